@@ -5,10 +5,18 @@
 #include "DrawOnTexture.h"
 
 #include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <algorithm>
 #include <string>
 #include <format>
 #include <unordered_map>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <span>
+#include <stdexcept>
 
 #include <windows.h>
 #include <windowsx.h>
@@ -36,6 +44,38 @@
 
 
 import d3d_util;
+import tile_canvas;
+import undo_history;
+import blend_kernels;
+import layer_stack;
+import readback_ring;
+import canvas_export;
+import descriptor_heap;
+import task_graph;
+import memory_budget;
+import frame_capture;
+import command_recorder;
+import render_device;
+import software_device;
+import pixel_formats;
+import render_graph;
+import transient_heap;
+import spatial_index;
+import cull_kernels;
+import indirect_draw;
+import filter_kernels;
+import canvas_filters;
+import filter_compute;
+import flood_fill;
+import glyph_rasterizer;
+import truetype_font;
+import glyph_cache;
+import text_runs;
+import path_tessellator;
+import distance_field;
+import resample;
+import jpeg_decoder;
+import frame_pacing;
 
 using winrt::com_ptr;
 using winrt::check_hresult;
@@ -47,8 +87,16 @@ using DirectX::XMFLOAT4X4;
 using DirectX::XMVECTOR;
 using DirectX::XMMATRIX;
 
-// Toggle this to use texture from file, or draw the texture using Direct2D.
-const bool use_texture_from_file = false;
+// Pick which texture the quad shows: the one loaded from file, the one drawn on with Direct2D,
+// the composite of the CPU layer stack, or a distance field that stays sharp at any scale.
+enum class TextureSource { file, direct2d, layers, distance_field };
+const TextureSource texture_source = TextureSource::direct2d;
+
+// Photos bigger than this either way are scaled down to fit when they're loaded.
+const int max_file_texture_size = 1024;
+
+// Most GPU memory the app lets itself use; lowered to the OS budget for the adapter if that's less.
+const uint64_t gpu_memory_budget = 512ull * 1024 * 1024;
 
 LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
@@ -91,12 +139,53 @@ struct Vertex {
     }
 };
 
+// For a square
+// 0  1
+// 3  2
+const std::array<Vertex, 4> quad_vertices = {
+    Vertex({ XMFLOAT2(-0.7f,  0.7f), XMFLOAT2(0,0) }),
+    Vertex({ XMFLOAT2( 0.7f,  0.8f), XMFLOAT2(1,0) }),
+    Vertex({ XMFLOAT2( 0.6f, -0.7f), XMFLOAT2(1,1) }),
+    Vertex({ XMFLOAT2(-0.7f, -0.7f), XMFLOAT2(0,1) })
+};
+
+const std::array<std::uint16_t, 6> quad_indices = { 0,1,3,  1,2,3 };
+
 struct SubmeshGeometry {
     uint32_t index_count = 0;
     uint32_t start_index = 0;
     int32_t base_vertex = 0;
 };
 
+// Bounds of a submesh's vertices in model space, the space the scene index works in.
+spatial::Bounds submesh_bounds(std::span<const Vertex> vertices, std::span<const uint16_t> indices,
+                               const SubmeshGeometry& submesh) {
+    spatial::Bounds b = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t i = 0; i < submesh.index_count; i++) {
+        const XMFLOAT2& p = vertices[indices[submesh.start_index + i] + submesh.base_vertex].pos;
+        b = spatial::merge(b, { p.x, p.y, p.x, p.y });
+    }
+    return b;
+}
+
+// The texture coordinate at model space point p, if one of the submesh's triangles covers it.
+std::optional<XMFLOAT2> submesh_texcoord(std::span<const Vertex> vertices, std::span<const uint16_t> indices,
+                                         const SubmeshGeometry& submesh, XMFLOAT2 p) {
+    for (uint32_t i = 0; i + 2 < submesh.index_count; i += 3) {
+        const Vertex& a = vertices[indices[submesh.start_index + i] + submesh.base_vertex];
+        const Vertex& b = vertices[indices[submesh.start_index + i + 1] + submesh.base_vertex];
+        const Vertex& c = vertices[indices[submesh.start_index + i + 2] + submesh.base_vertex];
+        float area = (b.pos.x - a.pos.x) * (c.pos.y - a.pos.y) - (c.pos.x - a.pos.x) * (b.pos.y - a.pos.y);
+        if (area == 0) continue;
+        float u = ((c.pos.x - p.x) * (a.pos.y - p.y) - (a.pos.x - p.x) * (c.pos.y - p.y)) / area;   // weight of b
+        float v = ((a.pos.x - p.x) * (b.pos.y - p.y) - (b.pos.x - p.x) * (a.pos.y - p.y)) / area;   // weight of c
+        float w = 1.0f - u - v;
+        if (u < 0 || v < 0 || w < 0) continue;
+        return XMFLOAT2(w * a.texc.x + u * b.texc.x + v * c.texc.x, w * a.texc.y + u * b.texc.y + v * c.texc.y);
+    }
+    return std::nullopt;
+}
+
 struct MeshGeometry {
     // Give it a name so we can look it up by name.
     std::string name;
@@ -153,7 +242,17 @@ class App {
     static App* s_app;
     HINSTANCE m_app_h = nullptr;           // application instance handle
     HWND      m_main_window_h = nullptr;   // main window handle
-    bool m_needs_draw = false;
+
+    // When to draw; see run(). Input invalidates it, 'F' cycles its mode.
+    pacing::FramePacer m_pacer{ pacing::steady_clock() };
+    winrt::handle m_frame_latency_waitable;     // the swap chain's, signalled when a frame flips
+    winrt::handle m_pacing_timer;
+    // The software renderer has no swap chain to hold it to the display, so it gets a pretend one.
+    std::optional<pacing::SimulatedPresentQueue> m_software_flips;
+    float m_spin = 0;   // radians, turned by continuous mode
+
+    // Tracked resources hold on to this, so it outlives all of them.
+    std::shared_ptr<gpu::MemoryBudget> m_memory = std::make_shared<gpu::MemoryBudget>(gpu_memory_budget);
 
     // Bumped it to version 3 from 1 (?).
     com_ptr<ID2D1Factory3> m_d2d_factory;
@@ -175,7 +274,9 @@ class App {
 
     com_ptr<ID3D12DescriptorHeap> m_rtv_heap;
     com_ptr<ID3D12DescriptorHeap> m_dsv_heap;
-    com_ptr<ID3D12DescriptorHeap> m_cbv_heap;
+    std::unique_ptr<gpu::DescriptorHeap> m_descriptors;
+    uint32_t m_cbv_index = 0;
+    uint32_t m_texture_index = 0;   // which SRV in m_descriptors the quad samples
 
     D3D_DRIVER_TYPE m_d3d_driver_type = D3D_DRIVER_TYPE_HARDWARE;
     DXGI_FORMAT m_back_buffer_format = DXGI_FORMAT_R8G8B8A8_UNORM; // ??
@@ -185,9 +286,12 @@ class App {
     uint32_t m_4x_msaa_quality = 0;      // quality level of 4X MSAA
 
     static const int SwapChainBufferCount = 2;
+    static const UINT swap_chain_flags =
+        DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH | DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
     int m_curr_back_buffer = 0;
     com_ptr<ID3D12Resource> m_swap_chain_buffer[SwapChainBufferCount];
-    com_ptr<ID3D12Resource> m_depth_stencil_buffer;
+    // Per frame targets (depth, and whatever passes draw() adds) are render graph transients placed here.
+    std::unique_ptr<gpu::TransientHeap> m_transients;
 
     com_ptr<ID3D12PipelineState> m_pso;
     com_ptr<ID3D12RootSignature> m_root_signature;
@@ -196,14 +300,85 @@ class App {
     D3D12_RECT m_scissor_rect;
 
     std::unique_ptr<MeshGeometry> m_geo;
+    // Vector shapes over the scene, tessellated at startup and drawn with their own pipeline.
+    std::unique_ptr<MeshGeometry> m_shape_geo;
+    com_ptr<ID3D12PipelineState> m_shape_pso;
     com_ptr<ID3D12Resource> m_texture1;
+    uint32_t m_file_srv = 0;
+    // The file texture starts as a 1/8 size preview; this is the real decode, coming on another thread.
+    std::future<image::DecodedImage> m_file_refined;
     com_ptr<ID3D12Resource> m_texture2;
+    com_ptr<ID3D12Resource> m_texture3;  // layer stack composite
+    com_ptr<ID3D12Resource> m_texture3_uploader;
+    com_ptr<ID3D12Resource> m_texture4;  // distance field, R8
+    std::unique_ptr<canvas::LayerStack> m_layers;
+    // Undo/redo (Ctrl+Z/Ctrl+Y) for the ink layer, the one the bucket and drop shadow draw on.
+    // Declared after m_layers, whose canvas it points into.
+    std::unique_ptr<canvas::UndoHistory> m_ink_history;
+
+    // Text drawn into the layers goes through the glyph and shaped run caches.
+    text::TrueTypeRasterizer m_fonts;
+    std::unique_ptr<text::GlyphCache> m_glyphs;
+    std::unique_ptr<text::RunCache> m_text_runs;
+
+    // Screenshots: the back buffer is copied into one of these and saved once the GPU is done.
+    static const int ReadbackBufferCount = 3;
+    com_ptr<ID3D12Resource> m_readback_buffers[ReadbackBufferCount];
+    std::unique_ptr<gpu::ReadbackRing> m_readback;
+    canvas::Exporter m_exporter;
+    bool m_screenshot_requested = false;
+
+    // Drawing on the CPU through render::SoftwareDevice, when there's no D3D12 device at all, not
+    // even WARP, or when started with --software. Shows the layer composite; the file and
+    // Direct2D textures need D3D to exist.
+    struct SoftwareRenderer {
+        std::unique_ptr<render::Device> device;
+        std::unique_ptr<render::CommandList> list;
+        render::Pipeline pipeline;
+        render::Buffer vertices;
+        render::Buffer indices;
+        render::Buffer constants;
+        render::Texture texture;
+        render::Texture color;
+        render::Texture depth;
+    };
+    std::unique_ptr<SoftwareRenderer> m_software;
+
+    // Frame capture, toggled with C. While it's on every frame's commands go to frames_<n>.cap.
+    std::unique_ptr<capture::Writer> m_capture;
+    bool m_capture_needs_geometry = false;  // a new capture hasn't seen the vertex data yet
 
     XMFLOAT4X4 m_world = Identity4x4();
     XMFLOAT4X4 m_view = Identity4x4();
     XMFLOAT4X4 m_proj = Identity4x4();
 
+    // Everything drawable, by its model space bounds, so draw() only issues what's in view and
+    // clicks don't scan. Users are indices into m_draw_items.
+    struct DrawItem {
+        std::string name;
+        SubmeshGeometry submesh;
+        spatial::ProxyId proxy = spatial::null_proxy;
+    };
+    std::vector<DrawItem> m_draw_items;
+    spatial::SpatialIndex m_scene_index{ 0.01f };
+    std::vector<uint32_t> m_visible;
+    XMFLOAT4X4 m_inv_world_view_proj = Identity4x4();  // clip space back to model space
+    spatial::Bounds m_view_bounds;                      // the viewport in model space, from update()
+
+    // The scene pass draws m_draw_items with one ExecuteIndirect, culled on the CPU, or on the GPU
+    // with G. Captures draw them one by one instead so they replay without indirect support.
+    std::unique_ptr<gpu::IndirectDrawer> m_indirect;
+    bool m_gpu_culling = false;
+
+    // B blurs the layer composite on the GPU on its way to the scene (the CPU layers stay sharp);
+    // S gives the ink layer a drop shadow on the CPU.
+    std::unique_ptr<gpu::BlurCompute> m_blur;
+    pixel::GaussianKernel m_blur_kernel = pixel::gaussian_kernel(3.0f);
+    bool m_gpu_blur = false;
+    bool m_texture_blurred = false;     // m_texture3 holds the blurred layers, not the plain ones
+
     std::unique_ptr<d3d_util::UploadBuffer<ObjectConstants>> m_object_cb = nullptr;
+    ObjectConstants m_object_constants;     // what's in m_object_cb, for captures
     struct ShaderByteCode {
         com_ptr<ID3DBlob> vs = nullptr;
         com_ptr<ID3DBlob> ps = nullptr;
@@ -241,22 +416,111 @@ public:
         switch (msg)
         {
         case WM_KEYDOWN:
-            m_needs_draw = true;
+            if (wParam == 'P') {
+                m_screenshot_requested = true;
+            } else if (wParam == 'C') {
+                toggle_capture();
+            } else if (wParam == 'G') {
+                m_gpu_culling = !m_gpu_culling;
+                debugf(L"culling on the {}\n", m_gpu_culling ? L"GPU" : L"CPU");
+            } else if (wParam == 'M') {
+                OutputDebugStringA(m_memory->dump().c_str());
+            } else if (wParam == 'T' && m_layers) {
+                m_exporter.save_tiles(std::format("layers_{}.tiles", draw_count), m_layers->composite());
+            } else if (wParam == 'B' && m_layers) {
+                m_gpu_blur = !m_gpu_blur;
+            } else if (wParam == 'S' && m_layers) {
+                canvas::Filter shadow;
+                shadow.kind = canvas::FilterKind::drop_shadow;
+                shadow.sigma = 3.0f;
+                canvas::apply_filter(m_layers->layer(1).pixels, shadow);
+                m_ink_history->commit_stroke();
+            } else if (wParam == 'Z' && GetKeyState(VK_CONTROL) < 0 && m_ink_history) {
+                m_ink_history->undo();
+            } else if (wParam == 'Y' && GetKeyState(VK_CONTROL) < 0 && m_ink_history) {
+                m_ink_history->redo();
+            } else if (wParam == 'F') {
+                auto mode = pacing::Mode((int(m_pacer.mode()) + 1) % 3);
+                m_pacer.set_mode(mode);
+                std::string_view name = pacing::mode_name(mode);
+                debugf(L"frame pacing: {}\n", std::wstring(name.begin(), name.end()));
+            }
+            m_pacer.invalidate();
+            break;
+        case WM_LBUTTONDOWN:
+            hit_test(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+            break;
+        case WM_RBUTTONDOWN:
+            paint_bucket(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+            m_pacer.invalidate();
             break;
         }
         return DefWindowProc(hwnd, msg, wParam, lParam);
     }
 
+    // Messages first, since they're what invalidates things, then a frame if the pacer says it's time,
+    // otherwise sleep until a message, a free present slot or the pacer's deadline.
     int run() {
-        MSG msg;
-        while (GetMessage(&msg, nullptr, 0, 0)) {
-            DispatchMessage(&msg);
-            if (m_needs_draw) {
+        start_pacing();
+        for (;;) {
+            MSG msg;
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+                if (msg.message == WM_QUIT) return (int)msg.wParam;
+                DispatchMessage(&msg);
+            }
+            if (m_software_flips) {
+                m_software_flips->collect(m_pacer.now(), [this](pacing::Nanos at) { m_pacer.slot_freed(at); });
+            }
+            if (m_pacer.should_begin()) {
+                m_pacer.begin_frame();
                 update();
-                draw();
+                if (m_software) {
+                    draw_software();
+                } else {
+                    draw();
+                }
+                continue;
             }
+            wait_for_frame();
+        }
+    }
+
+    void start_pacing() {
+        DEVMODEW mode{};
+        mode.dmSize = sizeof(mode);
+        if (EnumDisplaySettingsW(nullptr, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1) {
+            m_pacer.set_refresh(std::chrono::nanoseconds(1'000'000'000 / mode.dmDisplayFrequency));
+        }
+        if (m_software) {
+            m_software_flips.emplace(std::chrono::nanoseconds(1'000'000'000 / 60));
+        }
+        // A high resolution timer where there is one; the default tick is far too coarse to aim at a vblank.
+        m_pacing_timer.attach(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                                     TIMER_ALL_ACCESS));
+        if (!m_pacing_timer) {
+            m_pacing_timer.attach(CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+        }
+    }
+
+    void wait_for_frame() {
+        pacing::Nanos wait = m_pacer.wait_time();
+        if (m_software_flips && m_software_flips->next_flip() != pacing::forever) {
+            wait = std::min(wait, std::max(m_software_flips->next_flip() - m_pacer.now(), pacing::Nanos(0)));
+        }
+        HANDLE handles[2];
+        DWORD count = 0;
+        bool waitable = m_frame_latency_waitable && !m_software;
+        if (waitable) handles[count++] = m_frame_latency_waitable.get();
+        if (wait != pacing::forever && m_pacing_timer) {
+            LARGE_INTEGER due;
+            due.QuadPart = -std::max<int64_t>(wait.count() / 100, 1);  // relative, in 100ns units
+            SetWaitableTimer(m_pacing_timer.get(), &due, 0, nullptr, nullptr, false);
+            handles[count++] = m_pacing_timer.get();
+        }
+        DWORD result = MsgWaitForMultipleObjectsEx(count, handles, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        if (waitable && result == WAIT_OBJECT_0) {
+            m_pacer.slot_freed(m_pacer.now());
         }
-        return (int)msg.wParam;
     }
 
     bool init_main_window() {
@@ -320,16 +584,32 @@ private:
     void create_dxgi_factory() {
         check_hresult(CreateDXGIFactory1(__uuidof(m_dxgi_factory), m_dxgi_factory.put_void()));
     }
-    void create_d3d12_device() {
+    bool create_d3d12_device() {
         // Try to create hardware device.
         IUnknown *default_adapter = nullptr;
         HRESULT hr = D3D12CreateDevice(default_adapter, D3D_FEATURE_LEVEL_11_0, __uuidof(m_device), m_device.put_void());
         // Fallback to the "WARP" software device.
         if (FAILED(hr)) {
             com_ptr<IDXGIAdapter> warp_adapter;
-            check_hresult(m_dxgi_factory->EnumWarpAdapter(__uuidof(warp_adapter), warp_adapter.put_void()));
-            check_hresult(D3D12CreateDevice(warp_adapter.get(), D3D_FEATURE_LEVEL_11_0, __uuidof(m_device), m_device.put_void()));
+            hr = m_dxgi_factory->EnumWarpAdapter(__uuidof(warp_adapter), warp_adapter.put_void());
+            if (SUCCEEDED(hr)) {
+                hr = D3D12CreateDevice(warp_adapter.get(), D3D_FEATURE_LEVEL_11_0, __uuidof(m_device), m_device.put_void());
+            }
+        }
+        return SUCCEEDED(hr);
+    }
+
+    void set_memory_budget() {
+        uint64_t budget = gpu_memory_budget;
+        com_ptr<IDXGIAdapter3> adapter;
+        if (SUCCEEDED(m_dxgi_factory->EnumAdapterByLuid(m_device->GetAdapterLuid(), __uuidof(adapter), adapter.put_void()))) {
+            DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+            if (SUCCEEDED(adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)) && info.Budget > 0) {
+                budget = std::min(budget, info.Budget);
+            }
         }
+        m_memory->set_budget(budget);
+        debugf(L"gpu memory budget {} MB\n", budget >> 20);
     }
 
     void create_fence() {
@@ -359,11 +639,16 @@ private:
     }
 
 public:
-    void init_directx() {
+    // Returns false if there's no D3D12 device to be had; init_software() is the fallback.
+    bool init_directx() {
         create_d2d_factory();
         create_debug_layer();
         create_dxgi_factory();
-        create_d3d12_device();
+        if (!create_d3d12_device()) {
+            return false;
+        }
+        set_memory_budget();
+        m_transients = std::make_unique<gpu::TransientHeap>(m_device.get(), m_memory);
         create_fence();
         get_descriptor_sizes();
         check_msaa_support();
@@ -375,13 +660,29 @@ public:
         // Reset the command list to prep for initialization commands.
         check_hresult(m_command_list->Reset(m_direct_cmd_list_alloc.get(), nullptr));
 
-        load_textures();
-        build_descriptor_heaps();
-        build_constant_buffers();
-        build_root_signature();
-        build_shaders_and_input_layout();
-        make_geo();
-        build_pso();
+        // The rest of startup is a task graph so shader compiles, image decode and geometry can
+        // overlap. Only one task at a time may record into m_command_list, so those are chained.
+        // WIC and D2D stay on this thread.
+        tasks::TaskGraph startup;
+        auto shaders = startup.add("shaders", [this] { build_shaders_and_input_layout(); });
+        auto file_tex = startup.add("file texture", [this] { load_file_texture(); }, {}, tasks::Affinity::caller);
+        auto d2d_tex = startup.add("direct2d texture", [this] { m_texture2 = draw_on_texture(); }, {},
+                                   tasks::Affinity::caller);
+        auto layer_tex = startup.add("layer texture", [this] { build_layer_texture(); });
+        auto sdf_tex = startup.add("distance field texture", [this] { build_distance_field_texture(); });
+        auto geometry = startup.add("geometry", [this] { make_geo(); }, { layer_tex });
+        auto heaps = startup.add("descriptor heaps", [this] { build_descriptor_heaps(); },
+                                 { file_tex, d2d_tex, layer_tex, sdf_tex });
+        startup.add("constant buffers", [this] { build_constant_buffers(); }, { heaps });
+        auto root_sig = startup.add("root signature", [this] { build_root_signature(); }, { heaps });
+        startup.add("pso", [this] { build_pso(); }, { shaders, root_sig });
+        startup.add("shape geometry", [this] { make_shape_geo(); }, { geometry });
+        startup.add("shape pipeline", [this] { build_shape_pso(); }, { root_sig });
+        startup.add("indirect draws", [this] { build_indirect_draws(); }, { root_sig, geometry });
+        startup.add("blur pipeline", [this] { m_blur = std::make_unique<gpu::BlurCompute>(m_device.get()); });
+        startup.run();
+        OutputDebugStringA(("startup:\n" + startup.report()).c_str());
+        add_evictors();
 
         // Execute the initialization commands.
         check_hresult(m_command_list->Close());
@@ -391,10 +692,15 @@ public:
         // Wait until initialization is complete.
         flush_command_queue();
         debugf(L"finished init_directx()\n");
+        return true;
     }
 
 
     void on_resize() {
+        if (m_software) {
+            resize_software();
+            return;
+        }
         assert(m_device);
         assert(m_swap_chain);
         assert(m_direct_cmd_list_alloc);
@@ -408,69 +714,27 @@ public:
         for (int i = 0; i < SwapChainBufferCount; ++i) {
             m_swap_chain_buffer[i] = nullptr; // .Reset();
         }
-        m_depth_stencil_buffer = nullptr; //.Reset();
+        // The transients are sized to the window; the next frame places them again.
+        m_transients->release();
 
         // Resize the swap chain.
         check_hresult(m_swap_chain->ResizeBuffers(
             SwapChainBufferCount,
             m_client_width, m_client_height,
             m_back_buffer_format,
-            DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH));
+            swap_chain_flags));
 
         m_curr_back_buffer = 0;
 
         CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHeapHandle(m_rtv_heap->GetCPUDescriptorHandleForHeapStart());
         for (uint32_t i = 0; i < SwapChainBufferCount; i++) {
             check_hresult(m_swap_chain->GetBuffer(i, IID_PPV_ARGS(&m_swap_chain_buffer[i])));
+            d3d_util::track_memory(m_memory, m_swap_chain_buffer[i].get(), gpu::MemoryCategory::render_target,
+                                   std::format("back buffer {}", i));
             m_device->CreateRenderTargetView(m_swap_chain_buffer[i].get(), nullptr, rtvHeapHandle);
             rtvHeapHandle.Offset(1, m_rtv_desc_size);
         }
 
-        // Create the depth/stencil buffer and view.
-        D3D12_RESOURCE_DESC depthStencilDesc;
-        depthStencilDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        depthStencilDesc.Alignment = 0;
-        depthStencilDesc.Width = m_client_width;
-        depthStencilDesc.Height = m_client_height;
-        depthStencilDesc.DepthOrArraySize = 1;
-        depthStencilDesc.MipLevels = 1;
-
-        // Correction 11/12/2016: SSAO chapter requires an SRV to the depth buffer to read from 
-        // the depth buffer.  Therefore, because we need to create two views to the same resource:
-        //   1. SRV format: DXGI_FORMAT_R24_UNORM_X8_TYPELESS
-        //   2. DSV Format: DXGI_FORMAT_D24_UNORM_S8_UINT
-        // we need to create the depth buffer resource with a typeless format.  
-        depthStencilDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
-
-        depthStencilDesc.SampleDesc.Count = m_4x_msaa_state ? 4 : 1;
-        depthStencilDesc.SampleDesc.Quality = m_4x_msaa_state ? (m_4x_msaa_quality - 1) : 0;
-        depthStencilDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-        depthStencilDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-        D3D12_CLEAR_VALUE optClear;
-        optClear.Format = m_depth_stencil_format;
-        optClear.DepthStencil.Depth = 1.0f;
-        optClear.DepthStencil.Stencil = 0;
-        CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_DEFAULT);
-        check_hresult(m_device->CreateCommittedResource(&heap_props,
-                                                        D3D12_HEAP_FLAG_NONE,
-                                                        &depthStencilDesc,
-                                                        D3D12_RESOURCE_STATE_COMMON,
-                                                        &optClear, __uuidof(m_depth_stencil_buffer), m_depth_stencil_buffer.put_void()));
-
-        // Create descriptor to mip level 0 of entire resource using the format of the resource.
-        D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
-        dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-        dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-        dsvDesc.Format = m_depth_stencil_format;
-        dsvDesc.Texture2D.MipSlice = 0;
-        m_device->CreateDepthStencilView(m_depth_stencil_buffer.get(), &dsvDesc, depth_stencil_view());
-
-        // Transition the resource from its initial state to be used as a depth buffer.
-        auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_depth_stencil_buffer.get(),
-                                                            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_DEPTH_WRITE);
-        m_command_list->ResourceBarrier(1, &barrier);
-
         // Execute the resize commands.
         check_hresult(m_command_list->Close());
         ID3D12CommandList* cmdsLists[] = { m_command_list.get() };
@@ -489,6 +753,9 @@ public:
 
         m_scissor_rect = { 0, 0, m_client_width, m_client_height };
 
+        // The readback buffers are back buffer sized; the next screenshot makes new ones.
+        release_readback_ring();
+
         // DirectX::XMMATRIX P = DirectX::XMMatrixPerspectiveFovLH(0.25f * pi, aspect_ratio(), 1.0f, 1000.0f);
         auto P = DirectX::XMMatrixOrthographicLH(2, 2, -0.5, 1000.0f);
         XMStoreFloat4x4(&m_proj, P);
@@ -552,10 +819,17 @@ public:
         sd.OutputWindow = m_main_window_h;
         sd.Windowed = true;
         sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-        sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+        sd.Flags = swap_chain_flags;
 
         // Note: Swap chain uses queue to perform flush.
         check_hresult(m_dxgi_factory->CreateSwapChain(m_command_queue.get(), &sd, m_swap_chain.put()));
+
+        // One frame queued at most, and a handle that says when there's room for it. It starts out
+        // signalled; take that now so it and the pacer agree there's one slot, and the frame can go.
+        auto swap_chain2 = m_swap_chain.as<IDXGISwapChain2>();
+        check_hresult(swap_chain2->SetMaximumFrameLatency(1));
+        m_frame_latency_waitable.attach(swap_chain2->GetFrameLatencyWaitableObject());
+        WaitForSingleObjectEx(m_frame_latency_waitable.get(), 1000, true);
     }
 
     ID3D12Resource* current_back_buffer() const {
@@ -570,17 +844,44 @@ public:
         return m_dsv_heap->GetCPUDescriptorHandleForHeapStart();
     }
 
-    void load_textures();
+    void load_file_texture();
+    com_ptr<ID3D12Resource> upload_file_texture(const image::DecodedImage& image);
+    void refine_file_texture();
     void build_descriptor_heaps();
     void build_constant_buffers();
     void build_root_signature();
     void build_shaders_and_input_layout();
     void make_geo();
     void build_pso();
+    void make_shape_geo();
+    void build_shape_pso();
+    void build_indirect_draws();
     com_ptr<ID3D12Resource> draw_on_texture();
+    void build_layer_texture();
+    void build_distance_field_texture();
+    void build_readback_ring();
+    void record_screenshot(capture::CommandRecorder& cmd);
+    void toggle_capture();
+    void build_layers();
+    void init_software();
+    void resize_software();
+    void draw_software();
+    void present_software(const uint32_t* pixels, uint32_t width, uint32_t height);
+    void collect_readbacks();
+    void upload_layer_tiles();
+    void add_draw_item(const std::string& name, const SubmeshGeometry& submesh, const spatial::Bounds& bounds);
+    spatial::Bounds view_bounds(const XMMATRIX& world_view_proj);
+    XMFLOAT2 screen_to_model(int x, int y);
+    void hit_test(int x, int y);
+    void paint_bucket(int x, int y);
+    void copy_layer_tiles(capture::CommandRecorder& cmd);
+    bool add_layer_blur(capture::CommandRecorder& cmd, gpu::RenderGraph& graph, gpu::ResourceHandle layers);
+    void add_evictors();
+    uint64_t release_readback_ring();
 
     void update();
     void draw();
+    void log_pacing();
     void flush_command_queue();
     std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> get_static_samplers();
 
@@ -604,13 +905,14 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     PIXLoadLatestWinPixGpuCapturerLibrary();
 
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
 
-    // TODO: Place code here.
+    bool software = wcsstr(lpCmdLine, L"--software") != nullptr;
 
     App app(hInstance);
     app.init_main_window();
-    app.init_directx();
+    if (software || !app.init_directx()) {
+        app.init_software();
+    }
     app.on_resize();
     return app.run();
 }
@@ -630,69 +932,184 @@ void App::update() {
     XMMATRIX view = DirectX::XMMatrixLookAtLH(pos, target, up);
     XMStoreFloat4x4(&m_view, view);
 
-    XMMATRIX world = DirectX::XMLoadFloat4x4(&m_world);
+    if (m_pacer.mode() == pacing::Mode::continuous) {
+        // A quarter turn a second, by the clock rather than per frame, so it's the same speed at any rate.
+        auto delta = std::min(m_pacer.frame_delta(), pacing::Nanos(std::chrono::milliseconds(100)));
+        m_spin += float(std::chrono::duration<double>(delta).count() * DirectX::XM_PIDIV2);
+    }
+    XMMATRIX world = DirectX::XMMatrixRotationZ(m_spin) * DirectX::XMLoadFloat4x4(&m_world);
     XMMATRIX proj = DirectX::XMLoadFloat4x4(&m_proj);
     XMMATRIX worldViewProj = world * view * proj;
 
     // Update the constant buffer with the latest worldViewProj matrix.
-    ObjectConstants objConstants;
-    XMStoreFloat4x4(&objConstants.WorldViewProj, XMMatrixTranspose(worldViewProj));
-    m_object_cb->copy_data(0, objConstants);
+    XMStoreFloat4x4(&m_object_constants.WorldViewProj, XMMatrixTranspose(worldViewProj));
+    m_view_bounds = view_bounds(worldViewProj);
+    if (m_software) {
+        auto bytes = reinterpret_cast<const uint8_t*>(&m_object_constants);
+        m_software->device->write_buffer(m_software->constants, 0, { bytes, sizeof(m_object_constants) });
+    } else {
+        m_object_cb->copy_data(0, m_object_constants);
+    }
 }
 
 
 void App::draw() {
     draw_count++;
-    debugf(L"App::draw() {}\n", draw_count);
 
     // Reuse the memory associated with command recording.
     // We can only reset when the associated command lists have finished execution on the GPU.
     check_hresult(m_direct_cmd_list_alloc->Reset());
+    m_descriptors->retire(m_fence->GetCompletedValue());
+    refine_file_texture();
+    // Nothing from earlier frames is in flight (see the flush below), so evicting is safe here.
+    m_memory->enforce();
 
     // A command list can be reset after it has been added to the command queue via ExecuteCommandList.
     // Reusing the command list reuses memory.
     check_hresult(m_command_list->Reset(m_direct_cmd_list_alloc.get(), m_pso.get()));
     PIXSetMarker(m_command_list.get(), 0xFF00FF00, "Draw count=%d", draw_count);
-    m_command_list->RSSetViewports(1, &m_screen_viewport);
-    m_command_list->RSSetScissorRects(1, &m_scissor_rect);
-
-    // Indicate a state transition on the resource usage.
-    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(current_back_buffer(),
-        D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    m_command_list->ResourceBarrier(1, &barrier);
-
-    // Clear the back buffer and depth buffer.
-    m_command_list->ClearRenderTargetView(current_back_buffer_view(), Colors::LightSteelBlue, 0, nullptr);
-    m_command_list->ClearDepthStencilView(depth_stencil_view(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-    // Specify the buffers we are going to render to.
-    auto bbv = current_back_buffer_view();
-    auto dsv = depth_stencil_view();
-    m_command_list->OMSetRenderTargets(1, &bbv, true, &dsv);
-
-    ID3D12DescriptorHeap* desc_heaps[] = { m_cbv_heap.get() };
-    m_command_list->SetDescriptorHeaps(1, desc_heaps);
-
-    m_command_list->SetPipelineState(m_pso.get());
-    m_command_list->SetGraphicsRootSignature(m_root_signature.get());
-
-    auto vb_view = m_geo->vertex_buffer_view();
-    auto ib_view = m_geo->index_buffer_view();
-    m_command_list->IASetVertexBuffers(0, 1, &vb_view);
-    m_command_list->IASetIndexBuffer(&ib_view);
-    m_command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-    CD3DX12_GPU_DESCRIPTOR_HANDLE heap_handle( m_cbv_heap->GetGPUDescriptorHandleForHeapStart() );
-    m_command_list->SetGraphicsRootDescriptorTable(0, heap_handle);
-    heap_handle.Offset(1 * m_cbv_srv_uav_desc_size);
-    m_command_list->SetGraphicsRootDescriptorTable(1, heap_handle);
-    debugf(L"index count = {}\n", m_geo->index_count);
-    m_command_list->DrawIndexedInstanced(m_geo->index_count, 1, 0, 0, 0);
-    
-    // Indicate a state transition on the resource usage.
-    auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(current_back_buffer(), D3D12_RESOURCE_STATE_RENDER_TARGET,
-                                                         D3D12_RESOURCE_STATE_PRESENT);
-    m_command_list->ResourceBarrier(1, &barrier2);
+    // Everything from here to Close() goes through cmd so a capture can see it.
+    capture::CommandRecorder cmd(m_command_list.get(), m_capture.get());
+    cmd.begin_frame(draw_count);
+    if (cmd.capturing()) {
+        if (m_capture_needs_geometry) {
+            cmd.upload(m_geo->vbuf_gpu.get(), 0, m_geo->vbuf_cpu->GetBufferPointer(), m_geo->vbuf_size);
+            cmd.upload(m_geo->ibuf_gpu.get(), 0, m_geo->ibuf_cpu->GetBufferPointer(), m_geo->ibuf_size);
+            cmd.upload(m_shape_geo->vbuf_gpu.get(), 0, m_shape_geo->vbuf_cpu->GetBufferPointer(),
+                       m_shape_geo->vbuf_size);
+            cmd.upload(m_shape_geo->ibuf_gpu.get(), 0, m_shape_geo->ibuf_cpu->GetBufferPointer(),
+                       m_shape_geo->ibuf_size);
+            m_capture_needs_geometry = false;
+        }
+        cmd.upload(m_object_cb->resource(), 0, &m_object_constants, sizeof(m_object_constants));
+    }
+
+    // The frame as a render graph. The passes only say what they read and write; the graph adds
+    // the barriers and places the depth buffer (and any other per frame target) in the transient heap.
+    gpu::RenderGraph graph;
+    auto back_buffer = graph.import_resource("back buffer", current_back_buffer(), gpu::Access::present,
+                                             gpu::Access::present);
+    gpu::TransientDesc depth_desc;
+    depth_desc.width = uint32_t(m_client_width);
+    depth_desc.height = uint32_t(m_client_height);
+    // Typeless so a later pass could read it through an R24_UNORM_X8_TYPELESS SRV.
+    depth_desc.format = DXGI_FORMAT_R24G8_TYPELESS;
+    depth_desc.view_format = m_depth_stencil_format;
+    depth_desc.samples = m_4x_msaa_state ? 4 : 1;
+    depth_desc.quality = m_4x_msaa_state ? (m_4x_msaa_quality - 1) : 0;
+    auto depth = graph.create_texture("depth stencil", depth_desc);
+
+    gpu::ResourceHandle layers;
+    if (texture_source == TextureSource::layers) {
+        layers = graph.import_resource("layer composite", m_texture3.get(), gpu::Access::shader_read,
+                                       gpu::Access::shader_read);
+        // The blur replaces the whole texture, so it has to start from a full upload of the
+        // layers. That only happens when it's switched on or off or the layers change; the rest of
+        // the time the texture keeps the last result.
+        bool gpu_blur = m_gpu_blur && !cmd.capturing();
+        m_layers->update();
+        auto& comp = m_layers->composite();
+        if (gpu_blur != m_texture_blurred || (gpu_blur && !comp.dirty_tiles().empty())) {
+            comp.mark_all_dirty();
+        }
+        if (!comp.dirty_tiles().empty()) {
+            graph.add_pass("layer upload", [&] { copy_layer_tiles(cmd); })
+                .write(layers, gpu::Access::copy_dst);
+            m_texture_blurred = gpu_blur && add_layer_blur(cmd, graph, layers);
+        }
+    }
+
+    // GPU culling fills the indirect argument buffer for the scene pass.
+    culling::ObjectBounds view = { m_view_bounds.min_x, m_view_bounds.min_y, m_view_bounds.max_x, m_view_bounds.max_y };
+    bool indirect = !cmd.capturing();
+    bool gpu_culling = indirect && m_gpu_culling;
+    gpu::ResourceHandle draws, indirect_count;
+    if (gpu_culling) {
+        draws = graph.import_resource("indirect draws", m_indirect->gpu_draws(), gpu::Access::indirect_argument,
+                                      gpu::Access::indirect_argument);
+        indirect_count = graph.import_resource("indirect count", m_indirect->gpu_count(),
+                                               gpu::Access::indirect_argument, gpu::Access::indirect_argument);
+        graph.add_pass("reset draw count", [&] { m_indirect->record_count_reset(m_command_list.get()); })
+            .write(indirect_count, gpu::Access::copy_dst);
+        graph.add_pass("cull", [&] { m_indirect->record_gpu_cull(m_command_list.get(), view); })
+            .write(draws, gpu::Access::unordered)
+            .write(indirect_count, gpu::Access::unordered);
+    } else if (indirect) {
+        m_indirect->cull_cpu(view);
+    }
+
+    auto scene = graph.add_pass("scene", [&] {
+        ID3D12Resource* depth_buffer = m_transients->resource(graph, depth);
+        D3D12_DEPTH_STENCIL_VIEW_DESC dsv_desc = {};
+        dsv_desc.Format = m_depth_stencil_format;
+        dsv_desc.ViewDimension = m_4x_msaa_state ? D3D12_DSV_DIMENSION_TEXTURE2DMS : D3D12_DSV_DIMENSION_TEXTURE2D;
+        m_device->CreateDepthStencilView(depth_buffer, &dsv_desc, depth_stencil_view());
+
+        cmd.set_viewport(m_screen_viewport);
+        cmd.set_scissor(m_scissor_rect);
+
+        // Clear the back buffer and depth buffer.
+        cmd.clear_render_target(current_back_buffer(), current_back_buffer_view(), Colors::LightSteelBlue);
+        cmd.clear_depth_stencil(depth_buffer, depth_stencil_view(), 1.0f, 0);
+
+        // Specify the buffers we are going to render to.
+        cmd.set_render_target(current_back_buffer(), current_back_buffer_view(), depth_buffer, depth_stencil_view());
+
+        cmd.set_descriptor_heap(m_descriptors->heap());
+
+        cmd.set_pipeline(m_pso.get());
+        cmd.set_root_signature(m_root_signature.get());
+
+        cmd.set_vertex_buffer(m_geo->vbuf_gpu.get(), m_geo->vertex_buffer_view());
+        cmd.set_index_buffer(m_geo->ibuf_gpu.get(), m_geo->index_buffer_view());
+        cmd.set_topology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        cmd.set_root_table(0, m_descriptors->gpu(m_cbv_index), m_object_cb->resource());
+        cmd.set_root_constant(1, m_texture_index);
+        cmd.set_root_table(2, m_descriptors->gpu(0));
+        if (indirect) {
+            m_indirect->draw(m_command_list.get(), gpu_culling);
+        } else {
+            // Only what the scene index says is in view, in the order it was added.
+            m_visible.clear();
+            m_scene_index.query(m_view_bounds, m_visible);
+            std::sort(m_visible.begin(), m_visible.end());
+            for (uint32_t item : m_visible) {
+                const auto& submesh = m_draw_items[item].submesh;
+                cmd.draw_indexed(submesh.index_count, 1, submesh.start_index, submesh.base_vertex);
+            }
+        }
+
+        // The shapes go on top in the order they were tessellated, one draw for all of them. Same
+        // root signature, so the constant buffer bound above still applies.
+        if (m_shape_geo->index_count > 0) {
+            cmd.set_pipeline(m_shape_pso.get());
+            cmd.set_vertex_buffer(m_shape_geo->vbuf_gpu.get(), m_shape_geo->vertex_buffer_view());
+            cmd.set_index_buffer(m_shape_geo->ibuf_gpu.get(), m_shape_geo->index_buffer_view());
+            cmd.draw_indexed(m_shape_geo->index_count, 1, 0, 0);
+        }
+    });
+    scene.write(back_buffer, gpu::Access::render_target).write(depth, gpu::Access::depth_write);
+    if (layers) {
+        scene.read(layers, gpu::Access::shader_read);
+    }
+    if (gpu_culling) {
+        scene.read(draws, gpu::Access::indirect_argument).read(indirect_count, gpu::Access::indirect_argument);
+    }
+
+    if (m_screenshot_requested) {
+        graph.add_pass("screenshot", [&] { record_screenshot(cmd); })
+            .read(back_buffer, gpu::Access::copy_src)
+            .side_effect();
+    }
+
+    graph.compile(m_transients->placement());
+    m_transients->realize(graph);
+    graph.execute([&](std::span<const gpu::Barrier> barriers) { m_transients->barriers(cmd, graph, barriers); });
+    if (draw_count % 600 == 0) {
+        OutputDebugStringA(graph.report().c_str());
+    }
+    cmd.end_frame(draw_count);
 
     // Done recording commands.
     check_hresult(m_command_list->Close());
@@ -700,16 +1117,36 @@ void App::draw() {
     // Add the command list to the queue for execution.
     ID3D12CommandList* cmd_lists[] = { m_command_list.get() };
     m_command_queue->ExecuteCommandLists(1, cmd_lists);
+    m_pacer.cpu_done();
+
+    // flush_command_queue() signals the next fence value once this frame is done.
+    m_descriptors->end_frame(m_current_fence + 1);
 
     // swap the back and front buffers
-    check_hresult(m_swap_chain->Present(0, 0));
+    // On the vblank; the pacer and the waitable object keep this from ever blocking.
+    check_hresult(m_swap_chain->Present(1, 0));
     m_curr_back_buffer = (m_curr_back_buffer + 1) % SwapChainBufferCount;
 
     // Wait until frame commands are complete.  This waiting is inefficient and is done for simplicity. 
     // Later we will show how to organize our rendering code so we do not have to wait per frame.
     flush_command_queue();
-    m_needs_draw = false;
-    
+    m_pacer.gpu_done();
+    collect_readbacks();
+    m_memory->end_frame();
+    if (draw_count % 600 == 0) {
+        OutputDebugStringA(m_memory->dump().c_str());
+        log_pacing();
+    }
+
+}
+
+
+void App::log_pacing() {
+    auto stats = m_pacer.stats();
+    auto ms = [](pacing::Nanos t) { return std::chrono::duration<double, std::milli>(t).count(); };
+    debugf(L"pacing: {} frames, {} missed, cpu {:.2f} ms, gpu {:.2f} ms, margin {:.2f} ms, refresh {:.3f} ms, "
+           L"latency {:.2f} ms\n", stats.frames, stats.missed, ms(stats.cpu), ms(stats.gpu), ms(stats.margin),
+           ms(stats.refresh), ms(stats.latency));
 }
 
 
@@ -737,92 +1174,146 @@ void App::flush_command_queue() {
 }
 
 
-void App::load_textures() {
-    // from MS docs on WIC
-    // Create a decoder
-    IWICImagingFactory* m_pIWICFactory;
-    HRESULT hr = S_OK;
-
-    // Create WIC factory
-   /* hr = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_pIWICFactory));
+// Decodes with WIC to RGBA8, for files the JPEG decoder can't read.
+image::DecodedImage decode_with_wic(const wchar_t* filename) {
+    com_ptr<IWICImagingFactory> factory;
+    check_hresult(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                                   __uuidof(factory), factory.put_void()));
+    com_ptr<IWICBitmapDecoder> decoder;
+    check_hresult(factory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand,
+                                                     decoder.put()));
+    com_ptr<IWICBitmapFrameDecode> frame;
+    check_hresult(decoder->GetFrame(0, frame.put()));
+    com_ptr<IWICFormatConverter> converter;
+    check_hresult(factory->CreateFormatConverter(converter.put()));
+    check_hresult(converter->Initialize(frame.get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr,
+                                        0.0, WICBitmapPaletteTypeCustom));
+    UINT width = 0, height = 0;
+    check_hresult(converter->GetSize(&width, &height));
+    image::DecodedImage decoded;
+    decoded.width = int(width);
+    decoded.height = int(height);
+    decoded.pixels.resize(size_t(width) * height);
+    check_hresult(converter->CopyPixels(nullptr, width * 4, UINT(decoded.pixels.size() * 4),
+                                        reinterpret_cast<BYTE*>(decoded.pixels.data())));
+    return decoded;
+}
 
+// Fits the image to max_file_texture_size in linear light: a camera photo is far bigger than the
+// quad it's drawn on, and would otherwise alias and waste memory.
+void fit_file_texture(image::DecodedImage& image) {
+    int fit_width, fit_height;
+    pixel::fit_within(image.width, image.height, max_file_texture_size, max_file_texture_size, fit_width, fit_height);
+    if (fit_width == image.width && fit_height == image.height) {
+        return;
+    }
+    std::vector<uint32_t> fitted(size_t(fit_width) * fit_height);
+    pixel::resample_rgba8(fitted.data(), fit_width, fit_height, fit_width, image.pixels.data(), image.width,
+                          image.height, image.width);
+    image.pixels = std::move(fitted);
+    image.width = fit_width;
+    image.height = fit_height;
+}
 
-    IWICBitmapDecoder* pDecoder = NULL;
-    auto filename = L"kitten1.jpg";
-    hr = m_pIWICFactory->CreateDecoderFromFilename(filename,                       // Image to be decoded
-        NULL,                           // Do not prefer a particular vendor
-        GENERIC_READ,                   // Desired read access to the file
-        WICDecodeMetadataCacheOnDemand, // Cache metadata when needed
-        &pDecoder                       // Pointer to the decoder
-    );
-    check_hresult(hr);
-    // Retrieve the first frame of the image from the decoder
-    IWICBitmapFrameDecode* pFrame = NULL;
+// JPEGs are decoded only as big as the texture needs, by the JPEG decoder's DCT scaling. When that
+// still means more than 1/8 size, a 1/8 decode goes up first and the real one replaces it when a
+// background thread has it (see refine_file_texture()). Anything else goes through WIC.
+void App::load_file_texture() {
+    const wchar_t* filename = L"kitten1b.jpg";
+    std::ifstream in(filename, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    image::JpegInfo info;
+    try {
+        info = image::read_jpeg_info(bytes);
+    } catch (const std::runtime_error&) {
+        // Not a JPEG.
+    }
+    if (!info.supported) {
+        auto decoded = decode_with_wic(filename);
+        fit_file_texture(decoded);
+        m_texture1 = upload_file_texture(decoded);
+        return;
+    }
 
-    if (SUCCEEDED(hr)) {
-        hr = pDecoder->GetFrame(0, &pFrame);
-    } */
+    int fit_width, fit_height;
+    pixel::fit_within(info.width, info.height, max_file_texture_size, max_file_texture_size, fit_width, fit_height);
+    int scale = image::jpeg_scale_for(info.width, info.height, fit_width, fit_height);
+    debugf(L"{}: {}x{}, decoding at 1/{}\n", filename, info.width, info.height, 1 << scale);
+    auto decode = [bytes = std::move(bytes)](int at_scale) {
+        auto decoded = image::decode_jpeg(bytes, at_scale);
+        fit_file_texture(decoded);
+        return decoded;
+    };
+    if (scale == 3) {
+        m_texture1 = upload_file_texture(decode(scale));
+        return;
+    }
+    m_texture1 = upload_file_texture(decode(3));
+    m_file_refined = std::async(std::launch::async, std::move(decode), scale);
+}
 
+com_ptr<ID3D12Resource> App::upload_file_texture(const image::DecodedImage& image) {
+    auto desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, image.width, image.height, 1, 1);
     com_ptr<ID3D12Resource> tex;
-    DirectX::ResourceUploadBatch resourceUpload(m_device.get());
-    resourceUpload.Begin();
-    auto cwd = std::filesystem::current_path();
-    hr = CreateWICTextureFromFile(m_device.get(), resourceUpload, L"kitten1b.jpg", tex.put(), false);
-    check_hresult(hr);
-    auto uploadResourcesFinished = resourceUpload.End(m_command_queue.get()); // ->GetCommandQueue());
-
-    uploadResourcesFinished.wait();
-
-    m_texture1 = std::move(tex);
+    CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_DEFAULT);
+    check_hresult(m_device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &desc,
+                                                    D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                                    __uuidof(tex), tex.put_void()));
+    d3d_util::track_memory(m_memory, tex.get(), gpu::MemoryCategory::texture, "kitten1b.jpg");
+    D3D12_SUBRESOURCE_DATA data = { image.pixels.data(), LONG_PTR(image.width) * 4, LONG_PTR(image.pixels.size()) * 4 };
+    DirectX::ResourceUploadBatch upload(m_device.get());
+    upload.Begin();
+    upload.Upload(tex.get(), 0, &data, 1);
+    upload.Transition(tex.get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    upload.End(m_command_queue.get()).wait();
+    return tex;
+}
 
-    m_texture2 = draw_on_texture();
-   /* dw_help = new DWriteHelper(m_device.get(), m_command_queue.get(), m_main_window_h);
-    dw_help->write_text();
-    m_text_texture = dw_help->get_texture();*/
+// Swaps the full decode in for the preview once it's ready. Nothing is in flight between frames
+// (draw() flushes at the end), so the SRV can be rewritten in place and the preview let go.
+void App::refine_file_texture() {
+    if (!m_file_refined.valid() || m_file_refined.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    try {
+        auto texture = upload_file_texture(m_file_refined.get());
+        m_descriptors->update_srv(m_file_srv, texture.get());
+        m_texture1 = std::move(texture);
+    } catch (const std::runtime_error& e) {
+        std::string_view what = e.what();
+        debugf(L"file texture: keeping the preview, {}\n", std::wstring(what.begin(), what.end()));
+    }
 }
 
 
-// The base class created RTV and DSV descriptor heaps. This creates  CBV/SRV/UAV heap.
+// The base class created RTV and DSV descriptor heaps. This creates the CBV/SRV/UAV heap, which is
+// bindless: every texture gets an SRV up front and the shader picks one with a root constant.
 void App::build_descriptor_heaps() {
-    // cbv = constant buffer view .... "view" ~ descriptor
-    D3D12_DESCRIPTOR_HEAP_DESC heap_desc;
-    heap_desc.NumDescriptors = 2;
-    heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    heap_desc.NodeMask = 0;
-    check_hresult(m_device->CreateDescriptorHeap(&heap_desc, __uuidof(m_cbv_heap), m_cbv_heap.put_void()));
-
-    // int desc_size = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    //
-    // Fill out the heap with actual descriptors.
-    //
-    CD3DX12_CPU_DESCRIPTOR_HANDLE desc_h(m_cbv_heap->GetCPUDescriptorHandleForHeapStart());
-    debugf(L"heap start: {}\n", desc_h.ptr);
-    // auto woodCrateTex = mTextures["woodCrateTex"]->Resource;
-
-    auto create_srv = [&desc_h, this](ID3D12Resource* tex) {
-        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
-        srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srv_desc.Format = tex->GetDesc().Format;
-        srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srv_desc.Texture2D.MostDetailedMip = 0;
-        srv_desc.Texture2D.MipLevels = tex->GetDesc().MipLevels;
-        srv_desc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-        desc_h.Offset(1, m_cbv_srv_uav_desc_size);
-        debugf(L" handle after offset: {}\n", desc_h.ptr);
-
-        m_device->CreateShaderResourceView(tex, &srv_desc, desc_h);
-    };
-    if (use_texture_from_file) {
-        create_srv(m_texture1.get());
-    } else {
-        create_srv(m_texture2.get());
+    m_descriptors = std::make_unique<gpu::DescriptorHeap>(m_device.get(), 1024, 1024);
+
+    m_file_srv = m_descriptors->create_srv(m_texture1.get());
+    uint32_t d2d_srv = m_descriptors->create_srv(m_texture2.get());
+    uint32_t layers_srv = m_descriptors->create_srv(m_texture3.get());
+    uint32_t sdf_srv = m_descriptors->create_srv(m_texture4.get());
+    switch (texture_source) {
+    case TextureSource::file:
+        m_texture_index = m_file_srv;
+        break;
+    case TextureSource::direct2d:
+        m_texture_index = d2d_srv;
+        break;
+    case TextureSource::layers:
+        m_texture_index = layers_srv;
+        break;
+    case TextureSource::distance_field:
+        m_texture_index = sdf_srv;
+        break;
     }
 }
 
 void App::build_constant_buffers() {
     m_object_cb = std::make_unique<d3d_util::UploadBuffer<ObjectConstants>>(m_device.get(), 1, true);
+    d3d_util::track_memory(m_memory, m_object_cb->resource(), gpu::MemoryCategory::upload, "object constants");
 
     uint32_t cb_byte_size = d3d_util::calc_constant_buffer_byte_size(sizeof(ObjectConstants));
 
@@ -835,7 +1326,7 @@ void App::build_constant_buffers() {
     cbvDesc.BufferLocation = cbAddress;
     cbvDesc.SizeInBytes = d3d_util::calc_constant_buffer_byte_size(sizeof(ObjectConstants));
 
-    m_device->CreateConstantBufferView(&cbvDesc, m_cbv_heap->GetCPUDescriptorHandleForHeapStart());
+    m_cbv_index = m_descriptors->create_cbv(cbvDesc);
 }
 
 void App::build_root_signature() {
@@ -844,13 +1335,17 @@ void App::build_root_signature() {
     // texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
     CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
     ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_NONE); // DATA_STATIC);
-    ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_NONE); // DATA_STATIC);
+    // Bindless textures: the whole heap from index 0 as t0[]. Volatile because most of it isn't
+    // SRVs (or isn't written yet), which is fine as long as the shader never reads those.
+    ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, m_descriptors->size(), 0, 0,
+                   D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
 
-    CD3DX12_ROOT_PARAMETER1 params[2];
+    CD3DX12_ROOT_PARAMETER1 params[3];
 
     // Perfomance TIP: Order from most frequent to least frequent.
     params[0].InitAsDescriptorTable(1, ranges, D3D12_SHADER_VISIBILITY_ALL);
-    params[1].InitAsDescriptorTable(1, ranges+1, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[1].InitAsConstants(1, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL);    // texture index, b1
+    params[2].InitAsDescriptorTable(1, ranges+1, D3D12_SHADER_VISIBILITY_PIXEL);
     // slotRootParameter[1].InitAsConstantBufferView(1); // <- "register" number. Used 0 in table above.
     // slotRootParameter[2].InitAsConstantBufferView(2);
     // slotRootParameter[3].InitAsConstantBufferView(3);
@@ -870,7 +1365,7 @@ void App::build_root_signature() {
     // CD3DX12_ROOT_SIGNATURE_DESC rs_desc(4, slotRootParameter, (UINT)samplers.size(), samplers.data(),
     //                                         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rs_desc;
-    rs_desc.Init_1_1(2, params, (UINT)samplers.size(), samplers.data(),
+    rs_desc.Init_1_1(3, params, (UINT)samplers.size(), samplers.data(),
                      D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     // create a root signature with a single slot which points to a descriptor range consisting of a single constant
@@ -895,8 +1390,11 @@ void App::build_root_signature() {
 void App::build_shaders_and_input_layout()
 {
     HRESULT hr = S_OK;
-    m_shader_byte_code.vs = d3d_util::compile_shader(L"shaders.hlsl", nullptr, "vert_shader", "vs_5_0");
-    m_shader_byte_code.ps = d3d_util::compile_shader(L"shaders.hlsl", nullptr, "pix_shader", "ps_5_0");
+    // 5.1 for the unbounded texture array.
+    m_shader_byte_code.vs = d3d_util::compile_shader(L"shaders.hlsl", nullptr, "vert_shader", "vs_5_1");
+    // A distance field isn't colors; its pixel shader turns distances into edges.
+    const char* pixel_shader = texture_source == TextureSource::distance_field ? "sdf_pix_shader" : "pix_shader";
+    m_shader_byte_code.ps = d3d_util::compile_shader(L"shaders.hlsl", nullptr, pixel_shader, "ps_5_1");
 
     m_input_layout = {
         // {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
@@ -907,17 +1405,8 @@ void App::build_shaders_and_input_layout()
 }
 
 void App::make_geo() {
-    // For a square 
-    // 0  1
-    // 3  2
-    std::array<Vertex, 4> vertices = {
-        Vertex({ XMFLOAT2(-0.7f,  0.7f), XMFLOAT2(0,0) }),
-        Vertex({ XMFLOAT2( 0.7f,  0.8f), XMFLOAT2(1,0) }),
-        Vertex({ XMFLOAT2( 0.6f, -0.7f), XMFLOAT2(1,1) }),
-        Vertex({ XMFLOAT2(-0.7f, -0.7f), XMFLOAT2(0,1) })
-    };
-
-    std::array<std::uint16_t, 6> indices = { 0,1,3,  1,2,3 };
+    const auto& vertices = quad_vertices;
+    const auto& indices = quad_indices;
 
     const uint32_t vbByteSize = vertices.size() * sizeof(Vertex);
     const uint32_t ibByteSize = (uint32_t)indices.size() * sizeof(std::uint16_t);
@@ -936,6 +1425,10 @@ void App::make_geo() {
 
     m_geo->ibuf_gpu = d3d_util::create_default_buffer(m_device.get(),
         m_command_list.get(), indices.data(), ibByteSize, m_geo->ibuf_uploader);
+    d3d_util::track_memory(m_memory, m_geo->vbuf_gpu.get(), gpu::MemoryCategory::geometry, "square vertices");
+    d3d_util::track_memory(m_memory, m_geo->ibuf_gpu.get(), gpu::MemoryCategory::geometry, "square indices");
+    d3d_util::track_memory(m_memory, m_geo->vbuf_uploader.get(), gpu::MemoryCategory::upload, "square vertex upload");
+    d3d_util::track_memory(m_memory, m_geo->ibuf_uploader.get(), gpu::MemoryCategory::upload, "square index upload");
 
     m_geo->vertex_stride = sizeof(Vertex);
     m_geo->vbuf_size = vbByteSize;
@@ -949,9 +1442,88 @@ void App::make_geo() {
     submesh.base_vertex = 0;
 
     m_geo->parts["square"] = submesh;
+    add_draw_item("square", submesh, submesh_bounds(vertices, indices, submesh));
 
 }
 
+void App::add_draw_item(const std::string& name, const SubmeshGeometry& submesh, const spatial::Bounds& bounds) {
+    DrawItem item;
+    item.name = name;
+    item.submesh = submesh;
+    item.proxy = m_scene_index.insert(bounds, uint32_t(m_draw_items.size()));
+    m_draw_items.push_back(std::move(item));
+}
+
+// The viewport's corners taken back through world_view_proj. Fine for the orthographic camera;
+// a perspective one would want the frustum's footprint on the drawing plane instead.
+spatial::Bounds App::view_bounds(const XMMATRIX& world_view_proj) {
+    XMMATRIX inverse = XMMatrixInverse(nullptr, world_view_proj);
+    XMStoreFloat4x4(&m_inv_world_view_proj, inverse);
+    spatial::Bounds b = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (float x : { -1.0f, 1.0f }) {
+        for (float y : { -1.0f, 1.0f }) {
+            XMFLOAT2 p;
+            XMStoreFloat2(&p, XMVector3TransformCoord(XMVectorSet(x, y, 0, 1), inverse));
+            b = spatial::merge(b, { p.x, p.y, p.x, p.y });
+        }
+    }
+    return b;
+}
+
+// A client area point on the drawing plane, through the last frame's camera.
+XMFLOAT2 App::screen_to_model(int x, int y) {
+    float ndc_x = 2.0f * x / std::max(m_client_width, 1) - 1.0f;
+    float ndc_y = 1.0f - 2.0f * y / std::max(m_client_height, 1);
+    XMFLOAT2 p;
+    XMStoreFloat2(&p, XMVector3TransformCoord(XMVectorSet(ndc_x, ndc_y, 0, 1), XMLoadFloat4x4(&m_inv_world_view_proj)));
+    return p;
+}
+
+// Logs what's under a click, by bounds.
+void App::hit_test(int x, int y) {
+    XMFLOAT2 p = screen_to_model(x, y);
+    std::vector<uint32_t> hits;
+    m_scene_index.query_point(p.x, p.y, hits);
+    for (uint32_t item : hits) {
+        debugf(L"hit {} at ({}, {})\n", std::wstring(m_draw_items[item].name.begin(), m_draw_items[item].name.end()),
+               p.x, p.y);
+    }
+}
+
+// Fills the ink layer from the texel under the click. The bounds only narrow it down; the point
+// has to be on one of the item's triangles.
+void App::paint_bucket(int x, int y) {
+    if (!m_layers) return;
+    XMFLOAT2 p = screen_to_model(x, y);
+    std::vector<uint32_t> hits;
+    m_scene_index.query_point(p.x, p.y, hits);
+    for (uint32_t item : hits) {
+        auto uv = submesh_texcoord(quad_vertices, quad_indices, m_draw_items[item].submesh, p);
+        if (!uv) continue;
+        auto& ink = m_layers->layer(1).pixels;
+        int tx = std::clamp(int(uv->x * ink.width()), 0, ink.width() - 1);
+        int ty = std::clamp(int(uv->y * ink.height()), 0, ink.height() - 1);
+        int64_t filled = canvas::flood_fill(ink, tx, ty, 0xff4080c0, 24);
+        m_ink_history->commit_stroke();
+        debugf(L"filled {} pixels from ({}, {})\n", filled, tx, ty);
+        return;
+    }
+}
+
+// One object per draw item, all sampling the current texture. Needs the root signature (for the
+// command signature's root constant), the draw items and m_texture_index.
+void App::build_indirect_draws() {
+    m_indirect = std::make_unique<gpu::IndirectDrawer>(m_device.get(), m_root_signature.get(), 1, m_memory);
+    std::vector<culling::ObjectBounds> bounds;
+    std::vector<culling::DrawArgs> args;
+    for (const auto& item : m_draw_items) {
+        const auto& b = m_scene_index.bounds(item.proxy);
+        bounds.push_back({ b.min_x, b.min_y, b.max_x, b.max_y });
+        args.push_back({ item.submesh.index_count, item.submesh.start_index, item.submesh.base_vertex, m_texture_index });
+    }
+    m_indirect->set_objects(bounds, args);
+}
+
 void App::build_pso() {
     D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc;
     ZeroMemory(&psoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
@@ -976,6 +1548,107 @@ void App::build_pso() {
     check_hresult(m_device->CreateGraphicsPipelineState(&psoDesc, __uuidof(m_pso), m_pso.put_void()));
 }
 
+// A few shapes over the square, in model space. The camera shows 2 units across the window's
+// height, which sets how fine the curves are flattened and how wide the anti-aliasing fringe is.
+void App::make_shape_geo() {
+    std::vector<shapes::Path> paths(4);
+    std::vector<shapes::ShapeDraw> draws;
+    paths[0].rounded_rect(-0.75f, -0.75f, 1.5f, 1.6f, 0.08f);
+    draws.push_back({ &paths[0], 0xff303030, shapes::FillRule::nonzero, shapes::Stroke{ 0.02f } });
+    paths[1].ellipse(0.45f, -0.45f, 0.15f, 0.1f);
+    draws.push_back({ &paths[1], 0xc0a06000, shapes::FillRule::nonzero, {} });
+    paths[2].move_to(-0.6f, -0.5f).cubic_to(-0.4f, -0.2f, -0.2f, -0.8f, 0.0f, -0.5f).quad_to(0.1f, -0.35f, 0.2f, -0.5f);
+    draws.push_back({ &paths[2], 0xff2020c0, shapes::FillRule::nonzero,
+                      shapes::Stroke{ 0.03f, shapes::LineJoin::round, shapes::LineCap::round } });
+    paths[3].move_to(0.3f, 0.6f).line_to(0.45f, 0.3f).line_to(0.6f, 0.6f).close();
+    draws.push_back({ &paths[3], 0xff008000, shapes::FillRule::nonzero,
+                      shapes::Stroke{ 0.02f, shapes::LineJoin::miter, shapes::LineCap::butt } });
+
+    shapes::TessellateOptions options;
+    options.pixel_size = 2.0f / std::max(m_client_height, 1);
+    std::vector<shapes::MeshRange> ranges;
+    shapes::Mesh mesh = shapes::tessellate(draws, options, ranges);
+
+    const uint32_t vbByteSize = uint32_t(mesh.vertices.size() * sizeof(shapes::ShapeVertex));
+    const uint32_t ibByteSize = uint32_t(mesh.indices.size() * sizeof(uint32_t));
+
+    m_shape_geo = std::make_unique<MeshGeometry>();
+    m_shape_geo->name = "shape_geo";
+
+    check_hresult(D3DCreateBlob(vbByteSize, m_shape_geo->vbuf_cpu.put()));
+    memcpy(m_shape_geo->vbuf_cpu->GetBufferPointer(), mesh.vertices.data(), vbByteSize);
+
+    check_hresult(D3DCreateBlob(ibByteSize, m_shape_geo->ibuf_cpu.put()));
+    memcpy(m_shape_geo->ibuf_cpu->GetBufferPointer(), mesh.indices.data(), ibByteSize);
+
+    m_shape_geo->vbuf_gpu = d3d_util::create_default_buffer(m_device.get(),
+        m_command_list.get(), mesh.vertices.data(), vbByteSize, m_shape_geo->vbuf_uploader);
+
+    m_shape_geo->ibuf_gpu = d3d_util::create_default_buffer(m_device.get(),
+        m_command_list.get(), mesh.indices.data(), ibByteSize, m_shape_geo->ibuf_uploader);
+    d3d_util::track_memory(m_memory, m_shape_geo->vbuf_gpu.get(), gpu::MemoryCategory::geometry, "shape vertices");
+    d3d_util::track_memory(m_memory, m_shape_geo->ibuf_gpu.get(), gpu::MemoryCategory::geometry, "shape indices");
+    d3d_util::track_memory(m_memory, m_shape_geo->vbuf_uploader.get(), gpu::MemoryCategory::upload,
+                           "shape vertex upload");
+    d3d_util::track_memory(m_memory, m_shape_geo->ibuf_uploader.get(), gpu::MemoryCategory::upload,
+                           "shape index upload");
+
+    m_shape_geo->vertex_stride = sizeof(shapes::ShapeVertex);
+    m_shape_geo->vbuf_size = vbByteSize;
+    m_shape_geo->index_format = DXGI_FORMAT_R32_UINT;
+    m_shape_geo->ibuf_size = ibByteSize;
+    m_shape_geo->index_count = uint32_t(mesh.indices.size());
+
+    const char* names[] = { "frame", "ellipse", "curve", "triangle" };
+    for (size_t i = 0; i < ranges.size(); i++) {
+        SubmeshGeometry submesh;
+        submesh.index_count = ranges[i].index_count;
+        submesh.start_index = ranges[i].start_index;
+        submesh.base_vertex = 0;
+        m_shape_geo->parts[names[i]] = submesh;
+    }
+}
+
+// Premultiplied colors blended over whatever's there, no depth test (the shapes are flat on the
+// drawing plane, where the square already wrote its depth) and no culling, since the tessellator
+// doesn't keep a winding order.
+void App::build_shape_pso() {
+    auto vs = d3d_util::compile_shader(L"shapes.hlsl", nullptr, "shape_vs", "vs_5_1");
+    auto ps = d3d_util::compile_shader(L"shapes.hlsl", nullptr, "shape_ps", "ps_5_1");
+    D3D12_INPUT_ELEMENT_DESC input_layout[] = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+    };
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc;
+    ZeroMemory(&psoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
+
+    psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+    psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    auto& blend = psoDesc.BlendState.RenderTarget[0];
+    blend.BlendEnable = TRUE;
+    blend.SrcBlend = D3D12_BLEND_ONE;
+    blend.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+    blend.SrcBlendAlpha = D3D12_BLEND_ONE;
+    blend.DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+    psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    psoDesc.DepthStencilState.DepthEnable = FALSE;
+    psoDesc.SampleMask = UINT_MAX;
+    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    psoDesc.NumRenderTargets = 1;
+    psoDesc.RTVFormats[0] = m_back_buffer_format;
+    psoDesc.SampleDesc.Count = m_4x_msaa_state ? 4 : 1;
+    psoDesc.SampleDesc.Quality = m_4x_msaa_state ? (m_4x_msaa_quality - 1) : 0;
+    psoDesc.DSVFormat = m_depth_stencil_format;
+
+    psoDesc.pRootSignature = m_root_signature.get();
+    psoDesc.VS = { reinterpret_cast<BYTE*>(vs->GetBufferPointer()), vs->GetBufferSize() };
+    psoDesc.PS = { reinterpret_cast<BYTE*>(ps->GetBufferPointer()), ps->GetBufferSize() };
+    psoDesc.InputLayout = { input_layout, _countof(input_layout) };
+    check_hresult(m_device->CreateGraphicsPipelineState(&psoDesc, __uuidof(m_shape_pso), m_shape_pso.put_void()));
+}
+
 
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> App::get_static_samplers() {
     // Applications usually only need a handful of samplers.  So just define them all up front
@@ -1077,6 +1750,7 @@ com_ptr<ID3D12Resource> App::draw_on_texture() {
                                            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, __uuidof(texture),
                                            texture.put_void());
     check_hresult(hr);
+    d3d_util::track_memory(m_memory, texture.get(), gpu::MemoryCategory::render_target, "direct2d texture");
     const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.get(), 0, 1);
 
     // Is that what to do? Create a wrapped resource for the texture ?
@@ -1126,6 +1800,454 @@ com_ptr<ID3D12Resource> App::draw_on_texture() {
     return texture;
 }
 
+// Same picture as draw_on_texture(), but built from CPU layers: paper, with a red outline on a
+// multiply layer over it (and a caption, with a font). The composite is what gets uploaded to m_texture3
+// and sampled.
+void App::build_layers() {
+    const int size = 256;
+    m_ink_history.reset();
+    m_layers = std::make_unique<canvas::LayerStack>(size, size);
+
+    auto& paper = m_layers->add_layer("paper");
+    paper.pixels.fill_rect(0, 0, size, size, 0xfff0f0f0);
+
+    auto& ink = m_layers->add_layer("ink");
+    const uint32_t red = 0xff0000ff;
+    ink.pixels.fill_rect(10, 10, 100, 11, red);
+    ink.pixels.fill_rect(10, 99, 100, 100, red);
+    ink.pixels.fill_rect(10, 10, 11, 100, red);
+    ink.pixels.fill_rect(99, 10, 100, 100, red);
+    m_layers->set_mode(1, pixel::BlendMode::multiply);
+
+    // A caption under the box, if the system font is where it usually is.
+    try {
+        auto font = text::TrueTypeFont::load("C:\\Windows\\Fonts\\arial.ttf");
+        text::TextStyle style = { m_fonts.add_font(std::move(font)), 14 };
+        m_glyphs = std::make_unique<text::GlyphCache>(m_fonts, 512, 512);
+        m_text_runs = std::make_unique<text::RunCache>(m_fonts, 256);
+        std::vector<text::GlyphQuad> quads;
+        m_glyphs->begin_frame();
+        text::emit_quads(*m_glyphs, m_text_runs->get("Draw on texture", style), style, 10, 120, red, quads);
+        text::draw_quads(ink.pixels, *m_glyphs, quads);
+    } catch (const std::runtime_error& e) {
+        std::string_view what = e.what();
+        debugf(L"no caption: {}\n", std::wstring(what.begin(), what.end()));
+    }
+
+    // What's there so far is the starting point, not something to undo.
+    m_ink_history = std::make_unique<canvas::UndoHistory>(ink.pixels, 64 * 1024 * 1024);
+}
+
+void App::build_layer_texture() {
+    build_layers();
+    const int size = m_layers->width();
+
+    D3D12_RESOURCE_DESC textureDesc = {};
+    textureDesc.MipLevels = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.Width = size;
+    textureDesc.Height = size;
+    textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    textureDesc.DepthOrArraySize = 1;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+    com_ptr<ID3D12Resource> texture;
+    CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_DEFAULT);
+    check_hresult(m_device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &textureDesc,
+                                                    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr,
+                                                    __uuidof(texture), texture.put_void()));
+    d3d_util::track_memory(m_memory, texture.get(), gpu::MemoryCategory::texture, "layer composite");
+
+    m_texture3 = std::move(texture);
+    upload_layer_tiles();
+}
+
+// The red box from draw_on_texture(), thicker, and a disc, as a 64x64 distance field: 4KB against
+// the 256KB of the RGBA bitmaps, and unlike them it's still sharp when the quad is scaled up.
+void App::build_distance_field_texture() {
+    const int size = 64;
+    const float scale = size / 256.0f;      // the shapes are in the 256x256 bitmaps' pixels
+    shapes::Path picture;
+    picture.rect(10, 10, 90, 90);
+    // The hole goes the other way round, so nonzero leaves it empty.
+    picture.move_to(18, 18).line_to(18, 92).line_to(92, 92).line_to(92, 18).close();
+    picture.ellipse(170, 170, 50, 50);
+    auto coverage = sdf::path_coverage(picture, size, size, scale);
+    sdf::DistanceFieldOptions options;
+    options.spread = 4;
+    sdf::DistanceField field = sdf::from_coverage(coverage.data(), size, size, size, options);
+
+    D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8_UNORM, field.width, field.height, 1, 1);
+    com_ptr<ID3D12Resource> texture;
+    CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_DEFAULT);
+    check_hresult(m_device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &desc,
+                                                    D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                                    __uuidof(texture), texture.put_void()));
+    d3d_util::track_memory(m_memory, texture.get(), gpu::MemoryCategory::texture, "distance field");
+
+    // Through its own command list, like the file texture, so it doesn't need m_command_list.
+    D3D12_SUBRESOURCE_DATA data = { field.pixels.data(), LONG_PTR(field.width), LONG_PTR(field.pixels.size()) };
+    DirectX::ResourceUploadBatch upload(m_device.get());
+    upload.Begin();
+    upload.Upload(texture.get(), 0, &data, 1);
+    upload.Transition(texture.get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    upload.End(m_command_queue.get()).wait();
+
+    m_texture4 = std::move(texture);
+}
+
+// Recomposites the layer stack and copies just the tiles that changed into m_texture3, with the
+// barriers around the copies. For startup; draw() does it as a render graph pass.
+void App::upload_layer_tiles() {
+    m_layers->update();
+    if (m_layers->composite().dirty_tiles().empty()) {
+        return;
+    }
+    capture::CommandRecorder cmd(m_command_list.get(), nullptr);
+    cmd.transition(m_texture3.get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+    copy_layer_tiles(cmd);
+    cmd.transition(m_texture3.get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
+// Copies the composite's dirty tiles into m_texture3, which has to be in COPY_DEST. The upload
+// buffer holds the whole texture in its placed footprint layout and each tile is a box copy out of
+// it. Writing into it here is safe only because draw() waits for the GPU every frame. It's made
+// on first use, and again after the memory budget has evicted it.
+void App::copy_layer_tiles(capture::CommandRecorder& cmd) {
+    auto& comp = m_layers->composite();
+    const auto& dirty = comp.dirty_tiles();
+    if (dirty.empty()) {
+        return;
+    }
+
+    auto desc = m_texture3->GetDesc();
+    if (!m_texture3_uploader) {
+        m_texture3_uploader = d3d_util::create_upload_buffer(m_device.get(),
+                                                             GetRequiredIntermediateSize(m_texture3.get(), 0, 1));
+        d3d_util::track_memory(m_memory, m_texture3_uploader.get(), gpu::MemoryCategory::upload, "layer upload");
+    }
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    m_device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, nullptr, nullptr, nullptr);
+
+    BYTE* mapped = nullptr;
+    check_hresult(m_texture3_uploader->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+
+    CD3DX12_TEXTURE_COPY_LOCATION dst(m_texture3.get(), 0);
+    CD3DX12_TEXTURE_COPY_LOCATION src(m_texture3_uploader.get(), footprint);
+    for (int index : dirty) {
+        uint32_t x0 = (index % comp.tiles_x()) * canvas::tile_size;
+        uint32_t y0 = (index / comp.tiles_x()) * canvas::tile_size;
+        uint32_t w = std::min<uint32_t>(canvas::tile_size, comp.width() - x0);
+        uint32_t h = std::min<uint32_t>(canvas::tile_size, comp.height() - y0);
+        const canvas::Tile* tile = comp.tile(index);
+        for (uint32_t y = 0; y < h; y++) {
+            BYTE* row = mapped + footprint.Offset + (y0 + y) * footprint.Footprint.RowPitch + x0 * 4;
+            if (tile) {
+                memcpy(row, tile->row(y), w * 4);
+            } else {
+                memset(row, 0, w * 4);
+            }
+        }
+        D3D12_BOX box = { x0, y0, 0, x0 + w, y0 + h, 1 };
+        cmd.copy_texture_region(m_texture3.get(), dst, x0, y0, m_texture3_uploader.get(), src, box);
+    }
+    m_texture3_uploader->Unmap(0, nullptr);
+    comp.clear_dirty();
+}
+
+// Blurs m_texture3 with BlurCompute: rows into one transient texture, columns into another, and
+// that copied back over the layers. The views go in this frame's part of the descriptor ring;
+// false if there was no room, and the texture is left unblurred.
+bool App::add_layer_blur(capture::CommandRecorder& cmd, gpu::RenderGraph& graph, gpu::ResourceHandle layers) {
+    uint32_t views = m_descriptors->allocate_transient(4);
+    if (views == gpu::invalid_descriptor) {
+        return false;
+    }
+    gpu::TransientDesc desc;
+    desc.width = uint32_t(m_layers->width());
+    desc.height = uint32_t(m_layers->height());
+    desc.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    auto rows = graph.create_texture("blur rows", desc);
+    auto blurred = graph.create_texture("blurred layers", desc);
+
+    // Typed RGBA8 textures, so the default views do. The dispatches go straight to the list, a
+    // capture has no compute; draw() leaves the blur out while capturing.
+    auto pass = [this, &cmd, &graph, views, desc](ID3D12Resource* source, gpu::ResourceHandle destination,
+                                                  uint32_t slot, bool vertical) {
+        m_device->CreateShaderResourceView(source, nullptr, m_descriptors->cpu(views + slot));
+        m_device->CreateUnorderedAccessView(m_transients->resource(graph, destination), nullptr, nullptr,
+                                            m_descriptors->cpu(views + slot + 1));
+        cmd.set_descriptor_heap(m_descriptors->heap());
+        m_blur->record_pass(cmd.list(), m_descriptors->gpu(views + slot), m_descriptors->gpu(views + slot + 1),
+                            desc.width, desc.height, vertical, m_blur_kernel);
+    };
+    graph.add_pass("blur rows", [this, pass, rows] { pass(m_texture3.get(), rows, 0, false); })
+        .read(layers, gpu::Access::compute_read)
+        .write(rows, gpu::Access::unordered);
+    graph.add_pass("blur columns", [this, &graph, pass, rows, blurred] {
+        pass(m_transients->resource(graph, rows), blurred, 2, true);
+    })
+        .read(rows, gpu::Access::compute_read)
+        .write(blurred, gpu::Access::unordered);
+    graph.add_pass("blur copy", [this, &cmd, &graph, blurred] {
+        cmd.copy_resource(m_texture3.get(), m_transients->resource(graph, blurred));
+    })
+        .read(blurred, gpu::Access::copy_src)
+        .write(layers, gpu::Access::copy_dst);
+    return true;
+}
+
+
+// One readback buffer per ring slot, each big enough for the whole back buffer in its copyable
+// footprint layout. They stay mapped; the ring only hands a slot's memory out after its fence.
+// Made by the first screenshot after startup, a resize or an eviction.
+void App::build_readback_ring() {
+    auto desc = current_back_buffer()->GetDesc();
+    UINT64 total_bytes = 0;
+    m_device->GetCopyableFootprints(&desc, 0, 1, 0, nullptr, nullptr, nullptr, &total_bytes);
+
+    std::vector<std::span<const uint8_t>> memory;
+    CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_READBACK);
+    auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(total_bytes);
+    for (auto& buffer : m_readback_buffers) {
+        buffer = nullptr;
+        check_hresult(m_device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &buffer_desc,
+                                                        D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                                        __uuidof(buffer), buffer.put_void()));
+        d3d_util::track_memory(m_memory, buffer.get(), gpu::MemoryCategory::readback, "screenshot readback");
+        uint8_t* mapped = nullptr;
+        check_hresult(buffer->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+        memory.emplace_back(mapped, total_bytes);
+    }
+    m_readback = std::make_unique<gpu::ReadbackRing>(std::move(memory));
+}
+
+// Saves whatever has finished and drops the readback buffers, unless a copy is still in flight.
+// Returns the bytes given back.
+uint64_t App::release_readback_ring() {
+    if (!m_readback) {
+        return 0;
+    }
+    collect_readbacks();
+    if (m_readback->in_flight() > 0) {
+        return 0;
+    }
+    uint64_t bytes = 0;
+    for (auto& buffer : m_readback_buffers) {
+        bytes += buffer->GetDesc().Width;
+        buffer = nullptr;
+    }
+    m_readback = nullptr;
+    return bytes;
+}
+
+// Called while the back buffer is still a render target. If every slot is busy the request stays
+// set and gets another go next frame.
+void App::record_screenshot(capture::CommandRecorder& cmd) {
+    if (!m_readback) {
+        build_readback_ring();
+    }
+    auto desc = current_back_buffer()->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    m_device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, nullptr, nullptr, nullptr);
+
+    gpu::ReadbackRegion region = { 0, 0, footprint.Footprint.Width, footprint.Footprint.Height };
+    int slot = m_readback->acquire(draw_count, region, footprint.Footprint.RowPitch);
+    if (slot < 0) {
+        return;
+    }
+
+    // The render graph has the back buffer in COPY_SOURCE for this pass.
+    CD3DX12_TEXTURE_COPY_LOCATION dst(m_readback_buffers[slot].get(), footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION src(current_back_buffer(), 0);
+    cmd.copy_texture(m_readback_buffers[slot].get(), dst, current_back_buffer(), src);
+
+    // flush_command_queue() signals the next fence value right after this frame's commands.
+    m_readback->submit(slot, m_current_fence + 1);
+    m_screenshot_requested = false;
+}
+
+// Copies finished readbacks out of their slots and hands them to the export thread, which does
+// the encoding. Only the row copy happens here.
+void App::collect_readbacks() {
+    if (m_readback) {
+        m_readback->collect(m_fence->GetCompletedValue(), [&](const gpu::ReadbackView& view) {
+            std::vector<uint32_t> pixels(size_t(view.region.width) * view.region.height);
+            for (uint32_t y = 0; y < view.region.height; y++) {
+                memcpy(pixels.data() + size_t(y) * view.region.width, view.data + y * view.row_pitch,
+                       view.region.width * 4);
+            }
+            m_exporter.save_png(std::format("screenshot_{}.png", view.tag), view.region.width,
+                                view.region.height, std::move(pixels));
+        });
+    }
+    for (const auto& result : m_exporter.take_results()) {
+        if (result.ok) {
+            debugf(L"saved {}\n", result.path.wstring());
+        } else {
+            debugf(L"couldn't save {}\n", result.path.wstring());
+        }
+    }
+}
+
+// Starts or stops writing frames to a capture file. A new capture starts with the vertex and index
+// data; constants go in every frame. Textures aren't captured, a replay only knows their sizes.
+void App::toggle_capture() {
+    if (m_capture) {
+        auto message = std::format("capture stopped: {} commands, {} bytes\n", m_capture->commands(),
+                                   m_capture->bytes_written());
+        m_capture = nullptr;
+        OutputDebugStringA(message.c_str());
+        return;
+    }
+    auto path = std::format("frames_{}.cap", draw_count);
+    std::shared_ptr<capture::FileSink> file;
+    try {
+        file = std::make_shared<capture::FileSink>(path);
+    } catch (const std::runtime_error& e) {
+        OutputDebugStringA(std::format("{}\n", e.what()).c_str());
+        return;
+    }
+    // Each frame is handed over in one piece and written on the sink's thread.
+    m_capture = std::make_unique<capture::Writer>([file](std::span<const uint8_t> bytes) { file->write(bytes); });
+    m_capture_needs_geometry = true;
+    OutputDebugStringA(std::format("capturing to {}\n", path).c_str());
+}
+
+void App::init_software() {
+    debugf(L"no D3D12 device, drawing in software\n");
+    m_software = std::make_unique<SoftwareRenderer>();
+    auto& sw = *m_software;
+    sw.device = std::make_unique<render::SoftwareDevice>(0,
+        [this](const uint32_t* pixels, uint32_t width, uint32_t height, render::Format) {
+            present_software(pixels, width, height);
+        });
+    sw.list = sw.device->create_command_list();
+    // Matches App's pipeline: default rasterizer and depth states, sampler s0 (point, wrap).
+    sw.pipeline = sw.device->create_pipeline({ offsetof(Vertex, pos), offsetof(Vertex, texc) });
+
+    auto bytes = [](const auto& a) {
+        return std::span(reinterpret_cast<const uint8_t*>(a.data()), a.size() * sizeof(a[0]));
+    };
+    sw.vertices = sw.device->create_buffer(sizeof(quad_vertices));
+    sw.device->write_buffer(sw.vertices, 0, bytes(quad_vertices));
+    sw.indices = sw.device->create_buffer(sizeof(quad_indices));
+    sw.device->write_buffer(sw.indices, 0, bytes(quad_indices));
+    sw.constants = sw.device->create_buffer(sizeof(ObjectConstants));
+
+    build_layers();
+    auto& comp = m_layers->composite();
+    sw.texture = sw.device->create_texture({ uint32_t(comp.width()), uint32_t(comp.height()),
+                                             render::Format::rgba8_unorm });
+}
+
+// The back buffer equivalent. BGRA so present can hand it to GDI as is.
+void App::resize_software() {
+    auto& sw = *m_software;
+    if (sw.color) sw.device->destroy(sw.color);
+    if (sw.depth) sw.device->destroy(sw.depth);
+    uint32_t width = std::max(m_client_width, 1);
+    uint32_t height = std::max(m_client_height, 1);
+    sw.color = sw.device->create_texture({ width, height, render::Format::bgra8_unorm });
+    sw.depth = sw.device->create_texture({ width, height, render::Format::d32_float });
+
+    m_screen_viewport = { 0, 0, float(width), float(height), 0, 1 };
+    m_scissor_rect = { 0, 0, LONG(width), LONG(height) };
+    auto P = DirectX::XMMatrixOrthographicLH(2, 2, -0.5, 1000.0f);
+    XMStoreFloat4x4(&m_proj, P);
+}
+
+void App::draw_software() {
+    draw_count++;
+    auto& sw = *m_software;
+
+    // Same dirty tile idea as upload_layer_tiles(), minus the upload buffer.
+    m_layers->update();
+    auto& comp = m_layers->composite();
+    static const std::vector<uint32_t> empty_tile(canvas::tile_pixels, 0);
+    for (int index : comp.dirty_tiles()) {
+        const canvas::Tile* tile = comp.tile(index);
+        uint32_t x0 = (index % comp.tiles_x()) * canvas::tile_size;
+        uint32_t y0 = (index / comp.tiles_x()) * canvas::tile_size;
+        uint32_t w = std::min<uint32_t>(canvas::tile_size, comp.width() - x0);
+        uint32_t h = std::min<uint32_t>(canvas::tile_size, comp.height() - y0);
+        sw.device->write_texture(sw.texture, x0, y0, w, h, tile ? tile->row(0) : empty_tile.data(),
+                                 canvas::tile_size * 4);
+    }
+    comp.clear_dirty();
+
+    auto& list = *sw.list;
+    const auto& v = m_screen_viewport;
+    list.reset();
+    list.set_render_target(sw.color, sw.depth);
+    list.set_viewport({ v.TopLeftX, v.TopLeftY, v.Width, v.Height, v.MinDepth, v.MaxDepth });
+    list.set_scissor({ m_scissor_rect.left, m_scissor_rect.top, m_scissor_rect.right, m_scissor_rect.bottom });
+    list.clear(sw.color, Colors::LightSteelBlue);
+    list.clear_depth(sw.depth, 1.0f);
+    list.set_pipeline(sw.pipeline);
+    list.set_vertex_buffer(sw.vertices, sizeof(Vertex));
+    list.set_index_buffer(sw.indices, render::Format::r16_uint);
+    list.set_constants(sw.constants);
+    list.set_texture(sw.texture);
+    list.draw_indexed(uint32_t(quad_indices.size()));
+    // It rasterizes inside submit(), which makes that the "GPU" part of the frame.
+    m_pacer.cpu_done();
+    sw.device->wait(sw.device->submit(list));
+
+    if (m_screenshot_requested) {
+        auto desc = sw.device->describe(sw.color);
+        std::vector<uint32_t> pixels(size_t(desc.width) * desc.height);
+        sw.device->read_texture(sw.color, pixels.data(), desc.width * 4);
+        pixel::swizzle_rgba_bgra(pixels.data(), pixels.data(), pixels.size());
+        m_exporter.save_png(std::format("screenshot_{}.png", draw_count), int(desc.width), int(desc.height),
+                            std::move(pixels));
+        m_screenshot_requested = false;
+    }
+    sw.device->present(sw.color);
+    m_software_flips->present(m_pacer.now());
+    m_pacer.gpu_done();
+    collect_readbacks();
+}
+
+void App::present_software(const uint32_t* pixels, uint32_t width, uint32_t height) {
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = LONG(width);
+    info.bmiHeader.biHeight = -LONG(height);    // top down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    HDC dc = GetDC(m_main_window_h);
+    StretchDIBits(dc, 0, 0, width, height, 0, 0, width, height, pixels, &info, DIB_RGB_COLORS, SRCCOPY);
+    ReleaseDC(m_main_window_h, dc);
+}
+
+// What the memory budget can take back when it's over, cheapest to make again first. Each one is
+// made again the next time it's needed.
+void App::add_evictors() {
+    m_memory->add_evictor("screenshot readback", 0, [this](uint64_t) {
+        return release_readback_ring();
+    });
+    m_memory->add_evictor("geometry upload", 0, [this](uint64_t) -> uint64_t {
+        // Only needed for the copy at startup, which finished long ago.
+        uint64_t bytes = 0;
+        for (MeshGeometry* geo : { m_geo.get(), m_shape_geo.get() }) {
+            if (!geo || !geo->vbuf_uploader) continue;
+            bytes += geo->vbuf_uploader->GetDesc().Width + geo->ibuf_uploader->GetDesc().Width;
+            geo->dispose_uploaders();
+        }
+        return bytes;
+    });
+    m_memory->add_evictor("layer upload", 1, [this](uint64_t) -> uint64_t {
+        if (!m_texture3_uploader) return 0;
+        uint64_t bytes = m_texture3_uploader->GetDesc().Width;
+        m_texture3_uploader = nullptr;
+        return bytes;
+    });
+}
+
 
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "D3D12.lib")
@@ -0,0 +1,313 @@
+module;
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "simd.h"
+
+export module canvas_filters;
+
+import tile_canvas;
+import filter_kernels;
+import blend_kernels;
+import half_float;
+
+// Blur, sharpen and drop shadow for a TileCanvas, built from the row kernels in filter_kernels.
+//
+// Blurs are separable: a horizontal pass over every row, then a vertical one. Small radii use a
+// real Gaussian kernel; past max_gaussian_radius (or when asked) three box blurs stand in for it,
+// which cost the same at any radius.
+//
+// apply_filter() works tile by tile, spread over threads. Each output tile is computed from the
+// source pixels around it out to the filter's reach (its halo), gathered from the neighbouring
+// tiles, with everything outside the canvas or in a null tile read as transparent. Results go to
+// new tiles that only replace the old ones once every tile is done, so no tile reads another's
+// output. Tiles with nothing but null tiles within reach stay null.
+
+namespace canvas {
+
+export enum class FilterKind {
+    blur,
+    sharpen,
+    drop_shadow,
+};
+
+export enum class BlurMethod {
+    automatic,      // Gaussian up to max_gaussian_radius, boxes past it
+    gaussian,
+    box,
+};
+
+export struct Filter {
+    FilterKind kind = FilterKind::blur;
+    float sigma = 2.0f;                 // blur size, as the Gaussian's standard deviation in pixels
+    BlurMethod method = BlurMethod::automatic;
+    float amount = 1.0f;                // sharpen: how far to push pixels away from the blur
+    int offset_x = 4;                   // drop shadow: where the shadow goes, in pixels
+    int offset_y = 4;
+    uint32_t color = 0x80000000;        // drop shadow colour, premultiplied
+};
+
+struct BlurPlan {
+    bool box = false;
+    pixel::GaussianKernel kernel;
+    std::array<int, 3> radii{};
+    int reach = 0;
+};
+
+BlurPlan plan_blur(float sigma, BlurMethod method) {
+    BlurPlan plan;
+    plan.box = method == BlurMethod::box ||
+               (method == BlurMethod::automatic && 3.0f * sigma > float(pixel::max_gaussian_radius));
+    if (plan.box) {
+        plan.radii = pixel::box_radii(sigma);
+        plan.reach = plan.radii[0] + plan.radii[1] + plan.radii[2];
+    } else {
+        plan.kernel = pixel::gaussian_kernel(sigma);
+        plan.reach = plan.kernel.radius;
+    }
+    return plan;
+}
+
+// How far from an output pixel the filter reads.
+export int filter_reach(const Filter& filter) {
+    int reach = plan_blur(filter.sigma, filter.method).reach;
+    if (filter.kind == FilterKind::drop_shadow) {
+        reach += std::max(std::abs(filter.offset_x), std::abs(filter.offset_y));
+    }
+    return reach;
+}
+
+// Buffers a thread reuses from tile to tile.
+struct Scratch {
+    std::vector<uint32_t> a;
+    std::vector<uint32_t> b;
+    std::vector<uint32_t> c;
+    std::vector<uint32_t> sums;
+    std::vector<const uint32_t*> taps;
+
+    uint32_t* get(std::vector<uint32_t>& v, size_t size) {
+        if (v.size() < size) v.resize(size);
+        return v.data();
+    }
+};
+
+// src is readable plan.reach pixels around [0, width) x [0, height).
+void blur(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, int width, int height,
+          const BlurPlan& plan, Scratch& scratch, simd::Level level) {
+    const int reach = plan.reach;
+    if (!plan.box) {
+        // Rows first, over the rows the vertical pass will read, into tmp (reach rows above and
+        // below the output).
+        const int taps = plan.kernel.tap_count();
+        const size_t rows = size_t(height) + 2 * reach;
+        uint32_t* tmp = scratch.get(scratch.a, size_t(width) * rows);
+        scratch.taps.resize(taps);
+        for (size_t y = 0; y < rows; y++) {
+            const uint32_t* row = src + (ptrdiff_t(y) - reach) * ptrdiff_t(src_pitch);
+            for (int t = 0; t < taps; t++) scratch.taps[t] = row + t - reach;
+            pixel::convolve_rgba8(tmp + y * width, scratch.taps.data(), plan.kernel.weights.data(), taps, width, level);
+        }
+        for (int y = 0; y < height; y++) {
+            for (int t = 0; t < taps; t++) scratch.taps[t] = tmp + size_t(y + t) * width;
+            pixel::convolve_rgba8(dst + y * dst_pitch, scratch.taps.data(), plan.kernel.weights.data(), taps, width,
+                                  level);
+        }
+        return;
+    }
+
+    // Three box passes each way, ping-ponging between a and b. Each pass needs its input to
+    // reach its own radius further out than its output, so the area shrinks by that much a pass.
+    const size_t pitch = size_t(width) + 2 * reach;
+    const size_t size = pitch * (size_t(height) + 2 * reach);
+    uint32_t* bufs[2] = { scratch.get(scratch.a, size), scratch.get(scratch.b, size) };
+    uint32_t* sums = scratch.get(scratch.sums, 4 * pitch);
+
+    // in points at x = 0 of the top row (y = -reach).
+    const uint32_t* in = src - reach * ptrdiff_t(src_pitch);
+    size_t in_pitch = src_pitch;
+    int rest = reach;
+    for (int k = 0; k < 3; k++) {
+        rest -= plan.radii[k];
+        uint32_t* out = bufs[k & 1];
+        pixel::box_rows_rgba8(out, pitch, in - rest, in_pitch, size_t(width) + 2 * rest, height + 2 * reach,
+                              plan.radii[k], level);
+        in = out + rest;
+        in_pitch = pitch;
+    }
+    // The rows ended up in bufs[0]; now in points at its top row, y = -reach.
+    rest = reach;
+    for (int k = 0; k < 3; k++) {
+        rest -= plan.radii[k];
+        const uint32_t* centre = in + plan.radii[k] * ptrdiff_t(pitch);
+        if (k == 2) {
+            pixel::box_columns_rgba8(dst, dst_pitch, centre, pitch, width, height, plan.radii[k], sums, level);
+        } else {
+            uint32_t* out = bufs[(k + 1) & 1];
+            pixel::box_columns_rgba8(out, pitch, centre, pitch, width, height + 2 * rest, plan.radii[k], sums, level);
+            in = out;
+        }
+    }
+}
+
+void filter(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, int width, int height,
+            const Filter& f, Scratch& scratch, simd::Level level) {
+    BlurPlan plan = plan_blur(f.sigma, f.method);
+    switch (f.kind) {
+    case FilterKind::blur:
+        blur(dst, dst_pitch, src, src_pitch, width, height, plan, scratch, level);
+        break;
+
+    case FilterKind::sharpen: {
+        uint32_t* blurred = scratch.get(scratch.c, size_t(width) * height);
+        blur(blurred, width, src, src_pitch, width, height, plan, scratch, level);
+        int32_t amount = std::clamp(int32_t(std::lround(f.amount * 256.0f)), 0, 16 * 256);
+        for (int y = 0; y < height; y++) {
+            pixel::unsharp_rgba8(dst + y * dst_pitch, src + y * src_pitch, blurred + size_t(y) * width, width,
+                                 amount, level);
+        }
+        break;
+    }
+
+    case FilterKind::drop_shadow: {
+        // The shadow is the colour wherever the source has alpha, blurred and moved by the
+        // offset; then the source goes over it. Tinting first means one RGBA blur does it.
+        const int reach = filter_reach(f);
+        const size_t pitch = size_t(width) + 2 * reach;
+        const size_t rows = size_t(height) + 2 * reach;
+        uint32_t* shadow = scratch.get(scratch.c, pitch * rows);
+        for (size_t y = 0; y < rows; y++) {
+            const uint32_t* s = src + (ptrdiff_t(y) - reach) * ptrdiff_t(src_pitch) - reach;
+            uint32_t* d = shadow + y * pitch;
+            for (size_t x = 0; x < pitch; x++) {
+                uint32_t a = s[x] >> 24;
+                uint32_t r = 0;
+                for (int c = 0; c < 4; c++) r |= pixel::mul255((f.color >> (8 * c)) & 0xff, a) << (8 * c);
+                d[x] = r;
+            }
+        }
+        const uint32_t* centre = shadow + size_t(reach - f.offset_y) * pitch + (reach - f.offset_x);
+        blur(dst, dst_pitch, centre, pitch, width, height, plan, scratch, level);
+        for (int y = 0; y < height; y++) {
+            pixel::blend_rgba8(pixel::BlendMode::source_over, dst + y * dst_pitch, src + y * src_pitch, width, 255,
+                               level);
+        }
+        break;
+    }
+    }
+}
+
+// Copies [x0, x0 + width) x [y0, y0 + height) out of the canvas, zeros outside it and for null tiles.
+void gather(const TileCanvas& canvas, int x0, int y0, int width, int height, uint32_t* out, size_t pitch) {
+    for (int y = 0; y < height; y++) {
+        uint32_t* row = out + y * pitch;
+        int cy = y0 + y;
+        if (cy < 0 || cy >= canvas.height()) {
+            std::fill(row, row + width, 0u);
+            continue;
+        }
+        int x = 0;
+        while (x < width) {
+            int cx = x0 + x;
+            if (cx < 0 || cx >= canvas.width()) {
+                int end = cx < 0 ? std::min(width, -x0) : width;
+                std::fill(row + x, row + end, 0u);
+                x = end;
+                continue;
+            }
+            int span = std::min({ tile_size - cx % tile_size, canvas.width() - cx, width - x });
+            const Tile* t = canvas.tile(canvas.tile_index(cx / tile_size, cy / tile_size));
+            if (t) {
+                memcpy(row + x, t->row(cy % tile_size) + cx % tile_size, span * sizeof(uint32_t));
+            } else {
+                std::fill(row + x, row + x + span, 0u);
+            }
+            x += span;
+        }
+    }
+}
+
+// Filters a plain image. src has to be readable filter_reach(f) pixels around
+// [0, width) x [0, height); dst can't overlap it.
+export void filter_rgba8(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, int width,
+                         int height, const Filter& f, simd::Level level = simd::Level::avx2) {
+    Scratch scratch;
+    filter(dst, dst_pitch, src, src_pitch, width, height, f, scratch, simd::usable_level(level));
+}
+
+// Filters the whole canvas in place. threads = 0 uses every core.
+export void apply_filter(TileCanvas& canvas, const Filter& f, unsigned threads = 0,
+                         simd::Level level = simd::Level::avx2) {
+    level = simd::usable_level(level);
+    const int reach = filter_reach(f);
+    const int halo_tiles = (reach + tile_size - 1) / tile_size;
+
+    // Only tiles with something within reach can change.
+    auto near_content = [&](int tx, int ty) {
+        for (int ny = std::max(ty - halo_tiles, 0); ny <= std::min(ty + halo_tiles, canvas.tiles_y() - 1); ny++) {
+            for (int nx = std::max(tx - halo_tiles, 0); nx <= std::min(tx + halo_tiles, canvas.tiles_x() - 1); nx++) {
+                if (canvas.tile(canvas.tile_index(nx, ny))) return true;
+            }
+        }
+        return false;
+    };
+    std::vector<int> work;
+    for (int ty = 0; ty < canvas.tiles_y(); ty++) {
+        for (int tx = 0; tx < canvas.tiles_x(); tx++) {
+            if (near_content(tx, ty)) work.push_back(canvas.tile_index(tx, ty));
+        }
+    }
+    if (work.empty()) return;
+
+    // A null result means the tile came out empty.
+    std::vector<std::unique_ptr<Tile>> results(work.size());
+    std::atomic<size_t> next = 0;
+    auto run = [&] {
+        Scratch scratch;
+        std::vector<uint32_t> source;
+        const size_t pitch = tile_size + 2 * reach;
+        source.resize(pitch * pitch);
+        for (size_t i = next++; i < work.size(); i = next++) {
+            int index = work[i];
+            int x0 = index % canvas.tiles_x() * tile_size;
+            int y0 = index / canvas.tiles_x() * tile_size;
+            // Pixels past the canvas edge stay zero.
+            int width = std::min(tile_size, canvas.width() - x0);
+            int height = std::min(tile_size, canvas.height() - y0);
+            gather(canvas, x0 - reach, y0 - reach, width + 2 * reach, height + 2 * reach, source.data(), pitch);
+            auto out = std::make_unique<Tile>();
+            filter(out->pixels.data(), tile_size, source.data() + reach * pitch + reach, pitch, width, height, f,
+                   scratch, level);
+            bool empty = std::all_of(out->pixels.begin(), out->pixels.end(), [](uint32_t p) { return p == 0; });
+            if (!empty) results[i] = std::move(out);
+        }
+    };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, unsigned(work.size()));
+    {
+        std::vector<std::jthread> pool;
+        for (unsigned t = 1; t < threads; t++) pool.emplace_back(run);
+        run();
+    }
+
+    // Through mutable_tile() so the change shows up as touched (for undo) and dirty.
+    for (size_t i = 0; i < work.size(); i++) {
+        int index = work[i];
+        if (results[i]) {
+            canvas.mutable_tile(index).pixels = results[i]->pixels;
+        } else if (canvas.tile(index)) {
+            canvas.mutable_tile(index).pixels.fill(0);
+        }
+    }
+}
+
+}
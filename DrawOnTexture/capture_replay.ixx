@@ -0,0 +1,327 @@
+module;
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+export module capture_replay;
+
+import frame_capture;
+import render_device;
+
+// Plays a frame capture on a render::Device, so a frame recorded on a machine with D3D12 can be
+// drawn again on one without it (software_device) and looked at.
+//
+// A capture only has what the device interface can't find out for itself: resource sizes and
+// formats, the buffer contents the CPU wrote, and the commands. Textures' contents aren't in it,
+// so every draw samples a checkerboard. Compute work isn't captured either. The app's one pipeline
+// is the textured quad, which is what render::Device has, so every pipeline id maps to it.
+//
+// Captures come from files, so nothing in one is trusted: a command that names a resource that
+// isn't there, or a draw that would read past the end of a buffer, is skipped and counted rather
+// than handed to the device.
+
+namespace capture {
+
+// DXGI_FORMAT values the app uses.
+constexpr uint32_t dxgi_r32g8x24_typeless = 19;
+constexpr uint32_t dxgi_d32_float_s8x24_uint = 20;
+constexpr uint32_t dxgi_r32_typeless = 39;
+constexpr uint32_t dxgi_d32_float = 40;
+constexpr uint32_t dxgi_r32_uint = 42;
+constexpr uint32_t dxgi_r24g8_typeless = 44;
+constexpr uint32_t dxgi_d24_unorm_s8_uint = 45;
+constexpr uint32_t dxgi_r16_uint = 57;
+constexpr uint32_t dxgi_b8g8r8a8_unorm = 87;
+constexpr uint32_t dxgi_b8g8r8a8_unorm_srgb = 91;
+
+constexpr uint32_t triangle_list = 4;   // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+constexpr uint32_t max_texture_size = 16384;
+constexpr uint64_t max_buffer_size = uint64_t(1) << 30;
+constexpr uint32_t checker_size = 64;
+
+// Every texture here is 4 bytes a texel; depth formats become d32, everything else RGBA8.
+render::Format device_format(uint32_t dxgi) {
+    switch (dxgi) {
+    case dxgi_r32g8x24_typeless:
+    case dxgi_d32_float_s8x24_uint:
+    case dxgi_r32_typeless:
+    case dxgi_d32_float:
+    case dxgi_r24g8_typeless:
+    case dxgi_d24_unorm_s8_uint:
+        return render::Format::d32_float;
+    case dxgi_b8g8r8a8_unorm:
+    case dxgi_b8g8r8a8_unorm_srgb:
+        return render::Format::bgra8_unorm;
+    default:
+        return render::Format::rgba8_unorm;
+    }
+}
+
+export struct DeviceReplayStats {
+    uint64_t frames = 0;
+    uint64_t draws = 0;
+    uint64_t skipped = 0;       // commands the device couldn't be given
+};
+
+export class DeviceBackend : public Backend {
+public:
+    // present says whether end_frame presents the frame's render target.
+    explicit DeviceBackend(render::Device& device, bool present = true)
+        : m_device(device), m_present(present), m_list(device.create_command_list())
+    {
+        m_pipeline = device.create_pipeline({});
+        std::vector<uint32_t> checker(checker_size * checker_size);
+        for (uint32_t y = 0; y < checker_size; y++) {
+            for (uint32_t x = 0; x < checker_size; x++) {
+                checker[y * checker_size + x] = ((x / 8 + y / 8) & 1) ? 0xffc0c0c0u : 0xff404040u;
+            }
+        }
+        m_checker = device.create_texture({ checker_size, checker_size, render::Format::rgba8_unorm });
+        device.write_texture(m_checker, 0, 0, checker_size, checker_size, checker.data(), checker_size * 4);
+    }
+
+    ~DeviceBackend() override {
+        for (auto& [id, r] : m_resources) destroy(r);
+        for (auto& r : m_dead) destroy(r);
+        m_device.destroy(m_checker);
+    }
+
+    DeviceBackend(const DeviceBackend&) = delete;
+    DeviceBackend& operator=(const DeviceBackend&) = delete;
+
+    const DeviceReplayStats& stats() const { return m_stats; }
+
+    // The device texture a capture resource became, or none.
+    render::Texture texture(ObjectId id) const {
+        auto it = m_resources.find(id);
+        return it != m_resources.end() ? it->second.texture : render::Texture{};
+    }
+
+    // The render target of the last frame that finished.
+    render::Texture last_frame() const { return m_last_frame; }
+
+    void execute(const BeginFrame&) override {
+        m_list->reset();
+        m_state = {};
+        m_list->set_pipeline(m_pipeline);
+        m_list->set_texture(m_checker);
+    }
+
+    void execute(const EndFrame&) override {
+        m_device.wait(m_device.submit(*m_list));
+        m_list->reset();
+        for (auto& r : m_dead) destroy(r);
+        m_dead.clear();
+        m_stats.frames++;
+        if (m_state.color) {
+            m_last_frame = m_state.color;
+            if (m_present) m_device.present(m_state.color);
+        }
+    }
+
+    void execute(const DeclareResource& c) override {
+        Resource r;
+        r.desc = c;
+        if (c.kind == ResourceKind::buffer && c.width > 0 && c.width <= max_buffer_size) {
+            r.buffer = m_device.create_buffer(size_t(c.width));
+            r.shadow.resize(size_t(c.width));
+        } else if (c.kind == ResourceKind::texture2d && c.width > 0 && c.width <= max_texture_size &&
+                   c.height > 0 && c.height <= max_texture_size) {
+            r.texture = m_device.create_texture({ uint32_t(c.width), c.height, device_format(c.format) });
+        } else {
+            m_stats.skipped++;
+            return;
+        }
+        // A released object's address can come back as a new declaration with the same id. The
+        // old one may be named by commands already in the list, so it goes after the submit.
+        auto old = m_resources.find(c.id);
+        if (old != m_resources.end()) {
+            unbind(c.id, old->second);
+            m_dead.push_back(std::move(old->second));
+        }
+        m_resources[c.id] = std::move(r);
+    }
+
+    // Buffers only; the CPU never writes the app's textures through a capture.
+    void execute(const Upload& c, std::span<const uint8_t> data) override {
+        Resource* r = find(c.resource);
+        if (!r || !r->buffer || c.offset > r->shadow.size() || data.size() > r->shadow.size() - c.offset) {
+            m_stats.skipped++;
+            return;
+        }
+        m_device.write_buffer(r->buffer, size_t(c.offset), data);
+        memcpy(r->shadow.data() + c.offset, data.data(), data.size());
+    }
+
+    void execute(const ClearColor& c) override {
+        Resource* r = find(c.target);
+        if (!r || !r->texture || device_format(r->desc.format) == render::Format::d32_float) {
+            m_stats.skipped++;
+            return;
+        }
+        m_list->clear(r->texture, c.color);
+    }
+
+    void execute(const ClearDepth& c) override {
+        Resource* r = find(c.target);
+        if (!r || !r->texture || device_format(r->desc.format) != render::Format::d32_float) {
+            m_stats.skipped++;
+            return;
+        }
+        m_list->clear_depth(r->texture, c.depth);
+    }
+
+    void execute(const Viewport& c) override {
+        m_list->set_viewport({ c.x, c.y, c.width, c.height, c.min_depth, c.max_depth });
+    }
+
+    void execute(const Scissor& c) override { m_list->set_scissor({ c.left, c.top, c.right, c.bottom }); }
+
+    void execute(const RenderTargets& c) override {
+        Resource* color = find(c.color);
+        Resource* depth = find(c.depth);
+        m_state.color = color && color->texture ? color->texture : render::Texture{};
+        m_state.depth_resource = depth && depth->texture ? c.depth : 0;
+        render::Texture depth_texture;
+        if (m_state.color && m_state.depth_resource) {
+            // The depth buffer has to match the target's size to be usable.
+            auto cd = m_device.describe(m_state.color);
+            auto dd = m_device.describe(depth->texture);
+            if (cd.width == dd.width && cd.height == dd.height) depth_texture = depth->texture;
+        }
+        m_list->set_render_target(m_state.color, depth_texture);
+    }
+
+    void execute(const VertexBuffer& c) override {
+        Resource* r = find(c.resource);
+        m_state.vertices = r && r->buffer && c.stride > 0 ? c.resource : 0;
+        m_state.vertex = c;
+        if (m_state.vertices) m_list->set_vertex_buffer(r->buffer, c.stride, c.offset);
+    }
+
+    void execute(const IndexBuffer& c) override {
+        Resource* r = find(c.resource);
+        bool format_ok = c.format == dxgi_r16_uint || c.format == dxgi_r32_uint;
+        m_state.indices = r && r->buffer && format_ok ? c.resource : 0;
+        m_state.index = c;
+        if (m_state.indices) {
+            m_list->set_index_buffer(r->buffer, c.format == dxgi_r16_uint ? render::Format::r16_uint
+                                                                          : render::Format::r32_uint, c.offset);
+        }
+    }
+
+    void execute(const Topology& c) override { m_state.topology = c.topology; }
+
+    void execute(const RootTable& c) override {
+        Resource* r = find(c.resource);
+        if (r && r->buffer && r->shadow.size() >= 64) {
+            m_state.constants = c.resource;
+            m_list->set_constants(r->buffer);
+        }
+    }
+
+    void execute(const DrawIndexed& c) override {
+        if (!draw_is_safe(c)) {
+            m_stats.skipped++;
+            return;
+        }
+        // Every instance would land in the same place; the pipeline has no per instance data.
+        m_list->draw_indexed(c.index_count, c.start_index, c.base_vertex);
+        m_stats.draws++;
+    }
+
+    // Whole texture copies only; the device has no region copies, and copies into buffers are
+    // readbacks nobody looks at here.
+    void execute(const CopyRegion& c) override {
+        Resource* dst = find(c.dst);
+        Resource* src = find(c.src);
+        bool whole = dst && src && dst->texture && src->texture && c.left == 0 && c.top == 0 &&
+                     c.dst_x == 0 && c.dst_y == 0 && c.right == src->desc.width && c.bottom == src->desc.height &&
+                     dst->desc.width == src->desc.width && dst->desc.height == src->desc.height &&
+                     device_format(dst->desc.format) == device_format(src->desc.format);
+        if (!whole) {
+            m_stats.skipped++;
+            return;
+        }
+        m_list->copy_texture(dst->texture, src->texture);
+    }
+
+private:
+    struct Resource {
+        DeclareResource desc = {};
+        render::Buffer buffer;
+        render::Texture texture;
+        std::vector<uint8_t> shadow;     // buffer contents, for checking draws against
+    };
+
+    struct State {
+        render::Texture color;
+        ObjectId depth_resource = 0;
+        ObjectId vertices = 0;
+        ObjectId indices = 0;
+        ObjectId constants = 0;
+        VertexBuffer vertex = {};
+        IndexBuffer index = {};
+        uint32_t topology = triangle_list;
+    };
+
+    void destroy(Resource& r) {
+        if (r.buffer) m_device.destroy(r.buffer);
+        if (r.texture) m_device.destroy(r.texture);
+        if (r.texture && r.texture.index == m_last_frame.index) m_last_frame = {};
+    }
+
+    // Draws after this need the new resource bound again before they can run.
+    void unbind(ObjectId id, const Resource& r) {
+        if (r.texture && m_state.color.index == r.texture.index) m_state.color = {};
+        for (ObjectId* bound : { &m_state.vertices, &m_state.indices, &m_state.constants }) {
+            if (*bound == id) *bound = 0;
+        }
+    }
+
+    Resource* find(ObjectId id) {
+        auto it = id ? m_resources.find(id) : m_resources.end();
+        return it != m_resources.end() ? &it->second : nullptr;
+    }
+
+    // Everything the draw reads is bound and in range: each index, and the vertex it picks.
+    bool draw_is_safe(const DrawIndexed& c) {
+        if (!m_state.color || !m_state.vertices || !m_state.indices || !m_state.constants ||
+            m_state.topology != triangle_list) {
+            return false;
+        }
+        const auto& ib = find(m_state.indices)->shadow;
+        const auto& vb = find(m_state.vertices)->shadow;
+        uint32_t index_bytes = m_state.index.format == dxgi_r16_uint ? 2 : 4;
+        uint64_t first = m_state.index.offset + uint64_t(c.start_index) * index_bytes;
+        if (first + uint64_t(c.index_count) * index_bytes > ib.size()) return false;
+        for (uint32_t i = 0; i < c.index_count; i++) {
+            uint32_t index = 0;
+            memcpy(&index, ib.data() + first + uint64_t(i) * index_bytes, index_bytes);
+            int64_t vertex = int64_t(index) + c.base_vertex;
+            // position and uv, 16 bytes from the start of the vertex
+            if (vertex < 0 || m_state.vertex.offset + uint64_t(vertex) * m_state.vertex.stride + 16 > vb.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    render::Device& m_device;
+    bool m_present;
+    std::unique_ptr<render::CommandList> m_list;
+    render::Pipeline m_pipeline;
+    render::Texture m_checker;
+    render::Texture m_last_frame;
+    std::unordered_map<ObjectId, Resource> m_resources;
+    std::vector<Resource> m_dead;       // replaced during the frame, destroyed after it
+    State m_state;
+    DeviceReplayStats m_stats;
+};
+
+}
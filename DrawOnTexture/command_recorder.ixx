@@ -0,0 +1,202 @@
+module;
+
+#include <windows.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+#include <unknwn.h>
+#include <winrt/base.h>
+#include <cstdint>
+#include <span>
+
+export module command_recorder;
+
+import frame_capture;
+
+// The command list calls draw() makes, passed straight through to D3D and also written to a
+// frame_capture::Writer when there is one. With no writer it's a pointer check per call.
+//
+// Commands that name render targets and buffers by descriptor handle or GPU address also take the
+// resource, since a capture has to say what was drawn into without D3D around to ask.
+
+namespace capture {
+
+export class CommandRecorder {
+public:
+    CommandRecorder(ID3D12GraphicsCommandList* list, Writer* writer)
+        : m_list(list), m_writer(writer) {}
+
+    ID3D12GraphicsCommandList* list() const { return m_list; }
+    bool capturing() const { return m_writer != nullptr; }
+
+    void begin_frame(uint64_t frame) {
+        if (m_writer) m_writer->record(BeginFrame{ frame });
+    }
+
+    void end_frame(uint64_t frame) {
+        if (m_writer) m_writer->record(EndFrame{ frame });
+    }
+
+    // Contents the GPU reads that were written from the CPU (mapped constants, geometry), so a
+    // replay sees the same data. Recording only; nothing goes to the command list.
+    void upload(ID3D12Resource* resource, uint64_t offset, const void* data, size_t size) {
+        if (!m_writer) return;
+        m_writer->upload(id(resource), offset, std::span(static_cast<const uint8_t*>(data), size));
+    }
+
+    void transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+        auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after);
+        m_list->ResourceBarrier(1, &barrier);
+        if (m_writer) m_writer->record(Barrier{ id(resource), uint32_t(before), uint32_t(after) });
+    }
+
+    // Several at once in one ResourceBarrier call. Aliasing barriers aren't captured; a replay has
+    // no heaps for resources to share.
+    void barriers(std::span<const D3D12_RESOURCE_BARRIER> barriers) {
+        if (barriers.empty()) return;
+        m_list->ResourceBarrier(UINT(barriers.size()), barriers.data());
+        if (!m_writer) return;
+        for (const auto& b : barriers) {
+            if (b.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION) continue;
+            const auto& t = b.Transition;
+            m_writer->record(Barrier{ id(t.pResource), uint32_t(t.StateBefore), uint32_t(t.StateAfter) });
+        }
+    }
+
+    void clear_render_target(ID3D12Resource* target, D3D12_CPU_DESCRIPTOR_HANDLE rtv, const float color[4]) {
+        m_list->ClearRenderTargetView(rtv, color, 0, nullptr);
+        if (m_writer) m_writer->record(ClearColor{ id(target), { color[0], color[1], color[2], color[3] } });
+    }
+
+    void clear_depth_stencil(ID3D12Resource* target, D3D12_CPU_DESCRIPTOR_HANDLE dsv, float depth, uint8_t stencil) {
+        m_list->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
+        if (m_writer) m_writer->record(ClearDepth{ id(target), depth, stencil });
+    }
+
+    void set_viewport(const D3D12_VIEWPORT& v) {
+        m_list->RSSetViewports(1, &v);
+        if (m_writer) m_writer->record(Viewport{ v.TopLeftX, v.TopLeftY, v.Width, v.Height, v.MinDepth, v.MaxDepth });
+    }
+
+    void set_scissor(const D3D12_RECT& r) {
+        m_list->RSSetScissorRects(1, &r);
+        if (m_writer) m_writer->record(Scissor{ r.left, r.top, r.right, r.bottom });
+    }
+
+    void set_render_target(ID3D12Resource* color, D3D12_CPU_DESCRIPTOR_HANDLE rtv,
+                           ID3D12Resource* depth, D3D12_CPU_DESCRIPTOR_HANDLE dsv) {
+        m_list->OMSetRenderTargets(1, &rtv, true, &dsv);
+        if (m_writer) m_writer->record(RenderTargets{ id(color), id(depth) });
+    }
+
+    void set_descriptor_heap(ID3D12DescriptorHeap* heap) {
+        m_list->SetDescriptorHeaps(1, &heap);
+        m_heap_start = heap->GetGPUDescriptorHandleForHeapStart().ptr;
+        winrt::com_ptr<ID3D12Device> device;
+        winrt::check_hresult(heap->GetDevice(__uuidof(device), device.put_void()));
+        m_increment = device->GetDescriptorHandleIncrementSize(heap->GetDesc().Type);
+    }
+
+    void set_pipeline(ID3D12PipelineState* pso) {
+        m_list->SetPipelineState(pso);
+        if (m_writer) m_writer->record(Pipeline{ m_writer->object(pso) });
+    }
+
+    void set_root_signature(ID3D12RootSignature* root) {
+        m_list->SetGraphicsRootSignature(root);
+        if (m_writer) m_writer->record(RootSignature{ m_writer->object(root) });
+    }
+
+    void set_vertex_buffer(ID3D12Resource* buffer, const D3D12_VERTEX_BUFFER_VIEW& view) {
+        m_list->IASetVertexBuffers(0, 1, &view);
+        if (m_writer) {
+            auto offset = uint32_t(view.BufferLocation - buffer->GetGPUVirtualAddress());
+            m_writer->record(VertexBuffer{ id(buffer), view.SizeInBytes, view.StrideInBytes, offset });
+        }
+    }
+
+    void set_index_buffer(ID3D12Resource* buffer, const D3D12_INDEX_BUFFER_VIEW& view) {
+        m_list->IASetIndexBuffer(&view);
+        if (m_writer) {
+            auto offset = uint32_t(view.BufferLocation - buffer->GetGPUVirtualAddress());
+            m_writer->record(IndexBuffer{ id(buffer), view.SizeInBytes, uint32_t(view.Format), offset });
+        }
+    }
+
+    void set_topology(D3D12_PRIMITIVE_TOPOLOGY topology) {
+        m_list->IASetPrimitiveTopology(topology);
+        if (m_writer) m_writer->record(Topology{ uint32_t(topology) });
+    }
+
+    // table has to be in the heap given to set_descriptor_heap(). For a constant buffer table, pass
+    // the buffer too so a replay can bind it.
+    void set_root_table(uint32_t param, D3D12_GPU_DESCRIPTOR_HANDLE table, ID3D12Resource* constants = nullptr) {
+        m_list->SetGraphicsRootDescriptorTable(param, table);
+        if (m_writer) {
+            auto descriptor = uint32_t((table.ptr - m_heap_start) / m_increment);
+            m_writer->record(RootTable{ param, descriptor, id(constants) });
+        }
+    }
+
+    void set_root_constant(uint32_t param, uint32_t value, uint32_t offset = 0) {
+        m_list->SetGraphicsRoot32BitConstant(param, value, offset);
+        if (m_writer) m_writer->record(RootConstant{ param, value, offset });
+    }
+
+    void draw_indexed(uint32_t index_count, uint32_t instance_count = 1, uint32_t start_index = 0,
+                      int32_t base_vertex = 0, uint32_t start_instance = 0) {
+        m_list->DrawIndexedInstanced(index_count, instance_count, start_index, base_vertex, start_instance);
+        if (m_writer) {
+            m_writer->record(DrawIndexed{ index_count, instance_count, start_index, base_vertex, start_instance });
+        }
+    }
+
+    // Whole subresource 0 of src into dst at (0, 0); dst may be a buffer in footprint layout.
+    void copy_texture(ID3D12Resource* dst, const D3D12_TEXTURE_COPY_LOCATION& dst_location,
+                      ID3D12Resource* src, const D3D12_TEXTURE_COPY_LOCATION& src_location) {
+        m_list->CopyTextureRegion(&dst_location, 0, 0, 0, &src_location, nullptr);
+        if (m_writer) {
+            auto desc = src->GetDesc();
+            m_writer->record(CopyRegion{ id(dst), id(src), 0, 0, 0, 0, uint32_t(desc.Width), desc.Height });
+        }
+    }
+
+    // A box of src into dst at (x, y), eg. a tile out of an upload buffer in footprint layout.
+    void copy_texture_region(ID3D12Resource* dst, const D3D12_TEXTURE_COPY_LOCATION& dst_location, uint32_t x,
+                             uint32_t y, ID3D12Resource* src, const D3D12_TEXTURE_COPY_LOCATION& src_location,
+                             const D3D12_BOX& box) {
+        m_list->CopyTextureRegion(&dst_location, x, y, 0, &src_location, &box);
+        if (m_writer) {
+            m_writer->record(CopyRegion{ id(dst), id(src), x, y, box.left, box.top, box.right, box.bottom });
+        }
+    }
+
+    // Same size and format.
+    void copy_resource(ID3D12Resource* dst, ID3D12Resource* src) {
+        m_list->CopyResource(dst, src);
+        if (m_writer) {
+            auto desc = src->GetDesc();
+            m_writer->record(CopyRegion{ id(dst), id(src), 0, 0, 0, 0, uint32_t(desc.Width), desc.Height });
+        }
+    }
+
+private:
+    // Declares the resource the first time a capture sees it.
+    ObjectId id(ID3D12Resource* resource) {
+        if (!resource) return 0;
+        auto desc = resource->GetDesc();
+        DeclareResource decl = {};
+        decl.kind = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? ResourceKind::buffer : ResourceKind::texture2d;
+        decl.width = desc.Width;
+        decl.height = desc.Height;
+        decl.format = uint32_t(desc.Format);
+        ObjectId known = m_writer->find(resource, decl);
+        return known ? known : m_writer->declare(resource, decl);
+    }
+
+    ID3D12GraphicsCommandList* m_list;
+    Writer* m_writer;
+    UINT64 m_heap_start = 0;
+    uint32_t m_increment = 1;
+};
+
+}
@@ -0,0 +1,87 @@
+// The GPU side of cull_kernels.ixx: one thread per object, tested against the view and compacted
+// into the ExecuteIndirect argument buffer. Same structs and same steps as culling::cull_draws().
+// Each group scans its visible flags so its draws stay in object order, then takes a run of slots
+// with one atomic. Groups finish in any order, so unlike the CPU version the whole list isn't.
+
+struct ObjectBounds
+{
+    float2 lo;
+    float2 hi;
+};
+
+struct DrawArgs
+{
+    uint index_count;
+    uint start_index;
+    int base_vertex;
+    uint texture;
+};
+
+// The command signature: gTextureIndex, then D3D12_DRAW_INDEXED_ARGUMENTS.
+struct IndirectDraw
+{
+    uint texture;
+    uint index_count;
+    uint instance_count;
+    uint start_index;
+    int base_vertex;
+    uint start_instance;
+};
+
+cbuffer cbCull : register(b0)
+{
+    float2 gViewMin;
+    float2 gViewMax;
+    uint gObjectCount;
+};
+
+StructuredBuffer<ObjectBounds> gBounds : register(t0);
+StructuredBuffer<DrawArgs> gArgs : register(t1);
+RWStructuredBuffer<IndirectDraw> gDraws : register(u0);
+RWByteAddressBuffer gDrawCount : register(u1);     // zeroed before the dispatch
+
+#define GROUP_SIZE 64   // culling::group_size
+
+groupshared uint gsScan[GROUP_SIZE];
+groupshared uint gsBase;
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void cull_cs(uint3 id : SV_DispatchThreadID, uint lane : SV_GroupIndex)
+{
+    // Written like culling::visible() so NaN bounds come out the same.
+    bool visible = false;
+    if (id.x < gObjectCount) {
+        ObjectBounds b = gBounds[id.x];
+        visible = b.lo.x <= gViewMax.x && b.lo.y <= gViewMax.y && gViewMin.x <= b.hi.x && gViewMin.y <= b.hi.y;
+    }
+
+    // Inclusive scan of the flags: gsScan[lane] - 1 is a visible object's slot in the group.
+    gsScan[lane] = visible ? 1 : 0;
+    GroupMemoryBarrierWithGroupSync();
+    [unroll]
+    for (uint offset = 1; offset < GROUP_SIZE; offset <<= 1) {
+        uint add = lane >= offset ? gsScan[lane - offset] : 0;
+        GroupMemoryBarrierWithGroupSync();
+        gsScan[lane] += add;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (lane == GROUP_SIZE - 1) {
+        uint base;
+        gDrawCount.InterlockedAdd(0, gsScan[lane], base);
+        gsBase = base;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (visible) {
+        DrawArgs a = gArgs[id.x];
+        IndirectDraw d;
+        d.texture = a.texture;
+        d.index_count = a.index_count;
+        d.instance_count = 1;
+        d.start_index = a.start_index;
+        d.base_vertex = a.base_vertex;
+        d.start_instance = 0;
+        gDraws[gsBase + gsScan[lane] - 1] = d;
+    }
+}
@@ -0,0 +1,197 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <span>
+#include "simd.h"
+
+export module cull_kernels;
+
+// Builds the argument buffer for the ExecuteIndirect path: tests every object's bounds against the
+// view and writes one IndirectDraw per visible object, packed with no gaps. It's the CPU twin of
+// cull_cs in cull.hlsl, with the same structs and the same steps: objects go in groups of
+// group_size, each group compacts its visible objects in order, then appends them to the output.
+// On the GPU the groups append in whatever order they finish; here they go in order, so the CPU
+// list is in object order.
+//
+// The box test is written so it comes out the same in every version, NaNs included (a NaN box is
+// never visible): min <= view max and view min <= max on both axes.
+
+namespace culling {
+
+// The layouts cull.hlsl reads and writes; keep them in step.
+export struct ObjectBounds {
+    float min_x, min_y, max_x, max_y;
+};
+
+export struct DrawArgs {
+    uint32_t index_count;
+    uint32_t start_index;
+    int32_t base_vertex;
+    uint32_t texture;           // descriptor heap index for gTextureIndex
+};
+
+// One command signature entry: the texture index root constant, then
+// D3D12_DRAW_INDEXED_ARGUMENTS.
+export struct IndirectDraw {
+    uint32_t texture;
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t start_index;
+    int32_t base_vertex;
+    uint32_t start_instance;
+};
+static_assert(sizeof(IndirectDraw) == 24);
+
+export inline constexpr uint32_t group_size = 64;
+
+bool visible(const ObjectBounds& b, const ObjectBounds& view) {
+    return b.min_x <= view.max_x && b.min_y <= view.max_y && view.min_x <= b.max_x && view.min_y <= b.max_y;
+}
+
+// Each kernel writes the indices of the visible objects among bounds[0, count) to out, offset by
+// base, and returns how many. The SIMD versions store whole registers, but never past out + count.
+
+uint32_t compact_scalar(const ObjectBounds* bounds, uint32_t count, uint32_t base, const ObjectBounds& view,
+                        uint32_t* out) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        out[n] = base + i;
+        n += visible(bounds[i], view);
+    }
+    return n;
+}
+
+#if SIMD_X86
+
+// For each 4 bit mask, the lanes that are set, packed to the front (as pshufb controls on 32 bit
+// lanes), and for each 8 bit mask the same as 4 bit lane numbers for vpermd.
+constexpr auto pack4_table = [] {
+    std::array<std::array<uint8_t, 16>, 16> t = {};
+    for (int m = 0; m < 16; m++) {
+        int n = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            if (m & (1 << lane)) {
+                for (int b = 0; b < 4; b++) t[m][n * 4 + b] = uint8_t(lane * 4 + b);
+                n++;
+            }
+        }
+        for (; n < 4; n++) {
+            for (int b = 0; b < 4; b++) t[m][n * 4 + b] = 0x80;
+        }
+    }
+    return t;
+}();
+
+constexpr auto pack8_table = [] {
+    std::array<uint32_t, 256> t = {};
+    for (int m = 0; m < 256; m++) {
+        int n = 0;
+        for (int lane = 0; lane < 8; lane++) {
+            if (m & (1 << lane)) t[m] |= uint32_t(lane) << (4 * n++);
+        }
+    }
+    return t;
+}();
+
+// (min_x, min_y, -max_x, -max_y) <= (view max_x, view max_y, -view min_x, -view min_y) is the whole
+// test in one compare.
+SIMD_TARGET_SSE41
+inline __m128 flip_max(__m128 v) {
+    return _mm_xor_ps(v, _mm_castsi128_ps(_mm_setr_epi32(0, 0, int(0x80000000), int(0x80000000))));
+}
+
+SIMD_TARGET_SSE41
+uint32_t compact_sse41(const ObjectBounds* bounds, uint32_t count, uint32_t base, const ObjectBounds& view,
+                       uint32_t* out) {
+    const __m128 limit = _mm_setr_ps(view.max_x, view.max_y, -view.min_x, -view.min_y);
+    const float* p = &bounds[0].min_x;
+    uint32_t n = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 4; k++) {
+            __m128 b = flip_max(_mm_loadu_ps(p + 4 * (i + k)));
+            mask |= uint32_t(_mm_movemask_ps(_mm_cmple_ps(b, limit)) == 0xF) << k;
+        }
+        __m128i index = _mm_add_epi32(_mm_set1_epi32(int(base + i)), _mm_setr_epi32(0, 1, 2, 3));
+        __m128i control = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pack4_table[mask].data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), _mm_shuffle_epi8(index, control));
+        n += std::popcount(mask);
+    }
+    return n + compact_scalar(bounds + i, count - i, base + i, view, out + n);
+}
+
+SIMD_TARGET_AVX2
+uint32_t compact_avx2(const ObjectBounds* bounds, uint32_t count, uint32_t base, const ObjectBounds& view,
+                      uint32_t* out) {
+    const __m256 limit = _mm256_setr_ps(view.max_x, view.max_y, -view.min_x, -view.min_y,
+                                        view.max_x, view.max_y, -view.min_x, -view.min_y);
+    const __m256 flip = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, int(0x80000000), int(0x80000000),
+                                                              0, 0, int(0x80000000), int(0x80000000)));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i nibbles = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const float* p = &bounds[0].min_x;
+    uint32_t n = 0;
+    uint32_t i = 0;
+    // 8 objects per iteration, two per register.
+    for (; i + 8 <= count; i += 8) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 4; k++) {
+            __m256 b = _mm256_xor_ps(_mm256_loadu_ps(p + 4 * (i + 2 * k)), flip);
+            uint32_t m = uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(b, limit, _CMP_LE_OQ)));
+            mask |= (uint32_t((m & 0xF) == 0xF) | uint32_t((m >> 4) == 0xF) << 1) << (2 * k);
+        }
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(int(base + i)), lanes);
+        __m256i control = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(pack8_table[mask])), nibbles),
+                                           _mm256_set1_epi32(0xF));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n), _mm256_permutevar8x32_epi32(index, control));
+        n += std::popcount(mask);
+    }
+    return n + compact_sse41(bounds + i, count - i, base + i, view, out + n);
+}
+
+#endif // SIMD_X86
+
+uint32_t compact(const ObjectBounds* bounds, uint32_t count, uint32_t base, const ObjectBounds& view,
+                 uint32_t* out, simd::Level level) {
+#if SIMD_X86
+    switch (level) {
+    case simd::Level::avx2: return compact_avx2(bounds, count, base, view, out);
+    case simd::Level::sse41: return compact_sse41(bounds, count, base, view, out);
+    default: break;
+    }
+#endif
+    return compact_scalar(bounds, count, base, view, out);
+}
+
+// Indices of the objects overlapping view, in order. visible needs room for bounds.size().
+export uint32_t cull(std::span<const ObjectBounds> bounds, const ObjectBounds& view, uint32_t* visible,
+                     simd::Level level = simd::Level::avx2) {
+    return compact(bounds.data(), uint32_t(bounds.size()), 0, view, visible, simd::usable_level(level));
+}
+
+// The whole of cull_cs: an IndirectDraw in out for every object overlapping view. Returns the
+// draw count. out needs room for bounds.size() draws.
+export uint32_t cull_draws(std::span<const ObjectBounds> bounds, std::span<const DrawArgs> args,
+                           const ObjectBounds& view, IndirectDraw* out, simd::Level level = simd::Level::avx2) {
+    assert(args.size() >= bounds.size());
+    level = simd::usable_level(level);
+    uint32_t group[group_size];
+    uint32_t count = 0;
+    for (uint32_t first = 0; first < bounds.size(); first += group_size) {
+        uint32_t size = std::min<uint32_t>(group_size, uint32_t(bounds.size()) - first);
+        uint32_t n = compact(bounds.data() + first, size, first, view, group, level);
+        for (uint32_t k = 0; k < n; k++) {
+            const DrawArgs& a = args[group[k]];
+            out[count + k] = { a.texture, a.index_count, 1, a.start_index, a.base_vertex, 0 };
+        }
+        count += n;
+    }
+    return count;
+}
+
+}
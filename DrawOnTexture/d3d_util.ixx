@@ -13,9 +13,14 @@ module;
 #include <unknwn.h>
 #include <winrt/base.h> // com_ptr?
 #include <filesystem>
+#include <atomic>
+#include <memory>
+#include <string>
 
 export module d3d_util;
 
+import memory_budget;
+
 using winrt::com_ptr;
 using winrt::check_hresult;
 
@@ -37,6 +42,55 @@ export uint32_t calc_constant_buffer_byte_size(UINT byteSize)
     return (byteSize + 255) & ~255;
 }
 
+// {5b0e3f52-8d7a-4c61-9a3e-27c4f1d8b6a0}
+constexpr GUID memory_tag_guid = { 0x5b0e3f52, 0x8d7a, 0x4c61, { 0x9a, 0x3e, 0x27, 0xc4, 0xf1, 0xd8, 0xb6, 0xa0 } };
+
+// Rides along on a resource as private data. The resource releases it when it's destroyed, which
+// is when the memory stops counting. Holds the budget so it can't go away first.
+class MemoryTag final : public IUnknown {
+public:
+    MemoryTag(std::shared_ptr<gpu::MemoryBudget> budget, gpu::AllocationId id)
+        : m_budget(std::move(budget)), m_id(id) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override {
+        if (riid == __uuidof(IUnknown)) {
+            *object = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refs; }
+
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG refs = --m_refs;
+        if (refs == 0) delete this;
+        return refs;
+    }
+
+private:
+    ~MemoryTag() { m_budget->untrack(m_id); }
+
+    std::atomic<ULONG> m_refs = 1;
+    std::shared_ptr<gpu::MemoryBudget> m_budget;
+    gpu::AllocationId m_id;
+};
+
+// Counts resource against budget for as long as it lives. Tracking it again replaces the old entry.
+export void track_memory(const std::shared_ptr<gpu::MemoryBudget>& budget, ID3D12Resource* resource,
+                         gpu::MemoryCategory category, std::string name) {
+    com_ptr<ID3D12Device> device;
+    check_hresult(resource->GetDevice(__uuidof(device), device.put_void()));
+    auto desc = resource->GetDesc();
+    uint64_t bytes = device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+    auto tag = new MemoryTag(budget, budget->track(category, bytes, std::move(name)));
+    HRESULT hr = resource->SetPrivateDataInterface(memory_tag_guid, tag);
+    tag->Release();
+    check_hresult(hr);
+}
+
 // Simpler version of thing below. Just create the TYPE_DEFAULT buffer. No upload buffer at same time.
 export com_ptr<ID3D12Resource> create_default_buffer(ID3D12Device* device, uint64_t size) {
     com_ptr<ID3D12Resource> buffer;
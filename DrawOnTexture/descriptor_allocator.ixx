@@ -0,0 +1,135 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+export module descriptor_allocator;
+
+// Index allocators for carving up one big shader-visible descriptor heap. They only hand out
+// indices; descriptor_heap turns those into handles. Two kinds:
+//
+// - DescriptorFreeList, for descriptors that live as long as their resource (texture SRVs).
+//   Since shaders pick textures by index, a freed slot may still be read by frames in flight, so
+//   freeing is deferred until a fence says they're done.
+// - DescriptorRing, for descriptors written every frame. Each frame's allocations are released
+//   together once that frame's fence has passed.
+
+namespace gpu {
+
+export inline constexpr uint32_t invalid_descriptor = UINT32_MAX;
+
+export class DescriptorFreeList {
+public:
+    DescriptorFreeList(uint32_t base, uint32_t count)
+        : m_base(base), m_allocated(count, 0)
+    {
+        // Pop from the back, so hand out low indices first.
+        m_free.reserve(count);
+        for (uint32_t i = count; i > 0; i--) {
+            m_free.push_back(base + i - 1);
+        }
+    }
+
+    uint32_t capacity() const { return static_cast<uint32_t>(m_allocated.size()); }
+    uint32_t used() const { return capacity() - static_cast<uint32_t>(m_free.size()); }
+
+    // Returns invalid_descriptor when full.
+    uint32_t allocate() {
+        if (m_free.empty()) return invalid_descriptor;
+        uint32_t index = m_free.back();
+        m_free.pop_back();
+        m_allocated[index - m_base] = 1;
+        return index;
+    }
+
+    // Frees right away. Only for descriptors the GPU can't be using, eg. never drawn with.
+    void free(uint32_t index) {
+        assert(index - m_base < capacity() && m_allocated[index - m_base]);
+        m_allocated[index - m_base] = 0;
+        m_free.push_back(index);
+    }
+
+    // Frees once the GPU has passed fence_value.
+    void free_after(uint32_t index, uint64_t fence_value) {
+        assert(index - m_base < capacity() && m_allocated[index - m_base]);
+        m_pending.push_back({ index, fence_value });
+    }
+
+    void retire(uint64_t completed_fence) {
+        // Fences only go up, so the pending list is in fence order.
+        while (!m_pending.empty() && m_pending.front().fence <= completed_fence) {
+            free(m_pending.front().index);
+            m_pending.pop_front();
+        }
+    }
+
+private:
+    struct Pending {
+        uint32_t index;
+        uint64_t fence;
+    };
+
+    uint32_t m_base;
+    std::vector<uint32_t> m_free;
+    std::vector<uint8_t> m_allocated;
+    std::deque<Pending> m_pending;
+};
+
+export class DescriptorRing {
+public:
+    DescriptorRing(uint32_t base, uint32_t count)
+        : m_base(base), m_capacity(count)
+    {
+    }
+
+    uint32_t capacity() const { return m_capacity; }
+    uint32_t used() const { return m_used; }
+
+    // count contiguous descriptors for this frame. A run that won't fit before the end of the ring
+    // starts over at the beginning, and the skipped bit is released with the frame. Returns
+    // invalid_descriptor if the frames in flight are holding too much.
+    uint32_t allocate(uint32_t count = 1) {
+        if (count == 0 || count > m_capacity) return invalid_descriptor;
+        // Once every frame has retired the ring is empty wherever head got to; starting over at 0
+        // keeps a big run from being refused just because it would have to wrap.
+        if (m_used == 0) m_head = 0;
+        uint32_t skip = m_head + count > m_capacity ? m_capacity - m_head : 0;
+        if (m_used + skip + count > m_capacity) return invalid_descriptor;
+        uint32_t start = (m_head + skip) % m_capacity;
+        m_head = (start + count) % m_capacity;
+        m_used += skip + count;
+        m_frame_used += skip + count;
+        return m_base + start;
+    }
+
+    // Everything allocated since the last end_frame() is released once fence_value has passed.
+    void end_frame(uint64_t fence_value) {
+        if (m_frame_used == 0) return;
+        m_frames.push_back({ fence_value, m_frame_used });
+        m_frame_used = 0;
+    }
+
+    void retire(uint64_t completed_fence) {
+        while (!m_frames.empty() && m_frames.front().fence <= completed_fence) {
+            m_used -= m_frames.front().count;
+            m_frames.pop_front();
+        }
+    }
+
+private:
+    struct Frame {
+        uint64_t fence;
+        uint32_t count;
+    };
+
+    uint32_t m_base;
+    uint32_t m_capacity;
+    uint32_t m_head = 0;
+    uint32_t m_used = 0;
+    uint32_t m_frame_used = 0;
+    std::deque<Frame> m_frames;
+};
+
+}
@@ -0,0 +1,118 @@
+module;
+
+#include <windows.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+#include <unknwn.h>
+#include <winrt/base.h>
+#include <stdexcept>
+
+export module descriptor_heap;
+
+import descriptor_allocator;
+
+using winrt::com_ptr;
+using winrt::check_hresult;
+
+// The one shader-visible CBV/SRV/UAV heap. It's bound once per command list and never switched;
+// shaders pick textures out of it by index (an unbounded Texture2D array starting at index 0),
+// so drawing with a different texture is a root constant change rather than a new table.
+//
+// The front of the heap is for long-lived descriptors, the back is a per-frame ring.
+
+namespace gpu {
+
+export class DescriptorHeap {
+public:
+    DescriptorHeap(ID3D12Device* device, uint32_t persistent_count, uint32_t transient_count)
+        : m_device(device),
+          m_persistent(0, persistent_count),
+          m_transient(persistent_count, transient_count)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+        desc.NumDescriptors = persistent_count + transient_count;
+        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        check_hresult(device->CreateDescriptorHeap(&desc, __uuidof(m_heap), m_heap.put_void()));
+        m_heap->SetName(L"bindless heap");
+        m_size = desc.NumDescriptors;
+        m_increment = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    }
+
+    ID3D12DescriptorHeap* heap() const { return m_heap.get(); }
+    uint32_t size() const { return m_size; }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu(uint32_t index) const {
+        return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_heap->GetCPUDescriptorHandleForHeapStart(), index, m_increment);
+    }
+
+    D3D12_GPU_DESCRIPTOR_HANDLE gpu(uint32_t index) const {
+        return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_heap->GetGPUDescriptorHandleForHeapStart(), index, m_increment);
+    }
+
+    // A long-lived SRV for the whole texture. The index is what shaders use to find it.
+    uint32_t create_srv(ID3D12Resource* texture) {
+        uint32_t index = allocate_persistent();
+        update_srv(index, texture);
+        return index;
+    }
+
+    // Points an SRV at a different texture. Only when no frame that reads it is in flight.
+    void update_srv(uint32_t index, ID3D12Resource* texture) {
+        auto tex_desc = texture->GetDesc();
+        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+        srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srv_desc.Format = tex_desc.Format;
+        srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srv_desc.Texture2D.MostDetailedMip = 0;
+        srv_desc.Texture2D.MipLevels = tex_desc.MipLevels;
+        srv_desc.Texture2D.ResourceMinLODClamp = 0.0f;
+        m_device->CreateShaderResourceView(texture, &srv_desc, cpu(index));
+    }
+
+    uint32_t create_cbv(const D3D12_CONSTANT_BUFFER_VIEW_DESC& cbv_desc) {
+        uint32_t index = allocate_persistent();
+        m_device->CreateConstantBufferView(&cbv_desc, cpu(index));
+        return index;
+    }
+
+    // Gives back a long-lived descriptor once the frames that might still read it are done.
+    void release(uint32_t index, uint64_t fence_value) {
+        m_persistent.free_after(index, fence_value);
+    }
+
+    // count contiguous descriptors valid for this frame only. Returns invalid_descriptor if the
+    // frames in flight have used up the ring.
+    uint32_t allocate_transient(uint32_t count = 1) {
+        return m_transient.allocate(count);
+    }
+
+    // Call after submitting a frame, with the fence value it signals.
+    void end_frame(uint64_t fence_value) {
+        m_transient.end_frame(fence_value);
+    }
+
+    // Call before recording a frame.
+    void retire(uint64_t completed_fence) {
+        m_persistent.retire(completed_fence);
+        m_transient.retire(completed_fence);
+    }
+
+private:
+    uint32_t allocate_persistent() {
+        uint32_t index = m_persistent.allocate();
+        if (index == invalid_descriptor) {
+            throw std::runtime_error("out of persistent descriptors");
+        }
+        return index;
+    }
+
+    ID3D12Device* m_device;
+    com_ptr<ID3D12DescriptorHeap> m_heap;
+    uint32_t m_size = 0;
+    uint32_t m_increment = 0;
+    DescriptorFreeList m_persistent;
+    DescriptorRing m_transient;
+};
+
+}
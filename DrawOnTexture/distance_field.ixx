@@ -0,0 +1,308 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+export module distance_field;
+
+import glyph_rasterizer;
+import path_tessellator;
+
+// Signed distance fields, so a shape or glyph rasterized once at a small size can be drawn crisp at
+// any scale: the texture holds the distance to the nearest edge instead of coverage, bilinear
+// filtering interpolates distances (which stay meaningful between texels, unlike coverage), and
+// the pixel shader (sdf_pix_shader in shaders.hlsl) puts the edge back at 0.5 with a one pixel
+// ramp wherever it lands on screen.
+//
+// The distances are exact Euclidean ones from the Felzenszwalb-Huttenlocher transform: a 1D pass
+// down every column then along every row, each one a lower envelope of parabolas, so the whole
+// thing is linear in the number of pixels. Columns don't depend on each other (nor do rows), so each
+// pass is split across threads. It starts from 8 bit coverage: the transform finds the nearest
+// pixel the edge goes through, and that pixel's coverage says where in it the edge is, so
+// antialiased input gives subpixel distances rather than ones rounded to whole pixels.
+//
+// One channel only. Corners come out rounded when the field is magnified a lot; multi-channel
+// fields fix that but need the outline's edges, not coverage.
+
+namespace sdf {
+
+// Stands in for infinity in the squared distances; big enough, and finite so sums stay finite.
+inline constexpr float far_away = 1e20f;
+
+// The lower envelope of the parabolas (q - i)^2 + f[i], sampled at every q, and which i it came
+// from. v and z are scratch, n and n + 1 long.
+void transform_1d(const float* f, float* d, int* nearest, int n, int* v, float* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -far_away;
+    z[1] = far_away;
+    for (int q = 1; q < n; q++) {
+        // Where the new parabola crosses the last one on the envelope; if that's before the last
+        // one started, the last one isn't on the envelope at all. z[0] stops it at the first.
+        auto crossing = [&](int r) { return ((f[q] + float(q) * q) - (f[r] + float(r) * r)) / float(2 * (q - r)); };
+        float s = crossing(v[k]);
+        while (s <= z[k]) s = crossing(v[--k]);
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = far_away;
+    }
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        float dq = float(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+        nearest[q] = v[k];
+    }
+}
+
+// Columns are done a block at a time: copying a block out and back reads whole cache lines
+// instead of one float from each.
+constexpr int column_block = 16;
+
+// Runs fn(first, last) over [0, count) in chunks on threads (0 for every core) plus the caller.
+template <typename Fn>
+void parallel_chunks(int count, int chunk, unsigned threads, Fn fn) {
+    std::atomic<int> next = 0;
+    auto run = [&] {
+        for (int i = next.fetch_add(chunk); i < count; i = next.fetch_add(chunk)) {
+            fn(i, std::min(count, i + chunk));
+        }
+    };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1u, std::min<unsigned>(threads, unsigned((count + chunk - 1) / chunk)));
+    std::vector<std::jthread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(run);
+    run();
+}
+
+// Exact squared Euclidean distances, in place. On the way in grid holds 0 at the features and
+// far_away everywhere else; on the way out each cell has the squared distance to the nearest
+// feature, and nearest (resized to match) has that feature's index in grid.
+export void squared_distances(std::vector<float>& grid, std::vector<int>& nearest, int width, int height,
+                              unsigned threads = 0) {
+    assert(grid.size() == size_t(width) * height);
+    nearest.resize(grid.size());
+    if (width == 0 || height == 0) return;
+    // Down the columns, leaving the row of each cell's nearest feature in that column in nearest.
+    parallel_chunks(width, column_block, threads, [&](int x0, int x1) {
+        int columns = x1 - x0;
+        std::vector<float> block(size_t(height) * column_block), f(height), d(height), z(height + 1);
+        std::vector<int> rows(size_t(height) * column_block), row(height), v(height);
+        for (int y = 0; y < height; y++) {
+            std::copy_n(&grid[size_t(y) * width + x0], columns, &block[size_t(y) * column_block]);
+        }
+        for (int c = 0; c < columns; c++) {
+            for (int y = 0; y < height; y++) f[y] = block[size_t(y) * column_block + c];
+            transform_1d(f.data(), d.data(), row.data(), height, v.data(), z.data());
+            for (int y = 0; y < height; y++) {
+                block[size_t(y) * column_block + c] = d[y];
+                rows[size_t(y) * column_block + c] = row[y];
+            }
+        }
+        for (int y = 0; y < height; y++) {
+            std::copy_n(&block[size_t(y) * column_block], columns, &grid[size_t(y) * width + x0]);
+            std::copy_n(&rows[size_t(y) * column_block], columns, &nearest[size_t(y) * width + x0]);
+        }
+    });
+    // Along the rows: the nearest column, and that column's nearest row from the first pass.
+    parallel_chunks(height, 8, threads, [&](int y0, int y1) {
+        std::vector<float> d(width), z(width + 1);
+        std::vector<int> column(width), rows(width), v(width);
+        for (int y = y0; y < y1; y++) {
+            float* line = &grid[size_t(y) * width];
+            int* found = &nearest[size_t(y) * width];
+            transform_1d(line, d.data(), column.data(), width, v.data(), z.data());
+            std::copy(d.begin(), d.end(), line);
+            std::copy_n(found, width, rows.begin());
+            for (int x = 0; x < width; x++) {
+                found[x] = rows[column[x]] * width + column[x];
+            }
+        }
+    });
+}
+
+export struct DistanceFieldOptions {
+    float spread = 8;       // pixels each way from the edge that the 0..255 range covers
+    int padding = 0;        // empty pixels added around the input, so the field has room outside it
+    unsigned threads = 0;   // 0 for every core
+};
+
+// An 8 bit field, 0.5 (127.5) on the edge, more inside, less outside. A step of 1 / (2 * spread)
+// per pixel, so a shader gets the distance in pixels back as (value - 0.5) * 2 * spread.
+export struct DistanceField {
+    int width = 0;
+    int height = 0;
+    float spread = 0;
+    std::vector<uint8_t> pixels;
+
+    // Signed distance in field pixels, positive inside, clamped to spread.
+    float distance(int x, int y) const {
+        return (pixels[size_t(y) * width + x] / 255.0f - 0.5f) * 2 * spread;
+    }
+};
+
+// How far past a pixel's centre, in direction (dx, dy), a straight edge through it is when the
+// covered part (a) is on the near side. Gustavson and Strand's estimate from "Anti-aliased
+// Euclidean distance transform": 0.5 - a along an axis, and for a slanted edge the corner
+// triangles make it reach further.
+float edge_offset(float dx, float dy, float a) {
+    if (dx == 0 || dy == 0) return 0.5f - a;
+    float length = std::sqrt(dx * dx + dy * dy);
+    float gx = std::abs(dx) / length, gy = std::abs(dy) / length;
+    if (gx < gy) std::swap(gx, gy);
+    float a1 = 0.5f * gy / gx;
+    if (a < a1) return 0.5f * (gx + gy) - std::sqrt(2 * gx * gy * a);
+    if (a < 1 - a1) return (0.5f - a) * gx;
+    return -0.5f * (gx + gy) + std::sqrt(2 * gx * gy * (1 - a));
+}
+
+// From coverage (width * height bytes, stride bytes apart), where 255 is inside.
+export DistanceField from_coverage(const uint8_t* coverage, int width, int height, size_t stride,
+                                   const DistanceFieldOptions& options = {}) {
+    DistanceField field;
+    int pad = std::max(options.padding, 0);
+    field.width = width + 2 * pad;
+    field.height = height + 2 * pad;
+    field.spread = options.spread;
+    size_t count = size_t(field.width) * field.height;
+
+    // The transform finds, for a pixel outside, the nearest pixel with any coverage, and for one
+    // inside the nearest that isn't fully covered; the edge is somewhere in that pixel, and its
+    // coverage and the direction it's in say where. Partly covered pixels are on the edge already.
+    std::vector<float> alpha(count, 0.0f), outside(count, far_away), inside(count, far_away);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = coverage + size_t(y) * stride;
+        size_t row = size_t(y + pad) * field.width + pad;
+        for (int x = 0; x < width; x++) {
+            alpha[row + x] = src[x] / 255.0f;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (alpha[i] > 0) outside[i] = 0;
+        if (alpha[i] < 1) inside[i] = 0;
+    }
+    std::vector<int> nearest_in, nearest_out;
+    squared_distances(outside, nearest_in, field.width, field.height, options.threads);
+    squared_distances(inside, nearest_out, field.width, field.height, options.threads);
+
+    field.pixels.resize(count);
+    float scale = 255.0f / (2 * options.spread);
+    // Past this the offset can't bring it back inside the range, so the field is just clamped.
+    float beyond = (options.spread + 1) * (options.spread + 1);
+    for (int y = 0; y < field.height; y++) {
+        for (int x = 0; x < field.width; x++) {
+            size_t i = size_t(y) * field.width + x;
+            float a = alpha[i], d;
+            if (a > 0 && a < 1) {
+                d = a - 0.5f;
+            } else {
+                bool in = a == 1;
+                float squared = in ? inside[i] : outside[i];
+                if (squared >= beyond) {
+                    d = in ? options.spread : -options.spread;
+                } else {
+                    int q = in ? nearest_out[i] : nearest_in[i];
+                    int qy = q / field.width, qx = q - qy * field.width;
+                    float e = edge_offset(float(qx - x), float(qy - y), in ? 1 - alpha[q] : alpha[q]);
+                    d = std::sqrt(squared) + e;
+                    if (!in) d = -d;
+                }
+            }
+            field.pixels[i] = uint8_t(std::clamp(127.5f + d * scale, 0.0f, 255.0f) + 0.5f);
+        }
+    }
+    return field;
+}
+
+// A glyph's field, padded by the spread so the outside distances fit. left/top move out by the
+// same amount.
+export DistanceField from_glyph(text::GlyphBitmap& glyph, const DistanceFieldOptions& options = {}) {
+    DistanceFieldOptions padded = options;
+    padded.padding = std::max(options.padding, int(std::ceil(options.spread)));
+    glyph.left -= padded.padding;
+    glyph.top -= padded.padding;
+    return from_coverage(glyph.coverage.data(), glyph.width, glyph.height, size_t(glyph.width), padded);
+}
+
+// Coverage of a filled path (nonzero) in a width x height bitmap, path units times scale plus
+// offset to pixels. Open contours are closed. For fields of shapes made with path_tessellator's
+// Path.
+export std::vector<uint8_t> path_coverage(const shapes::Path& path, int width, int height, float scale = 1,
+                                          float offset_x = 0, float offset_y = 0) {
+    // Much finer than the tessellator's quarter pixel: the field is only as good as the outline,
+    // and a coarse one pulls every distance outside a curve in.
+    constexpr float tolerance = 0.05f;
+    text::CoverageRasterizer rasterizer(width, height);
+    auto to_pixels = [&](shapes::Vec2 p) {
+        return text::Point{ p.x * scale + offset_x, p.y * scale + offset_y };
+    };
+    auto cubic = [&](text::Point p0, text::Point c1, text::Point c2, text::Point p1) {
+        // Same segment count rule as the tessellator.
+        float ddx = std::max(std::abs(p0.x - 2 * c1.x + c2.x), std::abs(c1.x - 2 * c2.x + p1.x));
+        float ddy = std::max(std::abs(p0.y - 2 * c1.y + c2.y), std::abs(c1.y - 2 * c2.y + p1.y));
+        int n = std::clamp(int(std::ceil(std::sqrt(6 * std::hypot(ddx, ddy) / (8 * tolerance)))), 1, 1024);
+        text::Point prev = p0;
+        for (int k = 1; k <= n; k++) {
+            float t = float(k) / n, mt = 1 - t;
+            float a = mt * mt * mt, b = 3 * mt * mt * t, c = 3 * mt * t * t, d = t * t * t;
+            text::Point q = { a * p0.x + b * c1.x + c * c2.x + d * p1.x, a * p0.y + b * c1.y + c * c2.y + d * p1.y };
+            rasterizer.line(prev, q);
+            prev = q;
+        }
+    };
+    const auto& points = path.points();
+    size_t i = 0;
+    text::Point start = {}, current = {};
+    bool open = false;
+    auto close = [&] {
+        if (open) rasterizer.line(current, start);
+        open = false;
+    };
+    for (shapes::Verb verb : path.verbs()) {
+        switch (verb) {
+        case shapes::Verb::move:
+            close();
+            start = current = to_pixels(points[i++]);
+            open = true;
+            break;
+        case shapes::Verb::line: {
+            text::Point p = to_pixels(points[i++]);
+            rasterizer.line(current, p);
+            current = p;
+            break;
+        }
+        case shapes::Verb::quad: {
+            // As the cubic it is.
+            text::Point c = to_pixels(points[i]), p = to_pixels(points[i + 1]);
+            i += 2;
+            cubic(current, { current.x + (c.x - current.x) * 2 / 3, current.y + (c.y - current.y) * 2 / 3 },
+                  { p.x + (c.x - p.x) * 2 / 3, p.y + (c.y - p.y) * 2 / 3 }, p);
+            current = p;
+            break;
+        }
+        case shapes::Verb::cubic: {
+            text::Point p = to_pixels(points[i + 2]);
+            cubic(current, to_pixels(points[i]), to_pixels(points[i + 1]), p);
+            i += 3;
+            current = p;
+            break;
+        }
+        case shapes::Verb::close:
+            close();
+            current = start;
+            break;
+        }
+    }
+    close();
+    std::vector<uint8_t> coverage(size_t(width) * height);
+    rasterizer.accumulate(coverage.data());
+    return coverage;
+}
+
+}
@@ -0,0 +1,95 @@
+module;
+
+#include <windows.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+#include <D3Dcompiler.h>
+#include <unknwn.h>
+#include <winrt/base.h>
+#include <cassert>
+#include <cstdint>
+
+export module filter_compute;
+
+import filter_kernels;
+import d3d_util;
+
+using winrt::com_ptr;
+using winrt::check_hresult;
+
+// The compute shader side of the canvas filters: blur_cs in filters.hlsl, one pass of a separable
+// Gaussian per dispatch. A blur is two passes, rows into a temporary texture and then its columns
+// into the destination; both are RGBA8 textures. The results match canvas::filter_rgba8() with
+// BlurMethod::gaussian.
+
+namespace gpu {
+
+export class BlurCompute {
+public:
+    explicit BlurCompute(ID3D12Device* device) {
+        CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+        CD3DX12_ROOT_PARAMETER1 params[3];
+        params[0].InitAsConstants(sizeof(Constants) / 4, 0);    // cbBlur, b0
+        params[1].InitAsDescriptorTable(1, &ranges[0]);         // source, t0
+        params[2].InitAsDescriptorTable(1, &ranges[1]);         // destination, u0
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rs_desc;
+        rs_desc.Init_1_1(3, params);
+        com_ptr<ID3DBlob> serialized;
+        com_ptr<ID3DBlob> errors;
+        HRESULT hr = D3DX12SerializeVersionedRootSignature(&rs_desc, D3D_ROOT_SIGNATURE_VERSION_1_1,
+                                                           serialized.put(), errors.put());
+        if (errors) {
+            OutputDebugStringA((char*)errors->GetBufferPointer());
+        }
+        check_hresult(hr);
+        check_hresult(device->CreateRootSignature(0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
+                                                  __uuidof(m_root_signature), m_root_signature.put_void()));
+
+        auto cs = d3d_util::compile_shader(L"filters.hlsl", nullptr, "blur_cs", "cs_5_1");
+        D3D12_COMPUTE_PIPELINE_STATE_DESC pso_desc = {};
+        pso_desc.pRootSignature = m_root_signature.get();
+        pso_desc.CS = { cs->GetBufferPointer(), cs->GetBufferSize() };
+        check_hresult(device->CreateComputePipelineState(&pso_desc, __uuidof(m_pso), m_pso.put_void()));
+    }
+
+    // Records one pass of kernel over a width x height texture, along rows or columns. The
+    // descriptors are one-entry tables in the bound heap: an SRV of the source, which has to be in
+    // NON_PIXEL_SHADER_RESOURCE, and a UAV of the destination, in UNORDERED_ACCESS. Leaves the
+    // compute root signature and pipeline set.
+    void record_pass(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE source,
+                     D3D12_GPU_DESCRIPTOR_HANDLE destination, uint32_t width, uint32_t height, bool vertical,
+                     const pixel::GaussianKernel& kernel) {
+        assert(kernel.radius <= pixel::max_gaussian_radius);
+        Constants constants = { width, height, vertical ? 1u : 0u, uint32_t(kernel.radius) };
+        for (int i = 0; i <= kernel.radius; i++) {
+            constants.weights[i] = uint32_t(kernel.weights[kernel.radius + i]);
+        }
+        list->SetComputeRootSignature(m_root_signature.get());
+        list->SetPipelineState(m_pso.get());
+        list->SetComputeRoot32BitConstants(0, sizeof(Constants) / 4, &constants, 0);
+        list->SetComputeRootDescriptorTable(1, source);
+        list->SetComputeRootDescriptorTable(2, destination);
+        uint32_t length = vertical ? height : width;
+        list->Dispatch((length + group_size - 1) / group_size, vertical ? width : height, 1);
+    }
+
+private:
+    static constexpr uint32_t group_size = 64;      // GROUP_SIZE in filters.hlsl
+
+    // cbBlur; the weights are the centre one and out, the shader mirrors them.
+    struct Constants {
+        uint32_t width;
+        uint32_t height;
+        uint32_t vertical;
+        uint32_t radius;
+        uint32_t weights[20] = {};
+    };
+    static_assert(pixel::max_gaussian_radius + 1 <= 20);
+
+    com_ptr<ID3D12RootSignature> m_root_signature;
+    com_ptr<ID3D12PipelineState> m_pso;
+};
+
+}
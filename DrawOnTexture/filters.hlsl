@@ -0,0 +1,58 @@
+// The GPU version of the Gaussian blur in canvas_filters.ixx: one pass of the separable blur,
+// along rows or along columns. It uses the same 2.14 fixed point weights and rounding as
+// pixel::convolve_rgba8(), and the pass in between is stored as RGBA8 like the CPU's, so the two
+// come out bit identical. Pixels outside the texture read as transparent, like outside a TileCanvas.
+
+cbuffer cbBlur : register(b0)
+{
+    uint2 gSize;            // texture width and height
+    uint gVertical;         // 0 blurs along rows, 1 along columns
+    uint gRadius;           // <= MAX_RADIUS
+    uint4 gWeights[5];      // weights[radius + i] for i = 0..radius, four to a uint4
+};
+
+Texture2D<float4> gSource : register(t0);
+RWTexture2D<unorm float4> gDest : register(u0);
+
+#define GROUP_SIZE 64
+#define MAX_RADIUS 16       // pixel::max_gaussian_radius
+
+// The group's pixels plus the radius either side.
+groupshared uint4 gsLine[GROUP_SIZE + 2 * MAX_RADIUS];
+
+uint weight(uint i)
+{
+    return gWeights[i >> 2][i & 3];
+}
+
+int2 texel(uint line, uint pos)
+{
+    return gVertical ? int2(line, pos) : int2(pos, line);
+}
+
+// A group does GROUP_SIZE pixels of one row (or column): dispatch (ceil(length / GROUP_SIZE), lines, 1).
+[numthreads(GROUP_SIZE, 1, 1)]
+void blur_cs(uint3 group : SV_GroupID, uint lane : SV_GroupIndex)
+{
+    uint length = gVertical ? gSize.y : gSize.x;
+    int start = int(group.x * GROUP_SIZE) - int(gRadius);
+    for (uint i = lane; i < GROUP_SIZE + 2 * gRadius; i += GROUP_SIZE) {
+        int pos = start + int(i);
+        uint4 v = 0;
+        if (pos >= 0 && pos < int(length)) {
+            v = uint4(round(gSource.Load(int3(texel(group.y, pos), 0)) * 255.0f));
+        }
+        gsLine[i] = v;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint pos = group.x * GROUP_SIZE + lane;
+    if (pos >= length) {
+        return;
+    }
+    uint4 sum = 1 << 13;    // half of 1 << weight_bits
+    for (uint t = 0; t <= 2 * gRadius; t++) {
+        sum += weight(uint(abs(int(t) - int(gRadius)))) * gsLine[lane + t];
+    }
+    gDest[texel(group.y, pos)] = float4(sum >> 14) / 255.0f;
+}
@@ -0,0 +1,344 @@
+module;
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <vector>
+#include "simd.h"
+
+export module flood_fill;
+
+import tile_canvas;
+
+// Paint bucket for a TileCanvas: fills the 4-connected region of pixels within a tolerance of the
+// one clicked on.
+//
+// A tile row is 64 pixels, so it fits in one uint64_t. The first time the fill reaches a tile, the
+// tile's pixels are compared against the target colour all at once (SSE4.1/AVX2, like the other
+// pixel kernels) into one match bit per pixel, and after that the fill only works on bits: a
+// span fill where a span is found with a couple of bit scans per tile row, and filled pixels are
+// kept in a second mask. Pixels are written at the end, from the masks, so matching always sees
+// the original colours even when the fill colour itself is within the tolerance.
+//
+// Null tiles are transparent all over. If transparent matches, reaching one fills all of it, so
+// it's done in one step without looking at its pixels, and it and every other tile the fill
+// covers completely end up sharing one solid tile. A fill over a big empty or flat canvas then
+// writes almost nothing.
+
+namespace canvas {
+
+// --- tolerance compare ---------------------------------------------------------------------------
+
+// A pixel matches when every channel is within tolerance of the target's.
+bool matches(uint32_t p, uint32_t target, uint32_t tolerance) {
+    for (int c = 0; c < 4; c++) {
+        int d = int((p >> (8 * c)) & 0xff) - int((target >> (8 * c)) & 0xff);
+        if (uint32_t(std::abs(d)) > tolerance) return false;
+    }
+    return true;
+}
+
+uint64_t match_bits_scalar(const uint32_t* row, uint32_t target, uint32_t tolerance) {
+    uint64_t bits = 0;
+    for (int i = 0; i < tile_size; i++) {
+        bits |= uint64_t(matches(row[i], target, tolerance)) << i;
+    }
+    return bits;
+}
+
+#if SIMD_X86
+
+// |a - b| per byte is the OR of the two saturating differences; it's within tolerance where
+// max(|a - b|, tolerance) is tolerance, and a pixel matches where all four bytes are.
+SIMD_TARGET_SSE41
+uint64_t match_bits_sse41(const uint32_t* row, uint32_t target, uint32_t tolerance) {
+    const __m128i t = _mm_set1_epi32(int(target));
+    const __m128i tol = _mm_set1_epi8(char(tolerance));
+    const __m128i ones = _mm_set1_epi32(-1);
+    uint64_t bits = 0;
+    for (int i = 0; i < tile_size; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(v, t), _mm_subs_epu8(t, v));
+        __m128i ok = _mm_cmpeq_epi8(_mm_max_epu8(d, tol), tol);
+        bits |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(ok, ones)))) << i;
+    }
+    return bits;
+}
+
+SIMD_TARGET_AVX2
+uint64_t match_bits_avx2(const uint32_t* row, uint32_t target, uint32_t tolerance) {
+    const __m256i t = _mm256_set1_epi32(int(target));
+    const __m256i tol = _mm256_set1_epi8(char(tolerance));
+    const __m256i ones = _mm256_set1_epi32(-1);
+    uint64_t bits = 0;
+    for (int i = 0; i < tile_size; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i d = _mm256_or_si256(_mm256_subs_epu8(v, t), _mm256_subs_epu8(t, v));
+        __m256i ok = _mm256_cmpeq_epi8(_mm256_max_epu8(d, tol), tol);
+        bits |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(ok, ones)))) << i;
+    }
+    return bits;
+}
+
+#endif // SIMD_X86
+
+// One bit per pixel of a tile row, bit i for pixel i.
+uint64_t match_bits(const uint32_t* row, uint32_t target, uint32_t tolerance, simd::Level level) {
+#if SIMD_X86
+    switch (level) {
+    case simd::Level::avx2: return match_bits_avx2(row, target, tolerance);
+    case simd::Level::sse41: return match_bits_sse41(row, target, tolerance);
+    default: break;
+    }
+#endif
+    return match_bits_scalar(row, target, tolerance);
+}
+
+// --- the fill ------------------------------------------------------------------------------------
+
+constexpr uint64_t all_bits = ~uint64_t(0);
+
+// Bits at and above i.
+uint64_t bits_from(int i) {
+    return all_bits << i;
+}
+
+// Bits below i.
+uint64_t bits_below(int i) {
+    return i == 0 ? 0 : all_bits >> (64 - i);
+}
+
+class Filler {
+public:
+    Filler(TileCanvas& canvas, uint32_t target, uint32_t tolerance, simd::Level level)
+        : m_canvas(canvas), m_target(target), m_tolerance(tolerance), m_level(level),
+          m_state(canvas.tile_count(), unseen),
+          m_empty_matches(matches(0, target, tolerance))
+    {
+    }
+
+    void fill(int x, int y) {
+        m_spans.push_back({ y, x, x + 1 });
+        while (!m_spans.empty()) {
+            Span s = m_spans.back();
+            m_spans.pop_back();
+            scan(s);
+        }
+    }
+
+    // Writes color wherever the fill got to. Returns the pixel count.
+    int64_t write(uint32_t color) {
+        std::shared_ptr<Tile> solid;
+        auto solid_tile = [&] {
+            if (!solid) {
+                solid = std::make_shared<Tile>();
+                solid->pixels.fill(color);
+            }
+            return solid;
+        };
+        int64_t count = 0;
+        for (int index = 0; index < m_canvas.tile_count(); index++) {
+            int32_t state = m_state[index];
+            if (state == all_filled) {
+                m_canvas.replace_tile(index, solid_tile());
+                count += area(index);
+                continue;
+            }
+            if (state < 0) continue;
+            const Masks& m = *m_masks[state];
+            int rows = std::min(tile_size, m_canvas.height() - index / m_canvas.tiles_x() * tile_size);
+            uint64_t edge = edge_bits(index);
+            bool full = true;
+            for (int y = 0; y < rows && full; y++) {
+                full = m.filled[y] == edge;
+            }
+            if (full) {
+                m_canvas.replace_tile(index, solid_tile());
+                count += area(index);
+                continue;
+            }
+            Tile* tile = nullptr;
+            for (int y = 0; y < rows; y++) {
+                uint64_t bits = m.filled[y];
+                if (!bits) continue;
+                if (!tile) tile = &m_canvas.mutable_tile(index);
+                count += std::popcount(bits);
+                uint32_t* row = tile->row(y);
+                while (bits) {
+                    int start = std::countr_zero(bits);
+                    int end = start + std::countr_one(bits >> start);
+                    std::fill(row + start, row + end, color);
+                    bits &= end == 64 ? 0 : bits_from(end);
+                }
+            }
+        }
+        return count;
+    }
+
+private:
+    // A row to look for unfilled matching pixels in, [x0, x1).
+    struct Span {
+        int y, x0, x1;
+    };
+
+    struct Masks {
+        std::array<uint64_t, tile_size> match;
+        std::array<uint64_t, tile_size> filled;
+    };
+
+    // m_state values: an index into m_masks, or one of these.
+    static constexpr int32_t unseen = -1;
+    static constexpr int32_t all_filled = -2;   // an empty tile the fill covered
+    static constexpr int32_t blocked = -3;      // an empty tile that doesn't match
+
+    // The pixels of a tile row that are inside the canvas.
+    uint64_t edge_bits(int index) const {
+        int columns = std::min(tile_size, m_canvas.width() - index % m_canvas.tiles_x() * tile_size);
+        return columns == 64 ? all_bits : bits_below(columns);
+    }
+
+    int64_t area(int index) const {
+        int columns = std::min(tile_size, m_canvas.width() - index % m_canvas.tiles_x() * tile_size);
+        int rows = std::min(tile_size, m_canvas.height() - index / m_canvas.tiles_x() * tile_size);
+        return int64_t(columns) * rows;
+    }
+
+    // Bits of row y in tile column tx that could still be filled. Looking at a tile for the first
+    // time sets it up; the fill only ever looks at pixels next to ones it has filled, so an empty
+    // tile that matches is part of the fill as soon as it's seen.
+    uint64_t open_bits(int tx, int y) {
+        int index = m_canvas.tile_index(tx, y / tile_size);
+        int32_t state = m_state[index];
+        if (state == unseen) state = visit(index);
+        if (state < 0) return 0;
+        const Masks& m = *m_masks[state];
+        return m.match[y % tile_size] & ~m.filled[y % tile_size];
+    }
+
+    // Empty tiles the fill has been to can't change any more.
+    bool settled(int index) const {
+        return m_state[index] == all_filled || m_state[index] == blocked;
+    }
+
+    int32_t visit(int index) {
+        const Tile* tile = m_canvas.tile(index);
+        if (!tile) {
+            if (!m_empty_matches) return m_state[index] = blocked;
+            m_state[index] = all_filled;
+            // Everything around it is next to a filled pixel now, except in neighbours that are
+            // already settled.
+            int tx = index % m_canvas.tiles_x();
+            int ty = index / m_canvas.tiles_x();
+            int x0 = tx * tile_size;
+            int y0 = ty * tile_size;
+            int x1 = std::min(x0 + tile_size, m_canvas.width());
+            int y1 = std::min(y0 + tile_size, m_canvas.height());
+            if (ty > 0 && !settled(index - m_canvas.tiles_x())) m_spans.push_back({ y0 - 1, x0, x1 });
+            if (ty + 1 < m_canvas.tiles_y() && !settled(index + m_canvas.tiles_x())) m_spans.push_back({ y1, x0, x1 });
+            bool left = tx > 0 && !settled(index - 1);
+            bool right = tx + 1 < m_canvas.tiles_x() && !settled(index + 1);
+            for (int y = y0; y < y1; y++) {
+                if (left) m_spans.push_back({ y, x0 - 1, x0 });
+                if (right) m_spans.push_back({ y, x1, x1 + 1 });
+            }
+            return all_filled;
+        }
+        auto m = std::make_unique<Masks>();
+        uint64_t edge = edge_bits(index);
+        int rows = std::min(tile_size, m_canvas.height() - index / m_canvas.tiles_x() * tile_size);
+        for (int y = 0; y < tile_size; y++) {
+            m->match[y] = y < rows ? match_bits(tile->row(y), m_target, m_tolerance, m_level) & edge : 0;
+        }
+        m->filled.fill(0);
+        m_masks.push_back(std::move(m));
+        return m_state[index] = int32_t(m_masks.size() - 1);
+    }
+
+    void mark_filled(int y, int x0, int x1) {
+        for (int x = x0; x < x1;) {
+            int tx = x / tile_size;
+            int end = std::min(x1, (tx + 1) * tile_size);
+            int32_t state = m_state[m_canvas.tile_index(tx, y / tile_size)];
+            assert(state >= 0);
+            uint64_t bits = bits_from(x % tile_size);
+            if (end % tile_size) bits &= bits_below(end % tile_size);
+            m_masks[state]->filled[y % tile_size] |= bits;
+            x = end;
+        }
+    }
+
+    // First open pixel in [x, x1), or x1.
+    int next_open(int y, int x, int x1) {
+        while (x < x1) {
+            int tx = x / tile_size;
+            uint64_t bits = open_bits(tx, y) & bits_from(x % tile_size);
+            if (bits) return std::min(tx * tile_size + std::countr_zero(bits), x1);
+            x = (tx + 1) * tile_size;
+        }
+        return x1;
+    }
+
+    // First pixel at or after x that isn't open (x is).
+    int run_end(int y, int x) {
+        while (x < m_canvas.width()) {
+            int tx = x / tile_size;
+            uint64_t closed = ~open_bits(tx, y) & bits_from(x % tile_size);
+            if (closed) return tx * tile_size + std::countr_zero(closed);
+            x = (tx + 1) * tile_size;
+        }
+        return m_canvas.width();
+    }
+
+    // Start of the open run that x is in.
+    int run_start(int y, int x) {
+        for (;;) {
+            int tx = x / tile_size;
+            uint64_t closed = ~open_bits(tx, y) & bits_below(x % tile_size);
+            if (closed) return tx * tile_size + 64 - std::countl_zero(closed);
+            if (tx == 0) return 0;
+            x = tx * tile_size - 1;
+            if (!(open_bits(tx - 1, y) >> (tile_size - 1))) return tx * tile_size;
+        }
+    }
+
+    void scan(const Span& s) {
+        if (s.y < 0 || s.y >= m_canvas.height()) return;
+        int x1 = std::min(s.x1, m_canvas.width());
+        int x = next_open(s.y, std::max(s.x0, 0), x1);
+        while (x < x1) {
+            int start = x == s.x0 ? run_start(s.y, x) : x;
+            int end = run_end(s.y, x);
+            mark_filled(s.y, start, end);
+            m_spans.push_back({ s.y - 1, start, end });
+            m_spans.push_back({ s.y + 1, start, end });
+            x = next_open(s.y, end, x1);
+        }
+    }
+
+    TileCanvas& m_canvas;
+    uint32_t m_target;
+    uint32_t m_tolerance;
+    simd::Level m_level;
+    std::vector<int32_t> m_state;
+    std::vector<std::unique_ptr<Masks>> m_masks;
+    std::vector<Span> m_spans;
+    bool m_empty_matches;
+};
+
+// Fills the 4-connected region around (x, y) of pixels within tolerance (per channel, 0-255) of
+// the one at (x, y) with color, premultiplied. Returns the number of pixels filled. The tiles it
+// changes come out dirty and touched, like any other drawing.
+export int64_t flood_fill(TileCanvas& canvas, int x, int y, uint32_t color, uint32_t tolerance = 0,
+                          simd::Level level = simd::Level::avx2) {
+    if (x < 0 || x >= canvas.width() || y < 0 || y >= canvas.height()) return 0;
+    Filler filler(canvas, canvas.pixel(x, y), std::min(tolerance, 255u), simd::usable_level(level));
+    filler.fill(x, y);
+    return filler.write(color);
+}
+
+}
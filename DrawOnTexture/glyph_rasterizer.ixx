@@ -0,0 +1,167 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+export module glyph_rasterizer;
+
+// What the text cache needs from a font backend: cmap lookups, advances, line metrics and an 8 bit
+// coverage bitmap per glyph. truetype_font implements it on the CPU from .ttf files, so the cache
+// works (and can be measured) without DirectWrite.
+//
+// CoverageRasterizer is the scan converter a CPU backend fills outlines with. It's the signed area
+// accumulation one FreeType's smooth rasterizer and font-rs use: every edge adds its exact area and
+// cover to the cells it crosses, and a running sum along each row gives the coverage, with the
+// nonzero rule. No sorting, no scanline lists, and it's exact for line segments.
+
+namespace text {
+
+// Fonts are numbered by the backend that loaded them.
+export using FontId = uint16_t;
+
+// Pixel sizes, y down from the baseline.
+export struct FontMetrics {
+    float ascent = 0;       // above the baseline, positive
+    float descent = 0;      // below the baseline, positive
+    float line_gap = 0;
+
+    float line_height() const { return ascent + descent + line_gap; }
+};
+
+// An 8 bit coverage image. left/top place its top left corner relative to the pen position on the
+// baseline, y down.
+export struct GlyphBitmap {
+    int width = 0;
+    int height = 0;
+    int left = 0;
+    int top = 0;
+    std::vector<uint8_t> coverage;
+};
+
+export class GlyphRasterizer {
+public:
+    virtual ~GlyphRasterizer() = default;
+
+    // 0 (the missing glyph) for characters the font doesn't have.
+    virtual uint16_t glyph_index(FontId font, char32_t c) const = 0;
+    virtual FontMetrics metrics(FontId font, float size) const = 0;
+    virtual float advance(FontId font, float size, uint16_t glyph) const = 0;
+    virtual float kerning(FontId font, float size, uint16_t left, uint16_t right) const = 0;
+    // subpixel_x in [0, 1) shifts the outline right before it's rasterized. Has to be safe to call
+    // from several threads at once.
+    virtual GlyphBitmap rasterize(FontId font, float size, uint16_t glyph, float subpixel_x) const = 0;
+};
+
+export struct Point {
+    float x, y;
+};
+
+export class CoverageRasterizer {
+public:
+    CoverageRasterizer(int width, int height)
+        : m_width(width), m_height(height), m_cells(size_t(width + 2) * height)
+    {
+        assert(width >= 0 && height >= 0);
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // In pixels, y down. The direction decides the winding; anything outside the bitmap is clipped,
+    // although edges off the left still count towards the cover of the pixels to their right.
+    void line(Point p0, Point p1) {
+        if (p0.y == p1.y) return;
+        float dir = 1;
+        if (p0.y > p1.y) {
+            std::swap(p0, p1);
+            dir = -1;
+        }
+        float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+        float x = p0.x;
+        if (p0.y < 0) x -= p0.y * dxdy;
+        int y_end = std::min(m_height, int(std::ceil(p1.y)));
+        for (int y = std::max(0, int(p0.y)); y < y_end; y++) {
+            float* row = m_cells.data() + size_t(y) * (m_width + 2);
+            float dy = std::min(float(y + 1), p1.y) - std::max(float(y), p0.y);
+            float x_next = x + dxdy * dy;
+            float d = dy * dir;
+            // Clamped, the area all lands in column 0 (or the last one) and the cover is the same.
+            float x0 = std::clamp(std::min(x, x_next), 0.0f, float(m_width));
+            float x1 = std::clamp(std::max(x, x_next), 0.0f, float(m_width));
+            float x0_floor = std::floor(x0);
+            int x0i = int(x0_floor);
+            float x1_ceil = std::ceil(x1);
+            int x1i = int(x1_ceil);
+            if (x1i <= x0i + 1) {
+                // Within one pixel: split by where the middle of the edge is.
+                float xm = 0.5f * (x0 + x1) - x0_floor;
+                row[x0i] += d - d * xm;
+                row[x0i + 1] += d * xm;
+            } else {
+                float s = 1.0f / (x1 - x0);
+                float x0f = x0 - x0_floor;
+                float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+                float x1f = x1 - x1_ceil + 1;
+                float am = 0.5f * s * x1f * x1f;
+                row[x0i] += d * a0;
+                if (x1i == x0i + 2) {
+                    row[x0i + 1] += d * (1 - a0 - am);
+                } else {
+                    float a1 = s * (1.5f - x0f);
+                    row[x0i + 1] += d * (a1 - a0);
+                    for (int xi = x0i + 2; xi < x1i - 1; xi++) {
+                        row[xi] += d * s;
+                    }
+                    float a2 = a1 + float(x1i - x0i - 3) * s;
+                    row[x1i - 1] += d * (1 - a2 - am);
+                }
+                row[x1i] += d * am;
+            }
+            x = x_next;
+        }
+    }
+
+    // Flattened into lines, more of them the more it bends.
+    void quad(Point p0, Point p1, Point p2) {
+        float ddx = p0.x - 2 * p1.x + p2.x;
+        float ddy = p0.y - 2 * p1.y + p2.y;
+        float dev = ddx * ddx + ddy * ddy;
+        if (dev < 0.333f) {
+            line(p0, p2);
+            return;
+        }
+        int n = 1 + int(std::sqrt(std::sqrt(3.0f * dev)));
+        Point prev = p0;
+        for (int i = 1; i <= n; i++) {
+            float t = float(i) / n;
+            float mt = 1 - t;
+            Point p = { mt * mt * p0.x + 2 * mt * t * p1.x + t * t * p2.x,
+                        mt * mt * p0.y + 2 * mt * t * p1.y + t * t * p2.y };
+            line(prev, p);
+            prev = p;
+        }
+    }
+
+    // Coverage, width * height bytes. Leaves the rasterizer cleared for the next shape.
+    void accumulate(uint8_t* out) {
+        for (int y = 0; y < m_height; y++) {
+            float* row = m_cells.data() + size_t(y) * (m_width + 2);
+            float acc = 0;
+            for (int x = 0; x < m_width; x++) {
+                acc += row[x];
+                out[size_t(y) * m_width + x] = uint8_t(std::min(std::abs(acc), 1.0f) * 255.0f + 0.5f);
+            }
+        }
+        std::fill(m_cells.begin(), m_cells.end(), 0.0f);
+    }
+
+private:
+    int m_width;
+    int m_height;
+    std::vector<float> m_cells;     // width + 2 per row: an edge's area can spill one past the end
+};
+
+}
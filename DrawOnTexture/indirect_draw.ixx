@@ -0,0 +1,213 @@
+module;
+
+#include <windows.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+#include <D3Dcompiler.h>
+#include <unknwn.h>
+#include <winrt/base.h>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <vector>
+
+export module indirect_draw;
+
+import cull_kernels;
+import d3d_util;
+import memory_budget;
+
+using winrt::com_ptr;
+using winrt::check_hresult;
+
+// Draws a list of objects with one ExecuteIndirect. The argument buffer comes from culling the
+// objects against the view, either on the CPU (culling::cull_draws() straight into an upload
+// buffer) or on the GPU (cull_cs in cull.hlsl into a default buffer). Each draw sets the texture
+// index root constant through the command signature, so objects can sample different textures.
+//
+// The GPU version's buffers change state (copy dest, UAV, indirect argument); the caller puts
+// gpu_draws() and gpu_count() in its render graph with the accesses record_gpu_cull() and draw()
+// say they need.
+
+namespace gpu {
+
+export class IndirectDrawer {
+public:
+    // draw_root_signature is the one draws are made with; texture_param is its root constant for
+    // gTextureIndex.
+    IndirectDrawer(ID3D12Device* device, ID3D12RootSignature* draw_root_signature, uint32_t texture_param,
+                   std::shared_ptr<MemoryBudget> memory)
+        : m_device(device), m_memory(std::move(memory))
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC args[2] = {};
+        args[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+        args[0].Constant.RootParameterIndex = texture_param;
+        args[0].Constant.DestOffsetIn32BitValues = 0;
+        args[0].Constant.Num32BitValuesToSet = 1;
+        args[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+        D3D12_COMMAND_SIGNATURE_DESC desc = {};
+        desc.ByteStride = sizeof(culling::IndirectDraw);
+        desc.NumArgumentDescs = 2;
+        desc.pArgumentDescs = args;
+        check_hresult(m_device->CreateCommandSignature(&desc, draw_root_signature, __uuidof(m_signature),
+                                                       m_signature.put_void()));
+
+        build_cull_pipeline();
+    }
+
+    uint32_t object_count() const { return uint32_t(m_bounds.size()); }
+
+    // The objects to cull, bounds and draw args in step.
+    void set_objects(std::span<const culling::ObjectBounds> bounds, std::span<const culling::DrawArgs> args) {
+        assert(bounds.size() == args.size());
+        m_bounds.assign(bounds.begin(), bounds.end());
+        m_args.assign(args.begin(), args.end());
+        if (m_bounds.size() > m_capacity || !m_objects) {
+            grow(std::max<uint32_t>(uint32_t(m_bounds.size()), m_capacity * 2));
+        }
+        // cull_cs reads these; nothing's in flight when objects change (the app waits every frame).
+        memcpy(m_objects_mapped, m_bounds.data(), m_bounds.size() * sizeof(culling::ObjectBounds));
+        memcpy(m_objects_mapped + args_offset(), m_args.data(), m_args.size() * sizeof(culling::DrawArgs));
+    }
+
+    // Culls on the CPU into the upload buffer draw(.., false) reads. Returns the draw count.
+    uint32_t cull_cpu(const culling::ObjectBounds& view) {
+        auto draws = reinterpret_cast<culling::IndirectDraw*>(m_cpu_mapped);
+        uint32_t count = culling::cull_draws(m_bounds, m_args, view, draws);
+        memcpy(m_cpu_mapped + count_offset(), &count, sizeof(count));
+        return count;
+    }
+
+    ID3D12Resource* gpu_draws() const { return m_gpu_draws.get(); }
+    ID3D12Resource* gpu_count() const { return m_gpu_count.get(); }
+
+    // Zeroes the GPU draw count. gpu_count() has to be in COPY_DEST.
+    void record_count_reset(ID3D12GraphicsCommandList* list) {
+        list->CopyBufferRegion(m_gpu_count.get(), 0, m_zero.get(), 0, sizeof(uint32_t));
+    }
+
+    // Records cull_cs over the objects. gpu_draws() and gpu_count() have to be in UNORDERED_ACCESS
+    // and the count zeroed. Leaves the compute root signature and pipeline set.
+    void record_gpu_cull(ID3D12GraphicsCommandList* list, const culling::ObjectBounds& view) {
+        if (m_bounds.empty()) return;
+        struct { float min_x, min_y, max_x, max_y; uint32_t count; } constants = {
+            view.min_x, view.min_y, view.max_x, view.max_y, uint32_t(m_bounds.size())
+        };
+        auto objects = m_objects->GetGPUVirtualAddress();
+        list->SetComputeRootSignature(m_cull_root_signature.get());
+        list->SetPipelineState(m_cull_pso.get());
+        list->SetComputeRoot32BitConstants(0, 5, &constants, 0);
+        list->SetComputeRootShaderResourceView(1, objects);
+        list->SetComputeRootShaderResourceView(2, objects + args_offset());
+        list->SetComputeRootUnorderedAccessView(3, m_gpu_draws->GetGPUVirtualAddress());
+        list->SetComputeRootUnorderedAccessView(4, m_gpu_count->GetGPUVirtualAddress());
+        list->Dispatch((uint32_t(m_bounds.size()) + culling::group_size - 1) / culling::group_size, 1, 1);
+    }
+
+    // The draws, with the graphics root signature, pipeline and buffers already set. With gpu the
+    // buffers have to be in INDIRECT_ARGUMENT. The root constant is left undefined afterwards.
+    void draw(ID3D12GraphicsCommandList* list, bool gpu) {
+        if (m_bounds.empty()) return;
+        if (gpu) {
+            list->ExecuteIndirect(m_signature.get(), uint32_t(m_bounds.size()), m_gpu_draws.get(), 0,
+                                  m_gpu_count.get(), 0);
+        } else {
+            list->ExecuteIndirect(m_signature.get(), uint32_t(m_bounds.size()), m_cpu_draws.get(), 0,
+                                  m_cpu_draws.get(), count_offset());
+        }
+    }
+
+private:
+    uint64_t args_offset() const { return uint64_t(m_capacity) * sizeof(culling::ObjectBounds); }
+    uint64_t count_offset() const { return uint64_t(m_capacity) * sizeof(culling::IndirectDraw); }
+
+    void build_cull_pipeline() {
+        CD3DX12_ROOT_PARAMETER1 params[5];
+        params[0].InitAsConstants(5, 0);                    // view and object count, b0
+        params[1].InitAsShaderResourceView(0);              // bounds, t0
+        params[2].InitAsShaderResourceView(1);              // draw args, t1
+        params[3].InitAsUnorderedAccessView(0);             // draws, u0
+        params[4].InitAsUnorderedAccessView(1);             // draw count, u1
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rs_desc;
+        rs_desc.Init_1_1(5, params);
+        com_ptr<ID3DBlob> serialized;
+        com_ptr<ID3DBlob> errors;
+        HRESULT hr = D3DX12SerializeVersionedRootSignature(&rs_desc, D3D_ROOT_SIGNATURE_VERSION_1_1,
+                                                           serialized.put(), errors.put());
+        if (errors) {
+            OutputDebugStringA((char*)errors->GetBufferPointer());
+        }
+        check_hresult(hr);
+        check_hresult(m_device->CreateRootSignature(0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
+                                                    __uuidof(m_cull_root_signature),
+                                                    m_cull_root_signature.put_void()));
+
+        auto cs = d3d_util::compile_shader(L"cull.hlsl", nullptr, "cull_cs", "cs_5_1");
+        D3D12_COMPUTE_PIPELINE_STATE_DESC pso_desc = {};
+        pso_desc.pRootSignature = m_cull_root_signature.get();
+        pso_desc.CS = { cs->GetBufferPointer(), cs->GetBufferSize() };
+        check_hresult(m_device->CreateComputePipelineState(&pso_desc, __uuidof(m_cull_pso), m_cull_pso.put_void()));
+
+        m_zero = d3d_util::create_upload_buffer(m_device, sizeof(uint32_t));
+        void* zero = nullptr;
+        check_hresult(m_zero->Map(0, nullptr, &zero));
+        memset(zero, 0, sizeof(uint32_t));
+        m_zero->Unmap(0, nullptr);
+        d3d_util::track_memory(m_memory, m_zero.get(), MemoryCategory::upload, "indirect zero");
+    }
+
+    // Buffers for capacity objects. Old contents are dropped; set_objects() writes them again.
+    void grow(uint32_t capacity) {
+        m_capacity = std::max<uint32_t>(capacity, 256);
+        if (m_objects) m_objects->Unmap(0, nullptr);
+        if (m_cpu_draws) m_cpu_draws->Unmap(0, nullptr);
+
+        uint64_t objects_size = uint64_t(m_capacity) * (sizeof(culling::ObjectBounds) + sizeof(culling::DrawArgs));
+        m_objects = d3d_util::create_upload_buffer(m_device, objects_size);
+        check_hresult(m_objects->Map(0, nullptr, reinterpret_cast<void**>(&m_objects_mapped)));
+        d3d_util::track_memory(m_memory, m_objects.get(), MemoryCategory::upload, "indirect objects");
+
+        m_cpu_draws = d3d_util::create_upload_buffer(m_device, count_offset() + sizeof(uint32_t));
+        check_hresult(m_cpu_draws->Map(0, nullptr, reinterpret_cast<void**>(&m_cpu_mapped)));
+        d3d_util::track_memory(m_memory, m_cpu_draws.get(), MemoryCategory::upload, "indirect draws (cpu)");
+
+        // Made in the states the render graph imports them in.
+        CD3DX12_HEAP_PROPERTIES heap_props(D3D12_HEAP_TYPE_DEFAULT);
+        auto draws_desc = CD3DX12_RESOURCE_DESC::Buffer(count_offset(), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        m_gpu_draws = nullptr;
+        check_hresult(m_device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &draws_desc,
+                                                        D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, nullptr,
+                                                        __uuidof(m_gpu_draws), m_gpu_draws.put_void()));
+        d3d_util::track_memory(m_memory, m_gpu_draws.get(), MemoryCategory::geometry, "indirect draws (gpu)");
+        if (!m_gpu_count) {
+            auto count_desc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+            check_hresult(m_device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &count_desc,
+                                                            D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, nullptr,
+                                                            __uuidof(m_gpu_count), m_gpu_count.put_void()));
+            d3d_util::track_memory(m_memory, m_gpu_count.get(), MemoryCategory::geometry, "indirect count (gpu)");
+        }
+    }
+
+    ID3D12Device* m_device;
+    std::shared_ptr<MemoryBudget> m_memory;
+    com_ptr<ID3D12CommandSignature> m_signature;
+    com_ptr<ID3D12RootSignature> m_cull_root_signature;
+    com_ptr<ID3D12PipelineState> m_cull_pso;
+
+    std::vector<culling::ObjectBounds> m_bounds;
+    std::vector<culling::DrawArgs> m_args;
+    uint32_t m_capacity = 0;
+
+    com_ptr<ID3D12Resource> m_objects;      // upload: bounds, then draw args at args_offset()
+    uint8_t* m_objects_mapped = nullptr;
+    com_ptr<ID3D12Resource> m_cpu_draws;    // upload: CPU culled draws, then the count at count_offset()
+    uint8_t* m_cpu_mapped = nullptr;
+    com_ptr<ID3D12Resource> m_gpu_draws;
+    com_ptr<ID3D12Resource> m_gpu_count;
+    com_ptr<ID3D12Resource> m_zero;
+};
+
+}
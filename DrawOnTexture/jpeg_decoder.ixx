@@ -0,0 +1,753 @@
+module;
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+export module jpeg_decoder;
+
+// Baseline JPEG decoder that can decode at 1/2, 1/4 or 1/8 size directly, for previews and for
+// textures that are only ever drawn small.
+//
+// The scaled decodes happen in the DCT domain. Averaging the inverse DCT over each k x k group of
+// pixels is itself a linear map from the 64 coefficients, so it's folded into the IDCT's basis:
+// the result is what decoding at full size and box filtering down would give, for a fraction of
+// the work. At 1/8 a block is just its DC coefficient. The entropy decoding still has to read
+// every coefficient, but the IDCT, upsampling and colour conversion only produce the smaller
+// image, and only that is ever stored. Subsampled chroma is decoded at a bigger scale than luma
+// where it can be, the way libjpeg does it, so a 4:2:0 file at 1/2 needs no chroma upsampling.
+//
+// Read: sequential Huffman JPEGs (SOF0 and SOF1) with 8 bit samples, grey or three components
+// (YCbCr, or RGB per Adobe's marker), any sampling factors, restart intervals, and
+// non-interleaved scans. Not read: progressive and arithmetic coded files, 12 bit samples, CMYK;
+// those throw, and the caller can fall back on WIC. Chroma left to upsample is repeated.
+
+namespace image {
+
+// What the decoders here produce.
+export struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;   // RGBA8, 0xAABBGGRR, width * height
+};
+
+export struct JpegInfo {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    bool progressive = false;
+    bool supported = false;     // decode_jpeg() can read it
+};
+
+// Size of one side of the image decoded at 1 / 2^scale_log2.
+export int jpeg_scaled_size(int size, int scale_log2) {
+    return (size + (1 << scale_log2) - 1) >> scale_log2;
+}
+
+// The most the decoder can shrink width x height (0 to 3, for 1/1 to 1/8) and still give at least
+// want_width x want_height, so whatever's left is scaling down by less than 2.
+export int jpeg_scale_for(int width, int height, int want_width, int want_height) {
+    int scale = 0;
+    while (scale < 3 && jpeg_scaled_size(width, scale + 1) >= want_width &&
+           jpeg_scaled_size(height, scale + 1) >= want_height) {
+        scale++;
+    }
+    return scale;
+}
+
+// Index into an 8x8 block for each coefficient in the order the file has them. The 16 extra
+// entries catch a run that goes past the end of a corrupt block.
+const uint8_t natural_order[64 + 16] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63,
+};
+
+// --- entropy decoding ----------------------------------------------------------------------------
+
+constexpr int lookup_bits = 9;
+
+struct HuffmanTable {
+    // Codes of up to lookup_bits bits straight from the next bits: (length << 8) | symbol, or 0 for
+    // a longer code, which goes through maxcode.
+    std::array<uint16_t, 1 << lookup_bits> fast{};
+    // For AC tables, a code and the value bits after it, when both fit in lookup_bits, all in one:
+    // value << 8 | run << 4 | bits used. 0 when they don't fit.
+    std::array<int16_t, 1 << lookup_bits> fast_ac{};
+    std::array<int32_t, 18> maxcode{};      // largest code of each length, -1 for none
+    std::array<int32_t, 17> valptr{};       // values[valptr[length] + code]
+    std::array<uint8_t, 256> values{};
+    bool defined = false;
+
+    void build(const uint8_t* counts, const uint8_t* symbols, int count) {
+        std::copy(symbols, symbols + count, values.begin());
+        fast.fill(0);
+        int32_t code = 0;
+        int k = 0;
+        for (int length = 1; length <= 16; length++) {
+            valptr[length] = k - code;
+            for (int i = 0; i < counts[length - 1]; i++, k++, code++) {
+                if (length <= lookup_bits) {
+                    int shift = lookup_bits - length;
+                    for (int fill = 0; fill < (1 << shift); fill++) {
+                        fast[(code << shift) | fill] = uint16_t(length << 8 | values[k]);
+                    }
+                }
+            }
+            maxcode[length] = counts[length - 1] ? code - 1 : -1;
+            if (code > (1 << length)) {
+                throw std::runtime_error("jpeg: bad huffman table");
+            }
+            code <<= 1;
+        }
+        maxcode[17] = INT32_MAX;
+        for (int i = 0; i < (1 << lookup_bits); i++) {
+            fast_ac[i] = 0;
+            int length = fast[i] >> 8, run = fast[i] >> 4 & 15, size = fast[i] & 15;
+            if (fast[i] == 0 || size == 0 || length + size > lookup_bits) continue;
+            int value = i >> (lookup_bits - length - size) & ((1 << size) - 1);
+            if (value < (1 << (size - 1))) value -= (1 << size) - 1;
+            if (value >= -128 && value <= 127) fast_ac[i] = int16_t(value * 256 + (run << 4) + length + size);
+        }
+        defined = true;
+    }
+};
+
+// Reads the entropy coded data MSB first, dropping the zero byte stuffed after each 0xff. At a
+// marker it stops and feeds zeros, which is what a truncated or corrupt scan decodes from.
+class BitReader {
+public:
+    BitReader(const uint8_t* begin, const uint8_t* end) : m_p(begin), m_end(end) {}
+
+    int decode(const HuffmanTable& table) {
+        if (m_count < 16) fill();
+        uint16_t entry = table.fast[size_t(m_bits >> (64 - lookup_bits))];
+        if (entry) {
+            consume(entry >> 8);
+            return entry & 0xff;
+        }
+        for (int length = lookup_bits + 1; length <= 16; length++) {
+            int32_t code = int32_t(m_bits >> (64 - length));
+            if (code <= table.maxcode[length]) {
+                consume(length);
+                int index = table.valptr[length] + code;
+                if (index < 0 || index > 255) break;
+                return table.values[index];
+            }
+        }
+        throw std::runtime_error("jpeg: bad huffman code");
+    }
+
+    // An AC coefficient's zero run and value. False for a symbol with no value: end of block, or
+    // sixteen zeros when run is 15.
+    bool decode_ac(const HuffmanTable& table, int& run, int& value) {
+        if (m_count < 16) fill();
+        if (int packed = table.fast_ac[size_t(m_bits >> (64 - lookup_bits))]) {
+            consume(packed & 15);
+            run = packed >> 4 & 15;
+            value = packed >> 8;
+            return true;
+        }
+        int rs = decode(table);
+        run = rs >> 4;
+        if ((rs & 15) == 0) return false;
+        value = receive_extend(rs & 15);
+        return true;
+    }
+
+    // The next bits bits as the signed value they code.
+    int receive_extend(int bits) {
+        if (bits == 0) return 0;
+        if (m_count < bits) fill();
+        int value = int(m_bits >> (64 - bits));
+        consume(bits);
+        return value < (1 << (bits - 1)) ? value - (1 << bits) + 1 : value;
+    }
+
+    // Drops what's left of the current interval and steps over the RSTn marker after it.
+    void restart() {
+        m_bits = 0;
+        m_count = 0;
+        m_marker = false;
+        while (m_p + 1 < m_end && !(m_p[0] == 0xff && m_p[1] >= 0xd0 && m_p[1] <= 0xd7)) m_p++;
+        m_p = std::min(m_p + 2, m_end);
+    }
+
+    // Where the marker after the scan is, or somewhere before it.
+    const uint8_t* position() const { return m_p; }
+
+private:
+    void fill() {
+        while (m_count <= 56) {
+            uint64_t byte = 0;
+            if (!m_marker && m_p < m_end) {
+                byte = *m_p;
+                if (byte != 0xff) {
+                    m_p++;
+                } else if (m_p + 1 < m_end && m_p[1] == 0) {
+                    m_p += 2;
+                } else {
+                    m_marker = true;
+                    byte = 0;
+                }
+            }
+            m_bits |= byte << (56 - m_count);
+            m_count += 8;
+        }
+    }
+
+    void consume(int bits) {
+        m_bits <<= bits;
+        m_count -= bits;
+    }
+
+    const uint8_t* m_p;
+    const uint8_t* m_end;
+    uint64_t m_bits = 0;    // next bits at the top
+    int m_count = 0;
+    bool m_marker = false;
+};
+
+// --- inverse DCT ---------------------------------------------------------------------------------
+
+// basis[s][u * 8 + i]: how much coefficient u adds to output sample i of the 1/2^s size IDCT.
+// That's the 8 point IDCT, C(u) / 2 * cos((2x + 1) u pi / 16), averaged over the 2^s full size
+// samples x that output sample i covers.
+struct IdctTables {
+    float basis[4][64];
+};
+
+const IdctTables& idct_tables() {
+    static const IdctTables tables = [] {
+        IdctTables t{};
+        for (int s = 0; s < 4; s++) {
+            int k = 1 << s;
+            for (int u = 0; u < 8; u++) {
+                double c = u == 0 ? std::numbers::sqrt2 / 2 : 1.0;
+                for (int i = 0; i < 8 / k; i++) {
+                    double sum = 0.0;
+                    for (int x = i * k; x < (i + 1) * k; x++) sum += std::cos((2 * x + 1) * u * std::numbers::pi / 16);
+                    t.basis[s][u * 8 + i] = float(c / 2 * sum / k);
+                }
+            }
+        }
+        return t;
+    }();
+    return tables;
+}
+
+uint8_t to_sample(float f) {
+    return uint8_t(std::clamp(f + 128.5f, 0.0f, 255.0f));
+}
+
+// One dimension of the full size IDCT, Arai, Agui and Nakajima's factorization as libjpeg's float
+// IDCT has it: 5 multiplies instead of 64, for inputs premultiplied by aan_scales.
+template <int step>
+void idct_8(const float* in, float* out) {
+    float tmp0 = in[0 * step], tmp1 = in[2 * step], tmp2 = in[4 * step], tmp3 = in[6 * step];
+    float tmp10 = tmp0 + tmp2, tmp11 = tmp0 - tmp2;
+    float tmp13 = tmp1 + tmp3, tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    float tmp4 = in[1 * step], tmp5 = in[3 * step], tmp6 = in[5 * step], tmp7 = in[7 * step];
+    float z13 = tmp6 + tmp5, z10 = tmp6 - tmp5, z11 = tmp4 + tmp7, z12 = tmp4 - tmp7;
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562f;
+    float z5 = (z10 + z12) * 1.847759065f;
+    tmp10 = 1.082392200f * z12 - z5;
+    tmp12 = -2.613125930f * z10 + z5;
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
+
+    out[0 * step] = tmp0 + tmp7;
+    out[7 * step] = tmp0 - tmp7;
+    out[1 * step] = tmp1 + tmp6;
+    out[6 * step] = tmp1 - tmp6;
+    out[2 * step] = tmp2 + tmp5;
+    out[5 * step] = tmp2 - tmp5;
+    out[4 * step] = tmp3 + tmp4;
+    out[3 * step] = tmp3 - tmp4;
+}
+
+// cos(u pi / 16) * sqrt(2) for u > 0, 1 for u = 0, for row times column, over 8.
+const std::array<float, 64>& aan_scales() {
+    static const auto scales = [] {
+        std::array<float, 64> t{};
+        for (int v = 0; v < 8; v++) {
+            for (int u = 0; u < 8; u++) {
+                double sv = v ? std::cos(v * std::numbers::pi / 16) * std::numbers::sqrt2 : 1.0;
+                double su = u ? std::cos(u * std::numbers::pi / 16) * std::numbers::sqrt2 : 1.0;
+                t[v * 8 + u] = float(sv * su / 8);
+            }
+        }
+        return t;
+    }();
+    return scales;
+}
+
+// Reduced sizes multiply through the box filtered basis, which only needs the outputs there are.
+// nx is a template parameter so the inner loops are fixed length.
+template <int nx>
+void idct_reduced(const float* coef, uint32_t rows, int scale_x, int scale_y, uint8_t* out, size_t stride) {
+    const float* basis_x = idct_tables().basis[scale_x];
+    const float* basis_y = idct_tables().basis[scale_y];
+    float tmp[64];
+    for (int v = 0; v < 8; v++) {
+        if (!(rows >> v & 1)) continue;
+        float t[nx] = {};
+        for (int u = 0; u < 8; u++) {
+            float c = coef[v * 8 + u];
+            for (int i = 0; i < nx; i++) t[i] += c * basis_x[u * 8 + i];
+        }
+        std::copy(t, t + nx, tmp + v * 8);
+    }
+    for (int j = 0; j < 8 >> scale_y; j++) {
+        float row[nx] = {};
+        for (int v = 0; v < 8; v++) {
+            if (!(rows >> v & 1)) continue;
+            float w = basis_y[v * 8 + j];
+            for (int i = 0; i < nx; i++) row[i] += w * tmp[v * 8 + i];
+        }
+        for (int i = 0; i < nx; i++) out[j * stride + i] = to_sample(row[i]);
+    }
+}
+
+// Dequantized coefficients (natural order) to 8 >> scale_x by 8 >> scale_y samples. rows has a
+// bit for each coefficient row with anything in it, and last is the last coefficient in file
+// order that isn't zero; most blocks have few.
+void idct(const float* coef, uint32_t rows, int last, int scale_x, int scale_y, uint8_t* out, size_t stride) {
+    int nx = 8 >> scale_x, ny = 8 >> scale_y;
+    if (last == 0 || (nx == 1 && ny == 1)) {
+        // Just DC, which is 8 times the block's mean, and all a 1/8 block needs.
+        uint8_t v = to_sample(coef[0] * 0.125f);
+        for (int j = 0; j < ny; j++) std::memset(out + j * stride, v, nx);
+        return;
+    }
+    float tmp[64];
+    if (nx == 8 && ny == 8) {
+        const auto& scales = aan_scales();
+        float in[64];
+        for (int i = 0; i < 64; i++) in[i] = coef[i] * scales[i];
+        // Columns, then rows. A column with nothing but DC is DC all the way down.
+        for (int u = 0; u < 8; u++) {
+            bool ac = false;
+            for (int v = 1; v < 8; v++) ac |= in[v * 8 + u] != 0.0f;
+            if (ac) {
+                idct_8<8>(in + u, tmp + u);
+            } else {
+                for (int v = 0; v < 8; v++) tmp[v * 8 + u] = in[u];
+            }
+        }
+        for (int j = 0; j < 8; j++) {
+            float row[8];
+            idct_8<1>(tmp + j * 8, row);
+            for (int i = 0; i < 8; i++) out[j * stride + i] = to_sample(row[i]);
+        }
+        return;
+    }
+    switch (nx) {
+    case 8: idct_reduced<8>(coef, rows, scale_x, scale_y, out, stride); break;
+    case 4: idct_reduced<4>(coef, rows, scale_x, scale_y, out, stride); break;
+    case 2: idct_reduced<2>(coef, rows, scale_x, scale_y, out, stride); break;
+    default: idct_reduced<1>(coef, rows, scale_x, scale_y, out, stride); break;
+    }
+}
+
+// --- decoder -------------------------------------------------------------------------------------
+
+struct Component {
+    int id = 0;
+    int h = 1, v = 1;           // sampling factors
+    int quant = 0;
+    int dc_table = 0, ac_table = 0;
+    int dc_pred = 0;
+    int scale_x = 0, scale_y = 0;   // the IDCT's, 1/2^scale; less than the image's when subsampled
+    int plane_width = 0;            // samples, a whole number of MCUs
+    std::vector<uint8_t> plane;
+};
+
+class Decoder {
+public:
+    Decoder(std::span<const uint8_t> data, int scale_log2) : m_data(data), m_scale(scale_log2) {
+        assert(scale_log2 >= 0 && scale_log2 <= 3);
+    }
+
+    // Just the headers up to the frame.
+    JpegInfo info() {
+        JpegInfo info;
+        m_at = 2;
+        expect_soi();
+        while (uint8_t marker = next_marker()) {
+            if (marker == 0xd9) break;
+            size_t length = segment_length();
+            if (is_frame(marker)) {
+                read_frame(marker, m_at + 2);
+                info.width = m_width;
+                info.height = m_height;
+                info.components = int(m_components.size());
+                info.progressive = marker == 0xc2 || marker == 0xc6 || marker == 0xca || marker == 0xce;
+                info.supported = (marker == 0xc0 || marker == 0xc1) && m_precision == 8 &&
+                                  (info.components == 1 || info.components == 3);
+                return info;
+            }
+            m_at += length;
+        }
+        throw std::runtime_error("jpeg: no frame header");
+    }
+
+    DecodedImage decode() {
+        m_at = 2;
+        expect_soi();
+        bool frame = false;
+        while (uint8_t marker = next_marker()) {
+            if (marker == 0xd9) break;
+            size_t length = segment_length();
+            size_t body = m_at + 2;
+            if (is_frame(marker)) {
+                if (marker != 0xc0 && marker != 0xc1) {
+                    throw std::runtime_error(marker == 0xc2 ? "jpeg: progressive files aren't supported"
+                                                            : "jpeg: only baseline and extended huffman are supported");
+                }
+                read_frame(marker, body);
+                start_frame();
+                frame = true;
+            } else if (marker == 0xc4) {
+                read_huffman_tables(body, m_at + length);
+            } else if (marker == 0xdb) {
+                read_quant_tables(body, m_at + length);
+            } else if (marker == 0xdd) {
+                m_restart_interval = u16(body);
+            } else if (marker == 0xee && length >= 14 && std::memcmp(&m_data[body], "Adobe", 5) == 0) {
+                m_adobe_transform = m_data[body + 11];
+            } else if (marker == 0xda) {
+                if (!frame) throw std::runtime_error("jpeg: scan before the frame header");
+                m_at = read_scan(body, m_at + length);
+                continue;
+            }
+            m_at += length;
+        }
+        if (!frame) throw std::runtime_error("jpeg: no frame header");
+        return convert();
+    }
+
+private:
+    static int log2(int n) {
+        int bits = 0;
+        while (n > 1) n >>= 1, bits++;
+        return bits;
+    }
+
+    static bool is_frame(uint8_t marker) {
+        return marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+    }
+
+    uint16_t u16(size_t at) const {
+        if (at + 2 > m_data.size()) throw std::runtime_error("jpeg: read past the end of the file");
+        return uint16_t(m_data[at] << 8 | m_data[at + 1]);
+    }
+
+    uint8_t u8(size_t at) const {
+        if (at >= m_data.size()) throw std::runtime_error("jpeg: read past the end of the file");
+        return m_data[at];
+    }
+
+    void expect_soi() const {
+        if (m_data.size() < 4 || m_data[0] != 0xff || m_data[1] != 0xd8) {
+            throw std::runtime_error("jpeg: not a JPEG file");
+        }
+    }
+
+    // The marker at m_at, skipping fill bytes, with m_at left on its length. 0 at the end.
+    uint8_t next_marker() {
+        while (m_at + 1 < m_data.size() && !(m_data[m_at] == 0xff && m_data[m_at + 1] != 0xff &&
+                                             m_data[m_at + 1] != 0)) {
+            m_at++;
+        }
+        if (m_at + 1 >= m_data.size()) return 0;
+        uint8_t marker = m_data[m_at + 1];
+        m_at += 2;
+        return marker;
+    }
+
+    // Length of the segment at m_at, counting the length itself. Markers without one are 0.
+    size_t segment_length() const {
+        if (m_data[m_at - 1] == 0xd9 || (m_data[m_at - 1] >= 0xd0 && m_data[m_at - 1] <= 0xd7)) return 0;
+        size_t length = u16(m_at);
+        if (length < 2 || m_at + length > m_data.size()) throw std::runtime_error("jpeg: bad segment length");
+        return length;
+    }
+
+    void read_frame(uint8_t, size_t at) {
+        m_precision = u8(at);
+        m_height = u16(at + 1);
+        m_width = u16(at + 3);
+        int count = u8(at + 5);
+        if (m_width == 0 || m_height == 0) throw std::runtime_error("jpeg: zero size image");
+        if (count == 0 || count > 4) throw std::runtime_error("jpeg: bad component count");
+        m_components.assign(count, {});
+        for (int i = 0; i < count; i++) {
+            auto& c = m_components[i];
+            c.id = u8(at + 6 + 3 * i);
+            c.h = u8(at + 7 + 3 * i) >> 4;
+            c.v = u8(at + 7 + 3 * i) & 15;
+            c.quant = u8(at + 8 + 3 * i) & 3;
+            if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4) throw std::runtime_error("jpeg: bad sampling factors");
+        }
+    }
+
+    void start_frame() {
+        if (m_precision != 8) throw std::runtime_error("jpeg: only 8 bit samples are supported");
+        if (m_components.size() != 1 && m_components.size() != 3) {
+            throw std::runtime_error("jpeg: only grey and three component images are supported");
+        }
+        for (const auto& c : m_components) {
+            m_hmax = std::max(m_hmax, c.h);
+            m_vmax = std::max(m_vmax, c.v);
+        }
+        m_mcus_x = (m_width + 8 * m_hmax - 1) / (8 * m_hmax);
+        m_mcus_y = (m_height + 8 * m_vmax - 1) / (8 * m_vmax);
+        // Every block takes at least two bits, a DC code and an end of block, so a damaged header
+        // asking for more blocks than that doesn't get its planes allocated.
+        size_t blocks = 0;
+        for (const auto& c : m_components) blocks += size_t(m_mcus_x) * m_mcus_y * c.h * c.v;
+        if (blocks > 4 * m_data.size()) throw std::runtime_error("jpeg: image is too big for the file");
+        for (auto& c : m_components) {
+            // Chroma at half the resolution decodes at twice the scale, down to full size.
+            c.scale_x = std::max(0, m_scale - log2(m_hmax / c.h));
+            c.scale_y = std::max(0, m_scale - log2(m_vmax / c.v));
+            c.plane_width = m_mcus_x * c.h * (8 >> c.scale_x);
+            c.plane.assign(size_t(c.plane_width) * m_mcus_y * c.v * (8 >> c.scale_y), 0);
+        }
+    }
+
+    void read_huffman_tables(size_t at, size_t end) {
+        while (at < end) {
+            uint8_t tc_th = u8(at);
+            int table_class = tc_th >> 4, slot = tc_th & 3;
+            if (table_class > 1) throw std::runtime_error("jpeg: bad huffman table class");
+            if (at + 17 > end) throw std::runtime_error("jpeg: short huffman table");
+            const uint8_t* counts = &m_data[at + 1];
+            int total = 0;
+            for (int i = 0; i < 16; i++) total += counts[i];
+            if (total > 256 || at + 17 + total > end) throw std::runtime_error("jpeg: bad huffman table");
+            (table_class == 0 ? m_dc_tables : m_ac_tables)[slot].build(counts, &m_data[at + 17], total);
+            at += 17 + total;
+        }
+    }
+
+    // Kept in file (zigzag) order, which is the order coefficients are decoded in.
+    void read_quant_tables(size_t at, size_t end) {
+        while (at < end) {
+            uint8_t pq_tq = u8(at);
+            int precision = pq_tq >> 4, slot = pq_tq & 3;
+            if (precision > 1) throw std::runtime_error("jpeg: bad quantization table");
+            at++;
+            for (int k = 0; k < 64; k++) {
+                m_quant[slot][k] = precision ? u16(at + 2 * k) : u8(at + k);
+            }
+            at += precision ? 128 : 64;
+        }
+    }
+
+    // Returns where marker parsing picks up again, after the entropy coded data.
+    size_t read_scan(size_t at, size_t end) {
+        int count = u8(at);
+        if (count < 1 || count > 4 || at + 1 + 2 * count + 3 > end) throw std::runtime_error("jpeg: bad scan header");
+        std::vector<Component*> scan;
+        for (int i = 0; i < count; i++) {
+            int id = u8(at + 1 + 2 * i);
+            auto it = std::find_if(m_components.begin(), m_components.end(), [&](auto& c) { return c.id == id; });
+            if (it == m_components.end()) throw std::runtime_error("jpeg: scan of an unknown component");
+            it->dc_table = u8(at + 2 + 2 * i) >> 4 & 3;
+            it->ac_table = u8(at + 2 + 2 * i) & 3;
+            if (!m_dc_tables[it->dc_table].defined || !m_ac_tables[it->ac_table].defined) {
+                throw std::runtime_error("jpeg: scan uses a missing huffman table");
+            }
+            it->dc_pred = 0;
+            scan.push_back(&*it);
+        }
+
+        BitReader bits(m_data.data() + end, m_data.data() + m_data.size());
+        int done = 0;
+        auto restart = [&] {
+            if (m_restart_interval && done > 0 && done % m_restart_interval == 0) {
+                bits.restart();
+                for (auto* c : scan) c->dc_pred = 0;
+            }
+            done++;
+        };
+        auto block = [&](Component& c, int bx, int by) {
+            int last = decode_block(bits, c);
+            size_t at = size_t(by) * (8 >> c.scale_y) * c.plane_width + size_t(bx) * (8 >> c.scale_x);
+            idct(m_coef, m_rows, last, c.scale_x, c.scale_y, &c.plane[at], c.plane_width);
+        };
+        if (count == 1) {
+            // Non-interleaved: the component's own blocks, not padded out to whole MCUs.
+            Component& c = *scan[0];
+            int blocks_x = ((m_width * c.h + m_hmax - 1) / m_hmax + 7) / 8;
+            int blocks_y = ((m_height * c.v + m_vmax - 1) / m_vmax + 7) / 8;
+            for (int by = 0; by < blocks_y; by++) {
+                for (int bx = 0; bx < blocks_x; bx++) {
+                    restart();
+                    block(c, bx, by);
+                }
+            }
+        } else {
+            for (int my = 0; my < m_mcus_y; my++) {
+                for (int mx = 0; mx < m_mcus_x; mx++) {
+                    restart();
+                    for (auto* c : scan) {
+                        for (int v = 0; v < c->v; v++) {
+                            for (int h = 0; h < c->h; h++) block(*c, mx * c->h + h, my * c->v + v);
+                        }
+                    }
+                }
+            }
+        }
+        return size_t(bits.position() - m_data.data());
+    }
+
+    // One block's coefficients into m_coef, dequantized. Returns the last one that isn't zero, in
+    // file order.
+    int decode_block(BitReader& bits, Component& c) {
+        std::fill(m_coef, m_coef + 64, 0.0f);
+        const uint16_t* quant = m_quant[c.quant].data();
+        // 8 bit samples have DC differences of at most 11 bits; more is a damaged table or scan.
+        int dc = bits.decode(m_dc_tables[c.dc_table]);
+        if (dc > 11) throw std::runtime_error("jpeg: bad dc difference");
+        c.dc_pred += bits.receive_extend(dc);
+        m_coef[0] = float(c.dc_pred) * quant[0];
+        m_rows = 1;
+        int last = 0;
+        const HuffmanTable& ac = m_ac_tables[c.ac_table];
+        for (int k = 1; k < 64; k++) {
+            int run, value;
+            if (!bits.decode_ac(ac, run, value)) {
+                if (run != 15) break;   // end of block
+                k += 15;
+                continue;
+            }
+            k += run;
+            int at = natural_order[k];
+            m_coef[at] = float(value) * quant[std::min(k, 63)];
+            m_rows |= 1u << (at >> 3);
+            last = k;
+        }
+        return last;
+    }
+
+    DecodedImage convert() const {
+        DecodedImage image;
+        image.width = jpeg_scaled_size(m_width, m_scale);
+        image.height = jpeg_scaled_size(m_height, m_scale);
+        image.pixels.resize(size_t(image.width) * image.height);
+        // Which plane column each output column reads; subsampled components repeat theirs.
+        std::vector<std::vector<int>> columns(m_components.size());
+        for (size_t i = 0; i < m_components.size(); i++) {
+            columns[i].resize(image.width);
+            const auto& c = m_components[i];
+            for (int x = 0; x < image.width; x++) {
+                columns[i][x] = x * (c.h << (m_scale - c.scale_x)) / m_hmax;
+            }
+        }
+        const auto& tables = color_tables();
+        bool rgb = m_components.size() == 3 &&
+                   (m_adobe_transform == 0 ||
+                    (m_components[0].id == 'R' && m_components[1].id == 'G' && m_components[2].id == 'B'));
+        for (int y = 0; y < image.height; y++) {
+            uint32_t* out = &image.pixels[size_t(y) * image.width];
+            auto row = [&](size_t i) {
+                const auto& c = m_components[i];
+                return &c.plane[size_t(y * (c.v << (m_scale - c.scale_y)) / m_vmax) * c.plane_width];
+            };
+            if (m_components.size() == 1) {
+                const uint8_t* g = row(0);
+                for (int x = 0; x < image.width; x++) out[x] = g[x] * 0x010101u | 0xff000000u;
+                continue;
+            }
+            const uint8_t* p0 = row(0);
+            const uint8_t* p1 = row(1);
+            const uint8_t* p2 = row(2);
+            const int* x0 = columns[0].data();
+            const int* x1 = columns[1].data();
+            const int* x2 = columns[2].data();
+            if (rgb) {
+                for (int x = 0; x < image.width; x++) {
+                    out[x] = p0[x0[x]] | p1[x1[x]] << 8 | p2[x2[x]] << 16 | 0xff000000u;
+                }
+                continue;
+            }
+            for (int x = 0; x < image.width; x++) {
+                int luma = p0[x0[x]], cb = p1[x1[x]], cr = p2[x2[x]];
+                uint32_t r = tables.clamp[luma + tables.cr_r[cr] + 256];
+                uint32_t g = tables.clamp[luma + ((tables.cb_g[cb] + tables.cr_g[cr]) >> 16) + 256];
+                uint32_t b = tables.clamp[luma + tables.cb_b[cb] + 256];
+                out[x] = r | g << 8 | b << 16 | 0xff000000u;
+            }
+        }
+        return image;
+    }
+
+    // JFIF's YCbCr to RGB in 16.16 fixed point, libjpeg style.
+    struct ColorTables {
+        int cr_r[256], cb_b[256], cr_g[256], cb_g[256];
+        uint8_t clamp[256 * 3];     // index + 256
+    };
+
+    static const ColorTables& color_tables() {
+        static const ColorTables tables = [] {
+            ColorTables t;
+            for (int i = 0; i < 256; i++) {
+                int c = i - 128;
+                t.cr_r[i] = int(std::lround(1.40200 * c));
+                t.cb_b[i] = int(std::lround(1.77200 * c));
+                t.cr_g[i] = int(std::lround(-0.71414 * 65536 * c));
+                t.cb_g[i] = int(std::lround(-0.34414 * 65536 * c)) + 32768;
+            }
+            for (int i = 0; i < 256 * 3; i++) t.clamp[i] = uint8_t(std::clamp(i - 256, 0, 255));
+            return t;
+        }();
+        return tables;
+    }
+
+    std::span<const uint8_t> m_data;
+    int m_scale;
+    size_t m_at = 0;
+    int m_precision = 8;
+    int m_width = 0, m_height = 0;
+    int m_hmax = 1, m_vmax = 1;
+    int m_mcus_x = 0, m_mcus_y = 0;
+    int m_restart_interval = 0;
+    int m_adobe_transform = -1;
+    std::vector<Component> m_components;
+    std::array<HuffmanTable, 4> m_dc_tables;
+    std::array<HuffmanTable, 4> m_ac_tables;
+    std::array<std::array<uint16_t, 64>, 4> m_quant{};
+    float m_coef[64];
+    uint32_t m_rows = 0;
+};
+
+export JpegInfo read_jpeg_info(std::span<const uint8_t> data) {
+    return Decoder(data, 0).info();
+}
+
+// Decodes at 1 / 2^scale_log2 of the full size (scale_log2 0 to 3). Throws for anything it can't
+// read; read_jpeg_info() says up front.
+export DecodedImage decode_jpeg(std::span<const uint8_t> data, int scale_log2 = 0) {
+    return Decoder(data, std::clamp(scale_log2, 0, 3)).decode();
+}
+
+}
@@ -0,0 +1,261 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module memory_budget;
+
+// Accounting for GPU memory. Every resource the app creates is tracked with a category and a size,
+// which gives current and peak use per category and how much was allocated and freed each frame.
+//
+// Going over the budget doesn't fail anything. enforce() is called at a safe point (the start of a
+// frame, when nothing recorded yet uses the memory) and asks the evictors, lowest priority value
+// first, to let go of things until use fits again. Evictors free memory by dropping resources,
+// which untracks them; what they return is only for the log.
+//
+// Knows nothing about D3D, so it can be driven with made up allocation traces.
+
+namespace gpu {
+
+export enum class MemoryCategory : uint8_t {
+    texture,
+    geometry,
+    upload,
+    render_target,
+    readback,
+    count
+};
+
+export const char* category_name(MemoryCategory c) {
+    switch (c) {
+    case MemoryCategory::texture:       return "texture";
+    case MemoryCategory::geometry:      return "geometry";
+    case MemoryCategory::upload:        return "upload";
+    case MemoryCategory::render_target: return "render target";
+    case MemoryCategory::readback:      return "readback";
+    default:                            return "?";
+    }
+}
+
+export using AllocationId = uint64_t;
+
+// Asked to free at least bytes_over bytes (it's fine to free less). Returns how much it freed.
+export using Evictor = std::function<uint64_t(uint64_t bytes_over)>;
+
+export struct CategoryStats {
+    uint64_t current = 0;
+    uint64_t peak = 0;
+    uint32_t count = 0;
+};
+
+export struct MemoryStats {
+    std::array<CategoryStats, size_t(MemoryCategory::count)> categories;
+    uint64_t current = 0;
+    uint64_t peak = 0;
+    uint64_t budget = 0;
+    // Churn during the last finished frame (see end_frame()).
+    uint64_t frame_allocated = 0;
+    uint64_t frame_freed = 0;
+    uint64_t frames = 0;
+    // Totals over all enforce() calls.
+    uint64_t evicted = 0;
+    uint32_t evictions = 0;
+    uint32_t over_budget = 0;  // enforce() calls that couldn't get under budget
+
+    const CategoryStats& operator[](MemoryCategory c) const { return categories[size_t(c)]; }
+};
+
+export class MemoryBudget {
+public:
+    explicit MemoryBudget(uint64_t budget) : m_budget(budget) {}
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    uint64_t budget() const {
+        std::lock_guard lock(m_mutex);
+        return m_budget;
+    }
+
+    void set_budget(uint64_t budget) {
+        std::lock_guard lock(m_mutex);
+        m_budget = budget;
+    }
+
+    // Resources get created from the startup task graph's threads, so tracking is locked.
+    AllocationId track(MemoryCategory category, uint64_t bytes, std::string name = {}) {
+        assert(category < MemoryCategory::count);
+        std::lock_guard lock(m_mutex);
+        AllocationId id = m_next_id++;
+        m_allocations.emplace(id, Allocation{ category, bytes, std::move(name) });
+        CategoryStats& c = m_categories[size_t(category)];
+        c.current += bytes;
+        c.peak = std::max(c.peak, c.current);
+        c.count++;
+        m_current += bytes;
+        m_peak = std::max(m_peak, m_current);
+        m_frame_allocated += bytes;
+        return id;
+    }
+
+    void untrack(AllocationId id) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_allocations.find(id);
+        assert(it != m_allocations.end());
+        if (it == m_allocations.end()) return;
+        CategoryStats& c = m_categories[size_t(it->second.category)];
+        c.current -= it->second.bytes;
+        c.count--;
+        m_current -= it->second.bytes;
+        m_frame_freed += it->second.bytes;
+        m_allocations.erase(it);
+    }
+
+    // Lower priority values are asked first: things that are cheap to make again go early.
+    int add_evictor(std::string name, int priority, Evictor evict) {
+        std::lock_guard lock(m_mutex);
+        int id = m_next_evictor++;
+        auto at = std::upper_bound(m_evictors.begin(), m_evictors.end(), priority,
+                                   [](int p, const EvictorEntry& e) { return p < e.priority; });
+        m_evictors.insert(at, { id, priority, std::move(name), std::move(evict) });
+        return id;
+    }
+
+    void remove_evictor(int id) {
+        std::lock_guard lock(m_mutex);
+        std::erase_if(m_evictors, [&](const EvictorEntry& e) { return e.id == id; });
+    }
+
+    // Runs evictors in priority order until current use plus headroom fits the budget. Pass the
+    // size of something about to be created as headroom to make room for it first. Returns
+    // whether it fits. Evictors run without the lock held, so they can drop tracked resources.
+    bool enforce(uint64_t headroom = 0) {
+        std::vector<EvictorEntry> evictors;
+        {
+            std::lock_guard lock(m_mutex);
+            if (m_current + headroom <= m_budget) return true;
+            evictors = m_evictors;
+        }
+        for (auto& e : evictors) {
+            uint64_t over = bytes_over(headroom);
+            if (over == 0) break;
+            uint64_t freed = e.evict(over);
+            std::lock_guard lock(m_mutex);
+            if (freed > 0) {
+                m_evicted += freed;
+                m_evictions++;
+            }
+        }
+        bool fits = bytes_over(headroom) == 0;
+        if (!fits) {
+            std::lock_guard lock(m_mutex);
+            m_over_budget++;
+        }
+        return fits;
+    }
+
+    // Closes the frame's churn counters; stats() reports the frame just closed.
+    void end_frame() {
+        std::lock_guard lock(m_mutex);
+        m_last_frame_allocated = std::exchange(m_frame_allocated, 0);
+        m_last_frame_freed = std::exchange(m_frame_freed, 0);
+        m_frames++;
+    }
+
+    MemoryStats stats() const {
+        std::lock_guard lock(m_mutex);
+        MemoryStats s;
+        s.categories = m_categories;
+        s.current = m_current;
+        s.peak = m_peak;
+        s.budget = m_budget;
+        s.frame_allocated = m_last_frame_allocated;
+        s.frame_freed = m_last_frame_freed;
+        s.frames = m_frames;
+        s.evicted = m_evicted;
+        s.evictions = m_evictions;
+        s.over_budget = m_over_budget;
+        return s;
+    }
+
+    // Text dump for the debug output: totals, one line per category, then the largest allocations.
+    std::string dump(size_t largest = 5) const {
+        MemoryStats s = stats();
+        std::string out = std::format("gpu memory: {} of {} budget, peak {}, last frame +{} -{}, evicted {} in {} calls\n",
+                                      mib(s.current), mib(s.budget), mib(s.peak), mib(s.frame_allocated),
+                                      mib(s.frame_freed), mib(s.evicted), s.evictions);
+        for (size_t i = 0; i < s.categories.size(); i++) {
+            const CategoryStats& c = s.categories[i];
+            out += std::format("  {:<14} {:>10} peak {:>10} ({} allocations)\n",
+                               category_name(MemoryCategory(i)), mib(c.current), mib(c.peak), c.count);
+        }
+
+        std::vector<Allocation> top;
+        {
+            std::lock_guard lock(m_mutex);
+            for (auto& [id, a] : m_allocations) top.push_back(a);
+        }
+        largest = std::min(largest, top.size());
+        std::partial_sort(top.begin(), top.begin() + largest, top.end(),
+                          [](const Allocation& a, const Allocation& b) { return a.bytes > b.bytes; });
+        for (size_t i = 0; i < largest; i++) {
+            out += std::format("  {:>10}  {} ({})\n", mib(top[i].bytes),
+                               top[i].name.empty() ? "unnamed" : top[i].name, category_name(top[i].category));
+        }
+        return out;
+    }
+
+private:
+    struct Allocation {
+        MemoryCategory category;
+        uint64_t bytes;
+        std::string name;
+    };
+
+    struct EvictorEntry {
+        int id;
+        int priority;
+        std::string name;
+        Evictor evict;
+    };
+
+    static std::string mib(uint64_t bytes) {
+        return std::format("{:.2f} MB", bytes / (1024.0 * 1024.0));
+    }
+
+    uint64_t bytes_over(uint64_t headroom) const {
+        std::lock_guard lock(m_mutex);
+        return m_current + headroom > m_budget ? m_current + headroom - m_budget : 0;
+    }
+
+    mutable std::mutex m_mutex;
+    uint64_t m_budget;
+    uint64_t m_current = 0;
+    uint64_t m_peak = 0;
+    std::array<CategoryStats, size_t(MemoryCategory::count)> m_categories{};
+    std::unordered_map<AllocationId, Allocation> m_allocations;
+    AllocationId m_next_id = 1;
+
+    uint64_t m_frame_allocated = 0;
+    uint64_t m_frame_freed = 0;
+    uint64_t m_last_frame_allocated = 0;
+    uint64_t m_last_frame_freed = 0;
+    uint64_t m_frames = 0;
+
+    std::vector<EvictorEntry> m_evictors;  // sorted by priority
+    int m_next_evictor = 0;
+    uint64_t m_evicted = 0;
+    uint32_t m_evictions = 0;
+    uint32_t m_over_budget = 0;
+};
+
+}
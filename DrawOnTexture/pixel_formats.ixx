@@ -0,0 +1,520 @@
+module;
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include "simd.h"
+
+export module pixel_formats;
+
+import half_float;
+
+// Pixel format conversions for texture load and readback: RGBA<->BGRA swizzle, premultiply and
+// unpremultiply, UNORM8 <-> 16F packing, and sRGB <-> linear.
+//
+// All of them take (dst, src, count in pixels). The ones where dst and src have the same pixel
+// size can run in place (dst == src). StoreMode::streaming uses non-temporal stores, for big
+// one-shot conversions (a whole decoded image, a readback) that would otherwise push everything
+// useful out of the cache.
+//
+// The arithmetic kernels have SSE4.1/AVX2 versions that give the same bits as the scalar ones.
+// sRGB goes through lookup tables: 256 entries for 8 bit sRGB in, and 64K entries indexed by the
+// half float bits for linear in, which is exact for every input and faster than gathers would be.
+
+namespace pixel {
+
+export enum class StoreMode {
+    cached,
+    streaming,
+};
+
+// --- scalar reference ----------------------------------------------------------------------------
+
+uint32_t unpremul_channel(uint32_t c, uint32_t a) {
+    float v = static_cast<float>(c) * 255.0f;
+    v = v / static_cast<float>(a);
+    return std::min<uint32_t>(static_cast<uint32_t>(std::lrint(v)), 255);
+}
+
+// Clamp to [0,1] the way SSE max/min do it (NaN goes to 0), then scale and round to even.
+uint32_t float_to_unorm8(float f) {
+    f = f > 0.0f ? f : 0.0f;
+    f = f < 1.0f ? f : 1.0f;
+    return static_cast<uint32_t>(std::lrint(f * 255.0f));
+}
+
+double srgb_decode(double c) {
+    return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+double srgb_encode(double l) {
+    return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+}
+
+struct SrgbTables {
+    std::array<float, 256> to_linear_float;
+    std::array<uint16_t, 256> to_linear_half;
+    std::array<uint16_t, 256> unorm_half;           // plain c/255, for alpha
+    std::array<uint8_t, 65536> half_to_srgb;        // linear half -> sRGB8
+    std::array<uint8_t, 65536> half_to_unorm;       // half -> UNORM8, for alpha
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            to_linear_float[i] = static_cast<float>(srgb_decode(i / 255.0));
+            to_linear_half[i] = float_to_half(to_linear_float[i]);
+            unorm_half[i] = float_to_half(static_cast<float>(i) / 255.0f);
+        }
+        for (int h = 0; h < 65536; h++) {
+            float f = half_to_float(static_cast<uint16_t>(h));
+            double l = f > 0.0f ? std::min(f, 1.0f) : 0.0;   // also sends NaN to 0
+            half_to_srgb[h] = static_cast<uint8_t>(std::lround(srgb_encode(l) * 255.0));
+            half_to_unorm[h] = static_cast<uint8_t>(float_to_unorm8(f));
+        }
+    }
+};
+
+const SrgbTables& srgb_tables() {
+    // ~130KB; built on first use rather than at startup.
+    static const auto tables = std::make_unique<SrgbTables>();
+    return *tables;
+}
+
+struct Swizzle {
+    using Dst = uint32_t;
+    using Src = uint32_t;
+    static constexpr size_t dst_pixel_bytes = 4;
+    static constexpr size_t src_pixel_bytes = 4;
+
+    static void scalar(Dst* dst, const Src* src, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t p = src[i];
+            dst[i] = (p & 0xff00ff00u) | ((p & 0xffu) << 16) | ((p >> 16) & 0xffu);
+        }
+    }
+#if SIMD_X86
+    template <bool NT> static size_t sse41(Dst* dst, const Src* src, size_t count);
+    template <bool NT> static size_t avx2(Dst* dst, const Src* src, size_t count);
+#endif
+};
+
+struct Premultiply {
+    using Dst = uint32_t;
+    using Src = uint32_t;
+    static constexpr size_t dst_pixel_bytes = 4;
+    static constexpr size_t src_pixel_bytes = 4;
+
+    static void scalar(Dst* dst, const Src* src, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t p = src[i];
+            uint32_t a = p >> 24;
+            dst[i] = (a << 24) | (mul255((p >> 16) & 0xff, a) << 16) | (mul255((p >> 8) & 0xff, a) << 8) | mul255(p & 0xff, a);
+        }
+    }
+#if SIMD_X86
+    template <bool NT> static size_t sse41(Dst* dst, const Src* src, size_t count);
+    template <bool NT> static size_t avx2(Dst* dst, const Src* src, size_t count);
+#endif
+};
+
+struct Unpremultiply {
+    using Dst = uint32_t;
+    using Src = uint32_t;
+    static constexpr size_t dst_pixel_bytes = 4;
+    static constexpr size_t src_pixel_bytes = 4;
+
+    static void scalar(Dst* dst, const Src* src, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t p = src[i];
+            uint32_t a = p >> 24;
+            if (a == 0) {
+                dst[i] = 0;
+                continue;
+            }
+            dst[i] = (a << 24) | (unpremul_channel((p >> 16) & 0xff, a) << 16) |
+                     (unpremul_channel((p >> 8) & 0xff, a) << 8) | unpremul_channel(p & 0xff, a);
+        }
+    }
+#if SIMD_X86
+    template <bool NT> static size_t sse41(Dst* dst, const Src* src, size_t count);
+    template <bool NT> static size_t avx2(Dst* dst, const Src* src, size_t count);
+#endif
+};
+
+struct UnormToHalf {
+    using Dst = uint16_t;
+    using Src = uint32_t;
+    static constexpr size_t dst_pixel_bytes = 8;
+    static constexpr size_t src_pixel_bytes = 4;
+
+    static void scalar(Dst* dst, const Src* src, size_t count) {
+        const auto& t = srgb_tables();
+        for (size_t i = 0; i < count; i++) {
+            for (int c = 0; c < 4; c++) {
+                dst[4 * i + c] = t.unorm_half[(src[i] >> (8 * c)) & 0xff];
+            }
+        }
+    }
+#if SIMD_X86
+    template <bool NT> static size_t sse41(Dst* dst, const Src* src, size_t count);
+    template <bool NT> static size_t avx2(Dst* dst, const Src* src, size_t count);
+#endif
+};
+
+struct HalfToUnorm {
+    using Dst = uint32_t;
+    using Src = uint16_t;
+    static constexpr size_t dst_pixel_bytes = 4;
+    static constexpr size_t src_pixel_bytes = 8;
+
+    static void scalar(Dst* dst, const Src* src, size_t count) {
+        const auto& t = srgb_tables();
+        for (size_t i = 0; i < count; i++) {
+            const uint16_t* h = src + 4 * i;
+            dst[i] = t.half_to_unorm[h[0]] | (t.half_to_unorm[h[1]] << 8) |
+                     (t.half_to_unorm[h[2]] << 16) | (uint32_t(t.half_to_unorm[h[3]]) << 24);
+        }
+    }
+#if SIMD_X86
+    template <bool NT> static size_t sse41(Dst* dst, const Src* src, size_t count);
+    template <bool NT> static size_t avx2(Dst* dst, const Src* src, size_t count);
+#endif
+};
+
+#if SIMD_X86
+
+// --- SSE4.1 / AVX2 -------------------------------------------------------------------------------
+
+template <bool NT>
+SIMD_TARGET_SSE41 inline void store128(void* p, __m128i v) {
+    if constexpr (NT) {
+        _mm_stream_si128(static_cast<__m128i*>(p), v);
+    } else {
+        _mm_storeu_si128(static_cast<__m128i*>(p), v);
+    }
+}
+
+template <bool NT>
+SIMD_TARGET_AVX2 inline void store256(void* p, __m256i v) {
+    if constexpr (NT) {
+        _mm256_stream_si256(static_cast<__m256i*>(p), v);
+    } else {
+        _mm256_storeu_si256(static_cast<__m256i*>(p), v);
+    }
+}
+
+template <bool NT>
+SIMD_TARGET_SSE41 size_t Swizzle::sse41(Dst* dst, const Src* src, size_t count) {
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        store128<NT>(dst + i, _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_AVX2 size_t Swizzle::avx2(Dst* dst, const Src* src, size_t count) {
+    const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        store256<NT>(dst + i, _mm256_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_SSE41 size_t Premultiply::sse41(Dst* dst, const Src* src, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+    // Multiplying alpha by 255 leaves it as is.
+    const __m128i alpha_one = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        lo = mul255_sse(lo, _mm_or_si128(_mm_shuffle_epi8(lo, alpha), alpha_one));
+        hi = mul255_sse(hi, _mm_or_si128(_mm_shuffle_epi8(hi, alpha), alpha_one));
+        store128<NT>(dst + i, _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_AVX2 size_t Premultiply::avx2(Dst* dst, const Src* src, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1,
+                                           6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+    const __m256i alpha_one = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = _mm256_unpacklo_epi8(v, zero);
+        __m256i hi = _mm256_unpackhi_epi8(v, zero);
+        lo = mul255_avx2(lo, _mm256_or_si256(_mm256_shuffle_epi8(lo, alpha), alpha_one));
+        hi = mul255_avx2(hi, _mm256_or_si256(_mm256_shuffle_epi8(hi, alpha), alpha_one));
+        store256<NT>(dst + i, _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+// One pixel (4 x int32) at a time: c * 255 / a in float, same ops as unpremul_channel().
+SIMD_TARGET_SSE41 inline __m128i unpremul_sse(__m128i p) {
+    __m128i a = _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(p), _mm_set1_ps(255.0f));
+    v = _mm_div_ps(v, _mm_cvtepi32_ps(a));
+    __m128i r = _mm_min_epi32(_mm_cvtps_epi32(v), _mm_set1_epi32(255));
+    r = _mm_blend_epi16(r, p, 0xc0);    // alpha unchanged
+    return _mm_andnot_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), r);
+}
+
+SIMD_TARGET_AVX2 inline __m256i unpremul_avx2(__m256i p) {
+    __m256i a = _mm256_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3));
+    __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(p), _mm256_set1_ps(255.0f));
+    v = _mm256_div_ps(v, _mm256_cvtepi32_ps(a));
+    __m256i r = _mm256_min_epi32(_mm256_cvtps_epi32(v), _mm256_set1_epi32(255));
+    r = _mm256_blend_epi32(r, p, 0x88);
+    return _mm256_andnot_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()), r);
+}
+
+template <bool NT>
+SIMD_TARGET_SSE41 size_t Unpremultiply::sse41(Dst* dst, const Src* src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i p0 = unpremul_sse(_mm_cvtepu8_epi32(v));
+        __m128i p1 = unpremul_sse(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4)));
+        __m128i p2 = unpremul_sse(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+        __m128i p3 = unpremul_sse(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12)));
+        __m128i r = _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3));
+        store128<NT>(dst + i, r);
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_AVX2 size_t Unpremultiply::avx2(Dst* dst, const Src* src, size_t count) {
+    // The packs below interleave pixels across the 128 bit lanes; this puts them back.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i* s = reinterpret_cast<const __m128i*>(src + i);
+        __m128i v0 = _mm_loadu_si128(s);
+        __m128i v1 = _mm_loadu_si128(s + 1);
+        __m256i p0 = unpremul_avx2(_mm256_cvtepu8_epi32(v0));
+        __m256i p1 = unpremul_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(v0, 8)));
+        __m256i p2 = unpremul_avx2(_mm256_cvtepu8_epi32(v1));
+        __m256i p3 = unpremul_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(v1, 8)));
+        __m256i r = _mm256_packus_epi16(_mm256_packus_epi32(p0, p1), _mm256_packus_epi32(p2, p3));
+        store256<NT>(dst + i, _mm256_permutevar8x32_epi32(r, order));
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_SSE41 size_t UnormToHalf::sse41(Dst* dst, const Src* src, size_t count) {
+    // Multiplying by 1/255 instead of dividing gives the same half for all 256 inputs.
+    const __m128 inv255 = _mm_set1_ps(1.0f / 255.0f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i h[4];
+        for (int k = 0; k < 4; k++) {
+            __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), inv255);
+            h[k] = float_to_half_sse(f);
+            v = _mm_srli_si128(v, 4);
+        }
+        store128<NT>(dst + 4 * i, _mm_packus_epi32(h[0], h[1]));
+        store128<NT>(dst + 4 * i + 8, _mm_packus_epi32(h[2], h[3]));
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_AVX2 size_t UnormToHalf::avx2(Dst* dst, const Src* src, size_t count) {
+    const __m256 inv255 = _mm256_set1_ps(1.0f / 255.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i* s = reinterpret_cast<const __m128i*>(src + i);
+        __m128i v[2] = { _mm_loadu_si128(s), _mm_loadu_si128(s + 1) };
+        __m256i h[4];
+        for (int k = 0; k < 4; k++) {
+            __m128i bytes = (k & 1) ? _mm_srli_si128(v[k / 2], 8) : v[k / 2];
+            __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), inv255);
+            h[k] = float_to_half_avx2(f);
+        }
+        __m256i r0 = _mm256_permute4x64_epi64(_mm256_packus_epi32(h[0], h[1]), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i r1 = _mm256_permute4x64_epi64(_mm256_packus_epi32(h[2], h[3]), _MM_SHUFFLE(3, 1, 2, 0));
+        store256<NT>(dst + 4 * i, r0);
+        store256<NT>(dst + 4 * i + 16, r1);
+    }
+    return i;
+}
+
+SIMD_TARGET_SSE41 inline __m128i half_to_unorm_sse(__m128i h) {
+    __m128 f = half_to_float_sse(h);
+    f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvtps_epi32(_mm_mul_ps(f, _mm_set1_ps(255.0f)));
+}
+
+SIMD_TARGET_AVX2 inline __m256i half_to_unorm_avx2(__m256i h) {
+    __m256 f = half_to_float_avx2(h);
+    f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    return _mm256_cvtps_epi32(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)));
+}
+
+template <bool NT>
+SIMD_TARGET_SSE41 size_t HalfToUnorm::sse41(Dst* dst, const Src* src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i* s = reinterpret_cast<const __m128i*>(src + 4 * i);
+        __m128i v0 = _mm_loadu_si128(s);
+        __m128i v1 = _mm_loadu_si128(s + 1);
+        __m128i p0 = half_to_unorm_sse(_mm_cvtepu16_epi32(v0));
+        __m128i p1 = half_to_unorm_sse(_mm_cvtepu16_epi32(_mm_srli_si128(v0, 8)));
+        __m128i p2 = half_to_unorm_sse(_mm_cvtepu16_epi32(v1));
+        __m128i p3 = half_to_unorm_sse(_mm_cvtepu16_epi32(_mm_srli_si128(v1, 8)));
+        store128<NT>(dst + i, _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3)));
+    }
+    return i;
+}
+
+template <bool NT>
+SIMD_TARGET_AVX2 size_t HalfToUnorm::avx2(Dst* dst, const Src* src, size_t count) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i* s = reinterpret_cast<const __m256i*>(src + 4 * i);
+        __m256i v0 = _mm256_loadu_si256(s);
+        __m256i v1 = _mm256_loadu_si256(s + 1);
+        __m256i p0 = half_to_unorm_avx2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v0)));
+        __m256i p1 = half_to_unorm_avx2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v0, 1)));
+        __m256i p2 = half_to_unorm_avx2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v1)));
+        __m256i p3 = half_to_unorm_avx2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v1, 1)));
+        __m256i r = _mm256_packus_epi16(_mm256_packus_epi32(p0, p1), _mm256_packus_epi32(p2, p3));
+        store256<NT>(dst + i, _mm256_permutevar8x32_epi32(r, order));
+    }
+    return i;
+}
+
+#endif // SIMD_X86
+
+// --- dispatch ------------------------------------------------------------------------------------
+
+// Runs Op over count pixels. For streaming stores, scalar handles the pixels before dst is aligned
+// for the vector width, then the SIMD loop, then scalar again for the tail.
+template <class Op>
+void run(typename Op::Dst* dst, const typename Op::Src* src, size_t count, StoreMode store, simd::Level level) {
+    constexpr size_t dst_elems = Op::dst_pixel_bytes / sizeof(typename Op::Dst);
+    constexpr size_t src_elems = Op::src_pixel_bytes / sizeof(typename Op::Src);
+    size_t done = 0;
+#if SIMD_X86
+    level = simd::usable_level(level);
+    if (level != simd::Level::scalar) {
+        size_t align = level == simd::Level::avx2 ? 32 : 16;
+        size_t misalign = (align - reinterpret_cast<uintptr_t>(dst) % align) % align;
+        bool streaming = store == StoreMode::streaming && misalign % Op::dst_pixel_bytes == 0;
+        if (streaming) {
+            done = std::min(count, misalign / Op::dst_pixel_bytes);
+            Op::scalar(dst, src, done);
+        }
+        auto d = dst + done * dst_elems;
+        auto s = src + done * src_elems;
+        size_t n = count - done;
+        if (level == simd::Level::avx2) {
+            done += streaming ? Op::template avx2<true>(d, s, n) : Op::template avx2<false>(d, s, n);
+        } else {
+            done += streaming ? Op::template sse41<true>(d, s, n) : Op::template sse41<false>(d, s, n);
+        }
+        if (streaming) {
+            _mm_sfence();
+        }
+    }
+#endif
+    Op::scalar(dst + done * dst_elems, src + done * src_elems, count - done);
+}
+
+// --- public API ----------------------------------------------------------------------------------
+
+// RGBA8 <-> BGRA8. The same shuffle goes both ways.
+export void swizzle_rgba_bgra(uint32_t* dst, const uint32_t* src, size_t count,
+                              StoreMode store = StoreMode::cached, simd::Level level = simd::Level::avx2) {
+    run<Swizzle>(dst, src, count, store, level);
+}
+
+// Straight to premultiplied alpha, 8 bit, channel order doesn't matter as long as alpha is last.
+export void premultiply_rgba8(uint32_t* dst, const uint32_t* src, size_t count,
+                              StoreMode store = StoreMode::cached, simd::Level level = simd::Level::avx2) {
+    run<Premultiply>(dst, src, count, store, level);
+}
+
+// Premultiplied back to straight alpha. Fully transparent pixels become 0.
+export void unpremultiply_rgba8(uint32_t* dst, const uint32_t* src, size_t count,
+                                StoreMode store = StoreMode::cached, simd::Level level = simd::Level::avx2) {
+    run<Unpremultiply>(dst, src, count, store, level);
+}
+
+// UNORM8 to 16F, c/255 per channel. dst holds 4 halves per pixel.
+export void unorm8_to_half(uint16_t* dst, const uint32_t* src, size_t count,
+                           StoreMode store = StoreMode::cached, simd::Level level = simd::Level::avx2) {
+    run<UnormToHalf>(dst, src, count, store, level);
+}
+
+// 16F to UNORM8, clamped to [0,1] and rounded to nearest.
+export void half_to_unorm8(uint32_t* dst, const uint16_t* src, size_t count,
+                           StoreMode store = StoreMode::cached, simd::Level level = simd::Level::avx2) {
+    run<HalfToUnorm>(dst, src, count, store, level);
+}
+
+// sRGB8 to linear 16F. Alpha is linear already and is just rescaled.
+export void srgb8_to_linear_half(uint16_t* dst, const uint32_t* src, size_t count) {
+    const auto& t = srgb_tables();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t p = src[i];
+        dst[4 * i + 0] = t.to_linear_half[p & 0xff];
+        dst[4 * i + 1] = t.to_linear_half[(p >> 8) & 0xff];
+        dst[4 * i + 2] = t.to_linear_half[(p >> 16) & 0xff];
+        dst[4 * i + 3] = t.unorm_half[p >> 24];
+    }
+}
+
+// Linear 16F to sRGB8, exact to the nearest sRGB code for every half value.
+export void linear_half_to_srgb8(uint32_t* dst, const uint16_t* src, size_t count) {
+    const auto& t = srgb_tables();
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t* h = src + 4 * i;
+        dst[i] = t.half_to_srgb[h[0]] | (t.half_to_srgb[h[1]] << 8) | (t.half_to_srgb[h[2]] << 16) |
+                 (uint32_t(t.half_to_unorm[h[3]]) << 24);
+    }
+}
+
+// sRGB8 to linear float RGBA (4 floats per pixel), for filters that work in linear light.
+export void srgb8_to_linear_float(float* dst, const uint32_t* src, size_t count) {
+    const auto& t = srgb_tables();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t p = src[i];
+        dst[4 * i + 0] = t.to_linear_float[p & 0xff];
+        dst[4 * i + 1] = t.to_linear_float[(p >> 8) & 0xff];
+        dst[4 * i + 2] = t.to_linear_float[(p >> 16) & 0xff];
+        dst[4 * i + 3] = static_cast<float>(p >> 24) / 255.0f;
+    }
+}
+
+// Linear float RGBA back to sRGB8. Goes through half precision, which has more than enough
+// resolution to land on the right 8 bit code.
+export void linear_float_to_srgb8(uint32_t* dst, const float* src, size_t count) {
+    const auto& t = srgb_tables();
+    for (size_t i = 0; i < count; i++) {
+        const float* f = src + 4 * i;
+        dst[i] = t.half_to_srgb[float_to_half(f[0])] | (t.half_to_srgb[float_to_half(f[1])] << 8) |
+                 (t.half_to_srgb[float_to_half(f[2])] << 16) | (float_to_unorm8(f[3]) << 24);
+    }
+}
+
+}
@@ -0,0 +1,479 @@
+module;
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <numbers>
+#include <thread>
+#include <vector>
+#include "simd.h"
+
+export module resample;
+
+import pixel_formats;
+
+// Image resizing for texture ingest: fitting a decoded image to a texture size, the atlas, or a
+// thumbnail, with a box (area average, for thumbnails), Mitchell (soft, no ringing) or Lanczos3
+// (sharp) filter.
+//
+// Resampling is separable. For each output column (and row) the source pixels under the filter
+// and their weights are worked out once, into a ResampleWeights table; a horizontal pass then
+// filters source rows down to the output width and a vertical pass combines those rows. When
+// downscaling the filter is stretched by the scale factor so it averages everything it covers
+// instead of skipping pixels, which is what keeps a 24MP photo from aliasing at texture size.
+//
+// The arithmetic is float, in linear light and premultiplied alpha: sRGB8 is decoded through
+// pixel_formats' tables, alpha multiplied in, and undone on the way out. Filtering sRGB values
+// directly darkens every edge and fine texture as it shrinks.
+//
+// resample_rgba8() splits the output into bands of rows spread over threads. A band runs the
+// horizontal pass on each source row it needs exactly once, into a ring of as many rows as the
+// vertical filter has taps. The kernels have SSE4.1/AVX2 versions that add in the same order as
+// the scalar ones, so every level gives the same bits.
+
+namespace pixel {
+
+export enum class ResampleFilter {
+    box,
+    mitchell,
+    lanczos3,
+};
+
+// How far the filter reaches either side, in source pixels at 1:1.
+export float filter_radius(ResampleFilter filter) {
+    switch (filter) {
+    case ResampleFilter::box: return 0.5f;
+    case ResampleFilter::mitchell: return 2.0f;
+    case ResampleFilter::lanczos3: return 3.0f;
+    }
+    return 0.5f;
+}
+
+export double filter_weight(ResampleFilter filter, double x) {
+    x = std::abs(x);
+    switch (filter) {
+    case ResampleFilter::box:
+        return x < 0.5 ? 1.0 : 0.0;
+    case ResampleFilter::mitchell: {
+        // Mitchell-Netravali with B = C = 1/3.
+        constexpr double b = 1.0 / 3.0, c = 1.0 / 3.0;
+        if (x < 1.0) return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x + (6 - 2 * b)) / 6;
+        if (x < 2.0) {
+            return ((-b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x + (-12 * b - 48 * c) * x +
+                    (8 * b + 24 * c)) / 6;
+        }
+        return 0.0;
+    }
+    case ResampleFilter::lanczos3: {
+        if (x < 1e-8) return 1.0;
+        if (x >= 3.0) return 0.0;
+        double px = std::numbers::pi * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+    }
+    return 0.0;
+}
+
+// For each of size outputs, taps weights (adding up to 1) for the source pixels from first[i]
+// on. Pixels past the edges are clamped to it, which folds their weight onto the edge pixel.
+export struct ResampleWeights {
+    int taps = 0;
+    std::vector<int32_t> first;
+    std::vector<float> weights;     // size * taps
+};
+
+// even_taps pads taps to an even number with zero weights, for the horizontal kernels, which take
+// two at a time. first[i] + taps can then be one past the end of the source.
+export ResampleWeights resample_weights(int src_size, int dst_size, ResampleFilter filter, bool even_taps = false) {
+    assert(src_size > 0 && dst_size > 0);
+    double scale = double(dst_size) / src_size;
+    double stretch = std::max(1.0, 1.0 / scale);
+    double support = filter_radius(filter) * stretch;
+    auto range = [&](int i, int& lo, int& hi) {
+        double center = (i + 0.5) / scale;
+        lo = std::max(0, int(std::floor(center - support)));
+        hi = std::min(src_size, int(std::ceil(center + support)) + 1);
+    };
+
+    ResampleWeights w;
+    for (int i = 0; i < dst_size; i++) {
+        int lo, hi;
+        range(i, lo, hi);
+        w.taps = std::max(w.taps, hi - lo);
+    }
+    w.taps = std::min(w.taps, src_size);
+    int stored = even_taps ? (w.taps + 1) & ~1 : w.taps;
+    w.first.resize(dst_size);
+    w.weights.assign(size_t(dst_size) * stored, 0.0f);
+    std::vector<double> row(w.taps);
+    for (int i = 0; i < dst_size; i++) {
+        double center = (i + 0.5) / scale;
+        int first = std::clamp(int(std::floor(center - support)), 0, src_size - w.taps);
+        w.first[i] = first;
+        std::fill(row.begin(), row.end(), 0.0);
+        double total = 0.0;
+        int lo = int(std::floor(center - support)), hi = int(std::ceil(center + support)) + 1;
+        for (int j = lo; j < hi; j++) {
+            double weight = filter_weight(filter, (j + 0.5 - center) / stretch);
+            if (weight == 0.0) continue;
+            int k = std::clamp(j, 0, src_size - 1) - first;
+            if (k < 0 || k >= w.taps) continue;     // only when the filter is wider than the source
+            row[k] += weight;
+            total += weight;
+        }
+        if (total == 0.0) {
+            // Nothing under the filter (a box narrower than the gap between centres): nearest.
+            row[std::clamp(int(center) - first, 0, w.taps - 1)] = total = 1.0;
+        }
+        for (int k = 0; k < w.taps; k++) {
+            w.weights[size_t(i) * stored + k] = float(row[k] / total);
+        }
+    }
+    w.taps = stored;
+    return w;
+}
+
+// --- scalar reference ----------------------------------------------------------------------------
+
+// Float RGBA, 4 floats a pixel. Even and odd taps are summed separately and added at the end,
+// which is how the SIMD versions split them.
+void horizontal_scalar(float* dst, const float* src, const int32_t* first, const float* weights, int taps,
+                       int count) {
+    for (int i = 0; i < count; i++) {
+        const float* s = src + 4 * size_t(first[i]);
+        const float* w = weights + size_t(i) * taps;
+        float even[4] = {}, odd[4] = {};
+        for (int t = 0; t < taps; t += 2) {
+            for (int c = 0; c < 4; c++) {
+                even[c] += w[t] * s[4 * t + c];
+                odd[c] += w[t + 1] * s[4 * t + 4 + c];
+            }
+        }
+        for (int c = 0; c < 4; c++) dst[4 * i + c] = even[c] + odd[c];
+    }
+}
+
+// count floats: dst[x] = sum over t of weights[t] * rows[t][x].
+void vertical_scalar(float* dst, const float* const* rows, const float* weights, int taps, size_t count) {
+    for (size_t x = 0; x < count; x++) {
+        float sum = 0.0f;
+        for (int t = 0; t < taps; t++) sum += weights[t] * rows[t][x];
+        dst[x] = sum;
+    }
+}
+
+#if SIMD_X86
+
+// --- SSE4.1 --------------------------------------------------------------------------------------
+
+// A pixel is one register, so a tap is a broadcast weight times a load. Two outputs at a time:
+// that's four independent sums, enough to keep the adds from waiting on each other.
+SIMD_TARGET_SSE41
+void horizontal_sse41(float* dst, const float* src, const int32_t* first, const float* weights, int taps,
+                      int count) {
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const float* s0 = src + 4 * size_t(first[i]);
+        const float* s1 = src + 4 * size_t(first[i + 1]);
+        const float* w0 = weights + size_t(i) * taps;
+        const float* w1 = w0 + taps;
+        __m128 even0 = _mm_setzero_ps(), odd0 = _mm_setzero_ps();
+        __m128 even1 = _mm_setzero_ps(), odd1 = _mm_setzero_ps();
+        for (int t = 0; t < taps; t += 2) {
+            even0 = _mm_add_ps(even0, _mm_mul_ps(_mm_set1_ps(w0[t]), _mm_loadu_ps(s0 + 4 * t)));
+            odd0 = _mm_add_ps(odd0, _mm_mul_ps(_mm_set1_ps(w0[t + 1]), _mm_loadu_ps(s0 + 4 * t + 4)));
+            even1 = _mm_add_ps(even1, _mm_mul_ps(_mm_set1_ps(w1[t]), _mm_loadu_ps(s1 + 4 * t)));
+            odd1 = _mm_add_ps(odd1, _mm_mul_ps(_mm_set1_ps(w1[t + 1]), _mm_loadu_ps(s1 + 4 * t + 4)));
+        }
+        _mm_storeu_ps(dst + 4 * i, _mm_add_ps(even0, odd0));
+        _mm_storeu_ps(dst + 4 * i + 4, _mm_add_ps(even1, odd1));
+    }
+    horizontal_scalar(dst + 4 * i, src, first + i, weights + size_t(i) * taps, taps, count - i);
+}
+
+SIMD_TARGET_SSE41
+void vertical_sse41(float* dst, const float* const* rows, const float* weights, int taps, size_t count) {
+    size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps(), c = _mm_setzero_ps(), d = _mm_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            __m128 w = _mm_set1_ps(weights[t]);
+            const float* r = rows[t] + x;
+            a = _mm_add_ps(a, _mm_mul_ps(w, _mm_loadu_ps(r)));
+            b = _mm_add_ps(b, _mm_mul_ps(w, _mm_loadu_ps(r + 4)));
+            c = _mm_add_ps(c, _mm_mul_ps(w, _mm_loadu_ps(r + 8)));
+            d = _mm_add_ps(d, _mm_mul_ps(w, _mm_loadu_ps(r + 12)));
+        }
+        _mm_storeu_ps(dst + x, a);
+        _mm_storeu_ps(dst + x + 4, b);
+        _mm_storeu_ps(dst + x + 8, c);
+        _mm_storeu_ps(dst + x + 12, d);
+    }
+    for (; x + 4 <= count; x += 4) {
+        __m128 a = _mm_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            a = _mm_add_ps(a, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + x)));
+        }
+        _mm_storeu_ps(dst + x, a);
+    }
+    for (; x < count; x++) {
+        float sum = 0.0f;
+        for (int t = 0; t < taps; t++) sum += weights[t] * rows[t][x];
+        dst[x] = sum;
+    }
+}
+
+// --- AVX2 ----------------------------------------------------------------------------------------
+
+// Two taps per register: pixels t and t + 1 are next to each other, so one load gets both, and
+// their weights are spread over the two halves. The halves are the even and odd sums. Two
+// outputs at a time for independent sums; more runs out of registers.
+SIMD_TARGET_AVX2
+void horizontal_avx2(float* dst, const float* src, const int32_t* first, const float* weights, int taps,
+                     int count) {
+    const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const float* s[2];
+        const float* w[2];
+        __m256 acc[2];
+        for (int k = 0; k < 2; k++) {
+            s[k] = src + 4 * size_t(first[i + k]);
+            w[k] = weights + size_t(i + k) * taps;
+            acc[k] = _mm256_setzero_ps();
+        }
+        for (int t = 0; t < taps; t += 2) {
+            for (int k = 0; k < 2; k++) {
+                __m128 pair = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(w[k] + t)));
+                __m256 wv = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(pair), spread);
+                acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(wv, _mm256_loadu_ps(s[k] + 4 * t)));
+            }
+        }
+        for (int k = 0; k < 2; k++) {
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc[k]), _mm256_extractf128_ps(acc[k], 1));
+            _mm_storeu_ps(dst + 4 * (i + k), sum);
+        }
+    }
+    horizontal_sse41(dst + 4 * i, src, first + i, weights + size_t(i) * taps, taps, count - i);
+}
+
+SIMD_TARGET_AVX2
+void vertical_avx2(float* dst, const float* const* rows, const float* weights, int taps, size_t count) {
+    size_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps(), c = _mm256_setzero_ps(), d = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            __m256 w = _mm256_set1_ps(weights[t]);
+            const float* r = rows[t] + x;
+            a = _mm256_add_ps(a, _mm256_mul_ps(w, _mm256_loadu_ps(r)));
+            b = _mm256_add_ps(b, _mm256_mul_ps(w, _mm256_loadu_ps(r + 8)));
+            c = _mm256_add_ps(c, _mm256_mul_ps(w, _mm256_loadu_ps(r + 16)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(w, _mm256_loadu_ps(r + 24)));
+        }
+        _mm256_storeu_ps(dst + x, a);
+        _mm256_storeu_ps(dst + x + 8, b);
+        _mm256_storeu_ps(dst + x + 16, c);
+        _mm256_storeu_ps(dst + x + 24, d);
+    }
+    for (; x + 8 <= count; x += 8) {
+        __m256 a = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + x)));
+        }
+        _mm256_storeu_ps(dst + x, a);
+    }
+    for (; x < count; x++) {
+        float sum = 0.0f;
+        for (int t = 0; t < taps; t++) sum += weights[t] * rows[t][x];
+        dst[x] = sum;
+    }
+}
+
+#endif // SIMD_X86
+
+// One source row through the horizontal filter. src has to be readable up to first + taps for
+// every output, so one pixel past the end when taps were padded.
+export void resample_row(float* dst, const float* src, const ResampleWeights& weights,
+                         simd::Level level = simd::Level::avx2) {
+    assert(weights.taps % 2 == 0);
+    int count = int(weights.first.size());
+#if SIMD_X86
+    const int32_t* first = weights.first.data();
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: horizontal_avx2(dst, src, first, weights.weights.data(), weights.taps, count); return;
+    case simd::Level::sse41: horizontal_sse41(dst, src, first, weights.weights.data(), weights.taps, count); return;
+    default: break;
+    }
+#endif
+    horizontal_scalar(dst, src, weights.first.data(), weights.weights.data(), weights.taps, count);
+}
+
+// dst = sum of weights[t] * rows[t], count floats.
+export void resample_column(float* dst, const float* const* rows, const float* weights, int taps, size_t count,
+                            simd::Level level = simd::Level::avx2) {
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: vertical_avx2(dst, rows, weights, taps, count); return;
+    case simd::Level::sse41: vertical_sse41(dst, rows, weights, taps, count); return;
+    default: break;
+    }
+#endif
+    vertical_scalar(dst, rows, weights, taps, count);
+}
+
+// --- images --------------------------------------------------------------------------------------
+
+export struct ResampleOptions {
+    ResampleFilter filter = ResampleFilter::lanczos3;
+    bool srgb = true;               // decode to linear light first; false filters the values as they are
+    bool premultiplied = false;     // the input (and so the output) is premultiplied already
+    unsigned threads = 0;           // 0 for every core
+    simd::Level level = simd::Level::avx2;
+};
+
+// The biggest size with width:height's aspect ratio within max_width x max_height, and no bigger
+// than width x height.
+export void fit_within(int width, int height, int max_width, int max_height, int& fit_width, int& fit_height) {
+    double scale = std::min({ 1.0, double(max_width) / width, double(max_height) / height });
+    fit_width = std::max(1, int(std::lround(width * scale)));
+    fit_height = std::max(1, int(std::lround(height * scale)));
+}
+
+uint32_t float_to_unorm(float f) {
+    return uint32_t(std::lrint(std::clamp(f, 0.0f, 1.0f) * 255.0f));
+}
+
+// 8 bit channel to float, both ways. The sRGB one comes out of pixel_formats' own decoder, so the
+// values are the ones the rest of the app sees.
+struct DecodeTables {
+    float srgb[256];
+    float unorm[256];
+};
+
+const DecodeTables& decode_tables() {
+    static const DecodeTables tables = [] {
+        DecodeTables t;
+        uint32_t probe[256];
+        float linear[256 * 4];
+        for (uint32_t i = 0; i < 256; i++) probe[i] = i | i << 24;
+        srgb8_to_linear_float(linear, probe, 256);
+        for (int i = 0; i < 256; i++) {
+            t.srgb[i] = linear[4 * i];
+            t.unorm[i] = linear[4 * i + 3];
+        }
+        return t;
+    }();
+    return tables;
+}
+
+// A source row to (linear) premultiplied float, in one go: table lookups are cheap next to a
+// second pass over the row.
+void decode_row(float* dst, const uint32_t* src, int count, const ResampleOptions& options) {
+    const auto& tables = decode_tables();
+    const float* color = options.srgb ? tables.srgb : tables.unorm;
+    if (options.premultiplied) {
+        for (int i = 0; i < count; i++) {
+            uint32_t p = src[i];
+            dst[4 * i + 0] = color[p & 0xff];
+            dst[4 * i + 1] = color[(p >> 8) & 0xff];
+            dst[4 * i + 2] = color[(p >> 16) & 0xff];
+            dst[4 * i + 3] = tables.unorm[p >> 24];
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            uint32_t p = src[i];
+            float a = tables.unorm[p >> 24];
+            dst[4 * i + 0] = color[p & 0xff] * a;
+            dst[4 * i + 1] = color[(p >> 8) & 0xff] * a;
+            dst[4 * i + 2] = color[(p >> 16) & 0xff] * a;
+            dst[4 * i + 3] = a;
+        }
+    }
+}
+
+// And back. Ringing can leave colour above alpha or below zero; the encoders clamp.
+void encode_row(uint32_t* dst, float* src, int count, const ResampleOptions& options) {
+    if (!options.premultiplied) {
+        for (int i = 0; i < count; i++) {
+            float a = src[4 * i + 3];
+            float inverse = a > 0.0f ? 1.0f / a : 0.0f;
+            src[4 * i + 0] *= inverse;
+            src[4 * i + 1] *= inverse;
+            src[4 * i + 2] *= inverse;
+        }
+    }
+    if (options.srgb) {
+        linear_float_to_srgb8(dst, src, size_t(count));
+        if (options.premultiplied) {
+            // Colour can't be more than alpha in a premultiplied pixel, and sRGB encoding can push
+            // it there.
+            for (int i = 0; i < count; i++) {
+                uint32_t a = dst[i] >> 24, p = 0;
+                for (int c = 0; c < 24; c += 8) p |= std::min((dst[i] >> c) & 0xff, a) << c;
+                dst[i] = p | a << 24;
+            }
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            uint32_t a = float_to_unorm(src[4 * i + 3]);
+            uint32_t p = a << 24;
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = float_to_unorm(src[4 * i + c]);
+                p |= (options.premultiplied ? std::min(v, a) : v) << (8 * c);
+            }
+            dst[i] = p;
+        }
+    }
+}
+
+// RGBA8 (0xAABBGGRR) src into dst at dst's size. Pitches are in pixels. dst can't overlap src.
+export void resample_rgba8(uint32_t* dst, int dst_width, int dst_height, size_t dst_pitch, const uint32_t* src,
+                           int src_width, int src_height, size_t src_pitch, const ResampleOptions& options = {}) {
+    if (dst_width <= 0 || dst_height <= 0 || src_width <= 0 || src_height <= 0) return;
+    ResampleWeights columns = resample_weights(src_width, dst_width, options.filter, true);
+    ResampleWeights rows = resample_weights(src_height, dst_height, options.filter);
+    // Decoded rows are long enough for the last output's taps, padding included.
+    int decoded_width = src_width;
+    for (int32_t first : columns.first) decoded_width = std::max(decoded_width, int(first) + columns.taps);
+
+    unsigned threads = options.threads;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // A few bands per thread to even out the load, but not so short that the rows shared between
+    // neighbouring bands, filtered by both, add up to much.
+    int band = std::clamp((dst_height + 4 * int(threads) - 1) / (4 * int(threads)), 16, 128);
+    int bands = (dst_height + band - 1) / band;
+    threads = std::min<unsigned>(threads, unsigned(bands));
+
+    std::atomic<int> next = 0;
+    auto run = [&] {
+        std::vector<float> decoded(size_t(decoded_width) * 4, 0.0f);
+        std::vector<float> ring(size_t(rows.taps) * dst_width * 4);
+        std::vector<float> out(size_t(dst_width) * 4);
+        std::vector<const float*> taps(rows.taps);
+        for (int b = next++; b < bands; b = next++) {
+            int done = -1;      // last source row in the ring
+            for (int y = b * band; y < std::min(dst_height, (b + 1) * band); y++) {
+                int first = rows.first[y];
+                for (int r = std::max(done + 1, first); r < first + rows.taps; r++) {
+                    decode_row(decoded.data(), src + size_t(r) * src_pitch, src_width, options);
+                    resample_row(&ring[size_t(r % rows.taps) * dst_width * 4], decoded.data(), columns, options.level);
+                }
+                done = std::max(done, first + rows.taps - 1);
+                for (int t = 0; t < rows.taps; t++) {
+                    taps[t] = &ring[size_t((first + t) % rows.taps) * dst_width * 4];
+                }
+                resample_column(out.data(), taps.data(), &rows.weights[size_t(y) * rows.taps], rows.taps,
+                                out.size(), options.level);
+                encode_row(dst + size_t(y) * dst_pitch, out.data(), dst_width, options);
+            }
+        }
+    };
+    std::vector<std::jthread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(run);
+    run();
+}
+
+}
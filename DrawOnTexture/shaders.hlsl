@@ -5,7 +5,13 @@ cbuffer cbPerObject : register(b0)
 };
 
 
-Texture2D theTexture : register(t0);
+cbuffer cbPerDraw : register(b1)
+{
+    uint gTextureIndex;
+};
+
+// Every texture in the descriptor heap; gTextureIndex picks one.
+Texture2D gTextures[] : register(t0);
 SamplerState theSampler : register(s0);
 
 // Things labled with "2" have texture coord.
@@ -36,7 +42,18 @@ VertexOut2 vert_shader(VertexIn2 vin)
 
 float4 pix_shader(VertexOut2 pin) : SV_Target
 {
-    float4 color = theTexture.Sample(theSampler, pin.TexC);
+    float4 color = gTextures[gTextureIndex].Sample(theSampler, pin.TexC);
     // color = float4(1, 0, 0, 1);
     return color;
+}
+
+// For TextureSource::distance_field: the texture holds distances (distance_field.ixx), 0.5 on the
+// edge. Filtered linearly, then fwidth makes the edge one screen pixel wide at any scale.
+SamplerState linearClamp : register(s3);
+
+float4 sdf_pix_shader(VertexOut2 pin) : SV_Target
+{
+    float d = gTextures[gTextureIndex].Sample(linearClamp, pin.TexC).r - 0.5f;
+    float ink = saturate(d / max(fwidth(d), 1e-5f) + 0.5f);
+    return lerp(float4(0.94f, 0.94f, 0.94f, 1), float4(1, 0, 0, 1), ink);
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+// Vector shapes from path_tessellator: model space positions and a premultiplied color per vertex.
+// Anti-aliasing is in the geometry (fringe vertices have zero alpha), so the pixel shader only
+// passes the color on and the pipeline blends with ONE, INV_SRC_ALPHA.
+
+cbuffer cbPerObject : register(b0)
+{
+    float4x4 gWorldViewProj;
+};
+
+struct ShapeIn
+{
+    float2 PosL : POSITION;
+    float4 Color : COLOR;
+};
+
+struct ShapeOut
+{
+    float4 PosH : SV_POSITION;
+    float4 Color : COLOR;
+};
+
+ShapeOut shape_vs(ShapeIn vin)
+{
+    ShapeOut vout;
+    vout.PosH = mul(float4(vin.PosL, 0, 1.0f), gWorldViewProj);
+    vout.Color = vin.Color;
+    return vout;
+}
+
+float4 shape_ps(ShapeOut pin) : SV_Target
+{
+    return pin.Color;
+}
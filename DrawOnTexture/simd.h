@@ -0,0 +1,79 @@
+#pragma once
+
+// Shared bits for the CPU pixel kernels: runtime CPU feature checks, and the function attributes
+// GCC/Clang need to compile SSE4.1/AVX2 intrinsics in a file that is built for plain x86-64.
+// MSVC lets you use any intrinsic anywhere, so the attributes are empty there.
+//
+// Include this from a module's global fragment (before "export module").
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+#if SIMD_X86 && !defined(_MSC_VER)
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#endif
+
+namespace simd {
+
+enum class Level {
+    scalar,
+    sse41,
+    avx2,
+};
+
+inline Level detect_level() {
+#if SIMD_X86
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    int max_leaf = regs[0];
+    __cpuid(regs, 1);
+    bool sse41 = (regs[2] & (1 << 19)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (max_leaf >= 7 && osxsave && avx) {
+        // The OS has to save the YMM registers too, or AVX instructions fault.
+        bool ymm_enabled = (_xgetbv(0) & 6) == 6;
+        __cpuidex(regs, 7, 0);
+        avx2 = ymm_enabled && (regs[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2 && sse41) return Level::avx2;
+    if (sse41) return Level::sse41;
+#endif
+    return Level::scalar;
+}
+
+// The best level this CPU supports. Kernels check this once per call, which is cheap enough for
+// the row/tile sized spans we pass them.
+inline Level supported_level() {
+    static const Level level = detect_level();
+    return level;
+}
+
+// Kernels take a Level so tests and benchmarks can force the slower paths. Asking for more than
+// the CPU has just gets what it has.
+inline Level usable_level(Level requested) {
+    return std::min(requested, supported_level());
+}
+
+}
@@ -0,0 +1,575 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <variant>
+#include <vector>
+
+export module software_device;
+
+import render_device;
+
+// render::Device on the CPU. Commands run when they're submitted, so fences are done as soon as
+// submit() returns. Draws go through a plain scanline-free rasterizer:
+//
+// - vertex stage: every index is fetched and transformed (the quad has 6), no vertex cache
+// - triangles are clipped to 0 <= z <= w, turned into 24.8 fixed point, culled and set up as
+//   three edge functions with the D3D top-left rule
+// - the target is cut into bands of rows and the bands are shared out to a pool of threads;
+//   each band walks every triangle's bounding box inside it, so nothing is written twice
+//
+// Only the textured quad pipeline exists, so there's no shader interpreter: the pixel stage is
+// the sample from pix_shader() written straight into the target.
+
+namespace render {
+
+constexpr int subpixel_bits = 8;
+constexpr int band_rows = 16;
+
+// Runs count jobs across the pool and the calling thread and returns when they're all done.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads) {
+        for (unsigned i = 1; i < threads; i++) {
+            m_workers.emplace_back([this](std::stop_token st) { worker_loop(st); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(m_mutex);
+            for (auto& w : m_workers) w.request_stop();
+        }
+        m_start_cv.notify_all();
+        m_workers.clear();     // join while the mutex and condition variables are still around
+    }
+
+    unsigned threads() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+
+    void run(size_t count, const std::function<void(size_t)>& job) {
+        if (m_workers.empty() || count <= 1) {
+            for (size_t i = 0; i < count; i++) job(i);
+            return;
+        }
+        {
+            std::lock_guard lock(m_mutex);
+            m_job = &job;
+            m_count = count;
+            m_next = 0;
+            m_busy = m_workers.size();
+            m_generation++;
+        }
+        m_start_cv.notify_all();
+        take_jobs(job, count);
+        std::unique_lock lock(m_mutex);
+        m_done_cv.wait(lock, [this] { return m_busy == 0; });
+        m_job = nullptr;
+    }
+
+private:
+    void take_jobs(const std::function<void(size_t)>& job, size_t count) {
+        for (size_t i = m_next++; i < count; i = m_next++) job(i);
+    }
+
+    void worker_loop(std::stop_token st) {
+        uint64_t seen = 0;
+        std::unique_lock lock(m_mutex);
+        for (;;) {
+            m_start_cv.wait(lock, [&] { return st.stop_requested() || m_generation != seen; });
+            if (st.stop_requested()) return;
+            seen = m_generation;
+            const auto* job = m_job;
+            size_t count = m_count;
+            lock.unlock();
+            take_jobs(*job, count);
+            lock.lock();
+            if (--m_busy == 0) m_done_cv.notify_one();
+        }
+    }
+
+    std::vector<std::jthread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv;
+    std::condition_variable m_done_cv;
+    const std::function<void(size_t)>* m_job = nullptr;
+    size_t m_count = 0;
+    std::atomic<size_t> m_next = 0;
+    size_t m_busy = 0;
+    uint64_t m_generation = 0;
+};
+
+struct TextureData {
+    TextureDesc desc;
+    std::vector<uint32_t> texels;   // every texture format here is 4 bytes
+};
+
+struct ClearCmd { Texture target; uint32_t value; };
+struct ClearDepthCmd { Texture target; float depth; };
+struct TargetCmd { Texture color; Texture depth; };
+struct ViewportCmd { Viewport viewport; };
+struct ScissorCmd { Rect rect; };
+struct PipelineCmd { Pipeline pipeline; };
+struct VertexBufferCmd { Buffer buffer; uint32_t stride; uint32_t offset; };
+struct IndexBufferCmd { Buffer buffer; Format format; uint32_t offset; };
+struct ConstantsCmd { Buffer buffer; };
+struct TextureCmd { Texture texture; };
+struct DrawCmd { uint32_t index_count; uint32_t start_index; int32_t base_vertex; };
+struct CopyCmd { Texture dst; Texture src; };
+
+using Command = std::variant<ClearCmd, ClearDepthCmd, TargetCmd, ViewportCmd, ScissorCmd, PipelineCmd,
+                             VertexBufferCmd, IndexBufferCmd, ConstantsCmd, TextureCmd, DrawCmd, CopyCmd>;
+
+uint32_t pack_color(const float c[4], Format format) {
+    auto to8 = [](float v) { return uint32_t(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    uint32_t r = to8(c[0]), g = to8(c[1]), b = to8(c[2]), a = to8(c[3]);
+    if (format == Format::bgra8_unorm) std::swap(r, b);
+    return r | g << 8 | b << 16 | a << 24;
+}
+
+uint32_t swap_red_blue(uint32_t c) {
+    return (c & 0xff00ff00) | (c >> 16 & 0xff) | (c & 0xff) << 16;
+}
+
+class SoftwareCommandList final : public CommandList {
+public:
+    std::vector<Command> commands;
+    // Filled in by the device, which knows the formats.
+    std::function<uint32_t(Texture, const float[4])> pack;
+
+    void reset() override { commands.clear(); }
+    void clear(Texture target, const float color[4]) override { commands.push_back(ClearCmd{ target, pack(target, color) }); }
+    void clear_depth(Texture target, float depth) override { commands.push_back(ClearDepthCmd{ target, depth }); }
+    void set_render_target(Texture color, Texture depth) override { commands.push_back(TargetCmd{ color, depth }); }
+    void set_viewport(const Viewport& viewport) override { commands.push_back(ViewportCmd{ viewport }); }
+    void set_scissor(const Rect& rect) override { commands.push_back(ScissorCmd{ rect }); }
+    void set_pipeline(Pipeline pipeline) override { commands.push_back(PipelineCmd{ pipeline }); }
+    void set_vertex_buffer(Buffer buffer, uint32_t stride, uint32_t offset) override {
+        commands.push_back(VertexBufferCmd{ buffer, stride, offset });
+    }
+    void set_index_buffer(Buffer buffer, Format format, uint32_t offset) override {
+        commands.push_back(IndexBufferCmd{ buffer, format, offset });
+    }
+    void set_constants(Buffer buffer) override { commands.push_back(ConstantsCmd{ buffer }); }
+    void set_texture(Texture texture) override { commands.push_back(TextureCmd{ texture }); }
+    void draw_indexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) override {
+        commands.push_back(DrawCmd{ index_count, start_index, base_vertex });
+    }
+    void copy_texture(Texture dst, Texture src) override { commands.push_back(CopyCmd{ dst, src }); }
+};
+
+struct ClipVertex {
+    float x, y, z, w, u, v;
+};
+
+// A triangle ready to rasterize: 24.8 fixed point corners in clockwise (front facing) order and
+// the attributes that get interpolated, already divided by w.
+struct SetupTriangle {
+    int64_t x[3], y[3];
+    int64_t area;
+    float z[3], inv_w[3], u_w[3], v_w[3];
+    int min_x, min_y, max_x, max_y;     // pixel bounds, inclusive, inside the scissor
+};
+
+export class SoftwareDevice final : public Device {
+public:
+    // pixels are the texture's texels, width * height of them with no padding.
+    using PresentFn = std::function<void(const uint32_t* pixels, uint32_t width, uint32_t height, Format format)>;
+
+    explicit SoftwareDevice(unsigned threads = 0, PresentFn present = {})
+        : m_pool(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+          m_present(std::move(present))
+    {
+    }
+
+    unsigned threads() const { return m_pool.threads(); }
+
+    Buffer create_buffer(size_t size) override {
+        auto data = std::make_unique<std::vector<uint8_t>>(size);
+        return Buffer{ add(m_buffers, std::move(data)) };
+    }
+
+    void write_buffer(Buffer buffer, size_t offset, std::span<const uint8_t> data) override {
+        auto& b = *m_buffers[buffer.index - 1];
+        assert(offset + data.size() <= b.size());
+        memcpy(b.data() + offset, data.data(), data.size());
+    }
+
+    void destroy(Buffer buffer) override { m_buffers[buffer.index - 1] = nullptr; }
+
+    Texture create_texture(const TextureDesc& desc) override {
+        assert(format_bytes(desc.format) == 4);
+        auto data = std::make_unique<TextureData>();
+        data->desc = desc;
+        data->texels.resize(size_t(desc.width) * desc.height);
+        return Texture{ add(m_textures, std::move(data)) };
+    }
+
+    TextureDesc describe(Texture texture) const override { return tex(texture).desc; }
+
+    void write_texture(Texture texture, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                       const void* data, size_t row_pitch) override {
+        auto& t = tex(texture);
+        assert(x + width <= t.desc.width && y + height <= t.desc.height);
+        for (uint32_t row = 0; row < height; row++) {
+            memcpy(t.texels.data() + size_t(y + row) * t.desc.width + x,
+                   static_cast<const uint8_t*>(data) + row * row_pitch, width * 4);
+        }
+    }
+
+    void read_texture(Texture texture, void* data, size_t row_pitch) override {
+        auto& t = tex(texture);
+        for (uint32_t row = 0; row < t.desc.height; row++) {
+            memcpy(static_cast<uint8_t*>(data) + row * row_pitch, t.texels.data() + size_t(row) * t.desc.width,
+                   t.desc.width * 4);
+        }
+    }
+
+    void destroy(Texture texture) override { m_textures[texture.index - 1] = nullptr; }
+
+    Pipeline create_pipeline(const PipelineDesc& desc) override {
+        m_pipelines.push_back(desc);
+        return Pipeline{ static_cast<uint32_t>(m_pipelines.size()) };
+    }
+
+    std::unique_ptr<CommandList> create_command_list() override {
+        auto list = std::make_unique<SoftwareCommandList>();
+        list->pack = [this](Texture t, const float c[4]) { return pack_color(c, tex(t).desc.format); };
+        return list;
+    }
+
+    uint64_t submit(CommandList& list) override {
+        State state;
+        for (const Command& cmd : static_cast<SoftwareCommandList&>(list).commands) {
+            std::visit([&](const auto& c) { execute(state, c); }, cmd);
+        }
+        return ++m_fence;
+    }
+
+    uint64_t completed_fence() const override { return m_fence; }
+    void wait(uint64_t) override {}
+
+    void present(Texture texture) override {
+        if (!m_present) return;
+        auto& t = tex(texture);
+        m_present(t.texels.data(), t.desc.width, t.desc.height, t.desc.format);
+    }
+
+private:
+    struct State {
+        Texture color, depth, texture;
+        Viewport viewport;
+        Rect scissor = { 0, 0, INT32_MAX, INT32_MAX };
+        PipelineDesc pipeline;
+        VertexBufferCmd vertices = {};
+        IndexBufferCmd indices = {};
+        Buffer constants;
+    };
+
+    template <class T>
+    static uint32_t add(std::vector<std::unique_ptr<T>>& table, std::unique_ptr<T> item) {
+        auto slot = std::find(table.begin(), table.end(), nullptr);
+        if (slot != table.end()) {
+            *slot = std::move(item);
+            return static_cast<uint32_t>(slot - table.begin()) + 1;
+        }
+        table.push_back(std::move(item));
+        return static_cast<uint32_t>(table.size());
+    }
+
+    TextureData& tex(Texture t) const {
+        assert(t.index > 0 && t.index <= m_textures.size() && m_textures[t.index - 1]);
+        return *m_textures[t.index - 1];
+    }
+
+    // Splits the rows [0, height) into bands and runs f(y0, y1) on the pool.
+    void for_bands(uint32_t height, const std::function<void(int, int)>& f) {
+        size_t bands = (height + band_rows - 1) / band_rows;
+        m_pool.run(bands, [&](size_t band) {
+            int y0 = int(band) * band_rows;
+            f(y0, std::min<int>(y0 + band_rows, height));
+        });
+    }
+
+    void execute(State&, const ClearCmd& c) {
+        auto& t = tex(c.target);
+        for_bands(t.desc.height, [&](int y0, int y1) {
+            std::fill(t.texels.begin() + size_t(y0) * t.desc.width, t.texels.begin() + size_t(y1) * t.desc.width, c.value);
+        });
+    }
+
+    void execute(State&, const ClearDepthCmd& c) {
+        auto& t = tex(c.target);
+        uint32_t bits;
+        memcpy(&bits, &c.depth, 4);
+        std::fill(t.texels.begin(), t.texels.end(), bits);
+    }
+
+    void execute(State& s, const TargetCmd& c) { s.color = c.color; s.depth = c.depth; }
+    void execute(State& s, const ViewportCmd& c) { s.viewport = c.viewport; }
+    void execute(State& s, const ScissorCmd& c) { s.scissor = c.rect; }
+    void execute(State& s, const PipelineCmd& c) { s.pipeline = m_pipelines[c.pipeline.index - 1]; }
+    void execute(State& s, const VertexBufferCmd& c) { s.vertices = c; }
+    void execute(State& s, const IndexBufferCmd& c) { s.indices = c; }
+    void execute(State& s, const ConstantsCmd& c) { s.constants = c.buffer; }
+    void execute(State& s, const TextureCmd& c) { s.texture = c.texture; }
+
+    void execute(State&, const CopyCmd& c) {
+        auto& dst = tex(c.dst);
+        auto& src = tex(c.src);
+        assert(dst.texels.size() == src.texels.size() && dst.desc.format == src.desc.format);
+        dst.texels = src.texels;
+    }
+
+    void execute(State& s, const DrawCmd& d) {
+        const auto& vb = *m_buffers[s.vertices.buffer.index - 1];
+        const auto& ib = *m_buffers[s.indices.buffer.index - 1];
+        float m[16];
+        memcpy(m, m_buffers[s.constants.index - 1]->data(), sizeof(m));
+
+        // Vertex stage. The buffer holds the transpose of the matrix the shader multiplies by,
+        // so output component j is row j of it dotted with the input.
+        std::vector<ClipVertex> verts(d.index_count);
+        uint32_t index_bytes = format_bytes(s.indices.format);
+        for (uint32_t i = 0; i < d.index_count; i++) {
+            size_t at = s.indices.offset + size_t(d.start_index + i) * index_bytes;
+            uint32_t index = 0;
+            memcpy(&index, ib.data() + at, index_bytes);
+            const uint8_t* v = vb.data() + s.vertices.offset + size_t(int64_t(index) + d.base_vertex) * s.vertices.stride;
+            float pos[2], uv[2];
+            memcpy(pos, v + s.pipeline.position_offset, sizeof(pos));
+            memcpy(uv, v + s.pipeline.uv_offset, sizeof(uv));
+            float out[4];
+            for (int j = 0; j < 4; j++) {
+                out[j] = m[j * 4 + 0] * pos[0] + m[j * 4 + 1] * pos[1] + m[j * 4 + 3];
+            }
+            verts[i] = { out[0], out[1], out[2], out[3], uv[0], uv[1] };
+        }
+
+        auto& target = tex(s.color);
+        TextureData* depth = s.depth ? &tex(s.depth) : nullptr;
+        int clip_x0 = std::max({ 0, s.scissor.left, int(s.viewport.x) });
+        int clip_y0 = std::max({ 0, s.scissor.top, int(s.viewport.y) });
+        int clip_x1 = std::min({ int(target.desc.width), s.scissor.right, int(std::ceil(s.viewport.x + s.viewport.width)) });
+        int clip_y1 = std::min({ int(target.desc.height), s.scissor.bottom, int(std::ceil(s.viewport.y + s.viewport.height)) });
+        if (clip_x0 >= clip_x1 || clip_y0 >= clip_y1) return;
+
+        std::vector<SetupTriangle> tris;
+        for (uint32_t i = 0; i + 2 < d.index_count; i += 3) {
+            ClipVertex poly[9] = { verts[i], verts[i + 1], verts[i + 2] };
+            int n = clip(poly, 3);
+            for (int k = 1; k + 1 < n; k++) {
+                SetupTriangle t;
+                if (setup(poly[0], poly[k], poly[k + 1], s, clip_x0, clip_y0, clip_x1, clip_y1, t)) {
+                    tris.push_back(t);
+                }
+            }
+        }
+        if (tris.empty()) return;
+
+        const TextureData& source = tex(s.texture);
+        bool swap = source.desc.format != target.desc.format;
+        for_bands(target.desc.height, [&](int y0, int y1) {
+            for (const auto& t : tris) {
+                raster(t, std::max(y0, t.min_y), std::min(y1 - 1, t.max_y), s.pipeline, source, swap, target, depth);
+            }
+        });
+    }
+
+    // Sutherland-Hodgman against z >= 0 and z <= w (which also keeps w > 0 for anything left).
+    static int clip(ClipVertex* poly, int n) {
+        auto lerp = [](const ClipVertex& a, const ClipVertex& b, float t) {
+            return ClipVertex{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t,
+                               a.w + (b.w - a.w) * t, a.u + (b.u - a.u) * t, a.v + (b.v - a.v) * t };
+        };
+        for (int plane = 0; plane < 2; plane++) {
+            auto dist = [plane](const ClipVertex& v) { return plane == 0 ? v.z : v.w - v.z; };
+            ClipVertex out[9];
+            int count = 0;
+            for (int i = 0; i < n; i++) {
+                const ClipVertex& a = poly[i];
+                const ClipVertex& b = poly[(i + 1) % n];
+                float da = dist(a), db = dist(b);
+                if (da >= 0) out[count++] = a;
+                if ((da >= 0) != (db >= 0)) out[count++] = lerp(a, b, da / (da - db));
+            }
+            n = count;
+            std::copy(out, out + n, poly);
+            if (n < 3) return 0;
+        }
+        return n;
+    }
+
+    static bool setup(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const State& s,
+                      int clip_x0, int clip_y0, int clip_x1, int clip_y1, SetupTriangle& t) {
+        const ClipVertex* v[3] = { &a, &b, &c };
+        const Viewport& vp = s.viewport;
+        float sx[3], sy[3];
+        for (int i = 0; i < 3; i++) {
+            float inv_w = 1.0f / v[i]->w;
+            sx[i] = vp.x + (v[i]->x * inv_w + 1) * 0.5f * vp.width;
+            sy[i] = vp.y + (1 - v[i]->y * inv_w) * 0.5f * vp.height;
+            t.x[i] = std::llround(sx[i] * (1 << subpixel_bits));
+            t.y[i] = std::llround(sy[i] * (1 << subpixel_bits));
+            t.z[i] = vp.min_depth + v[i]->z * inv_w * (vp.max_depth - vp.min_depth);
+            t.inv_w[i] = inv_w;
+            t.u_w[i] = v[i]->u * inv_w;
+            t.v_w[i] = v[i]->v * inv_w;
+        }
+        // Positive area is clockwise on screen (y down), which is front facing by D3D's default.
+        t.area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.y[1] - t.y[0]) * (t.x[2] - t.x[0]);
+        if (t.area == 0) return false;
+        if (t.area < 0) {
+            if (s.pipeline.cull == CullMode::back) return false;
+            std::swap(t.x[1], t.x[2]);
+            std::swap(t.y[1], t.y[2]);
+            std::swap(t.z[1], t.z[2]);
+            std::swap(t.inv_w[1], t.inv_w[2]);
+            std::swap(t.u_w[1], t.u_w[2]);
+            std::swap(t.v_w[1], t.v_w[2]);
+            t.area = -t.area;
+        }
+        t.min_x = std::max(clip_x0, int(std::floor(std::min({ sx[0], sx[1], sx[2] }))));
+        t.min_y = std::max(clip_y0, int(std::floor(std::min({ sy[0], sy[1], sy[2] }))));
+        t.max_x = std::min(clip_x1 - 1, int(std::ceil(std::max({ sx[0], sx[1], sx[2] }))));
+        t.max_y = std::min(clip_y1 - 1, int(std::ceil(std::max({ sy[0], sy[1], sy[2] }))));
+        return t.min_x <= t.max_x && t.min_y <= t.max_y;
+    }
+
+    static uint32_t fetch(const TextureData& t, int x, int y, AddressMode address) {
+        int w = int(t.desc.width), h = int(t.desc.height);
+        if (address == AddressMode::wrap && (w & (w - 1)) == 0 && (h & (h - 1)) == 0) {
+            x &= w - 1;
+            y &= h - 1;
+        } else if (address == AddressMode::wrap) {
+            x %= w;
+            y %= h;
+            if (x < 0) x += w;
+            if (y < 0) y += h;
+        } else {
+            x = std::clamp(x, 0, w - 1);
+            y = std::clamp(y, 0, h - 1);
+        }
+        return t.texels[size_t(y) * w + x];
+    }
+
+    static int floor_int(float f) {
+        int i = int(f);
+        return f < float(i) ? i - 1 : i;
+    }
+
+    static uint32_t sample(const TextureData& t, float u, float v, const PipelineDesc& p) {
+        float fx = u * t.desc.width;
+        float fy = v * t.desc.height;
+        if (p.filter == Filter::point) {
+            return fetch(t, floor_int(fx), floor_int(fy), p.address);
+        }
+        fx -= 0.5f;
+        fy -= 0.5f;
+        int x0 = floor_int(fx), y0 = floor_int(fy);
+        uint32_t wx = uint32_t((fx - x0) * 256), wy = uint32_t((fy - y0) * 256);
+        uint32_t c[4] = { fetch(t, x0, y0, p.address), fetch(t, x0 + 1, y0, p.address),
+                          fetch(t, x0, y0 + 1, p.address), fetch(t, x0 + 1, y0 + 1, p.address) };
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t top = (c[0] >> shift & 0xff) * (256 - wx) + (c[1] >> shift & 0xff) * wx;
+            uint32_t bottom = (c[2] >> shift & 0xff) * (256 - wx) + (c[3] >> shift & 0xff) * wx;
+            out |= ((top * (256 - wy) + bottom * wy + (1 << 15)) >> 16) << shift;
+        }
+        return out;
+    }
+
+    // An attribute as a plane over the screen: value at the start of the current row, and how
+    // much it changes per pixel across and down.
+    struct Plane {
+        float row, dx, dy;
+
+        Plane(const float values[3], const double w_row[3], const double w_dx[3], const double w_dy[3]) {
+            row = float(values[0] * w_row[0] + values[1] * w_row[1] + values[2] * w_row[2]);
+            dx = float(values[0] * w_dx[0] + values[1] * w_dx[1] + values[2] * w_dx[2]);
+            dy = float(values[0] * w_dy[0] + values[1] * w_dy[1] + values[2] * w_dy[2]);
+        }
+    };
+
+    static void raster(const SetupTriangle& t, int y_begin, int y_end, const PipelineDesc& p,
+                       const TextureData& source, bool swap, TextureData& target, TextureData* depth) {
+        if (y_begin > y_end) return;
+        constexpr int64_t one = 1 << subpixel_bits;
+        constexpr int64_t half = one / 2;
+        // Edge k runs from corner k+1 to corner k+2 and is opposite corner k, so its value over
+        // the area is corner k's barycentric weight. Edges that aren't top or left get a -1 bias
+        // so pixels exactly on them belong to the neighbour.
+        int64_t step_x[3], step_y[3], row[3];
+        double w_row[3], w_dx[3], w_dy[3];
+        int64_t px = t.min_x * one + half;
+        int64_t py = y_begin * one + half;
+        for (int k = 0; k < 3; k++) {
+            int a = (k + 1) % 3, b = (k + 2) % 3;
+            int64_t dx = t.x[b] - t.x[a];
+            int64_t dy = t.y[b] - t.y[a];
+            bool top_left = dy < 0 || (dy == 0 && dx > 0);
+            int64_t e = dx * (py - t.y[a]) - dy * (px - t.x[a]);
+            row[k] = e + (top_left ? 0 : -1);
+            step_x[k] = -dy * one;
+            step_y[k] = dx * one;
+            w_row[k] = double(e) / t.area;
+            w_dx[k] = double(step_x[k]) / t.area;
+            w_dy[k] = double(step_y[k]) / t.area;
+        }
+        Plane z(t.z, w_row, w_dx, w_dy);
+        Plane inv_w(t.inv_w, w_row, w_dx, w_dy);
+        Plane u_w(t.u_w, w_row, w_dx, w_dy);
+        Plane v_w(t.v_w, w_row, w_dx, w_dy);
+        // Orthographic projections leave w at 1 everywhere, no need to divide per pixel.
+        bool affine = t.inv_w[0] == t.inv_w[1] && t.inv_w[1] == t.inv_w[2];
+        float w_const = 1.0f / t.inv_w[0];
+
+        uint32_t width = target.desc.width;
+        for (int y = y_begin; y <= y_end; y++) {
+            int64_t e0 = row[0], e1 = row[1], e2 = row[2];
+            float zv = z.row, iw = inv_w.row, uw = u_w.row, vw = v_w.row;
+            uint32_t* out = target.texels.data() + size_t(y) * width;
+            float* z_row = depth && p.depth_test ? reinterpret_cast<float*>(depth->texels.data()) + size_t(y) * width : nullptr;
+            for (int x = t.min_x; x <= t.max_x; x++) {
+                if ((e0 | e1 | e2) >= 0 && (!z_row || zv < z_row[x])) {
+                    float w = affine ? w_const : 1.0f / iw;
+                    uint32_t color = sample(source, uw * w, vw * w, p);
+                    out[x] = swap ? swap_red_blue(color) : color;
+                    if (z_row) z_row[x] = zv;
+                }
+                e0 += step_x[0];
+                e1 += step_x[1];
+                e2 += step_x[2];
+                zv += z.dx;
+                iw += inv_w.dx;
+                uw += u_w.dx;
+                vw += v_w.dx;
+            }
+            row[0] += step_y[0];
+            row[1] += step_y[1];
+            row[2] += step_y[2];
+            z.row += z.dy;
+            inv_w.row += inv_w.dy;
+            u_w.row += u_w.dy;
+            v_w.row += v_w.dy;
+        }
+    }
+
+    WorkerPool m_pool;
+    PresentFn m_present;
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> m_buffers;
+    std::vector<std::unique_ptr<TextureData>> m_textures;
+    std::vector<PipelineDesc> m_pipelines;
+    uint64_t m_fence = 0;
+};
+
+}
@@ -0,0 +1,235 @@
+module;
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+export module task_graph;
+
+// A one-shot graph of tasks with dependencies, run on a handful of threads. Built for startup:
+// shader compiles, image decodes and such don't depend on each other and can overlap. Every task
+// is timed, and report() prints where the time went and which chain of tasks (the critical path)
+// bounds how fast startup can get.
+//
+// Tasks that have to run one at a time (eg. because they record into the same command list) say
+// so by depending on each other. Tasks that have to stay on the calling thread (COM apartment,
+// single threaded D2D factory) are added with Affinity::caller.
+
+namespace tasks {
+
+export using TaskId = size_t;
+
+export enum class Affinity {
+    any,
+    caller,     // the thread that calls run()
+};
+
+export struct TaskTiming {
+    std::string name;
+    double start_ms = 0;    // since run() started
+    double end_ms = 0;
+    unsigned thread = 0;    // 0 is the thread that called run()
+    bool ran = false;       // false if it was skipped because something it needs failed
+};
+
+export class TaskGraph {
+public:
+    // deps have to be added first, so ids are already in a valid order.
+    TaskId add(std::string name, std::function<void()> work, std::vector<TaskId> deps = {},
+               Affinity affinity = Affinity::any) {
+        TaskId id = m_tasks.size();
+        for (TaskId d : deps) {
+            assert(d < id);
+            m_tasks[d].dependents.push_back(id);
+        }
+        m_tasks.push_back({ std::move(work), std::move(deps), {}, affinity });
+        m_timings.push_back({ std::move(name) });
+        return id;
+    }
+
+    size_t size() const { return m_tasks.size(); }
+
+    // Runs everything, using up to threads threads including this one (0 = one per core). If a
+    // task throws, whatever depends on it is skipped, the rest still runs, and the first exception
+    // is rethrown at the end.
+    void run(unsigned threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<unsigned>(threads, static_cast<unsigned>(std::max<size_t>(m_tasks.size(), 1)));
+
+        m_waiting.resize(m_tasks.size());
+        m_skipped.assign(m_tasks.size(), 0);
+        for (TaskId id = 0; id < m_tasks.size(); id++) {
+            m_waiting[id] = m_tasks[id].deps.size();
+            if (m_waiting[id] == 0) make_ready(id);
+        }
+        m_finished = 0;
+        m_error = nullptr;
+        m_start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::jthread> pool;
+            for (unsigned t = 1; t < threads; t++) {
+                pool.emplace_back([this, t] { worker(t); });
+            }
+            worker(0);
+        }
+        m_wall_ms = ms_since_start();
+        if (m_error) std::rethrow_exception(m_error);
+    }
+
+    const std::vector<TaskTiming>& timings() const { return m_timings; }
+    double wall_ms() const { return m_wall_ms; }
+
+    // The chain of dependent tasks with the most total run time, first to last. Startup can't get
+    // faster than this without speeding up one of these tasks.
+    std::vector<TaskId> critical_path() const {
+        if (m_tasks.empty()) return {};
+        std::vector<double> finish(m_tasks.size(), 0);
+        std::vector<TaskId> via(m_tasks.size(), SIZE_MAX);
+        for (TaskId id = 0; id < m_tasks.size(); id++) {
+            double before = 0;
+            for (TaskId d : m_tasks[id].deps) {
+                if (finish[d] > before) {
+                    before = finish[d];
+                    via[id] = d;
+                }
+            }
+            finish[id] = before + duration(id);
+        }
+        TaskId last = std::max_element(finish.begin(), finish.end()) - finish.begin();
+        std::vector<TaskId> path;
+        for (TaskId id = last; id != SIZE_MAX; id = via[id]) {
+            path.push_back(id);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Text profile of the last run: one line per task in start order, then totals.
+    std::string report() const {
+        std::vector<TaskId> order(m_tasks.size());
+        for (TaskId id = 0; id < order.size(); id++) order[id] = id;
+        std::sort(order.begin(), order.end(), [&](TaskId a, TaskId b) {
+            return m_timings[a].start_ms < m_timings[b].start_ms;
+        });
+        auto path = critical_path();
+        double busy = 0;
+        double path_ms = 0;
+        for (TaskId id = 0; id < m_tasks.size(); id++) busy += duration(id);
+        for (TaskId id : path) path_ms += duration(id);
+
+        std::string out;
+        for (TaskId id : order) {
+            const TaskTiming& t = m_timings[id];
+            bool critical = std::find(path.begin(), path.end(), id) != path.end();
+            if (t.ran) {
+                out += std::format("{:>8.2f} {:>8.2f} ms  thread {}  {}{}\n", t.start_ms, t.end_ms - t.start_ms,
+                                   t.thread, t.name, critical ? "  *" : "");
+            } else {
+                out += std::format("{:>8} {:>8}     skipped    {}\n", "-", "-", t.name);
+            }
+        }
+        out += std::format("wall {:.2f} ms, task time {:.2f} ms, critical path (*) {:.2f} ms\n",
+                           m_wall_ms, busy, path_ms);
+        return out;
+    }
+
+private:
+    struct Task {
+        std::function<void()> work;
+        std::vector<TaskId> deps;
+        std::vector<TaskId> dependents;
+        Affinity affinity;
+    };
+
+    double ms_since_start() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+    double duration(TaskId id) const {
+        const TaskTiming& t = m_timings[id];
+        return t.ran ? t.end_ms - t.start_ms : 0;
+    }
+
+    void make_ready(TaskId id) {
+        if (m_tasks[id].affinity == Affinity::caller) {
+            m_ready_caller.push_back(id);
+        } else {
+            m_ready.push_back(id);
+        }
+    }
+
+    // Thread 0 is the caller; it takes its own tasks first since nobody else can.
+    void worker(unsigned thread) {
+        std::unique_lock lock(m_mutex);
+        for (;;) {
+            m_cv.wait(lock, [&] {
+                return !m_ready.empty() || (thread == 0 && !m_ready_caller.empty()) || m_finished == m_tasks.size();
+            });
+            auto& queue = thread == 0 && !m_ready_caller.empty() ? m_ready_caller : m_ready;
+            if (queue.empty()) return;
+            TaskId id = queue.front();
+            queue.pop_front();
+            lock.unlock();
+
+            TaskTiming& t = m_timings[id];
+            t.thread = thread;
+            t.start_ms = ms_since_start();
+            std::exception_ptr error;
+            try {
+                m_tasks[id].work();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            t.end_ms = ms_since_start();
+            t.ran = true;
+
+            lock.lock();
+            m_finished++;
+            if (error) {
+                if (!m_error) m_error = error;
+                skip_dependents(id);
+            } else {
+                for (TaskId d : m_tasks[id].dependents) {
+                    if (!m_skipped[d] && --m_waiting[d] == 0) make_ready(d);
+                }
+            }
+            m_cv.notify_all();
+        }
+    }
+
+    // Called with the lock held.
+    void skip_dependents(TaskId id) {
+        for (TaskId d : m_tasks[id].dependents) {
+            if (m_skipped[d]) continue;     // already skipped through another path
+            m_skipped[d] = 1;
+            m_finished++;
+            skip_dependents(d);
+        }
+    }
+
+    std::vector<Task> m_tasks;
+    std::vector<TaskTiming> m_timings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<TaskId> m_ready;
+    std::deque<TaskId> m_ready_caller;
+    std::vector<size_t> m_waiting;  // unfinished deps per task
+    std::vector<uint8_t> m_skipped;
+    size_t m_finished = 0;
+    std::exception_ptr m_error;
+    std::chrono::steady_clock::time_point m_start;
+    double m_wall_ms = 0;
+};
+
+}
@@ -0,0 +1,202 @@
+module;
+
+#include <windows.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+#include <unknwn.h>
+#include <winrt/base.h>
+#include <cassert>
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+export module transient_heap;
+
+import render_graph;
+import memory_budget;
+import command_recorder;
+
+using winrt::com_ptr;
+using winrt::check_hresult;
+
+// The D3D side of render_graph: one heap per HeapClass and the graph's transients as placed
+// resources in them. Placed resources are kept from frame to frame while the graph asks for the
+// same thing at the same offset, so a steady frame creates nothing. Heaps only grow; release()
+// starts over (on resize, when the sizes change anyway).
+
+namespace gpu {
+
+export D3D12_RESOURCE_STATES resource_state(Access access) {
+    switch (access) {
+    case Access::shader_read:   return D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    case Access::compute_read:  return D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    case Access::copy_src:      return D3D12_RESOURCE_STATE_COPY_SOURCE;
+    case Access::copy_dst:      return D3D12_RESOURCE_STATE_COPY_DEST;
+    case Access::render_target: return D3D12_RESOURCE_STATE_RENDER_TARGET;
+    case Access::depth_write:   return D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    case Access::depth_read:    return D3D12_RESOURCE_STATE_DEPTH_READ;
+    case Access::unordered:     return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    case Access::indirect_argument: return D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+    case Access::present:       return D3D12_RESOURCE_STATE_PRESENT;
+    default:                    return D3D12_RESOURCE_STATE_COMMON;
+    }
+}
+
+D3D12_RESOURCE_DESC resource_desc(const TransientDesc& desc, uint32_t usage) {
+    D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
+    if (usage & usage_bit(Access::render_target)) {
+        flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+    }
+    if (usage & (usage_bit(Access::depth_write) | usage_bit(Access::depth_read))) {
+        flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+        if (!(usage & (usage_bit(Access::shader_read) | usage_bit(Access::compute_read)))) {
+            flags |= D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+        }
+    }
+    if (usage & usage_bit(Access::unordered)) {
+        flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    }
+    return CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT(desc.format), desc.width, desc.height, 1, 1,
+                                        desc.samples, desc.quality, flags);
+}
+
+export class TransientHeap {
+public:
+    TransientHeap(ID3D12Device* device, std::shared_ptr<MemoryBudget> budget)
+        : m_device(device), m_budget(std::move(budget)) {}
+
+    ~TransientHeap() { release(); }
+
+    PlacementFn placement() const {
+        return [device = m_device](const TransientDesc& desc, uint32_t usage) {
+            auto d = resource_desc(desc, usage);
+            auto info = device->GetResourceAllocationInfo(0, 1, &d);
+            return Placement{ info.SizeInBytes, info.Alignment };
+        };
+    }
+
+    // Makes the heaps and placed resources graph's compile() settled on. Nothing using resources
+    // that get replaced may still be in flight; the app waits for the GPU every frame.
+    void realize(const RenderGraph& graph) {
+        m_placed.resize(graph.resource_count());
+        for (size_t c = 0; c < m_heaps.size(); c++) {
+            auto& heap = m_heaps[c];
+            uint64_t size = graph.heap_size(HeapClass(c));
+            uint64_t alignment = graph.heap_alignment(HeapClass(c));
+            if (size <= heap.size && alignment <= heap.alignment) continue;
+
+            for (auto& placed : m_placed) {
+                if (placed.heap_class == HeapClass(c)) placed.resource = nullptr;
+            }
+            drop(heap);
+            auto flags = HeapClass(c) == HeapClass::targets ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+                                                            : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+            CD3DX12_HEAP_DESC desc(size, D3D12_HEAP_TYPE_DEFAULT, alignment, flags);
+            check_hresult(m_device->CreateHeap(&desc, __uuidof(heap.heap), heap.heap.put_void()));
+            heap.size = size;
+            heap.alignment = alignment;
+            heap.tracked = m_budget->track(HeapClass(c) == HeapClass::targets ? MemoryCategory::render_target
+                                                                             : MemoryCategory::texture,
+                                           size, HeapClass(c) == HeapClass::targets ? "transient targets"
+                                                                                    : "transient textures");
+        }
+
+        for (uint32_t i = 0; i < graph.resource_count(); i++) {
+            ResourceHandle h = { i };
+            auto& placed = m_placed[i];
+            if (!graph.transient(h) || !graph.used(h)) continue;
+            if (placed.resource && placed.desc == graph.desc(h) && placed.usage == graph.usage(h) &&
+                placed.heap_class == graph.heap_class(h) && placed.offset == graph.offset(h)) {
+                continue;
+            }
+            placed.desc = graph.desc(h);
+            placed.usage = graph.usage(h);
+            placed.heap_class = graph.heap_class(h);
+            placed.offset = graph.offset(h);
+            placed.state = resource_state(graph.first_access(h));
+            placed.resource = nullptr;
+
+            auto desc = resource_desc(placed.desc, placed.usage);
+            D3D12_CLEAR_VALUE clear = {};
+            bool depth = placed.usage & (usage_bit(Access::depth_write) | usage_bit(Access::depth_read));
+            clear.Format = DXGI_FORMAT(placed.desc.view_format ? placed.desc.view_format : placed.desc.format);
+            clear.DepthStencil.Depth = 1.0f;
+            check_hresult(m_device->CreatePlacedResource(m_heaps[size_t(placed.heap_class)].heap.get(), placed.offset,
+                                                         &desc, placed.state, depth ? &clear : nullptr,
+                                                         __uuidof(placed.resource), placed.resource.put_void()));
+            placed.resource->SetName(std::wstring(graph.name(h).begin(), graph.name(h).end()).c_str());
+        }
+    }
+
+    ID3D12Resource* resource(const RenderGraph& graph, ResourceHandle h) const {
+        if (!graph.transient(h)) {
+            return static_cast<ID3D12Resource*>(graph.external(h));
+        }
+        assert(h.index < m_placed.size() && m_placed[h.index].resource);
+        return m_placed[h.index].resource.get();
+    }
+
+    // For RenderGraph::execute(). One ResourceBarrier call per batch.
+    void barriers(capture::CommandRecorder& cmd, const RenderGraph& graph, std::span<const Barrier> barriers) {
+        m_batch.clear();
+        for (const auto& b : barriers) {
+            ID3D12Resource* r = resource(graph, b.resource);
+            if (b.kind == Barrier::Kind::aliasing) {
+                m_batch.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, r));
+                continue;
+            }
+            D3D12_RESOURCE_STATES before = resource_state(b.before);
+            D3D12_RESOURCE_STATES after = resource_state(b.after);
+            if (graph.transient(b.resource)) {
+                before = m_placed[b.resource.index].state;
+                m_placed[b.resource.index].state = after;
+            }
+            if (before != after) {
+                m_batch.push_back(CD3DX12_RESOURCE_BARRIER::Transition(r, before, after));
+            }
+        }
+        cmd.barriers(m_batch);
+    }
+
+    void release() {
+        m_placed.clear();
+        for (auto& heap : m_heaps) {
+            drop(heap);
+        }
+    }
+
+private:
+    struct Heap {
+        com_ptr<ID3D12Heap> heap;
+        uint64_t size = 0;
+        uint64_t alignment = 0;
+        AllocationId tracked = 0;
+    };
+
+    struct Placed {
+        com_ptr<ID3D12Resource> resource;
+        TransientDesc desc;
+        uint32_t usage = 0;
+        HeapClass heap_class = HeapClass::textures;
+        uint64_t offset = 0;
+        D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+    };
+
+    void drop(Heap& heap) {
+        if (heap.heap) {
+            m_budget->untrack(heap.tracked);
+        }
+        heap = {};
+    }
+
+    ID3D12Device* m_device;
+    std::shared_ptr<MemoryBudget> m_budget;
+    std::array<Heap, size_t(HeapClass::count)> m_heaps;
+    std::vector<Placed> m_placed;
+    std::vector<D3D12_RESOURCE_BARRIER> m_batch;
+};
+
+}
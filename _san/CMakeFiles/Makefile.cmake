@@ -0,0 +1,193 @@
+# CMAKE generated file: DO NOT EDIT!
+# Generated by "Unix Makefiles" Generator, CMake Version 3.25
+
+# The generator used is:
+set(CMAKE_DEPENDS_GENERATOR "Unix Makefiles")
+
+# The top level Makefile was generated from the following files:
+set(CMAKE_MAKEFILE_DEPENDS
+  "CMakeCache.txt"
+  "/root/repo/CMakeLists.txt"
+  "/root/repo/DrawOnTexture/blend_kernels.ixx"
+  "/root/repo/DrawOnTexture/canvas_export.ixx"
+  "/root/repo/DrawOnTexture/canvas_filters.ixx"
+  "/root/repo/DrawOnTexture/capture_replay.ixx"
+  "/root/repo/DrawOnTexture/cull_kernels.ixx"
+  "/root/repo/DrawOnTexture/descriptor_allocator.ixx"
+  "/root/repo/DrawOnTexture/distance_field.ixx"
+  "/root/repo/DrawOnTexture/filter_kernels.ixx"
+  "/root/repo/DrawOnTexture/flood_fill.ixx"
+  "/root/repo/DrawOnTexture/frame_capture.ixx"
+  "/root/repo/DrawOnTexture/frame_pacing.ixx"
+  "/root/repo/DrawOnTexture/glyph_cache.ixx"
+  "/root/repo/DrawOnTexture/glyph_rasterizer.ixx"
+  "/root/repo/DrawOnTexture/half_float.ixx"
+  "/root/repo/DrawOnTexture/jpeg_decoder.ixx"
+  "/root/repo/DrawOnTexture/layer_stack.ixx"
+  "/root/repo/DrawOnTexture/lz_codec.ixx"
+  "/root/repo/DrawOnTexture/memory_budget.ixx"
+  "/root/repo/DrawOnTexture/path_tessellator.ixx"
+  "/root/repo/DrawOnTexture/pixel_formats.ixx"
+  "/root/repo/DrawOnTexture/png_writer.ixx"
+  "/root/repo/DrawOnTexture/readback_ring.ixx"
+  "/root/repo/DrawOnTexture/render_device.ixx"
+  "/root/repo/DrawOnTexture/render_graph.ixx"
+  "/root/repo/DrawOnTexture/resample.ixx"
+  "/root/repo/DrawOnTexture/software_device.ixx"
+  "/root/repo/DrawOnTexture/spatial_index.ixx"
+  "/root/repo/DrawOnTexture/task_graph.ixx"
+  "/root/repo/DrawOnTexture/text_runs.ixx"
+  "/root/repo/DrawOnTexture/texture_streaming.ixx"
+  "/root/repo/DrawOnTexture/tile_canvas.ixx"
+  "/root/repo/DrawOnTexture/truetype_font.ixx"
+  "/root/repo/DrawOnTexture/undo_history.ixx"
+  "CMakeFiles/3.25.1/CMakeCXXCompiler.cmake"
+  "CMakeFiles/3.25.1/CMakeSystem.cmake"
+  "modules/blend_kernels.h.new"
+  "modules/canvas_export.h.new"
+  "modules/canvas_filters.h.new"
+  "modules/capture_replay.h.new"
+  "modules/cull_kernels.h.new"
+  "modules/descriptor_allocator.h.new"
+  "modules/distance_field.h.new"
+  "modules/filter_kernels.h.new"
+  "modules/flood_fill.h.new"
+  "modules/frame_capture.h.new"
+  "modules/frame_pacing.h.new"
+  "modules/glyph_cache.h.new"
+  "modules/glyph_rasterizer.h.new"
+  "modules/half_float.h.new"
+  "modules/jpeg_decoder.h.new"
+  "modules/layer_stack.h.new"
+  "modules/lz_codec.h.new"
+  "modules/memory_budget.h.new"
+  "modules/path_tessellator.h.new"
+  "modules/pixel_formats.h.new"
+  "modules/png_writer.h.new"
+  "modules/readback_ring.h.new"
+  "modules/render_device.h.new"
+  "modules/render_graph.h.new"
+  "modules/resample.h.new"
+  "modules/software_device.h.new"
+  "modules/spatial_index.h.new"
+  "modules/task_graph.h.new"
+  "modules/text_runs.h.new"
+  "modules/texture_streaming.h.new"
+  "modules/tile_canvas.h.new"
+  "modules/truetype_font.h.new"
+  "modules/undo_history.h.new"
+  "/root/repo/benchmarks/CMakeLists.txt"
+  "/root/repo/tests/CMakeLists.txt"
+  "/root/repo/tools/CMakeLists.txt"
+  "/usr/share/cmake-3.25/Modules/CMakeCXXInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeCommonLanguageInclude.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeGenericSystem.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeInitializeConfigs.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeLanguageInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInitialize.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckCXXSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckIncludeFileCXX.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckLibraryExists.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/CMakeCommonCompilerMacros.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU-CXX.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageHandleStandardArgs.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageMessage.cmake"
+  "/usr/share/cmake-3.25/Modules/FindThreads.cmake"
+  "/usr/share/cmake-3.25/Modules/Internal/CheckSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU-CXX.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/UnixPaths.cmake"
+  )
+
+# The corresponding makefile is:
+set(CMAKE_MAKEFILE_OUTPUTS
+  "Makefile"
+  "CMakeFiles/cmake.check_cache"
+  )
+
+# Byproducts of CMake generate step:
+set(CMAKE_MAKEFILE_PRODUCTS
+  "modules/blend_kernels.h"
+  "modules/canvas_export.h"
+  "modules/canvas_filters.h"
+  "modules/capture_replay.h"
+  "modules/cull_kernels.h"
+  "modules/descriptor_allocator.h"
+  "modules/distance_field.h"
+  "modules/filter_kernels.h"
+  "modules/flood_fill.h"
+  "modules/frame_capture.h"
+  "modules/frame_pacing.h"
+  "modules/glyph_cache.h"
+  "modules/glyph_rasterizer.h"
+  "modules/half_float.h"
+  "modules/jpeg_decoder.h"
+  "modules/layer_stack.h"
+  "modules/lz_codec.h"
+  "modules/memory_budget.h"
+  "modules/path_tessellator.h"
+  "modules/pixel_formats.h"
+  "modules/png_writer.h"
+  "modules/readback_ring.h"
+  "modules/render_device.h"
+  "modules/render_graph.h"
+  "modules/resample.h"
+  "modules/software_device.h"
+  "modules/spatial_index.h"
+  "modules/task_graph.h"
+  "modules/text_runs.h"
+  "modules/texture_streaming.h"
+  "modules/tile_canvas.h"
+  "modules/truetype_font.h"
+  "modules/undo_history.h"
+  "CMakeFiles/CMakeDirectoryInformation.cmake"
+  "tests/CMakeFiles/CMakeDirectoryInformation.cmake"
+  "benchmarks/CMakeFiles/CMakeDirectoryInformation.cmake"
+  "tools/CMakeFiles/CMakeDirectoryInformation.cmake"
+  )
+
+# Dependency information for all targets:
+set(CMAKE_DEPEND_INFO_FILES
+  "tests/CMakeFiles/blend_kernels_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/layer_stack_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/undo_history_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/pixel_formats_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/readback_ring_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/canvas_export_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/descriptor_allocator_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/task_graph_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/memory_budget_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/frame_capture_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/render_graph_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/spatial_index_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/cull_kernels_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/filter_kernels_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/flood_fill_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/path_tessellator_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/distance_field_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/resample_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/jpeg_decoder_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/frame_pacing_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/text_runs_test.dir/DependInfo.cmake"
+  "tests/CMakeFiles/texture_streaming_test.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/blend_kernels_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/undo_history_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/pixel_formats_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/readback_ring_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/software_device_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/render_graph_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/spatial_index_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/cull_kernels_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/filter_kernels_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/flood_fill_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/text_runs_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/path_tessellator_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/distance_field_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/resample_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/jpeg_decoder_bench.dir/DependInfo.cmake"
+  "benchmarks/CMakeFiles/texture_streaming_bench.dir/DependInfo.cmake"
+  "tools/CMakeFiles/replay_capture.dir/DependInfo.cmake"
+  )
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/blend_kernels_bench.dir/blend_kernels_bench.cpp.o"
+  "CMakeFiles/blend_kernels_bench.dir/blend_kernels_bench.cpp.o.d"
+  "blend_kernels_bench"
+  "blend_kernels_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/blend_kernels_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/cull_kernels_bench.dir/cull_kernels_bench.cpp.o"
+  "CMakeFiles/cull_kernels_bench.dir/cull_kernels_bench.cpp.o.d"
+  "cull_kernels_bench"
+  "cull_kernels_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/cull_kernels_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/distance_field_bench.dir/distance_field_bench.cpp.o"
+  "CMakeFiles/distance_field_bench.dir/distance_field_bench.cpp.o.d"
+  "distance_field_bench"
+  "distance_field_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/distance_field_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
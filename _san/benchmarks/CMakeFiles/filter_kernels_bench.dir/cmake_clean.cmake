@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/filter_kernels_bench.dir/filter_kernels_bench.cpp.o"
+  "CMakeFiles/filter_kernels_bench.dir/filter_kernels_bench.cpp.o.d"
+  "filter_kernels_bench"
+  "filter_kernels_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/filter_kernels_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/flood_fill_bench.dir/flood_fill_bench.cpp.o"
+  "CMakeFiles/flood_fill_bench.dir/flood_fill_bench.cpp.o.d"
+  "flood_fill_bench"
+  "flood_fill_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/flood_fill_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
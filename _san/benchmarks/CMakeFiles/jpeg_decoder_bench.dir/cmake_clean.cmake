@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/jpeg_decoder_bench.dir/jpeg_decoder_bench.cpp.o"
+  "CMakeFiles/jpeg_decoder_bench.dir/jpeg_decoder_bench.cpp.o.d"
+  "jpeg_decoder_bench"
+  "jpeg_decoder_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/jpeg_decoder_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/path_tessellator_bench.dir/path_tessellator_bench.cpp.o"
+  "CMakeFiles/path_tessellator_bench.dir/path_tessellator_bench.cpp.o.d"
+  "path_tessellator_bench"
+  "path_tessellator_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/path_tessellator_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
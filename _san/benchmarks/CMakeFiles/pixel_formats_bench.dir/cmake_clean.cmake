@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pixel_formats_bench.dir/pixel_formats_bench.cpp.o"
+  "CMakeFiles/pixel_formats_bench.dir/pixel_formats_bench.cpp.o.d"
+  "pixel_formats_bench"
+  "pixel_formats_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/pixel_formats_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/readback_ring_bench.dir/readback_ring_bench.cpp.o"
+  "CMakeFiles/readback_ring_bench.dir/readback_ring_bench.cpp.o.d"
+  "readback_ring_bench"
+  "readback_ring_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/readback_ring_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
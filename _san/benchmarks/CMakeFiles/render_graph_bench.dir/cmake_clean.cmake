@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/render_graph_bench.dir/render_graph_bench.cpp.o"
+  "CMakeFiles/render_graph_bench.dir/render_graph_bench.cpp.o.d"
+  "render_graph_bench"
+  "render_graph_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/render_graph_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/resample_bench.dir/resample_bench.cpp.o"
+  "CMakeFiles/resample_bench.dir/resample_bench.cpp.o.d"
+  "resample_bench"
+  "resample_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/resample_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
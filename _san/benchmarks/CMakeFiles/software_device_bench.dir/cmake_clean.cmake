@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/software_device_bench.dir/software_device_bench.cpp.o"
+  "CMakeFiles/software_device_bench.dir/software_device_bench.cpp.o.d"
+  "software_device_bench"
+  "software_device_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/software_device_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
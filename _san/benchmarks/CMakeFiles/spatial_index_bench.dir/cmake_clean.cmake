@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/spatial_index_bench.dir/spatial_index_bench.cpp.o"
+  "CMakeFiles/spatial_index_bench.dir/spatial_index_bench.cpp.o.d"
+  "spatial_index_bench"
+  "spatial_index_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/spatial_index_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
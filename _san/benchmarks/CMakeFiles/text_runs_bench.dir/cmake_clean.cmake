@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/text_runs_bench.dir/text_runs_bench.cpp.o"
+  "CMakeFiles/text_runs_bench.dir/text_runs_bench.cpp.o.d"
+  "text_runs_bench"
+  "text_runs_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/text_runs_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
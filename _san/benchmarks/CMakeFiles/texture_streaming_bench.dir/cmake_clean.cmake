@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/texture_streaming_bench.dir/texture_streaming_bench.cpp.o"
+  "CMakeFiles/texture_streaming_bench.dir/texture_streaming_bench.cpp.o.d"
+  "texture_streaming_bench"
+  "texture_streaming_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/texture_streaming_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/undo_history_bench.dir/undo_history_bench.cpp.o"
+  "CMakeFiles/undo_history_bench.dir/undo_history_bench.cpp.o.d"
+  "undo_history_bench"
+  "undo_history_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/undo_history_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
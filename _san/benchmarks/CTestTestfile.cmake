@@ -0,0 +1,38 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/benchmarks
+# Build directory: /root/repo/_san/benchmarks
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test([=[blend_kernels_bench]=] "/root/repo/_san/benchmarks/blend_kernels_bench" "--quick")
+set_tests_properties([=[blend_kernels_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;11;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[undo_history_bench]=] "/root/repo/_san/benchmarks/undo_history_bench" "--quick")
+set_tests_properties([=[undo_history_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;12;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[pixel_formats_bench]=] "/root/repo/_san/benchmarks/pixel_formats_bench" "--quick")
+set_tests_properties([=[pixel_formats_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;13;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[readback_ring_bench]=] "/root/repo/_san/benchmarks/readback_ring_bench" "--quick")
+set_tests_properties([=[readback_ring_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;14;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[software_device_bench]=] "/root/repo/_san/benchmarks/software_device_bench" "--quick")
+set_tests_properties([=[software_device_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;15;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[render_graph_bench]=] "/root/repo/_san/benchmarks/render_graph_bench" "--quick")
+set_tests_properties([=[render_graph_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;16;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[spatial_index_bench]=] "/root/repo/_san/benchmarks/spatial_index_bench" "--quick")
+set_tests_properties([=[spatial_index_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;17;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[cull_kernels_bench]=] "/root/repo/_san/benchmarks/cull_kernels_bench" "--quick")
+set_tests_properties([=[cull_kernels_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;18;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[filter_kernels_bench]=] "/root/repo/_san/benchmarks/filter_kernels_bench" "--quick")
+set_tests_properties([=[filter_kernels_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;19;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[flood_fill_bench]=] "/root/repo/_san/benchmarks/flood_fill_bench" "--quick")
+set_tests_properties([=[flood_fill_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;20;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[text_runs_bench]=] "/root/repo/_san/benchmarks/text_runs_bench" "--quick")
+set_tests_properties([=[text_runs_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;21;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[path_tessellator_bench]=] "/root/repo/_san/benchmarks/path_tessellator_bench" "--quick")
+set_tests_properties([=[path_tessellator_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;22;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[distance_field_bench]=] "/root/repo/_san/benchmarks/distance_field_bench" "--quick")
+set_tests_properties([=[distance_field_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;23;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[resample_bench]=] "/root/repo/_san/benchmarks/resample_bench" "--quick")
+set_tests_properties([=[resample_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;24;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[jpeg_decoder_bench]=] "/root/repo/_san/benchmarks/jpeg_decoder_bench" "--quick")
+set_tests_properties([=[jpeg_decoder_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;25;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
+add_test([=[texture_streaming_bench]=] "/root/repo/_san/benchmarks/texture_streaming_bench" "--quick")
+set_tests_properties([=[texture_streaming_bench]=] PROPERTIES  LABELS "bench" WORKING_DIRECTORY "/root/repo/benchmarks" _BACKTRACE_TRIPLES "/root/repo/benchmarks/CMakeLists.txt;7;add_test;/root/repo/benchmarks/CMakeLists.txt;26;dot_bench;/root/repo/benchmarks/CMakeLists.txt;0;")
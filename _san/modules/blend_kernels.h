@@ -0,0 +1,333 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "simd.h"
+
+
+
+#include "half_float.h"
+
+// CPU blend kernels for premultiplied pixels, ie. the D2D1_ALPHA_MODE_PREMULTIPLIED RGBA8 surface
+// draw_on_texture() renders to, and RGBA16F for layers that need more range. These are the inner
+// loops of brush stamping and layer flattening: dst = blend(src * opacity, dst).
+//
+// Every kernel has a scalar version that is the reference, and SSE4.1/AVX2 versions that must give
+// bit identical results. For RGBA8 that means the same rounded divide by 255 everywhere. For 16F
+// it means the same float operations in the same order (no FMA), with the conversions from
+// half_float, which round exactly like the scalar ones.
+
+namespace pixel {
+
+enum class BlendMode {
+    source_over,
+    multiply,
+    screen,
+    add,
+    erase,      // destination-out: remove dst where src has alpha
+};
+
+// --- scalar reference ----------------------------------------------------------------------------
+
+template <BlendMode M>
+uint32_t blend_channel8(uint32_t s, uint32_t d, uint32_t sa, uint32_t da) {
+    uint32_t r;
+    if constexpr (M == BlendMode::source_over) {
+        r = s + mul255(d, 255 - sa);
+    } else if constexpr (M == BlendMode::multiply) {
+        r = mul255(s, 255 - da) + mul255(d, 255 - sa) + mul255(s, d);
+    } else if constexpr (M == BlendMode::screen) {
+        r = s + d - mul255(s, d);
+    } else if constexpr (M == BlendMode::add) {
+        r = s + d;
+    } else {
+        r = mul255(d, 255 - sa);
+    }
+    return r > 255 ? 255 : r;
+}
+
+template <BlendMode M>
+void blend8_scalar(uint32_t* dst, const uint32_t* src, size_t count, uint32_t opacity) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t s = src[i];
+        uint32_t d = dst[i];
+        uint32_t sc[4], dc[4];
+        for (int c = 0; c < 4; c++) {
+            sc[c] = (s >> (8 * c)) & 0xff;
+            dc[c] = (d >> (8 * c)) & 0xff;
+            if (opacity != 255) sc[c] = mul255(sc[c], opacity);
+        }
+        uint32_t r = 0;
+        for (int c = 0; c < 4; c++) {
+            r |= blend_channel8<M>(sc[c], dc[c], sc[3], dc[3]) << (8 * c);
+        }
+        dst[i] = r;
+    }
+}
+
+template <BlendMode M>
+float blend_channel16f(float s, float d, float sa, float da) {
+    if constexpr (M == BlendMode::source_over) {
+        return s + d * (1.0f - sa);
+    } else if constexpr (M == BlendMode::multiply) {
+        float t = s * (1.0f - da);
+        t = t + d * (1.0f - sa);
+        return t + s * d;
+    } else if constexpr (M == BlendMode::screen) {
+        float t = s + d;
+        return t - s * d;
+    } else if constexpr (M == BlendMode::add) {
+        return s + d;
+    } else {
+        return d * (1.0f - sa);
+    }
+}
+
+template <BlendMode M>
+void blend16f_scalar(uint16_t* dst, const uint16_t* src, size_t count, float opacity) {
+    for (size_t i = 0; i < count; i++) {
+        float s[4], d[4];
+        for (int c = 0; c < 4; c++) {
+            s[c] = half_to_float(src[4 * i + c]) * opacity;
+            d[c] = half_to_float(dst[4 * i + c]);
+        }
+        for (int c = 0; c < 4; c++) {
+            dst[4 * i + c] = float_to_half(blend_channel16f<M>(s[c], d[c], s[3], d[3]));
+        }
+    }
+}
+
+#if SIMD_X86
+
+// --- SSE4.1 --------------------------------------------------------------------------------------
+
+// Pixels are widened to 16 bit lanes, 2 pixels per register.
+SIMD_TARGET_SSE41 inline __m128i alpha16_sse(__m128i v) {
+    const __m128i mask = _mm_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+    return _mm_shuffle_epi8(v, mask);
+}
+
+template <BlendMode M>
+SIMD_TARGET_SSE41 inline __m128i blend16_sse(__m128i s, __m128i d) {
+    const __m128i k255 = _mm_set1_epi16(255);
+    __m128i sa = alpha16_sse(s);
+    if constexpr (M == BlendMode::source_over) {
+        return _mm_add_epi16(s, mul255_sse(d, _mm_sub_epi16(k255, sa)));
+    } else if constexpr (M == BlendMode::multiply) {
+        __m128i da = alpha16_sse(d);
+        __m128i r = _mm_add_epi16(mul255_sse(s, _mm_sub_epi16(k255, da)), mul255_sse(d, _mm_sub_epi16(k255, sa)));
+        return _mm_add_epi16(r, mul255_sse(s, d));
+    } else if constexpr (M == BlendMode::screen) {
+        return _mm_sub_epi16(_mm_add_epi16(s, d), mul255_sse(s, d));
+    } else if constexpr (M == BlendMode::add) {
+        return _mm_add_epi16(s, d);
+    } else {
+        return mul255_sse(d, _mm_sub_epi16(k255, sa));
+    }
+}
+
+template <BlendMode M>
+SIMD_TARGET_SSE41 void blend8_sse41(uint32_t* dst, const uint32_t* src, size_t count, uint32_t opacity) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i op = _mm_set1_epi16(static_cast<short>(opacity));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        if (opacity != 255) {
+            s_lo = mul255_sse(s_lo, op);
+            s_hi = mul255_sse(s_hi, op);
+        }
+        __m128i r_lo = blend16_sse<M>(s_lo, _mm_unpacklo_epi8(d, zero));
+        __m128i r_hi = blend16_sse<M>(s_hi, _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(r_lo, r_hi));
+    }
+    blend8_scalar<M>(dst + i, src + i, count - i, opacity);
+}
+
+template <BlendMode M>
+SIMD_TARGET_SSE41 inline __m128 blend_ps_sse(__m128 s, __m128 d) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 sa = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+    if constexpr (M == BlendMode::source_over) {
+        return _mm_add_ps(s, _mm_mul_ps(d, _mm_sub_ps(one, sa)));
+    } else if constexpr (M == BlendMode::multiply) {
+        __m128 da = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 t = _mm_mul_ps(s, _mm_sub_ps(one, da));
+        t = _mm_add_ps(t, _mm_mul_ps(d, _mm_sub_ps(one, sa)));
+        return _mm_add_ps(t, _mm_mul_ps(s, d));
+    } else if constexpr (M == BlendMode::screen) {
+        return _mm_sub_ps(_mm_add_ps(s, d), _mm_mul_ps(s, d));
+    } else if constexpr (M == BlendMode::add) {
+        return _mm_add_ps(s, d);
+    } else {
+        return _mm_mul_ps(d, _mm_sub_ps(one, sa));
+    }
+}
+
+template <BlendMode M>
+SIMD_TARGET_SSE41 void blend16f_sse41(uint16_t* dst, const uint16_t* src, size_t count, float opacity) {
+    const __m128 op = _mm_set1_ps(opacity);
+    size_t i = 0;
+    // 2 pixels (8 halves) per iteration, one pixel per float register.
+    for (; i + 2 <= count; i += 2) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + 4 * i));
+        __m128 s0 = _mm_mul_ps(half_to_float_sse(_mm_cvtepu16_epi32(s)), op);
+        __m128 s1 = _mm_mul_ps(half_to_float_sse(_mm_cvtepu16_epi32(_mm_srli_si128(s, 8))), op);
+        __m128 d0 = half_to_float_sse(_mm_cvtepu16_epi32(d));
+        __m128 d1 = half_to_float_sse(_mm_cvtepu16_epi32(_mm_srli_si128(d, 8)));
+        __m128i r0 = float_to_half_sse(blend_ps_sse<M>(s0, d0));
+        __m128i r1 = float_to_half_sse(blend_ps_sse<M>(s1, d1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_packus_epi32(r0, r1));
+    }
+    blend16f_scalar<M>(dst + 4 * i, src + 4 * i, count - i, opacity);
+}
+
+// --- AVX2 ----------------------------------------------------------------------------------------
+
+// Same as the SSE path, 4 pixels per register. unpack/pack work within 128 bit lanes, and undo
+// each other, so pixel order survives the round trip.
+SIMD_TARGET_AVX2 inline __m256i alpha16_avx2(__m256i v) {
+    const __m256i mask = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15,
+                                          6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+    return _mm256_shuffle_epi8(v, mask);
+}
+
+template <BlendMode M>
+SIMD_TARGET_AVX2 inline __m256i blend16_avx2(__m256i s, __m256i d) {
+    const __m256i k255 = _mm256_set1_epi16(255);
+    __m256i sa = alpha16_avx2(s);
+    if constexpr (M == BlendMode::source_over) {
+        return _mm256_add_epi16(s, mul255_avx2(d, _mm256_sub_epi16(k255, sa)));
+    } else if constexpr (M == BlendMode::multiply) {
+        __m256i da = alpha16_avx2(d);
+        __m256i r = _mm256_add_epi16(mul255_avx2(s, _mm256_sub_epi16(k255, da)),
+                                     mul255_avx2(d, _mm256_sub_epi16(k255, sa)));
+        return _mm256_add_epi16(r, mul255_avx2(s, d));
+    } else if constexpr (M == BlendMode::screen) {
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), mul255_avx2(s, d));
+    } else if constexpr (M == BlendMode::add) {
+        return _mm256_add_epi16(s, d);
+    } else {
+        return mul255_avx2(d, _mm256_sub_epi16(k255, sa));
+    }
+}
+
+template <BlendMode M>
+SIMD_TARGET_AVX2 void blend8_avx2(uint32_t* dst, const uint32_t* src, size_t count, uint32_t opacity) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i op = _mm256_set1_epi16(static_cast<short>(opacity));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+        __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+        if (opacity != 255) {
+            s_lo = mul255_avx2(s_lo, op);
+            s_hi = mul255_avx2(s_hi, op);
+        }
+        __m256i r_lo = blend16_avx2<M>(s_lo, _mm256_unpacklo_epi8(d, zero));
+        __m256i r_hi = blend16_avx2<M>(s_hi, _mm256_unpackhi_epi8(d, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(r_lo, r_hi));
+    }
+    blend8_sse41<M>(dst + i, src + i, count - i, opacity);
+}
+
+template <BlendMode M>
+SIMD_TARGET_AVX2 inline __m256 blend_ps_avx2(__m256 s, __m256 d) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 sa = _mm256_permute_ps(s, _MM_SHUFFLE(3, 3, 3, 3));
+    if constexpr (M == BlendMode::source_over) {
+        return _mm256_add_ps(s, _mm256_mul_ps(d, _mm256_sub_ps(one, sa)));
+    } else if constexpr (M == BlendMode::multiply) {
+        __m256 da = _mm256_permute_ps(d, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256 t = _mm256_mul_ps(s, _mm256_sub_ps(one, da));
+        t = _mm256_add_ps(t, _mm256_mul_ps(d, _mm256_sub_ps(one, sa)));
+        return _mm256_add_ps(t, _mm256_mul_ps(s, d));
+    } else if constexpr (M == BlendMode::screen) {
+        return _mm256_sub_ps(_mm256_add_ps(s, d), _mm256_mul_ps(s, d));
+    } else if constexpr (M == BlendMode::add) {
+        return _mm256_add_ps(s, d);
+    } else {
+        return _mm256_mul_ps(d, _mm256_sub_ps(one, sa));
+    }
+}
+
+template <BlendMode M>
+SIMD_TARGET_AVX2 void blend16f_avx2(uint16_t* dst, const uint16_t* src, size_t count, float opacity) {
+    const __m256 op = _mm256_set1_ps(opacity);
+    size_t i = 0;
+    // 4 pixels (16 halves) per iteration, two pixels per float register.
+    for (; i + 4 <= count; i += 4) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + 4 * i));
+        __m256 s0 = _mm256_mul_ps(half_to_float_avx2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(s))), op);
+        __m256 s1 = _mm256_mul_ps(half_to_float_avx2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(s, 1))), op);
+        __m256 d0 = half_to_float_avx2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(d)));
+        __m256 d1 = half_to_float_avx2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(d, 1)));
+        __m256i r0 = float_to_half_avx2(blend_ps_avx2<M>(s0, d0));
+        __m256i r1 = float_to_half_avx2(blend_ps_avx2<M>(s1, d1));
+        // packus interleaves the 128 bit lanes; put them back in order.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(r0, r1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), packed);
+    }
+    blend16f_sse41<M>(dst + 4 * i, src + 4 * i, count - i, opacity);
+}
+
+#endif // SIMD_X86
+
+// --- dispatch ------------------------------------------------------------------------------------
+
+template <BlendMode M>
+void blend8_dispatch(uint32_t* dst, const uint32_t* src, size_t count, uint32_t opacity, simd::Level level) {
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: return blend8_avx2<M>(dst, src, count, opacity);
+    case simd::Level::sse41: return blend8_sse41<M>(dst, src, count, opacity);
+    default: break;
+    }
+#endif
+    blend8_scalar<M>(dst, src, count, opacity);
+}
+
+template <BlendMode M>
+void blend16f_dispatch(uint16_t* dst, const uint16_t* src, size_t count, float opacity, simd::Level level) {
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: return blend16f_avx2<M>(dst, src, count, opacity);
+    case simd::Level::sse41: return blend16f_sse41<M>(dst, src, count, opacity);
+    default: break;
+    }
+#endif
+    blend16f_scalar<M>(dst, src, count, opacity);
+}
+
+// Blends count premultiplied RGBA8 pixels of src into dst. opacity scales src first (255 = as is).
+void blend_rgba8(BlendMode mode, uint32_t* dst, const uint32_t* src, size_t count,
+                        uint8_t opacity = 255, simd::Level level = simd::Level::avx2) {
+    switch (mode) {
+    case BlendMode::source_over: return blend8_dispatch<BlendMode::source_over>(dst, src, count, opacity, level);
+    case BlendMode::multiply: return blend8_dispatch<BlendMode::multiply>(dst, src, count, opacity, level);
+    case BlendMode::screen: return blend8_dispatch<BlendMode::screen>(dst, src, count, opacity, level);
+    case BlendMode::add: return blend8_dispatch<BlendMode::add>(dst, src, count, opacity, level);
+    case BlendMode::erase: return blend8_dispatch<BlendMode::erase>(dst, src, count, opacity, level);
+    }
+}
+
+// Same for premultiplied RGBA16F; count is in pixels (4 halves each).
+void blend_rgba16f(BlendMode mode, uint16_t* dst, const uint16_t* src, size_t count,
+                          float opacity = 1.0f, simd::Level level = simd::Level::avx2) {
+    switch (mode) {
+    case BlendMode::source_over: return blend16f_dispatch<BlendMode::source_over>(dst, src, count, opacity, level);
+    case BlendMode::multiply: return blend16f_dispatch<BlendMode::multiply>(dst, src, count, opacity, level);
+    case BlendMode::screen: return blend16f_dispatch<BlendMode::screen>(dst, src, count, opacity, level);
+    case BlendMode::add: return blend16f_dispatch<BlendMode::add>(dst, src, count, opacity, level);
+    case BlendMode::erase: return blend16f_dispatch<BlendMode::erase>(dst, src, count, opacity, level);
+    }
+}
+
+}
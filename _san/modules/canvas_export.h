@@ -0,0 +1,266 @@
+#pragma once
+
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+
+#include "tile_canvas.h"
+#include "pixel_formats.h"
+#include "png_writer.h"
+
+// Saving happens on a background thread so a big export never holds up a frame. Jobs own their
+// pixels: either a buffer handed over by the caller (eg. from a GPU readback) or a snapshot of a
+// TileCanvas, which only copies the tile pointers; the canvas copies a tile on its next write if
+// the snapshot still has it.
+//
+// Two formats: PNG (straight alpha), and a raw tile dump that keeps the canvas bits exactly,
+// premultiplied, with empty tiles left out:
+//   "DOTTILE1", u32 width, u32 height, u32 tile_size,
+//   then per tile in row order a u8 present flag, followed by tile_bytes of pixels if it's set.
+
+namespace canvas {
+
+constexpr char tile_magic[8] = { 'D', 'O', 'T', 'T', 'I', 'L', 'E', '1' };
+
+enum class Alpha {
+    straight,
+    premultiplied,
+};
+
+struct ExportResult {
+    std::filesystem::path path;
+    bool ok = false;
+    std::string error;
+};
+
+struct CanvasSnapshot {
+    int width;
+    int height;
+    int tiles_x;
+    std::vector<std::shared_ptr<Tile>> tiles;
+
+    explicit CanvasSnapshot(const TileCanvas& c)
+        : width(c.width()), height(c.height()), tiles_x(c.tiles_x())
+    {
+        tiles.reserve(c.tile_count());
+        for (int i = 0; i < c.tile_count(); i++) {
+            tiles.push_back(c.shared_tile(i));
+        }
+    }
+};
+
+void write_tiles(const std::filesystem::path& path, const CanvasSnapshot& snap) {
+    std::ofstream file(path, std::ios::binary);
+    uint32_t header[3] = { uint32_t(snap.width), uint32_t(snap.height), uint32_t(tile_size) };
+    file.write(tile_magic, sizeof(tile_magic));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const auto& t : snap.tiles) {
+        char present = t ? 1 : 0;
+        file.write(&present, 1);
+        if (t) {
+            file.write(reinterpret_cast<const char*>(t->pixels.data()), tile_bytes);
+        }
+    }
+    if (!file) {
+        throw std::runtime_error("couldn't write " + path.string());
+    }
+}
+
+// Flattens the snapshot to straight alpha rows and writes a PNG.
+void write_canvas_png(const std::filesystem::path& path, const CanvasSnapshot& snap) {
+    std::vector<uint32_t> pixels(size_t(snap.width) * snap.height);
+    for (int y = 0; y < snap.height; y++) {
+        uint32_t* row = pixels.data() + size_t(y) * snap.width;
+        for (int tx = 0; tx < snap.tiles_x; tx++) {
+            int x0 = tx * tile_size;
+            int w = std::min(tile_size, snap.width - x0);
+            const Tile* t = snap.tiles[(y / tile_size) * snap.tiles_x + tx].get();
+            if (t) {
+                pixel::unpremultiply_rgba8(row + x0, t->row(y % tile_size), w);
+            } else {
+                std::fill(row + x0, row + x0 + w, 0u);
+            }
+        }
+    }
+    image::write_png(path, reinterpret_cast<const uint8_t*>(pixels.data()), snap.width, snap.height,
+                     size_t(snap.width) * 4);
+}
+
+// Reads back a tile dump. Throws std::runtime_error if it isn't one. The header is checked against
+// the file size before anything gets allocated for it, so a corrupt or hostile dump can't ask for
+// a huge canvas: every tile takes at least its present flag in the file.
+TileCanvas load_tiles(const std::filesystem::path& path) {
+    std::error_code ec;
+    uint64_t file_size = std::filesystem::file_size(path, ec);
+    std::ifstream file(path, std::ios::binary);
+    char magic[8] = {};
+    uint32_t header[3] = {};
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (ec || !file || memcmp(magic, tile_magic, sizeof(magic)) != 0 || header[2] != tile_size) {
+        throw std::runtime_error(path.string() + " isn't a tile dump");
+    }
+    uint64_t header_size = sizeof(magic) + sizeof(header);
+    uint64_t tiles_x = (uint64_t(header[0]) + tile_size - 1) / tile_size;
+    uint64_t tiles_y = (uint64_t(header[1]) + tile_size - 1) / tile_size;
+    bool dims_ok = header[0] > 0 && header[1] > 0 && header[0] <= INT_MAX && header[1] <= INT_MAX &&
+                   tiles_x * tiles_y <= INT_MAX;
+    if (!dims_ok || tiles_x * tiles_y > file_size - header_size) {
+        throw std::runtime_error(path.string() + " has a bad size");
+    }
+    TileCanvas canvas(static_cast<int>(header[0]), static_cast<int>(header[1]));
+    uint64_t remaining = file_size - header_size;
+    for (int i = 0; i < canvas.tile_count(); i++) {
+        char present = 0;
+        file.read(&present, 1);
+        // Whatever flags are still to come have to fit after this tile's pixels too.
+        uint64_t flags_left = uint64_t(canvas.tile_count() - i);
+        if (!file || (present != 0 && present != 1) || remaining < flags_left + (present ? tile_bytes : 0)) {
+            throw std::runtime_error(path.string() + " is truncated");
+        }
+        remaining -= 1;
+        if (present) {
+            auto t = std::make_shared<Tile>();
+            file.read(reinterpret_cast<char*>(t->pixels.data()), tile_bytes);
+            remaining -= tile_bytes;
+            canvas.set_shared_tile(i, std::move(t));
+        }
+    }
+    if (!file) {
+        throw std::runtime_error(path.string() + " is truncated");
+    }
+    canvas.clear_dirty();
+    return canvas;
+}
+
+class Exporter {
+public:
+    Exporter() {
+        m_worker = std::jthread([this](std::stop_token st) { worker_loop(st); });
+    }
+
+    Exporter(const Exporter&) = delete;
+    Exporter& operator=(const Exporter&) = delete;
+
+    // Finishes whatever is queued; quitting shouldn't lose a save.
+    ~Exporter() {
+        wait_idle();
+        {
+            std::lock_guard lock(m_mutex);
+            m_worker.request_stop();
+        }
+        m_queue_cv.notify_all();
+    }
+
+    // pixels are RGBA8, width * height of them with no padding. Premultiplied ones are converted
+    // on the export thread rather than by the caller.
+    void save_png(std::filesystem::path path, int width, int height, std::vector<uint32_t> pixels,
+                  Alpha alpha = Alpha::straight) {
+        assert(pixels.size() == size_t(width) * height);
+        auto data = std::make_shared<std::vector<uint32_t>>(std::move(pixels));
+        push(std::move(path), [=](const std::filesystem::path& p) {
+            if (alpha == Alpha::premultiplied) {
+                pixel::unpremultiply_rgba8(data->data(), data->data(), data->size());
+            }
+            image::write_png(p, reinterpret_cast<const uint8_t*>(data->data()), width, height, size_t(width) * 4);
+        });
+    }
+
+    void save_png(std::filesystem::path path, const TileCanvas& canvas) {
+        auto snap = std::make_shared<CanvasSnapshot>(canvas);
+        push(std::move(path), [=](const std::filesystem::path& p) { write_canvas_png(p, *snap); });
+    }
+
+    void save_tiles(std::filesystem::path path, const TileCanvas& canvas) {
+        auto snap = std::make_shared<CanvasSnapshot>(canvas);
+        push(std::move(path), [=](const std::filesystem::path& p) { write_tiles(p, *snap); });
+    }
+
+    // Jobs queued or being written.
+    size_t pending() const {
+        std::lock_guard lock(m_mutex);
+        return m_queue.size() + (m_busy ? 1 : 0);
+    }
+
+    void wait_idle() {
+        std::unique_lock lock(m_mutex);
+        m_idle_cv.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+    }
+
+    // Results of the jobs finished since the last call.
+    std::vector<ExportResult> take_results() {
+        std::lock_guard lock(m_mutex);
+        return std::exchange(m_results, {});
+    }
+
+private:
+    struct Job {
+        std::filesystem::path path;
+        std::function<void(const std::filesystem::path&)> write;
+    };
+
+    void push(std::filesystem::path path, std::function<void(const std::filesystem::path&)> write) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_queue.push_back({ std::move(path), std::move(write) });
+        }
+        m_queue_cv.notify_one();
+    }
+
+    void worker_loop(std::stop_token st) {
+        std::unique_lock lock(m_mutex);
+        while (!st.stop_requested()) {
+            if (m_queue.empty()) {
+                m_idle_cv.notify_all();
+                m_queue_cv.wait(lock, [&] { return st.stop_requested() || !m_queue.empty(); });
+                continue;
+            }
+            Job job = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy = true;
+            lock.unlock();
+
+            ExportResult result{ job.path, true, {} };
+            try {
+                job.write(job.path);
+            } catch (const std::exception& e) {
+                result.ok = false;
+                result.error = e.what();
+            }
+            job = {};   // let go of the pixels before saying we're done
+
+            lock.lock();
+            m_results.push_back(std::move(result));
+            m_busy = false;
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_queue_cv;
+    std::condition_variable m_idle_cv;
+    std::deque<Job> m_queue;
+    std::vector<ExportResult> m_results;
+    bool m_busy = false;
+
+    std::jthread m_worker;
+};
+
+}
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include "simd.h"
+
+
+
+// Row kernels for the canvas filters (canvas_filters.ixx), on premultiplied RGBA8:
+//
+// - convolve_rgba8(): dst[i] = sum of weights[t] * taps[t][i]. With taps at src - r .. src + r
+//   it's a horizontal blur of one row, with taps at r rows above .. r rows below it's a vertical
+//   one, so one kernel does both passes of a separable Gaussian.
+// - box_rows_rgba8() / box_columns_rgba8(): box blurs with running sums, so the cost doesn't grow
+//   with the radius. Three of them in a row are close to a Gaussian, which is how big radii go.
+// - unsharp_rgba8(): sharpen by pushing a pixel away from its blurred version.
+//
+// Like blend_kernels, the scalar version of each is the reference and the SSE4.1/AVX2 ones give
+// bit identical results: everything is integer, with the same rounding in every version. Weights
+// are 2.14 fixed point and always add up to exactly 1, so a blur never makes a colour channel
+// bigger than its alpha.
+
+namespace pixel {
+
+inline constexpr int weight_bits = 14;
+inline constexpr int max_gaussian_radius = 16;
+inline constexpr int max_box_radius = 127;
+
+struct GaussianKernel {
+    int radius = 0;
+    std::array<int16_t, 2 * max_gaussian_radius + 1> weights{};    // tap_count() used, symmetric
+
+    int tap_count() const { return 2 * radius + 1; }
+};
+
+// Radius is 3 sigma, capped at max_gaussian_radius. The weights are rounded to fixed point and
+// whatever the rounding lost goes on the centre tap.
+GaussianKernel gaussian_kernel(float sigma) {
+    GaussianKernel k;
+    if (!(sigma > 0.0f)) {
+        k.weights[0] = 1 << weight_bits;
+        return k;
+    }
+    k.radius = std::clamp(int(std::ceil(3.0f * sigma)), 1, max_gaussian_radius);
+    double w[2 * max_gaussian_radius + 1];
+    double total = 0.0;
+    for (int i = 0; i < k.tap_count(); i++) {
+        double x = i - k.radius;
+        w[i] = std::exp(-x * x / (2.0 * double(sigma) * sigma));
+        total += w[i];
+    }
+    int sum = 0;
+    for (int i = 0; i < k.tap_count(); i++) {
+        k.weights[i] = int16_t(std::lround(w[i] / total * (1 << weight_bits)));
+        sum += k.weights[i];
+    }
+    k.weights[k.radius] = int16_t(k.weights[k.radius] + (1 << weight_bits) - sum);
+    return k;
+}
+
+// Radii of three box blurs that together come closest to a Gaussian of sigma (Kuckir's "fastest
+// Gaussian blur"): two box sizes, an odd size and the next odd size up, mixed to match the variance.
+std::array<int, 3> box_radii(float sigma) {
+    constexpr int n = 3;
+    double s2 = double(sigma) * sigma;
+    int lower = int(std::floor(std::sqrt(12.0 * s2 / n + 1.0)));
+    if (lower % 2 == 0) lower--;
+    lower = std::max(lower, 1);
+    int smaller = int(std::lround((12.0 * s2 - n * lower * lower - 4.0 * n * lower - 3.0 * n) / (-4.0 * lower - 4.0)));
+    std::array<int, 3> radii;
+    for (int i = 0; i < n; i++) {
+        int size = i < smaller ? lower : lower + 2;
+        radii[i] = std::min((size - 1) / 2, max_box_radius);
+    }
+    return radii;
+}
+
+// --- scalar reference ----------------------------------------------------------------------------
+
+constexpr int32_t round_half = 1 << (weight_bits - 1);
+
+uint32_t channel(uint32_t p, int c) {
+    return (p >> (8 * c)) & 0xff;
+}
+
+void convolve_scalar(uint32_t* dst, const uint32_t* const* taps, const int16_t* weights, int tap_count,
+                     size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t r = 0;
+        for (int c = 0; c < 4; c++) {
+            int32_t sum = round_half;
+            for (int t = 0; t < tap_count; t++) {
+                sum += weights[t] * int32_t(channel(taps[t][i], c));
+            }
+            r |= uint32_t(sum >> weight_bits) << (8 * c);
+        }
+        dst[i] = r;
+    }
+}
+
+// A box of d pixels sums to at most 255 * d; dividing by d is a multiply by 2^16 / d. For
+// d <= 2 * max_box_radius + 1 the rounding can't push a full box of 255 past 255.
+uint32_t box_scale(int radius) {
+    assert(radius >= 0 && radius <= max_box_radius);
+    uint32_t d = 2 * radius + 1;
+    return ((1u << 16) + d / 2) / d;
+}
+
+uint32_t box_divide(uint32_t sum, uint32_t scale) {
+    return (sum * scale + (1u << 15)) >> 16;
+}
+
+void box_rows_scalar(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                     int rows, int radius) {
+    uint32_t scale = box_scale(radius);
+    for (int y = 0; y < rows; y++) {
+        const uint32_t* s = src + y * src_pitch;
+        uint32_t* d = dst + y * dst_pitch;
+        uint32_t sums[4] = {};
+        for (int k = -radius; k <= radius; k++) {
+            for (int c = 0; c < 4; c++) sums[c] += channel(s[k], c);
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t r = 0;
+            for (int c = 0; c < 4; c++) r |= box_divide(sums[c], scale) << (8 * c);
+            d[i] = r;
+            if (i + 1 == count) break;
+            const uint32_t add = s[i + radius + 1];
+            const uint32_t sub = s[ptrdiff_t(i) - radius];
+            for (int c = 0; c < 4; c++) sums[c] += channel(add, c) - channel(sub, c);
+        }
+    }
+}
+
+void box_columns_scalar(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                        int rows, int radius, uint32_t* sums) {
+    uint32_t scale = box_scale(radius);
+    std::fill(sums, sums + 4 * count, 0u);
+    for (int k = -radius; k <= radius; k++) {
+        const uint32_t* s = src + k * ptrdiff_t(src_pitch);
+        for (size_t i = 0; i < 4 * count; i++) sums[i] += channel(s[i / 4], int(i % 4));
+    }
+    for (int y = 0; y < rows; y++) {
+        uint32_t* d = dst + y * dst_pitch;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t r = 0;
+            for (int c = 0; c < 4; c++) r |= box_divide(sums[4 * i + c], scale) << (8 * c);
+            d[i] = r;
+        }
+        if (y + 1 == rows) break;
+        const uint32_t* add = src + (y + radius + 1) * ptrdiff_t(src_pitch);
+        const uint32_t* sub = src + (y - radius) * ptrdiff_t(src_pitch);
+        for (size_t i = 0; i < 4 * count; i++) {
+            sums[i] += channel(add[i / 4], int(i % 4)) - channel(sub[i / 4], int(i % 4));
+        }
+    }
+}
+
+// src + (src - blurred) * amount / 256 per channel, then alpha clamped to [0, 255] and colour to
+// [0, alpha] so the result is still premultiplied.
+void unsharp_scalar(uint32_t* dst, const uint32_t* src, const uint32_t* blurred, size_t count, int32_t amount) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t v[4];
+        for (int c = 0; c < 4; c++) {
+            int32_t s = int32_t(channel(src[i], c));
+            int32_t diff = s - int32_t(channel(blurred[i], c));
+            v[c] = s + ((diff * amount + 128) >> 8);
+        }
+        int32_t a = std::clamp(v[3], 0, 255);
+        uint32_t r = 0;
+        for (int c = 0; c < 4; c++) r |= uint32_t(std::clamp(v[c], 0, a)) << (8 * c);
+        dst[i] = r;
+    }
+}
+
+#if SIMD_X86
+
+// --- SSE4.1 --------------------------------------------------------------------------------------
+
+// Two taps at a time: their bytes interleaved and widened to 16 bits are (a, b) pairs that one
+// pmaddwd multiplies by (wa, wb) and adds. 4 pixels per iteration, one 32 bit sum per channel.
+SIMD_TARGET_SSE41
+void convolve_sse41(uint32_t* dst, const uint32_t* const* taps, const int16_t* weights, int tap_count,
+                    size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i acc0 = _mm_set1_epi32(round_half);
+        __m128i acc1 = acc0;
+        __m128i acc2 = acc0;
+        __m128i acc3 = acc0;
+        for (int t = 0; t < tap_count; t += 2) {
+            bool pair = t + 1 < tap_count;
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps[t] + i));
+            __m128i b = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps[t + 1] + i)) : zero;
+            __m128i w = _mm_set1_epi32(int32_t(uint16_t(weights[t])) | (pair ? int32_t(weights[t + 1]) << 16 : 0));
+            __m128i lo = _mm_unpacklo_epi8(a, b);
+            __m128i hi = _mm_unpackhi_epi8(a, b);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+        __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(acc0, weight_bits), _mm_srai_epi32(acc1, weight_bits));
+        __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(acc2, weight_bits), _mm_srai_epi32(acc3, weight_bits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(p01, p23));
+    }
+    if (i < count) {
+        const uint32_t* rest[2 * max_box_radius + 1];
+        for (int t = 0; t < tap_count; t++) rest[t] = taps[t] + i;
+        convolve_scalar(dst + i, rest, weights, tap_count, count - i);
+    }
+}
+
+SIMD_TARGET_SSE41 inline __m128i widen_sse(uint32_t p) {
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(p)));
+}
+
+SIMD_TARGET_SSE41 inline __m128i box_divide_sse(__m128i sums, __m128i scale) {
+    return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(sums, scale), _mm_set1_epi32(1 << 15)), 16);
+}
+
+SIMD_TARGET_SSE41 inline uint32_t narrow_sse(__m128i v) {
+    __m128i p = _mm_packus_epi32(v, v);
+    return uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(p, p)));
+}
+
+// The running sum is one pixel's four channels in one register; each step adds a pixel and drops one.
+SIMD_TARGET_SSE41
+void box_row_sse41(uint32_t* d, const uint32_t* s, size_t count, int radius) {
+    const __m128i scale = _mm_set1_epi32(int(box_scale(radius)));
+    __m128i sums = _mm_setzero_si128();
+    for (int k = -radius; k <= radius; k++) sums = _mm_add_epi32(sums, widen_sse(s[k]));
+    for (size_t i = 0; i < count; i++) {
+        d[i] = narrow_sse(box_divide_sse(sums, scale));
+        if (i + 1 == count) break;
+        sums = _mm_sub_epi32(_mm_add_epi32(sums, widen_sse(s[i + radius + 1])), widen_sse(s[ptrdiff_t(i) - radius]));
+    }
+}
+
+SIMD_TARGET_SSE41
+void box_rows_sse41(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                    int rows, int radius) {
+    for (int y = 0; y < rows; y++) {
+        box_row_sse41(dst + y * dst_pitch, src + y * src_pitch, count, radius);
+    }
+}
+
+SIMD_TARGET_SSE41 inline __m128i load_widen_sse(const uint32_t* p) {
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(*p)));
+}
+
+SIMD_TARGET_SSE41
+void box_columns_sse41(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                       int rows, int radius, uint32_t* sums) {
+    const __m128i scale = _mm_set1_epi32(int(box_scale(radius)));
+    auto sum_at = [&](size_t i) { return reinterpret_cast<__m128i*>(sums + 4 * i); };
+    for (size_t i = 0; i < count; i++) _mm_storeu_si128(sum_at(i), _mm_setzero_si128());
+    for (int k = -radius; k <= radius; k++) {
+        const uint32_t* s = src + k * ptrdiff_t(src_pitch);
+        for (size_t i = 0; i < count; i++) {
+            _mm_storeu_si128(sum_at(i), _mm_add_epi32(_mm_loadu_si128(sum_at(i)), load_widen_sse(s + i)));
+        }
+    }
+    for (int y = 0; y < rows; y++) {
+        uint32_t* d = dst + y * dst_pitch;
+        bool last = y + 1 == rows;
+        const uint32_t* add = src + (y + radius + 1) * ptrdiff_t(src_pitch);
+        const uint32_t* sub = src + (y - radius) * ptrdiff_t(src_pitch);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i v[4];
+            for (int k = 0; k < 4; k++) {
+                __m128i s = _mm_loadu_si128(sum_at(i + k));
+                v[k] = box_divide_sse(s, scale);
+                if (!last) {
+                    s = _mm_sub_epi32(_mm_add_epi32(s, load_widen_sse(add + i + k)), load_widen_sse(sub + i + k));
+                    _mm_storeu_si128(sum_at(i + k), s);
+                }
+            }
+            __m128i p = _mm_packus_epi16(_mm_packus_epi32(v[0], v[1]), _mm_packus_epi32(v[2], v[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), p);
+        }
+        for (; i < count; i++) {
+            __m128i s = _mm_loadu_si128(sum_at(i));
+            d[i] = narrow_sse(box_divide_sse(s, scale));
+            if (!last) {
+                _mm_storeu_si128(sum_at(i), _mm_sub_epi32(_mm_add_epi32(s, load_widen_sse(add + i)),
+                                                          load_widen_sse(sub + i)));
+            }
+        }
+    }
+}
+
+// One pixel per register, 4 pixels per iteration.
+SIMD_TARGET_SSE41 inline __m128i unsharp_px_sse(__m128i s, __m128i b, __m128i amount) {
+    __m128i diff = _mm_mullo_epi32(_mm_sub_epi32(s, b), amount);
+    __m128i v = _mm_add_epi32(s, _mm_srai_epi32(_mm_add_epi32(diff, _mm_set1_epi32(128)), 8));
+    __m128i a = _mm_min_epi32(_mm_max_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)), _mm_setzero_si128()),
+                              _mm_set1_epi32(255));
+    return _mm_min_epi32(_mm_max_epi32(v, _mm_setzero_si128()), a);
+}
+
+SIMD_TARGET_SSE41
+void unsharp_sse41(uint32_t* dst, const uint32_t* src, const uint32_t* blurred, size_t count, int32_t amount) {
+    const __m128i amt = _mm_set1_epi32(amount);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v[4];
+        for (int k = 0; k < 4; k++) {
+            v[k] = unsharp_px_sse(load_widen_sse(src + i + k), load_widen_sse(blurred + i + k), amt);
+        }
+        __m128i p = _mm_packus_epi16(_mm_packus_epi32(v[0], v[1]), _mm_packus_epi32(v[2], v[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), p);
+    }
+    unsharp_scalar(dst + i, src + i, blurred + i, count - i, amount);
+}
+
+// --- AVX2 ----------------------------------------------------------------------------------------
+
+// Same as the SSE4.1 version, 8 pixels per iteration. unpack and pack work within 128 bit lanes,
+// so both halves come out in order without any cross lane shuffles.
+SIMD_TARGET_AVX2
+void convolve_avx2(uint32_t* dst, const uint32_t* const* taps, const int16_t* weights, int tap_count,
+                   size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i acc0 = _mm256_set1_epi32(round_half);
+        __m256i acc1 = acc0;
+        __m256i acc2 = acc0;
+        __m256i acc3 = acc0;
+        for (int t = 0; t < tap_count; t += 2) {
+            bool pair = t + 1 < tap_count;
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps[t] + i));
+            __m256i b = pair ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps[t + 1] + i)) : zero;
+            __m256i w = _mm256_set1_epi32(int32_t(uint16_t(weights[t])) | (pair ? int32_t(weights[t + 1]) << 16 : 0));
+            __m256i lo = _mm256_unpacklo_epi8(a, b);
+            __m256i hi = _mm256_unpackhi_epi8(a, b);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+        }
+        __m256i p01 = _mm256_packs_epi32(_mm256_srai_epi32(acc0, weight_bits), _mm256_srai_epi32(acc1, weight_bits));
+        __m256i p23 = _mm256_packs_epi32(_mm256_srai_epi32(acc2, weight_bits), _mm256_srai_epi32(acc3, weight_bits));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(p01, p23));
+    }
+    if (i < count) {
+        const uint32_t* rest[2 * max_box_radius + 1];
+        for (int t = 0; t < tap_count; t++) rest[t] = taps[t] + i;
+        convolve_sse41(dst + i, rest, weights, tap_count, count - i);
+    }
+}
+
+// Pixel a's channels in the low lane, b's in the high one.
+SIMD_TARGET_AVX2 inline __m256i widen2(const uint32_t* a, const uint32_t* b) {
+    return _mm256_cvtepu8_epi32(_mm_unpacklo_epi32(_mm_cvtsi32_si128(int(*a)), _mm_cvtsi32_si128(int(*b))));
+}
+
+// Two rows at once, one in each half of the register.
+SIMD_TARGET_AVX2
+void box_rows_avx2(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                   int rows, int radius) {
+    const __m256i scale = _mm256_set1_epi32(int(box_scale(radius)));
+    const __m256i half = _mm256_set1_epi32(1 << 15);
+    int y = 0;
+    for (; y + 2 <= rows; y += 2) {
+        const uint32_t* s0 = src + y * src_pitch;
+        const uint32_t* s1 = s0 + src_pitch;
+        uint32_t* d0 = dst + y * dst_pitch;
+        uint32_t* d1 = d0 + dst_pitch;
+        __m256i sums = _mm256_setzero_si256();
+        for (int k = -radius; k <= radius; k++) sums = _mm256_add_epi32(sums, widen2(s0 + k, s1 + k));
+        for (size_t i = 0; i < count; i++) {
+            __m256i v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sums, scale), half), 16);
+            __m256i p = _mm256_packus_epi32(v, v);
+            p = _mm256_packus_epi16(p, p);
+            d0[i] = uint32_t(_mm256_cvtsi256_si32(p));
+            d1[i] = uint32_t(_mm_cvtsi128_si32(_mm256_extracti128_si256(p, 1)));
+            if (i + 1 == count) break;
+            sums = _mm256_add_epi32(sums, widen2(s0 + i + radius + 1, s1 + i + radius + 1));
+            sums = _mm256_sub_epi32(sums, widen2(s0 + i - radius, s1 + i - radius));
+        }
+    }
+    if (y < rows) {
+        box_row_sse41(dst + y * dst_pitch, src + y * src_pitch, count, radius);
+    }
+}
+
+// 8 pixels of 32 bit channels, two per register, to 8 packed pixels. The in-lane packs leave them
+// in the order 0 2 4 6 | 1 3 5 7.
+SIMD_TARGET_AVX2 inline __m256i pack8_avx2(__m256i v0, __m256i v1, __m256i v2, __m256i v3) {
+    __m256i p = _mm256_packus_epi16(_mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3));
+    return _mm256_permutevar8x32_epi32(p, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+SIMD_TARGET_AVX2 inline __m256i load_widen2_avx2(const uint32_t* p) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+
+SIMD_TARGET_AVX2
+void box_columns_avx2(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                      int rows, int radius, uint32_t* sums) {
+    const __m256i scale = _mm256_set1_epi32(int(box_scale(radius)));
+    const __m256i half = _mm256_set1_epi32(1 << 15);
+    size_t wide = count & ~size_t(7);
+    auto sum_at = [&](size_t i) { return reinterpret_cast<__m256i*>(sums + 4 * i); };
+    for (size_t i = 0; i < wide; i += 2) _mm256_storeu_si256(sum_at(i), _mm256_setzero_si256());
+    for (int k = -radius; k <= radius; k++) {
+        const uint32_t* s = src + k * ptrdiff_t(src_pitch);
+        for (size_t i = 0; i < wide; i += 2) {
+            _mm256_storeu_si256(sum_at(i), _mm256_add_epi32(_mm256_loadu_si256(sum_at(i)), load_widen2_avx2(s + i)));
+        }
+    }
+    for (int y = 0; y < rows; y++) {
+        uint32_t* d = dst + y * dst_pitch;
+        bool last = y + 1 == rows;
+        const uint32_t* add = src + (y + radius + 1) * ptrdiff_t(src_pitch);
+        const uint32_t* sub = src + (y - radius) * ptrdiff_t(src_pitch);
+        for (size_t i = 0; i < wide; i += 8) {
+            __m256i v[4];
+            for (int k = 0; k < 4; k++) {
+                __m256i s = _mm256_loadu_si256(sum_at(i + 2 * k));
+                v[k] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(s, scale), half), 16);
+                if (!last) {
+                    s = _mm256_add_epi32(s, load_widen2_avx2(add + i + 2 * k));
+                    _mm256_storeu_si256(sum_at(i + 2 * k), _mm256_sub_epi32(s, load_widen2_avx2(sub + i + 2 * k)));
+                }
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), pack8_avx2(v[0], v[1], v[2], v[3]));
+        }
+    }
+    if (wide < count) {
+        box_columns_sse41(dst + wide, dst_pitch, src + wide, src_pitch, count - wide, rows, radius, sums + 4 * wide);
+    }
+}
+
+SIMD_TARGET_AVX2
+void unsharp_avx2(uint32_t* dst, const uint32_t* src, const uint32_t* blurred, size_t count, int32_t amount) {
+    const __m256i amt = _mm256_set1_epi32(amount);
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k255 = _mm256_set1_epi32(255);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v[4];
+        for (int k = 0; k < 4; k++) {
+            __m256i s = load_widen2_avx2(src + i + 2 * k);
+            __m256i diff = _mm256_mullo_epi32(_mm256_sub_epi32(s, load_widen2_avx2(blurred + i + 2 * k)), amt);
+            __m256i r = _mm256_add_epi32(s, _mm256_srai_epi32(_mm256_add_epi32(diff, round), 8));
+            __m256i a = _mm256_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm256_min_epi32(_mm256_max_epi32(a, zero), k255);
+            v[k] = _mm256_min_epi32(_mm256_max_epi32(r, zero), a);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), pack8_avx2(v[0], v[1], v[2], v[3]));
+    }
+    unsharp_sse41(dst + i, src + i, blurred + i, count - i, amount);
+}
+
+#endif // SIMD_X86
+
+// dst[i] = sum over t of weights[t] * taps[t][i], per channel, rounded. Weights are 2.14 fixed
+// point, non-negative and add up to 1 << weight_bits. dst can't be one of the taps.
+void convolve_rgba8(uint32_t* dst, const uint32_t* const* taps, const int16_t* weights, int tap_count,
+                           size_t count, simd::Level level = simd::Level::avx2) {
+    assert(tap_count > 0 && tap_count <= 2 * max_box_radius + 1);
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: convolve_avx2(dst, taps, weights, tap_count, count); return;
+    case simd::Level::sse41: convolve_sse41(dst, taps, weights, tap_count, count); return;
+    default: break;
+    }
+#endif
+    convolve_scalar(dst, taps, weights, tap_count, count);
+}
+
+// Horizontal box blur of rows rows: each dst pixel is the average of the 2 * radius + 1 around the
+// same spot in src. src has to be readable radius pixels either side of [0, count).
+void box_rows_rgba8(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch, size_t count,
+                           int rows, int radius, simd::Level level = simd::Level::avx2) {
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: box_rows_avx2(dst, dst_pitch, src, src_pitch, count, rows, radius); return;
+    case simd::Level::sse41: box_rows_sse41(dst, dst_pitch, src, src_pitch, count, rows, radius); return;
+    default: break;
+    }
+#endif
+    box_rows_scalar(dst, dst_pitch, src, src_pitch, count, rows, radius);
+}
+
+// Vertical box blur: src has to be readable radius rows above and below [0, rows). sums is
+// scratch for 4 * count values.
+void box_columns_rgba8(uint32_t* dst, size_t dst_pitch, const uint32_t* src, size_t src_pitch,
+                              size_t count, int rows, int radius, uint32_t* sums,
+                              simd::Level level = simd::Level::avx2) {
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: box_columns_avx2(dst, dst_pitch, src, src_pitch, count, rows, radius, sums); return;
+    case simd::Level::sse41: box_columns_sse41(dst, dst_pitch, src, src_pitch, count, rows, radius, sums); return;
+    default: break;
+    }
+#endif
+    box_columns_scalar(dst, dst_pitch, src, src_pitch, count, rows, radius, sums);
+}
+
+// Unsharp mask: src pushed away from blurred by amount (8.8 fixed point, 256 doubles the
+// difference). dst can be src or blurred.
+void unsharp_rgba8(uint32_t* dst, const uint32_t* src, const uint32_t* blurred, size_t count,
+                          int32_t amount, simd::Level level = simd::Level::avx2) {
+    assert(amount >= 0 && amount <= 16 * 256);
+#if SIMD_X86
+    switch (simd::usable_level(level)) {
+    case simd::Level::avx2: unsharp_avx2(dst, src, blurred, count, amount); return;
+    case simd::Level::sse41: unsharp_sse41(dst, src, blurred, count, amount); return;
+    default: break;
+    }
+#endif
+    unsharp_scalar(dst, src, blurred, count, amount);
+}
+
+}
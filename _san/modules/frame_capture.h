@@ -0,0 +1,555 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+
+// A compact binary record of the commands a frame sends to the GPU, and a player for it. The
+// recording side (command_recorder) sits between draw() and the command list; playback feeds the
+// commands to a Backend: CountingBackend below, capture_replay's DeviceBackend, which draws them
+// with a render::Device (the software one, say), or anything else.
+//
+// Nothing in here touches D3D so captures can be replayed anywhere. D3D values (resource states,
+// DXGI formats, topologies) are stored as their plain numbers.
+//
+// The stream:
+//   header: "DOTCAP\0\0", u32 version, u32 reserved
+//   records: u8 op, u32 payload size, payload
+// Payloads are the structs below, copied as is (little endian). A reader skips ops it doesn't
+// know and zero fills fields missing from a shorter payload, so new ops and new fields at the
+// end of a struct don't need a new version; anything else does.
+
+namespace capture {
+
+inline constexpr uint32_t format_version = 1;
+constexpr char magic[8] = { 'D', 'O', 'T', 'C', 'A', 'P', 0, 0 };
+
+enum class Op : uint8_t {
+    begin_frame = 1,
+    end_frame,
+    declare_resource,
+    upload,
+    barrier,
+    clear_color,
+    clear_depth,
+    viewport,
+    scissor,
+    render_targets,
+    pipeline,
+    root_signature,
+    vertex_buffer,
+    index_buffer,
+    topology,
+    root_table,
+    root_constant,
+    draw_indexed,
+    copy_region,
+};
+
+// Resources and pipeline objects are referred to by small ids handed out by the Writer. 0 is none.
+using ObjectId = uint32_t;
+
+enum class ResourceKind : uint32_t {
+    buffer,
+    texture2d,
+};
+
+struct BeginFrame {
+    static constexpr Op op = Op::begin_frame;
+    uint64_t frame;
+};
+
+struct EndFrame {
+    static constexpr Op op = Op::end_frame;
+    uint64_t frame;
+};
+
+struct DeclareResource {
+    static constexpr Op op = Op::declare_resource;
+    ObjectId id;
+    ResourceKind kind;
+    uint64_t width;         // bytes for buffers
+    uint32_t height;
+    uint32_t format;        // DXGI_FORMAT
+};
+
+// Followed by size bytes of data in the same record.
+struct Upload {
+    static constexpr Op op = Op::upload;
+    ObjectId resource;
+    uint32_t size;
+    uint64_t offset;
+};
+
+struct Barrier {
+    static constexpr Op op = Op::barrier;
+    ObjectId resource;
+    uint32_t before;        // D3D12_RESOURCE_STATES
+    uint32_t after;
+};
+
+struct ClearColor {
+    static constexpr Op op = Op::clear_color;
+    ObjectId target;
+    float color[4];
+};
+
+struct ClearDepth {
+    static constexpr Op op = Op::clear_depth;
+    ObjectId target;
+    float depth;
+    uint32_t stencil;
+};
+
+struct Viewport {
+    static constexpr Op op = Op::viewport;
+    float x, y, width, height, min_depth, max_depth;
+};
+
+struct Scissor {
+    static constexpr Op op = Op::scissor;
+    int32_t left, top, right, bottom;
+};
+
+struct RenderTargets {
+    static constexpr Op op = Op::render_targets;
+    ObjectId color;
+    ObjectId depth;
+};
+
+struct Pipeline {
+    static constexpr Op op = Op::pipeline;
+    ObjectId id;
+};
+
+struct RootSignature {
+    static constexpr Op op = Op::root_signature;
+    ObjectId id;
+};
+
+struct VertexBuffer {
+    static constexpr Op op = Op::vertex_buffer;
+    ObjectId resource;
+    uint32_t size;
+    uint32_t stride;
+    uint32_t offset;
+};
+
+struct IndexBuffer {
+    static constexpr Op op = Op::index_buffer;
+    ObjectId resource;
+    uint32_t size;
+    uint32_t format;        // DXGI_FORMAT_R16_UINT or R32_UINT
+    uint32_t offset;
+};
+
+struct Topology {
+    static constexpr Op op = Op::topology;
+    uint32_t topology;      // D3D_PRIMITIVE_TOPOLOGY
+};
+
+// A descriptor table by its index in the one shader-visible heap. For a constant buffer table the
+// buffer is named too, so a replay can bind the constants it was sent without knowing the heap.
+struct RootTable {
+    static constexpr Op op = Op::root_table;
+    uint32_t param;
+    uint32_t descriptor;
+    ObjectId resource;      // 0 if not a constant buffer, or from before it was recorded
+};
+
+struct RootConstant {
+    static constexpr Op op = Op::root_constant;
+    uint32_t param;
+    uint32_t value;
+    uint32_t offset;
+};
+
+struct DrawIndexed {
+    static constexpr Op op = Op::draw_indexed;
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t start_index;
+    int32_t base_vertex;
+    uint32_t start_instance;
+};
+
+struct CopyRegion {
+    static constexpr Op op = Op::copy_region;
+    ObjectId dst;
+    ObjectId src;
+    uint32_t dst_x, dst_y;
+    uint32_t left, top, right, bottom;
+};
+
+// Writes records into a buffer and hands each finished frame to sink in one piece, so a capture
+// costs a few memcpys per command while it's on and nothing when it's off.
+class Writer {
+public:
+    using Sink = std::function<void(std::span<const uint8_t>)>;
+
+    explicit Writer(Sink sink) : m_sink(std::move(sink)) {
+        m_buffer.reserve(64 * 1024);
+        m_buffer.insert(m_buffer.end(), magic, magic + sizeof(magic));
+        put(format_version);
+        put(uint32_t(0));
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() { flush(); }
+
+    template <class T>
+    void record(const T& cmd) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_buffer.push_back(uint8_t(T::op));
+        put(uint32_t(sizeof(T)));
+        put(cmd);
+        m_commands++;
+        if constexpr (T::op == Op::end_frame) flush();
+    }
+
+    void upload(ObjectId resource, uint64_t offset, std::span<const uint8_t> data) {
+        Upload cmd = { resource, uint32_t(data.size()), offset };
+        m_buffer.push_back(uint8_t(Op::upload));
+        put(uint32_t(sizeof(cmd) + data.size()));
+        put(cmd);
+        m_buffer.insert(m_buffer.end(), data.begin(), data.end());
+        m_commands++;
+    }
+
+    // The id for key (eg. an ID3D12Resource*), or 0 if it hasn't been seen or was seen with a
+    // different description, which happens when a released object's address gets reused.
+    ObjectId find(const void* key, const DeclareResource& desc) const {
+        auto it = m_ids.find(key);
+        if (it == m_ids.end()) return 0;
+        const DeclareResource& d = it->second;
+        bool same = d.kind == desc.kind && d.width == desc.width && d.height == desc.height && d.format == desc.format;
+        return same ? d.id : 0;
+    }
+
+    // Gives key an id and records its description. desc.id is filled in.
+    ObjectId declare(const void* key, DeclareResource desc) {
+        desc.id = m_next_id++;
+        m_ids[key] = desc;
+        record(desc);
+        return desc.id;
+    }
+
+    // Ids for things replay doesn't need described (pipeline states, root signatures).
+    ObjectId object(const void* key) {
+        auto [it, added] = m_objects.try_emplace(key, 0);
+        if (added) it->second = m_next_id++;
+        return it->second;
+    }
+
+    uint64_t bytes_written() const { return m_written; }
+    uint64_t commands() const { return m_commands; }
+
+    void flush() {
+        if (m_buffer.empty()) return;
+        m_sink(m_buffer);
+        m_written += m_buffer.size();
+        m_buffer.clear();
+    }
+
+private:
+    template <class T>
+    void put(const T& value) {
+        auto p = reinterpret_cast<const uint8_t*>(&value);
+        m_buffer.insert(m_buffer.end(), p, p + sizeof(T));
+    }
+
+    Sink m_sink;
+    std::vector<uint8_t> m_buffer;
+    std::unordered_map<const void*, DeclareResource> m_ids;
+    std::unordered_map<const void*, ObjectId> m_objects;
+    ObjectId m_next_id = 1;
+    uint64_t m_written = 0;
+    uint64_t m_commands = 0;
+};
+
+// A Writer sink that writes to a file from a thread of its own, so the frame handing over its
+// commands never waits on the disk. Throws std::runtime_error if the file can't be opened.
+// Whatever is still queued is written before the destructor returns.
+class FileSink {
+public:
+    explicit FileSink(const std::filesystem::path& path) : m_file(path, std::ios::binary) {
+        if (!m_file) {
+            throw std::runtime_error("frame_capture: couldn't open " + path.string());
+        }
+        m_worker = std::jthread([this](std::stop_token st) { worker_loop(st); });
+    }
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    ~FileSink() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_worker.request_stop();
+        }
+        m_cv.notify_one();
+        m_worker.join();
+    }
+
+    // Copies bytes to the queue; the only cost to the caller.
+    void write(std::span<const uint8_t> bytes) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_queued.insert(m_queued.end(), bytes.begin(), bytes.end());
+        }
+        m_cv.notify_one();
+    }
+
+    // Whether a write has failed (disk full, say). The rest of the capture is dropped.
+    bool failed() const {
+        std::lock_guard lock(m_mutex);
+        return m_failed;
+    }
+
+private:
+    void worker_loop(std::stop_token st) {
+        std::vector<uint8_t> writing;
+        std::unique_lock lock(m_mutex);
+        for (;;) {
+            m_cv.wait(lock, [&] { return st.stop_requested() || !m_queued.empty(); });
+            if (m_queued.empty()) break;
+            std::swap(writing, m_queued);
+            lock.unlock();
+            if (m_file) {
+                m_file.write(reinterpret_cast<const char*>(writing.data()), std::streamsize(writing.size()));
+            }
+            writing.clear();
+            lock.lock();
+            m_failed = !m_file;
+        }
+        lock.unlock();
+        m_file.flush();
+    }
+
+    std::ofstream m_file;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<uint8_t> m_queued;
+    bool m_failed = false;
+    std::jthread m_worker;
+};
+
+// What replay drives. Everything defaults to doing nothing, so a backend only overrides what it
+// cares about.
+class Backend {
+public:
+    virtual ~Backend() = default;
+    virtual void execute(const BeginFrame&) {}
+    virtual void execute(const EndFrame&) {}
+    virtual void execute(const DeclareResource&) {}
+    virtual void execute(const Upload&, std::span<const uint8_t> data) {}
+    virtual void execute(const Barrier&) {}
+    virtual void execute(const ClearColor&) {}
+    virtual void execute(const ClearDepth&) {}
+    virtual void execute(const Viewport&) {}
+    virtual void execute(const Scissor&) {}
+    virtual void execute(const RenderTargets&) {}
+    virtual void execute(const Pipeline&) {}
+    virtual void execute(const RootSignature&) {}
+    virtual void execute(const VertexBuffer&) {}
+    virtual void execute(const IndexBuffer&) {}
+    virtual void execute(const Topology&) {}
+    virtual void execute(const RootTable&) {}
+    virtual void execute(const RootConstant&) {}
+    virtual void execute(const DrawIndexed&) {}
+    virtual void execute(const CopyRegion&) {}
+};
+
+// Counts what a capture asks for, per frame and in total. What the replay tool prints, and a cheap
+// way to see what a change did to a frame's command stream.
+struct FrameCounts {
+    uint64_t frame = 0;
+    uint32_t draws = 0;
+    uint64_t instances = 0;
+    uint64_t triangles = 0;         // triangle list draws only
+    uint32_t barriers = 0;
+    uint32_t clears = 0;
+    uint32_t copies = 0;
+    uint32_t uploads = 0;
+    uint64_t upload_bytes = 0;
+    uint32_t state_changes = 0;     // everything that sets pipeline or binding state
+    uint32_t resources = 0;         // declared during the frame
+};
+
+class CountingBackend : public Backend {
+public:
+    const std::vector<FrameCounts>& frames() const { return m_frames; }
+    // Everything, including commands outside a begin_frame/end_frame pair.
+    const FrameCounts& totals() const { return m_totals; }
+
+    void execute(const BeginFrame& c) override {
+        m_current = {};
+        m_current.frame = c.frame;
+    }
+
+    void execute(const EndFrame&) override { m_frames.push_back(m_current); }
+
+    void execute(const DeclareResource&) override { count(&FrameCounts::resources); }
+
+    void execute(const Upload& c, std::span<const uint8_t> data) override {
+        count(&FrameCounts::uploads);
+        m_current.upload_bytes += data.size();
+        m_totals.upload_bytes += data.size();
+    }
+
+    void execute(const Barrier&) override { count(&FrameCounts::barriers); }
+    void execute(const ClearColor&) override { count(&FrameCounts::clears); }
+    void execute(const ClearDepth&) override { count(&FrameCounts::clears); }
+    void execute(const CopyRegion&) override { count(&FrameCounts::copies); }
+
+    void execute(const Viewport&) override { count(&FrameCounts::state_changes); }
+    void execute(const Scissor&) override { count(&FrameCounts::state_changes); }
+    void execute(const RenderTargets&) override { count(&FrameCounts::state_changes); }
+    void execute(const Pipeline&) override { count(&FrameCounts::state_changes); }
+    void execute(const RootSignature&) override { count(&FrameCounts::state_changes); }
+    void execute(const VertexBuffer&) override { count(&FrameCounts::state_changes); }
+    void execute(const IndexBuffer&) override { count(&FrameCounts::state_changes); }
+    void execute(const RootTable&) override { count(&FrameCounts::state_changes); }
+    void execute(const RootConstant&) override { count(&FrameCounts::state_changes); }
+
+    void execute(const Topology& c) override {
+        count(&FrameCounts::state_changes);
+        m_topology = c.topology;
+    }
+
+    void execute(const DrawIndexed& c) override {
+        count(&FrameCounts::draws);
+        uint64_t triangles = m_topology == triangle_list ? uint64_t(c.index_count / 3) * c.instance_count : 0;
+        for (FrameCounts* f : { &m_current, &m_totals }) {
+            f->instances += c.instance_count;
+            f->triangles += triangles;
+        }
+    }
+
+private:
+    static constexpr uint32_t triangle_list = 4;    // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+
+    void count(uint32_t FrameCounts::*field) {
+        m_current.*field += 1;
+        m_totals.*field += 1;
+    }
+
+    FrameCounts m_current;
+    FrameCounts m_totals;
+    std::vector<FrameCounts> m_frames;
+    uint32_t m_topology = triangle_list;
+};
+
+struct ReplayStats {
+    uint64_t frames = 0;
+    uint64_t commands = 0;
+    uint64_t skipped = 0;           // ops this reader doesn't know
+    uint64_t bytes = 0;
+    std::vector<double> frame_ms;   // begin_frame to end_frame, per frame
+};
+
+template <class T>
+T payload(const uint8_t* data, size_t size) {
+    T cmd = {};
+    memcpy(&cmd, data, std::min(size, sizeof(T)));
+    return cmd;
+}
+
+// Plays a capture into backend. Throws std::runtime_error if the stream isn't a capture, is from
+// a newer format version, or is cut off in the middle of a record. A stream cut off between
+// records (eg. the app quit while capturing) just ends there.
+ReplayStats replay(std::istream& in, Backend& backend) {
+    char header[sizeof(magic)] = {};
+    uint32_t version = 0;
+    uint32_t reserved = 0;
+    in.read(header, sizeof(header));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&reserved), sizeof(reserved));
+    if (!in || memcmp(header, magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("not a frame capture");
+    }
+    if (version > format_version) {
+        throw std::runtime_error("frame capture version " + std::to_string(version) + " is newer than this player");
+    }
+
+    ReplayStats stats;
+    stats.bytes = sizeof(header) + 8;
+    std::vector<uint8_t> data;
+    auto frame_start = std::chrono::steady_clock::now();
+    for (;;) {
+        uint8_t op = 0;
+        uint32_t size = 0;
+        if (!in.read(reinterpret_cast<char*>(&op), 1)) break;
+        in.read(reinterpret_cast<char*>(&size), sizeof(size));
+        data.resize(size);
+        in.read(reinterpret_cast<char*>(data.data()), size);
+        if (!in) {
+            throw std::runtime_error("frame capture is truncated");
+        }
+        stats.bytes += 5 + size;
+        stats.commands++;
+
+        const uint8_t* p = data.data();
+        switch (Op(op)) {
+        case Op::begin_frame:
+            frame_start = std::chrono::steady_clock::now();
+            backend.execute(payload<BeginFrame>(p, size));
+            break;
+        case Op::end_frame:
+            backend.execute(payload<EndFrame>(p, size));
+            stats.frames++;
+            stats.frame_ms.push_back(
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+            break;
+        case Op::declare_resource: backend.execute(payload<DeclareResource>(p, size)); break;
+        case Op::upload: {
+            auto cmd = payload<Upload>(p, size);
+            if (size < sizeof(Upload) || size - sizeof(Upload) < cmd.size) {
+                throw std::runtime_error("frame capture upload is short");
+            }
+            backend.execute(cmd, std::span<const uint8_t>(p + sizeof(Upload), cmd.size));
+            break;
+        }
+        case Op::barrier:        backend.execute(payload<Barrier>(p, size)); break;
+        case Op::clear_color:    backend.execute(payload<ClearColor>(p, size)); break;
+        case Op::clear_depth:    backend.execute(payload<ClearDepth>(p, size)); break;
+        case Op::viewport:       backend.execute(payload<Viewport>(p, size)); break;
+        case Op::scissor:        backend.execute(payload<Scissor>(p, size)); break;
+        case Op::render_targets: backend.execute(payload<RenderTargets>(p, size)); break;
+        case Op::pipeline:       backend.execute(payload<Pipeline>(p, size)); break;
+        case Op::root_signature: backend.execute(payload<RootSignature>(p, size)); break;
+        case Op::vertex_buffer:  backend.execute(payload<VertexBuffer>(p, size)); break;
+        case Op::index_buffer:   backend.execute(payload<IndexBuffer>(p, size)); break;
+        case Op::topology:       backend.execute(payload<Topology>(p, size)); break;
+        case Op::root_table:     backend.execute(payload<RootTable>(p, size)); break;
+        case Op::root_constant:  backend.execute(payload<RootConstant>(p, size)); break;
+        case Op::draw_indexed:   backend.execute(payload<DrawIndexed>(p, size)); break;
+        case Op::copy_region:    backend.execute(payload<CopyRegion>(p, size)); break;
+        default:
+            stats.skipped++;
+            break;
+        }
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+
+
+
+// Decides when the app starts a frame, in one of three modes:
+//   on_demand:   draw once after something invalidates the window, as soon as the swap chain has room.
+//   continuous:  draw every interval (every refresh by default) whether anything changed or not.
+//   low_latency: like on_demand, but hold the frame back until just before the vblank it can still make,
+//                so it picks up the newest input. How long before is the predicted CPU and GPU time of
+//                the frame plus a margin that grows when a frame misses its vblank and shrinks back when
+//                they don't.
+//
+// The app tells the pacer when a present slot frees up. On D3D that's the swap chain's frame latency
+// waitable object, which fires when a frame flips onto the screen; those flips are also how the pacer
+// learns where the vblanks fall and how long a refresh really is.
+//
+// Knows nothing about D3D or Win32 and reads the time through a Clock, so it can be driven by a made up
+// clock and a SimulatedPresentQueue.
+
+namespace pacing {
+
+using Nanos = std::chrono::nanoseconds;
+using Clock = std::function<Nanos()>;
+
+// "No deadline": wait for a message or a present slot.
+constexpr Nanos forever = Nanos::max();
+
+Clock steady_clock() {
+    return [] {
+        return std::chrono::duration_cast<Nanos>(std::chrono::steady_clock::now().time_since_epoch());
+    };
+}
+
+enum class Mode : uint8_t {
+    on_demand,
+    continuous,
+    low_latency,
+};
+
+const char* mode_name(Mode m) {
+    switch (m) {
+    case Mode::on_demand:   return "on demand";
+    case Mode::continuous:  return "continuous";
+    case Mode::low_latency: return "low latency";
+    default:                return "?";
+    }
+}
+
+struct PacerOptions {
+    Mode mode = Mode::on_demand;
+    Nanos refresh = std::chrono::microseconds(16667);   // a guess until flips are seen
+    Nanos interval{ 0 };        // continuous: time between frames; 0 draws every refresh
+    int max_queued = 1;         // presented but not yet on screen, as in SetMaximumFrameLatency()
+    Nanos margin = std::chrono::microseconds(1000);     // low_latency: where the margin starts
+};
+
+struct PacerStats {
+    uint64_t frames = 0;
+    uint64_t missed = 0;        // low_latency frames shown later than the vblank they aimed for
+    Nanos cpu{};                // predicted, begin_frame() to cpu_done()
+    Nanos gpu{};                // predicted, cpu_done() to gpu_done()
+    Nanos margin{};
+    Nanos refresh{};
+    Nanos latency{};            // running average, begin_frame() to on screen
+};
+
+// Running mean and mean deviation. Predicting mean + 2 deviations covers nearly every frame without
+// chasing a single slow one.
+struct Estimate {
+    double mean = 0;
+    double deviation = 0;
+    bool primed = false;
+
+    void add(double x) {
+        if (!primed) {
+            mean = x;
+            primed = true;
+            return;
+        }
+        double d = x - mean;
+        mean += d / 8;
+        deviation += (std::abs(d) - deviation) / 8;
+    }
+
+    double predict() const { return mean + 2 * deviation; }
+};
+
+class FramePacer {
+public:
+    explicit FramePacer(Clock clock, PacerOptions options = {})
+        : m_clock(std::move(clock)), m_options(options), m_mode(options.mode), m_slots(options.max_queued),
+          m_refresh(double(options.refresh.count())), m_margin(double(options.margin.count())) {
+        assert(m_clock && options.max_queued >= 1 && options.refresh.count() > 0);
+    }
+
+    Nanos now() const { return m_clock(); }
+    Mode mode() const { return m_mode; }
+
+    void set_mode(Mode mode) {
+        m_mode = mode;
+        m_next_start = Nanos::min();
+        m_dirty = true;
+    }
+
+    // The display's nominal refresh, before any flips have been measured.
+    void set_refresh(Nanos refresh) {
+        assert(refresh.count() > 0);
+        m_refresh = double(refresh.count());
+    }
+
+    // Something on screen is out of date. Continuous mode draws anyway.
+    void invalidate() { m_dirty = true; }
+
+    // A present slot freed up at `at`. That's a flip of the oldest frame still queued, if there is one;
+    // the swap chain's waitable object starts out signalled once per slot without any flip behind it.
+    void slot_freed(Nanos at) {
+        m_slots = std::min(m_slots + 1, m_options.max_queued);
+        if (m_queued.empty()) return;
+        Queued frame = m_queued.front();
+        m_queued.pop_front();
+
+        double latency = double((at - frame.begin).count());
+        m_latency = m_stats.latency.count() == 0 ? latency : m_latency + (latency - m_latency) / 16;
+        m_stats.latency = Nanos(int64_t(m_latency));
+        if (frame.aimed) {
+            if (double((at - frame.target).count()) > m_refresh / 2) {
+                m_stats.missed++;
+                m_margin = std::min(m_margin * 1.5 + min_margin, m_refresh / 2);
+            } else {
+                m_margin = std::max(m_margin - m_margin / 32, min_margin);
+            }
+        }
+        learn_refresh(at);
+        if (m_mode == Mode::continuous) {
+            // Start on a vblank, so the frame flips on the one after: every interval, on the grid.
+            m_next_start = at + Nanos(int64_t((interval_refreshes() - 1) * m_refresh));
+        }
+    }
+
+    // When the next frame should start: forever if it waits on something other than time.
+    Nanos start_time() const {
+        if (m_in_frame || m_slots == 0) return forever;
+        switch (m_mode) {
+        case Mode::continuous:
+            return m_next_start;
+        case Mode::low_latency:
+            if (!m_dirty) return forever;
+            return aiming() ? aim(now()).start : Nanos::min();
+        default:
+            return m_dirty ? Nanos::min() : forever;
+        }
+    }
+
+    bool should_begin() const { return start_time() <= now(); }
+
+    // How long the app can sleep before asking again, unless a message or a slot comes in first.
+    Nanos wait_time() const {
+        Nanos start = start_time();
+        if (start == forever) return forever;
+        Nanos t = now();
+        return start <= t ? Nanos(0) : start - t;
+    }
+
+    void begin_frame() {
+        assert(!m_in_frame && m_slots > 0);
+        Nanos t = now();
+        m_previous_begin = m_begin;
+        m_begin = t;
+        m_cpu_end = t;
+        m_in_frame = true;
+        m_dirty = false;
+        m_slots--;
+        m_aimed = m_mode == Mode::low_latency && aiming();
+        m_target = m_aimed ? aim(t).target : Nanos(0);
+        if (m_mode == Mode::continuous) {
+            // Until a flip says better; see slot_freed().
+            m_next_start = t + Nanos(int64_t(interval_refreshes() * m_refresh - m_refresh / 2));
+        }
+    }
+
+    // The frame's commands are recorded and submitted.
+    void cpu_done() {
+        assert(m_in_frame);
+        m_cpu_end = now();
+        m_cpu.add(double((m_cpu_end - m_begin).count()));
+    }
+
+    // The GPU finished the frame and it's been presented.
+    void gpu_done() {
+        assert(m_in_frame);
+        m_gpu.add(double((now() - m_cpu_end).count()));
+        m_in_frame = false;
+        m_stats.frames++;
+        m_queued.push_back({ m_begin, m_target, m_aimed });
+    }
+
+    // Start of the current (or last) frame, and how long since the one before, for animation.
+    Nanos frame_start() const { return m_begin; }
+    Nanos frame_delta() const { return m_previous_begin.count() ? m_begin - m_previous_begin : Nanos(0); }
+
+    PacerStats stats() const {
+        PacerStats stats = m_stats;
+        stats.cpu = Nanos(int64_t(m_cpu.predict()));
+        stats.gpu = Nanos(int64_t(m_gpu.predict()));
+        stats.margin = Nanos(int64_t(m_margin));
+        stats.refresh = Nanos(int64_t(m_refresh));
+        return stats;
+    }
+
+private:
+    static constexpr double min_margin = 250'000;   // ns
+    static constexpr double slack = 50'000;
+
+    struct Queued {
+        Nanos begin;
+        Nanos target;
+        bool aimed;
+    };
+
+    struct Aim {
+        Nanos start;
+        Nanos target;
+    };
+
+    // Frames aimed at vblanks only flip on the ones aimed at, so they can't show a refresh that's
+    // off: on a faster display they land every few real vblanks, and once that gap has been taken
+    // for the refresh they fit it. So while flips don't fit, frames start as soon as they can and
+    // flip at the display's own pace.
+    bool aiming() const { return m_have_vblank && m_misfits == 0; }
+
+    // The first vblank a frame starting now can make, and when to start it to get there just in time.
+    Aim aim(Nanos t) const {
+        double work = m_cpu.predict() + m_gpu.predict() + m_margin;
+        // A little slack, or a wakeup that lands right on the start would push it a whole refresh on.
+        double since = double((t - m_vblank).count()) + work - slack;
+        double refreshes = std::max(1.0, std::ceil(since / m_refresh));
+        Nanos target = m_vblank + Nanos(int64_t(refreshes * m_refresh));
+        return { target - Nanos(int64_t(work)), target };
+    }
+
+    double interval_refreshes() const {
+        return std::max(1.0, std::round(double(m_options.interval.count()) / m_refresh));
+    }
+
+    // Flips land on vblanks, so the gap between two is a whole number of refreshes, give or take the
+    // wakeup. Nudge the refresh towards what they say. Gaps that don't fit mean the refresh is off
+    // altogether (another monitor, a variable rate); after a run of them, take the shortest one.
+    void learn_refresh(Nanos at) {
+        if (m_have_vblank) {
+            double gap = double((at - m_vblank).count());
+            double refreshes = std::round(gap / m_refresh);
+            if (refreshes >= 1 && refreshes <= 4 && std::abs(gap - refreshes * m_refresh) < m_refresh / 8) {
+                m_refresh += (gap / refreshes - m_refresh) / 16;
+                m_misfits = 0;
+            } else if (gap > 0 && gap < 4 * m_refresh) {
+                m_shortest_misfit = m_misfits++ ? std::min(m_shortest_misfit, gap) : gap;
+                if (m_misfits == 8) {
+                    m_refresh = m_shortest_misfit;
+                    m_misfits = 0;
+                }
+            }
+        }
+        m_vblank = at;
+        m_have_vblank = true;
+    }
+
+    Clock m_clock;
+    PacerOptions m_options;
+    Mode m_mode;
+    bool m_dirty = true;
+    int m_slots;
+    bool m_in_frame = false;
+
+    Nanos m_begin{ 0 };
+    Nanos m_previous_begin{ 0 };
+    Nanos m_cpu_end{ 0 };
+    Nanos m_next_start = Nanos::min();
+    bool m_aimed = false;
+    Nanos m_target{ 0 };
+    std::deque<Queued> m_queued;
+
+    bool m_have_vblank = false;
+    Nanos m_vblank{ 0 };
+    double m_refresh;
+    int m_misfits = 0;
+    double m_shortest_misfit = 0;
+    double m_margin;
+    double m_latency = 0;
+    Estimate m_cpu;
+    Estimate m_gpu;
+    PacerStats m_stats;
+};
+
+// A flip model present queue on a perfect vblank clock, for pacing without a swap chain (the software
+// renderer has none) and for trying schedules anywhere. A frame presented at t flips at the first vblank
+// after t, and after the frame before it; the flip frees its slot.
+class SimulatedPresentQueue {
+public:
+    explicit SimulatedPresentQueue(Nanos refresh, Nanos phase = Nanos(0)) : m_refresh(refresh), m_phase(phase) {
+        assert(refresh.count() > 0);
+    }
+
+    Nanos refresh() const { return m_refresh; }
+
+    void present(Nanos at) {
+        Nanos flip = m_phase + ((at - m_phase) / m_refresh + 1) * m_refresh;
+        if (!m_flips.empty()) flip = std::max(flip, m_flips.back() + m_refresh);
+        else if (m_last_flip != forever) flip = std::max(flip, m_last_flip + m_refresh);
+        m_flips.push_back(flip);
+    }
+
+    // The next flip, or forever when nothing is queued.
+    Nanos next_flip() const { return m_flips.empty() ? forever : m_flips.front(); }
+
+    // Hands every flip up to `now` to `flipped`, oldest first. Returns how many.
+    int collect(Nanos now, const std::function<void(Nanos)>& flipped) {
+        int count = 0;
+        while (!m_flips.empty() && m_flips.front() <= now) {
+            m_last_flip = m_flips.front();
+            m_flips.pop_front();
+            flipped(m_last_flip);
+            count++;
+        }
+        return count;
+    }
+
+private:
+    Nanos m_refresh;
+    Nanos m_phase;
+    Nanos m_last_flip = forever;
+    std::deque<Nanos> m_flips;
+};
+
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+
+#include "glyph_rasterizer.h"
+
+// Rasterized glyphs, packed into one 8 bit coverage atlas for the GPU to sample.
+//
+// A glyph is keyed by font, size, glyph id and which quarter pixel the pen was on, so text that
+// lands at different subpixel positions still gets the right coverage. Rasterizing only happens on
+// a miss; after that drawing a glyph is a hash lookup.
+//
+// The atlas is cut into shelves, rows of glyphs of about the same height. When it's full the shelf
+// used longest ago is thrown out as a whole: LRU by shelf rather than by glyph, which is what keeps
+// the packing trivial. Shelves used in the current frame (since begin_frame()) are never evicted,
+// so everything looked up for a frame stays put until it's drawn.
+
+namespace text {
+
+// Subpixel positions per pixel.
+inline constexpr int subpixel_steps = 4;
+
+struct GlyphKey {
+    FontId font = 0;
+    uint16_t glyph = 0;
+    uint32_t size_64 = 0;   // pixel size in 1/64ths, like FreeType's 26.6
+    uint8_t subpixel = 0;   // in 1/subpixel_steps of a pixel
+
+    float size() const { return size_64 / 64.0f; }
+
+    uint64_t packed() const {
+        return uint64_t(font) << 48 | uint64_t(glyph) << 32 | uint64_t(size_64 & 0x3fffffff) << 2 | subpixel;
+    }
+
+    friend bool operator==(const GlyphKey&, const GlyphKey&) = default;
+};
+
+struct AtlasRect {
+    uint16_t x = 0, y = 0, width = 0, height = 0;
+};
+
+// Where a glyph is in the atlas, and where its top left corner goes relative to the pen position.
+// Blank glyphs (space) have an empty rect.
+struct CachedGlyph {
+    AtlasRect rect;
+    int16_t left = 0;
+    int16_t top = 0;
+};
+
+struct GlyphCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evicted_glyphs = 0;
+    uint64_t evicted_shelves = 0;
+    uint64_t too_big = 0;       // didn't fit in the atlas at all, or every shelf was in use
+};
+
+class GlyphCache {
+public:
+    GlyphCache(const GlyphRasterizer& rasterizer, int atlas_width, int atlas_height)
+        : m_rasterizer(rasterizer), m_width(atlas_width), m_height(atlas_height),
+          m_pixels(size_t(atlas_width) * atlas_height)
+    {
+        assert(atlas_width > 0 && atlas_width <= 65535 && atlas_height > 0 && atlas_height <= 65535);
+    }
+
+    const GlyphRasterizer& rasterizer() const { return m_rasterizer; }
+
+    int atlas_width() const { return m_width; }
+    int atlas_height() const { return m_height; }
+    const uint8_t* atlas_pixels() const { return m_pixels.data(); }
+
+    // Rows of the atlas written since the last clear_dirty(), [dirty_top, dirty_bottom), for
+    // uploading. Empty when top >= bottom.
+    int dirty_top() const { return m_dirty_top; }
+    int dirty_bottom() const { return m_dirty_bottom; }
+    void clear_dirty() {
+        m_dirty_top = m_height;
+        m_dirty_bottom = 0;
+    }
+
+    const GlyphCacheStats& stats() const { return m_stats; }
+    void reset_stats() { m_stats = {}; }
+    size_t size() const { return m_glyphs.size(); }
+
+    void begin_frame() { m_frame++; }
+
+    // Null if it can't be cached: bigger than the atlas, or the atlas is full of this frame's glyphs.
+    const CachedGlyph* get(const GlyphKey& key) {
+        auto it = m_glyphs.find(key.packed());
+        if (it != m_glyphs.end()) {
+            m_stats.hits++;
+            touch(it->second.shelf);
+            return &it->second.glyph;
+        }
+        m_stats.misses++;
+        return insert(key, m_rasterizer.rasterize(key.font, key.size(), key.glyph,
+                                                  float(key.subpixel) / subpixel_steps));
+    }
+
+    // Rasterizes whichever of keys aren't cached yet on a pool of threads (0 for every core), then
+    // packs them. For filling the cache ahead of a big block of text.
+    void warm(std::span<const GlyphKey> keys, unsigned threads = 0) {
+        std::vector<GlyphKey> missing;
+        std::unordered_set<uint64_t> seen;
+        for (const auto& key : keys) {
+            uint64_t packed = key.packed();
+            if (!m_glyphs.contains(packed) && seen.insert(packed).second) missing.push_back(key);
+        }
+        if (missing.empty()) return;
+        std::vector<GlyphBitmap> bitmaps(missing.size());
+        std::atomic<size_t> next = 0;
+        auto run = [&] {
+            for (size_t i = next++; i < missing.size(); i = next++) {
+                const auto& key = missing[i];
+                bitmaps[i] = m_rasterizer.rasterize(key.font, key.size(), key.glyph,
+                                                    float(key.subpixel) / subpixel_steps);
+            }
+        };
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<unsigned>(threads, unsigned(missing.size()));
+        {
+            std::vector<std::jthread> pool;
+            for (unsigned t = 1; t < threads; t++) pool.emplace_back(run);
+            run();
+        }
+        for (size_t i = 0; i < missing.size(); i++) {
+            m_stats.misses++;
+            insert(missing[i], bitmaps[i]);
+        }
+    }
+
+private:
+    // Shelf heights are rounded up to this, so glyphs of similar sizes share them.
+    static constexpr int shelf_step = 8;
+    // Glyphs are this far apart, so bilinear sampling doesn't bleed a neighbour in.
+    static constexpr int padding = 1;
+
+    struct Shelf {
+        int y = 0;
+        int height = 0;
+        int x = 0;                      // where the next glyph goes
+        uint64_t last_used = 0;
+        std::vector<uint64_t> keys;
+    };
+
+    struct Entry {
+        CachedGlyph glyph;
+        int shelf = -1;                 // -1 for blank glyphs, which take no space
+    };
+
+    void touch(int shelf) {
+        if (shelf >= 0) m_shelves[shelf].last_used = m_frame;
+    }
+
+    const CachedGlyph* insert(const GlyphKey& key, const GlyphBitmap& bitmap) {
+        Entry entry;
+        entry.glyph.left = int16_t(bitmap.left);
+        entry.glyph.top = int16_t(bitmap.top);
+        if (bitmap.width > 0 && bitmap.height > 0) {
+            int shelf = allocate(bitmap.width + padding, bitmap.height + padding);
+            if (shelf < 0) {
+                m_stats.too_big++;
+                return nullptr;
+            }
+            Shelf& s = m_shelves[shelf];
+            entry.shelf = shelf;
+            entry.glyph.rect = { uint16_t(s.x), uint16_t(s.y), uint16_t(bitmap.width), uint16_t(bitmap.height) };
+            for (int y = 0; y < bitmap.height; y++) {
+                std::memcpy(&m_pixels[size_t(s.y + y) * m_width + s.x], &bitmap.coverage[size_t(y) * bitmap.width],
+                            bitmap.width);
+            }
+            mark_dirty(s.y, s.y + bitmap.height);
+            s.x += bitmap.width + padding;
+            s.keys.push_back(key.packed());
+            s.last_used = m_frame;
+        }
+        return &m_glyphs.insert_or_assign(key.packed(), entry).first->second.glyph;
+    }
+
+    // A shelf with room for width x height: one of about the right height with space left, a new
+    // one under the others, or the least recently used one emptied out.
+    int allocate(int width, int height) {
+        int shelf_height = (height + shelf_step - 1) / shelf_step * shelf_step;
+        if (width > m_width || shelf_height > m_height) return -1;
+        for (size_t i = 0; i < m_shelves.size(); i++) {
+            const Shelf& s = m_shelves[i];
+            if (s.height >= shelf_height && s.height <= shelf_height + shelf_height / 2 && s.x + width <= m_width) {
+                return int(i);
+            }
+        }
+        if (m_next_y + shelf_height <= m_height) {
+            m_shelves.push_back({ m_next_y, shelf_height, 0, 0, {} });
+            m_next_y += shelf_height;
+            return int(m_shelves.size() - 1);
+        }
+        int victim = -1;
+        for (size_t i = 0; i < m_shelves.size(); i++) {
+            const Shelf& s = m_shelves[i];
+            if (s.height < shelf_height || s.last_used == m_frame) continue;
+            if (victim < 0 || s.last_used < m_shelves[victim].last_used) victim = int(i);
+        }
+        if (victim >= 0) evict(victim);
+        return victim;
+    }
+
+    void evict(int shelf) {
+        Shelf& s = m_shelves[shelf];
+        for (uint64_t key : s.keys) {
+            m_glyphs.erase(key);
+        }
+        m_stats.evicted_glyphs += s.keys.size();
+        m_stats.evicted_shelves++;
+        s.keys.clear();
+        s.x = 0;
+        for (int y = s.y; y < s.y + s.height; y++) {
+            std::memset(&m_pixels[size_t(y) * m_width], 0, m_width);
+        }
+        mark_dirty(s.y, s.y + s.height);
+    }
+
+    void mark_dirty(int top, int bottom) {
+        m_dirty_top = std::min(m_dirty_top, top);
+        m_dirty_bottom = std::max(m_dirty_bottom, bottom);
+    }
+
+    const GlyphRasterizer& m_rasterizer;
+    int m_width;
+    int m_height;
+    std::vector<uint8_t> m_pixels;
+    std::vector<Shelf> m_shelves;
+    int m_next_y = 0;
+    uint64_t m_frame = 1;
+    std::unordered_map<uint64_t, Entry> m_glyphs;
+    GlyphCacheStats m_stats;
+    int m_dirty_top = 0;
+    int m_dirty_bottom = 0;
+};
+
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <bit>
+#include "simd.h"
+
+
+
+// The bits of pixel arithmetic the kernel modules share, scalar and SSE4.1/AVX2: IEEE half <-> float
+// conversion, and the rounded a*b/255 for 8 bit channels. The SIMD versions give exactly the same
+// bits as the scalar ones (the half conversions use integer ops instead of F16C, which SSE4.1
+// machines may not have), so kernels built on them can be tested bit for bit against their scalar
+// reference.
+
+namespace pixel {
+
+// a*b/255 rounded to nearest, exact for all 8 bit inputs.
+uint32_t mul255(uint32_t a, uint32_t b) {
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// Exact conversion. Denormals come out right because the shift+multiply does the renormalizing.
+float half_to_float(uint16_t h) {
+    uint32_t expmant = h & 0x7fffu;
+    float scaled = std::bit_cast<float>(expmant << 13) * std::bit_cast<float>((254u - 15u) << 23);
+    uint32_t bits = std::bit_cast<uint32_t>(scaled);
+    if (expmant > 0x7bffu) bits |= 255u << 23;     // inf/nan keep an all-ones exponent
+    bits |= uint32_t(h & 0x8000u) << 16;
+    return std::bit_cast<float>(bits);
+}
+
+constexpr uint32_t f16_max = (127u + 16u) << 23;            // this and above round to inf
+constexpr uint32_t f16_min_normal = (127u - 14u) << 23;
+constexpr uint32_t f16_subnorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+constexpr uint32_t f16_normal_bias = 0xfffu - ((127u - 15u) << 23);
+
+// Round to nearest even. Any NaN becomes 0x7e00, dropping the sign, so NaNs come out the same
+// whichever operand x86 happened to propagate.
+uint16_t float_to_half(float f) {
+    uint32_t bits = std::bit_cast<uint32_t>(f);
+    uint32_t sign = bits & 0x80000000u;
+    uint32_t absf = bits ^ sign;
+    uint32_t result;
+    if (absf > 0x7f800000u) {
+        return 0x7e00u;
+    } else if (absf >= f16_max) {
+        result = 0x7c00u;
+    } else if (absf < f16_min_normal) {
+        float t = std::bit_cast<float>(absf) + std::bit_cast<float>(f16_subnorm_magic);
+        result = std::bit_cast<uint32_t>(t) - f16_subnorm_magic;
+    } else {
+        uint32_t mant_odd = (absf >> 13) & 1;
+        result = (absf + f16_normal_bias + mant_odd) >> 13;
+    }
+    return static_cast<uint16_t>(result | (sign >> 16));
+}
+
+#if SIMD_X86
+
+// mul255() on 16 bit lanes holding 8 bit values.
+SIMD_TARGET_SSE41 inline __m128i mul255_sse(__m128i a, __m128i b) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+SIMD_TARGET_AVX2 inline __m256i mul255_avx2(__m256i a, __m256i b) {
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+SIMD_TARGET_SSE41 inline __m128 half_to_float_sse(__m128i h) {
+    __m128i expmant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+    __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)),
+                               _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+    __m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7bff)), _mm_set1_epi32(255 << 23));
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(infnan, sign)));
+}
+
+// Returns the halves in the low 16 bits of each 32 bit lane.
+SIMD_TARGET_SSE41 inline __m128i float_to_half_sse(__m128 f) {
+    __m128i bits = _mm_castps_si128(f);
+    __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(int(0x80000000u)));
+    __m128i absf = _mm_xor_si128(bits, sign);
+
+    __m128i is_nan = _mm_cmpgt_epi32(absf, _mm_set1_epi32(0x7f800000));
+    __m128i is_regular = _mm_cmpgt_epi32(_mm_set1_epi32(f16_max), absf);
+    __m128i is_sub = _mm_cmpgt_epi32(_mm_set1_epi32(f16_min_normal), absf);
+    __m128i inf_or_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+    __m128i magic = _mm_set1_epi32(f16_subnorm_magic);
+    __m128i sub = _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(absf), _mm_castsi128_ps(magic)));
+    sub = _mm_sub_epi32(sub, magic);
+
+    __m128i mant_odd = _mm_and_si128(_mm_srli_epi32(absf, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_add_epi32(_mm_add_epi32(absf, _mm_set1_epi32(int(f16_normal_bias))), mant_odd);
+    normal = _mm_srli_epi32(normal, 13);
+
+    __m128i finite = _mm_blendv_epi8(normal, sub, is_sub);
+    __m128i r = _mm_blendv_epi8(inf_or_nan, finite, is_regular);
+    return _mm_or_si128(r, _mm_andnot_si128(is_nan, _mm_srli_epi32(sign, 16)));
+}
+
+SIMD_TARGET_AVX2 inline __m256 half_to_float_avx2(__m256i h) {
+    __m256i expmant = _mm256_and_si256(h, _mm256_set1_epi32(0x7fff));
+    __m256 scaled = _mm256_mul_ps(_mm256_castsi256_ps(_mm256_slli_epi32(expmant, 13)),
+                                  _mm256_castsi256_ps(_mm256_set1_epi32((254 - 15) << 23)));
+    __m256i infnan = _mm256_and_si256(_mm256_cmpgt_epi32(expmant, _mm256_set1_epi32(0x7bff)),
+                                      _mm256_set1_epi32(255 << 23));
+    __m256i sign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16);
+    return _mm256_or_ps(scaled, _mm256_castsi256_ps(_mm256_or_si256(infnan, sign)));
+}
+
+SIMD_TARGET_AVX2 inline __m256i float_to_half_avx2(__m256 f) {
+    __m256i bits = _mm256_castps_si256(f);
+    __m256i sign = _mm256_and_si256(bits, _mm256_set1_epi32(int(0x80000000u)));
+    __m256i absf = _mm256_xor_si256(bits, sign);
+
+    __m256i is_nan = _mm256_cmpgt_epi32(absf, _mm256_set1_epi32(0x7f800000));
+    __m256i is_regular = _mm256_cmpgt_epi32(_mm256_set1_epi32(f16_max), absf);
+    __m256i is_sub = _mm256_cmpgt_epi32(_mm256_set1_epi32(f16_min_normal), absf);
+    __m256i inf_or_nan = _mm256_or_si256(_mm256_and_si256(is_nan, _mm256_set1_epi32(0x200)),
+                                         _mm256_set1_epi32(0x7c00));
+
+    __m256i magic = _mm256_set1_epi32(f16_subnorm_magic);
+    __m256i sub = _mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(absf), _mm256_castsi256_ps(magic)));
+    sub = _mm256_sub_epi32(sub, magic);
+
+    __m256i mant_odd = _mm256_and_si256(_mm256_srli_epi32(absf, 13), _mm256_set1_epi32(1));
+    __m256i normal = _mm256_add_epi32(_mm256_add_epi32(absf, _mm256_set1_epi32(int(f16_normal_bias))), mant_odd);
+    normal = _mm256_srli_epi32(normal, 13);
+
+    __m256i finite = _mm256_blendv_epi8(normal, sub, is_sub);
+    __m256i r = _mm256_blendv_epi8(inf_or_nan, finite, is_regular);
+    return _mm256_or_si256(r, _mm256_andnot_si256(is_nan, _mm256_srli_epi32(sign, 16)));
+}
+
+#endif // SIMD_X86
+
+}
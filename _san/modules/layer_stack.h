@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+
+#include "tile_canvas.h"
+#include "blend_kernels.h"
+
+// A stack of tiled layers flattened on the CPU into one cached composite canvas. The renderer only
+// ever samples the composite, so a frame costs one texture fetch no matter how many layers there
+// are. When a layer is drawn on, or its opacity/mode/visibility/order changes, only the tiles where
+// that layer has content are recomposited.
+
+namespace canvas {
+
+class Layer {
+public:
+    Layer(std::string name, int width, int height)
+        : m_name(std::move(name)), pixels(width, height)
+    {
+    }
+
+    const std::string& name() const { return m_name; }
+    pixel::BlendMode mode() const { return m_mode; }
+    uint8_t opacity() const { return m_opacity; }
+    bool visible() const { return m_visible; }
+
+private:
+    friend class LayerStack;
+    std::string m_name;
+    pixel::BlendMode m_mode = pixel::BlendMode::source_over;
+    uint8_t m_opacity = 255;
+    bool m_visible = true;
+
+public:
+    // Draw straight into this. The stack picks up the changed tiles from its dirty list.
+    TileCanvas pixels;
+};
+
+class LayerStack {
+public:
+    LayerStack(int width, int height)
+        : m_composite(width, height), m_dirty_flags(m_composite.tile_count(), 0)
+    {
+    }
+
+    int width() const { return m_composite.width(); }
+    int height() const { return m_composite.height(); }
+    size_t layer_count() const { return m_layers.size(); }
+
+    // Layers are bottom to top. position defaults to the top.
+    Layer& add_layer(std::string name, size_t position = SIZE_MAX) {
+        position = std::min(position, m_layers.size());
+        auto layer = std::make_unique<Layer>(std::move(name), width(), height());
+        Layer& ref = *layer;
+        m_layers.insert(m_layers.begin() + position, std::move(layer));
+        return ref;
+    }
+
+    void remove_layer(size_t index) {
+        assert(index < m_layers.size());
+        Layer& l = *m_layers[index];
+        mark_layer(l);
+        // Tiles changed since the last update() may be null now but still in the composite.
+        for (int i : l.pixels.dirty_tiles()) {
+            mark(i);
+        }
+        m_layers.erase(m_layers.begin() + index);
+    }
+
+    // Reordering only changes the result where the moved layer has content.
+    void move_layer(size_t from, size_t to) {
+        assert(from < m_layers.size() && to < m_layers.size());
+        if (from == to) return;
+        mark_layer(*m_layers[from]);
+        auto layer = std::move(m_layers[from]);
+        m_layers.erase(m_layers.begin() + from);
+        m_layers.insert(m_layers.begin() + to, std::move(layer));
+    }
+
+    Layer& layer(size_t index) { return *m_layers[index]; }
+    const Layer& layer(size_t index) const { return *m_layers[index]; }
+
+    void set_opacity(size_t index, uint8_t opacity) {
+        Layer& l = layer(index);
+        if (l.m_opacity == opacity) return;
+        l.m_opacity = opacity;
+        mark_layer(l);
+    }
+
+    void set_mode(size_t index, pixel::BlendMode mode) {
+        Layer& l = layer(index);
+        if (l.m_mode == mode) return;
+        l.m_mode = mode;
+        mark_layer(l);
+    }
+
+    void set_visible(size_t index, bool visible) {
+        Layer& l = layer(index);
+        if (l.m_visible == visible) return;
+        l.m_visible = visible;
+        mark_layer(l);
+    }
+
+    void invalidate_all() {
+        for (int i = 0; i < m_composite.tile_count(); i++) {
+            mark(i);
+        }
+    }
+
+    // Recomposites whatever changed since the last call. Returns the number of tiles redone.
+    // The composite's own dirty list then says which tiles need uploading.
+    int update() {
+        for (auto& l : m_layers) {
+            for (int index : l->pixels.dirty_tiles()) {
+                mark(index);
+            }
+            l->pixels.clear_dirty();
+        }
+        int count = static_cast<int>(m_dirty.size());
+        for (int index : m_dirty) {
+            recompose_tile(index);
+            m_dirty_flags[index] = 0;
+        }
+        m_dirty.clear();
+        // Nobody records history on the composite.
+        m_composite.clear_touched();
+        return count;
+    }
+
+    TileCanvas& composite() { return m_composite; }
+    const TileCanvas& composite() const { return m_composite; }
+
+private:
+    void mark(int index) {
+        if (!m_dirty_flags[index]) {
+            m_dirty_flags[index] = 1;
+            m_dirty.push_back(index);
+        }
+    }
+
+    void mark_layer(const Layer& l) {
+        for (int i = 0; i < l.pixels.tile_count(); i++) {
+            if (l.pixels.tile(i)) mark(i);
+        }
+    }
+
+    void recompose_tile(int index) {
+        // Gather what actually contributes; a null tile is transparent, which every mode treats
+        // as "leave dst alone".
+        m_contributing.clear();
+        for (auto& l : m_layers) {
+            if (l->m_visible && l->m_opacity > 0 && l->pixels.tile(index)) {
+                m_contributing.push_back(l.get());
+            }
+        }
+
+        if (m_contributing.empty()) {
+            m_composite.set_shared_tile(index, nullptr);
+            return;
+        }
+
+        // Opaque source-over onto nothing is a copy. If it's the only layer here just share its
+        // tile; the layer copies it on its next write.
+        const Layer* first = m_contributing.front();
+        bool first_is_copy = first->m_mode == pixel::BlendMode::source_over && first->m_opacity == 255;
+        if (first_is_copy && m_contributing.size() == 1) {
+            m_composite.set_shared_tile(index, first->pixels.shared_tile(index));
+            return;
+        }
+
+        Tile& out = m_composite.mutable_tile(index);
+        size_t start = 0;
+        if (first_is_copy) {
+            out.pixels = first->pixels.tile(index)->pixels;
+            start = 1;
+        } else {
+            out.pixels.fill(0);
+        }
+        for (size_t i = start; i < m_contributing.size(); i++) {
+            const Layer* l = m_contributing[i];
+            pixel::blend_rgba8(l->m_mode, out.pixels.data(), l->pixels.tile(index)->pixels.data(),
+                               tile_pixels, l->m_opacity);
+        }
+    }
+
+    std::vector<std::unique_ptr<Layer>> m_layers;
+    TileCanvas m_composite;
+    std::vector<uint8_t> m_dirty_flags;
+    std::vector<int> m_dirty;
+    std::vector<const Layer*> m_contributing;
+};
+
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+
+
+// A small LZ77 block codec in the style of LZ4. It trades ratio for speed: there is no entropy
+// coding, just literal runs and back references, so decoding is a handful of memcpy's per sequence.
+//
+// Block format, repeated until the input is used up:
+//   token    1 byte. High nibble = literal count, low nibble = match length - 4.
+//            A nibble of 15 means more length bytes follow (each adds 0-255, stop at < 255).
+//   literals
+//   offset   2 bytes, little endian, distance back to the match (1..65535).
+//   (extra match length bytes)
+// The last sequence has literals only and no offset.
+
+namespace lz {
+
+constexpr int min_match = 4;
+constexpr int hash_bits = 14;
+constexpr uint32_t max_offset = 65535;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+void write_length(std::vector<uint8_t>& out, size_t len) {
+    while (len >= 255) {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(len));
+}
+
+void emit_sequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t lit_len,
+                   uint32_t offset, size_t match_len) {
+    bool has_match = match_len >= min_match;
+    size_t ml = has_match ? match_len - min_match : 0;
+    uint8_t token = static_cast<uint8_t>((lit_len < 15 ? lit_len : 15) << 4);
+    token |= static_cast<uint8_t>(ml < 15 ? ml : 15);
+    out.push_back(token);
+    if (lit_len >= 15) {
+        write_length(out, lit_len - 15);
+    }
+    out.insert(out.end(), literals, literals + lit_len);
+    if (has_match) {
+        out.push_back(static_cast<uint8_t>(offset & 0xff));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (ml >= 15) {
+            write_length(out, ml - 15);
+        }
+    }
+}
+
+// Worst case output size, for callers that want to size a buffer up front.
+size_t compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+std::vector<uint8_t> compress(std::span<const uint8_t> src) {
+    std::vector<uint8_t> out;
+    out.reserve(src.size() / 2 + 16);
+
+    const uint8_t* base = src.data();
+    const uint8_t* ip = base;
+    const uint8_t* end = base + src.size();
+    const uint8_t* anchor = base;
+
+    if (src.size() > min_match) {
+        std::vector<uint32_t> table(size_t(1) << hash_bits, UINT32_MAX);
+        const uint8_t* match_limit = end - min_match;
+
+        while (ip <= match_limit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash4(seq);
+            uint32_t candidate = table[h];
+            uint32_t pos = static_cast<uint32_t>(ip - base);
+            table[h] = pos;
+
+            if (candidate == UINT32_MAX || pos - candidate > max_offset || read32(base + candidate) != seq) {
+                ip++;
+                continue;
+            }
+
+            const uint8_t* ref = base + candidate;
+            // Extend the match backwards into pending literals, then forwards.
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t* mp = ip + min_match;
+            const uint8_t* rp = ref + min_match;
+            while (mp < end && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+
+            emit_sequence(out, anchor, ip - anchor, static_cast<uint32_t>(ip - ref), mp - ip);
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    emit_sequence(out, anchor, end - anchor, 0, 0);
+    return out;
+}
+
+// Decodes into dst, which must be exactly the original size. Returns false on malformed input
+// rather than throwing, since callers treat a bad block the same as a missing one.
+bool decompress(std::span<const uint8_t> src, std::span<uint8_t> dst) {
+    const uint8_t* ip = src.data();
+    const uint8_t* iend = ip + src.size();
+    uint8_t* op = dst.data();
+    uint8_t* oend = op + dst.size();
+
+    auto read_length = [&](size_t& len) {
+        uint8_t b;
+        do {
+            if (ip >= iend) return false;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !read_length(lit_len)) return false;
+        if (size_t(iend - ip) < lit_len || size_t(oend - op) < lit_len) return false;
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(match_len)) return false;
+        match_len += min_match;
+
+        if (offset == 0 || offset > size_t(op - dst.data()) || size_t(oend - op) < match_len) return false;
+        const uint8_t* ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op += match_len;
+        } else {
+            // Overlapping copy, e.g. a run of one repeated pixel.
+            for (size_t i = 0; i < match_len; i++) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op == oend;
+}
+
+}
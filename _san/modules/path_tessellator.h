@@ -0,0 +1,655 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+
+
+// Vector paths to triangles, so shapes can be drawn with our own pipeline (shapes.hlsl) instead
+// of D2D through the 11on12 wrapper.
+//
+// Curves are flattened to within a tolerance first. Then:
+//
+// - fills are cut into horizontal trapezoids by a sweep: the bands are between the y of every
+//   vertex (and of every crossing, so self intersecting paths work), and inside a band the edges
+//   are sorted by x and walked with the winding count, nonzero or even-odd.
+// - strokes are a strip of cross sections along each polyline, with miter, round or bevel joins
+//   and butt, round or square caps.
+//
+// Anti-aliasing is geometry: a one pixel fringe whose outer vertices have zero alpha, outside fill
+// edges and at both sides (and ends) of strokes. Vertex colors are premultiplied, so the pipeline
+// blends with ONE, INV_SRC_ALPHA and the fringe fades out. The fringe sits outside the fill, so
+// antialiased fills come out about half a pixel fatter than the path.
+
+namespace shapes {
+
+struct Vec2 {
+    float x, y;
+};
+
+enum class Verb : uint8_t { move, line, quad, cubic, close };
+
+class Path {
+public:
+    Path& move_to(float x, float y) {
+        m_verbs.push_back(Verb::move);
+        m_points.push_back({ x, y });
+        return *this;
+    }
+
+    Path& line_to(float x, float y) {
+        m_verbs.push_back(Verb::line);
+        m_points.push_back({ x, y });
+        return *this;
+    }
+
+    Path& quad_to(float cx, float cy, float x, float y) {
+        m_verbs.push_back(Verb::quad);
+        m_points.push_back({ cx, cy });
+        m_points.push_back({ x, y });
+        return *this;
+    }
+
+    Path& cubic_to(float c1x, float c1y, float c2x, float c2y, float x, float y) {
+        m_verbs.push_back(Verb::cubic);
+        m_points.push_back({ c1x, c1y });
+        m_points.push_back({ c2x, c2y });
+        m_points.push_back({ x, y });
+        return *this;
+    }
+
+    Path& close() {
+        m_verbs.push_back(Verb::close);
+        return *this;
+    }
+
+    Path& rect(float x, float y, float width, float height) {
+        return move_to(x, y).line_to(x + width, y).line_to(x + width, y + height).line_to(x, y + height).close();
+    }
+
+    // Quarter circle corners as cubics, radius clamped to half the smaller side.
+    Path& rounded_rect(float x, float y, float width, float height, float radius) {
+        float r = std::min({ radius, std::abs(width) / 2, std::abs(height) / 2 });
+        if (r <= 0) return rect(x, y, width, height);
+        float k = r * (1 - arc_kappa);
+        float x1 = x + width, y1 = y + height;
+        move_to(x + r, y);
+        line_to(x1 - r, y);
+        cubic_to(x1 - k, y, x1, y + k, x1, y + r);
+        line_to(x1, y1 - r);
+        cubic_to(x1, y1 - k, x1 - k, y1, x1 - r, y1);
+        line_to(x + r, y1);
+        cubic_to(x + k, y1, x, y1 - k, x, y1 - r);
+        line_to(x, y + r);
+        cubic_to(x, y + k, x + k, y, x + r, y);
+        return close();
+    }
+
+    Path& ellipse(float cx, float cy, float rx, float ry) {
+        float kx = rx * arc_kappa, ky = ry * arc_kappa;
+        move_to(cx + rx, cy);
+        cubic_to(cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry);
+        cubic_to(cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy);
+        cubic_to(cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry);
+        cubic_to(cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy);
+        return close();
+    }
+
+    const std::vector<Verb>& verbs() const { return m_verbs; }
+    const std::vector<Vec2>& points() const { return m_points; }
+
+private:
+    // Control point distance for a cubic quarter circle of radius 1.
+    static constexpr float arc_kappa = 0.5522847f;
+
+    std::vector<Verb> m_verbs;
+    std::vector<Vec2> m_points;
+};
+
+enum class FillRule : uint8_t { nonzero, even_odd };
+enum class LineJoin : uint8_t { miter, round, bevel };
+enum class LineCap : uint8_t { butt, round, square };
+
+struct Stroke {
+    float width = 1;
+    LineJoin join = LineJoin::miter;
+    LineCap cap = LineCap::butt;
+    float miter_limit = 4;      // as in SVG: miter length over stroke width, past which it's a bevel
+};
+
+// Color is premultiplied RGBA8, 0xAABBGGRR like the canvas, ie. DXGI_FORMAT_R8G8B8A8_UNORM.
+struct ShapeVertex {
+    float x, y;
+    uint32_t color;
+};
+
+struct Mesh {
+    std::vector<ShapeVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct TessellateOptions {
+    float pixel_size = 1;       // path units per pixel; the tolerance and fringe are in pixels
+    float tolerance = 0.25f;    // how far the flattened curves may be from the real ones
+    bool antialias = true;
+};
+
+// --- flattening ----------------------------------------------------------------------------------
+
+struct Polyline {
+    std::vector<Vec2> points;
+    bool closed = false;
+};
+
+float length(Vec2 v) {
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+// Adds p unless it's on top of the last point.
+void add_point(Polyline& line, Vec2 p) {
+    if (!line.points.empty()) {
+        Vec2 last = line.points.back();
+        if (std::abs(last.x - p.x) < 1e-6f && std::abs(last.y - p.y) < 1e-6f) return;
+    }
+    line.points.push_back(p);
+}
+
+// The number of segments follows from the curve's second derivative: a chord of a curve
+// with |B''| <= m, over a parameter step of 1/n, is at most m / (8 n^2) from it.
+int curve_segments(float max_second_derivative, float tolerance) {
+    float n = std::ceil(std::sqrt(max_second_derivative / (8 * tolerance)));
+    return std::clamp(int(n), 1, 1000);
+}
+
+std::vector<Polyline> flatten(const Path& path, float tolerance) {
+    std::vector<Polyline> lines;
+    const auto& pts = path.points();
+    size_t at = 0;
+    Vec2 start{}, pen{};
+    auto current = [&]() -> Polyline& {
+        if (lines.empty() || lines.back().closed) {
+            lines.push_back({});
+            add_point(lines.back(), pen);
+        }
+        return lines.back();
+    };
+    for (Verb verb : path.verbs()) {
+        switch (verb) {
+        case Verb::move:
+            pen = start = pts[at++];
+            lines.push_back({});
+            add_point(lines.back(), pen);
+            break;
+        case Verb::line:
+            pen = pts[at++];
+            add_point(current(), pen);
+            break;
+        case Verb::quad: {
+            Vec2 p0 = pen, p1 = pts[at], p2 = pts[at + 1];
+            at += 2;
+            float dd = 2 * length({ p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y });
+            int n = curve_segments(dd, tolerance);
+            Polyline& line = current();
+            for (int i = 1; i <= n; i++) {
+                float t = float(i) / n, mt = 1 - t;
+                add_point(line, { mt * mt * p0.x + 2 * mt * t * p1.x + t * t * p2.x,
+                                  mt * mt * p0.y + 2 * mt * t * p1.y + t * t * p2.y });
+            }
+            pen = p2;
+            break;
+        }
+        case Verb::cubic: {
+            Vec2 p0 = pen, p1 = pts[at], p2 = pts[at + 1], p3 = pts[at + 2];
+            at += 3;
+            float dd = 6 * std::max(length({ p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y }),
+                                    length({ p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y }));
+            int n = curve_segments(dd, tolerance);
+            Polyline& line = current();
+            for (int i = 1; i <= n; i++) {
+                float t = float(i) / n, mt = 1 - t;
+                float a = mt * mt * mt, b = 3 * mt * mt * t, c = 3 * mt * t * t, d = t * t * t;
+                add_point(line, { a * p0.x + b * p1.x + c * p2.x + d * p3.x,
+                                  a * p0.y + b * p1.y + c * p2.y + d * p3.y });
+            }
+            pen = p3;
+            break;
+        }
+        case Verb::close:
+            if (!lines.empty() && !lines.back().closed) {
+                Polyline& line = lines.back();
+                // The closing edge is implied; drop an explicit one back to the start.
+                if (line.points.size() > 1) {
+                    Vec2 last = line.points.back();
+                    if (std::abs(last.x - start.x) < 1e-6f && std::abs(last.y - start.y) < 1e-6f) {
+                        line.points.pop_back();
+                    }
+                }
+                line.closed = true;
+            }
+            pen = start;
+            break;
+        }
+    }
+    std::erase_if(lines, [](const Polyline& l) { return l.points.size() < 2; });
+    return lines;
+}
+
+// --- mesh building -------------------------------------------------------------------------------
+
+uint32_t scale_color(uint32_t color, float coverage) {
+    if (coverage >= 1) return color;
+    uint32_t c = uint32_t(std::clamp(coverage, 0.0f, 1.0f) * 256);
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        out |= (((color >> shift) & 0xff) * c >> 8) << shift;
+    }
+    return out;
+}
+
+uint32_t add_vertex(Mesh& mesh, Vec2 p, uint32_t color) {
+    mesh.vertices.push_back({ p.x, p.y, color });
+    return uint32_t(mesh.vertices.size() - 1);
+}
+
+void add_triangle(Mesh& mesh, uint32_t a, uint32_t b, uint32_t c) {
+    mesh.indices.insert(mesh.indices.end(), { a, b, c });
+}
+
+void add_quad(Mesh& mesh, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+}
+
+// --- fill ----------------------------------------------------------------------------------------
+
+struct Edge {
+    float x0, y0, x1, y1;       // y0 < y1
+    int winding;
+
+    float x_at(float y) const {
+        return x0 + (x1 - x0) * (y - y0) / (y1 - y0);
+    }
+};
+
+struct Crossing {
+    float top, bottom, mid;
+    int winding;
+};
+
+bool inside(int winding, FillRule rule) {
+    return rule == FillRule::nonzero ? winding != 0 : (winding & 1) != 0;
+}
+
+void fill_trapezoids(const std::vector<Polyline>& lines, FillRule rule, uint32_t color, Mesh& mesh) {
+    std::vector<Edge> edges;
+    std::vector<float> ys;
+    for (const auto& line : lines) {
+        size_t n = line.points.size();
+        for (size_t i = 0; i < n; i++) {
+            Vec2 a = line.points[i], b = line.points[(i + 1) % n];
+            ys.push_back(a.y);
+            if (a.y == b.y) continue;
+            if (a.y < b.y) edges.push_back({ a.x, a.y, b.x, b.y, 1 });
+            else edges.push_back({ b.x, b.y, a.x, a.y, -1 });
+        }
+    }
+    if (edges.empty()) return;
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.y0 < b.y0; });
+
+    std::vector<const Edge*> active;
+    std::vector<Crossing> row;
+    size_t next_edge = 0;
+    for (size_t band = 0; band + 1 < ys.size(); band++) {
+        float y_end = ys[band + 1];
+        float y = ys[band];
+        std::erase_if(active, [&](const Edge* e) { return e->y1 <= y; });
+        while (next_edge < edges.size() && edges[next_edge].y0 <= y) {
+            if (edges[next_edge].y1 > y) active.push_back(&edges[next_edge]);
+            next_edge++;
+        }
+        // Split the band wherever two edges cross inside it, so edges never swap order in one.
+        while (y < y_end) {
+            float y_next = y_end;
+            for (;;) {
+                row.clear();
+                for (const Edge* e : active) {
+                    row.push_back({ e->x_at(y), e->x_at(y_next), e->x_at((y + y_next) / 2), e->winding });
+                }
+                std::sort(row.begin(), row.end(), [](const Crossing& a, const Crossing& b) { return a.mid < b.mid; });
+                float split = y_next;
+                for (size_t i = 0; i + 1 < row.size(); i++) {
+                    const Crossing& a = row[i];
+                    const Crossing& b = row[i + 1];
+                    float d_top = b.top - a.top, d_bottom = b.bottom - a.bottom;
+                    if (d_top >= 0 && d_bottom >= 0) continue;
+                    // The gap closes linearly from top to bottom.
+                    float t = d_top / (d_top - d_bottom);
+                    float yc = y + (y_next - y) * t;
+                    if (yc > y + 1e-5f * (1 + std::abs(y)) && yc < split) split = yc;
+                }
+                if (split >= y_next) break;
+                y_next = split;
+            }
+            int winding = 0;
+            for (size_t i = 0; i + 1 < row.size(); i++) {
+                winding += row[i].winding;
+                if (!inside(winding, rule)) continue;
+                const Crossing& l = row[i];
+                const Crossing& r = row[i + 1];
+                uint32_t base = add_vertex(mesh, { l.top, y }, color);
+                add_vertex(mesh, { r.top, y }, color);
+                add_vertex(mesh, { r.bottom, y_next }, color);
+                add_vertex(mesh, { l.bottom, y_next }, color);
+                add_quad(mesh, base, base + 1, base + 2, base + 3);
+            }
+            y = y_next;
+        }
+    }
+}
+
+// Signed area, for which way round a contour goes: the fringe goes on the outside, which is to
+// the right of the direction of travel for one sign and to the left for the other.
+float signed_area(const std::vector<Vec2>& points) {
+    float area = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        Vec2 a = points[i], b = points[(i + 1) % points.size()];
+        area += a.x * b.y - b.x * a.y;
+    }
+    return area / 2;
+}
+
+Vec2 unit_normal(Vec2 a, Vec2 b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float len = std::sqrt(dx * dx + dy * dy);
+    return len > 0 ? Vec2{ dy / len, -dx / len } : Vec2{ 0, 0 };
+}
+
+void fill_fringe(const std::vector<Polyline>& lines, uint32_t color, float width, Mesh& mesh) {
+    for (const auto& line : lines) {
+        const auto& pts = line.points;
+        size_t n = pts.size();
+        if (n < 3) continue;
+        float side = signed_area(pts) >= 0 ? 1.0f : -1.0f;
+        uint32_t base = uint32_t(mesh.vertices.size());
+        for (size_t i = 0; i < n; i++) {
+            Vec2 prev = pts[(i + n - 1) % n], p = pts[i], next = pts[(i + 1) % n];
+            Vec2 n0 = unit_normal(prev, p), n1 = unit_normal(p, next);
+            Vec2 m = { n0.x + n1.x, n0.y + n1.y };
+            float dot = m.x * n1.x + m.y * n1.y;
+            // The miter, limited so spikes stay short.
+            float scale = dot > 0.25f ? 1 / dot : 4;
+            add_vertex(mesh, p, color);
+            add_vertex(mesh, { p.x + side * m.x * scale * width, p.y + side * m.y * scale * width }, 0);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t j = uint32_t((i + 1) % n);
+            add_quad(mesh, base + 2 * i, base + 2 * i + 1, base + 2 * j + 1, base + 2 * j);
+        }
+    }
+}
+
+// --- stroke --------------------------------------------------------------------------------------
+
+class StrokeBuilder {
+public:
+    StrokeBuilder(Mesh& mesh, const Stroke& stroke, uint32_t color, const TessellateOptions& options)
+        : m_mesh(mesh), m_stroke(stroke)
+    {
+        float half = stroke.width / 2;
+        float aa = options.antialias ? options.pixel_size : 0;
+        m_core = std::max(half - aa / 2, 0.0f);
+        m_outer = m_core + aa;
+        m_aa = aa;
+        // Lines thinner than the fringe fade instead of getting thinner.
+        m_color = aa > 0 ? scale_color(color, stroke.width / aa) : color;
+        m_tolerance = options.tolerance * options.pixel_size;
+    }
+
+    void polyline(const Polyline& line) {
+        const auto& pts = line.points;
+        size_t n = pts.size();
+        if (n < 2 || m_stroke.width <= 0) return;
+        // For each point, the sections the segments before and after it end and start at.
+        std::vector<std::pair<uint32_t, uint32_t>> joins(n);
+        size_t segments = line.closed ? n : n - 1;
+        for (size_t i = 0; i < n; i++) {
+            bool end = !line.closed && (i == 0 || i == n - 1);
+            if (end) {
+                Vec2 d = direction(i == 0 ? pts[0] : pts[n - 2], i == 0 ? pts[1] : pts[n - 1]);
+                uint32_t s = cap(pts[i], d, i == 0);
+                joins[i] = { s, s };
+            } else {
+                Vec2 prev = pts[(i + n - 1) % n], next = pts[(i + 1) % n];
+                joins[i] = join(pts[i], direction(prev, pts[i]), direction(pts[i], next),
+                                distance(prev, pts[i]), distance(pts[i], next));
+            }
+        }
+        for (size_t i = 0; i < segments; i++) {
+            connect(joins[i].second, joins[(i + 1) % n].first);
+        }
+    }
+
+private:
+    static Vec2 direction(Vec2 a, Vec2 b) {
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len = std::sqrt(dx * dx + dy * dy);
+        return len > 0 ? Vec2{ dx / len, dy / len } : Vec2{ 1, 0 };
+    }
+
+    static Vec2 left(Vec2 d) { return { -d.y, d.x }; }
+
+    static float distance(Vec2 a, Vec2 b) { return length({ b.x - a.x, b.y - a.y }); }
+
+    int section_size() const { return m_aa > 0 ? 4 : 2; }
+
+    // A cross section through p: fringe, core, core, fringe from the left. The offsets are unit
+    // normals for a plain section, longer for a miter, and differ on the two sides at a join.
+    uint32_t section(Vec2 p, Vec2 left_offset, Vec2 right_offset, uint32_t color) {
+        uint32_t first = uint32_t(m_mesh.vertices.size());
+        if (m_aa > 0) add_vertex(m_mesh, { p.x + left_offset.x * m_outer, p.y + left_offset.y * m_outer }, 0);
+        add_vertex(m_mesh, { p.x + left_offset.x * m_core, p.y + left_offset.y * m_core }, color);
+        add_vertex(m_mesh, { p.x - right_offset.x * m_core, p.y - right_offset.y * m_core }, color);
+        if (m_aa > 0) add_vertex(m_mesh, { p.x - right_offset.x * m_outer, p.y - right_offset.y * m_outer }, 0);
+        return first;
+    }
+
+    uint32_t section(Vec2 p, Vec2 offset, uint32_t color) {
+        return section(p, offset, offset, color);
+    }
+
+    void connect(uint32_t a, uint32_t b) {
+        for (int k = 0; k + 1 < section_size(); k++) {
+            add_quad(m_mesh, a + k, a + k + 1, b + k + 1, b + k);
+        }
+    }
+
+    // A pie slice around c, from direction from turning by sweep radians, with its own fringe. The
+    // triangles all meet at hub, which is c unless the slice has to reach further in.
+    void fan(Vec2 c, Vec2 from, float sweep, std::optional<Vec2> hub = std::nullopt) {
+        float step = 2 * std::acos(std::clamp(1 - m_tolerance / std::max(m_outer, 1e-6f), -1.0f, 1.0f));
+        int steps = std::clamp(int(std::ceil(std::abs(sweep) / std::max(step, 1e-3f))), 1, 256);
+        uint32_t center = add_vertex(m_mesh, hub.value_or(c), m_color);
+        uint32_t first = uint32_t(m_mesh.vertices.size());
+        for (int i = 0; i <= steps; i++) {
+            float a = sweep * i / steps;
+            float cs = std::cos(a), sn = std::sin(a);
+            Vec2 d = { from.x * cs - from.y * sn, from.x * sn + from.y * cs };
+            add_vertex(m_mesh, { c.x + d.x * m_core, c.y + d.y * m_core }, m_color);
+            if (m_aa > 0) add_vertex(m_mesh, { c.x + d.x * m_outer, c.y + d.y * m_outer }, 0);
+        }
+        uint32_t per = m_aa > 0 ? 2 : 1;
+        for (int i = 0; i < steps; i++) {
+            uint32_t a = first + i * per, b = a + per;
+            add_triangle(m_mesh, center, a, b);
+            if (m_aa > 0) add_quad(m_mesh, a, a + 1, b + 1, b);
+        }
+    }
+
+    // d0 and d1 are the directions in and out, length0 and length1 how long those segments are.
+    std::pair<uint32_t, uint32_t> join(Vec2 p, Vec2 d0, Vec2 d1, float length0, float length1) {
+        Vec2 n0 = left(d0), n1 = left(d1);
+        float cross = d0.x * d1.y - d0.y * d1.x;
+        float dot = d0.x * d1.x + d0.y * d1.y;
+        if (std::abs(cross) < 1e-4f && dot > 0) {
+            uint32_t s = section(p, n1, m_color);
+            return { s, s };
+        }
+        Vec2 m = { n0.x + n1.x, n0.y + n1.y };
+        float m_dot = m.x * n0.x + m.y * n0.y;
+        // 1 / cos(half the turn) is the miter length over the stroke width.
+        float len = std::sqrt(m.x * m.x + m.y * m.y);
+        float miter = m_dot > 1e-6f ? len / m_dot : 0;
+        Vec2 offset = miter > 0 ? Vec2{ m.x / len * miter, m.y / len * miter } : n1;
+        if (m_stroke.join == LineJoin::miter && miter > 0 && miter <= m_stroke.miter_limit) {
+            uint32_t s = section(p, offset, m_color);
+            return { s, s };
+        }
+        float outside = cross > 0 ? -1.0f : 1.0f;
+        // Both sections meet at the inner miter point, so the inside of the turn isn't covered
+        // twice; unless the segments are too short for it, when they just overlap.
+        bool inner_miter = miter > 0 && miter * m_outer <= std::min(length0, length1);
+        uint32_t in, out;
+        if (!inner_miter) {
+            in = section(p, n0, m_color);
+            out = section(p, n1, m_color);
+        } else if (outside > 0) {
+            in = section(p, n0, offset, m_color);
+            out = section(p, n1, offset, m_color);
+        } else {
+            in = section(p, offset, n0, m_color);
+            out = section(p, offset, n1, m_color);
+        }
+        // Fill the wedge on the outside of the turn. With the inner miter the sections don't go
+        // through p, so the wedge is fanned from the miter point to close the gap.
+        Vec2 hub = p;
+        if (inner_miter) hub = { p.x - outside * offset.x * m_core, p.y - outside * offset.y * m_core };
+        Vec2 from = { n0.x * outside, n0.y * outside };
+        float sweep = std::atan2(cross, dot);
+        if (m_stroke.join == LineJoin::round) {
+            fan(p, from, sweep, hub);
+        } else {
+            // Bevel: one triangle of core, and a fringe along the bevel edge.
+            Vec2 to = { n1.x * outside, n1.y * outside };
+            uint32_t c = add_vertex(m_mesh, hub, m_color);
+            uint32_t a = add_vertex(m_mesh, { p.x + from.x * m_core, p.y + from.y * m_core }, m_color);
+            uint32_t b = add_vertex(m_mesh, { p.x + to.x * m_core, p.y + to.y * m_core }, m_color);
+            add_triangle(m_mesh, c, a, b);
+            if (m_aa > 0) {
+                uint32_t ao = add_vertex(m_mesh, { p.x + from.x * m_outer, p.y + from.y * m_outer }, 0);
+                uint32_t bo = add_vertex(m_mesh, { p.x + to.x * m_outer, p.y + to.y * m_outer }, 0);
+                add_quad(m_mesh, a, ao, bo, b);
+            }
+        }
+        return { in, out };
+    }
+
+    // The section the line starts or ends with, d pointing along the line.
+    uint32_t cap(Vec2 p, Vec2 d, bool start) {
+        Vec2 n = left(d);
+        Vec2 back = start ? Vec2{ -d.x, -d.y } : d;     // away from the line
+        if (m_stroke.cap == LineCap::round) {
+            uint32_t s = section(p, n, m_color);
+            fan(p, start ? n : Vec2{ -n.x, -n.y }, std::numbers::pi_v<float>);
+            return s;
+        }
+        float extend = m_stroke.cap == LineCap::square ? m_stroke.width / 2 : 0;
+        Vec2 q = { p.x + back.x * extend, p.y + back.y * extend };
+        uint32_t s = section(q, n, m_color);
+        if (m_aa > 0) {
+            uint32_t f = section({ q.x + back.x * m_aa, q.y + back.y * m_aa }, n, 0);
+            connect(f, s);
+        }
+        return s;
+    }
+
+    Mesh& m_mesh;
+    const Stroke& m_stroke;
+    uint32_t m_color;
+    float m_core;       // half width of the solid part
+    float m_outer;      // half width including the fringe
+    float m_aa;
+    float m_tolerance;
+};
+
+// --- entry points --------------------------------------------------------------------------------
+
+void fill_path(const Path& path, uint32_t color, FillRule rule, const TessellateOptions& options, Mesh& mesh) {
+    auto lines = flatten(path, options.tolerance * options.pixel_size);
+    for (auto& line : lines) line.closed = true;
+    fill_trapezoids(lines, rule, color, mesh);
+    if (options.antialias) fill_fringe(lines, color, options.pixel_size, mesh);
+}
+
+void stroke_path(const Path& path, uint32_t color, const Stroke& stroke, const TessellateOptions& options,
+                        Mesh& mesh) {
+    StrokeBuilder builder(mesh, stroke, color, options);
+    for (const auto& line : flatten(path, options.tolerance * options.pixel_size)) {
+        builder.polyline(line);
+    }
+}
+
+// One path to draw: filled if there's no stroke.
+struct ShapeDraw {
+    const Path* path = nullptr;
+    uint32_t color = 0xff000000;
+    FillRule fill_rule = FillRule::nonzero;
+    std::optional<Stroke> stroke;
+};
+
+// Where each draw's triangles ended up in the combined index buffer.
+struct MeshRange {
+    uint32_t start_index = 0;
+    uint32_t index_count = 0;
+};
+
+// Tessellates draws on a pool of threads (0 for every core), a path at a time, then concatenates
+// the results in order into one mesh.
+Mesh tessellate(std::span<const ShapeDraw> draws, const TessellateOptions& options,
+                       std::vector<MeshRange>& ranges, unsigned threads = 0) {
+    std::vector<Mesh> parts(draws.size());
+    std::atomic<size_t> next = 0;
+    auto run = [&] {
+        for (size_t i = next++; i < draws.size(); i = next++) {
+            const ShapeDraw& d = draws[i];
+            if (d.stroke) stroke_path(*d.path, d.color, *d.stroke, options, parts[i]);
+            else fill_path(*d.path, d.color, d.fill_rule, options, parts[i]);
+        }
+    };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1u, std::min<unsigned>(threads, unsigned(draws.size())));
+    {
+        std::vector<std::jthread> pool;
+        for (unsigned t = 1; t < threads; t++) pool.emplace_back(run);
+        run();
+    }
+
+    Mesh mesh;
+    size_t vertex_count = 0, index_count = 0;
+    for (const auto& part : parts) {
+        vertex_count += part.vertices.size();
+        index_count += part.indices.size();
+    }
+    mesh.vertices.reserve(vertex_count);
+    mesh.indices.reserve(index_count);
+    ranges.clear();
+    for (const auto& part : parts) {
+        uint32_t base = uint32_t(mesh.vertices.size());
+        ranges.push_back({ uint32_t(mesh.indices.size()), uint32_t(part.indices.size()) });
+        mesh.vertices.insert(mesh.vertices.end(), part.vertices.begin(), part.vertices.end());
+        for (uint32_t i : part.indices) {
+            mesh.indices.push_back(base + i);
+        }
+    }
+    return mesh;
+}
+
+}
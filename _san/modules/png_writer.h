@@ -0,0 +1,616 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+
+// PNG encoder for exports. Rows are filtered and deflated in independent chunks on several
+// threads, pigz style: each chunk ends on a byte boundary (an empty stored block, like zlib's
+// Z_SYNC_FLUSH), so the chunks can just be concatenated into one zlib stream. The chunk's adler32s
+// are combined at the end. Costs a little ratio at each chunk boundary since matches can't reach
+// back into the previous chunk.
+
+namespace image {
+
+// --- checksums -----------------------------------------------------------------------------------
+
+const std::array<uint32_t, 256>& crc_table() {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    const auto& table = crc_table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+constexpr uint32_t adler_base = 65521;
+
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1) {
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        // 5552 is the most bytes we can sum before b can overflow 32 bits.
+        size_t n = std::min<size_t>(size, 5552);
+        size -= n;
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= adler_base;
+        b %= adler_base;
+    }
+    return (b << 16) | a;
+}
+
+// adler32 of A+B from adler32(A), adler32(B) and the length of B. Same as zlib's adler32_combine.
+uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2) {
+    uint32_t rem = static_cast<uint32_t>(len2 % adler_base);
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = static_cast<uint32_t>((uint64_t(rem) * sum1) % adler_base);
+    sum1 += (adler2 & 0xffff) + adler_base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + adler_base - rem;
+    if (sum1 >= adler_base) sum1 -= adler_base;
+    if (sum1 >= adler_base) sum1 -= adler_base;
+    if (sum2 >= 2 * adler_base) sum2 -= 2 * adler_base;
+    if (sum2 >= adler_base) sum2 -= adler_base;
+    return sum1 | (sum2 << 16);
+}
+
+// --- deflate -------------------------------------------------------------------------------------
+
+constexpr int min_match = 3;
+constexpr int max_match = 258;
+constexpr int window_size = 32768;
+constexpr int hash_bits = 15;
+constexpr int max_chain = 32;
+constexpr size_t block_tokens = 1 << 15;
+
+constexpr int num_lit_codes = 286;
+constexpr int num_dist_codes = 30;
+constexpr int num_len_codes = 19;
+
+constexpr std::array<uint16_t, 29> length_base = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr std::array<uint8_t, 29> length_extra = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr std::array<uint16_t, 30> dist_base = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+    2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr std::array<uint8_t, 30> dist_extra = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// The order code length code lengths are sent in.
+constexpr std::array<uint8_t, 19> len_code_order = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+int length_code(int len) {
+    return static_cast<int>(std::upper_bound(length_base.begin(), length_base.end(), len) - length_base.begin()) - 1;
+}
+
+int dist_code(int dist) {
+    return static_cast<int>(std::upper_bound(dist_base.begin(), dist_base.end(), dist) - dist_base.begin()) - 1;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    // LSB first, as deflate wants everything except Huffman codes, which are pre-reversed.
+    void put(uint32_t value, int count) {
+        m_bits |= uint64_t(value) << m_count;
+        m_count += count;
+        while (m_count >= 8) {
+            m_out.push_back(static_cast<uint8_t>(m_bits));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void align() {
+        if (m_count > 0) put(0, 8 - m_count);
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_bits = 0;
+    int m_count = 0;
+};
+
+// Code lengths for freq, at most max_bits long. Plain Huffman, and if that comes out too deep,
+// flatten the frequencies and try again. Not optimal like package-merge but it rarely triggers.
+void huffman_lengths(const uint32_t* freq, int n, int max_bits, uint8_t* lengths) {
+    std::vector<uint32_t> f(freq, freq + n);
+    std::fill(lengths, lengths + n, 0);
+    int used = 0;
+    int last = 0;
+    for (int i = 0; i < n; i++) {
+        if (f[i]) {
+            used++;
+            last = i;
+        }
+    }
+    if (used == 0) return;
+    if (used == 1) {
+        // A single code of length 1 is the one incomplete code inflate accepts.
+        lengths[last] = 1;
+        return;
+    }
+    struct Node {
+        uint64_t weight;
+        int left, right;
+    };
+    std::vector<Node> nodes;
+    std::vector<uint8_t> depth;
+    for (;;) {
+        nodes.clear();
+        using Entry = std::pair<uint64_t, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+        for (int i = 0; i < n; i++) {
+            if (f[i]) {
+                heap.push({ f[i], static_cast<int>(nodes.size()) });
+                nodes.push_back({ f[i], -1, i });
+            }
+        }
+        while (heap.size() > 1) {
+            auto [wa, a] = heap.top();
+            heap.pop();
+            auto [wb, b] = heap.top();
+            heap.pop();
+            heap.push({ wa + wb, static_cast<int>(nodes.size()) });
+            nodes.push_back({ wa + wb, a, b });
+        }
+        // Parents come after their children, so walk backwards handing depth down.
+        depth.assign(nodes.size(), 0);
+        int deepest = 0;
+        for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; i--) {
+            if (nodes[i].left >= 0) {
+                depth[nodes[i].left] = depth[i] + 1;
+                depth[nodes[i].right] = depth[i] + 1;
+            } else {
+                lengths[nodes[i].right] = depth[i];
+                deepest = std::max<int>(deepest, depth[i]);
+            }
+        }
+        if (deepest <= max_bits) return;
+        for (auto& v : f) {
+            if (v) v = (v >> 1) | 1;
+        }
+    }
+}
+
+// Canonical codes from lengths (RFC 1951 3.2.2), bit reversed for the LSB first writer.
+void canonical_codes(const uint8_t* lengths, int n, uint16_t* codes) {
+    int bl_count[16] = {};
+    for (int i = 0; i < n; i++) bl_count[lengths[i]]++;
+    bl_count[0] = 0;
+    int next_code[16] = {};
+    int code = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        code = (code + bl_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+    for (int i = 0; i < n; i++) {
+        int len = lengths[i];
+        if (!len) {
+            codes[i] = 0;
+            continue;
+        }
+        uint32_t c = next_code[len]++;
+        uint32_t r = 0;
+        for (int b = 0; b < len; b++) {
+            r = (r << 1) | ((c >> b) & 1);
+        }
+        codes[i] = static_cast<uint16_t>(r);
+    }
+}
+
+struct Token {
+    uint16_t value;     // literal byte, or match length
+    uint16_t dist;      // 0 for a literal
+    uint8_t len_code;   // length_code(value) and dist_code(dist) for matches, worked out once
+    uint8_t dist_code;
+};
+
+struct HuffmanTable {
+    std::array<uint8_t, 288> lit_len{};
+    std::array<uint16_t, 288> lit_code{};
+    std::array<uint8_t, 32> dist_len{};
+    std::array<uint16_t, 32> dist_code{};
+
+    void make_codes() {
+        canonical_codes(lit_len.data(), 288, lit_code.data());
+        canonical_codes(dist_len.data(), 32, dist_code.data());
+    }
+};
+
+const HuffmanTable& fixed_table() {
+    static const auto table = [] {
+        HuffmanTable t;
+        std::fill(t.lit_len.begin(), t.lit_len.begin() + 144, 8);
+        std::fill(t.lit_len.begin() + 144, t.lit_len.begin() + 256, 9);
+        std::fill(t.lit_len.begin() + 256, t.lit_len.begin() + 280, 7);
+        std::fill(t.lit_len.begin() + 280, t.lit_len.end(), 8);
+        std::fill(t.dist_len.begin(), t.dist_len.end(), 5);
+        t.make_codes();
+        return t;
+    }();
+    return table;
+}
+
+class Deflater {
+public:
+    explicit Deflater(std::vector<uint8_t>& out) : m_writer(out) {}
+
+    // Compresses data as non-final blocks and finishes on a byte boundary.
+    void compress_chunk(const uint8_t* data, size_t size) {
+        find_matches(data, size);
+        m_writer.put(0, 1);     // not final
+        m_writer.put(0, 2);     // stored, empty
+        m_writer.align();
+        m_writer.put(0x0000, 16);
+        m_writer.put(0xffff, 16);
+    }
+
+    // The last block of the stream, empty.
+    void finish() {
+        const auto& fixed = fixed_table();
+        m_writer.put(1, 1);
+        m_writer.put(1, 2);
+        m_writer.put(fixed.lit_code[256], fixed.lit_len[256]);
+        m_writer.align();
+    }
+
+private:
+    static uint32_t hash(const uint8_t* p) {
+        uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v * 2654435761u) >> (32 - hash_bits);
+    }
+
+    void find_matches(const uint8_t* data, size_t size) {
+        std::vector<int32_t> head(size_t(1) << hash_bits, -1);
+        std::vector<int32_t> prev(size);
+        auto insert = [&](size_t pos) {
+            if (pos + min_match > size) return;
+            uint32_t h = hash(data + pos);
+            prev[pos] = head[h];
+            head[h] = static_cast<int32_t>(pos);
+        };
+
+        m_tokens.clear();
+        size_t pos = 0;
+        while (pos < size) {
+            int best_len = 0;
+            int best_dist = 0;
+            if (pos + min_match <= size) {
+                int limit = static_cast<int>(std::min<size_t>(max_match, size - pos));
+                int32_t cand = head[hash(data + pos)];
+                for (int chain = 0; cand >= 0 && chain < max_chain; chain++, cand = prev[cand]) {
+                    int dist = static_cast<int>(pos - cand);
+                    if (dist > window_size) break;
+                    const uint8_t* a = data + cand;
+                    const uint8_t* b = data + pos;
+                    if (a[best_len] != b[best_len]) continue;
+                    int len = 0;
+                    while (len < limit && a[len] == b[len]) len++;
+                    if (len > best_len) {
+                        best_len = len;
+                        best_dist = dist;
+                        if (len == limit) break;
+                    }
+                }
+            }
+            if (best_len >= min_match) {
+                m_tokens.push_back({ static_cast<uint16_t>(best_len), static_cast<uint16_t>(best_dist),
+                                     static_cast<uint8_t>(length_code(best_len)),
+                                     static_cast<uint8_t>(dist_code(best_dist)) });
+                for (int i = 0; i < best_len; i++) insert(pos + i);
+                pos += best_len;
+            } else {
+                m_tokens.push_back({ data[pos], 0, 0, 0 });
+                insert(pos);
+                pos++;
+            }
+            if (m_tokens.size() >= block_tokens) {
+                write_block();
+            }
+        }
+        if (!m_tokens.empty()) write_block();
+    }
+
+    void write_block() {
+        std::array<uint32_t, 288> lit_freq{};
+        std::array<uint32_t, 32> dist_freq{};
+        for (const Token& t : m_tokens) {
+            if (t.dist == 0) {
+                lit_freq[t.value]++;
+            } else {
+                lit_freq[257 + t.len_code]++;
+                dist_freq[t.dist_code]++;
+            }
+        }
+        lit_freq[256] = 1;
+
+        HuffmanTable dyn;
+        huffman_lengths(lit_freq.data(), num_lit_codes, 15, dyn.lit_len.data());
+        huffman_lengths(dist_freq.data(), num_dist_codes, 15, dyn.dist_len.data());
+        if (std::all_of(dyn.dist_len.begin(), dyn.dist_len.end(), [](uint8_t l) { return l == 0; })) {
+            dyn.dist_len[0] = 1;
+        }
+        dyn.make_codes();
+
+        // The tree description for the dynamic block: lit and dist lengths run length coded.
+        int hlit = num_lit_codes;
+        while (hlit > 257 && dyn.lit_len[hlit - 1] == 0) hlit--;
+        int hdist = num_dist_codes;
+        while (hdist > 1 && dyn.dist_len[hdist - 1] == 0) hdist--;
+        std::vector<uint8_t> all(dyn.lit_len.begin(), dyn.lit_len.begin() + hlit);
+        all.insert(all.end(), dyn.dist_len.begin(), dyn.dist_len.begin() + hdist);
+        std::vector<std::pair<uint8_t, uint8_t>> rle;   // symbol, extra bits value
+        for (size_t i = 0; i < all.size();) {
+            size_t run = 1;
+            while (i + run < all.size() && all[i + run] == all[i]) run++;
+            if (all[i] == 0 && run >= 3) {
+                run = std::min<size_t>(run, 138);
+                if (run >= 11) rle.push_back({ 18, static_cast<uint8_t>(run - 11) });
+                else rle.push_back({ 17, static_cast<uint8_t>(run - 3) });
+                i += run;
+            } else if (all[i] != 0 && run >= 4) {
+                rle.push_back({ all[i], 0 });
+                run = std::min<size_t>(run - 1, 6);
+                rle.push_back({ 16, static_cast<uint8_t>(run - 3) });
+                i += run + 1;
+            } else {
+                rle.push_back({ all[i], 0 });
+                i++;
+            }
+        }
+        std::array<uint32_t, num_len_codes> len_freq{};
+        for (auto [sym, extra] : rle) len_freq[sym]++;
+        std::array<uint8_t, num_len_codes> len_len{};
+        std::array<uint16_t, num_len_codes> len_code{};
+        huffman_lengths(len_freq.data(), num_len_codes, 7, len_len.data());
+        canonical_codes(len_len.data(), num_len_codes, len_code.data());
+        int hclen = num_len_codes;
+        while (hclen > 4 && len_len[len_code_order[hclen - 1]] == 0) hclen--;
+
+        uint64_t header_bits = 5 + 5 + 4 + 3 * hclen;
+        for (auto [sym, extra] : rle) {
+            header_bits += len_len[sym] + (sym == 16 ? 2 : sym == 17 ? 3 : sym == 18 ? 7 : 0);
+        }
+        const HuffmanTable& fixed = fixed_table();
+        bool use_fixed = header_bits + data_bits(dyn) >= data_bits(fixed);
+
+        m_writer.put(0, 1);
+        if (use_fixed) {
+            m_writer.put(1, 2);
+            write_tokens(fixed);
+        } else {
+            m_writer.put(2, 2);
+            m_writer.put(hlit - 257, 5);
+            m_writer.put(hdist - 1, 5);
+            m_writer.put(hclen - 4, 4);
+            for (int i = 0; i < hclen; i++) {
+                m_writer.put(len_len[len_code_order[i]], 3);
+            }
+            for (auto [sym, extra] : rle) {
+                m_writer.put(len_code[sym], len_len[sym]);
+                if (sym == 16) m_writer.put(extra, 2);
+                else if (sym == 17) m_writer.put(extra, 3);
+                else if (sym == 18) m_writer.put(extra, 7);
+            }
+            write_tokens(dyn);
+        }
+        m_tokens.clear();
+    }
+
+    uint64_t data_bits(const HuffmanTable& t) const {
+        uint64_t bits = t.lit_len[256];
+        for (const Token& tok : m_tokens) {
+            if (tok.dist == 0) {
+                bits += t.lit_len[tok.value];
+            } else {
+                int lc = tok.len_code;
+                int dc = tok.dist_code;
+                bits += t.lit_len[257 + lc] + length_extra[lc] + t.dist_len[dc] + dist_extra[dc];
+            }
+        }
+        return bits;
+    }
+
+    void write_tokens(const HuffmanTable& t) {
+        for (const Token& tok : m_tokens) {
+            if (tok.dist == 0) {
+                m_writer.put(t.lit_code[tok.value], t.lit_len[tok.value]);
+            } else {
+                int lc = tok.len_code;
+                m_writer.put(t.lit_code[257 + lc], t.lit_len[257 + lc]);
+                m_writer.put(tok.value - length_base[lc], length_extra[lc]);
+                int dc = tok.dist_code;
+                m_writer.put(t.dist_code[dc], t.dist_len[dc]);
+                m_writer.put(tok.dist - dist_base[dc], dist_extra[dc]);
+            }
+        }
+        m_writer.put(t.lit_code[256], t.lit_len[256]);
+    }
+
+    BitWriter m_writer;
+    std::vector<Token> m_tokens;
+};
+
+// --- PNG -----------------------------------------------------------------------------------------
+
+uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+template <int Type>
+uint64_t apply_filter(const uint8_t* row, const uint8_t* above, size_t bytes, uint8_t* out) {
+    constexpr size_t bpp = 4;
+    uint64_t score = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t a = i >= bpp ? row[i - bpp] : 0;
+        uint8_t b = above[i];
+        uint8_t c = i >= bpp ? above[i - bpp] : 0;
+        uint8_t pred = 0;
+        if constexpr (Type == 1) pred = a;
+        if constexpr (Type == 2) pred = b;
+        if constexpr (Type == 3) pred = static_cast<uint8_t>((a + b) / 2);
+        if constexpr (Type == 4) pred = paeth(a, b, c);
+        uint8_t v = static_cast<uint8_t>(row[i] - pred);
+        out[i] = v;
+        score += v < 128 ? v : 256 - v;
+    }
+    return score;
+}
+
+// Filters one row into out (filter byte first), picking whichever filter gives the smallest sum
+// of absolute values, which is the usual libpng heuristic. above is all zeros for the first row.
+void filter_row(const uint8_t* row, const uint8_t* above, size_t bytes, uint8_t* out, std::vector<uint8_t>& scratch) {
+    using Filter = uint64_t (*)(const uint8_t*, const uint8_t*, size_t, uint8_t*);
+    static constexpr Filter filters[5] = {
+        apply_filter<0>, apply_filter<1>, apply_filter<2>, apply_filter<3>, apply_filter<4> };
+    scratch.resize(bytes);
+    uint64_t best = filters[0](row, above, bytes, out + 1);
+    out[0] = 0;
+    for (uint8_t type = 1; type < 5; type++) {
+        uint64_t score = filters[type](row, above, bytes, scratch.data());
+        if (score < best) {
+            best = score;
+            out[0] = type;
+            memcpy(out + 1, scratch.data(), bytes);
+        }
+    }
+}
+
+void put_be32(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v >> 24));
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void put_chunk(std::vector<uint8_t>& out, const char* type, std::initializer_list<std::pair<const uint8_t*, size_t>> parts) {
+    size_t size = 0;
+    for (auto [p, n] : parts) size += n;
+    put_be32(out, static_cast<uint32_t>(size));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    for (auto [p, n] : parts) out.insert(out.end(), p, p + n);
+    put_be32(out, crc32(out.data() + start, out.size() - start));
+}
+
+struct EncodedChunk {
+    std::vector<uint8_t> deflated;
+    uint32_t adler = 1;
+    size_t raw_size = 0;
+};
+
+// Encodes straight alpha RGBA8 rows as an 8 bit RGBA PNG. threads = 0 uses every core.
+std::vector<uint8_t> encode_png(const uint8_t* rgba, int width, int height, size_t row_pitch, int threads = 0) {
+    assert(width > 0 && height > 0);
+    size_t row_bytes = size_t(width) * 4;
+    // Chunks of about 256KB of filtered data; much smaller and the lost matches at the seams start
+    // to show in the file size.
+    int rows_per_chunk = static_cast<int>(std::max<size_t>(1, (256 * 1024) / (row_bytes + 1)));
+    int chunk_count = (height + rows_per_chunk - 1) / rows_per_chunk;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, chunk_count);
+
+    std::vector<EncodedChunk> chunks(chunk_count);
+    std::atomic<int> next{ 0 };
+    auto work = [&] {
+        std::vector<uint8_t> filtered;
+        std::vector<uint8_t> scratch;
+        const std::vector<uint8_t> zero_row(row_bytes, 0);
+        for (int c = next++; c < chunk_count; c = next++) {
+            int y0 = c * rows_per_chunk;
+            int y1 = std::min(height, y0 + rows_per_chunk);
+            filtered.resize(size_t(y1 - y0) * (row_bytes + 1));
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = rgba + size_t(y) * row_pitch;
+                const uint8_t* above = y > 0 ? row - row_pitch : zero_row.data();
+                filter_row(row, above, row_bytes, filtered.data() + size_t(y - y0) * (row_bytes + 1), scratch);
+            }
+            EncodedChunk& out = chunks[c];
+            Deflater deflater(out.deflated);
+            deflater.compress_chunk(filtered.data(), filtered.size());
+            if (c == chunk_count - 1) deflater.finish();
+            out.adler = adler32(filtered.data(), filtered.size());
+            out.raw_size = filtered.size();
+        }
+    };
+    {
+        std::vector<std::jthread> pool;
+        for (int i = 1; i < threads; i++) pool.emplace_back(work);
+        work();
+    }
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<uint8_t> ihdr;
+    put_be32(ihdr, width);
+    put_be32(ihdr, height);
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 });     // 8 bit, RGBA, deflate, adaptive filters, no interlace
+    put_chunk(png, "IHDR", { { ihdr.data(), ihdr.size() } });
+
+    // One IDAT per chunk. Their contents join up into a single zlib stream.
+    static const uint8_t zlib_header[2] = { 0x78, 0x9c };
+    uint32_t adler = 1;
+    for (int c = 0; c < chunk_count; c++) {
+        auto& d = chunks[c].deflated;
+        if (c == 0) {
+            put_chunk(png, "IDAT", { { zlib_header, 2 }, { d.data(), d.size() } });
+        } else {
+            put_chunk(png, "IDAT", { { d.data(), d.size() } });
+        }
+        adler = adler32_combine(adler, chunks[c].adler, chunks[c].raw_size);
+        d = {};
+    }
+    uint8_t trailer[4] = { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) };
+    put_chunk(png, "IDAT", { { trailer, 4 } });
+    put_chunk(png, "IEND", {});
+    return png;
+}
+
+// Throws std::runtime_error if the file can't be written.
+void write_png(const std::filesystem::path& path, const uint8_t* rgba, int width, int height,
+                      size_t row_pitch, int threads = 0) {
+    auto png = encode_png(rgba, width, height, row_pitch, threads);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    if (!file) {
+        throw std::runtime_error("couldn't write " + path.string());
+    }
+}
+
+}
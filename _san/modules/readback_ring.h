@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+
+
+// Bookkeeping for getting pixels back from the GPU without waiting on it. There's a fixed ring of
+// readback buffers; a copy into one is recorded in the frame's command list, tagged with the fence
+// value the frame signals, and handed back a few frames later once the fence has passed. If every
+// buffer is still in flight the request just has to wait for a later frame, draw() never blocks.
+//
+// Knows nothing about D3D: the slots are plain memory (the mapped readback buffers in the app, or
+// ordinary vectors when testing), and the caller passes in the completed fence value.
+
+namespace gpu {
+
+struct ReadbackRegion {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// A finished readback. Only valid during the collect() callback, the slot is reused after.
+struct ReadbackView {
+    uint64_t tag;
+    ReadbackRegion region;
+    const uint8_t* data;
+    size_t row_pitch;
+};
+
+class ReadbackRing {
+public:
+    explicit ReadbackRing(std::vector<std::span<const uint8_t>> memory) {
+        for (auto m : memory) {
+            Slot s;
+            s.memory = m;
+            m_slots.push_back(s);
+        }
+    }
+
+    size_t slot_count() const { return m_slots.size(); }
+    size_t slot_bytes(int slot) const { return m_slots[slot].memory.size(); }
+    size_t in_flight() const { return m_order.size(); }
+
+    // Claims a free slot for copying region in, rows row_pitch apart. Returns -1 if every slot is
+    // busy or the region doesn't fit in one; try again next frame.
+    int acquire(uint64_t tag, ReadbackRegion region, size_t row_pitch) {
+        size_t bytes = region.height ? (region.height - 1) * row_pitch + region.width * size_t(4) : 0;
+        for (size_t n = 0; n < m_slots.size(); n++) {
+            int index = static_cast<int>((m_next + n) % m_slots.size());
+            Slot& s = m_slots[index];
+            if (s.state != State::free || s.memory.size() < bytes) continue;
+            s.state = State::recording;
+            s.tag = tag;
+            s.region = region;
+            s.row_pitch = row_pitch;
+            m_next = (index + 1) % m_slots.size();
+            return index;
+        }
+        return -1;
+    }
+
+    // The copy into slot is recorded, and done once the GPU reaches fence_value.
+    void submit(int slot, uint64_t fence_value) {
+        Slot& s = m_slots[slot];
+        assert(s.state == State::recording);
+        assert(m_order.empty() || m_slots[m_order.back()].fence <= fence_value);
+        s.state = State::in_flight;
+        s.fence = fence_value;
+        m_order.push_back(slot);
+    }
+
+    // Gives up a slot that was acquired but never submitted, eg. the frame was thrown away.
+    void cancel(int slot) {
+        assert(m_slots[slot].state == State::recording);
+        m_slots[slot].state = State::free;
+    }
+
+    // Calls f(const ReadbackView&) for every readback the GPU has finished, oldest first, and
+    // frees their slots. Returns how many there were.
+    template <class F>
+    int collect(uint64_t completed_fence, F&& f) {
+        int count = 0;
+        while (!m_order.empty() && m_slots[m_order.front()].fence <= completed_fence) {
+            Slot& s = m_slots[m_order.front()];
+            m_order.pop_front();
+            f(ReadbackView{ s.tag, s.region, s.memory.data(), s.row_pitch });
+            s.state = State::free;
+            count++;
+        }
+        return count;
+    }
+
+private:
+    enum class State : uint8_t {
+        free,
+        recording,
+        in_flight,
+    };
+
+    struct Slot {
+        std::span<const uint8_t> memory;
+        State state = State::free;
+        uint64_t fence = 0;
+        uint64_t tag = 0;
+        ReadbackRegion region;
+        size_t row_pitch = 0;
+    };
+
+    std::vector<Slot> m_slots;
+    std::deque<int> m_order;     // in flight, in submit order
+    size_t m_next = 0;
+};
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+
+
+// The small slice of a GPU API the app draws with: buffers, textures, the textured quad pipeline
+// from shaders.hlsl, command lists, fences and present. Resource states and descriptors are the
+// backend's business; a texture is bound by handle and the backend finds its view.
+//
+// software_device implements it on the CPU, for machines with no D3D12 at all (render farm,
+// CI). There's no D3D12 implementation and none is planned: App's D3D12 path records through
+// CommandRecorder, the render graph's barriers, the descriptor ring and the memory budget, all of
+// which work on the raw command list, and hiding that behind this interface would lose them. What
+// this is for is drawing the same frame without D3D12; capture_replay does that with a capture.
+
+namespace render {
+
+enum class Format : uint8_t {
+    unknown,
+    rgba8_unorm,
+    bgra8_unorm,
+    d32_float,
+    r16_uint,
+    r32_uint,
+};
+
+uint32_t format_bytes(Format f) {
+    switch (f) {
+    case Format::rgba8_unorm:
+    case Format::bgra8_unorm:
+    case Format::d32_float:
+    case Format::r32_uint:
+        return 4;
+    case Format::r16_uint:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// Handles are indices into the device's tables, 0 is none.
+struct Buffer {
+    uint32_t index = 0;
+    explicit operator bool() const { return index != 0; }
+};
+
+struct Texture {
+    uint32_t index = 0;
+    explicit operator bool() const { return index != 0; }
+};
+
+struct Pipeline {
+    uint32_t index = 0;
+    explicit operator bool() const { return index != 0; }
+};
+
+struct TextureDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    Format format = Format::rgba8_unorm;
+};
+
+enum class Filter : uint8_t { point, linear };
+enum class AddressMode : uint8_t { wrap, clamp };
+enum class CullMode : uint8_t { none, back };
+
+// shaders.hlsl's pipeline: float2 position and float2 uv per vertex, transformed by the float4x4
+// in the constant buffer (stored transposed, as the HLSL side expects), then the bound texture
+// sampled at uv. The defaults match what App sets up (D3D12 default states, sampler s0).
+struct PipelineDesc {
+    uint32_t position_offset = 0;
+    uint32_t uv_offset = 8;
+    Filter filter = Filter::point;
+    AddressMode address = AddressMode::wrap;
+    CullMode cull = CullMode::back;
+    bool depth_test = true;
+};
+
+struct Viewport {
+    float x = 0, y = 0, width = 0, height = 0, min_depth = 0, max_depth = 1;
+};
+
+struct Rect {
+    int32_t left = 0, top = 0, right = 0, bottom = 0;
+};
+
+// Records commands for Device::submit(). Reusable after reset() once its last submit has finished.
+class CommandList {
+public:
+    virtual ~CommandList() = default;
+    virtual void reset() = 0;
+    virtual void clear(Texture target, const float color[4]) = 0;
+    virtual void clear_depth(Texture target, float depth) = 0;
+    virtual void set_render_target(Texture color, Texture depth) = 0;
+    virtual void set_viewport(const Viewport& viewport) = 0;
+    virtual void set_scissor(const Rect& rect) = 0;
+    virtual void set_pipeline(Pipeline pipeline) = 0;
+    virtual void set_vertex_buffer(Buffer buffer, uint32_t stride, uint32_t offset = 0) = 0;
+    virtual void set_index_buffer(Buffer buffer, Format format, uint32_t offset = 0) = 0;
+    virtual void set_constants(Buffer buffer) = 0;
+    virtual void set_texture(Texture texture) = 0;
+    virtual void draw_indexed(uint32_t index_count, uint32_t start_index = 0, int32_t base_vertex = 0) = 0;
+    // Same size and format.
+    virtual void copy_texture(Texture dst, Texture src) = 0;
+};
+
+class Device {
+public:
+    virtual ~Device() = default;
+
+    virtual Buffer create_buffer(size_t size) = 0;
+    virtual void write_buffer(Buffer buffer, size_t offset, std::span<const uint8_t> data) = 0;
+    virtual void destroy(Buffer buffer) = 0;
+
+    virtual Texture create_texture(const TextureDesc& desc) = 0;
+    virtual TextureDesc describe(Texture texture) const = 0;
+    // Rows of width * format_bytes bytes, row_pitch apart.
+    virtual void write_texture(Texture texture, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                               const void* data, size_t row_pitch) = 0;
+    virtual void read_texture(Texture texture, void* data, size_t row_pitch) = 0;
+    virtual void destroy(Texture texture) = 0;
+
+    virtual Pipeline create_pipeline(const PipelineDesc& desc) = 0;
+
+    virtual std::unique_ptr<CommandList> create_command_list() = 0;
+    // Returns the fence value that's reached once list has run.
+    virtual uint64_t submit(CommandList& list) = 0;
+    virtual uint64_t completed_fence() const = 0;
+    virtual void wait(uint64_t fence_value) = 0;
+
+    virtual void present(Texture texture) = 0;
+};
+
+}
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <format>
+#include <functional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+// A frame as a list of passes that say which resources they read and write. compile() works out
+// the rest:
+//  - passes whose output nobody reads are culled (writing an imported resource or side_effect()
+//    keeps a pass),
+//  - each transient texture lives from the first to the last pass that uses it, and transients
+//    whose lifetimes don't overlap share heap memory, so the heap is as big as the most memory alive
+//    at any one pass rather than the sum of every pass's targets,
+//  - the barriers each pass needs come from the accesses, including aliasing barriers for
+//    transients that share memory with another one.
+// execute() then runs the passes in order, handing the barriers to the caller first.
+//
+// The graph is built again every frame, so compile() has to be cheap. It knows nothing about D3D:
+// sizes come from a PlacementFn and barriers are handed out as Access pairs. transient_heap does
+// the D3D side.
+
+namespace gpu {
+
+enum class Access : uint8_t {
+    none,            // a transient before its first use this frame, contents undefined
+    shader_read,     // pixel shader SRV
+    compute_read,    // compute shader SRV
+    copy_src,
+    copy_dst,
+    render_target,
+    depth_write,
+    depth_read,
+    unordered,       // UAV
+    indirect_argument,
+    present,
+    count
+};
+
+const char* access_name(Access a) {
+    switch (a) {
+    case Access::none:          return "none";
+    case Access::shader_read:   return "shader read";
+    case Access::compute_read:  return "compute read";
+    case Access::copy_src:      return "copy src";
+    case Access::copy_dst:      return "copy dst";
+    case Access::render_target: return "render target";
+    case Access::depth_write:   return "depth write";
+    case Access::depth_read:    return "depth read";
+    case Access::unordered:     return "unordered";
+    case Access::indirect_argument: return "indirect argument";
+    case Access::present:       return "present";
+    default:                    return "?";
+    }
+}
+
+bool is_write(Access a) {
+    return a == Access::copy_dst || a == Access::render_target || a == Access::depth_write || a == Access::unordered;
+}
+
+constexpr uint32_t usage_bit(Access a) {
+    return 1u << uint32_t(a);
+}
+
+// Resource heap tier 1 can't put render target or depth textures in the same heap as other
+// textures, so each kind gets its own heap.
+enum class HeapClass : uint8_t {
+    targets,
+    textures,
+    count
+};
+
+struct TransientDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t format = 0;        // DXGI_FORMAT
+    uint32_t view_format = 0;   // for views and the optimized clear value when format is typeless, 0 for format
+    uint32_t samples = 1;
+    uint32_t quality = 0;
+
+    bool operator==(const TransientDesc&) const = default;
+};
+
+struct ResourceHandle {
+    uint32_t index = ~0u;
+    explicit operator bool() const { return index != ~0u; }
+};
+
+struct Placement {
+    uint64_t size = 0;
+    uint64_t alignment = 0;
+};
+
+// Size and alignment of a transient, given every Access the frame uses it with (usage_bit()s).
+using PlacementFn = std::function<Placement(const TransientDesc& desc, uint32_t usage)>;
+
+struct Barrier {
+    enum class Kind : uint8_t { transition, aliasing };
+
+    Kind kind = Kind::transition;
+    ResourceHandle resource;
+    // A transient's first transition each frame has before == none: it's in whatever state the
+    // previous frame (or another graph) left it. The backend keeps track of that.
+    Access before = Access::none;
+    Access after = Access::none;
+};
+
+using BarrierFn = std::function<void(std::span<const Barrier> barriers)>;
+
+struct GraphStats {
+    uint32_t passes = 0;
+    uint32_t culled = 0;
+    uint32_t transients = 0;
+    uint32_t aliased = 0;           // transients sharing memory with another one
+    uint32_t barriers = 0;
+    std::array<uint64_t, size_t(HeapClass::count)> heap_bytes = {};
+    uint64_t unaliased_bytes = 0;   // what the transients would take each in their own memory
+};
+
+class RenderGraph {
+public:
+    class PassBuilder {
+    public:
+        // One access per resource per pass. Reading and writing the same resource in a pass is
+        // declared as the write.
+        PassBuilder& read(ResourceHandle resource, Access access) {
+            assert(!is_write(access) && access != Access::none);
+            m_graph.use(m_pass, resource, access);
+            return *this;
+        }
+
+        PassBuilder& write(ResourceHandle resource, Access access) {
+            assert(is_write(access));
+            m_graph.use(m_pass, resource, access);
+            return *this;
+        }
+
+        // Never culled, for passes whose result leaves the graph some other way (readbacks).
+        PassBuilder& side_effect() {
+            m_graph.m_passes[m_pass].side_effect = true;
+            return *this;
+        }
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+        RenderGraph& m_graph;
+        uint32_t m_pass;
+    };
+
+    // A resource that outlives the frame (back buffer, textures). It's in state initial when the
+    // graph starts and is left in state final.
+    ResourceHandle import_resource(std::string name, void* resource, Access initial, Access final) {
+        Resource r;
+        r.name = std::move(name);
+        r.external = resource;
+        r.initial = initial;
+        r.final = final;
+        return add(std::move(r));
+    }
+
+    // A texture only this frame's passes use. The first pass to use it has to write all of it (or
+    // clear it) since its memory may have held another transient.
+    ResourceHandle create_texture(std::string name, const TransientDesc& desc) {
+        Resource r;
+        r.name = std::move(name);
+        r.transient = true;
+        r.desc = desc;
+        return add(std::move(r));
+    }
+
+    PassBuilder add_pass(std::string name, std::function<void()> run) {
+        assert(!m_compiled);
+        Pass pass;
+        pass.name = std::move(name);
+        pass.run = std::move(run);
+        m_passes.push_back(std::move(pass));
+        return PassBuilder(*this, uint32_t(m_passes.size() - 1));
+    }
+
+    void compile(const PlacementFn& place) {
+        assert(!m_compiled);
+        m_stats = {};
+        cull();
+        find_lifetimes();
+        place_transients(place);
+        build_barriers();
+        m_compiled = true;
+    }
+
+    void execute(const BarrierFn& barriers) {
+        assert(m_compiled);
+        for (auto& pass : m_passes) {
+            if (!pass.live) continue;
+            if (!pass.barriers.empty()) barriers(pass.barriers);
+            if (pass.run) pass.run();
+        }
+        if (!m_final_barriers.empty()) barriers(m_final_barriers);
+    }
+
+    // What compile() decided, for the backend and for tests.
+    uint32_t resource_count() const { return uint32_t(m_resources.size()); }
+    bool transient(ResourceHandle h) const { return get(h).transient; }
+    // Whether a live pass uses it. Unused transients aren't placed.
+    bool used(ResourceHandle h) const { return get(h).first >= 0; }
+    void* external(ResourceHandle h) const { return get(h).external; }
+    const std::string& name(ResourceHandle h) const { return get(h).name; }
+    const TransientDesc& desc(ResourceHandle h) const { return get(h).desc; }
+    uint32_t usage(ResourceHandle h) const { return get(h).usage; }
+    Access first_access(ResourceHandle h) const { return get(h).first_access; }
+    HeapClass heap_class(ResourceHandle h) const { return get(h).heap_class; }
+    uint64_t offset(ResourceHandle h) const { return get(h).offset; }
+    uint64_t size(ResourceHandle h) const { return get(h).size; }
+    bool aliased(ResourceHandle h) const { return get(h).aliased; }
+    bool culled(uint32_t pass) const { return !m_passes[pass].live; }
+    uint64_t heap_size(HeapClass c) const { return m_stats.heap_bytes[size_t(c)]; }
+    uint64_t heap_alignment(HeapClass c) const { return m_heap_alignment[size_t(c)]; }
+    const GraphStats& stats() const { return m_stats; }
+
+    std::string report() const {
+        std::string out = std::format("render graph: {} passes ({} culled), {} transients ({} aliased), {} barriers\n",
+                                      m_stats.passes, m_stats.culled, m_stats.transients, m_stats.aliased,
+                                      m_stats.barriers);
+        for (const auto& pass : m_passes) {
+            out += std::format("  {}{}\n", pass.name, pass.live ? "" : " (culled)");
+            for (const auto& b : pass.barriers) {
+                append_barrier(out, b);
+            }
+        }
+        for (const auto& b : m_final_barriers) {
+            append_barrier(out, b);
+        }
+        for (size_t c = 0; c < size_t(HeapClass::count); c++) {
+            if (m_stats.heap_bytes[c] == 0) continue;
+            out += std::format("  {} heap: {} KB\n", c == size_t(HeapClass::targets) ? "targets" : "textures",
+                               m_stats.heap_bytes[c] / 1024);
+        }
+        for (const auto& r : m_resources) {
+            if (!r.transient || r.first < 0) continue;
+            out += std::format("    {:<24} passes {}-{}  offset {} KB  size {} KB\n", r.name, r.first, r.last,
+                               r.offset / 1024, r.size / 1024);
+        }
+        out += std::format("  transients {} KB, {} KB without aliasing\n",
+                           (m_stats.heap_bytes[0] + m_stats.heap_bytes[1]) / 1024, m_stats.unaliased_bytes / 1024);
+        return out;
+    }
+
+private:
+    struct Resource {
+        std::string name;
+        bool transient = false;
+        void* external = nullptr;
+        Access initial = Access::none;
+        Access final = Access::none;
+        TransientDesc desc;
+        // Filled in by compile(). first and last are positions among the live passes.
+        uint32_t usage = 0;
+        Access first_access = Access::none;
+        int first = -1;
+        int last = -1;
+        HeapClass heap_class = HeapClass::textures;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t alignment = 1;
+        bool aliased = false;
+    };
+
+    struct Use {
+        uint32_t resource;
+        Access access;
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void()> run;
+        std::vector<Use> uses;
+        bool side_effect = false;
+        bool live = false;
+        std::vector<Barrier> barriers;
+    };
+
+    ResourceHandle add(Resource r) {
+        assert(!m_compiled);
+        m_resources.push_back(std::move(r));
+        return { uint32_t(m_resources.size() - 1) };
+    }
+
+    const Resource& get(ResourceHandle h) const {
+        assert(h.index < m_resources.size());
+        return m_resources[h.index];
+    }
+
+    void use(uint32_t pass, ResourceHandle resource, Access access) {
+        assert(resource.index < m_resources.size());
+        for (auto& u : m_passes[pass].uses) {
+            if (u.resource == resource.index) {
+                assert(u.access == access || is_write(access) != is_write(u.access));
+                if (is_write(access)) u.access = access;
+                return;
+            }
+        }
+        m_passes[pass].uses.push_back({ resource.index, access });
+    }
+
+    // Walks back from the passes that have to run, keeping whatever writes what they read.
+    void cull() {
+        std::vector<bool> needed(m_resources.size(), false);
+        for (size_t i = m_passes.size(); i-- > 0;) {
+            auto& pass = m_passes[i];
+            pass.live = pass.side_effect;
+            for (const auto& u : pass.uses) {
+                if (is_write(u.access) && (needed[u.resource] || !m_resources[u.resource].transient)) {
+                    pass.live = true;
+                }
+            }
+            if (!pass.live) continue;
+            for (const auto& u : pass.uses) {
+                if (!is_write(u.access)) needed[u.resource] = true;
+            }
+        }
+    }
+
+    void find_lifetimes() {
+        for (auto& r : m_resources) {
+            r.usage = 0;
+            r.first = r.last = -1;
+            r.aliased = false;
+        }
+        int position = 0;
+        for (const auto& pass : m_passes) {
+            if (!pass.live) {
+                m_stats.culled++;
+                continue;
+            }
+            for (const auto& u : pass.uses) {
+                auto& r = m_resources[u.resource];
+                if (r.first < 0) {
+                    r.first = position;
+                    r.first_access = u.access;
+                }
+                r.last = position;
+                r.usage |= usage_bit(u.access);
+            }
+            position++;
+        }
+        m_stats.passes = uint32_t(position);
+    }
+
+    static uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Biggest first, each at the lowest offset that doesn't overlap the memory of a transient
+    // that's alive at the same time. Greedy, but close to the peak for frame-sized targets.
+    void place_transients(const PlacementFn& place) {
+        constexpr uint32_t target_usage = usage_bit(Access::render_target) | usage_bit(Access::depth_write) |
+                                          usage_bit(Access::depth_read);
+        std::vector<uint32_t> order;
+        for (uint32_t i = 0; i < m_resources.size(); i++) {
+            auto& r = m_resources[i];
+            if (!r.transient || r.first < 0) continue;
+            r.heap_class = (r.usage & target_usage) ? HeapClass::targets : HeapClass::textures;
+            Placement p = place(r.desc, r.usage);
+            r.size = p.size;
+            r.alignment = std::max<uint64_t>(p.alignment, 1);
+            m_stats.unaliased_bytes += p.size;
+            order.push_back(i);
+        }
+        m_stats.transients = uint32_t(order.size());
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            const auto& ra = m_resources[a];
+            const auto& rb = m_resources[b];
+            return ra.size != rb.size ? ra.size > rb.size : ra.first < rb.first;
+        });
+
+        m_heap_alignment = {};
+        std::vector<std::pair<uint64_t, uint64_t>> taken;
+        for (size_t n = 0; n < order.size(); n++) {
+            auto& r = m_resources[order[n]];
+            taken.clear();
+            for (size_t m = 0; m < n; m++) {
+                const auto& other = m_resources[order[m]];
+                if (other.heap_class == r.heap_class && other.first <= r.last && r.first <= other.last) {
+                    taken.push_back({ other.offset, other.offset + other.size });
+                }
+            }
+            std::sort(taken.begin(), taken.end());
+            uint64_t offset = 0;
+            for (const auto& [begin, end] : taken) {
+                if (align_up(offset, r.alignment) + r.size <= begin) break;
+                offset = std::max(offset, end);
+            }
+            r.offset = align_up(offset, r.alignment);
+
+            auto c = size_t(r.heap_class);
+            m_stats.heap_bytes[c] = std::max(m_stats.heap_bytes[c], r.offset + r.size);
+            m_heap_alignment[c] = std::max(m_heap_alignment[c], r.alignment);
+        }
+
+        for (size_t n = 0; n < order.size(); n++) {
+            auto& r = m_resources[order[n]];
+            for (size_t m = 0; m < order.size() && !r.aliased; m++) {
+                const auto& other = m_resources[order[m]];
+                r.aliased = m != n && other.heap_class == r.heap_class && other.offset < r.offset + r.size &&
+                            r.offset < other.offset + other.size;
+            }
+            m_stats.aliased += r.aliased;
+        }
+    }
+
+    void build_barriers() {
+        std::vector<Access> state(m_resources.size());
+        for (size_t i = 0; i < m_resources.size(); i++) {
+            state[i] = m_resources[i].transient ? Access::none : m_resources[i].initial;
+        }
+        for (auto& pass : m_passes) {
+            pass.barriers.clear();
+            if (!pass.live) continue;
+            for (const auto& u : pass.uses) {
+                const auto& r = m_resources[u.resource];
+                ResourceHandle h = { u.resource };
+                if (r.transient && state[u.resource] == Access::none) {
+                    if (r.aliased) {
+                        pass.barriers.push_back({ Barrier::Kind::aliasing, h });
+                    }
+                    pass.barriers.push_back({ Barrier::Kind::transition, h, Access::none, u.access });
+                } else if (state[u.resource] != u.access) {
+                    pass.barriers.push_back({ Barrier::Kind::transition, h, state[u.resource], u.access });
+                }
+                state[u.resource] = u.access;
+            }
+            m_stats.barriers += uint32_t(pass.barriers.size());
+        }
+        m_final_barriers.clear();
+        for (uint32_t i = 0; i < m_resources.size(); i++) {
+            const auto& r = m_resources[i];
+            if (!r.transient && state[i] != r.final) {
+                m_final_barriers.push_back({ Barrier::Kind::transition, { i }, state[i], r.final });
+            }
+        }
+        m_stats.barriers += uint32_t(m_final_barriers.size());
+    }
+
+    void append_barrier(std::string& out, const Barrier& b) const {
+        const auto& name = m_resources[b.resource.index].name;
+        if (b.kind == Barrier::Kind::aliasing) {
+            out += std::format("    alias {}\n", name);
+        } else {
+            out += std::format("    {}: {} -> {}\n", name, access_name(b.before), access_name(b.after));
+        }
+    }
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<Barrier> m_final_barriers;
+    std::array<uint64_t, size_t(HeapClass::count)> m_heap_alignment = {};
+    GraphStats m_stats;
+    bool m_compiled = false;
+};
+
+}
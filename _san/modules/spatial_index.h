@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <utility>
+#include <vector>
+
+
+
+// A dynamic bounding volume tree over 2D boxes, for "what's under this point", "what touches this
+// rectangle" and "what's in view" without scanning every stroke and sprite.
+//
+// Leaves store the item's box grown by a margin. Moving an item only touches the tree when its new
+// box leaves the grown one, so strokes being edited or sprites jittering in place cost nothing.
+// Inserts pick a sibling by the surface area heuristic and rotations keep the tree balanced, so
+// nothing degrades into a list whatever order things arrive in. rebuild() builds the whole tree
+// again top down, which gives tighter boxes after lots of churn, or for a bulk load.
+//
+// cull() tests a node against several views in one walk (the main view, a minimap, a capture
+// region...) so the shared part of the tree is visited once.
+
+namespace spatial {
+
+struct Bounds {
+    float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+
+    bool contains(float x, float y) const { return x >= min_x && x <= max_x && y >= min_y && y <= max_y; }
+    bool contains(const Bounds& b) const {
+        return b.min_x >= min_x && b.max_x <= max_x && b.min_y >= min_y && b.max_y <= max_y;
+    }
+    bool overlaps(const Bounds& b) const {
+        return b.min_x <= max_x && min_x <= b.max_x && b.min_y <= max_y && min_y <= b.max_y;
+    }
+    // Half the perimeter, which ranks boxes the same way surface area does in 3D.
+    float cost() const { return (max_x - min_x) + (max_y - min_y); }
+    Bounds grown(float by) const { return { min_x - by, min_y - by, max_x + by, max_y + by }; }
+};
+
+Bounds merge(const Bounds& a, const Bounds& b) {
+    return { std::min(a.min_x, b.min_x), std::min(a.min_y, b.min_y),
+             std::max(a.max_x, b.max_x), std::max(a.max_y, b.max_y) };
+}
+
+using ProxyId = int32_t;
+inline constexpr ProxyId null_proxy = -1;
+
+// One walk tests up to this many views.
+inline constexpr size_t max_views = 32;
+
+class SpatialIndex {
+public:
+    // margin is how far an item can move before update() has to touch the tree.
+    explicit SpatialIndex(float margin = 0.0f) : m_margin(margin) {}
+
+    size_t size() const { return m_count; }
+    int height() const { return m_root == null_proxy ? 0 : m_nodes[m_root].height; }
+
+    // user is handed back by queries; it's usually an index into the caller's own array.
+    ProxyId insert(const Bounds& bounds, uint32_t user) {
+        ProxyId id = allocate();
+        Node& n = m_nodes[id];
+        n.tight = bounds;
+        n.box = bounds.grown(m_margin);
+        n.user = user;
+        n.height = 0;
+        insert_leaf(id);
+        m_count++;
+        return id;
+    }
+
+    void remove(ProxyId id) {
+        assert(is_leaf(id));
+        remove_leaf(id);
+        release(id);
+        m_count--;
+    }
+
+    // Returns whether the tree had to change.
+    bool update(ProxyId id, const Bounds& bounds) {
+        assert(is_leaf(id));
+        Node& n = m_nodes[id];
+        n.tight = bounds;
+        if (n.box.contains(bounds)) {
+            return false;
+        }
+        remove_leaf(id);
+        m_nodes[id].box = bounds.grown(m_margin);
+        insert_leaf(id);
+        return true;
+    }
+
+    uint32_t user(ProxyId id) const { return m_nodes[id].user; }
+    const Bounds& bounds(ProxyId id) const { return m_nodes[id].tight; }
+
+    // visit(ProxyId) for every item whose box overlaps area. Returning false from visit stops the
+    // query.
+    template <class Visit>
+    void query(const Bounds& area, Visit&& visit) const {
+        if (m_root == null_proxy) return;
+        ProxyId stack[stack_size];
+        int top = 0;
+        stack[top++] = m_root;
+        while (top > 0) {
+            const Node& n = m_nodes[stack[--top]];
+            if (!n.box.overlaps(area)) continue;
+            if (n.leaf()) {
+                if (n.tight.overlaps(area) && !visit(ProxyId(&n - m_nodes.data()))) return;
+            } else {
+                assert(top + 2 <= stack_size);
+                stack[top++] = n.child1;
+                stack[top++] = n.child2;
+            }
+        }
+    }
+
+    // Appends the users of everything overlapping area.
+    void query(const Bounds& area, std::vector<uint32_t>& users) const {
+        query(area, [&](ProxyId id) {
+            users.push_back(m_nodes[id].user);
+            return true;
+        });
+    }
+
+    void query_point(float x, float y, std::vector<uint32_t>& users) const {
+        query(Bounds{ x, y, x, y }, users);
+    }
+
+    // Appends to visible[i] the users of everything overlapping views[i], in one walk of the tree.
+    void cull(std::span<const Bounds> views, std::span<std::vector<uint32_t>> visible) const {
+        assert(views.size() <= max_views && visible.size() >= views.size());
+        if (m_root == null_proxy || views.empty()) return;
+        struct Entry { ProxyId node; uint32_t views; };
+        Entry stack[stack_size];
+        int top = 0;
+        stack[top++] = { m_root, uint32_t((uint64_t(1) << views.size()) - 1) };
+        while (top > 0) {
+            Entry e = stack[--top];
+            const Node& n = m_nodes[e.node];
+            const Bounds& box = n.leaf() ? n.tight : n.box;
+            uint32_t inside = 0;
+            for (uint32_t bits = e.views; bits; bits &= bits - 1) {
+                int v = std::countr_zero(bits);
+                if (box.overlaps(views[v])) inside |= 1u << v;
+            }
+            if (!inside) continue;
+            if (n.leaf()) {
+                for (uint32_t bits = inside; bits; bits &= bits - 1) {
+                    visible[std::countr_zero(bits)].push_back(n.user);
+                }
+            } else {
+                assert(top + 2 <= stack_size);
+                stack[top++] = { n.child1, inside };
+                stack[top++] = { n.child2, inside };
+            }
+        }
+    }
+
+    // Builds the tree again from its leaves, top down, splitting the longer axis of the leaf
+    // centers at the median. Proxy ids stay valid.
+    void rebuild() {
+        if (m_count < 3) return;
+        std::vector<ProxyId> leaves;
+        leaves.reserve(m_count);
+        for (ProxyId i = 0; i < ProxyId(m_nodes.size()); i++) {
+            Node& n = m_nodes[i];
+            if (n.height < 0) continue;
+            if (n.leaf()) {
+                leaves.push_back(i);
+            } else {
+                release(i);
+            }
+        }
+        m_root = build(leaves);
+        m_nodes[m_root].parent = null_proxy;
+    }
+
+    // Sum of internal node costs over the root's; lower means queries visit fewer nodes.
+    float quality() const {
+        if (m_root == null_proxy) return 0;
+        float total = 0;
+        for (const auto& n : m_nodes) {
+            if (n.height > 0) total += n.box.cost();
+        }
+        return total / std::max(m_nodes[m_root].box.cost(), 1e-20f);
+    }
+
+private:
+    // Deep enough for any tree the balancing allows (height is about 1.44 log2 of the leaf count).
+    static constexpr int stack_size = 256;
+
+    struct Node {
+        Bounds box;     // grown by the margin for leaves, the union of the children otherwise
+        Bounds tight;   // leaves only
+        ProxyId parent = null_proxy;   // next free node when on the free list
+        ProxyId child1 = null_proxy;
+        ProxyId child2 = null_proxy;
+        int32_t height = -1;           // 0 for leaves, -1 when free
+        uint32_t user = 0;
+
+        bool leaf() const { return child1 == null_proxy; }
+    };
+
+    bool is_leaf(ProxyId id) const {
+        return id >= 0 && id < ProxyId(m_nodes.size()) && m_nodes[id].height == 0;
+    }
+
+    ProxyId allocate() {
+        if (m_free == null_proxy) {
+            m_nodes.push_back({});
+            m_nodes.back().height = 0;
+            return ProxyId(m_nodes.size() - 1);
+        }
+        ProxyId id = m_free;
+        m_free = m_nodes[id].parent;
+        m_nodes[id] = {};
+        m_nodes[id].height = 0;
+        return id;
+    }
+
+    void release(ProxyId id) {
+        m_nodes[id].height = -1;
+        m_nodes[id].parent = m_free;
+        m_free = id;
+    }
+
+    void insert_leaf(ProxyId leaf) {
+        if (m_root == null_proxy) {
+            m_root = leaf;
+            m_nodes[leaf].parent = null_proxy;
+            return;
+        }
+
+        // Walk down to the cheapest sibling: making a new parent at a node costs the merged box,
+        // and every ancestor above it grows by the same amount.
+        Bounds box = m_nodes[leaf].box;
+        ProxyId index = m_root;
+        while (!m_nodes[index].leaf()) {
+            const Node& n = m_nodes[index];
+            float cost = n.box.cost();
+            float combined = merge(n.box, box).cost();
+            float here = 2 * combined;
+            float inherited = 2 * (combined - cost);
+
+            auto descend_cost = [&](ProxyId child) {
+                const Node& c = m_nodes[child];
+                float merged = merge(box, c.box).cost();
+                return c.leaf() ? merged + inherited : merged - c.box.cost() + inherited;
+            };
+            float cost1 = descend_cost(n.child1);
+            float cost2 = descend_cost(n.child2);
+            if (here < cost1 && here < cost2) break;
+            index = cost1 < cost2 ? n.child1 : n.child2;
+        }
+
+        ProxyId sibling = index;
+        ProxyId old_parent = m_nodes[sibling].parent;
+        ProxyId parent = allocate();
+        Node& p = m_nodes[parent];
+        p.parent = old_parent;
+        p.box = merge(box, m_nodes[sibling].box);
+        p.height = m_nodes[sibling].height + 1;
+        p.child1 = sibling;
+        p.child2 = leaf;
+        m_nodes[sibling].parent = parent;
+        m_nodes[leaf].parent = parent;
+        if (old_parent == null_proxy) {
+            m_root = parent;
+        } else if (m_nodes[old_parent].child1 == sibling) {
+            m_nodes[old_parent].child1 = parent;
+        } else {
+            m_nodes[old_parent].child2 = parent;
+        }
+        refit(parent);
+    }
+
+    void remove_leaf(ProxyId leaf) {
+        if (leaf == m_root) {
+            m_root = null_proxy;
+            return;
+        }
+        ProxyId parent = m_nodes[leaf].parent;
+        ProxyId grand = m_nodes[parent].parent;
+        ProxyId sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+        release(parent);
+        m_nodes[sibling].parent = grand;
+        if (grand == null_proxy) {
+            m_root = sibling;
+            return;
+        }
+        if (m_nodes[grand].child1 == parent) {
+            m_nodes[grand].child1 = sibling;
+        } else {
+            m_nodes[grand].child2 = sibling;
+        }
+        refit(grand);
+    }
+
+    // Rebalances and fixes boxes and heights from index up to the root.
+    void refit(ProxyId index) {
+        while (index != null_proxy) {
+            index = balance(index);
+            Node& n = m_nodes[index];
+            const Node& c1 = m_nodes[n.child1];
+            const Node& c2 = m_nodes[n.child2];
+            n.height = 1 + std::max(c1.height, c2.height);
+            n.box = merge(c1.box, c2.box);
+            index = n.parent;
+        }
+    }
+
+    // If one child of a is more than one level taller than the other, rotates that child up into
+    // a's place. Returns the root of the subtree.
+    ProxyId balance(ProxyId a) {
+        Node& A = m_nodes[a];
+        if (A.leaf() || A.height < 2) return a;
+        int32_t diff = m_nodes[A.child2].height - m_nodes[A.child1].height;
+        if (diff > 1) return rotate_up(a, A.child2, A.child1);
+        if (diff < -1) return rotate_up(a, A.child1, A.child2);
+        return a;
+    }
+
+    // tall becomes the parent of a; a keeps short and the shorter of tall's children.
+    ProxyId rotate_up(ProxyId a, ProxyId tall, ProxyId short_child) {
+        Node& A = m_nodes[a];
+        Node& T = m_nodes[tall];
+        ProxyId f = T.child1;
+        ProxyId g = T.child2;
+
+        T.parent = A.parent;
+        A.parent = tall;
+        if (T.parent == null_proxy) {
+            m_root = tall;
+        } else if (m_nodes[T.parent].child1 == a) {
+            m_nodes[T.parent].child1 = tall;
+        } else {
+            m_nodes[T.parent].child2 = tall;
+        }
+
+        // Keep the taller grandchild under tall, give the other one to a.
+        ProxyId keep = m_nodes[f].height > m_nodes[g].height ? f : g;
+        ProxyId give = keep == f ? g : f;
+        T.child1 = a;
+        T.child2 = keep;
+        A.child1 = short_child;
+        A.child2 = give;
+        m_nodes[give].parent = a;
+
+        A.box = merge(m_nodes[short_child].box, m_nodes[give].box);
+        A.height = 1 + std::max(m_nodes[short_child].height, m_nodes[give].height);
+        T.box = merge(A.box, m_nodes[keep].box);
+        T.height = 1 + std::max(A.height, m_nodes[keep].height);
+        return tall;
+    }
+
+    ProxyId build(std::span<ProxyId> leaves) {
+        if (leaves.size() == 1) {
+            return leaves[0];
+        }
+        Bounds centers = { 1e30f, 1e30f, -1e30f, -1e30f };
+        for (ProxyId id : leaves) {
+            const Bounds& b = m_nodes[id].box;
+            float cx = (b.min_x + b.max_x) * 0.5f;
+            float cy = (b.min_y + b.max_y) * 0.5f;
+            centers = merge(centers, { cx, cy, cx, cy });
+        }
+        bool split_x = centers.max_x - centers.min_x >= centers.max_y - centers.min_y;
+        auto mid = leaves.begin() + leaves.size() / 2;
+        std::nth_element(leaves.begin(), mid, leaves.end(), [&](ProxyId a, ProxyId b) {
+            const Bounds& ba = m_nodes[a].box;
+            const Bounds& bb = m_nodes[b].box;
+            return split_x ? ba.min_x + ba.max_x < bb.min_x + bb.max_x : ba.min_y + ba.max_y < bb.min_y + bb.max_y;
+        });
+        size_t half = leaves.size() / 2;
+        ProxyId left = build(leaves.first(half));
+        ProxyId right = build(leaves.subspan(half));
+
+        ProxyId parent = allocate();
+        Node& p = m_nodes[parent];
+        p.child1 = left;
+        p.child2 = right;
+        p.box = merge(m_nodes[left].box, m_nodes[right].box);
+        p.height = 1 + std::max(m_nodes[left].height, m_nodes[right].height);
+        m_nodes[left].parent = parent;
+        m_nodes[right].parent = parent;
+        return parent;
+    }
+
+    std::vector<Node> m_nodes;
+    ProxyId m_root = null_proxy;
+    ProxyId m_free = null_proxy;
+    size_t m_count = 0;
+    float m_margin;
+};
+
+}
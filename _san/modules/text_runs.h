@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+
+#include "glyph_rasterizer.h"
+#include "glyph_cache.h"
+#include "tile_canvas.h"
+#include "blend_kernels.h"
+
+// Strings to quads. Shaping here is the simple kind, a glyph per character with advances and pair
+// kerning, but it's still the expensive part of drawing a label that doesn't change, so shaped runs
+// are cached by string and style. Emitting a run looks up each glyph in the GlyphCache at the
+// subpixel position the pen lands on and appends a quad per visible glyph; a whole frame of text is
+// one batch, one draw from the glyph atlas.
+
+namespace text {
+
+struct TextStyle {
+    FontId font = 0;
+    float size = 16;        // pixels per em
+
+    friend bool operator==(const TextStyle&, const TextStyle&) = default;
+};
+
+struct ShapedGlyph {
+    uint16_t glyph;
+    float x;                // pen position from the start of the run
+};
+
+struct ShapedRun {
+    std::vector<ShapedGlyph> glyphs;
+    float width = 0;        // the pen position after the last glyph
+};
+
+// Code points out of UTF-8; anything malformed comes out as U+FFFD.
+std::u32string decode_utf8(std::string_view s) {
+    std::u32string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size();) {
+        uint8_t c = uint8_t(s[i]);
+        int extra = c < 0x80 ? 0 : (c >> 5) == 6 ? 1 : (c >> 4) == 14 ? 2 : (c >> 3) == 30 ? 3 : -1;
+        if (extra < 0 || i + extra >= s.size()) {
+            out.push_back(0xfffd);
+            i++;
+            continue;
+        }
+        char32_t cp = extra == 0 ? c : c & (0x3f >> extra);
+        bool ok = true;
+        for (int k = 1; k <= extra; k++) {
+            uint8_t next = uint8_t(s[i + k]);
+            ok = ok && (next & 0xc0) == 0x80;
+            cp = cp << 6 | (next & 0x3f);
+        }
+        out.push_back(ok ? cp : 0xfffd);
+        i += ok ? extra + 1 : 1;
+    }
+    return out;
+}
+
+ShapedRun shape(const GlyphRasterizer& rasterizer, std::string_view utf8, const TextStyle& style) {
+    ShapedRun run;
+    float pen = 0;
+    uint16_t previous = 0;
+    for (char32_t c : decode_utf8(utf8)) {
+        uint16_t glyph = rasterizer.glyph_index(style.font, c);
+        if (!run.glyphs.empty()) pen += rasterizer.kerning(style.font, style.size, previous, glyph);
+        run.glyphs.push_back({ glyph, pen });
+        pen += rasterizer.advance(style.font, style.size, glyph);
+        previous = glyph;
+    }
+    run.width = pen;
+    return run;
+}
+
+struct RunCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Shaped runs by (string, style), least recently used out first once there are capacity of them.
+class RunCache {
+public:
+    RunCache(const GlyphRasterizer& rasterizer, size_t capacity)
+        : m_rasterizer(rasterizer), m_capacity(std::max<size_t>(capacity, 1))
+    {
+    }
+
+    // Valid until the next get().
+    const ShapedRun& get(std::string_view utf8, const TextStyle& style) {
+        m_probe.text.assign(utf8);
+        m_probe.style = style;
+        auto it = m_runs.find(m_probe);
+        if (it != m_runs.end()) {
+            m_stats.hits++;
+            m_order.splice(m_order.begin(), m_order, it->second.order);
+            return it->second.run;
+        }
+        m_stats.misses++;
+        if (m_runs.size() >= m_capacity) {
+            m_runs.erase(m_order.back());
+            m_order.pop_back();
+            m_stats.evictions++;
+        }
+        m_order.push_front(m_probe);
+        auto& entry = m_runs[m_probe];
+        entry.run = shape(m_rasterizer, utf8, style);
+        entry.order = m_order.begin();
+        return entry.run;
+    }
+
+    const RunCacheStats& stats() const { return m_stats; }
+    void reset_stats() { m_stats = {}; }
+    size_t size() const { return m_runs.size(); }
+
+private:
+    struct Key {
+        std::string text;
+        TextStyle style;
+
+        friend bool operator==(const Key&, const Key&) = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            size_t h = std::hash<std::string>()(k.text);
+            h ^= std::hash<float>()(k.style.size) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+            return h ^ (size_t(k.style.font) * 0x9e3779b97f4a7c15);
+        }
+    };
+
+    struct Entry {
+        ShapedRun run;
+        std::list<Key>::iterator order;
+    };
+
+    const GlyphRasterizer& m_rasterizer;
+    size_t m_capacity;
+    std::list<Key> m_order;     // most recently used first
+    std::unordered_map<Key, Entry, KeyHash> m_runs;
+    Key m_probe;                // reused for lookups so a hit doesn't allocate
+    RunCacheStats m_stats;
+};
+
+// A glyph's pixels in the target and in the atlas, both in pixels. Color is premultiplied RGBA8
+// like the canvas, scaled by the atlas coverage.
+struct GlyphQuad {
+    int16_t x = 0, y = 0;
+    AtlasRect source;
+    uint32_t color = 0;
+};
+
+// Appends a quad for each visible glyph of run, with the pen starting at (x, y) on the baseline.
+// Returns how many glyphs couldn't be cached (and so aren't drawn).
+int emit_quads(GlyphCache& cache, const ShapedRun& run, const TextStyle& style, float x, float y,
+                      uint32_t color, std::vector<GlyphQuad>& quads) {
+    int dropped = 0;
+    uint32_t size_64 = uint32_t(std::lround(style.size * 64));
+    int baseline = int(std::lround(y));
+    for (const auto& g : run.glyphs) {
+        // Which quarter of a pixel the pen is on; rounding up to a whole step moves to the next pixel.
+        float pen = x + g.x;
+        float whole = std::floor(pen);
+        int step = int(std::lround((pen - whole) * subpixel_steps));
+        if (step == subpixel_steps) {
+            step = 0;
+            whole += 1;
+        }
+        const CachedGlyph* cached = cache.get({ style.font, g.glyph, size_64, uint8_t(step) });
+        if (!cached) {
+            dropped++;
+            continue;
+        }
+        if (cached->rect.width == 0) continue;
+        quads.push_back({ int16_t(int(whole) + cached->left), int16_t(baseline + cached->top), cached->rect, color });
+    }
+    return dropped;
+}
+
+// The batch for a GPU draw: four vertices and six indices per quad, positions in pixels and uvs
+// normalized to the atlas. The pixel shader multiplies color by the atlas's coverage.
+struct TextVertex {
+    float x, y;
+    float u, v;
+    uint32_t color;
+};
+
+void quad_vertices(std::span<const GlyphQuad> quads, int atlas_width, int atlas_height,
+                          std::vector<TextVertex>& vertices, std::vector<uint32_t>& indices) {
+    float su = 1.0f / atlas_width, sv = 1.0f / atlas_height;
+    for (const auto& q : quads) {
+        uint32_t base = uint32_t(vertices.size());
+        float x0 = q.x, y0 = q.y, x1 = float(q.x + q.source.width), y1 = float(q.y + q.source.height);
+        float u0 = q.source.x * su, v0 = q.source.y * sv;
+        float u1 = (q.source.x + q.source.width) * su, v1 = (q.source.y + q.source.height) * sv;
+        vertices.push_back({ x0, y0, u0, v0, q.color });
+        vertices.push_back({ x1, y0, u1, v0, q.color });
+        vertices.push_back({ x1, y1, u1, v1, q.color });
+        vertices.push_back({ x0, y1, u0, v1, q.color });
+        for (uint32_t i : { 0u, 1u, 3u, 1u, 2u, 3u }) {
+            indices.push_back(base + i);
+        }
+    }
+}
+
+// The CPU version of that draw: each quad's color scaled by its coverage, blended source over onto
+// the canvas a tile row at a time, through mutable_tile() like any other drawing.
+void draw_quads(canvas::TileCanvas& target, const GlyphCache& cache, std::span<const GlyphQuad> quads) {
+    using canvas::tile_size;
+    const uint8_t* atlas = cache.atlas_pixels();
+    uint32_t src[tile_size];
+    for (const auto& q : quads) {
+        int x0 = std::max<int>(q.x, 0), y0 = std::max<int>(q.y, 0);
+        int x1 = std::min(q.x + q.source.width, target.width());
+        int y1 = std::min(q.y + q.source.height, target.height());
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* coverage = atlas + size_t(q.source.y + y - q.y) * cache.atlas_width() + q.source.x - q.x;
+            for (int x = x0; x < x1;) {
+                int end = std::min(x1, (x / tile_size + 1) * tile_size);
+                bool any = false;
+                for (int i = x; i < end; i++) {
+                    uint32_t a = coverage[i];
+                    uint32_t p = 0;
+                    for (int c = 0; c < 32; c += 8) {
+                        p |= ((((q.color >> c) & 0xff) * a + 127) / 255) << c;
+                    }
+                    src[i - x] = p;
+                    any |= p != 0;
+                }
+                if (any) {
+                    auto& tile = target.mutable_tile(target.tile_index(x / tile_size, y / tile_size));
+                    pixel::blend_rgba8(pixel::BlendMode::source_over, tile.row(y % tile_size) + x % tile_size, src,
+                                       size_t(end - x));
+                }
+                x = end;
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,978 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+
+#include "lz_codec.h"
+#include "resample.h"
+
+// Streams textures in from disk a mip at a time, coarsest first, so a library of thousands of images
+// can be browsed without loading all of them up front.
+//
+// Images are kept as mip files, made once from the source with build_mip_file():
+//   "DOTMIPS1", u32 width, u32 height, u32 mip count,
+//   then per mip, coarsest first: u32 width, u32 height, u64 offset, u32 stored size, u32 flags,
+//   then the mips themselves in the same order, RGBA8, lz compressed when that's smaller.
+// The first read of a file is head_bytes long, which takes in the smallest mips along with the
+// header, so a single read puts something on screen.
+//
+// Reads go through an AsyncReader with a bounded queue: io_uring on Linux, overlapped reads on a
+// completion port on Windows, and blocking reads when neither is there. TextureStreamer decides what
+// to read next, for the textures on screen. A texture's priority is its size on screen over how many
+// frames ago it was seen, and each mip coarser than the finest it wants counts double. Over the
+// budget, the mips with the lowest priority are dropped, and a read only goes out if what it would
+// push out matters less.
+//
+// Knows nothing about D3D; mips are handed to the app through a callback to upload.
+//
+// Not wired into the app: DrawOnTexture shows one file texture, which load_file_texture() decodes
+// with jpeg_decoder, reduced size first. This is for browsing many images, and is driven for now
+// by benchmarks/texture_streaming_bench.cpp over a corpus it generates.
+
+namespace streaming {
+
+constexpr char mip_magic[8] = { 'D', 'O', 'T', 'M', 'I', 'P', 'S', '1' };
+constexpr uint32_t mip_lz = 1;
+constexpr size_t header_bytes = sizeof(mip_magic) + 3 * sizeof(uint32_t);
+constexpr size_t level_bytes = 2 * sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+constexpr size_t head_bytes = 4096;
+constexpr int max_mips = 15;      // up to 16384, D3D12's largest texture
+// Past any mip file there could be: all the levels of a 16384x16384 image come to under 1.5GB.
+constexpr uint64_t max_file_bytes = 1ull << 32;
+
+struct MipLevel {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t offset = 0;
+    uint32_t stored_size = 0;
+    uint32_t flags = 0;
+
+    uint64_t bytes() const { return uint64_t(width) * height * 4; }
+};
+
+struct MipFileHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<MipLevel> mips;     // coarsest first
+};
+
+template <class T>
+T read_at(std::span<const uint8_t> data, size_t at) {
+    T v;
+    memcpy(&v, data.data() + at, sizeof(v));
+    return v;
+}
+
+template <class T>
+void append(std::vector<uint8_t>& out, T v) {
+    auto p = reinterpret_cast<const uint8_t*>(&v);
+    out.insert(out.end(), p, p + sizeof(v));
+}
+
+// Reads the header from the start of a mip file. Throws std::runtime_error if it isn't one.
+MipFileHeader parse_mip_header(std::span<const uint8_t> head) {
+    if (head.size() < header_bytes || memcmp(head.data(), mip_magic, sizeof(mip_magic)) != 0) {
+        throw std::runtime_error("texture_streaming: not a mip file");
+    }
+    MipFileHeader header;
+    header.width = read_at<uint32_t>(head, 8);
+    header.height = read_at<uint32_t>(head, 12);
+    uint32_t count = read_at<uint32_t>(head, 16);
+    if (count == 0 || count > max_mips || head.size() < header_bytes + count * level_bytes) {
+        throw std::runtime_error("texture_streaming: bad mip count");
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        size_t at = header_bytes + i * level_bytes;
+        MipLevel mip;
+        mip.width = read_at<uint32_t>(head, at);
+        mip.height = read_at<uint32_t>(head, at + 4);
+        mip.offset = read_at<uint64_t>(head, at + 8);
+        mip.stored_size = read_at<uint32_t>(head, at + 16);
+        mip.flags = read_at<uint32_t>(head, at + 20);
+        // Sizes are checked before anything gets allocated for them.
+        bool size_ok = (mip.flags & mip_lz) ? mip.stored_size <= lz::compress_bound(mip.bytes())
+                                            : mip.stored_size == mip.bytes();
+        bool after_table = mip.offset >= header_bytes + count * level_bytes;
+        bool in_file = mip.offset <= max_file_bytes && mip.stored_size <= max_file_bytes - mip.offset;
+        if (mip.width == 0 || mip.height == 0 || !size_ok || !after_table || !in_file) {
+            throw std::runtime_error("texture_streaming: bad mip level");
+        }
+        header.mips.push_back(mip);
+    }
+    // Each level is half the next, down to 1x1.
+    uint32_t width = header.width, height = header.height;
+    for (size_t i = count; i-- > 0;) {
+        if (header.mips[i].width != width || header.mips[i].height != height) {
+            throw std::runtime_error("texture_streaming: mip sizes don't halve");
+        }
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    if (header.mips[0].width != 1 || header.mips[0].height != 1) {
+        throw std::runtime_error("texture_streaming: mips don't go down to 1x1");
+    }
+    return header;
+}
+
+// A mip file for an RGBA8 image: every level down to 1x1, box filtered from the one above. The pitch
+// is in pixels, as for resample_rgba8().
+std::vector<uint8_t> build_mip_file(const uint32_t* pixels, int width, int height, size_t pitch) {
+    assert(width > 0 && height > 0);
+    std::vector<std::vector<uint32_t>> levels;
+    std::vector<std::pair<int, int>> sizes;
+    levels.emplace_back(size_t(width) * height);
+    for (int y = 0; y < height; y++) {
+        memcpy(levels[0].data() + size_t(y) * width, pixels + y * pitch, size_t(width) * 4);
+    }
+    sizes.emplace_back(width, height);
+    pixel::ResampleOptions options;
+    options.filter = pixel::ResampleFilter::box;
+    while (sizes.back().first > 1 || sizes.back().second > 1) {
+        auto [w, h] = sizes.back();
+        int mw = std::max(1, w / 2), mh = std::max(1, h / 2);
+        std::vector<uint32_t> mip(size_t(mw) * mh);
+        pixel::resample_rgba8(mip.data(), mw, mh, mw, levels.back().data(), w, h, w, options);
+        levels.push_back(std::move(mip));
+        sizes.emplace_back(mw, mh);
+    }
+    if (levels.size() > max_mips) {
+        throw std::runtime_error("texture_streaming: image too big for a mip file");
+    }
+    std::reverse(levels.begin(), levels.end());
+    std::reverse(sizes.begin(), sizes.end());
+
+    std::vector<std::vector<uint8_t>> stored;
+    std::vector<uint32_t> flags;
+    for (const auto& level : levels) {
+        std::span<const uint8_t> raw(reinterpret_cast<const uint8_t*>(level.data()), level.size() * 4);
+        std::vector<uint8_t> packed = lz::compress(raw);
+        bool smaller = packed.size() < raw.size();
+        stored.push_back(smaller ? std::move(packed) : std::vector<uint8_t>(raw.begin(), raw.end()));
+        flags.push_back(smaller ? mip_lz : 0);
+    }
+
+    std::vector<uint8_t> out(mip_magic, mip_magic + sizeof(mip_magic));
+    append(out, uint32_t(width));
+    append(out, uint32_t(height));
+    append(out, uint32_t(levels.size()));
+    uint64_t offset = header_bytes + levels.size() * level_bytes;
+    for (size_t i = 0; i < levels.size(); i++) {
+        append(out, uint32_t(sizes[i].first));
+        append(out, uint32_t(sizes[i].second));
+        append(out, offset);
+        append(out, uint32_t(stored[i].size()));
+        append(out, flags[i]);
+        offset += stored[i].size();
+    }
+    for (const auto& s : stored) {
+        out.insert(out.end(), s.begin(), s.end());
+    }
+    return out;
+}
+
+void write_mip_file(const std::filesystem::path& path, const uint32_t* pixels, int width, int height,
+                           size_t pitch) {
+    std::vector<uint8_t> bytes = build_mip_file(pixels, width, height, pitch);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    if (!file) {
+        throw std::runtime_error("texture_streaming: couldn't write " + path.string());
+    }
+}
+
+// --- async reads ---------------------------------------------------------------------------------
+
+struct ReadRequest {
+    int file = -1;
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    uint8_t* dest = nullptr;    // left alone by the caller until the read completes
+    uint64_t tag = 0;
+};
+
+struct ReadDone {
+    uint64_t tag = 0;
+    int64_t bytes = 0;          // read, which is short at the end of the file; -1 if it failed
+};
+
+class AsyncReader {
+public:
+    virtual ~AsyncReader() = default;
+    virtual const char* name() const = 0;
+
+    // A file to read from, or -1 if it can't be opened. Only close it with nothing in flight on it.
+    virtual int open(const std::filesystem::path& path) = 0;
+    virtual void close(int file) = 0;
+
+    // At most depth() reads are in flight; submit() turns down any more.
+    virtual int depth() const = 0;
+    virtual int in_flight() const = 0;
+    virtual bool submit(const ReadRequest& request) = 0;
+
+    // Sends off what's been submitted and appends what's finished to done. With wait, blocks until
+    // at least one read finishes, unless none are in flight.
+    virtual void complete(std::vector<ReadDone>& done, bool wait) = 0;
+};
+
+// Reads in complete(), one after the other. The fallback, and the baseline to measure against.
+class BlockingReader final : public AsyncReader {
+public:
+    explicit BlockingReader(int depth) : m_depth(depth) {}
+
+    const char* name() const override { return "blocking"; }
+
+    int open(const std::filesystem::path& path) override {
+        auto file = std::make_unique<std::ifstream>(path, std::ios::binary);
+        if (!*file) return -1;
+        for (size_t i = 0; i < m_files.size(); i++) {
+            if (!m_files[i]) {
+                m_files[i] = std::move(file);
+                return int(i);
+            }
+        }
+        m_files.push_back(std::move(file));
+        return int(m_files.size() - 1);
+    }
+
+    void close(int file) override { m_files[file] = nullptr; }
+
+    int depth() const override { return m_depth; }
+    int in_flight() const override { return int(m_queued.size()); }
+
+    bool submit(const ReadRequest& request) override {
+        if (in_flight() >= m_depth) return false;
+        m_queued.push_back(request);
+        return true;
+    }
+
+    void complete(std::vector<ReadDone>& done, bool) override {
+        for (const ReadRequest& r : m_queued) {
+            std::ifstream& file = *m_files[r.file];
+            file.clear();
+            file.seekg(std::streamoff(r.offset));
+            file.read(reinterpret_cast<char*>(r.dest), r.size);
+            int64_t bytes = file.gcount();
+            done.push_back({ r.tag, file.bad() || (bytes == 0 && r.size) ? -1 : bytes });
+        }
+        m_queued.clear();
+    }
+
+private:
+    int m_depth;
+    std::vector<std::unique_ptr<std::ifstream>> m_files;
+    std::vector<ReadRequest> m_queued;
+};
+
+#if defined(_WIN32)
+
+// Overlapped reads on a completion port.
+class OverlappedReader final : public AsyncReader {
+public:
+    explicit OverlappedReader(int depth) : m_depth(depth), m_slots(depth) {
+        m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (!m_port) throw std::runtime_error("texture_streaming: couldn't make a completion port");
+        for (int i = depth - 1; i >= 0; i--) m_free.push_back(i);
+    }
+
+    ~OverlappedReader() override {
+        std::vector<ReadDone> done;
+        while (m_in_flight) complete(done, true);
+        for (HANDLE file : m_files) {
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        }
+        CloseHandle(m_port);
+    }
+
+    const char* name() const override { return "overlapped"; }
+
+    int open(const std::filesystem::path& path) override {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_OVERLAPPED, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return -1;
+        if (!CreateIoCompletionPort(file, m_port, 0, 0)) {
+            CloseHandle(file);
+            return -1;
+        }
+        for (size_t i = 0; i < m_files.size(); i++) {
+            if (m_files[i] == INVALID_HANDLE_VALUE) {
+                m_files[i] = file;
+                return int(i);
+            }
+        }
+        m_files.push_back(file);
+        return int(m_files.size() - 1);
+    }
+
+    void close(int file) override {
+        CloseHandle(m_files[file]);
+        m_files[file] = INVALID_HANDLE_VALUE;
+    }
+
+    int depth() const override { return m_depth; }
+    int in_flight() const override { return m_in_flight; }
+
+    bool submit(const ReadRequest& request) override {
+        if (m_free.empty()) return false;
+        int index = m_free.back();
+        m_free.pop_back();
+        Slot& slot = m_slots[index];
+        slot.overlapped = {};
+        slot.overlapped.Offset = DWORD(request.offset);
+        slot.overlapped.OffsetHigh = DWORD(request.offset >> 32);
+        slot.tag = request.tag;
+        m_in_flight++;
+        // Even a read that finishes right away posts to the port, so it's collected in complete() too.
+        if (!ReadFile(m_files[request.file], request.dest, request.size, nullptr, &slot.overlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            m_failed.push_back({ request.tag, -1 });
+            m_free.push_back(index);
+            m_in_flight--;
+        }
+        return true;
+    }
+
+    void complete(std::vector<ReadDone>& done, bool wait) override {
+        done.insert(done.end(), m_failed.begin(), m_failed.end());
+        bool block = wait && m_failed.empty() && m_in_flight > 0;
+        m_failed.clear();
+        if (m_in_flight == 0) return;
+        OVERLAPPED_ENTRY entries[64];
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(m_port, entries, 64, &count, block ? INFINITE : 0, false)) return;
+        for (ULONG i = 0; i < count; i++) {
+            Slot* slot = CONTAINING_RECORD(entries[i].lpOverlapped, Slot, overlapped);
+            // Internal is the NTSTATUS; reading from past the end is an error status too.
+            bool ok = LONG(slot->overlapped.Internal) >= 0;
+            done.push_back({ slot->tag, ok ? int64_t(entries[i].dwNumberOfBytesTransferred) : -1 });
+            m_free.push_back(int(slot - m_slots.data()));
+            m_in_flight--;
+        }
+    }
+
+private:
+    struct Slot {
+        OVERLAPPED overlapped{};
+        uint64_t tag = 0;
+    };
+
+    int m_depth;
+    HANDLE m_port = nullptr;
+    std::vector<Slot> m_slots;
+    std::vector<int> m_free;
+    std::vector<HANDLE> m_files;
+    std::vector<ReadDone> m_failed;
+    int m_in_flight = 0;
+};
+
+#elif defined(__linux__)
+
+// io_uring through the raw system calls: one submission queue entry per read, submitted in a batch
+// by complete(), which also reaps.
+class UringReader final : public AsyncReader {
+public:
+    explicit UringReader(int depth) : m_depth(depth), m_slots(depth) {
+        for (int i = depth - 1; i >= 0; i--) m_free.push_back(i);
+        io_uring_params params{};
+        m_ring = int(syscall(__NR_io_uring_setup, unsigned(depth), &params));
+        if (m_ring < 0) throw std::runtime_error("texture_streaming: io_uring_setup failed");
+        m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+        m_sq = map(m_sq_size, IORING_OFF_SQ_RING);
+        m_cq = single ? m_sq : map(m_cq_size, IORING_OFF_CQ_RING);
+        m_sqes = static_cast<io_uring_sqe*>(map(params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+        m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        auto sq = static_cast<uint8_t*>(m_sq);
+        auto cq = static_cast<uint8_t*>(m_cq);
+        m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~UringReader() override {
+        std::vector<ReadDone> done;
+        while (m_in_flight) complete(done, true);
+        for (int fd : m_files) {
+            if (fd >= 0) ::close(fd);
+        }
+        munmap(m_sqes, m_sqes_size);
+        if (m_cq != m_sq) munmap(m_cq, m_cq_size);
+        munmap(m_sq, m_sq_size);
+        ::close(m_ring);
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    int open(const std::filesystem::path& path) override {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return -1;
+        for (size_t i = 0; i < m_files.size(); i++) {
+            if (m_files[i] < 0) {
+                m_files[i] = fd;
+                return int(i);
+            }
+        }
+        m_files.push_back(fd);
+        return int(m_files.size() - 1);
+    }
+
+    void close(int file) override {
+        ::close(m_files[file]);
+        m_files[file] = -1;
+    }
+
+    int depth() const override { return m_depth; }
+    int in_flight() const override { return m_in_flight; }
+
+    bool submit(const ReadRequest& request) override {
+        if (m_free.empty()) return false;
+        int slot = m_free.back();
+        m_free.pop_back();
+        m_slots[slot] = { request.tag, request.size };
+        // Only this thread moves the tail, so a plain read of it is fine; the kernel needs the release.
+        unsigned tail = *m_sq_tail;
+        unsigned index = tail & m_sq_mask;
+        io_uring_sqe& sqe = m_sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = m_files[request.file];
+        sqe.off = request.offset;
+        sqe.addr = reinterpret_cast<uint64_t>(request.dest);
+        sqe.len = request.size;
+        sqe.user_data = uint64_t(slot);
+        m_sq_array[index] = index;
+        std::atomic_ref<unsigned>(*m_sq_tail).store(tail + 1, std::memory_order_release);
+        m_unsubmitted++;
+        m_in_flight++;
+        return true;
+    }
+
+    void complete(std::vector<ReadDone>& done, bool wait) override {
+        if (m_in_flight == 0) return;
+        bool block = wait && ready() == 0;
+        if (m_unsubmitted || block) {
+            unsigned flags = block ? IORING_ENTER_GETEVENTS : 0;
+            int submitted;
+            do {
+                submitted = int(syscall(__NR_io_uring_enter, m_ring, m_unsubmitted, block ? 1u : 0u, flags,
+                                        nullptr, 0));
+            } while (submitted < 0 && errno == EINTR);
+            if (submitted < 0) throw std::runtime_error("texture_streaming: io_uring_enter failed");
+            m_unsubmitted -= unsigned(submitted);
+        }
+        unsigned head = *m_cq_head;
+        unsigned tail = std::atomic_ref<unsigned>(*m_cq_tail).load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+            const Slot& slot = m_slots[cqe.user_data];
+            // Nothing at all for a read that asked for something started past the end of the file,
+            // which the other readers fail.
+            bool failed = cqe.res < 0 || (cqe.res == 0 && slot.size > 0);
+            done.push_back({ slot.tag, failed ? -1 : int64_t(cqe.res) });
+            m_free.push_back(int(cqe.user_data));
+            m_in_flight--;
+        }
+        std::atomic_ref<unsigned>(*m_cq_head).store(head, std::memory_order_release);
+    }
+
+private:
+    void* map(size_t size, uint64_t offset) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, off_t(offset));
+        if (p == MAP_FAILED) throw std::runtime_error("texture_streaming: couldn't map the io_uring rings");
+        return p;
+    }
+
+    unsigned ready() const {
+        return std::atomic_ref<unsigned>(*m_cq_tail).load(std::memory_order_acquire) - *m_cq_head;
+    }
+
+    struct Slot {
+        uint64_t tag = 0;
+        uint32_t size = 0;
+    };
+
+    int m_depth;
+    std::vector<Slot> m_slots;
+    std::vector<int> m_free;
+    int m_ring = -1;
+    void* m_sq = nullptr;
+    void* m_cq = nullptr;
+    size_t m_sq_size = 0;
+    size_t m_cq_size = 0;
+    size_t m_sqes_size = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    unsigned* m_sq_tail = nullptr;
+    unsigned m_sq_mask = 0;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned m_cq_mask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+    std::vector<int> m_files;
+    unsigned m_unsubmitted = 0;
+    int m_in_flight = 0;
+};
+
+#endif
+
+// The platform's asynchronous reader, or blocking reads if it can't be had.
+std::unique_ptr<AsyncReader> make_reader(int depth) {
+    assert(depth > 0);
+    try {
+#if defined(_WIN32)
+        return std::make_unique<OverlappedReader>(depth);
+#elif defined(__linux__)
+        return std::make_unique<UringReader>(depth);
+#endif
+    } catch (const std::runtime_error&) {
+    }
+    return std::make_unique<BlockingReader>(depth);
+}
+
+std::unique_ptr<AsyncReader> make_blocking_reader(int depth) {
+    return std::make_unique<BlockingReader>(depth);
+}
+
+// --- residency -----------------------------------------------------------------------------------
+
+using TextureId = uint32_t;
+
+struct StreamedMip {
+    int level = 0;              // 0 is full size
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::span<const uint32_t> pixels;   // RGBA8, packed rows; only good during the callback
+};
+
+struct StreamingOptions {
+    uint64_t budget = 512ull << 20;     // bytes of resident mips, at 4 bytes a pixel
+    int max_open_files = 256;
+};
+
+struct StreamingStats {
+    uint64_t reads = 0;
+    uint64_t bytes_read = 0;
+    uint64_t mips_loaded = 0;
+    uint64_t mips_evicted = 0;
+    uint64_t failed = 0;        // textures given up on
+    uint64_t resident_bytes = 0;
+    int in_flight = 0;
+};
+
+class TextureStreamer {
+public:
+    // A mip arrived. They come coarsest first, each after the one below it.
+    using MipFn = std::function<void(TextureId id, const StreamedMip& mip)>;
+    // Mips finer than level are gone; level is the mip count when none are left.
+    using EvictFn = std::function<void(TextureId id, int level)>;
+
+    TextureStreamer(std::unique_ptr<AsyncReader> reader, StreamingOptions options, MipFn on_mip, EvictFn on_evict)
+        : m_reader(std::move(reader)), m_options(options), m_on_mip(std::move(on_mip)),
+          m_on_evict(std::move(on_evict)) {
+        assert(m_reader && m_on_mip && m_on_evict);
+    }
+
+    // The reads write into our buffers, so they have to land first.
+    ~TextureStreamer() {
+        std::vector<ReadDone> done;
+        while (m_reader->in_flight()) m_reader->complete(done, true);
+        for (Texture& t : m_textures) {
+            if (t.file >= 0) m_reader->close(t.file);
+        }
+    }
+
+    TextureId add(std::filesystem::path path) {
+        m_textures.push_back({});
+        m_textures.back().path = std::move(path);
+        return TextureId(m_textures.size() - 1);
+    }
+
+    // The texture is on screen this frame at this many pixels along its longer side.
+    void set_screen_size(TextureId id, float pixels) {
+        Texture& t = m_textures[id];
+        t.screen = std::max(pixels, 0.0f);
+        t.last_seen = m_frame;
+        t.seen = true;
+    }
+
+    // Once a frame: collects finished reads and hands their mips over, then sends the next reads off
+    // in priority order, evicting to make room for them. With wait, blocks for a read if any are out.
+    // The queue depth is the reader's.
+    void update(bool wait = false) {
+        m_done.clear();
+        m_reader->complete(m_done, wait);
+        for (const ReadDone& d : m_done) {
+            finish_read(TextureId(d.tag), d.bytes);
+        }
+        issue_reads();
+        m_evictable = {};
+        m_evictable_built = false;
+        m_frame++;
+    }
+
+    int mip_count(TextureId id) const { return int(m_textures[id].header.mips.size()); }
+    // The finest level on hand, or the mip count if none are.
+    int resident_level(TextureId id) const {
+        const Texture& t = m_textures[id];
+        return int(t.header.mips.size()) - t.resident;
+    }
+    bool failed(TextureId id) const { return m_textures[id].state == State::failed; }
+    size_t size() const { return m_textures.size(); }
+
+    StreamingStats stats() const {
+        StreamingStats stats = m_stats;
+        stats.resident_bytes = m_resident_bytes;
+        stats.in_flight = m_reader->in_flight();
+        return stats;
+    }
+
+private:
+    enum class State : uint8_t { no_header, ready, failed };
+
+    struct Texture {
+        std::filesystem::path path;
+        State state = State::no_header;
+        MipFileHeader header;
+        int resident = 0;           // mips on hand, counting from the coarsest
+        bool reading = false;       // one read at a time, so mips arrive in order
+        int reading_end = 0;        // the read takes in mips resident..reading_end
+        int file = -1;
+        bool seen = false;
+        float screen = 0;
+        uint64_t last_seen = 0;
+        std::vector<uint8_t> buffer;
+    };
+
+    static constexpr size_t spare_limit = 64 << 20;
+    static constexpr uint64_t batch_bytes = 1 << 20;
+
+    struct Candidate {
+        double score;
+        TextureId id;
+        int resident;               // stale when the texture's has moved on
+        bool operator<(const Candidate& o) const { return score > o.score; }    // lowest on top
+    };
+
+    // Mips wanted, counting from the coarsest: enough that the finest covers the size on screen.
+    int wanted(const Texture& t) const {
+        if (!t.seen || t.state != State::ready) return 0;
+        const auto& mips = t.header.mips;
+        for (size_t i = 0; i < mips.size(); i++) {
+            if (float(std::max(mips[i].width, mips[i].height)) >= t.screen) return int(i) + 1;
+        }
+        return int(mips.size());
+    }
+
+    // How much mip i (coarsest first) of t matters. Mips finer than wanted come out below 1x.
+    double score(const Texture& t, int i) const {
+        double age = double(m_frame - t.last_seen);
+        int coarser = (t.state == State::ready ? wanted(t) - 1 : max_mips) - i;
+        return (double(t.screen) + 1) * std::ldexp(1.0, coarser) / (1 + age);
+    }
+
+    // The mips a read for t takes in, from t.resident up to the returned end. Small ones that sit next
+    // to each other in the file go together, so a texture gets to its size in a read or two rather than
+    // a frame per mip; big ones go alone, so the coarser ones still show first.
+    int batch_end(const Texture& t, int want) const {
+        const auto& mips = t.header.mips;
+        int end = t.resident + 1;
+        uint64_t bytes = mips[t.resident].bytes();
+        while (end < want && mips[end].offset == mips[end - 1].offset + mips[end - 1].stored_size &&
+               bytes + mips[end].bytes() <= batch_bytes) {
+            bytes += mips[end].bytes();
+            end++;
+        }
+        return end;
+    }
+
+    uint64_t batch_bytes_of(const Texture& t, int end) const {
+        uint64_t bytes = 0;
+        for (int i = t.resident; i < end; i++) bytes += t.header.mips[i].bytes();
+        return bytes;
+    }
+
+    void issue_reads() {
+        std::vector<Candidate> next;
+        // Only for what's on screen now. Reading for textures that were would have them push each other
+        // out as they age at different rates; prefetching is up to the app, by calling set_screen_size().
+        for (TextureId id = 0; id < m_textures.size(); id++) {
+            const Texture& t = m_textures[id];
+            if (t.reading || !t.seen || t.last_seen != m_frame || t.state == State::failed) continue;
+            if (t.state == State::no_header || t.resident < wanted(t)) {
+                next.push_back({ score(t, t.resident), id, t.resident });
+            }
+        }
+        std::sort(next.begin(), next.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+        for (const Candidate& c : next) {
+            if (m_reader->in_flight() >= m_reader->depth()) break;
+            Texture& t = m_textures[c.id];
+            int end = 0;
+            uint64_t bytes = 0;
+            if (t.state == State::ready) {
+                end = batch_end(t, wanted(t));
+                bytes = batch_bytes_of(t, end);
+                // Only pushing out what matters less than the finest mip read, so that one doesn't
+                // ride in on the priority of the coarsest.
+                if (!make_room(bytes, score(t, end - 1))) {
+                    // Perhaps the first one alone fits.
+                    if (end == t.resident + 1) continue;
+                    end = t.resident + 1;
+                    bytes = batch_bytes_of(t, end);
+                    if (!make_room(bytes, c.score)) continue;
+                }
+            }
+            if (t.file < 0) {
+                if (m_open_files >= m_options.max_open_files) close_idle_file();
+                t.file = m_reader->open(t.path);
+                if (t.file < 0) {
+                    fail(t);
+                    continue;
+                }
+                m_open_files++;
+            }
+            ReadRequest request;
+            request.file = t.file;
+            request.tag = c.id;
+            if (t.state == State::no_header) {
+                request.size = uint32_t(head_bytes);
+            } else {
+                const MipLevel& first = t.header.mips[t.resident];
+                const MipLevel& last = t.header.mips[end - 1];
+                request.offset = first.offset;
+                request.size = uint32_t(last.offset + last.stored_size - first.offset);
+                t.reading_end = end;
+                m_reserved_bytes += bytes;
+            }
+            t.buffer = take_buffer(request.size);
+            request.dest = t.buffer.data();
+            [[maybe_unused]] bool submitted = m_reader->submit(request);
+            assert(submitted);
+            t.reading = true;
+            m_stats.reads++;
+        }
+    }
+
+    void finish_read(TextureId id, int64_t bytes) {
+        Texture& t = m_textures[id];
+        assert(t.reading);
+        t.reading = false;
+        bool head = t.state == State::no_header;
+        if (!head) m_reserved_bytes -= batch_bytes_of(t, t.reading_end);
+        if (bytes < 0) {
+            fail(t);
+            return;
+        }
+        m_stats.bytes_read += uint64_t(bytes);
+        std::span<const uint8_t> data(t.buffer.data(), size_t(bytes));
+        try {
+            // What came in starts at this offset in the file, and the mips in it are handed over in order.
+            uint64_t base = 0;
+            int end = 0;
+            if (head) {
+                t.header = parse_mip_header(data);
+                t.state = State::ready;
+                // The smallest mips come along with the header.
+                end = int(t.header.mips.size());
+            } else {
+                base = t.header.mips[t.resident].offset;
+                end = t.reading_end;
+            }
+            while (t.resident < end) {
+                const MipLevel& mip = t.header.mips[t.resident];
+                if (mip.offset + mip.stored_size > base + data.size()) {
+                    if (head) break;
+                    throw std::runtime_error("texture_streaming: short read");
+                }
+                deliver(id, t, data.subspan(size_t(mip.offset - base), mip.stored_size));
+            }
+        } catch (const std::runtime_error&) {
+            fail(t);
+            return;
+        }
+        give_back(t.buffer);
+        if (t.resident >= wanted(t)) close_file(t);
+    }
+
+    // Hands mip t.resident over to the app, unpacking it first if it's compressed.
+    void deliver(TextureId id, Texture& t, std::span<const uint8_t> stored) {
+        const MipLevel& mip = t.header.mips[t.resident];
+        size_t count = size_t(mip.width) * mip.height;
+        if (m_pixels.size() < count) m_pixels.resize(count);
+        std::span<uint8_t> dst(reinterpret_cast<uint8_t*>(m_pixels.data()), count * 4);
+        if (mip.flags & mip_lz) {
+            if (!lz::decompress(stored, dst)) throw std::runtime_error("texture_streaming: bad mip data");
+        } else {
+            memcpy(dst.data(), stored.data(), dst.size());
+        }
+        StreamedMip streamed;
+        streamed.level = int(t.header.mips.size()) - 1 - t.resident;
+        streamed.width = mip.width;
+        streamed.height = mip.height;
+        streamed.pixels = { m_pixels.data(), count };
+        m_on_mip(id, streamed);
+        t.resident++;
+        m_resident_bytes += mip.bytes();
+        m_stats.mips_loaded++;
+    }
+
+    // Evicts mips that matter less than `score` until `bytes` more fit. False if they can't be made to.
+    // Read buffers go back to a pool rather than the heap. A new one of a few megabytes costs more in
+    // zeroing and page faults than reading into it does when the file is in the cache.
+    std::vector<uint8_t> take_buffer(size_t size) {
+        auto best = m_spare.end();
+        for (auto it = m_spare.begin(); it != m_spare.end(); ++it) {
+            if (it->size() >= size && (best == m_spare.end() || it->size() < best->size())) best = it;
+        }
+        if (best == m_spare.end() && !m_spare.empty()) best = m_spare.end() - 1;
+        std::vector<uint8_t> buffer;
+        if (best != m_spare.end()) {
+            m_spare_bytes -= best->size();
+            buffer = std::move(*best);
+            m_spare.erase(best);
+        }
+        if (buffer.size() < size) buffer.resize(size);
+        return buffer;
+    }
+
+    void give_back(std::vector<uint8_t>& buffer) {
+        if (m_spare_bytes + buffer.size() <= spare_limit) {
+            m_spare_bytes += buffer.size();
+            m_spare.push_back(std::move(buffer));
+        }
+        buffer = {};
+    }
+
+    // Victims are all picked before any is evicted: evicting some and then not reading would have
+    // them read back in next frame, pushing out something else, and so on.
+    bool make_room(uint64_t bytes, double score) {
+        if (bytes > m_options.budget) return false;
+        uint64_t used = m_resident_bytes + m_reserved_bytes;
+        if (used + bytes <= m_options.budget) return true;
+        if (!m_evictable_built) {
+            for (TextureId id = 0; id < m_textures.size(); id++) push_evictable(id, m_textures[id].resident);
+            m_evictable_built = true;
+        }
+        m_victims.clear();
+        uint64_t freed = 0;
+        while (used + bytes - freed > m_options.budget && !m_evictable.empty()) {
+            Candidate c = m_evictable.top();
+            const Texture& t = m_textures[c.id];
+            if (t.reading || c.resident != t.resident - planned(c.id)) {
+                m_evictable.pop();
+                continue;
+            }
+            if (c.score >= score) break;
+            m_evictable.pop();
+            m_victims.push_back(c);
+            freed += t.header.mips[c.resident - 1].bytes();
+            push_evictable(c.id, c.resident - 1);
+        }
+        if (used + bytes - freed > m_options.budget) {
+            for (const Candidate& c : m_victims) m_evictable.push(c);
+            m_victims.clear();
+            return false;
+        }
+        for (const Candidate& c : m_victims) evict_finest(c.id);
+        m_victims.clear();
+        return true;
+    }
+
+    // Mips of the texture picked to go but not gone yet.
+    int planned(TextureId id) const {
+        int count = 0;
+        for (const Candidate& c : m_victims) count += c.id == id;
+        return count;
+    }
+
+    void push_evictable(TextureId id, int resident) {
+        const Texture& t = m_textures[id];
+        if (resident > 0 && !t.reading) {
+            m_evictable.push({ score(t, resident - 1), id, resident });
+        }
+    }
+
+    void evict_finest(TextureId id) {
+        Texture& t = m_textures[id];
+        t.resident--;
+        m_resident_bytes -= t.header.mips[t.resident].bytes();
+        m_stats.mips_evicted++;
+        m_on_evict(id, int(t.header.mips.size()) - t.resident);
+    }
+
+    void fail(Texture& t) {
+        t.state = State::failed;
+        t.reading = false;
+        give_back(t.buffer);
+        close_file(t);
+        m_stats.failed++;
+    }
+
+    void close_file(Texture& t) {
+        if (t.file < 0) return;
+        m_reader->close(t.file);
+        t.file = -1;
+        m_open_files--;
+    }
+
+    // Out of descriptors: let go of a file nothing's reading from; it opens again when needed.
+    void close_idle_file() {
+        for (Texture& t : m_textures) {
+            if (t.file >= 0 && !t.reading) {
+                close_file(t);
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<AsyncReader> m_reader;
+    StreamingOptions m_options;
+    MipFn m_on_mip;
+    EvictFn m_on_evict;
+    std::vector<Texture> m_textures;
+    std::vector<ReadDone> m_done;
+    std::vector<uint32_t> m_pixels;
+    std::vector<std::vector<uint8_t>> m_spare;
+    size_t m_spare_bytes = 0;
+    std::priority_queue<Candidate> m_evictable;     // built the first time a frame needs room
+    bool m_evictable_built = false;
+    std::vector<Candidate> m_victims;
+    uint64_t m_frame = 0;
+    uint64_t m_resident_bytes = 0;
+    uint64_t m_reserved_bytes = 0;      // mips being read
+    int m_open_files = 0;
+    StreamingStats m_stats;
+};
+
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+
+
+// A CPU side canvas split into fixed size tiles. Tiles are reference counted and copy-on-write,
+// so anything that wants to keep an old version of a tile (undo history, export, a layer cache)
+// just holds on to the shared_ptr. Tiles that were never drawn on are null and read as
+// transparent, which keeps big mostly-empty canvases cheap.
+
+namespace canvas {
+
+inline constexpr int tile_size = 64;
+inline constexpr int tile_pixels = tile_size * tile_size;
+inline constexpr size_t tile_bytes = tile_pixels * sizeof(uint32_t);
+
+// Pixels are premultiplied RGBA8 packed as 0xAABBGGRR, ie. the same byte order in memory as
+// DXGI_FORMAT_R8G8B8A8_UNORM, so a tile row can be memcpy'd into an upload buffer.
+struct Tile {
+    std::array<uint32_t, tile_pixels> pixels{};
+
+    uint32_t* row(int y) { return pixels.data() + y * tile_size; }
+    const uint32_t* row(int y) const { return pixels.data() + y * tile_size; }
+};
+
+class TileCanvas {
+public:
+    TileCanvas(int width, int height)
+        : m_width(width), m_height(height),
+          m_tiles_x((width + tile_size - 1) / tile_size),
+          m_tiles_y((height + tile_size - 1) / tile_size)
+    {
+        assert(width > 0 && height > 0);
+        m_tiles.resize(tile_count());
+        m_dirty_flags.resize(tile_count(), 0);
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int tiles_x() const { return m_tiles_x; }
+    int tiles_y() const { return m_tiles_y; }
+    int tile_count() const { return m_tiles_x * m_tiles_y; }
+
+    int tile_index(int tx, int ty) const {
+        assert(tx >= 0 && tx < m_tiles_x && ty >= 0 && ty < m_tiles_y);
+        return ty * m_tiles_x + tx;
+    }
+
+    // Null if the tile has never been drawn on.
+    const Tile* tile(int index) const {
+        return m_tiles[index].get();
+    }
+
+    std::shared_ptr<Tile> shared_tile(int index) const {
+        return m_tiles[index];
+    }
+
+    // Swap in a whole tile, eg. when undoing. Anyone else holding the tile keeps sharing it
+    // until the next write, which will copy it.
+    void set_shared_tile(int index, std::shared_ptr<Tile> tile) {
+        m_tiles[index] = std::move(tile);
+        mark(index, dirty_upload);
+    }
+
+    // Swap in a whole tile as a drawing operation, eg. one solid tile shared by every tile a fill
+    // covered. Unlike set_shared_tile() it counts as touched.
+    void replace_tile(int index, std::shared_ptr<Tile> tile) {
+        m_tiles[index] = std::move(tile);
+        mark(index, dirty_upload | dirty_touched);
+    }
+
+    // Get a tile for writing. Allocates empty tiles and copies tiles that are shared.
+    Tile& mutable_tile(int index) {
+        auto& t = m_tiles[index];
+        if (!t) {
+            t = std::make_shared<Tile>();
+        } else if (t.use_count() > 1) {
+            t = std::make_shared<Tile>(*t);
+        }
+        mark(index, dirty_upload | dirty_touched);
+        return *t;
+    }
+
+    uint32_t pixel(int x, int y) const {
+        assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+        const Tile* t = tile(tile_index(x / tile_size, y / tile_size));
+        return t ? t->row(y % tile_size)[x % tile_size] : 0;
+    }
+
+    void set_pixel(int x, int y, uint32_t color) {
+        assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+        Tile& t = mutable_tile(tile_index(x / tile_size, y / tile_size));
+        t.row(y % tile_size)[x % tile_size] = color;
+    }
+
+    // Fills [x0,x1) x [y0,y1), clipped to the canvas.
+    void fill_rect(int x0, int y0, int x1, int y1, uint32_t color) {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, m_width);
+        y1 = std::min(y1, m_height);
+        for (int ty = y0 / tile_size; ty * tile_size < y1; ty++) {
+            for (int tx = x0 / tile_size; tx * tile_size < x1; tx++) {
+                Tile& t = mutable_tile(tile_index(tx, ty));
+                int ty0 = std::max(y0 - ty * tile_size, 0);
+                int ty1 = std::min(y1 - ty * tile_size, tile_size);
+                int tx0 = std::max(x0 - tx * tile_size, 0);
+                int tx1 = std::min(x1 - tx * tile_size, tile_size);
+                for (int y = ty0; y < ty1; y++) {
+                    std::fill(t.row(y) + tx0, t.row(y) + tx1, color);
+                }
+            }
+        }
+    }
+
+    // Tiles changed since the last clear_dirty(), for re-uploading to the GPU texture.
+    const std::vector<int>& dirty_tiles() const { return m_dirty; }
+    void clear_dirty() { clear(m_dirty, dirty_upload); }
+
+    // Every tile back on the dirty list, for when the GPU copy was overwritten and has to be
+    // uploaded in full. Doesn't count as touched.
+    void mark_all_dirty() {
+        for (int i = 0; i < tile_count(); i++) mark(i, dirty_upload);
+    }
+
+    // Tiles written through mutable_tile() since the last clear_touched(). Unlike dirty_tiles()
+    // this doesn't include set_shared_tile(), so the undo history can tell strokes from undos.
+    const std::vector<int>& touched_tiles() const { return m_touched; }
+    void clear_touched() { clear(m_touched, dirty_touched); }
+
+private:
+    static constexpr uint8_t dirty_upload = 1;
+    static constexpr uint8_t dirty_touched = 2;
+
+    void mark(int index, uint8_t bits) {
+        uint8_t added = bits & ~m_dirty_flags[index];
+        if (added & dirty_upload) m_dirty.push_back(index);
+        if (added & dirty_touched) m_touched.push_back(index);
+        m_dirty_flags[index] |= bits;
+    }
+
+    void clear(std::vector<int>& list, uint8_t bit) {
+        for (int i : list) {
+            m_dirty_flags[i] &= ~bit;
+        }
+        list.clear();
+    }
+
+    int m_width;
+    int m_height;
+    int m_tiles_x;
+    int m_tiles_y;
+    std::vector<std::shared_ptr<Tile>> m_tiles;
+    std::vector<uint8_t> m_dirty_flags;
+    std::vector<int> m_dirty;
+    std::vector<int> m_touched;
+};
+
+}
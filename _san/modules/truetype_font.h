@@ -0,0 +1,473 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+
+#include "glyph_rasterizer.h"
+
+// A GlyphRasterizer that reads TrueType (glyf) fonts itself: enough of the format for Latin text
+// and the cache benchmarks, on any platform.
+//
+// Read: head, maxp, hhea, hmtx, loca, glyf (simple and composite glyphs, offsets only), cmap
+// formats 4 and 12, and kern format 0. Not read: hinting instructions, CFF outlines, GPOS/GSUB, so
+// there's no real shaping, just one glyph per character plus pair kerning.
+
+namespace text {
+
+// Big endian reads out of the file, bounds checked against the whole file; a bad offset in a table
+// throws rather than reading past the end.
+class Reader {
+public:
+    explicit Reader(const std::vector<uint8_t>& data) : m_data(data) {}
+
+    uint8_t u8(size_t at) const { check(at, 1); return m_data[at]; }
+    uint16_t u16(size_t at) const { check(at, 2); return uint16_t(m_data[at] << 8 | m_data[at + 1]); }
+    int16_t i16(size_t at) const { return int16_t(u16(at)); }
+    uint32_t u32(size_t at) const { return uint32_t(u16(at)) << 16 | u16(at + 2); }
+
+    size_t size() const { return m_data.size(); }
+
+private:
+    void check(size_t at, size_t n) const {
+        if (at + n > m_data.size() || at + n < at) {
+            throw std::runtime_error("truetype: read past the end of the font");
+        }
+    }
+
+    const std::vector<uint8_t>& m_data;
+};
+
+// One point of a glyph outline in font units, y up.
+struct OutlinePoint {
+    float x, y;
+    bool on_curve;
+};
+
+// Contours as TrueType stores them: on and off curve points, where two off curve points in a row
+// have an implied on curve point half way between them.
+struct Outline {
+    std::vector<OutlinePoint> points;
+    std::vector<uint32_t> contour_ends;     // one past each contour's last point
+    float x_min = 0, y_min = 0, x_max = 0, y_max = 0;
+};
+
+class TrueTypeFont {
+public:
+    explicit TrueTypeFont(std::vector<uint8_t> data) : m_data(std::move(data)) {
+        Reader r(m_data);
+        uint16_t tables = r.u16(4);
+        for (uint16_t i = 0; i < tables; i++) {
+            size_t record = 12 + size_t(i) * 16;
+            uint32_t offset = r.u32(record + 8);
+            if (tag_is(record, "head")) m_head = offset;
+            else if (tag_is(record, "maxp")) m_maxp = offset;
+            else if (tag_is(record, "hhea")) m_hhea = offset;
+            else if (tag_is(record, "hmtx")) m_hmtx = offset;
+            else if (tag_is(record, "loca")) m_loca = offset;
+            else if (tag_is(record, "glyf")) m_glyf = offset;
+            else if (tag_is(record, "cmap")) m_cmap = offset;
+            else if (tag_is(record, "kern")) m_kern = offset;
+        }
+        if (!m_head || !m_maxp || !m_hhea || !m_hmtx || !m_loca || !m_glyf || !m_cmap) {
+            throw std::runtime_error("truetype: not a TrueType outline font");
+        }
+        m_units_per_em = r.u16(m_head + 18);
+        m_long_loca = r.i16(m_head + 50) != 0;
+        m_glyph_count = r.u16(m_maxp + 4);
+        m_ascent = r.i16(m_hhea + 4);
+        m_descent = -r.i16(m_hhea + 6);
+        m_line_gap = r.i16(m_hhea + 8);
+        m_h_metrics = std::max<uint16_t>(r.u16(m_hhea + 34), 1);
+        if (m_units_per_em == 0) throw std::runtime_error("truetype: bad unitsPerEm");
+        find_cmap();
+        find_kern();
+    }
+
+    static TrueTypeFont load(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("truetype: can't open " + path.string());
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return TrueTypeFont(std::move(data));
+    }
+
+    uint16_t glyph_count() const { return m_glyph_count; }
+
+    // Pixels per font unit at size (the em size in pixels).
+    float scale(float size) const { return size / m_units_per_em; }
+
+    FontMetrics metrics(float size) const {
+        float s = scale(size);
+        return { m_ascent * s, m_descent * s, m_line_gap * s };
+    }
+
+    uint16_t glyph_index(char32_t c) const {
+        Reader r(m_data);
+        if (m_cmap_format == 12) {
+            uint32_t groups = r.u32(m_cmap_table + 12);
+            uint32_t lo = 0, hi = groups;
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) / 2;
+                size_t g = m_cmap_table + 16 + size_t(mid) * 12;
+                if (c < r.u32(g)) hi = mid;
+                else if (c > r.u32(g + 4)) lo = mid + 1;
+                else return uint16_t(r.u32(g + 8) + (c - r.u32(g)));
+            }
+            return 0;
+        }
+        if (m_cmap_format == 4 && c <= 0xffff) {
+            uint16_t segments = r.u16(m_cmap_table + 6) / 2;
+            size_t ends = m_cmap_table + 14;
+            size_t starts = ends + 2 * size_t(segments) + 2;
+            size_t deltas = starts + 2 * size_t(segments);
+            size_t range_offsets = deltas + 2 * size_t(segments);
+            uint32_t lo = 0, hi = segments;
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) / 2;
+                if (r.u16(ends + 2 * mid) < c) lo = mid + 1;
+                else hi = mid;
+            }
+            if (lo == segments) return 0;
+            uint16_t start = r.u16(starts + 2 * lo);
+            if (c < start) return 0;
+            uint16_t delta = r.u16(deltas + 2 * lo);
+            uint16_t range_offset = r.u16(range_offsets + 2 * lo);
+            if (range_offset == 0) return uint16_t(c + delta);
+            uint16_t g = r.u16(range_offsets + 2 * lo + range_offset + 2 * (c - start));
+            return g ? uint16_t(g + delta) : 0;
+        }
+        return 0;
+    }
+
+    // In font units.
+    int advance_units(uint16_t glyph) const {
+        Reader r(m_data);
+        uint16_t i = std::min<uint16_t>(glyph, m_h_metrics - 1);
+        return r.u16(m_hmtx + 4 * size_t(i));
+    }
+
+    int kerning_units(uint16_t left, uint16_t right) const {
+        if (!m_kern_pairs) return 0;
+        Reader r(m_data);
+        uint32_t key = uint32_t(left) << 16 | right;
+        uint32_t lo = 0, hi = m_kern_count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            size_t pair = m_kern_pairs + size_t(mid) * 6;
+            uint32_t k = r.u32(pair);
+            if (k < key) lo = mid + 1;
+            else if (k > key) hi = mid;
+            else return r.i16(pair + 4);
+        }
+        return 0;
+    }
+
+    Outline outline(uint16_t glyph) const {
+        Outline out;
+        append_outline(glyph, 0, 0, 0, out);
+        if (!out.points.empty()) {
+            auto [x0, x1] = std::minmax_element(out.points.begin(), out.points.end(),
+                                                [](auto& a, auto& b) { return a.x < b.x; });
+            auto [y0, y1] = std::minmax_element(out.points.begin(), out.points.end(),
+                                                [](auto& a, auto& b) { return a.y < b.y; });
+            out.x_min = x0->x;
+            out.x_max = x1->x;
+            out.y_min = y0->y;
+            out.y_max = y1->y;
+        }
+        return out;
+    }
+
+private:
+    bool tag_is(size_t record, const char* tag) const {
+        return record + 4 <= m_data.size() && std::memcmp(m_data.data() + record, tag, 4) == 0;
+    }
+
+    // Prefers a full Unicode table (3,10 or 0,4+) over the BMP one (3,1 or 0,3).
+    void find_cmap() {
+        Reader r(m_data);
+        uint16_t count = r.u16(m_cmap + 2);
+        int best = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            size_t record = m_cmap + 4 + size_t(i) * 8;
+            uint16_t platform = r.u16(record);
+            uint16_t encoding = r.u16(record + 2);
+            size_t table = m_cmap + r.u32(record + 4);
+            uint16_t format = r.u16(table);
+            bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+            int score = !unicode ? 0 : format == 12 ? 2 : format == 4 ? 1 : 0;
+            if (score > best) {
+                best = score;
+                m_cmap_table = table;
+                m_cmap_format = format;
+            }
+        }
+    }
+
+    // The first horizontal format 0 subtable, if there's a kern table at all.
+    void find_kern() {
+        if (!m_kern) return;
+        Reader r(m_data);
+        if (r.u16(m_kern) != 0) return;     // the old Apple version 1 header
+        uint16_t count = r.u16(m_kern + 2);
+        size_t table = m_kern + 4;
+        for (uint16_t i = 0; i < count; i++) {
+            uint16_t length = r.u16(table + 2);
+            uint16_t coverage = r.u16(table + 4);
+            if ((coverage >> 8) == 0 && (coverage & 1)) {
+                m_kern_count = r.u16(table + 6);
+                m_kern_pairs = table + 14;
+                return;
+            }
+            table += length;
+        }
+    }
+
+    std::pair<size_t, size_t> glyph_range(uint16_t glyph) const {
+        if (glyph >= m_glyph_count) return { 0, 0 };
+        Reader r(m_data);
+        if (m_long_loca) {
+            return { m_glyf + r.u32(m_loca + 4 * size_t(glyph)), m_glyf + r.u32(m_loca + 4 * size_t(glyph) + 4) };
+        }
+        return { m_glyf + 2 * size_t(r.u16(m_loca + 2 * size_t(glyph))),
+                 m_glyf + 2 * size_t(r.u16(m_loca + 2 * size_t(glyph) + 2)) };
+    }
+
+    // Composite glyphs add their components with an offset and an optional 2x2 transform. Point
+    // matched placement isn't supported; those components go at the origin.
+    void append_outline(uint16_t glyph, float dx, float dy, int depth, Outline& out,
+                        const float* m = nullptr) const {
+        auto [start, end] = glyph_range(glyph);
+        if (start >= end || depth > 8) return;
+        Reader r(m_data);
+        int16_t contours = r.i16(start);
+        if (contours >= 0) {
+            append_simple(start, uint16_t(contours), dx, dy, out, m);
+            return;
+        }
+        size_t at = start + 10;
+        for (;;) {
+            uint16_t flags = r.u16(at);
+            uint16_t component = r.u16(at + 2);
+            at += 4;
+            float ox = 0, oy = 0;
+            if (flags & 1) {        // ARG_1_AND_2_ARE_WORDS
+                if (flags & 2) { ox = r.i16(at); oy = r.i16(at + 2); }
+                at += 4;
+            } else {
+                if (flags & 2) { ox = int8_t(r.u8(at)); oy = int8_t(r.u8(at + 1)); }
+                at += 2;
+            }
+            float t[4] = { 1, 0, 0, 1 };
+            if (flags & 8) {                // WE_HAVE_A_SCALE
+                t[0] = t[3] = r.i16(at) / 16384.0f;
+                at += 2;
+            } else if (flags & 0x40) {      // WE_HAVE_AN_X_AND_Y_SCALE
+                t[0] = r.i16(at) / 16384.0f;
+                t[3] = r.i16(at + 2) / 16384.0f;
+                at += 4;
+            } else if (flags & 0x80) {      // WE_HAVE_A_TWO_BY_TWO
+                t[0] = r.i16(at) / 16384.0f;
+                t[1] = r.i16(at + 2) / 16384.0f;
+                t[2] = r.i16(at + 4) / 16384.0f;
+                t[3] = r.i16(at + 6) / 16384.0f;
+                at += 8;
+            }
+            float combined[4] = { t[0], t[1], t[2], t[3] };
+            float cx = dx + ox, cy = dy + oy;
+            if (m) {
+                combined[0] = t[0] * m[0] + t[1] * m[2];
+                combined[1] = t[0] * m[1] + t[1] * m[3];
+                combined[2] = t[2] * m[0] + t[3] * m[2];
+                combined[3] = t[2] * m[1] + t[3] * m[3];
+                cx = dx + ox * m[0] + oy * m[2];
+                cy = dy + ox * m[1] + oy * m[3];
+            }
+            append_outline(component, cx, cy, depth + 1, out, combined);
+            if (!(flags & 0x20)) break;     // MORE_COMPONENTS
+        }
+    }
+
+    void append_simple(size_t start, uint16_t contours, float dx, float dy, Outline& out, const float* m) const {
+        Reader r(m_data);
+        size_t at = start + 10;
+        if (contours == 0) return;
+        // The points are sized from the last contour end, so the ends have to go up or a contour
+        // would run past them.
+        std::vector<uint16_t> ends(contours);
+        for (uint16_t i = 0; i < contours; i++) {
+            ends[i] = r.u16(at + 2 * size_t(i));
+            if (i > 0 && ends[i] <= ends[i - 1]) throw std::runtime_error("truetype: bad contour ends");
+        }
+        at += 2 * size_t(contours);
+        size_t first = out.points.size();
+        size_t count = size_t(ends.back()) + 1;
+        at += 2 + r.u16(at);    // skip the instructions
+
+        std::vector<uint8_t> flags(count);
+        for (size_t i = 0; i < count;) {
+            uint8_t f = r.u8(at++);
+            size_t repeat = (f & 8) ? r.u8(at++) : 0;
+            for (size_t k = 0; k <= repeat && i < count; k++) {
+                flags[i++] = f;
+            }
+        }
+        std::vector<int> xs(count), ys(count);
+        int v = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (flags[i] & 2) {
+                v += (flags[i] & 16) ? r.u8(at) : -int(r.u8(at));
+                at += 1;
+            } else if (!(flags[i] & 16)) {
+                v += r.i16(at);
+                at += 2;
+            }
+            xs[i] = v;
+        }
+        v = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (flags[i] & 4) {
+                v += (flags[i] & 32) ? r.u8(at) : -int(r.u8(at));
+                at += 1;
+            } else if (!(flags[i] & 32)) {
+                v += r.i16(at);
+                at += 2;
+            }
+            ys[i] = v;
+        }
+        for (size_t i = 0; i < count; i++) {
+            float x = float(xs[i]), y = float(ys[i]);
+            if (m) {
+                float tx = x * m[0] + y * m[2];
+                float ty = x * m[1] + y * m[3];
+                x = tx;
+                y = ty;
+            }
+            out.points.push_back({ x + dx, y + dy, (flags[i] & 1) != 0 });
+        }
+        for (uint16_t end : ends) out.contour_ends.push_back(uint32_t(first + end + 1));
+    }
+
+    std::vector<uint8_t> m_data;
+    size_t m_head = 0, m_maxp = 0, m_hhea = 0, m_hmtx = 0, m_loca = 0, m_glyf = 0, m_cmap = 0, m_kern = 0;
+    size_t m_cmap_table = 0;
+    uint16_t m_cmap_format = 0;
+    size_t m_kern_pairs = 0;
+    uint16_t m_kern_count = 0;
+    uint16_t m_units_per_em = 0;
+    bool m_long_loca = false;
+    uint16_t m_glyph_count = 0;
+    int m_ascent = 0, m_descent = 0, m_line_gap = 0;
+    uint16_t m_h_metrics = 1;
+};
+
+// The fonts it's been given, by FontId in the order they were added.
+class TrueTypeRasterizer final : public GlyphRasterizer {
+public:
+    FontId add_font(TrueTypeFont font) {
+        m_fonts.push_back(std::move(font));
+        return FontId(m_fonts.size() - 1);
+    }
+
+    const TrueTypeFont& font(FontId id) const { return m_fonts.at(id); }
+
+    uint16_t glyph_index(FontId font, char32_t c) const override {
+        return m_fonts.at(font).glyph_index(c);
+    }
+
+    FontMetrics metrics(FontId font, float size) const override {
+        return m_fonts.at(font).metrics(size);
+    }
+
+    float advance(FontId font, float size, uint16_t glyph) const override {
+        const auto& f = m_fonts.at(font);
+        return f.advance_units(glyph) * f.scale(size);
+    }
+
+    float kerning(FontId font, float size, uint16_t left, uint16_t right) const override {
+        const auto& f = m_fonts.at(font);
+        return f.kerning_units(left, right) * f.scale(size);
+    }
+
+    GlyphBitmap rasterize(FontId font, float size, uint16_t glyph, float subpixel_x) const override {
+        const auto& f = m_fonts.at(font);
+        Outline outline = f.outline(glyph);
+        GlyphBitmap bitmap;
+        if (outline.points.empty()) return bitmap;
+        float s = f.scale(size);
+        // Whole pixels around the scaled outline, so nothing is clipped.
+        bitmap.left = int(std::floor(outline.x_min * s + subpixel_x));
+        bitmap.top = int(std::floor(-outline.y_max * s));
+        bitmap.width = int(std::ceil(outline.x_max * s + subpixel_x)) - bitmap.left + 1;
+        bitmap.height = int(std::ceil(-outline.y_min * s)) - bitmap.top + 1;
+        float ox = subpixel_x - bitmap.left;
+        float oy = -float(bitmap.top);
+        auto to_pixels = [&](const OutlinePoint& p) { return Point{ p.x * s + ox, oy - p.y * s }; };
+
+        CoverageRasterizer raster(bitmap.width, bitmap.height);
+        uint32_t begin = 0;
+        for (uint32_t end : outline.contour_ends) {
+            trace_contour(raster, outline.points.data() + begin, end - begin, to_pixels);
+            begin = end;
+        }
+        bitmap.coverage.resize(size_t(bitmap.width) * bitmap.height);
+        raster.accumulate(bitmap.coverage.data());
+        return bitmap;
+    }
+
+private:
+    template <class Transform>
+    static void trace_contour(CoverageRasterizer& raster, const OutlinePoint* points, uint32_t count,
+                              const Transform& to_pixels) {
+        if (count < 2) return;
+        // Start at an on curve point, or half way between two off curve ones.
+        uint32_t first = 0;
+        while (first < count && !points[first].on_curve) first++;
+        Point start;
+        uint32_t rest = count - 1;      // points after the start, before closing
+        if (first == count) {
+            Point a = to_pixels(points[0]), b = to_pixels(points[1]);
+            start = { (a.x + b.x) / 2, (a.y + b.y) / 2 };
+            first = 0;
+            rest = count;
+        } else {
+            start = to_pixels(points[first]);
+        }
+        Point pen = start;
+        bool have_control = false;
+        Point control{};
+        for (uint32_t k = 1; k <= rest + 1; k++) {
+            bool closing = k == rest + 1;
+            const OutlinePoint& op = points[(first + k) % count];
+            Point p = closing ? start : to_pixels(op);
+            bool on = closing || op.on_curve;
+            if (on) {
+                if (have_control) raster.quad(pen, control, p);
+                else raster.line(pen, p);
+                pen = p;
+                have_control = false;
+            } else if (have_control) {
+                Point mid = { (control.x + p.x) / 2, (control.y + p.y) / 2 };
+                raster.quad(pen, control, mid);
+                pen = mid;
+                control = p;
+            } else {
+                control = p;
+                have_control = true;
+            }
+        }
+    }
+
+    std::vector<TrueTypeFont> m_fonts;
+};
+
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+
+
+#include "tile_canvas.h"
+#include "lz_codec.h"
+
+// Undo/redo for a TileCanvas that only stores the tiles each stroke touched.
+//
+// Every tile the canvas shows has a "live" TileVersion here that shares the canvas's tile pointer,
+// so the next write to that tile makes the canvas copy it (see TileCanvas::mutable_tile) and the old
+// pixels stay with the version. A step is a list of (before, after) versions. The after of one step
+// is the same object as the before of the next step that touched the tile, so unchanged history is
+// shared by reference count rather than copied.
+//
+// Versions that stop being live are handed to a worker thread which LZ compresses them and drops
+// the raw tile. Undo/redo decompress at most one tile per touched tile (~16KB each), which keeps
+// them well under a frame for ordinary strokes. The worker also drops the oldest steps when the
+// history goes over its memory cap, so the UI thread never waits on it.
+
+namespace canvas {
+
+struct HistoryCounters {
+    std::atomic<size_t> bytes = 0;
+    std::atomic<size_t> compressed = 0;
+};
+
+class TileVersion {
+public:
+    TileVersion(std::shared_ptr<Tile> tile, std::shared_ptr<HistoryCounters> counters)
+        : m_raw(std::move(tile)), m_counters(std::move(counters))
+    {
+    }
+
+    ~TileVersion() {
+        std::lock_guard lock(m_mutex);
+        m_counters->bytes -= held_bytes();
+        if (!m_packed.empty()) m_counters->compressed--;
+    }
+
+    // Returns the tile, decompressing it if the worker got to it first, and marks the version
+    // live. A null result means the tile was empty.
+    std::shared_ptr<Tile> acquire() {
+        std::lock_guard lock(m_mutex);
+        size_t before = held_bytes();
+        if (!m_raw && !m_packed.empty()) {
+            m_raw = std::make_shared<Tile>();
+            [[maybe_unused]] bool ok = lz::decompress(m_packed, std::span(reinterpret_cast<uint8_t*>(m_raw->pixels.data()), tile_bytes));
+            assert(ok && "corrupt undo tile");
+            // The canvas owns the pixels again; recompressing later is cheap and in the background.
+            m_packed.clear();
+            m_packed.shrink_to_fit();
+            m_counters->compressed--;
+        }
+        m_live = true;
+        m_counters->bytes += held_bytes();
+        m_counters->bytes -= before;
+        return m_raw;
+    }
+
+    void release() {
+        std::lock_guard lock(m_mutex);
+        size_t before = held_bytes();
+        m_live = false;
+        m_counters->bytes += held_bytes();
+        m_counters->bytes -= before;
+    }
+
+    // Called from the worker thread.
+    void compress() {
+        std::lock_guard lock(m_mutex);
+        if (m_live || !m_raw) return;
+        size_t before = held_bytes();
+        if (m_packed.empty()) {
+            m_packed = lz::compress(std::span(reinterpret_cast<const uint8_t*>(m_raw->pixels.data()), tile_bytes));
+            m_packed.shrink_to_fit();
+            m_counters->compressed++;
+        }
+        m_raw = nullptr;
+        m_counters->bytes += held_bytes();
+        m_counters->bytes -= before;
+    }
+
+private:
+    // Memory this version costs on top of the canvas. A live raw tile is the canvas's own tile.
+    size_t held_bytes() const {
+        size_t n = m_packed.capacity();
+        if (m_raw && !m_live) n += tile_bytes;
+        return n;
+    }
+
+    std::mutex m_mutex;
+    std::shared_ptr<Tile> m_raw;
+    std::vector<uint8_t> m_packed;
+    bool m_live = true;
+    std::shared_ptr<HistoryCounters> m_counters;
+};
+
+struct UndoStats {
+    size_t undo_steps = 0;
+    size_t redo_steps = 0;
+    size_t bytes = 0;              // raw + compressed tiles owned by the history alone
+    size_t compressed_tiles = 0;
+};
+
+class UndoHistory {
+public:
+    // The history starts from the canvas's current content. memory_cap is in bytes; once the
+    // history holds more than that, the oldest undo steps are dropped.
+    explicit UndoHistory(TileCanvas& canvas, size_t memory_cap = 256 * 1024 * 1024)
+        : m_canvas(canvas), m_memory_cap(memory_cap),
+          m_counters(std::make_shared<HistoryCounters>()),
+          m_live(canvas.tile_count())
+    {
+        for (int i = 0; i < canvas.tile_count(); i++) {
+            if (canvas.tile(i)) {
+                m_live[i] = make_version(canvas.shared_tile(i));
+            }
+        }
+        canvas.clear_touched();
+        m_worker = std::jthread([this](std::stop_token st) { worker_loop(st); });
+    }
+
+    UndoHistory(const UndoHistory&) = delete;
+    UndoHistory& operator=(const UndoHistory&) = delete;
+
+    ~UndoHistory() {
+        {
+            std::lock_guard lock(m_queue_mutex);
+            m_worker.request_stop();
+        }
+        m_queue_cv.notify_all();
+    }
+
+    // Records everything drawn since the last commit as one undoable step.
+    void commit_stroke() {
+        const auto& touched = m_canvas.touched_tiles();
+        if (touched.empty()) return;
+
+        Step step;
+        step.changes.reserve(touched.size());
+        for (int index : touched) {
+            auto before = std::move(m_live[index]);
+            auto after = make_version(m_canvas.shared_tile(index));
+            if (before) retire(before);
+            m_live[index] = after;
+            step.changes.push_back({ index, std::move(before), std::move(after) });
+        }
+        m_canvas.clear_touched();
+
+        {
+            std::lock_guard lock(m_undo_mutex);
+            m_undo.push_back(std::move(step));
+        }
+        m_redo.clear();
+        enforce_cap();
+    }
+
+    bool can_undo() const {
+        std::lock_guard lock(m_undo_mutex);
+        return !m_undo.empty();
+    }
+
+    bool can_redo() const { return !m_redo.empty(); }
+
+    bool undo() {
+        Step step;
+        {
+            std::lock_guard lock(m_undo_mutex);
+            if (m_undo.empty()) return false;
+            step = std::move(m_undo.back());
+            m_undo.pop_back();
+        }
+        // Uncommitted drawing is thrown away by the undo, like most paint programs.
+        discard_uncommitted();
+        for (auto& c : step.changes) {
+            switch_to(c.index, c.before);
+        }
+        m_redo.push_back(std::move(step));
+        return true;
+    }
+
+    bool redo() {
+        if (m_redo.empty()) return false;
+        discard_uncommitted();
+        Step step = std::move(m_redo.back());
+        m_redo.pop_back();
+        for (auto& c : step.changes) {
+            switch_to(c.index, c.after);
+        }
+        {
+            std::lock_guard lock(m_undo_mutex);
+            m_undo.push_back(std::move(step));
+        }
+        return true;
+    }
+
+    void set_memory_cap(size_t bytes) {
+        m_memory_cap = bytes;
+        enforce_cap();
+    }
+
+    UndoStats stats() const {
+        UndoStats s;
+        {
+            std::lock_guard lock(m_undo_mutex);
+            s.undo_steps = m_undo.size();
+        }
+        s.redo_steps = m_redo.size();
+        s.bytes = m_counters->bytes;
+        s.compressed_tiles = m_counters->compressed;
+        return s;
+    }
+
+    // Blocks until the worker has compressed everything queued so far and trimmed the history to
+    // the cap. For tests and measuring; nothing else needs to wait for it.
+    void wait_idle() {
+        std::unique_lock lock(m_queue_mutex);
+        m_idle_cv.wait(lock, [this] { return m_queue.empty() && !m_busy && !m_trim; });
+    }
+
+private:
+    struct Change {
+        int index;
+        std::shared_ptr<TileVersion> before;   // null = tile was empty
+        std::shared_ptr<TileVersion> after;
+    };
+
+    struct Step {
+        std::vector<Change> changes;
+    };
+
+    std::shared_ptr<TileVersion> make_version(std::shared_ptr<Tile> tile) {
+        if (!tile) return nullptr;
+        return std::make_shared<TileVersion>(std::move(tile), m_counters);
+    }
+
+    void switch_to(int index, const std::shared_ptr<TileVersion>& v) {
+        if (m_live[index]) retire(m_live[index]);
+        m_live[index] = v;
+        m_canvas.set_shared_tile(index, v ? v->acquire() : nullptr);
+    }
+
+    void discard_uncommitted() {
+        for (int index : m_canvas.touched_tiles()) {
+            auto& v = m_live[index];
+            m_canvas.set_shared_tile(index, v ? v->acquire() : nullptr);
+        }
+        m_canvas.clear_touched();
+    }
+
+    void retire(const std::shared_ptr<TileVersion>& v) {
+        v->release();
+        {
+            std::lock_guard lock(m_queue_mutex);
+            m_queue.push_back(v);
+        }
+        m_queue_cv.notify_one();
+    }
+
+    // Compressed sizes aren't known until the worker catches up, so it's the worker that drops
+    // steps, once its queue has drained; dropping them now would throw away more than needed after
+    // a burst of strokes. The history can sit over the cap until then.
+    void enforce_cap() {
+        if (m_counters->bytes <= m_memory_cap) return;
+        {
+            std::lock_guard lock(m_queue_mutex);
+            m_trim = true;
+        }
+        m_queue_cv.notify_one();
+    }
+
+    // Called from the worker thread. The dropped steps' tiles are freed here too.
+    void trim() {
+        std::lock_guard lock(m_undo_mutex);
+        while (m_counters->bytes > m_memory_cap && !m_undo.empty()) {
+            m_undo.pop_front();
+        }
+    }
+
+    void worker_loop(std::stop_token st) {
+        std::unique_lock lock(m_queue_mutex);
+        while (!st.stop_requested()) {
+            if (m_queue.empty() && m_trim) {
+                m_trim = false;
+                m_busy = true;
+                lock.unlock();
+                trim();
+                lock.lock();
+                m_busy = false;
+                continue;
+            }
+            if (m_queue.empty()) {
+                m_idle_cv.notify_all();
+                m_queue_cv.wait(lock, [&] { return st.stop_requested() || !m_queue.empty() || m_trim; });
+                continue;
+            }
+            auto weak = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy = true;
+            lock.unlock();
+            if (auto v = weak.lock()) {
+                v->compress();
+            }
+            lock.lock();
+            m_busy = false;
+        }
+        m_idle_cv.notify_all();
+    }
+
+    TileCanvas& m_canvas;
+    std::atomic<size_t> m_memory_cap;
+    std::shared_ptr<HistoryCounters> m_counters;
+
+    // The version each canvas tile currently shows.
+    std::vector<std::shared_ptr<TileVersion>> m_live;
+    // The worker pops from the front when trimming; everything else is the UI thread's.
+    mutable std::mutex m_undo_mutex;
+    std::deque<Step> m_undo;
+    std::vector<Step> m_redo;
+
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_cv;
+    std::condition_variable m_idle_cv;
+    std::deque<std::weak_ptr<TileVersion>> m_queue;
+    bool m_busy = false;
+    bool m_trim = false;
+
+    // Declared last so it is joined before the queue it reads from goes away.
+    std::jthread m_worker;
+};
+
+}
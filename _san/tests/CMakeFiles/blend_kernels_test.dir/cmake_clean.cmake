@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/blend_kernels_test.dir/blend_kernels_test.cpp.o"
+  "CMakeFiles/blend_kernels_test.dir/blend_kernels_test.cpp.o.d"
+  "blend_kernels_test"
+  "blend_kernels_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/blend_kernels_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
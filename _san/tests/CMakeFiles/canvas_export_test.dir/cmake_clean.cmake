@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/canvas_export_test.dir/canvas_export_test.cpp.o"
+  "CMakeFiles/canvas_export_test.dir/canvas_export_test.cpp.o.d"
+  "canvas_export_test"
+  "canvas_export_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/canvas_export_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/cull_kernels_test.dir/cull_kernels_test.cpp.o"
+  "CMakeFiles/cull_kernels_test.dir/cull_kernels_test.cpp.o.d"
+  "cull_kernels_test"
+  "cull_kernels_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/cull_kernels_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/distance_field_test.dir/distance_field_test.cpp.o"
+  "CMakeFiles/distance_field_test.dir/distance_field_test.cpp.o.d"
+  "distance_field_test"
+  "distance_field_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/distance_field_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/filter_kernels_test.dir/filter_kernels_test.cpp.o"
+  "CMakeFiles/filter_kernels_test.dir/filter_kernels_test.cpp.o.d"
+  "filter_kernels_test"
+  "filter_kernels_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/filter_kernels_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/flood_fill_test.dir/flood_fill_test.cpp.o"
+  "CMakeFiles/flood_fill_test.dir/flood_fill_test.cpp.o.d"
+  "flood_fill_test"
+  "flood_fill_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/flood_fill_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
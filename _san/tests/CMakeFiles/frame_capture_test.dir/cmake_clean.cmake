@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/frame_capture_test.dir/frame_capture_test.cpp.o"
+  "CMakeFiles/frame_capture_test.dir/frame_capture_test.cpp.o.d"
+  "frame_capture_test"
+  "frame_capture_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/frame_capture_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/frame_pacing_test.dir/frame_pacing_test.cpp.o"
+  "CMakeFiles/frame_pacing_test.dir/frame_pacing_test.cpp.o.d"
+  "frame_pacing_test"
+  "frame_pacing_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/frame_pacing_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/jpeg_decoder_test.dir/jpeg_decoder_test.cpp.o"
+  "CMakeFiles/jpeg_decoder_test.dir/jpeg_decoder_test.cpp.o.d"
+  "jpeg_decoder_test"
+  "jpeg_decoder_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/jpeg_decoder_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/layer_stack_test.dir/layer_stack_test.cpp.o"
+  "CMakeFiles/layer_stack_test.dir/layer_stack_test.cpp.o.d"
+  "layer_stack_test"
+  "layer_stack_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/layer_stack_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/memory_budget_test.dir/memory_budget_test.cpp.o"
+  "CMakeFiles/memory_budget_test.dir/memory_budget_test.cpp.o.d"
+  "memory_budget_test"
+  "memory_budget_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/memory_budget_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
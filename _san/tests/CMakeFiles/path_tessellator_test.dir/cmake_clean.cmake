@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/path_tessellator_test.dir/path_tessellator_test.cpp.o"
+  "CMakeFiles/path_tessellator_test.dir/path_tessellator_test.cpp.o.d"
+  "path_tessellator_test"
+  "path_tessellator_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/path_tessellator_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
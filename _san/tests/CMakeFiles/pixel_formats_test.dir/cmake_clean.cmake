@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pixel_formats_test.dir/pixel_formats_test.cpp.o"
+  "CMakeFiles/pixel_formats_test.dir/pixel_formats_test.cpp.o.d"
+  "pixel_formats_test"
+  "pixel_formats_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/pixel_formats_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
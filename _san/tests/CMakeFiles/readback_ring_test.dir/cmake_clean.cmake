@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/readback_ring_test.dir/readback_ring_test.cpp.o"
+  "CMakeFiles/readback_ring_test.dir/readback_ring_test.cpp.o.d"
+  "readback_ring_test"
+  "readback_ring_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/readback_ring_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
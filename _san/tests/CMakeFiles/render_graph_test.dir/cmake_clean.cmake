@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/render_graph_test.dir/render_graph_test.cpp.o"
+  "CMakeFiles/render_graph_test.dir/render_graph_test.cpp.o.d"
+  "render_graph_test"
+  "render_graph_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/render_graph_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
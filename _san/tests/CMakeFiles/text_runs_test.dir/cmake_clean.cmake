@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/text_runs_test.dir/text_runs_test.cpp.o"
+  "CMakeFiles/text_runs_test.dir/text_runs_test.cpp.o.d"
+  "text_runs_test"
+  "text_runs_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/text_runs_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
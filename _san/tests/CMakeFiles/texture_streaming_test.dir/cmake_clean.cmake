@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/texture_streaming_test.dir/texture_streaming_test.cpp.o"
+  "CMakeFiles/texture_streaming_test.dir/texture_streaming_test.cpp.o.d"
+  "texture_streaming_test"
+  "texture_streaming_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/texture_streaming_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/undo_history_test.dir/undo_history_test.cpp.o"
+  "CMakeFiles/undo_history_test.dir/undo_history_test.cpp.o.d"
+  "undo_history_test"
+  "undo_history_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/undo_history_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
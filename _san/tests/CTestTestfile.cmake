@@ -0,0 +1,50 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/tests
+# Build directory: /root/repo/_san/tests
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test([=[blend_kernels]=] "/root/repo/_san/tests/blend_kernels_test")
+set_tests_properties([=[blend_kernels]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;9;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[layer_stack]=] "/root/repo/_san/tests/layer_stack_test")
+set_tests_properties([=[layer_stack]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;10;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[undo_history]=] "/root/repo/_san/tests/undo_history_test")
+set_tests_properties([=[undo_history]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;11;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[pixel_formats]=] "/root/repo/_san/tests/pixel_formats_test")
+set_tests_properties([=[pixel_formats]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;12;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[readback_ring]=] "/root/repo/_san/tests/readback_ring_test")
+set_tests_properties([=[readback_ring]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;13;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[canvas_export]=] "/root/repo/_san/tests/canvas_export_test")
+set_tests_properties([=[canvas_export]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;14;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[descriptor_allocator]=] "/root/repo/_san/tests/descriptor_allocator_test")
+set_tests_properties([=[descriptor_allocator]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;15;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[task_graph]=] "/root/repo/_san/tests/task_graph_test")
+set_tests_properties([=[task_graph]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;16;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[memory_budget]=] "/root/repo/_san/tests/memory_budget_test")
+set_tests_properties([=[memory_budget]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;17;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[frame_capture]=] "/root/repo/_san/tests/frame_capture_test")
+set_tests_properties([=[frame_capture]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;18;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[render_graph]=] "/root/repo/_san/tests/render_graph_test")
+set_tests_properties([=[render_graph]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;19;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[spatial_index]=] "/root/repo/_san/tests/spatial_index_test")
+set_tests_properties([=[spatial_index]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;20;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[cull_kernels]=] "/root/repo/_san/tests/cull_kernels_test")
+set_tests_properties([=[cull_kernels]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;21;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[filter_kernels]=] "/root/repo/_san/tests/filter_kernels_test")
+set_tests_properties([=[filter_kernels]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;22;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[flood_fill]=] "/root/repo/_san/tests/flood_fill_test")
+set_tests_properties([=[flood_fill]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;23;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[path_tessellator]=] "/root/repo/_san/tests/path_tessellator_test")
+set_tests_properties([=[path_tessellator]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;24;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[distance_field]=] "/root/repo/_san/tests/distance_field_test")
+set_tests_properties([=[distance_field]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;25;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[resample]=] "/root/repo/_san/tests/resample_test")
+set_tests_properties([=[resample]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;26;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[jpeg_decoder]=] "/root/repo/_san/tests/jpeg_decoder_test")
+set_tests_properties([=[jpeg_decoder]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;27;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[frame_pacing]=] "/root/repo/_san/tests/frame_pacing_test")
+set_tests_properties([=[frame_pacing]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;28;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[text_runs]=] "/root/repo/_san/tests/text_runs_test")
+set_tests_properties([=[text_runs]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;29;dot_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test([=[texture_streaming]=] "/root/repo/_san/tests/texture_streaming_test")
+set_tests_properties([=[texture_streaming]=] PROPERTIES  WORKING_DIRECTORY "/root/repo/tests" _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;6;add_test;/root/repo/tests/CMakeLists.txt;30;dot_test;/root/repo/tests/CMakeLists.txt;0;")
@@ -0,0 +1,81 @@
+#pragma once
+
+// Shared bits for the benchmarks: timing, percentiles and one line per result.
+//
+// Every benchmark takes --quick, which shrinks the work so ctest can run it as a smoke test; the
+// numbers only mean something without it, in a Release build.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline bool& quick_flag() {
+    static bool quick = false;
+    return quick;
+}
+
+inline void init(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--quick") == 0) quick_flag() = true;
+    }
+}
+
+inline bool quick() { return quick_flag(); }
+
+// full normally, small with --quick.
+template <typename T>
+T pick(T full, T small) {
+    return quick() ? small : full;
+}
+
+inline double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Best time of one call to fn, in seconds. Calls it until min_seconds have gone by and at least
+// min_runs times; the best run is the one least disturbed by everything else on the machine.
+template <typename Fn>
+double best_time(Fn&& fn, double min_seconds = 0.5, int min_runs = 3) {
+    if (quick()) {
+        min_seconds = 0;
+        min_runs = 1;
+    }
+    double best = 1e30;
+    double total = 0;
+    for (int runs = 0; runs < min_runs || total < min_seconds; runs++) {
+        auto start = Clock::now();
+        fn();
+        double t = seconds_since(start);
+        best = std::min(best, t);
+        total += t;
+    }
+    return best;
+}
+
+// Keeps the compiler from dropping work whose result isn't otherwise used.
+inline volatile char keep_sink;
+
+template <typename T>
+void keep(const T& value) {
+    keep_sink = *reinterpret_cast<const volatile char*>(&value);
+}
+
+// p in [0, 1]; sorts the samples.
+inline double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t i = std::min(samples.size() - 1, size_t(p * double(samples.size())));
+    return samples[i];
+}
+
+inline void header(const char* title) {
+    std::printf("%s%s\n", title, quick() ? " (quick, numbers are not meaningful)" : "");
+}
+
+}
@@ -0,0 +1,77 @@
+// GB/s per blend kernel and code path, counting the bytes of src and dst read and dst written.
+// The span is a 256x256 tile (stays in L2) and a 4096x4096 layer (goes to memory).
+
+#include "blend_kernels.h"
+#include "bench.h"
+
+#include <random>
+#include <vector>
+
+using namespace pixel;
+
+const struct {
+    BlendMode mode;
+    const char* name;
+} modes[] = { { BlendMode::source_over, "source_over" }, { BlendMode::multiply, "multiply" },
+              { BlendMode::screen, "screen" }, { BlendMode::add, "add" }, { BlendMode::erase, "erase" } };
+
+const struct {
+    simd::Level level;
+    const char* name;
+} levels[] = { { simd::Level::scalar, "scalar" }, { simd::Level::sse41, "sse4.1" }, { simd::Level::avx2, "avx2" } };
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("blend kernels, GB/s (src read + dst read + dst written)");
+    std::mt19937 rng(1);
+
+    for (size_t side : { size_t(256), bench::pick<size_t>(4096, 512) }) {
+        size_t count = side * side;
+        std::vector<uint32_t> src(count), dst(count);
+        for (auto& p : src) p = rng() | 0x80000000u;
+        for (auto& p : dst) p = rng();
+        std::vector<uint16_t> src16(4 * count), dst16(4 * count);
+        for (auto& h : src16) h = float_to_half(float(rng() % 1000) / 1000);
+        for (auto& h : dst16) h = float_to_half(float(rng() % 1000) / 1000);
+        // Blending the same dst over and over walks multiply and erase down into denormals, which
+        // are far slower than anything real layers see. So each run starts from a fresh copy, and
+        // the time of the copy alone comes off.
+        const std::vector<uint16_t> fresh16 = dst16;
+        double copy16 = bench::best_time([&] { std::copy(fresh16.begin(), fresh16.end(), dst16.begin()); });
+
+        std::printf("\n%zux%zu        ", side, side);
+        for (auto& l : levels) std::printf("%10s", l.name);
+        std::printf("\n");
+        for (auto& m : modes) {
+            for (uint8_t opacity : { uint8_t(255), uint8_t(128) }) {
+                std::printf("rgba8   %-11s %3d", m.name, opacity);
+                for (auto& l : levels) {
+                    if (simd::usable_level(l.level) != l.level) {
+                        std::printf("%10s", "-");
+                        continue;
+                    }
+                    double t = bench::best_time([&] {
+                        blend_rgba8(m.mode, dst.data(), src.data(), count, opacity, l.level);
+                    });
+                    std::printf("%10.2f", 3.0 * 4 * count / t / 1e9);
+                }
+                std::printf("\n");
+            }
+            std::printf("rgba16f %-11s    ", m.name);
+            for (auto& l : levels) {
+                if (simd::usable_level(l.level) != l.level) {
+                    std::printf("%10s", "-");
+                    continue;
+                }
+                double t = bench::best_time([&] {
+                    std::copy(fresh16.begin(), fresh16.end(), dst16.begin());
+                    blend_rgba16f(m.mode, dst16.data(), src16.data(), count, 0.75f, l.level);
+                });
+                std::printf("%10.2f", 3.0 * 8 * count / std::max(t - copy16, 1e-9) / 1e9);
+            }
+            std::printf("\n");
+        }
+        bench::keep(dst[count / 2]);
+    }
+    return 0;
+}
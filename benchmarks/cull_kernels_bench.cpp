@@ -0,0 +1,64 @@
+// The culling kernels in millions of objects a second, per code path, at a few visible fractions
+// (the compaction costs more the more there is to pack), for the bare index list and for the
+// whole argument buffer build that feeds ExecuteIndirect.
+
+#include "cull_kernels.h"
+#include "bench.h"
+
+#include <random>
+#include <vector>
+
+using namespace culling;
+
+const struct {
+    simd::Level level;
+    const char* name;
+} levels[] = { { simd::Level::scalar, "scalar" }, { simd::Level::sse41, "sse4.1" }, { simd::Level::avx2, "avx2" } };
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("cull kernels, M objects/s");
+    const size_t count = bench::pick<size_t>(1 << 20, 1 << 12);
+
+    // Objects scattered over a 1000x1000 world; the view's size sets how many are visible.
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> pos(0, 1000), size(0, 10);
+    std::vector<ObjectBounds> bounds(count);
+    std::vector<DrawArgs> args(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = pos(rng), y = pos(rng);
+        bounds[i] = { x, y, x + size(rng), y + size(rng) };
+        args[i] = { 6, uint32_t(i * 6), 0, uint32_t(i % 64) };
+    }
+    std::vector<uint32_t> visible(count);
+    std::vector<IndirectDraw> draws(count);
+
+    std::printf("%zu objects%14s", count, "");
+    for (auto& l : levels) std::printf("%10s", l.name);
+    std::printf("\n");
+    for (float side : { 10.0f, 320.0f, 700.0f, 1000.0f }) {
+        ObjectBounds view = { 0, 0, side, side };
+        uint32_t found = cull(bounds, view, visible.data(), simd::Level::scalar);
+        for (bool build_draws : { false, true }) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s, %4.1f%% visible", build_draws ? "draws" : "indices",
+                          100.0 * found / count);
+            std::printf("%-26s", name);
+            for (auto& l : levels) {
+                if (simd::usable_level(l.level) != l.level) {
+                    std::printf("%10s", "-");
+                    continue;
+                }
+                double t = bench::best_time([&] {
+                    bench::keep(build_draws ? cull_draws(bounds, args, view, draws.data(), l.level)
+                                            : cull(bounds, view, visible.data(), l.level));
+                });
+                std::printf("%10.0f", count / t / 1e6);
+            }
+            std::printf("\n");
+        }
+    }
+    bench::keep(visible[count / 2]);
+    bench::keep(draws[0]);
+    return 0;
+}
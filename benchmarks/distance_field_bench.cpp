@@ -0,0 +1,104 @@
+// The distance transform in megapixels a second at a few sizes and thread counts, against a
+// brute force one over every feature (on a grid small enough to finish); then whole 8 bit fields
+// the way they're used: a glyph's worth at a time, and one big shape.
+
+#include "distance_field.h"
+#include "bench.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace sdf;
+
+// The outline of a shape: features along a circle, like the edge pixels of a filled one.
+std::vector<float> ring_grid(int side) {
+    std::vector<float> grid(size_t(side) * side, far_away);
+    float c = side / 2.0f, r = side / 3.0f;
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            float d = std::hypot(x - c, y - c) - r;
+            if (d > -0.5f && d <= 0.5f) grid[size_t(y) * side + x] = 0;
+        }
+    }
+    return grid;
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("distance field, MP/s");
+
+    std::vector<unsigned> thread_counts = { 1, 2, 4 };
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw > 4) thread_counts.push_back(hw);
+    std::printf("%-28s", "squared_distances, threads");
+    for (unsigned t : thread_counts) std::printf("%10u", t);
+    std::printf("\n");
+    std::vector<int> nearest;
+    for (int side : { 64, 512, bench::pick(4096, 1024) }) {
+        const std::vector<float> ring = ring_grid(side);
+        std::vector<float> grid;
+        std::printf("%5dx%-22d", side, side);
+        for (unsigned threads : thread_counts) {
+            double t = bench::best_time([&] {
+                grid = ring;
+                squared_distances(grid, nearest, side, side, threads);
+            });
+            std::printf("%10.1f", double(side) * side / t / 1e6);
+        }
+        std::printf("\n");
+    }
+
+    // The obvious way: every pixel against every feature.
+    {
+        const int side = bench::pick(256, 64);
+        const std::vector<float> ring = ring_grid(side);
+        std::vector<int> features;
+        for (int i = 0; i < side * side; i++) {
+            if (ring[i] == 0) features.push_back(i);
+        }
+        std::vector<float> out(ring.size());
+        double t = bench::best_time([&] {
+            for (int y = 0; y < side; y++) {
+                for (int x = 0; x < side; x++) {
+                    float best = far_away;
+                    for (int f : features) {
+                        float dx = float(f % side - x), dy = float(f / side - y);
+                        best = std::min(best, dx * dx + dy * dy);
+                    }
+                    out[size_t(y) * side + x] = best;
+                }
+            }
+        });
+        bench::keep(out[out.size() / 2]);
+        std::printf("%5dx%-4d brute force, %5zu features%10.2f\n", side, side, features.size(),
+                    double(side) * side / t / 1e6);
+    }
+
+    // Fields from coverage: many glyph sized ones on one thread each (as a glyph cache would make
+    // them), and one large shape on every core.
+    std::printf("\n");
+    shapes::Path shape;
+    shape.rounded_rect(6, 6, 36, 52, 8).ellipse(24, 32, 10, 14);
+    std::vector<uint8_t> glyph = path_coverage(shape, 48, 64);
+    DistanceFieldOptions glyph_options;
+    glyph_options.padding = 8;
+    glyph_options.threads = 1;
+    const int glyphs = bench::pick(500, 10);
+    double t = bench::best_time([&] {
+        for (int i = 0; i < glyphs; i++) bench::keep(from_coverage(glyph.data(), 48, 64, 48, glyph_options).pixels[0]);
+    });
+    std::printf("%-28s%10.0f fields/s%10.1f MP/s\n", "from_coverage, 64x80", glyphs / t,
+                glyphs * 64.0 * 80 / t / 1e6);
+
+    const int side = bench::pick(2048, 256);
+    shapes::Path big;
+    const float s = float(side);
+    big.ellipse(s / 2, s / 2, s / 3, s / 4).rect(s / 8, s / 8, s / 5, s / 6);
+    std::vector<uint8_t> coverage = path_coverage(big, side, side);
+    t = bench::best_time([&] { bench::keep(from_coverage(coverage.data(), side, side, side).pixels[0]); });
+    char name[64];
+    std::snprintf(name, sizeof(name), "from_coverage, %dx%d", side, side);
+    std::printf("%-28s%10.1f ms%16.1f MP/s\n", name, t * 1e3, double(side) * side / t / 1e6);
+    return 0;
+}
@@ -0,0 +1,122 @@
+// The filter kernels in megapixels a second, per code path: one Gaussian pass at a few radii, box
+// passes across and down (the same at any radius), and unsharp. Then whole filters on a plain
+// 1080p image, and apply_filter over a full canvas per thread count.
+
+#include "canvas_filters.h"
+#include "bench.h"
+
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace pixel;
+
+const struct {
+    simd::Level level;
+    const char* name;
+} levels[] = { { simd::Level::scalar, "scalar" }, { simd::Level::sse41, "sse4.1" }, { simd::Level::avx2, "avx2" } };
+
+// One row per kernel: fn(level) is timed for every usable level and shown as pixels / time.
+template <typename Fn>
+void row(const char* name, double pixels, Fn fn) {
+    std::printf("%-28s", name);
+    for (auto& l : levels) {
+        if (simd::usable_level(l.level) != l.level) {
+            std::printf("%10s", "-");
+            continue;
+        }
+        double t = bench::best_time([&] { fn(l.level); });
+        std::printf("%10.0f", pixels / t / 1e6);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("filter kernels, MP/s");
+    std::mt19937 rng(1);
+
+    // Rows of a 1920 wide image with room for the widest reach around them.
+    const int width = 1920, height = bench::pick(1080, 64), pad = 3 * max_box_radius + 1;
+    const size_t pitch = size_t(width) + 2 * pad;
+    std::vector<uint32_t> src(pitch * (size_t(height) + 2 * pad));
+    for (auto& p : src) p = rng() | 0xff000000u;
+    const uint32_t* centre = src.data() + pad * pitch + pad;
+    std::vector<uint32_t> dst(size_t(width) * height), sums(4 * width);
+    const double pixels = double(width) * height;
+
+    std::printf("%dx%d%19s", width, height, "");
+    for (auto& l : levels) std::printf("%10s", l.name);
+    std::printf("\n");
+    for (float sigma : { 0.7f, 2.0f, 5.0f }) {
+        GaussianKernel k = gaussian_kernel(sigma);
+        std::vector<const uint32_t*> taps(k.tap_count());
+        char name[64];
+        std::snprintf(name, sizeof(name), "gaussian pass, radius %d", k.radius);
+        row(name, pixels, [&](simd::Level level) {
+            for (int y = 0; y < height; y++) {
+                for (int t = 0; t < k.tap_count(); t++) taps[t] = centre + y * pitch + t - k.radius;
+                convolve_rgba8(dst.data() + size_t(y) * width, taps.data(), k.weights.data(), k.tap_count(), width,
+                               level);
+            }
+        });
+    }
+    for (int radius : { 2, 16, max_box_radius }) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "box rows, radius %d", radius);
+        row(name, pixels, [&](simd::Level level) {
+            box_rows_rgba8(dst.data(), width, centre, pitch, width, height, radius, level);
+        });
+        std::snprintf(name, sizeof(name), "box columns, radius %d", radius);
+        row(name, pixels, [&](simd::Level level) {
+            box_columns_rgba8(dst.data(), width, centre, pitch, width, height, radius, sums.data(), level);
+        });
+    }
+    row("unsharp", pixels, [&](simd::Level level) {
+        for (int y = 0; y < height; y++) {
+            uint32_t* d = dst.data() + size_t(y) * width;
+            unsharp_rgba8(d, centre + y * pitch, d, width, 384, level);
+        }
+    });
+
+    // Whole filters: both blur passes (and the rest), still on one thread.
+    std::vector<canvas::Filter> filters(5);
+    const char* names[] = { "blur sigma 2", "blur sigma 5", "blur sigma 20 (boxes)", "sharpen sigma 2",
+                            "drop shadow sigma 3" };
+    filters[1].sigma = 5.0f;
+    filters[2].sigma = 20.0f;
+    filters[3].kind = canvas::FilterKind::sharpen;
+    filters[4].kind = canvas::FilterKind::drop_shadow;
+    filters[4].sigma = 3.0f;
+    std::printf("\n");
+    for (size_t i = 0; i < filters.size(); i++) {
+        row(names[i], pixels, [&](simd::Level level) {
+            canvas::filter_rgba8(dst.data(), width, centre, pitch, width, height, filters[i], level);
+        });
+    }
+
+    // apply_filter over a canvas with something in every tile, per thread count.
+    const int side = bench::pick(2048, 256);
+    canvas::TileCanvas canvas(side, side);
+    for (int y = 0; y < side; y += 16) canvas.fill_rect(0, y, side, y + 8, 0xff2040c0u);
+    std::printf("\napply_filter, %dx%d canvas, MP/s\n%-28s", side, side, "threads");
+    std::vector<unsigned> thread_counts = { 1, 2, 4 };
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw > 4) thread_counts.push_back(hw);
+    for (unsigned t : thread_counts) std::printf("%10u", t);
+    std::printf("\n");
+    for (size_t i : { size_t(0), size_t(2) }) {
+        std::printf("%-28s", names[i]);
+        for (unsigned threads : thread_counts) {
+            double t = bench::best_time([&] {
+                canvas::TileCanvas copy = canvas;
+                canvas::apply_filter(copy, filters[i], threads);
+                bench::keep(copy.pixel(side / 2, side / 2));
+            });
+            std::printf("%10.0f", double(side) * side / t / 1e6);
+        }
+        std::printf("\n");
+    }
+    bench::keep(dst[dst.size() / 2]);
+    return 0;
+}
@@ -0,0 +1,78 @@
+// The paint bucket on a 16k x 16k canvas, per code path: a canvas never drawn on and one painted
+// flat (both covered in whole tiles, so mostly the solid tile shortcut), and a comb maze that
+// every tile takes part of, at tolerance 0 and at a tolerance that lets it through the walls.
+
+#include "flood_fill.h"
+#include "bench.h"
+
+#include <memory>
+#include <vector>
+
+using namespace canvas;
+
+const struct {
+    simd::Level level;
+    const char* name;
+} levels[] = { { simd::Level::scalar, "scalar" }, { simd::Level::sse41, "sse4.1" }, { simd::Level::avx2, "avx2" } };
+
+// Every tile shares tile, the way big drawn areas end up.
+TileCanvas shared_canvas(int side, std::shared_ptr<Tile> tile) {
+    TileCanvas c(side, side);
+    if (tile) {
+        for (int i = 0; i < c.tile_count(); i++) c.replace_tile(i, tile);
+    }
+    return c;
+}
+
+// Walls one pixel wide every 8, open along the bottom four rows: one region winding through
+// every tile, which none of them is wholly inside.
+std::shared_ptr<Tile> comb_tile() {
+    auto t = std::make_shared<Tile>();
+    for (int y = 0; y < tile_size; y++) {
+        for (int x = 0; x < tile_size; x++) {
+            t->row(y)[x] = x % 8 == 7 && y < tile_size - 4 ? 0xff202020u : 0xffe0e0e0u;
+        }
+    }
+    return t;
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    const int side = bench::pick(16384, 1024);
+    bench::header("flood fill");
+    std::printf("%dx%d canvas, ms per fill (M pixels filled/s)\n%-22s", side, side, "");
+    for (auto& l : levels) std::printf("%20s", l.name);
+    std::printf("\n");
+
+    auto solid = std::make_shared<Tile>();
+    solid->pixels.fill(0xff808080u);
+    const struct {
+        const char* name;
+        std::shared_ptr<Tile> tile;
+        uint32_t tolerance;
+    } cases[] = {
+        { "empty", nullptr, 0 },
+        { "flat", solid, 0 },
+        { "comb maze", comb_tile(), 0 },
+        { "comb maze, tol 200", comb_tile(), 200 },
+    };
+    for (const auto& k : cases) {
+        const TileCanvas original = shared_canvas(side, k.tile);
+        std::printf("%-22s", k.name);
+        for (auto& l : levels) {
+            if (simd::usable_level(l.level) != l.level) {
+                std::printf("%20s", "-");
+                continue;
+            }
+            int64_t filled = 0;
+            double t = bench::best_time([&] {
+                TileCanvas c = original;
+                filled = flood_fill(c, 0, side - 1, 0xff0000ffu, k.tolerance, l.level);
+            }, 0.5, 2);
+            // The copy and freeing the filled tiles are in there too, as they would be for the app.
+            std::printf("%11.1f (%6.0f)", t * 1e3, double(filled) / t / 1e6);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
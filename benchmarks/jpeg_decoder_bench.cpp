@@ -0,0 +1,168 @@
+// The JPEG decoder at each scale, in milliseconds and megabytes of file a second: on kitten1b.jpg,
+// and on a 24MP (6000x4000) 4:2:0 photo-sized file, the case the reduced decodes are for.
+//
+// There's no encoder in the tree, so the big file is written here: a smooth DC gradient with a
+// dozen or so small AC coefficients per luma block and a few per chroma block, which comes out
+// about the size of a quality 90 photo. Its Huffman tables are flat (every DC code 4 bits, every
+// AC code 8) rather than fitted to the data; the decoder's table lookup treats both the same.
+
+#include "jpeg_decoder.h"
+#include "bench.h"
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using namespace image;
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void put(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            m_byte = m_byte << 1 | (value >> i & 1);
+            if (++m_count == 8) emit();
+        }
+    }
+
+    // Pads the last byte with ones, as the standard has it.
+    void flush() {
+        while (m_count) put(1, 1);
+    }
+
+private:
+    void emit() {
+        m_out.push_back(uint8_t(m_byte));
+        if (m_byte == 0xff) m_out.push_back(0);     // stuffed
+        m_byte = 0;
+        m_count = 0;
+    }
+
+    std::vector<uint8_t>& m_out;
+    uint32_t m_byte = 0;
+    int m_count = 0;
+};
+
+void put_u16(std::vector<uint8_t>& out, int value) {
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+// Bits to code v as a JPEG magnitude category, and those bits.
+int category(int v) {
+    int bits = 0;
+    for (int a = std::abs(v); a; a >>= 1) bits++;
+    return bits;
+}
+
+void put_value(BitWriter& bits, int v, int size) {
+    bits.put(uint32_t(v >= 0 ? v : v + (1 << size) - 1), size);
+}
+
+std::vector<uint8_t> synthetic_jpeg(int width, int height) {
+    std::vector<uint8_t> out = { 0xff, 0xd8 };
+    // One quantization table, flat.
+    out.insert(out.end(), { 0xff, 0xdb });
+    put_u16(out, 67);
+    out.push_back(0);
+    out.insert(out.end(), 64, 4);
+    // 4:2:0, all components on table 0.
+    out.insert(out.end(), { 0xff, 0xc0 });
+    put_u16(out, 17);
+    out.push_back(8);
+    put_u16(out, height);
+    put_u16(out, width);
+    out.insert(out.end(), { 3, 1, 0x22, 0, 2, 0x11, 0, 3, 0x11, 0 });
+    // DC: categories 0 to 11, 4 bit codes, so the code is the category.
+    out.insert(out.end(), { 0xff, 0xc4 });
+    put_u16(out, 2 + 17 + 12);
+    out.push_back(0x00);
+    for (int length = 1; length <= 16; length++) out.push_back(length == 4 ? 12 : 0);
+    for (int s = 0; s < 12; s++) out.push_back(uint8_t(s));
+    // AC: end of block, sixteen zeros, then every run and size up to 10, 8 bit codes in that order.
+    std::vector<uint8_t> ac_symbols = { 0x00, 0xf0 };
+    for (int run = 0; run < 16; run++) {
+        for (int size = 1; size <= 10; size++) ac_symbols.push_back(uint8_t(run << 4 | size));
+    }
+    int ac_code[256] = {};
+    for (size_t i = 0; i < ac_symbols.size(); i++) ac_code[ac_symbols[i]] = int(i);
+    out.insert(out.end(), { 0xff, 0xc4 });
+    put_u16(out, 2 + 17 + int(ac_symbols.size()));
+    out.push_back(0x10);
+    for (int length = 1; length <= 16; length++) out.push_back(length == 8 ? uint8_t(ac_symbols.size()) : 0);
+    out.insert(out.end(), ac_symbols.begin(), ac_symbols.end());
+    out.insert(out.end(), { 0xff, 0xda });
+    put_u16(out, 12);
+    out.insert(out.end(), { 3, 1, 0x00, 2, 0x00, 3, 0x00, 0, 63, 0 });
+
+    std::mt19937 rng(1);
+    BitWriter bits(out);
+    int predictions[3] = {};
+    // dc is the block's mean level, -128 to 127; coefficients is about how many AC ones it has.
+    auto block = [&](int component, double dc, int coefficients) {
+        int quantized = int(std::lround(dc * 8 / 4));
+        int diff = quantized - predictions[component];
+        predictions[component] = quantized;
+        int size = category(diff);
+        bits.put(uint32_t(size), 4);
+        put_value(bits, diff, size);
+        int k = 0;
+        for (int i = 0; i < coefficients; i++) {
+            // Mostly low frequencies, small, either sign.
+            int next = k + 1 + int(rng() % 3);
+            if (next > 40) break;
+            int v = int(rng() % 12) + 1;
+            if (rng() % 2) v = -v;
+            int run = next - k - 1;
+            int s = category(v);
+            bits.put(uint32_t(ac_code[run << 4 | s]), 8);
+            put_value(bits, v, s);
+            k = next;
+        }
+        bits.put(uint32_t(ac_code[0x00]), 8);
+    };
+    const int mcus_x = (width + 15) / 16, mcus_y = (height + 15) / 16;
+    for (int my = 0; my < mcus_y; my++) {
+        for (int mx = 0; mx < mcus_x; mx++) {
+            double fx = double(mx) / mcus_x, fy = double(my) / mcus_y;
+            for (int i = 0; i < 4; i++) {
+                block(0, 100 * std::sin(fx * 9 + fy * 3 + i * 0.01), 8 + int(rng() % 10));
+            }
+            block(1, 60 * std::cos(fy * 7 - fx * 2), 2 + int(rng() % 3));
+            block(2, 50 * std::sin(fx * 5), 2 + int(rng() % 3));
+        }
+    }
+    bits.flush();
+    out.insert(out.end(), { 0xff, 0xd9 });
+    return out;
+}
+
+void run(const char* name, const std::vector<uint8_t>& file, int width, int height) {
+    std::printf("%s: %dx%d, %.2f MB\n", name, width, height, double(file.size()) / 1e6);
+    for (int scale = 0; scale <= 3; scale++) {
+        DecodedImage image;
+        double t = bench::best_time([&] { image = decode_jpeg(file, scale); });
+        char label[64];
+        std::snprintf(label, sizeof(label), "1/%d, %dx%d", 1 << scale, jpeg_scaled_size(width, scale),
+                      jpeg_scaled_size(height, scale));
+        std::printf("  %-22s%10.2f ms%10.1f MB/s of file%10.1f MP/s full size%8zu K pixels out\n", label, t * 1e3,
+                    double(file.size()) / t / 1e6, double(width) * height / t / 1e6, image.pixels.size() / 1000);
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("jpeg decoder");
+
+    std::ifstream in("../DrawOnTexture/kitten1b.jpg", std::ios::binary);
+    std::vector<uint8_t> kitten((std::istreambuf_iterator<char>(in)), {});
+    JpegInfo info = read_jpeg_info(kitten);
+    run("kitten1b.jpg", kitten, info.width, info.height);
+
+    const int width = bench::pick(6000, 600), height = bench::pick(4000, 400);
+    std::vector<uint8_t> photo = synthetic_jpeg(width, height);
+    run("synthetic 4:2:0", photo, width, height);
+    return 0;
+}
@@ -0,0 +1,124 @@
+// Paths per second through the tessellator, one kind of path at a time: fills of simple and self
+// intersecting shapes, with and without the antialiasing fringe, and strokes with each join;
+// then tessellate() over a big mixed batch per thread count.
+
+#include "path_tessellator.h"
+#include "bench.h"
+
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace shapes;
+
+// A star of points spikes, every step-th corner joined, so step > 1 crosses itself.
+Path star(float cx, float cy, float radius, int points, int step) {
+    Path path;
+    for (int i = 0; i < points; i++) {
+        float a = 2 * std::numbers::pi_v<float> * float(i * step) / float(points);
+        float x = cx + radius * std::cos(a), y = cy + radius * std::sin(a);
+        if (i == 0) path.move_to(x, y);
+        else path.line_to(x, y);
+    }
+    return path.close();
+}
+
+// A freehand stroke: a wobbly run of quads, like a smoothed pen input.
+Path scribble(std::mt19937& rng, float x, float y, int segments) {
+    std::uniform_real_distribution<float> step(-12, 12);
+    Path path;
+    path.move_to(x, y);
+    for (int i = 0; i < segments; i++) {
+        float cx = x + step(rng), cy = y + step(rng);
+        x += 8 + step(rng) / 2;
+        y += step(rng);
+        path.quad_to(cx, cy, x, y);
+    }
+    return path;
+}
+
+void report(const char* name, size_t paths, double seconds, const Mesh& mesh) {
+    std::printf("%-34s%12.0f paths/s%12.1f M triangles/s%10zu triangles each\n", name, double(paths) / seconds,
+                double(mesh.indices.size()) / 3 / seconds / 1e6, mesh.indices.size() / 3 / paths);
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("path tessellator");
+    std::mt19937 rng(1);
+    const size_t count = bench::pick<size_t>(2000, 50);
+
+    struct Kind {
+        const char* name;
+        std::vector<Path> paths;
+    };
+    std::vector<Kind> kinds(5);
+    kinds[0].name = "rect";
+    kinds[1].name = "rounded rect";
+    kinds[2].name = "ellipse r 10-200";
+    kinds[3].name = "star {7/3}";       // crosses itself
+    kinds[4].name = "scribble, 40 quads";
+    for (size_t i = 0; i < count; i++) {
+        float x = float(rng() % 1000), y = float(rng() % 1000);
+        kinds[0].paths.push_back(Path().rect(x, y, 80, 40));
+        kinds[1].paths.push_back(Path().rounded_rect(x, y, 120, 60, 12));
+        float r = 10 + float(rng() % 190);
+        kinds[2].paths.push_back(Path().ellipse(x, y, r, r * 0.7f));
+        kinds[3].paths.push_back(star(x, y, 50, 7, 3));
+        kinds[4].paths.push_back(scribble(rng, x, y, 40));
+    }
+
+    const TessellateOptions options[] = { { 1, 0.25f, false }, { 1, 0.25f, true } };
+    Mesh mesh;
+    for (const Kind& k : kinds) {
+        if (k.paths.front().verbs().back() != Verb::close) continue;
+        for (const TessellateOptions& o : options) {
+            double t = bench::best_time([&] {
+                mesh.vertices.clear();
+                mesh.indices.clear();
+                for (const Path& p : k.paths) fill_path(p, 0xff000000u, FillRule::nonzero, o, mesh);
+            });
+            char name[64];
+            std::snprintf(name, sizeof(name), "fill %s%s", k.name, o.antialias ? ", aa" : "");
+            report(name, k.paths.size(), t, mesh);
+        }
+    }
+    const char* joins[] = { "miter", "round", "bevel" };
+    for (size_t i : { size_t(1), size_t(4) }) {
+        const Kind& k = kinds[i];
+        for (int j = 0; j < 3; j++) {
+            Stroke stroke = { 6, LineJoin(j), LineCap::round, 4 };
+            double t = bench::best_time([&] {
+                mesh.vertices.clear();
+                mesh.indices.clear();
+                for (const Path& p : k.paths) stroke_path(p, 0xff000000u, stroke, options[1], mesh);
+            });
+            char name[64];
+            std::snprintf(name, sizeof(name), "stroke %s, %s", k.name, joins[j]);
+            report(name, k.paths.size(), t, mesh);
+        }
+    }
+
+    // Everything at once, filled and stroked, per thread count.
+    std::vector<ShapeDraw> draws;
+    for (const Kind& k : kinds) {
+        for (const Path& p : k.paths) {
+            ShapeDraw d = { &p, 0xff000000u, FillRule::nonzero, std::nullopt };
+            if (p.verbs().back() != Verb::close || draws.size() % 3 == 0) d.stroke = Stroke{ 4, LineJoin::round };
+            draws.push_back(d);
+        }
+    }
+    std::vector<unsigned> thread_counts = { 1, 2, 4 };
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw > 4) thread_counts.push_back(hw);
+    std::vector<MeshRange> ranges;
+    for (unsigned threads : thread_counts) {
+        double t = bench::best_time([&] { mesh = tessellate(draws, options[1], ranges, threads); });
+        char name[64];
+        std::snprintf(name, sizeof(name), "tessellate, %u threads", threads);
+        report(name, draws.size(), t, mesh);
+    }
+    return 0;
+}
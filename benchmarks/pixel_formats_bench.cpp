@@ -0,0 +1,82 @@
+// Pixel format conversions, megapixels/s and GB/s (bytes read + written) per code path, over a
+// 4096x4096 image: cached and streaming stores, and in place where the kernel allows it.
+
+#include "pixel_formats.h"
+#include "bench.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pixel;
+
+const struct {
+    simd::Level level;
+    const char* name;
+} levels[] = { { simd::Level::scalar, "scalar" }, { simd::Level::sse41, "sse4.1" }, { simd::Level::avx2, "avx2" } };
+
+template <typename Fn>
+void row(const char* name, size_t count, size_t bytes_per_pixel, Fn fn) {
+    std::printf("%-28s", name);
+    for (auto& l : levels) {
+        for (StoreMode store : { StoreMode::cached, StoreMode::streaming }) {
+            if (simd::usable_level(l.level) != l.level) {
+                std::printf("%16s", "-");
+                continue;
+            }
+            double t = bench::best_time([&] { fn(store, l.level); });
+            std::printf("%8.0f %5.1f  ", count / t / 1e6, count * bytes_per_pixel / t / 1e9);
+        }
+    }
+    std::printf("\n");
+}
+
+template <typename Fn>
+void table_row(const char* name, size_t count, size_t bytes_per_pixel, Fn fn) {
+    double t = bench::best_time(fn);
+    std::printf("%-28s%8.0f %5.1f   (lookup tables, one path)\n", name, count / t / 1e6,
+                count * bytes_per_pixel / t / 1e9);
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("pixel formats, MP/s and GB/s");
+    const size_t side = bench::pick<size_t>(4096, 256);
+    const size_t count = side * side;
+    std::mt19937 rng(1);
+    std::vector<uint32_t> rgba(count), out(count);
+    for (auto& p : rgba) p = rng();
+    std::vector<uint16_t> half(4 * count);
+    unorm8_to_half(half.data(), rgba.data(), count);
+    std::vector<float> linear(4 * count);
+
+    std::printf("%zux%-*zu", side, 27 - int(std::to_string(side).size()), side);
+    for (auto& l : levels) std::printf("%14s  %14s  ", (l.name + std::string(" cached")).c_str(), "stream");
+    std::printf("\n");
+
+    row("swizzle rgba<->bgra", count, 8, [&](StoreMode s, simd::Level l) {
+        swizzle_rgba_bgra(out.data(), rgba.data(), count, s, l);
+    });
+    row("swizzle, in place", count, 8, [&](StoreMode s, simd::Level l) {
+        swizzle_rgba_bgra(out.data(), out.data(), count, s, l);
+    });
+    row("premultiply", count, 8, [&](StoreMode s, simd::Level l) {
+        premultiply_rgba8(out.data(), rgba.data(), count, s, l);
+    });
+    row("unpremultiply", count, 8, [&](StoreMode s, simd::Level l) {
+        unpremultiply_rgba8(out.data(), rgba.data(), count, s, l);
+    });
+    row("unorm8 -> 16f", count, 12, [&](StoreMode s, simd::Level l) {
+        unorm8_to_half(half.data(), rgba.data(), count, s, l);
+    });
+    row("16f -> unorm8", count, 12, [&](StoreMode s, simd::Level l) {
+        half_to_unorm8(out.data(), half.data(), count, s, l);
+    });
+
+    table_row("srgb8 -> linear 16f", count, 12, [&] { srgb8_to_linear_half(half.data(), rgba.data(), count); });
+    table_row("linear 16f -> srgb8", count, 12, [&] { linear_half_to_srgb8(out.data(), half.data(), count); });
+    table_row("srgb8 -> linear float", count, 20, [&] { srgb8_to_linear_float(linear.data(), rgba.data(), count); });
+    table_row("linear float -> srgb8", count, 20, [&] { linear_float_to_srgb8(out.data(), linear.data(), count); });
+    bench::keep(out[count / 3]);
+    return 0;
+}
@@ -0,0 +1,162 @@
+// ReadbackRing against a fake device: a thread that plays the GPU, working through submitted
+// copies in order and signalling a fence after each frame's worth, with a few frames of latency
+// like a real queue. The "app" side records a readback of a canvas region every frame, as fast as
+// it can, and never waits.
+//
+// Reports readbacks and MB/s that make it through, how many frames had to skip their readback
+// because every slot was in flight, frames of latency from request to data, and what the ring
+// costs the app's thread per frame.
+
+#include "readback_ring.h"
+#include "bench.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace gpu;
+
+// Copies regions of a source image into slot memory, in submit order, and advances the completed
+// fence when a frame's copies are done. gpu_frame_us pads each frame, as if there were rendering
+// to do too.
+class FakeDevice {
+public:
+    FakeDevice(const std::vector<uint32_t>& image, int image_width, double gpu_frame_us)
+        : m_image(image), m_image_width(image_width), m_frame_us(gpu_frame_us) {
+        m_thread = std::thread([this] { run(); });
+    }
+
+    ~FakeDevice() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+    struct Copy {
+        uint8_t* dst;
+        ReadbackRegion region;
+        size_t row_pitch;
+    };
+
+    // A frame's copies (maybe none), done once the device signals fence.
+    void execute(std::vector<Copy> copies, uint64_t fence) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_frames.push_back({ std::move(copies), fence });
+        }
+        m_cv.notify_one();
+    }
+
+    uint64_t completed() const { return m_completed.load(std::memory_order_acquire); }
+
+    // Keeps the app from running unboundedly ahead, like a swap chain would.
+    void wait_for(uint64_t fence) const {
+        while (completed() < fence) std::this_thread::yield();
+    }
+
+private:
+    struct Frame {
+        std::vector<Copy> copies;
+        uint64_t fence;
+    };
+
+    void run() {
+        std::unique_lock lock(m_mutex);
+        for (;;) {
+            m_cv.wait(lock, [&] { return m_quit || !m_frames.empty(); });
+            if (m_frames.empty()) return;
+            Frame f = std::move(m_frames.front());
+            m_frames.pop_front();
+            lock.unlock();
+            auto start = bench::Clock::now();
+            for (const Copy& c : f.copies) {
+                for (uint32_t y = 0; y < c.region.height; y++) {
+                    const uint32_t* src = m_image.data() + size_t(c.region.y + y) * m_image_width + c.region.x;
+                    std::memcpy(c.dst + y * c.row_pitch, src, c.region.width * size_t(4));
+                }
+            }
+            while (bench::seconds_since(start) * 1e6 < m_frame_us) {}
+            m_completed.store(f.fence, std::memory_order_release);
+            lock.lock();
+        }
+    }
+
+    const std::vector<uint32_t>& m_image;
+    int m_image_width;
+    double m_frame_us;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Frame> m_frames;
+    bool m_quit = false;
+    std::atomic<uint64_t> m_completed{ 0 };
+    std::thread m_thread;
+};
+
+void run(const char* name, size_t slots, uint32_t region_w, uint32_t region_h, double gpu_frame_us, int frames) {
+    const int image_w = 4096, image_h = 4096;
+    std::vector<uint32_t> image(size_t(image_w) * image_h, 0x80808080u);
+    size_t row_pitch = (region_w * 4 + 255) & ~size_t(255);     // D3D12's 256 byte pitch alignment
+    std::vector<std::vector<uint8_t>> memory(slots, std::vector<uint8_t>(row_pitch * region_h));
+    std::vector<std::span<const uint8_t>> spans(memory.begin(), memory.end());
+
+    ReadbackRing ring(spans);
+    FakeDevice device(image, image_w, gpu_frame_us);
+    const uint64_t frames_in_flight = 3;
+    std::vector<double> ring_us;
+    std::vector<double> latency;
+    int skipped = 0, collected = 0;
+    uint64_t checksum = 0;
+
+    auto start = bench::Clock::now();
+    for (int frame = 1; frame <= frames; frame++) {
+        uint64_t fence = uint64_t(frame);
+        if (fence > frames_in_flight) device.wait_for(fence - frames_in_flight);
+
+        auto t = bench::Clock::now();
+        collected += ring.collect(device.completed(), [&](const ReadbackView& v) {
+            checksum += v.data[0];
+            latency.push_back(double(fence - v.tag));
+        });
+        uint32_t x = uint32_t(frame * 64) % (image_w - region_w), y = uint32_t(frame * 32) % (image_h - region_h);
+        ReadbackRegion region{ x, y, region_w, region_h };
+        int slot = ring.acquire(fence, region, row_pitch);
+        std::vector<FakeDevice::Copy> copies;
+        if (slot >= 0) {
+            copies.push_back({ memory[slot].data(), region, row_pitch });
+            ring.submit(slot, fence);
+        } else {
+            skipped++;
+        }
+        ring_us.push_back(bench::seconds_since(t) * 1e6);
+        device.execute(std::move(copies), fence);
+    }
+    device.wait_for(uint64_t(frames));
+    collected += ring.collect(device.completed(), [&](const ReadbackView& v) {
+        latency.push_back(double(uint64_t(frames) + 1 - v.tag));
+    });
+    double seconds = bench::seconds_since(start);
+    bench::keep(checksum);
+
+    double mb = double(collected) * region_w * region_h * 4 / 1e6;
+    std::printf("%-26s %zu slots %4ux%-4u %7.0f readbacks/s %6.0f MB/s  skipped %4.1f%%  "
+                "latency p50 %.0f p99 %.0f frames  ring p99 %.2f us\n",
+                name, slots, region_w, region_h, collected / seconds, mb / seconds, 100.0 * skipped / frames,
+                bench::percentile(latency, 0.5), bench::percentile(latency, 0.99), bench::percentile(ring_us, 0.99));
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("readback ring, fake device");
+    int frames = bench::pick(3000, 100);
+    for (size_t slots : { 1, 2, 3, 4 }) run("copy bound, 1024x1024", slots, 1024, 1024, 0, frames);
+    for (size_t slots : { 1, 2, 3, 4 }) run("2 ms GPU frames, 256x256", slots, 256, 256, 2000, frames / 4);
+    run("small regions, 64x64", 3, 64, 64, 0, frames * 4);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// What building and compiling the render graph costs each frame, and what aliasing saves: the
+// app's frame as it is, blur chains of growing length (the heap should stay flat while the
+// unaliased total grows with the chain), and random graphs of many passes.
+
+#include "render_graph.h"
+#include "bench.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace gpu;
+
+constexpr uint64_t MB = 1024 * 1024;
+
+Placement place(const TransientDesc& desc, uint32_t) {
+    uint64_t bytes = uint64_t(desc.width) * desc.height * 4;
+    return { (bytes + 65535) / 65536 * 65536, 65536 };
+}
+
+int key;
+
+// The app's frame: layer upload, blur rows/columns/copy, the scene and the screenshot copy.
+void app_frame(RenderGraph& graph) {
+    auto back = graph.import_resource("back buffer", &key, Access::present, Access::present);
+    auto depth = graph.import_resource("depth", &key, Access::depth_write, Access::depth_write);
+    auto layers = graph.import_resource("layers", &key, Access::shader_read, Access::shader_read);
+    auto readback = graph.import_resource("readback", &key, Access::copy_dst, Access::copy_dst);
+    TransientDesc desc = { 1920, 1080, 28 };
+    auto rows = graph.create_texture("blur rows", desc);
+    auto blurred = graph.create_texture("blurred", desc);
+    graph.add_pass("layer upload", [] {}).write(layers, Access::copy_dst);
+    graph.add_pass("blur rows", [] {}).read(layers, Access::compute_read).write(rows, Access::unordered);
+    graph.add_pass("blur columns", [] {}).read(rows, Access::compute_read).write(blurred, Access::unordered);
+    graph.add_pass("blur copy", [] {}).read(blurred, Access::copy_src).write(layers, Access::copy_dst);
+    graph.add_pass("scene", [] {})
+        .read(layers, Access::shader_read)
+        .write(back, Access::render_target)
+        .write(depth, Access::depth_write);
+    graph.add_pass("screenshot", [] {}).read(back, Access::copy_src).write(readback, Access::copy_dst);
+}
+
+void blur_chain(RenderGraph& graph, uint32_t length) {
+    auto layers = graph.import_resource("layers", &key, Access::shader_read, Access::shader_read);
+    ResourceHandle source = layers;
+    for (uint32_t i = 0; i < length; i++) {
+        auto blurred = graph.create_texture("blur", { 1920, 1080, 28 });
+        graph.add_pass("blur", [] {}).read(source, Access::compute_read).write(blurred, Access::unordered);
+        source = blurred;
+    }
+    graph.add_pass("copy back", [] {}).read(source, Access::copy_src).write(layers, Access::copy_dst);
+}
+
+// Each pass reads a couple of recent transients and writes a new one; a few write the back buffer.
+void random_graph(RenderGraph& graph, uint32_t passes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    auto back = graph.import_resource("back buffer", &key, Access::present, Access::present);
+    std::vector<ResourceHandle> written;
+    for (uint32_t p = 0; p < passes; p++) {
+        auto target = graph.create_texture("t", { 256u << (rng() % 3), 256u << (rng() % 3), 28 });
+        auto pass = graph.add_pass("pass", [] {});
+        for (int n = 0; n < 2 && !written.empty(); n++) {
+            size_t back_by = std::min<size_t>(written.size(), 1 + rng() % 8);
+            pass.read(written[written.size() - back_by], Access::shader_read);
+        }
+        pass.write(target, Access::render_target);
+        if (rng() % 16 == 0) pass.write(back, Access::render_target);
+        written.push_back(target);
+    }
+}
+
+template <typename Build>
+void row(const char* name, Build build) {
+    const int frames = bench::pick(200, 5);
+    GraphStats stats;
+    uint64_t heap = 0;
+    double t = bench::best_time([&] {
+        for (int i = 0; i < frames; i++) {
+            RenderGraph graph;
+            build(graph);
+            graph.compile(place);
+            graph.execute([](std::span<const Barrier> b) { bench::keep(b.size()); });
+            stats = graph.stats();
+            heap = graph.heap_size(HeapClass::targets) + graph.heap_size(HeapClass::textures);
+        }
+    });
+    double us = t / frames * 1e6;
+    std::printf("%-22s%7u%7u%7u%9u%10.1f%10.2f%10.0f%10.0f\n", name, stats.passes + stats.culled, stats.culled,
+                stats.transients, stats.barriers, us, us * 1000 / (stats.passes + stats.culled),
+                double(heap) / MB, double(stats.unaliased_bytes) / MB);
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("render graph, build + compile + execute (no-op passes)");
+    std::printf("%-22s%7s%7s%7s%9s%10s%10s%10s%10s\n", "graph", "passes", "culled", "trans", "barriers", "us/frame",
+                "ns/pass", "heap MB", "unaliased");
+    row("app frame", app_frame);
+    for (uint32_t length : { 2u, 8u, 32u, 128u, 512u }) {
+        row(("blur chain " + std::to_string(length)).c_str(), [length](RenderGraph& g) { blur_chain(g, length); });
+    }
+    for (uint32_t passes : { 64u, 256u, 1024u }) {
+        row(("random " + std::to_string(passes)).c_str(), [passes](RenderGraph& g) { random_graph(g, passes, 7); });
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// The resampler in megapixels of source a second. First the two kernels on their own, per code
+// path: the horizontal pass over float rows shrinking 6000 to 1024 wide, and the vertical pass
+// combining rows at each filter's tap count. Then the whole thing, a 24MP photo (6000x4000) down
+// to 1024x683 texture size per filter and thread count, in milliseconds, and up 2x for contrast.
+
+#include "resample.h"
+#include "bench.h"
+
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace pixel;
+
+const struct {
+    simd::Level level;
+    const char* name;
+} levels[] = { { simd::Level::scalar, "scalar" }, { simd::Level::sse41, "sse4.1" }, { simd::Level::avx2, "avx2" } };
+
+const struct {
+    ResampleFilter filter;
+    const char* name;
+} filters[] = { { ResampleFilter::box, "box" }, { ResampleFilter::mitchell, "mitchell" },
+                { ResampleFilter::lanczos3, "lanczos3" } };
+
+// One row per kernel: fn(level) is timed for every usable level and shown as pixels / time.
+template <typename Fn>
+void row(const char* name, double pixels, Fn fn) {
+    std::printf("%-30s", name);
+    for (auto& l : levels) {
+        if (simd::usable_level(l.level) != l.level) {
+            std::printf("%10s", "-");
+            continue;
+        }
+        double t = bench::best_time([&] { fn(l.level); });
+        std::printf("%10.0f", pixels / t / 1e6);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("resample, source MP/s");
+    std::mt19937 rng(1);
+
+    std::printf("%-30s", "kernels");
+    for (auto& l : levels) std::printf("%10s", l.name);
+    std::printf("\n");
+    const int src_width = 6000, dst_width = 1024;
+    const int rows_per_run = bench::pick(64, 4);
+    std::vector<float> src(size_t(src_width + 1) * 4), dst(size_t(dst_width) * 4);
+    for (auto& f : src) f = float(rng() % 1000) / 1000;
+    for (auto& f : filters) {
+        ResampleWeights columns = resample_weights(src_width, dst_width, f.filter, true);
+        char name[64];
+        std::snprintf(name, sizeof(name), "across, %s (%d taps)", f.name, columns.taps);
+        row(name, double(src_width) * rows_per_run, [&](simd::Level level) {
+            for (int r = 0; r < rows_per_run; r++) resample_row(dst.data(), src.data(), columns, level);
+            bench::keep(dst[0]);
+        });
+    }
+    // Down the rows of a 1024 wide image, so source pixels here are the taps' worth of rows.
+    std::vector<float> rows(size_t(24) * dst_width * 4);
+    for (auto& f : rows) f = float(rng() % 1000) / 1000;
+    for (auto& f : filters) {
+        ResampleWeights down = resample_weights(4000, 683, f.filter);
+        std::vector<const float*> taps(down.taps);
+        for (int t = 0; t < down.taps; t++) taps[t] = &rows[size_t(t) * dst_width * 4];
+        char name[64];
+        std::snprintf(name, sizeof(name), "down, %s (%d taps)", f.name, down.taps);
+        const int outputs = bench::pick(256, 4);
+        row(name, double(dst_width) * down.taps * outputs, [&](simd::Level level) {
+            for (int r = 0; r < outputs; r++) {
+                resample_column(dst.data(), taps.data(), down.weights.data(), down.taps, dst.size(), level);
+            }
+            bench::keep(dst[0]);
+        });
+    }
+
+    // Whole images, sRGB with alpha as load_file_texture gets them.
+    const int width = bench::pick(6000, 600), height = bench::pick(4000, 400);
+    std::vector<uint32_t> photo(size_t(width) * height);
+    for (auto& p : photo) p = rng() | 0xff000000u;
+    std::vector<unsigned> thread_counts = { 1, 2, 4 };
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw > 4) thread_counts.push_back(hw);
+    int fit_width = 0, fit_height = 0;
+    fit_within(width, height, width / 6 + 24, height / 6 + 24, fit_width, fit_height);
+    const struct {
+        int width, height;
+    } targets[] = { { fit_width, fit_height }, { 2 * width / 3, 2 * height / 3 }, { width / 4, height / 4 } };
+
+    char title[64];
+    std::snprintf(title, sizeof(title), "%dx%d to, threads", width, height);
+    std::printf("\nms (source MP/s)\n%-34s", title);
+    for (unsigned t : thread_counts) std::printf("%16u", t);
+    std::printf("\n");
+    std::vector<uint32_t> out;
+    for (auto& target : targets) {
+        out.resize(size_t(target.width) * target.height);
+        for (auto& f : filters) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "%dx%d %s", target.width, target.height, f.name);
+            std::printf("%-34s", name);
+            for (unsigned threads : thread_counts) {
+                ResampleOptions options;
+                options.filter = f.filter;
+                options.threads = threads;
+                double t = bench::best_time([&] {
+                    resample_rgba8(out.data(), target.width, target.height, target.width, photo.data(), width,
+                                   height, width, options);
+                }, 0.5, 2);
+                std::printf("%7.1f (%6.0f)", t * 1e3, double(width) * height / t / 1e6);
+            }
+            std::printf("\n");
+        }
+    }
+
+    // Up 2x, where the output is the bigger side: a thumbnail-sized image to a texture.
+    const int small_width = bench::pick(1024, 128), small_height = bench::pick(683, 96);
+    out.resize(size_t(4) * small_width * small_height);
+    std::snprintf(title, sizeof(title), "%dx%d up 2x, threads", small_width, small_height);
+    std::printf("\nms (output MP/s)\n%-34s", title);
+    for (unsigned t : thread_counts) std::printf("%16u", t);
+    std::printf("\n");
+    for (auto& f : filters) {
+        std::printf("%-34s", f.name);
+        for (unsigned threads : thread_counts) {
+            ResampleOptions options;
+            options.filter = f.filter;
+            options.threads = threads;
+            double t = bench::best_time([&] {
+                resample_rgba8(out.data(), 2 * small_width, 2 * small_height, 2 * small_width, photo.data(),
+                               small_width, small_height, width, options);
+            });
+            std::printf("%7.1f (%6.0f)", t * 1e3, 4.0 * small_width * small_height / t / 1e6);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+// The software device's throughput: clears and textured fills in MP/s at 1080p per thread count
+// and filter, many small quads in one draw (triangle setup and binning bound), and the time of a
+// whole 256x256 frame the way --software mode draws it, submit to fence.
+
+#include "software_device.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace render;
+
+// What a frame of the app looks like to the device: a target, a depth buffer, a texture and one
+// vertex/index/constants set holding quads.
+struct Scene {
+    Device& device;
+    Texture target, depth, texture;
+    Buffer vertices, indices, constants;
+    uint32_t index_count = 0;
+    std::unique_ptr<CommandList> list;
+
+    Scene(Device& d, uint32_t width, uint32_t height, const std::vector<float>& quads) : device(d) {
+        target = d.create_texture({ width, height, Format::rgba8_unorm });
+        depth = d.create_texture({ width, height, Format::d32_float });
+        std::mt19937 rng(3);
+        std::vector<uint32_t> texels(512 * 512);
+        for (auto& t : texels) t = rng() | 0xff000000u;
+        texture = d.create_texture({ 512, 512, Format::rgba8_unorm });
+        d.write_texture(texture, 0, 0, 512, 512, texels.data(), 512 * 4);
+
+        // quads holds x0, y0, x1, y1 in clip space for each quad.
+        std::vector<float> v;
+        std::vector<uint32_t> idx;
+        for (size_t q = 0; q < quads.size(); q += 4) {
+            uint32_t base = uint32_t(v.size() / 4);
+            float x0 = quads[q], y0 = quads[q + 1], x1 = quads[q + 2], y1 = quads[q + 3];
+            v.insert(v.end(), { x0, y0, 0, 0, x1, y0, 1, 0, x0, y1, 0, 1, x1, y1, 1, 1 });
+            idx.insert(idx.end(), { base, base + 1, base + 2, base + 2, base + 1, base + 3 });
+        }
+        index_count = uint32_t(idx.size());
+        vertices = d.create_buffer(v.size() * 4);
+        d.write_buffer(vertices, 0, { reinterpret_cast<const uint8_t*>(v.data()), v.size() * 4 });
+        indices = d.create_buffer(idx.size() * 4);
+        d.write_buffer(indices, 0, { reinterpret_cast<const uint8_t*>(idx.data()), idx.size() * 4 });
+        float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        constants = d.create_buffer(sizeof(identity));
+        d.write_buffer(constants, 0, { reinterpret_cast<const uint8_t*>(identity), sizeof(identity) });
+        list = d.create_command_list();
+    }
+
+    void frame(Pipeline pipeline, bool draw) {
+        const float clear[4] = { 0.1f, 0.2f, 0.3f, 1 };
+        TextureDesc desc = device.describe(target);
+        list->reset();
+        list->set_render_target(target, depth);
+        list->set_viewport({ 0, 0, float(desc.width), float(desc.height), 0, 1 });
+        list->set_scissor({ 0, 0, int32_t(desc.width), int32_t(desc.height) });
+        list->clear(target, clear);
+        list->clear_depth(depth, 1);
+        if (draw) {
+            list->set_pipeline(pipeline);
+            list->set_vertex_buffer(vertices, 16);
+            list->set_index_buffer(indices, Format::r32_uint);
+            list->set_constants(constants);
+            list->set_texture(texture);
+            list->draw_indexed(index_count);
+        }
+        device.wait(device.submit(*list));
+    }
+};
+
+// Quads of size x size pixels on a width x height target, laid out in a grid and wrapping round.
+std::vector<float> small_quads(uint32_t count, uint32_t size, uint32_t width, uint32_t height) {
+    std::vector<float> quads;
+    uint32_t per_row = width / size, rows = height / size;
+    for (uint32_t i = 0; i < count; i++) {
+        float x = float(i % per_row * size), y = float(i / per_row % rows * size);
+        quads.insert(quads.end(), { x / width * 2 - 1, 1 - y / height * 2, (x + size) / width * 2 - 1,
+                                    1 - (y + size) / height * 2 });
+    }
+    return quads;
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("software device");
+    const uint32_t width = bench::pick(1920u, 320u), height = bench::pick(1080u, 180u);
+    const double pixels = double(width) * height;
+
+    std::vector<unsigned> thread_counts = { 1, 2, 4 };
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    if (hardware > 4) thread_counts.push_back(hardware);
+
+    std::printf("%-26s", (std::to_string(width) + "x" + std::to_string(height)).c_str());
+    for (unsigned t : thread_counts) std::printf("%7u thr", t);
+    std::printf("\n");
+
+    auto row = [&](const char* name, double work, const char* unit, auto run) {
+        std::printf("%-26s", name);
+        for (unsigned t : thread_counts) {
+            SoftwareDevice device(t);
+            double seconds = run(device);
+            std::printf("%11.1f", work / seconds / 1e6);
+        }
+        std::printf("  %s\n", unit);
+    };
+
+    std::vector<float> full_screen = { -1, 1, 1, -1 };
+    row("clear color + depth", pixels, "MP/s", [&](Device& device) {
+        Scene scene(device, width, height, full_screen);
+        return bench::best_time([&] { scene.frame({}, false); });
+    });
+    for (Filter filter : { Filter::point, Filter::linear }) {
+        const char* name = filter == Filter::point ? "full screen quad, point" : "full screen quad, linear";
+        row(name, pixels, "MP/s, clears included", [&](Device& device) {
+            PipelineDesc desc;
+            desc.filter = filter;
+            Pipeline pipeline = device.create_pipeline(desc);
+            Scene scene(device, width, height, full_screen);
+            return bench::best_time([&] { scene.frame(pipeline, true); });
+        });
+    }
+
+    // Small quads: per triangle costs (vertex fetch, clipping, setup, the band loop) dominate.
+    const uint32_t count = bench::pick(20000u, 500u);
+    row("16x16 quads", count * 2.0, "M triangles/s", [&](Device& device) {
+        PipelineDesc desc;
+        desc.filter = Filter::linear;
+        Pipeline pipeline = device.create_pipeline(desc);
+        Scene scene(device, width, height, small_quads(count, 16, width, height));
+        return bench::best_time([&] { scene.frame(pipeline, true); });
+    });
+
+    // The --software mode frame: one textured quad over a 256x256 target, submit to fence.
+    std::printf("\n256x256 frame, submit to fence\n");
+    for (unsigned t : thread_counts) {
+        SoftwareDevice device(t);
+        Pipeline pipeline = device.create_pipeline({});
+        Scene scene(device, 256, 256, { -0.9f, 0.9f, 0.9f, -0.9f });
+        std::vector<double> ms;
+        for (int i = bench::pick(2000, 20); i > 0; i--) {
+            auto start = bench::Clock::now();
+            scene.frame(pipeline, true);
+            ms.push_back(bench::seconds_since(start) * 1e3);
+        }
+        double p50 = bench::percentile(ms, 0.5), p99 = bench::percentile(ms, 0.99);
+        std::printf("%3u threads   p50 %6.3f ms   p99 %6.3f ms\n", t, p50, p99);
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+// SpatialIndex over 200k strokes and sprites scattered over a big canvas: inserts, moves small
+// (inside the margin) and large, rebuild(), and rectangle, point and multi-view queries, with a
+// linear scan of the same boxes for comparison.
+
+#include "spatial_index.h"
+#include "bench.h"
+
+#include <random>
+#include <vector>
+
+using namespace spatial;
+
+std::vector<Bounds> make_items(size_t count, float world, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(0, world), size(1, 40);
+    std::vector<Bounds> items(count);
+    for (auto& b : items) {
+        float x = pos(rng), y = pos(rng);
+        // Mostly small, the odd long stroke.
+        float w = rng() % 50 == 0 ? size(rng) * 20 : size(rng), h = size(rng);
+        b = { x, y, x + w, y + h };
+    }
+    return items;
+}
+
+std::vector<Bounds> make_views(size_t count, float world, float extent, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(0, world - extent);
+    std::vector<Bounds> views(count);
+    for (auto& v : views) {
+        float x = pos(rng), y = pos(rng);
+        v = { x, y, x + extent, y + extent * 0.6f };
+    }
+    return views;
+}
+
+void report(const char* name, double ops, double seconds, const char* unit, double found = -1) {
+    std::printf("%-34s%12.0f %-12s", name, ops / seconds, unit);
+    if (found >= 0) std::printf("%10.1f found each", found);
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    const size_t count = bench::pick<size_t>(200000, 5000);
+    const float world = bench::pick(40000.0f, 6000.0f);
+    bench::header("spatial index");
+    std::printf("%zu items over %.0fx%.0f\n", count, world, world);
+
+    auto items = make_items(count, world, 1);
+    std::vector<ProxyId> proxies(count);
+    SpatialIndex index(4.0f);
+
+    double t = bench::best_time([&] {
+        index = SpatialIndex(4.0f);
+        for (size_t i = 0; i < count; i++) proxies[i] = index.insert(items[i], uint32_t(i));
+    });
+    report("insert", double(count), t, "inserts/s");
+    std::printf("%-34sheight %d, quality %.1f\n", "  after inserts", index.height(), index.quality());
+
+    t = bench::best_time([&] { index.rebuild(); });
+    report("rebuild", double(count), t, "items/s");
+    std::printf("%-34sheight %d, quality %.1f\n", "  after rebuild", index.height(), index.quality());
+
+    // Jitter inside the margin (sprites wobbling), then moves that leave it (strokes dragged).
+    std::mt19937 rng(2);
+    std::vector<float> jitter(count);
+    for (auto& j : jitter) j = float(int(rng() % 7)) - 3;
+    int sign = 1;
+    t = bench::best_time([&] {
+        sign = -sign;
+        size_t changed = 0;
+        for (size_t i = 0; i < count; i++) {
+            float d = sign * jitter[i] * 0.5f;
+            Bounds b = items[i];
+            changed += index.update(proxies[i], { b.min_x + d, b.min_y + d, b.max_x + d, b.max_y + d });
+        }
+        bench::keep(changed);
+    });
+    report("update, inside margin", double(count), t, "updates/s");
+    const size_t moved = count / 10;
+    t = bench::best_time([&] {
+        sign = -sign;
+        for (size_t i = 0; i < moved; i++) {
+            float d = sign * 60.0f;
+            Bounds b = items[i];
+            index.update(proxies[i], { b.min_x + d, b.min_y, b.max_x + d, b.max_y });
+        }
+    });
+    report("update, leaving margin", double(moved), t, "updates/s");
+    std::printf("%-34sheight %d, quality %.1f\n", "  after moves", index.height(), index.quality());
+    index.rebuild();
+
+    std::vector<uint32_t> found;
+    for (float extent : { 50.0f, 500.0f, 4000.0f }) {
+        auto views = make_views(bench::pick(2000, 50), world, extent, 3);
+        size_t total = 0;
+        t = bench::best_time([&] {
+            total = 0;
+            for (const auto& v : views) {
+                found.clear();
+                index.query(v, found);
+                total += found.size();
+            }
+        });
+        char name[64];
+        std::snprintf(name, sizeof(name), "query %.0fx%.0f", extent, extent * 0.6f);
+        report(name, double(views.size()), t, "queries/s", double(total) / views.size());
+
+        std::snprintf(name, sizeof(name), "  linear scan %.0fx%.0f", extent, extent * 0.6f);
+        size_t scan_views = std::min<size_t>(views.size(), bench::pick<size_t>(50, 5));
+        t = bench::best_time([&] {
+            size_t n = 0;
+            for (size_t v = 0; v < scan_views; v++) {
+                for (const auto& b : items) n += b.overlaps(views[v]);
+            }
+            bench::keep(n);
+        });
+        report(name, double(scan_views), t, "queries/s");
+    }
+
+    auto points = make_views(bench::pick(100000, 1000), world, 0, 4);
+    t = bench::best_time([&] {
+        size_t n = 0;
+        for (const auto& p : points) {
+            found.clear();
+            index.query_point(p.min_x, p.min_y, found);
+            n += found.size();
+        }
+        bench::keep(n);
+    });
+    report("point (hit test)", double(points.size()), t, "queries/s");
+
+    // The main view plus minimaps and capture regions, one walk against separate queries.
+    for (size_t view_count : { size_t(1), size_t(4), max_views }) {
+        auto views = make_views(view_count, world, 3000, 5);
+        std::vector<std::vector<uint32_t>> visible(view_count);
+        const int frames = bench::pick(50, 2);
+        t = bench::best_time([&] {
+            for (int f = 0; f < frames; f++) {
+                for (auto& v : visible) v.clear();
+                index.cull(views, visible);
+            }
+        });
+        double one_walk = t / frames;
+        t = bench::best_time([&] {
+            for (int f = 0; f < frames; f++) {
+                for (size_t v = 0; v < view_count; v++) {
+                    visible[v].clear();
+                    index.query(views[v], visible[v]);
+                }
+            }
+        });
+        std::printf("cull, %2zu views%20s%8.3f ms one walk, %8.3f ms separate queries\n", view_count, "",
+                    one_walk * 1e3, t / frames * 1e3);
+    }
+    return 0;
+}
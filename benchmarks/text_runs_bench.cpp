@@ -0,0 +1,178 @@
+// The text path from string to pixels: the glyph cache on misses, warm() per thread count, hits,
+// and an atlas too small for what's drawn; then shaping, the run cache, emitting quads, building
+// the vertex batch and the CPU draw.
+//
+// The glyphs come from a made-up font, rings with a stem of a width set by the glyph id, through
+// the same CoverageRasterizer the TrueType backend uses, so the numbers don't depend on which
+// fonts the machine has.
+
+#include "text_runs.h"
+#include "bench.h"
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace text;
+
+class RingFont final : public GlyphRasterizer {
+public:
+    uint16_t glyph_index(FontId, char32_t c) const override { return c < 0x20 ? 0 : uint16_t(c); }
+
+    FontMetrics metrics(FontId, float size) const override { return { 0.8f * size, 0.2f * size, 0.1f * size }; }
+
+    float advance(FontId, float size, uint16_t glyph) const override {
+        return glyph == ' ' ? 0.3f * size : (0.45f + 0.01f * float(glyph % 16)) * size;
+    }
+
+    float kerning(FontId, float size, uint16_t left, uint16_t right) const override {
+        return (left + right) % 7 == 0 ? -0.05f * size : 0.0f;
+    }
+
+    GlyphBitmap rasterize(FontId, float size, uint16_t glyph, float subpixel_x) const override {
+        GlyphBitmap bitmap;
+        if (glyph == ' ') return bitmap;
+        float w = (0.35f + 0.01f * float(glyph % 16)) * size, h = 0.55f * size;
+        bitmap.left = int(std::floor(subpixel_x));
+        bitmap.top = -int(std::ceil(h));
+        bitmap.width = int(std::ceil(w + subpixel_x)) - bitmap.left + 1;
+        bitmap.height = int(std::ceil(h)) + 1;
+        CoverageRasterizer raster(bitmap.width, bitmap.height);
+        float ox = subpixel_x - bitmap.left, cy = h / 2, cx = ox + w / 2;
+        // Outer and inner ovals in opposite directions, and the stem.
+        for (float k : { 1.0f, -0.6f }) {
+            float rx = w / 2 * std::abs(k), ry = h / 2 * std::abs(k), s = k > 0 ? 1.0f : -1.0f;
+            Point p[4] = { { cx + rx, cy }, { cx, cy + s * ry }, { cx - rx, cy }, { cx, cy - s * ry } };
+            for (int i = 0; i < 4; i++) {
+                Point q = p[(i + 1) % 4];
+                raster.quad(p[i], { p[i].x + q.x - cx, p[i].y + q.y - cy }, q);
+            }
+        }
+        float stem = 0.05f * size * float(1 + glyph % 3);
+        raster.line({ ox, 0 }, { ox, h });
+        raster.line({ ox, h }, { ox + stem, h });
+        raster.line({ ox + stem, h }, { ox + stem, 0 });
+        raster.line({ ox + stem, 0 }, { ox, 0 });
+        bitmap.coverage.resize(size_t(bitmap.width) * bitmap.height);
+        raster.accumulate(bitmap.coverage.data());
+        return bitmap;
+    }
+};
+
+// Printable ASCII at every subpixel position, in each size.
+std::vector<GlyphKey> ascii_keys(std::initializer_list<float> sizes) {
+    std::vector<GlyphKey> keys;
+    for (float size : sizes) {
+        for (uint16_t c = 0x21; c < 0x7f; c++) {
+            for (uint8_t sub = 0; sub < subpixel_steps; sub++) keys.push_back({ 0, c, uint32_t(size * 64), sub });
+        }
+    }
+    return keys;
+}
+
+void report(const char* name, double count, double seconds, const char* unit) {
+    std::printf("%-40s%12.0f %s\n", name, count / seconds, unit);
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("glyph cache and text runs");
+    RingFont font;
+
+    // --- glyph cache ---
+    auto keys = ascii_keys({ 12, 16, 24 });
+    double t = bench::best_time([&] {
+        GlyphCache cache(font, 1024, 1024);
+        for (const auto& k : keys) bench::keep(cache.get(k));
+    });
+    report("get, misses (rasterize + pack)", double(keys.size()), t, "glyphs/s");
+
+    std::vector<unsigned> thread_counts = { 1, 2, 4 };
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw > 4) thread_counts.push_back(hw);
+    for (unsigned threads : thread_counts) {
+        t = bench::best_time([&] {
+            GlyphCache cache(font, 1024, 1024);
+            cache.warm(keys, threads);
+            bench::keep(cache.size());
+        });
+        char name[64];
+        std::snprintf(name, sizeof(name), "warm, %u threads", threads);
+        report(name, double(keys.size()), t, "glyphs/s");
+    }
+
+    GlyphCache cache(font, 1024, 1024);
+    cache.warm(keys);
+    const int lookups = bench::pick(2000000, 20000);
+    t = bench::best_time([&] {
+        for (int i = 0; i < lookups; i++) bench::keep(cache.get(keys[size_t(i) * 7919 % keys.size()]));
+    });
+    report("get, hits", lookups, t, "lookups/s");
+
+    // Every frame a screenful in one of many sizes, into an atlas that holds a few of them.
+    {
+        GlyphCache small(font, 512, 512);
+        std::mt19937 rng(1);
+        const int frames = bench::pick(400, 20);
+        std::vector<GlyphKey> frame_keys;
+        auto start = bench::Clock::now();
+        size_t looked_up = 0;
+        for (int f = 0; f < frames; f++) {
+            small.begin_frame();
+            float size = float(10 + rng() % 16);
+            frame_keys = ascii_keys({ size });
+            frame_keys.resize(frame_keys.size() / 3);
+            for (const auto& k : frame_keys) bench::keep(small.get(k));
+            looked_up += frame_keys.size();
+        }
+        double seconds = bench::seconds_since(start);
+        const auto& s = small.stats();
+        report("get, 512x512 atlas, 16 sizes", double(looked_up), seconds, "glyphs/s");
+        std::printf("%-40s%11.1f%% hits, %llu shelves evicted, %llu too big\n", "",
+                    100.0 * s.hits / (s.hits + s.misses), (unsigned long long)s.evicted_shelves,
+                    (unsigned long long)s.too_big);
+    }
+
+    // --- text runs ---
+    const TextStyle style = { 0, 16 };
+    std::vector<std::string> labels;
+    for (int i = 0; i < 200; i++) labels.push_back("Layer " + std::to_string(i) + ": brush stroke, 42% opacity");
+    size_t label_glyphs = 0;
+    for (const auto& s : labels) label_glyphs += s.size();
+
+    t = bench::best_time([&] {
+        for (const auto& s : labels) bench::keep(shape(font, s, style).width);
+    });
+    report("shape", double(label_glyphs), t, "glyphs/s");
+    RunCache runs(font, 256);
+    t = bench::best_time([&] {
+        for (const auto& s : labels) bench::keep(runs.get(s, style).width);
+    });
+    report("run cache, hits", double(labels.size()), t, "runs/s");
+
+    std::vector<GlyphQuad> quads;
+    t = bench::best_time([&] {
+        quads.clear();
+        cache.begin_frame();
+        for (size_t i = 0; i < labels.size(); i++) {
+            emit_quads(cache, runs.get(labels[i], style), style, 10.25f + float(i % 4) * 0.3f, 20.0f * float(i + 1),
+                       0xff000000u, quads);
+        }
+    });
+    report("emit_quads", double(quads.size()), t, "glyphs/s");
+
+    std::vector<TextVertex> vertices;
+    std::vector<uint32_t> indices;
+    t = bench::best_time([&] {
+        vertices.clear();
+        indices.clear();
+        quad_vertices(quads, cache.atlas_width(), cache.atlas_height(), vertices, indices);
+    });
+    report("quad_vertices", double(quads.size()), t, "quads/s");
+
+    canvas::TileCanvas target(1024, 4096);
+    t = bench::best_time([&] { draw_quads(target, cache, quads); });
+    report("draw_quads (CPU)", double(quads.size()), t, "glyphs/s");
+    return 0;
+}
@@ -0,0 +1,246 @@
+// Texture streaming from disk, io_uring (or whatever make_reader() gives) against blocking reads,
+// over a corpus of mip files it writes to a temp directory first and deletes after: photo-sized
+// images made from kitten1b.jpg, resized and with a little grain so they don't compress away.
+//
+// First the readers alone: every mip of every file, coarse first, keeping depth reads in flight,
+// in MB/s and per-read latency percentiles. Then TextureStreamer the way a gallery uses it: 8x4
+// thumbnails 240 pixels across scrolling a row every 8 frames at 60 a second, in time from a
+// texture coming on screen to its first mip and to one big enough, and how long update() takes.
+// Each runs with the files in the page cache and, on Linux, with them dropped from it first.
+
+#include "texture_streaming.h"
+#include "jpeg_decoder.h"
+#include "bench.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace streaming;
+namespace fs = std::filesystem;
+
+double ms(bench::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::vector<fs::path> make_corpus(const fs::path& dir, int count, int min_side, int spread) {
+    std::ifstream in("../DrawOnTexture/kitten1b.jpg", std::ios::binary);
+    std::vector<uint8_t> jpeg((std::istreambuf_iterator<char>(in)), {});
+    image::DecodedImage kitten = image::decode_jpeg(jpeg);
+    fs::create_directories(dir);
+    std::mt19937 rng(7);
+    std::vector<fs::path> files;
+    for (int i = 0; i < count; i++) {
+        int width = min_side + int(rng() % spread), height = min_side * 2 / 3 + int(rng() % (spread * 3 / 4));
+        std::vector<uint32_t> pixels(size_t(width) * height);
+        pixel::ResampleOptions options;
+        options.filter = pixel::ResampleFilter::mitchell;
+        pixel::resample_rgba8(pixels.data(), width, height, width, kitten.pixels.data(), kitten.width,
+                              kitten.height, kitten.width, options);
+        for (auto& p : pixels) p = (p & 0xfff0f0f0u) | (rng() & 0x0f0f0f);
+        char name[32];
+        std::snprintf(name, sizeof(name), "%04d.mips", i);
+        files.push_back(dir / name);
+        write_mip_file(files.back(), pixels.data(), width, height, width);
+    }
+    return files;
+}
+
+// Off to disk and out of the page cache, so the next reads go to the device. Nothing to do it
+// with elsewhere, so only Linux has cold runs.
+bool drop_cache(const std::vector<fs::path>& files) {
+#if defined(__linux__)
+    for (const auto& f : files) {
+        int fd = ::open(f.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+    return true;
+#else
+    (void)files;
+    return false;
+#endif
+}
+
+void warm_cache(const std::vector<fs::path>& files) {
+    std::vector<char> buffer(1 << 20);
+    for (const auto& f : files) {
+        std::ifstream in(f, std::ios::binary);
+        while (in.read(buffer.data(), std::streamsize(buffer.size()))) {}
+    }
+}
+
+std::unique_ptr<AsyncReader> reader(bool async, int depth) {
+    return async ? make_reader(depth) : make_blocking_reader(depth);
+}
+
+struct Job {
+    int file;
+    uint64_t offset;
+    uint32_t size;
+};
+
+// Every mip past the head of every file, in file order: coarse first.
+std::vector<Job> all_mips(const std::vector<fs::path>& files) {
+    std::vector<Job> jobs;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::ifstream in(files[i], std::ios::binary);
+        std::vector<uint8_t> head(head_bytes);
+        in.read(reinterpret_cast<char*>(head.data()), std::streamsize(head.size()));
+        head.resize(size_t(in.gcount()));
+        for (const MipLevel& m : parse_mip_header(head).mips) {
+            if (m.offset + m.stored_size > head_bytes) jobs.push_back({ int(i), m.offset, m.stored_size });
+        }
+    }
+    return jobs;
+}
+
+void read_everything(const std::vector<fs::path>& files, const std::vector<Job>& jobs, bool async, int depth,
+                     const char* cache) {
+    std::unique_ptr<AsyncReader> r = reader(async, depth);
+    std::vector<int> fds;
+    for (const auto& f : files) fds.push_back(r->open(f));
+    uint32_t biggest = 0;
+    for (const Job& j : jobs) biggest = std::max(biggest, j.size);
+    std::vector<std::vector<uint8_t>> buffers(depth, std::vector<uint8_t>(biggest));
+    std::vector<int> free_slots;
+    for (int i = 0; i < depth; i++) free_slots.push_back(i);
+    std::vector<bench::Clock::time_point> started(depth);
+    std::vector<double> latencies;
+    std::vector<ReadDone> done;
+    uint64_t bytes = 0;
+    size_t next = 0, finished = 0;
+    auto start = bench::Clock::now();
+    while (finished < jobs.size()) {
+        while (next < jobs.size() && !free_slots.empty()) {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            const Job& j = jobs[next++];
+            ReadRequest request;
+            request.file = fds[j.file];
+            request.offset = j.offset;
+            request.size = j.size;
+            request.dest = buffers[slot].data();
+            request.tag = uint64_t(slot);
+            started[slot] = bench::Clock::now();
+            r->submit(request);
+        }
+        done.clear();
+        r->complete(done, true);
+        auto now = bench::Clock::now();
+        for (const ReadDone& d : done) {
+            latencies.push_back(ms(now - started[d.tag]));
+            bytes += uint64_t(std::max<int64_t>(d.bytes, 0));
+            free_slots.push_back(int(d.tag));
+            finished++;
+        }
+    }
+    double seconds = bench::seconds_since(start);
+    for (int fd : fds) r->close(fd);
+    std::printf("  %-9s depth %2d, %s: %7.0f MB/s, %5zu reads, latency p50 %6.2f p99 %7.2f p99.9 %7.2f max %7.2f ms\n",
+                r->name(), depth, cache, double(bytes) / seconds / 1e6, jobs.size(),
+                bench::percentile(latencies, 0.5), bench::percentile(latencies, 0.99),
+                bench::percentile(latencies, 0.999), bench::percentile(latencies, 1));
+}
+
+// Rows of 8 thumbnails, 4 on screen, one row further every 8 frames.
+void gallery(const std::vector<fs::path>& files, bool async, int depth, const char* cache) {
+    const int count = int(files.size()), rows = count / 8 - 4;
+    const bench::Clock::time_point never{};
+    std::vector<bench::Clock::time_point> seen(count), first_mip(count), big_enough(count);
+    StreamingOptions options;
+    options.budget = 256ull << 20;
+    TextureStreamer streamer(reader(async, depth), options,
+        [&](TextureId id, const StreamedMip& mip) {
+            auto now = bench::Clock::now();
+            if (first_mip[id] == never) first_mip[id] = now;
+            if (std::max(mip.width, mip.height) >= 240 && big_enough[id] == never) big_enough[id] = now;
+        },
+        [](TextureId, int) {});
+    for (const auto& f : files) streamer.add(f);
+
+    // Frames at 60 a second, with time between them for the reads to land; with --quick, a few
+    // times as fast, just so the reads do land.
+    using std::chrono::microseconds;
+    const auto frame = bench::pick<bench::Clock::duration>(microseconds(16667), microseconds(2000));
+    std::vector<double> update_ms;
+    auto tick = bench::Clock::now();
+    for (int f = 0; f < rows * 8 + 60; f++) {
+        int row = std::min(f / 8, rows);
+        auto now = bench::Clock::now();
+        for (int k = 0; k < 32; k++) {
+            TextureId id = TextureId(row * 8 + k);
+            if (seen[id] == never) seen[id] = now;
+            streamer.set_screen_size(id, 240);
+        }
+        streamer.update(false);
+        update_ms.push_back(ms(bench::Clock::now() - now));
+        tick += frame;
+        std::this_thread::sleep_until(tick);
+    }
+    std::vector<double> to_first, to_big;
+    int missing = 0;
+    for (int i = 0; i < count; i++) {
+        if (seen[i] == never) continue;
+        if (first_mip[i] == never || big_enough[i] == never) {
+            missing++;
+            continue;
+        }
+        to_first.push_back(ms(first_mip[i] - seen[i]));
+        to_big.push_back(ms(big_enough[i] - seen[i]));
+    }
+    std::printf("  %-9s depth %2d, %s: first mip p50 %6.1f p99 %6.1f ms, 240 px p50 %6.1f p99 %6.1f ms, "
+                "update() p50 %5.2f p99 %5.2f ms, %4.0f MB read, %d never got there\n",
+                async ? "async" : "blocking", depth, cache, bench::percentile(to_first, 0.5),
+                bench::percentile(to_first, 0.99), bench::percentile(to_big, 0.5), bench::percentile(to_big, 0.99),
+                bench::percentile(update_ms, 0.5), bench::percentile(update_ms, 0.99),
+                double(streamer.stats().bytes_read) / 1e6, missing);
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("texture streaming");
+    const fs::path dir = fs::temp_directory_path() / "dot_texture_streaming_bench";
+    fs::remove_all(dir);
+    const int count = bench::pick(96, 40);
+    auto start = bench::Clock::now();
+    std::vector<fs::path> files =
+        bench::quick() ? make_corpus(dir, count, 256, 128) : make_corpus(dir, count, 768, 1280);
+    uint64_t total = 0;
+    for (const auto& f : files) total += fs::file_size(f);
+    std::printf("%d mip files, %.0f MB, written in %.1f s; reading through %s\n", count, double(total) / 1e6,
+                bench::seconds_since(start), make_reader(1)->name());
+
+    std::vector<Job> jobs = all_mips(files);
+    std::vector<int> depths = { 1, 4, 16, 64 };
+    if (bench::quick()) depths = { 1, 16 };
+    std::printf("readers, every mip of every file:\n");
+    for (bool cold : { true, false }) {
+        for (int depth : depths) {
+            for (bool async : { true, false }) {
+                if (cold ? !drop_cache(files) : (warm_cache(files), false)) continue;
+                read_everything(files, jobs, async, depth, cold ? "cold" : "warm");
+            }
+        }
+    }
+    std::printf("gallery, 32 thumbnails on screen:\n");
+    for (bool cold : { true, false }) {
+        for (int depth : { 4, 32 }) {
+            for (bool async : { true, false }) {
+                if (cold ? !drop_cache(files) : (warm_cache(files), false)) continue;
+                gallery(files, async, depth, cold ? "cold" : "warm");
+            }
+        }
+    }
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Undo history memory and latency on a big canvas.
+//
+// Strokes are runs of soft round dabs over a painted background. Reports commit/undo/redo times
+// (the UI thread's cost, which has to stay well under a 16 ms frame) and what the history holds
+// once the worker has compressed it, next to keeping raw tiles and next to copying the canvas.
+
+#include "tile_canvas.h"
+#include "undo_history.h"
+#include "bench.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace canvas;
+
+// Smooth gradient with a little noise, roughly what a painted background compresses like.
+void paint_background(TileCanvas& c, std::mt19937& rng) {
+    for (int y = 0; y < c.height(); y++) {
+        for (int x = 0; x < c.width(); x++) {
+            uint32_t r = (x * 255 / c.width()) ^ (rng() & 3);
+            uint32_t g = (y * 255 / c.height()) ^ (rng() & 3);
+            c.set_pixel(x, y, 0xff000000u | (0x80u << 16) | (g << 8) | r);
+        }
+    }
+    c.clear_touched();
+}
+
+void dab(TileCanvas& c, float cx, float cy, float radius, uint32_t color) {
+    int x0 = std::max(0, int(cx - radius)), x1 = std::min(c.width() - 1, int(cx + radius));
+    int y0 = std::max(0, int(cy - radius)), y1 = std::min(c.height() - 1, int(cy + radius));
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            float d = std::hypot(x - cx, y - cy) / radius;
+            if (d < 1) c.set_pixel(x, y, d < 0.8f ? color : c.pixel(x, y) ^ 0x00202020u);
+        }
+    }
+}
+
+void stroke(TileCanvas& c, std::mt19937& rng, float length, float radius) {
+    float x = float(rng() % c.width()), y = float(rng() % c.height());
+    float angle = float(rng() % 628) / 100;
+    uint32_t color = rng() | 0xff000000u;
+    for (float t = 0; t < length; t += radius / 2) {
+        dab(c, x + std::cos(angle) * t, y + std::sin(angle) * t, radius, color);
+    }
+}
+
+struct Times {
+    std::vector<double> commit, undo, redo;
+};
+
+void report(const char* what, std::vector<double>& ms) {
+    double p50 = bench::percentile(ms, 0.5);
+    double p99 = bench::percentile(ms, 0.99);
+    std::printf("  %-7s p50 %7.3f  p99 %7.3f  max %7.3f ms\n", what, p50, p99, ms.back());
+}
+
+double mib(size_t bytes) { return double(bytes) / (1024 * 1024); }
+
+void run(const char* name, int size, int strokes, float length, float radius) {
+    std::mt19937 rng(1);
+    TileCanvas c(size, size);
+    paint_background(c, rng);
+    UndoHistory history(c, size_t(1) << 40);
+
+    Times times;
+    size_t touched = 0;
+    for (int i = 0; i < strokes; i++) {
+        stroke(c, rng, length, radius);
+        touched += c.touched_tiles().size();
+        auto start = bench::Clock::now();
+        history.commit_stroke();
+        times.commit.push_back(bench::seconds_since(start) * 1000);
+    }
+    size_t before_compression = history.stats().bytes;
+    history.wait_idle();
+    UndoStats stats = history.stats();
+
+    std::printf("\n%s: %dx%d canvas, %d strokes, %.1f tiles per stroke\n", name, size, size, strokes,
+                double(touched) / strokes);
+    std::printf("  history %.1f MB compressed (%.1f MB before the worker got to it, %zu tiles)\n",
+                mib(stats.bytes), mib(before_compression), stats.compressed_tiles);
+    std::printf("  a copy of the touched tiles per step: %.1f MB, a copy of the canvas per step: %.0f MB\n",
+                mib(touched * tile_bytes), mib(size_t(strokes) * size * size * 4));
+
+    for (int i = 0; i < strokes; i++) {
+        auto start = bench::Clock::now();
+        history.undo();
+        times.undo.push_back(bench::seconds_since(start) * 1000);
+    }
+    for (int i = 0; i < strokes; i++) {
+        auto start = bench::Clock::now();
+        history.redo();
+        times.redo.push_back(bench::seconds_since(start) * 1000);
+    }
+    report("commit", times.commit);
+    report("undo", times.undo);
+    report("redo", times.redo);
+}
+
+int main(int argc, char** argv) {
+    bench::init(argc, argv);
+    bench::header("undo history");
+    int size = bench::pick(8192, 1024);
+    run("brush strokes", size, bench::pick(200, 20), 400, 12);
+    run("wide strokes", size, bench::pick(50, 5), 3000, 60);
+    return 0;
+}
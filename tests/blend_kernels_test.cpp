@@ -0,0 +1,143 @@
+// The SSE4.1 and AVX2 blend kernels must match the scalar reference bit for bit, including the
+// scalar tails and unaligned spans; the scalar reference is checked against the blend equations.
+
+#include "blend_kernels.h"
+#include "check.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace pixel;
+
+const BlendMode modes[] = { BlendMode::source_over, BlendMode::multiply, BlendMode::screen, BlendMode::add,
+                            BlendMode::erase };
+const simd::Level levels[] = { simd::Level::sse41, simd::Level::avx2 };
+
+uint32_t premultiplied(std::mt19937& rng) {
+    uint32_t x = rng();
+    uint32_t a = x >> 24;
+    uint32_t r = (x & 0xff) % (a + 1), g = ((x >> 8) & 0xff) % (a + 1), b = ((x >> 16) & 0xff) % (a + 1);
+    return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+void rgba8_levels_match() {
+    std::mt19937 rng(1);
+    for (int iter = 0; iter < 60; iter++) {
+        // Every length up to a few AVX2 blocks, then longer ones, starting off a 32 byte boundary.
+        size_t count = iter < 40 ? size_t(iter) : 1000 + rng() % 100;
+        std::vector<uint32_t> src(count + 1), dst(count + 1);
+        for (auto& p : src) p = iter % 2 ? premultiplied(rng) : rng();
+        for (auto& p : dst) p = iter % 3 ? premultiplied(rng) : rng();
+        for (BlendMode mode : modes) {
+            for (int opacity : { 255, 128, 37, 0 }) {
+                auto expected = dst;
+                blend_rgba8(mode, expected.data() + 1, src.data() + 1, count, uint8_t(opacity), simd::Level::scalar);
+                for (simd::Level level : levels) {
+                    auto got = dst;
+                    blend_rgba8(mode, got.data() + 1, src.data() + 1, count, uint8_t(opacity), level);
+                    CHECK(got == expected);
+                }
+            }
+        }
+    }
+}
+
+void rgba16f_levels_match() {
+    std::mt19937 rng(2);
+    const uint16_t specials[] = { 0x0000, 0x8000, 0x0001, 0x03ff, 0x0400, 0x3c00, 0xbc00, 0x7bff, 0x7c00, 0xfc00,
+                                  0x7e00, 0x7d01, 0xfe00 };
+    for (int iter = 0; iter < 60; iter++) {
+        size_t count = iter < 40 ? size_t(iter) : 500 + rng() % 50;
+        std::vector<uint16_t> src(4 * (count + 1)), dst(4 * (count + 1));
+        for (auto& h : src) h = rng() % 8 ? uint16_t(rng()) : specials[rng() % std::size(specials)];
+        for (auto& h : dst) h = rng() % 8 ? uint16_t(rng()) : specials[rng() % std::size(specials)];
+        for (BlendMode mode : modes) {
+            for (float opacity : { 1.0f, 0.5f, 0.3f, 0.0f }) {
+                auto expected = dst;
+                blend_rgba16f(mode, expected.data() + 4, src.data() + 4, count, opacity, simd::Level::scalar);
+                for (simd::Level level : levels) {
+                    auto got = dst;
+                    blend_rgba16f(mode, got.data() + 4, src.data() + 4, count, opacity, level);
+                    CHECK(got == expected);
+                }
+            }
+        }
+    }
+}
+
+// Blending onto transparent black gives src * opacity / 255: every channel value and opacity, so
+// the rounded divide by 255 is checked exhaustively on every path.
+void opacity_scaling_is_exact() {
+    std::vector<uint32_t> src(256);
+    for (uint32_t v = 0; v < 256; v++) src[v] = v * 0x01010101u;
+    for (simd::Level level : { simd::Level::scalar, simd::Level::sse41, simd::Level::avx2 }) {
+        for (uint32_t opacity = 0; opacity < 256; opacity++) {
+            std::vector<uint32_t> dst(256, 0);
+            blend_rgba8(BlendMode::source_over, dst.data(), src.data(), dst.size(), uint8_t(opacity), level);
+            bool exact = true;
+            for (uint32_t v = 0; v < 256; v++) {
+                uint32_t want = uint32_t(std::lround(v * opacity / 255.0));
+                exact &= dst[v] == want * 0x01010101u;
+            }
+            CHECK(exact);
+        }
+    }
+}
+
+float channel(BlendMode mode, float s, float d, float sa, float da) {
+    switch (mode) {
+    case BlendMode::source_over: return s + d * (1 - sa);
+    case BlendMode::multiply: return s * (1 - da) + d * (1 - sa) + s * d;
+    case BlendMode::screen: return s + d - s * d;
+    case BlendMode::add: return std::min(1.0f, s + d);
+    default: return d * (1 - sa);
+    }
+}
+
+// The integer reference against the float equations: within one step of rounding per multiply.
+void rgba8_follows_equations() {
+    std::mt19937 rng(3);
+    for (BlendMode mode : modes) {
+        int worst = 0;
+        for (int i = 0; i < 20000; i++) {
+            uint32_t s = premultiplied(rng), d = premultiplied(rng), r = d;
+            blend_rgba8(mode, &r, &s, 1, 255, simd::Level::scalar);
+            for (int c = 0; c < 4; c++) {
+                float want = 255 * channel(mode, float((s >> 8 * c) & 0xff) / 255, float((d >> 8 * c) & 0xff) / 255,
+                                           float(s >> 24) / 255, float(d >> 24) / 255);
+                worst = std::max(worst, int(std::abs(float((r >> 8 * c) & 0xff) - want) + 0.5f));
+            }
+        }
+        CHECK(worst <= 2);
+    }
+}
+
+void rgba16f_follows_equations() {
+    uint16_t src[4] = { float_to_half(0.25f), float_to_half(0.5f), float_to_half(0.0f), float_to_half(0.5f) };
+    uint16_t dst[4] = { float_to_half(1.0f), float_to_half(0.0f), float_to_half(0.5f), float_to_half(1.0f) };
+    for (BlendMode mode : modes) {
+        uint16_t r[4];
+        std::memcpy(r, dst, sizeof(r));
+        blend_rgba16f(mode, r, src, 1, 1.0f, simd::Level::scalar);
+        for (int c = 0; c < 4; c++) {
+            float s = half_to_float(src[c]), d = half_to_float(dst[c]);
+            float want = channel(mode, s, d, half_to_float(src[3]), half_to_float(dst[3]));
+            if (mode == BlendMode::add) want = s + d;   // 16F doesn't clamp
+            CHECK(std::abs(half_to_float(r[c]) - want) < 1e-3f);
+        }
+    }
+}
+
+int main() {
+    std::printf("cpu supports %s\n", simd::supported_level() == simd::Level::avx2    ? "avx2"
+                                     : simd::supported_level() == simd::Level::sse41 ? "sse4.1"
+                                                                                    : "scalar only");
+    rgba8_levels_match();
+    rgba16f_levels_match();
+    opacity_scaling_is_exact();
+    rgba8_follows_equations();
+    rgba16f_follows_equations();
+    return check::result();
+}
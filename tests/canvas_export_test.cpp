@@ -0,0 +1,139 @@
+// Canvas export: a tile dump reads back bit for bit, the exporter finishes and reports every job,
+// and load_tiles() refuses damaged dumps, including ones whose header asks for far more canvas
+// than the file could hold, before allocating anything for them.
+
+#include "canvas_export.h"
+#include "check.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace canvas;
+namespace fs = std::filesystem;
+
+fs::path temp_dir() {
+    fs::path dir = fs::temp_directory_path() / "dot_canvas_export_test";
+    fs::create_directories(dir);
+    return dir;
+}
+
+std::vector<uint8_t> read_file(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+void write_file(const fs::path& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+TileCanvas some_canvas() {
+    std::mt19937 rng(3);
+    TileCanvas c(300, 170);     // partial tiles on the right and bottom, some tiles left empty
+    c.fill_rect(0, 0, 120, 60, 0xff204080u);
+    for (int i = 0; i < 500; i++) c.set_pixel(int(rng() % 300), int(rng() % 100), rng() | 0xff000000u);
+    return c;
+}
+
+void tiles_round_trip() {
+    fs::path path = temp_dir() / "round_trip.tiles";
+    TileCanvas c = some_canvas();
+    Exporter exporter;
+    exporter.save_tiles(path, c);
+    c.set_pixel(0, 0, 0);   // after the save was queued: the snapshot mustn't see it
+    exporter.wait_idle();
+    auto results = exporter.take_results();
+    CHECK(results.size() == 1 && results[0].ok);
+
+    TileCanvas back = load_tiles(path);
+    TileCanvas original = some_canvas();
+    CHECK(back.width() == 300 && back.height() == 170);
+    bool same = true;
+    for (int i = 0; i < back.tile_count(); i++) same &= (back.tile(i) == nullptr) == (original.tile(i) == nullptr);
+    for (int y = 0; y < 170; y++) {
+        for (int x = 0; x < 300; x++) same &= back.pixel(x, y) == original.pixel(x, y);
+    }
+    CHECK(same);
+    CHECK(back.dirty_tiles().empty());
+}
+
+void exporter_reports_every_job() {
+    fs::path dir = temp_dir();
+    Exporter exporter;
+    std::vector<uint32_t> pixels(64 * 32, 0x80402010u);
+    exporter.save_png(dir / "straight.png", 64, 32, pixels);
+    exporter.save_png(dir / "premultiplied.png", 64, 32, pixels, Alpha::premultiplied);
+    exporter.save_png(dir / "canvas.png", some_canvas());
+    exporter.save_tiles(dir / "no_such_dir" / "x.tiles", some_canvas());
+    exporter.wait_idle();
+    CHECK(exporter.pending() == 0);
+    auto results = exporter.take_results();
+    CHECK(results.size() == 4);
+    int ok = 0;
+    for (auto& r : results) ok += r.ok;
+    CHECK(ok == 3);
+    CHECK(!results.back().ok && !results.back().error.empty());
+    CHECK(exporter.take_results().empty());
+
+    auto png = read_file(dir / "canvas.png");
+    CHECK(png.size() > 8 && std::memcmp(png.data(), "\x89PNG", 4) == 0);
+}
+
+void rejects_damaged_dumps() {
+    fs::path dir = temp_dir();
+    fs::path good = dir / "good.tiles";
+    Exporter exporter;
+    exporter.save_tiles(good, some_canvas());
+    exporter.wait_idle();
+    const std::vector<uint8_t> bytes = read_file(good);
+    fs::path bad = dir / "bad.tiles";
+    auto rejected = [&](std::vector<uint8_t> b) {
+        write_file(bad, b);
+        try {
+            load_tiles(bad);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    auto with_u32 = [&](size_t at, uint32_t v) {
+        auto b = bytes;
+        std::memcpy(b.data() + at, &v, 4);
+        return b;
+    };
+
+    CHECK(!rejected(bytes));
+    CHECK(rejected({}));
+    CHECK(rejected(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 10)));
+    auto magic = bytes;
+    magic[0] = 'X';
+    CHECK(rejected(magic));
+    CHECK(rejected(with_u32(16, 32)));              // tile size
+    CHECK(rejected(with_u32(8, 0)));                // empty canvas
+    CHECK(rejected(with_u32(12, 0x80000000u)));     // doesn't fit an int
+    // Huge but representable sizes: the file is far too small for even the present flags, and
+    // this has to be caught before the tile table is allocated.
+    CHECK(rejected(with_u32(8, 0x7fffffffu)));
+    CHECK(rejected(with_u32(12, 1u << 20)));
+    // Bigger than written but small enough that only the pixel data runs out.
+    CHECK(rejected(with_u32(12, 400)));
+    for (size_t cut : { size_t(21), bytes.size() / 2, bytes.size() - 1 }) {
+        CHECK(rejected(std::vector<uint8_t>(bytes.begin(), bytes.begin() + cut)));
+    }
+    auto flag = bytes;
+    flag[20] = 7;   // first present flag
+    CHECK(rejected(flag));
+    CHECK_THROWS(load_tiles(dir / "missing.tiles"), std::runtime_error);
+}
+
+int main() {
+    tiles_round_trip();
+    exporter_reports_every_job();
+    rejects_damaged_dumps();
+    fs::remove_all(temp_dir());
+    return check::result();
+}
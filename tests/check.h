@@ -0,0 +1,46 @@
+#pragma once
+
+// Just enough of a test framework for the module tests: CHECK() prints and counts failures and keeps
+// going, and main() ends with "return check::result();".
+
+#include <cstdio>
+
+namespace check {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline bool report(bool ok, const char* expr, const char* file, int line) {
+    if (!ok) {
+        // Past a screenful the rest are usually the same failure again.
+        if (failures() < 20) std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+        failures()++;
+    }
+    return ok;
+}
+
+inline int result() {
+    if (failures()) {
+        std::printf("%d checks failed\n", failures());
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
+
+}
+
+#define CHECK(cond) ::check::report(static_cast<bool>(cond), #cond, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expr, type)                                                                   \
+    do {                                                                                           \
+        bool thrown_ = false;                                                                      \
+        try {                                                                                      \
+            (void)(expr);                                                                          \
+        } catch (const type&) {                                                                    \
+            thrown_ = true;                                                                        \
+        }                                                                                          \
+        ::check::report(thrown_, #expr " throws " #type, __FILE__, __LINE__);                      \
+    } while (0)
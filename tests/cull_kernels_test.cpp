@@ -0,0 +1,127 @@
+// The SSE4.1 and AVX2 cull kernels must find exactly the objects the box test does, in order, for
+// every length (so every scalar tail), with boxes touching the view's edges, inverted, infinite,
+// signed zeros and NaNs; must never write past the end of the output; and cull_draws must build
+// the same argument buffer whichever kernel is used.
+
+#include "cull_kernels.h"
+#include "check.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace culling;
+
+const simd::Level levels[] = { simd::Level::scalar, simd::Level::sse41, simd::Level::avx2 };
+
+constexpr float inf = std::numeric_limits<float>::infinity();
+constexpr float qnan = std::numeric_limits<float>::quiet_NaN();
+
+// The test as cull.hlsl writes it, one object at a time.
+std::vector<uint32_t> reference(const std::vector<ObjectBounds>& bounds, const ObjectBounds& view) {
+    std::vector<uint32_t> out;
+    for (uint32_t i = 0; i < bounds.size(); i++) {
+        const ObjectBounds& b = bounds[i];
+        if (b.min_x <= view.max_x && b.min_y <= view.max_y && view.min_x <= b.max_x && view.min_y <= b.max_y) {
+            out.push_back(i);
+        }
+    }
+    return out;
+}
+
+// Mostly ordinary boxes around the view, with the awkward ones mixed in.
+ObjectBounds random_bounds(std::mt19937& rng, const ObjectBounds& view) {
+    std::uniform_real_distribution<float> pos(-200, 200), size(0, 60);
+    float x = pos(rng), y = pos(rng);
+    ObjectBounds b = { x, y, x + size(rng), y + size(rng) };
+    switch (rng() % 16) {
+    case 0: b.max_x = view.min_x; break;                // touching, counts as visible
+    case 1: b.min_y = view.max_y; break;
+    case 2: std::swap(b.min_x, b.max_x); break;         // inverted
+    case 3: b.min_x = -inf; b.max_x = inf; break;
+    case 4: (&b.min_x)[rng() % 4] = qnan; break;
+    case 5: b = { -0.0f, -0.0f, 0.0f, 0.0f }; break;
+    case 6: b.max_x = std::nextafter(view.min_x, -inf); break;   // just outside
+    default: break;
+    }
+    return b;
+}
+
+void levels_match_reference() {
+    std::mt19937 rng(1);
+    const ObjectBounds views[] = {
+        { -50, -40, 60, 30 },
+        { 0.0f, 0.0f, 0.0f, 0.0f },              // a point, against the signed zeros
+        { -inf, -inf, inf, inf },                // everything but NaNs
+        { 1000, 1000, 1100, 1100 },              // nothing
+        { 10, 10, -10, -10 },                    // inverted view: only infinite boxes
+    };
+    bool match = true, in_bounds = true;
+    for (const ObjectBounds& view : views) {
+        for (int iter = 0; iter < 120; iter++) {
+            size_t count = iter < 80 ? size_t(iter) : 500 + rng() % 300;
+            std::vector<ObjectBounds> bounds(count);
+            for (auto& b : bounds) b = random_bounds(rng, view);
+            std::vector<uint32_t> expected = reference(bounds, view);
+            for (simd::Level level : levels) {
+                // Sized exactly, with a guard after it that the kernel mustn't touch.
+                std::vector<uint32_t> out(count + 16, 0xdeadbeef);
+                uint32_t n = cull(bounds, view, out.data(), level);
+                match &= std::vector<uint32_t>(out.begin(), out.begin() + n) == expected;
+                for (size_t i = count; i < out.size(); i++) in_bounds &= out[i] == 0xdeadbeef;
+            }
+        }
+    }
+    CHECK(match);
+    CHECK(in_bounds);
+}
+
+void all_or_nothing() {
+    for (simd::Level level : levels) {
+        std::vector<ObjectBounds> bounds(1000, ObjectBounds{ 0, 0, 1, 1 });
+        std::vector<uint32_t> out(bounds.size());
+        CHECK(cull(bounds, { -1, -1, 2, 2 }, out.data(), level) == 1000);
+        bool in_order = true;
+        for (uint32_t i = 0; i < 1000; i++) in_order &= out[i] == i;
+        CHECK(in_order);
+        CHECK(cull(bounds, { 5, 5, 6, 6 }, out.data(), level) == 0);
+        CHECK(cull(std::span<const ObjectBounds>(), { 5, 5, 6, 6 }, out.data(), level) == 0);
+    }
+}
+
+// The argument buffer: one draw per visible object, in object order across groups, with the
+// object's own arguments and one instance.
+void draws_match() {
+    std::mt19937 rng(2);
+    const ObjectBounds view = { -50, -40, 60, 30 };
+    bool match = true;
+    for (size_t count : { size_t(0), size_t(1), size_t(63), size_t(64), size_t(65), size_t(1000), size_t(4099) }) {
+        std::vector<ObjectBounds> bounds(count);
+        std::vector<DrawArgs> args(count);
+        for (size_t i = 0; i < count; i++) {
+            bounds[i] = random_bounds(rng, view);
+            args[i] = { uint32_t(6 * (1 + i % 3)), uint32_t(i * 6), int32_t(i * 4) - 100, uint32_t(i % 17) };
+        }
+        std::vector<uint32_t> expected = reference(bounds, view);
+        for (simd::Level level : levels) {
+            std::vector<IndirectDraw> out(count + 1, IndirectDraw{ 0xdeadbeef, 0, 0, 0, 0, 0 });
+            uint32_t n = cull_draws(bounds, args, view, out.data(), level);
+            match &= n == expected.size() && out[count].texture == 0xdeadbeef;
+            for (uint32_t k = 0; k < n && k < expected.size(); k++) {
+                const DrawArgs& a = args[expected[k]];
+                const IndirectDraw& d = out[k];
+                match &= d.texture == a.texture && d.index_count == a.index_count && d.instance_count == 1 &&
+                         d.start_index == a.start_index && d.base_vertex == a.base_vertex && d.start_instance == 0;
+            }
+        }
+    }
+    CHECK(match);
+}
+
+int main() {
+    levels_match_reference();
+    all_or_nothing();
+    draws_match();
+    return check::result();
+}
@@ -0,0 +1,121 @@
+// Descriptor allocators: the free list never hands out an index twice or reuses one before its
+// fence, and the ring, run against a model of which ranges each frame in flight still holds, never
+// hands out a descriptor that's still in use and never refuses a run that fits in an empty ring.
+
+#include "descriptor_allocator.h"
+#include "check.h"
+
+#include <deque>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace gpu;
+
+void free_list() {
+    DescriptorFreeList list(100, 4);
+    CHECK(list.capacity() == 4 && list.used() == 0);
+    uint32_t a = list.allocate(), b = list.allocate(), c = list.allocate(), d = list.allocate();
+    CHECK(a == 100 && b == 101 && c == 102 && d == 103);
+    CHECK(list.allocate() == invalid_descriptor);
+
+    list.free(b);
+    CHECK(list.allocate() == b);
+    list.free_after(a, 5);
+    list.free_after(c, 6);
+    list.retire(4);
+    CHECK(list.allocate() == invalid_descriptor);   // not until the fence passes
+    list.retire(5);
+    CHECK(list.used() == 3);
+    CHECK(list.allocate() == a);
+    list.retire(10);
+    CHECK(list.allocate() == c);
+    CHECK(list.used() == 4);
+}
+
+void ring_basics() {
+    DescriptorRing ring(1000, 10);
+    CHECK(ring.allocate(0) == invalid_descriptor);
+    CHECK(ring.allocate(11) == invalid_descriptor);
+    CHECK(ring.allocate(4) == 1000);
+    CHECK(ring.allocate(4) == 1004);
+    ring.end_frame(1);
+    CHECK(ring.allocate(3) == invalid_descriptor);  // 2 left at the end, and the start is frame 1's
+    CHECK(ring.allocate(2) == 1008);
+    ring.end_frame(2);
+    ring.retire(1);
+    CHECK(ring.used() == 2);
+    CHECK(ring.allocate(8) == 1000);                // wraps, the start is free again
+    ring.end_frame(3);
+
+    // Drained with head in the middle: a full-capacity run has to fit.
+    ring.retire(3);
+    CHECK(ring.used() == 0);
+    CHECK(ring.allocate(10) == 1000);
+    ring.end_frame(4);
+    ring.retire(4);
+    CHECK(ring.allocate(3) == 1000);
+    ring.end_frame(5);
+    ring.retire(5);
+    CHECK(ring.allocate(10) == 1000);
+}
+
+// Random frames of random allocations, a random number of frames in flight.
+void ring_against_model() {
+    std::mt19937 rng(11);
+    for (uint32_t capacity : { 1u, 7u, 64u, 1000u }) {
+        DescriptorRing ring(500, capacity);
+        struct Held {
+            uint64_t fence;
+            std::vector<std::pair<uint32_t, uint32_t>> ranges;   // [begin, end)
+        };
+        std::deque<Held> in_flight;
+        Held frame;
+        uint64_t fence = 0, completed = 0;
+        bool no_overlap = true, empty_never_refuses = true, in_range = true;
+
+        for (int step = 0; step < 20000; step++) {
+            uint32_t r = rng() % 10;
+            if (r < 6) {
+                uint32_t count = 1 + rng() % (rng() % 8 == 0 ? capacity : std::max(1u, capacity / 8));
+                bool empty = in_flight.empty() && frame.ranges.empty();
+                uint32_t index = ring.allocate(count);
+                if (index == invalid_descriptor) {
+                    empty_never_refuses &= !empty;
+                    continue;
+                }
+                uint32_t begin = index - 500, end = begin + count;
+                in_range &= end <= capacity;
+                auto overlaps = [&](const Held& h) {
+                    for (auto [b, e] : h.ranges) {
+                        if (begin < e && b < end) return true;
+                    }
+                    return false;
+                };
+                no_overlap &= !overlaps(frame);
+                for (const Held& h : in_flight) no_overlap &= !overlaps(h);
+                frame.ranges.push_back({ begin, end });
+            } else if (r < 8) {
+                ring.end_frame(++fence);
+                frame.fence = fence;
+                if (!frame.ranges.empty()) in_flight.push_back(std::move(frame));
+                frame = {};
+            } else {
+                completed = std::min(fence, completed + rng() % 3);
+                if (rng() % 20 == 0) completed = fence;     // the GPU catches up completely
+                ring.retire(completed);
+                while (!in_flight.empty() && in_flight.front().fence <= completed) in_flight.pop_front();
+            }
+        }
+        CHECK(no_overlap);
+        CHECK(empty_never_refuses);
+        CHECK(in_range);
+    }
+}
+
+int main() {
+    free_list();
+    ring_basics();
+    ring_against_model();
+    return check::result();
+}
@@ -0,0 +1,260 @@
+// The SSE4.1 and AVX2 filter kernels must match the scalar reference bit for bit, over every
+// length and radius; the kernels themselves must be right: Gaussian weights add up to one, the
+// three boxes come out at the Gaussian's variance, a flat image stays flat and premultiplied
+// pixels stay premultiplied. canvas_filters must give the same image tiled as untiled, on any
+// number of threads.
+
+#include "canvas_filters.h"
+#include "check.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace pixel;
+
+const simd::Level levels[] = { simd::Level::sse41, simd::Level::avx2 };
+
+uint32_t premultiplied(std::mt19937& rng) {
+    uint32_t x = rng();
+    uint32_t a = x >> 24;
+    uint32_t r = (x & 0xff) % (a + 1), g = ((x >> 8) & 0xff) % (a + 1), b = ((x >> 16) & 0xff) % (a + 1);
+    return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+bool is_premultiplied(const uint32_t* p, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t a = p[i] >> 24;
+        if ((p[i] & 0xff) > a || ((p[i] >> 8) & 0xff) > a || ((p[i] >> 16) & 0xff) > a) return false;
+    }
+    return true;
+}
+
+void gaussian_weights() {
+    for (float sigma : { 0.0f, -1.0f, 0.3f, 0.5f, 1.0f, 2.0f, 3.7f, 5.34f, 10.0f, 100.0f }) {
+        GaussianKernel k = gaussian_kernel(sigma);
+        int sum = 0;
+        bool symmetric = true, falling = true;
+        for (int i = 0; i < k.tap_count(); i++) {
+            sum += k.weights[i];
+            symmetric &= k.weights[i] == k.weights[k.tap_count() - 1 - i];
+            // Past the centre, which takes the rounding error and so can come out a little low.
+            if (i > k.radius + 1) falling &= k.weights[i] <= k.weights[i - 1] && k.weights[i] >= 0;
+        }
+        CHECK(sum == 1 << weight_bits);
+        CHECK(symmetric);
+        CHECK(falling);
+        CHECK(k.radius == (sigma > 0 ? std::clamp(int(std::ceil(3 * sigma)), 1, max_gaussian_radius) : 0));
+    }
+}
+
+// A box of radius r has variance ((2r + 1)^2 - 1) / 12, and variances add.
+void box_radii_variance() {
+    bool close = true, ordered = true;
+    for (float sigma = 0.5f; sigma <= 60.0f; sigma += 0.25f) {
+        auto radii = box_radii(sigma);
+        double variance = 0;
+        for (int r : radii) variance += ((2.0 * r + 1) * (2.0 * r + 1) - 1) / 12;
+        // Box sizes step by 2, so it can only get within a box step of sigma^2.
+        close &= std::abs(variance - double(sigma) * sigma) <= (2.0 * radii[2] + 2) / 3;
+        ordered &= radii[0] <= radii[1] && radii[1] <= radii[2] && radii[2] - radii[0] <= 1;
+    }
+    CHECK(close);
+    CHECK(ordered);
+    auto huge = box_radii(1000.0f);
+    CHECK(huge[0] == max_box_radius && huge[2] == max_box_radius);
+}
+
+void convolve_levels_match() {
+    std::mt19937 rng(1);
+    for (int iter = 0; iter < 80; iter++) {
+        size_t count = iter < 40 ? size_t(iter) : 700 + rng() % 100;
+        // Real Gaussian kernels, and arbitrary weights that add up to one up to the longest box.
+        std::vector<int16_t> weights;
+        if (iter % 2) {
+            GaussianKernel k = gaussian_kernel(0.3f + float(iter % 11));
+            weights.assign(k.weights.begin(), k.weights.begin() + k.tap_count());
+        } else {
+            weights.resize(1 + rng() % (2 * max_box_radius + 1));
+            int left = 1 << weight_bits;
+            for (auto& w : weights) {
+                w = int16_t(rng() % (left / 2 + 1));
+                left -= w;
+            }
+            weights[rng() % weights.size()] += int16_t(left);
+        }
+        const int taps = int(weights.size());
+        std::vector<uint32_t> src(count + taps + 1);
+        for (auto& p : src) p = iter % 3 ? premultiplied(rng) : rng();
+        std::vector<const uint32_t*> tap_ptrs(taps);
+        for (int t = 0; t < taps; t++) tap_ptrs[t] = src.data() + 1 + t;
+
+        std::vector<uint32_t> expected(count + 1);
+        convolve_rgba8(expected.data() + 1, tap_ptrs.data(), weights.data(), taps, count, simd::Level::scalar);
+        if (iter % 3) CHECK(is_premultiplied(expected.data() + 1, count));
+        for (simd::Level level : levels) {
+            std::vector<uint32_t> got(count + 1);
+            convolve_rgba8(got.data() + 1, tap_ptrs.data(), weights.data(), taps, count, level);
+            CHECK(got == expected);
+        }
+    }
+}
+
+void box_levels_match() {
+    std::mt19937 rng(2);
+    for (int radius : { 0, 1, 2, 7, 31, max_box_radius }) {
+        for (size_t count : { size_t(1), size_t(3), size_t(8), size_t(17), size_t(33), size_t(300) }) {
+            const int rows = 5;
+            const size_t pitch = count + 2 * radius + 3;
+            std::vector<uint32_t> src(pitch * (rows + 2 * radius));
+            for (auto& p : src) p = premultiplied(rng);
+            const uint32_t* centre = src.data() + radius * pitch + radius + 1;
+
+            std::vector<uint32_t> expected(count * rows), sums(4 * count);
+            box_rows_rgba8(expected.data(), count, centre, pitch, count, rows, radius, simd::Level::scalar);
+            CHECK(is_premultiplied(expected.data(), expected.size()));
+            for (simd::Level level : levels) {
+                std::vector<uint32_t> got(count * rows);
+                box_rows_rgba8(got.data(), count, centre, pitch, count, rows, radius, level);
+                CHECK(got == expected);
+            }
+            box_columns_rgba8(expected.data(), count, centre, pitch, count, rows, radius, sums.data(),
+                              simd::Level::scalar);
+            CHECK(is_premultiplied(expected.data(), expected.size()));
+            for (simd::Level level : levels) {
+                std::vector<uint32_t> got(count * rows);
+                box_columns_rgba8(got.data(), count, centre, pitch, count, rows, radius, sums.data(), level);
+                CHECK(got == expected);
+            }
+        }
+    }
+}
+
+void unsharp_levels_match() {
+    std::mt19937 rng(3);
+    for (int iter = 0; iter < 60; iter++) {
+        size_t count = iter < 40 ? size_t(iter) : 500 + rng() % 50;
+        std::vector<uint32_t> src(count), blurred(count);
+        for (auto& p : src) p = premultiplied(rng);
+        for (auto& p : blurred) p = premultiplied(rng);
+        for (int32_t amount : { 0, 1, 100, 256, 700, 16 * 256 }) {
+            std::vector<uint32_t> expected(count);
+            unsharp_rgba8(expected.data(), src.data(), blurred.data(), count, amount, simd::Level::scalar);
+            CHECK(is_premultiplied(expected.data(), count));
+            if (amount == 0) CHECK(expected == src);
+            for (simd::Level level : levels) {
+                std::vector<uint32_t> got(count);
+                unsharp_rgba8(got.data(), src.data(), blurred.data(), count, amount, level);
+                CHECK(got == expected);
+                // In place.
+                got = src;
+                unsharp_rgba8(got.data(), got.data(), blurred.data(), count, amount, level);
+                CHECK(got == expected);
+            }
+        }
+    }
+}
+
+// Weights add up to exactly one, and a full box of 255 divides back to 255, so nothing drifts.
+void flat_stays_flat() {
+    const uint32_t colours[] = { 0x00000000, 0xffffffff, 0x80402010, 0xff00ff00, 0x01010101 };
+    for (simd::Level level : { simd::Level::scalar, simd::Level::sse41, simd::Level::avx2 }) {
+        for (uint32_t colour : colours) {
+            const size_t count = 100;
+            const int radius = max_box_radius;
+            const size_t pitch = count + 2 * radius;
+            std::vector<uint32_t> src(pitch * (2 * radius + 2), colour), out(2 * count), sums(4 * count);
+            bool flat = true;
+            for (float sigma : { 0.5f, 2.0f, 5.34f }) {
+                GaussianKernel k = gaussian_kernel(sigma);
+                std::vector<const uint32_t*> taps(k.tap_count(), src.data());
+                convolve_rgba8(out.data(), taps.data(), k.weights.data(), k.tap_count(), count, level);
+                for (size_t i = 0; i < count; i++) flat &= out[i] == colour;
+            }
+            for (int r : { 0, 1, 9, radius }) {
+                const uint32_t* centre = src.data() + radius * pitch + radius;
+                box_rows_rgba8(out.data(), count, centre, pitch, count, 2, r, level);
+                for (size_t i = 0; i < 2 * count; i++) flat &= out[i] == colour;
+                box_columns_rgba8(out.data(), count, centre, pitch, count, 2, r, sums.data(), level);
+                for (size_t i = 0; i < 2 * count; i++) flat &= out[i] == colour;
+            }
+            unsharp_rgba8(out.data(), src.data(), src.data(), count, 16 * 256, level);
+            for (size_t i = 0; i < count; i++) flat &= out[i] == colour;
+            CHECK(flat);
+        }
+    }
+}
+
+// Some strokes and blobs on a canvas a few tiles across, with a tile's worth of nothing between.
+canvas::TileCanvas test_canvas(std::mt19937& rng) {
+    canvas::TileCanvas c(5 * canvas::tile_size + 17, 3 * canvas::tile_size + 5);
+    for (int i = 0; i < 12; i++) {
+        int x = int(rng() % uint32_t(c.width() - 40)), y = int(rng() % uint32_t(c.height() - 40));
+        if (x / canvas::tile_size == 3) continue;
+        c.fill_rect(x, y, x + 1 + int(rng() % 40), y + 1 + int(rng() % 40), premultiplied(rng) | 0x80000000u);
+    }
+    return c;
+}
+
+// The whole canvas with reach transparent pixels round it, filtered in one go.
+std::vector<uint32_t> filter_whole(const canvas::TileCanvas& c, const canvas::Filter& f, simd::Level level) {
+    const int reach = canvas::filter_reach(f);
+    const size_t pitch = size_t(c.width()) + 2 * reach;
+    std::vector<uint32_t> src(pitch * (size_t(c.height()) + 2 * reach));
+    for (int y = 0; y < c.height(); y++) {
+        for (int x = 0; x < c.width(); x++) src[(y + reach) * pitch + x + reach] = c.pixel(x, y);
+    }
+    std::vector<uint32_t> dst(size_t(c.width()) * c.height());
+    canvas::filter_rgba8(dst.data(), c.width(), src.data() + reach * pitch + reach, pitch, c.width(), c.height(), f,
+                         level);
+    return dst;
+}
+
+void canvas_filters_match() {
+    std::vector<canvas::Filter> filters(6);
+    filters[0].sigma = 1.5f;
+    filters[1].sigma = 9.0f;                                // boxes, reach past a tile
+    filters[2].sigma = 3.0f;
+    filters[2].method = canvas::BlurMethod::box;
+    filters[3].kind = canvas::FilterKind::sharpen;
+    filters[3].amount = 2.5f;
+    filters[4].kind = canvas::FilterKind::drop_shadow;
+    filters[5].kind = canvas::FilterKind::drop_shadow;
+    filters[5].offset_x = -7;
+    filters[5].color = 0xc0300000;
+
+    std::mt19937 rng(4);
+    for (const canvas::Filter& f : filters) {
+        canvas::TileCanvas c = test_canvas(rng);
+        std::vector<uint32_t> expected = filter_whole(c, f, simd::Level::scalar);
+        CHECK(is_premultiplied(expected.data(), expected.size()));
+        for (simd::Level level : levels) CHECK(filter_whole(c, f, level) == expected);
+
+        for (unsigned threads : { 1u, 3u }) {
+            canvas::TileCanvas tiled = c;
+            canvas::apply_filter(tiled, f, threads);
+            bool same = true;
+            for (int y = 0; y < c.height(); y++) {
+                for (int x = 0; x < c.width(); x++) same &= tiled.pixel(x, y) == expected[size_t(y) * c.width() + x];
+            }
+            CHECK(same);
+        }
+    }
+
+    // Nothing within reach, nothing made.
+    canvas::TileCanvas sparse(8 * canvas::tile_size, canvas::tile_size);
+    sparse.set_pixel(3, 3, 0xffffffff);
+    canvas::apply_filter(sparse, filters[0]);
+    CHECK(sparse.tile(0) != nullptr && sparse.tile(1) == nullptr && sparse.tile(7) == nullptr);
+}
+
+int main() {
+    gaussian_weights();
+    box_radii_variance();
+    convolve_levels_match();
+    box_levels_match();
+    unsharp_levels_match();
+    flat_stays_flat();
+    canvas_filters_match();
+    return check::result();
+}
@@ -0,0 +1,146 @@
+// flood_fill against a breadth-first fill of the same pixels: on noise, mazes and half empty
+// canvases whose sizes aren't whole tiles, at several tolerances, with the fill colour inside and
+// outside the tolerance and from every code path, it must change exactly the pixels the BFS
+// reaches and count them. Fills covering whole tiles share one solid tile.
+
+#include "flood_fill.h"
+#include "check.h"
+
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace canvas;
+
+const simd::Level levels[] = { simd::Level::scalar, simd::Level::sse41, simd::Level::avx2 };
+
+bool within(uint32_t p, uint32_t target, uint32_t tolerance) {
+    for (int c = 0; c < 4; c++) {
+        int d = int((p >> (8 * c)) & 0xff) - int((target >> (8 * c)) & 0xff);
+        if (d > int(tolerance) || -d > int(tolerance)) return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> pixels(const TileCanvas& c) {
+    std::vector<uint32_t> out(size_t(c.width()) * c.height());
+    for (int y = 0; y < c.height(); y++) {
+        for (int x = 0; x < c.width(); x++) out[size_t(y) * c.width() + x] = c.pixel(x, y);
+    }
+    return out;
+}
+
+// One pixel at a time off a queue; returns how many it filled.
+int64_t bfs_fill(std::vector<uint32_t>& image, int width, int height, int x, int y, uint32_t color,
+                 uint32_t tolerance) {
+    const std::vector<uint32_t> original = image;
+    const uint32_t target = original[size_t(y) * width + x];
+    std::vector<bool> seen(image.size());
+    std::deque<std::pair<int, int>> queue = { { x, y } };
+    seen[size_t(y) * width + x] = true;
+    int64_t filled = 0;
+    while (!queue.empty()) {
+        auto [px, py] = queue.front();
+        queue.pop_front();
+        image[size_t(py) * width + px] = color;
+        filled++;
+        const int next[4][2] = { { px - 1, py }, { px + 1, py }, { px, py - 1 }, { px, py + 1 } };
+        for (auto [nx, ny] : next) {
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+            size_t i = size_t(ny) * width + nx;
+            if (seen[i] || !within(original[i], target, tolerance)) continue;
+            seen[i] = true;
+            queue.push_back({ nx, ny });
+        }
+    }
+    return filled;
+}
+
+// Few colours close together, so tolerances decide what connects.
+void paint_noise(TileCanvas& c, std::mt19937& rng) {
+    for (int y = 0; y < c.height(); y++) {
+        for (int x = 0; x < c.width(); x++) c.set_pixel(x, y, 0xff000000u | (rng() % 4 * 0x101010u));
+    }
+}
+
+// Walls every few pixels with gaps in them, crossing tile edges at odd places.
+void paint_maze(TileCanvas& c, std::mt19937& rng) {
+    for (int y = 0; y < c.height(); y += 5) {
+        c.fill_rect(0, y, c.width(), y + 1, 0xff000000u);
+        for (int gap = 0; gap < c.width() / 40; gap++) {
+            int x = int(rng() % uint32_t(c.width()));
+            c.fill_rect(x, y, x + 1 + int(rng() % 3), y + 1, 0);
+        }
+    }
+    for (int x = 3; x < c.width(); x += 7) {
+        int y = int(rng() % uint32_t(c.height()));
+        c.fill_rect(x, y, x + 1, y + int(rng() % 90), 0xff000000u);
+    }
+}
+
+// Blobs on a canvas with most tiles left null.
+void paint_sparse(TileCanvas& c, std::mt19937& rng) {
+    for (int i = 0; i < 6; i++) {
+        int x = int(rng() % uint32_t(c.width())), y = int(rng() % uint32_t(c.height()));
+        c.fill_rect(x, y, x + int(rng() % 120), y + 2 + int(rng() % 4), 0xff4080c0u);
+        c.fill_rect(x, y, x + 3, y + int(rng() % 150), 0x80204060u);
+    }
+}
+
+void matches_bfs() {
+    std::mt19937 rng(1);
+    bool same_pixels = true, same_count = true;
+    for (int iter = 0; iter < 36; iter++) {
+        TileCanvas c(70 + int(rng() % 200), 60 + int(rng() % 150));
+        switch (iter % 3) {
+        case 0: paint_noise(c, rng); break;
+        case 1: paint_maze(c, rng); break;
+        case 2: paint_sparse(c, rng); break;
+        }
+        for (uint32_t tolerance : { 0u, 16u, 255u }) {
+            // Clicks on the edges and corners as well as anywhere.
+            int x = iter % 4 == 0 ? c.width() - 1 : int(rng() % uint32_t(c.width()));
+            int y = iter % 5 == 0 ? 0 : int(rng() % uint32_t(c.height()));
+            uint32_t target = c.pixel(x, y);
+            // A fill colour that matches the target too mustn't leak past the region.
+            uint32_t color = iter % 2 ? target ^ 0x01010101u : 0xff00ff00u;
+            std::vector<uint32_t> expected = pixels(c);
+            int64_t expected_count = bfs_fill(expected, c.width(), c.height(), x, y, color, tolerance);
+            for (simd::Level level : levels) {
+                TileCanvas filled = c;
+                same_count &= flood_fill(filled, x, y, color, tolerance, level) == expected_count;
+                same_pixels &= pixels(filled) == expected;
+            }
+        }
+    }
+    CHECK(same_pixels);
+    CHECK(same_count);
+}
+
+void empty_and_solid() {
+    // A canvas that was never drawn on fills all at once and shares one tile.
+    TileCanvas c(5 * tile_size + 9, 3 * tile_size);
+    CHECK(flood_fill(c, 10, 10, 0xff0000ffu) == int64_t(c.width()) * c.height());
+    CHECK(c.tile(0) == c.tile(1) && c.tile(0) == c.tile(c.tile_count() - 2));
+    CHECK(c.pixel(c.width() - 1, c.height() - 1) == 0xff0000ffu);
+    CHECK(int(c.touched_tiles().size()) == c.tile_count());
+
+    // A wall down the middle stops it; tiles it only partly covers get their own copy.
+    TileCanvas w(4 * tile_size, tile_size);
+    w.fill_rect(100, 0, 101, tile_size, 0xffffffffu);
+    w.clear_touched();
+    CHECK(flood_fill(w, 0, 0, 0xff00ff00u) == 100 * tile_size);
+    CHECK(w.pixel(99, 5) == 0xff00ff00u && w.pixel(100, 5) == 0xffffffffu && w.pixel(101, 5) == 0);
+    CHECK(w.touched_tiles().size() == 2);
+    CHECK(w.tile(2) == nullptr && w.tile(3) == nullptr);
+
+    // Outside the canvas nothing happens.
+    CHECK(flood_fill(w, -1, 0, 0xffffffffu) == 0);
+    CHECK(flood_fill(w, 0, tile_size, 0xffffffffu) == 0);
+}
+
+int main() {
+    matches_bfs();
+    empty_and_solid();
+    return check::result();
+}
@@ -0,0 +1,280 @@
+// Frame captures: what the Writer records comes back out of replay() command for command, broken
+// streams are refused or cut short the way replay() says, and a capture drawn on the software
+// device through DeviceBackend puts the quad where it was asked for and skips what it can't draw.
+
+#include "frame_capture.h"
+#include "capture_replay.h"
+#include "software_device.h"
+#include "check.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace capture;
+
+namespace dxgi {
+constexpr uint32_t r8g8b8a8_unorm = 28;
+constexpr uint32_t d32_float = 40;
+constexpr uint32_t r16_uint = 57;
+}
+
+std::string record(const std::function<void(Writer&)>& commands) {
+    std::string out;
+    {
+        Writer writer([&](std::span<const uint8_t> bytes) { out.append(bytes.begin(), bytes.end()); });
+        commands(writer);
+    }
+    return out;
+}
+
+ReplayStats play(const std::string& bytes, Backend& backend) {
+    std::istringstream in(bytes);
+    return replay(in, backend);
+}
+
+template <class T>
+std::span<const uint8_t> bytes_of(const std::vector<T>& v) {
+    return { reinterpret_cast<const uint8_t*>(v.data()), v.size() * sizeof(T) };
+}
+
+// Three frames of a made up app: counts per frame and in total.
+void round_trip() {
+    int key = 0;
+    std::string stream = record([&](Writer& w) {
+        ObjectId target = w.declare(&key, { 0, ResourceKind::texture2d, 64, 64, dxgi::r8g8b8a8_unorm });
+        CHECK(w.find(&key, { 0, ResourceKind::texture2d, 64, 64, dxgi::r8g8b8a8_unorm }) == target);
+        CHECK(w.find(&key, { 0, ResourceKind::texture2d, 32, 64, dxgi::r8g8b8a8_unorm }) == 0);
+        CHECK(w.object(&stream) == w.object(&stream));
+        for (uint64_t frame = 1; frame <= 3; frame++) {
+            w.record(BeginFrame{ frame });
+            w.upload(target, 0, std::vector<uint8_t>(100 * frame));
+            w.record(Barrier{ target, 0, 4 });
+            w.record(ClearColor{ target, { 0, 0, 0, 1 } });
+            w.record(Topology{ 4 });
+            for (uint64_t i = 0; i < frame; i++) w.record(DrawIndexed{ 6, 2, 0, 0, 0 });
+            w.record(Topology{ 5 });                    // strips aren't counted as triangles
+            w.record(DrawIndexed{ 4, 1, 0, 0, 0 });
+            w.record(EndFrame{ frame });
+        }
+    });
+    CountingBackend counts;
+    ReplayStats stats = play(stream, counts);
+    CHECK(stats.frames == 3 && stats.skipped == 0 && stats.frame_ms.size() == 3);
+    CHECK(stats.bytes == stream.size());
+    CHECK(stats.commands == 1 + 3 * 8 + 6);
+    CHECK(counts.frames().size() == 3);
+    for (size_t i = 0; i < counts.frames().size(); i++) {
+        const FrameCounts& f = counts.frames()[i];
+        CHECK(f.frame == i + 1);
+        CHECK(f.draws == i + 2);
+        CHECK(f.instances == 2 * (i + 1) + 1);
+        CHECK(f.triangles == 4 * (i + 1));
+        CHECK(f.upload_bytes == 100 * (i + 1));
+        CHECK(f.barriers == 1 && f.clears == 1 && f.uploads == 1 && f.state_changes == 2);
+    }
+    CHECK(counts.totals().resources == 1);
+    CHECK(counts.totals().draws == 9 && counts.totals().triangles == 24);
+}
+
+void broken_streams() {
+    std::string stream = record([](Writer& w) {
+        w.record(BeginFrame{ 1 });
+        w.record(DrawIndexed{ 3, 1, 0, 0, 0 });
+        w.record(EndFrame{ 1 });
+    });
+    CountingBackend counts;
+
+    // Cut between records: what's there plays. Cut inside one: an error.
+    size_t end_frame_size = 5 + sizeof(EndFrame);
+    CHECK(play(stream.substr(0, stream.size() - end_frame_size), counts).commands == 2);
+    CHECK_THROWS(play(stream.substr(0, stream.size() - 3), counts), std::runtime_error);
+    CHECK_THROWS(play(stream.substr(0, 10), counts), std::runtime_error);
+    CHECK_THROWS(play("not a capture at all", counts), std::runtime_error);
+    CHECK_THROWS(play("", counts), std::runtime_error);
+
+    std::string newer = stream;
+    uint32_t version = format_version + 1;
+    memcpy(newer.data() + 8, &version, 4);
+    CHECK_THROWS(play(newer, counts), std::runtime_error);
+
+    // An upload claiming more data than its record holds.
+    std::string upload = stream.substr(0, 16);
+    Upload bad = { 1, 1000, 0 };
+    uint32_t size = sizeof(bad) + 10;
+    upload += char(Op::upload);
+    upload.append(reinterpret_cast<const char*>(&size), 4);
+    upload.append(reinterpret_cast<const char*>(&bad), sizeof(bad));
+    upload.append(10, '\0');
+    CHECK_THROWS(play(upload, counts), std::runtime_error);
+
+    // An op from a newer writer is skipped; a payload from an older one is zero filled.
+    std::string mixed = stream.substr(0, 16);
+    uint32_t three = 3, four = 4;
+    mixed += char(200);
+    mixed.append(reinterpret_cast<const char*>(&three), 4);
+    mixed.append("abc");
+    mixed += char(Op::draw_indexed);
+    mixed.append(reinterpret_cast<const char*>(&four), 4);
+    mixed.append(reinterpret_cast<const char*>(&three), 4);   // index_count only
+    struct LastDraw : Backend {
+        DrawIndexed draw = { 9, 9, 9, 9, 9 };
+        void execute(const DrawIndexed& c) override { draw = c; }
+    } last;
+    ReplayStats stats = play(mixed, last);
+    CHECK(stats.skipped == 1 && stats.commands == 2);
+    CHECK(last.draw.index_count == 3 && last.draw.instance_count == 0 && last.draw.base_vertex == 0);
+}
+
+void file_sink() {
+    auto path = std::filesystem::temp_directory_path() / "frame_capture_test.cap";
+    {
+        FileSink file(path);
+        Writer writer([&](std::span<const uint8_t> bytes) { file.write(bytes); });
+        for (uint64_t frame = 0; frame < 200; frame++) {
+            writer.record(BeginFrame{ frame });
+            writer.upload(1, frame, std::vector<uint8_t>(frame % 50, uint8_t(frame)));
+            writer.record(EndFrame{ frame });
+        }
+        writer.flush();
+        CHECK(!file.failed());
+    }
+    std::ifstream in(path, std::ios::binary);
+    CountingBackend counts;
+    ReplayStats stats = replay(in, counts);
+    CHECK(stats.frames == 200);
+    CHECK(counts.frames().back().frame == 199 && counts.frames().back().upload_bytes == 199 % 50);
+    in.close();
+    std::filesystem::remove(path);
+
+    CHECK_THROWS(FileSink("/nonexistent/dir/frame.cap"), std::runtime_error);
+}
+
+// A 64x64 target cleared blue, a quad over its middle half drawn with the identity transform.
+struct Scene {
+    ObjectId target, depth, vertices, indices, constants;
+};
+
+Scene declare_scene(Writer& w, int* keys) {
+    Scene s;
+    s.target = w.declare(keys + 0, { 0, ResourceKind::texture2d, 64, 64, dxgi::r8g8b8a8_unorm });
+    s.depth = w.declare(keys + 1, { 0, ResourceKind::texture2d, 64, 64, dxgi::d32_float });
+    s.vertices = w.declare(keys + 2, { 0, ResourceKind::buffer, 64, 1, 0 });
+    s.indices = w.declare(keys + 3, { 0, ResourceKind::buffer, 12, 1, 0 });
+    s.constants = w.declare(keys + 4, { 0, ResourceKind::buffer, 256, 1, 0 });
+    std::vector<float> quad = { -0.5f, 0.5f, 0, 0,   0.5f, 0.5f, 1, 0,   -0.5f, -0.5f, 0, 1,   0.5f, -0.5f, 1, 1 };
+    std::vector<uint16_t> indices = { 0, 1, 2, 2, 1, 3 };
+    std::vector<float> identity(64, 0.0f);
+    for (int i = 0; i < 4; i++) identity[i * 5] = 1;
+    w.upload(s.vertices, 0, bytes_of(quad));
+    w.upload(s.indices, 0, bytes_of(indices));
+    w.upload(s.constants, 0, bytes_of(identity));
+    return s;
+}
+
+void bind_scene(Writer& w, const Scene& s) {
+    w.record(RenderTargets{ s.target, s.depth });
+    w.record(capture::Viewport{ 0, 0, 64, 64, 0, 1 });
+    w.record(Scissor{ 0, 0, 64, 64 });
+    w.record(ClearColor{ s.target, { 0, 0, 1, 1 } });
+    w.record(ClearDepth{ s.depth, 1, 0 });
+    w.record(VertexBuffer{ s.vertices, 64, 16, 0 });
+    w.record(IndexBuffer{ s.indices, 12, dxgi::r16_uint, 0 });
+    w.record(Topology{ 4 });
+    w.record(RootTable{ 0, 7, s.constants });
+}
+
+std::vector<uint32_t> read_target(render::Device& device, DeviceBackend& backend, ObjectId id) {
+    std::vector<uint32_t> pixels(64 * 64);
+    device.read_texture(backend.texture(id), pixels.data(), 64 * 4);
+    return pixels;
+}
+
+void software_replay() {
+    int keys[5];
+    Scene scene;
+    std::string stream = record([&](Writer& w) {
+        w.record(BeginFrame{ 1 });
+        scene = declare_scene(w, keys);
+        bind_scene(w, scene);
+        w.record(DrawIndexed{ 6, 1, 0, 0, 0 });
+        w.record(EndFrame{ 1 });
+    });
+
+    int presented = 0;
+    render::SoftwareDevice device(2, [&](const uint32_t*, uint32_t w, uint32_t h, render::Format f) {
+        presented += w == 64 && h == 64 && f == render::Format::rgba8_unorm;
+    });
+    DeviceBackend backend(device);
+    play(stream, backend);
+    CHECK(presented == 1);
+    CHECK(backend.stats().frames == 1 && backend.stats().draws == 1 && backend.stats().skipped == 0);
+    CHECK(backend.last_frame().index == backend.texture(scene.target).index);
+
+    const uint32_t blue = 0xffff0000u;
+    auto pixels = read_target(device, backend, scene.target);
+    bool outside_clear = true, inside_checker = true;
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            uint32_t p = pixels[y * 64 + x];
+            if (x >= 16 && x < 48 && y >= 16 && y < 48) {
+                inside_checker &= p == 0xffc0c0c0u || p == 0xff404040u;
+            } else {
+                outside_clear &= p == blue;
+            }
+        }
+    }
+    CHECK(outside_clear);
+    CHECK(inside_checker);
+}
+
+// Draws that would read outside the buffers, or with nothing bound, are counted and dropped.
+void malformed_draws_are_skipped() {
+    int keys[5], other;
+    std::string stream = record([&](Writer& w) {
+        w.record(BeginFrame{ 1 });
+        w.record(DrawIndexed{ 6, 1, 0, 0, 0 });             // nothing bound yet
+        Scene s = declare_scene(w, keys);
+        bind_scene(w, s);
+        w.record(DrawIndexed{ 9, 1, 0, 0, 0 });             // past the index buffer
+        w.record(DrawIndexed{ 6, 1, 0, 1, 0 });             // index 3 + 1 is past the vertices
+        w.record(DrawIndexed{ 6, 1, 0, -4, 0 });            // negative vertex
+        w.record(DrawIndexed{ 3, 1, 0xffffffffu, 0, 0 });   // start_index overflowing
+        w.upload(s.vertices, 60, std::vector<uint8_t>(8));  // past the end
+        w.upload(999, 0, std::vector<uint8_t>(4));          // not declared
+        w.record(ClearDepth{ s.target, 1, 0 });             // not a depth buffer
+        w.record(ClearColor{ s.depth, { 1, 1, 1, 1 } });    // not a color target
+        w.record(CopyRegion{ s.target, s.depth, 0, 0, 0, 0, 64, 64 });
+        w.record(CopyRegion{ s.target, s.target, 4, 0, 0, 0, 60, 64 });
+        w.declare(&other, { 0, ResourceKind::texture2d, 1u << 20, 1, dxgi::r8g8b8a8_unorm });
+        w.declare(&other, { 0, ResourceKind::buffer, 0, 1, 0 });
+        w.record(Topology{ 5 });
+        w.record(DrawIndexed{ 6, 1, 0, 0, 0 });             // strips aren't drawn
+        w.record(Topology{ 4 });
+        w.record(RootTable{ 0, 7, 0 });                     // a table without a buffer keeps the constants
+        w.record(DrawIndexed{ 6, 1, 0, 0, 0 });
+        // The vertex buffer's id redeclared mid frame: draws need it bound again.
+        w.record(DeclareResource{ s.vertices, ResourceKind::buffer, 64, 1, 0 });
+        w.record(DrawIndexed{ 6, 1, 0, 0, 0 });
+        w.record(EndFrame{ 1 });
+    });
+    render::SoftwareDevice device(1);
+    DeviceBackend backend(device, false);
+    play(stream, backend);
+    CHECK(backend.stats().draws == 1);
+    CHECK(backend.stats().skipped == 15);
+}
+
+int main() {
+    round_trip();
+    broken_streams();
+    file_sink();
+    software_replay();
+    malformed_draws_are_skipped();
+    return check::result();
+}
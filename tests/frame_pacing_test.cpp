@@ -0,0 +1,250 @@
+// The frame pacer against a SimulatedPresentQueue on a made up clock, with input arriving at 1 kHz
+// the way inking does. On demand and continuous draw once a refresh without missing; low latency
+// shows input sooner than either, misses few vblanks with a jittery CPU, follows a GPU that gets
+// slower, and learns a display's real refresh when the guess it's given is wrong. Continuous with
+// an interval draws on every other vblank, an idle on demand pacer draws once and then waits, and
+// the present queue flips on the vblank grid.
+
+#include "frame_pacing.h"
+#include "check.h"
+
+#include <cmath>
+#include <deque>
+#include <random>
+
+using namespace pacing;
+using namespace std::chrono_literals;
+
+struct Scenario {
+    Mode mode = Mode::low_latency;
+    double refresh_ms = 16.667;     // the display's
+    double guess_ms = 16.667;       // the pacer's, to start with
+    double cpu_ms = 2;
+    double gpu_ms = 3;
+    double jitter_ms = 0;           // mean of an exponential extra on the CPU time
+    double gpu_step_ms = 0;         // added to the GPU time for the second half
+    Nanos interval{ 0 };
+    double seconds = 10;
+};
+
+struct Result {
+    PacerStats stats;
+    double input_latency_ms = 0;    // oldest input a frame picked up to its flip, on average
+    std::vector<Nanos> flips;
+};
+
+double ms(Nanos t) {
+    return double(t.count()) / 1e6;
+}
+
+Nanos nanos(double ms) {
+    return Nanos(int64_t(ms * 1e6));
+}
+
+// The app's loop: take the flips, draw when the pacer says so, and otherwise sleep until whichever
+// comes first of the pacer's wait, the next flip and the next input.
+Result simulate(const Scenario& s) {
+    Nanos t = 1ms;
+    std::mt19937 rng(1);
+    std::exponential_distribution<double> jitter(1.0 / std::max(s.jitter_ms, 1e-6));
+    PacerOptions options;
+    options.mode = s.mode;
+    options.refresh = nanos(s.guess_ms);
+    options.interval = s.interval;
+    FramePacer pacer([&] { return t; }, options);
+    SimulatedPresentQueue queue(nanos(s.refresh_ms), 333'333ns);
+
+    Result result;
+    const Nanos end = t + nanos(s.seconds * 1e3), halfway = t + nanos(s.seconds * 500);
+    Nanos next_input = t, oldest_unseen = forever;
+    std::deque<Nanos> frame_inputs;
+    double latency = 0;
+    int latencies = 0;
+    while (t < end) {
+        for (; next_input <= t; next_input += 1ms) {
+            pacer.invalidate();
+            oldest_unseen = std::min(oldest_unseen, next_input);
+        }
+        queue.collect(t, [&](Nanos at) {
+            pacer.slot_freed(at);
+            result.flips.push_back(at);
+            Nanos input = frame_inputs.front();
+            frame_inputs.pop_front();
+            if (input != forever) {
+                latency += ms(at - input);
+                latencies++;
+            }
+        });
+        if (pacer.should_begin()) {
+            pacer.begin_frame();
+            // Input is read at the start of the frame.
+            frame_inputs.push_back(oldest_unseen);
+            oldest_unseen = forever;
+            t += nanos(s.cpu_ms + (s.jitter_ms > 0 ? jitter(rng) : 0));
+            pacer.cpu_done();
+            t += nanos(s.gpu_ms + (t > halfway ? s.gpu_step_ms : 0));
+            queue.present(t);
+            pacer.gpu_done();
+            continue;
+        }
+        Nanos wait = pacer.wait_time();
+        Nanos wake = std::min({ wait == forever ? forever : t + wait, queue.next_flip(), next_input });
+        t = std::max(wake, t + 1ns);
+    }
+    result.stats = pacer.stats();
+    result.input_latency_ms = latencies ? latency / latencies : 0;
+    return result;
+}
+
+bool near(double a, double b, double tolerance) {
+    return std::abs(a - b) <= tolerance;
+}
+
+void sixty_hz() {
+    Scenario s;
+    s.mode = Mode::on_demand;
+    Result on_demand = simulate(s);
+    s.mode = Mode::continuous;
+    Result continuous = simulate(s);
+    s.mode = Mode::low_latency;
+    Result low_latency = simulate(s);
+
+    for (const Result* r : { &on_demand, &continuous, &low_latency }) {
+        CHECK(r->stats.frames >= 595 && r->stats.frames <= 601);
+        CHECK(r->stats.missed == 0);
+        CHECK(near(ms(r->stats.refresh), 16.667, 0.01));
+        CHECK(near(ms(r->stats.cpu), 2, 0.01) && near(ms(r->stats.gpu), 3, 0.01));
+    }
+    // Drawn right after a flip, a frame waits most of a refresh to be shown and so does its input.
+    CHECK(near(ms(on_demand.stats.latency), 16.667, 0.1));
+    CHECK(near(ms(continuous.stats.latency), 16.667, 0.1));
+    // Held back to just before the vblank, it's on screen a little after its work is done.
+    CHECK(ms(low_latency.stats.latency) < 6);
+    CHECK(low_latency.input_latency_ms < on_demand.input_latency_ms - 8);
+
+    // A jittery CPU: the margin grows to cover it, and only a few frames miss.
+    s.jitter_ms = 0.5;
+    Result jittery = simulate(s);
+    CHECK(jittery.stats.missed * 20 < jittery.stats.frames);
+    CHECK(ms(jittery.stats.margin) > ms(low_latency.stats.margin));
+    CHECK(jittery.input_latency_ms < on_demand.input_latency_ms - 5);
+}
+
+// Told 60 Hz on a 144 Hz display, both modes find the real refresh and draw at it. Low latency
+// can't tell from its own aimed flips, which land on every third vblank and so fit 60 Hz well
+// enough; it has to stop aiming while they don't fit to see the real ones.
+void wrong_refresh_guess() {
+    Scenario s;
+    s.refresh_ms = 6.944;
+    s.cpu_ms = 1;
+    s.gpu_ms = 2;
+    s.jitter_ms = 0.2;
+    s.mode = Mode::continuous;
+    Result continuous = simulate(s);
+    s.mode = Mode::low_latency;
+    Result low_latency = simulate(s);
+    CHECK(near(ms(continuous.stats.refresh), 6.944, 0.05));
+    CHECK(near(ms(low_latency.stats.refresh), 6.944, 0.05));
+    CHECK(continuous.stats.frames >= 1420);
+    CHECK(low_latency.stats.frames >= 1350);
+    CHECK(low_latency.input_latency_ms < continuous.input_latency_ms);
+}
+
+// The GPU time triples halfway through; the prediction follows and few frames miss on the way.
+void slower_gpu() {
+    Scenario s;
+    s.jitter_ms = 0.2;
+    s.gpu_step_ms = 6;
+    Result r = simulate(s);
+    CHECK(near(ms(r.stats.gpu), 9, 0.1));
+    CHECK(r.stats.missed * 25 < r.stats.frames);
+    CHECK(r.stats.frames >= 580);
+}
+
+// A frame takes more than a refresh: every other vblank, and low latency still beats continuous.
+void heavy_frames() {
+    Scenario s;
+    s.cpu_ms = 8;
+    s.gpu_ms = 12;
+    s.jitter_ms = 0.2;
+    s.mode = Mode::continuous;
+    Result continuous = simulate(s);
+    s.mode = Mode::low_latency;
+    Result low_latency = simulate(s);
+    CHECK(continuous.stats.frames >= 295 && continuous.stats.frames <= 301);
+    CHECK(low_latency.stats.frames >= 290 && low_latency.stats.frames <= 301);
+    CHECK(low_latency.stats.missed * 30 < low_latency.stats.frames);
+    CHECK(low_latency.input_latency_ms < continuous.input_latency_ms - 5);
+}
+
+// 30 frames a second on a 60 Hz display: a flip on every other vblank, never one in between.
+void continuous_interval() {
+    Scenario s;
+    s.mode = Mode::continuous;
+    s.interval = 33333us;
+    s.jitter_ms = 0.2;
+    Result r = simulate(s);
+    CHECK(r.stats.frames >= 295 && r.stats.frames <= 301);
+    bool every_other = true;
+    for (size_t i = 1; i < r.flips.size(); i++) every_other &= near(ms(r.flips[i] - r.flips[i - 1]), 33.333, 0.01);
+    CHECK(every_other);
+}
+
+// Nothing changing: one frame, then no wakeups until something invalidates the window.
+void idle_on_demand() {
+    Nanos t{ 0 };
+    FramePacer pacer([&] { return t; });
+    int frames = 0;
+    auto step = [&] {
+        if (pacer.should_begin()) {
+            pacer.begin_frame();
+            pacer.cpu_done();
+            pacer.gpu_done();
+            pacer.slot_freed(t);
+            frames++;
+        }
+        t += 10ms;
+    };
+    for (int i = 0; i < 5; i++) step();
+    CHECK(frames == 1);
+    CHECK(pacer.wait_time() == forever);
+    pacer.invalidate();
+    CHECK(pacer.wait_time() == Nanos(0));
+    step();
+    CHECK(frames == 2 && pacer.wait_time() == forever);
+
+    // Dirty, but the one present slot is taken until the frame flips.
+    pacer.invalidate();
+    pacer.begin_frame();
+    pacer.cpu_done();
+    pacer.gpu_done();
+    pacer.invalidate();
+    CHECK(!pacer.should_begin() && pacer.wait_time() == forever);
+    pacer.slot_freed(t);
+    CHECK(pacer.should_begin());
+}
+
+void present_queue() {
+    SimulatedPresentQueue queue(10ms, 3ms);
+    CHECK(queue.next_flip() == forever);
+    queue.present(5ms);     // the next vblank
+    queue.present(6ms);     // queued behind it, a refresh later
+    queue.present(30ms);
+    std::vector<Nanos> flips;
+    CHECK(queue.collect(100ms, [&](Nanos at) { flips.push_back(at); }) == 3);
+    CHECK(flips == std::vector<Nanos>({ 13ms, 23ms, 33ms }));
+    // Presented right on a vblank, it makes the one after.
+    queue.present(43ms);
+    CHECK(queue.next_flip() == 53ms);
+}
+
+int main() {
+    sixty_hz();
+    wrong_refresh_guess();
+    slower_gpu();
+    heavy_frames();
+    continuous_interval();
+    idle_on_demand();
+    present_queue();
+    return check::result();
+}
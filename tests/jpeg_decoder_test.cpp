@@ -0,0 +1,177 @@
+// The JPEG decoder on kitten1b.jpg (255x258, 4:2:0) and on damaged copies of it. Each reduced
+// decode comes out at the right size and close to box filtering the full one. Every file in
+// jpeg_corpus/, and thousands of random corruptions and truncations, either decodes to an image of
+// the size its header gives or throws runtime_error: no crashes, no other exceptions, and no
+// allocations the file can't back up. The corpus files are kitten1b, less its EXIF, cut short or
+// with a byte or two patched to reach one parser path each; the names say which.
+
+#include "jpeg_decoder.h"
+#include "check.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace image;
+namespace fs = std::filesystem;
+
+std::vector<uint8_t> read_file(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+const std::vector<uint8_t>& kitten() {
+    static const std::vector<uint8_t> file = read_file("../DrawOnTexture/kitten1b.jpg");
+    return file;
+}
+
+void kitten_decodes() {
+    CHECK(kitten().size() > 1000);
+    JpegInfo info = read_jpeg_info(kitten());
+    CHECK(info.width == 255 && info.height == 258 && info.components == 3);
+    CHECK(info.supported && !info.progressive);
+
+    DecodedImage full = decode_jpeg(kitten());
+    CHECK(full.width == 255 && full.height == 258 && full.pixels.size() == size_t(255) * 258);
+    // Reduced decodes are the full one box filtered, up to rounding and chroma siting.
+    for (int scale = 1; scale <= 3; scale++) {
+        DecodedImage small = decode_jpeg(kitten(), scale);
+        CHECK(small.width == jpeg_scaled_size(255, scale) && small.height == jpeg_scaled_size(258, scale));
+        int k = 1 << scale;
+        double error = 0;
+        int samples = 0;
+        // Whole boxes only; the last row and column are partly past the image.
+        for (int y = 0; y < 258 / k; y++) {
+            for (int x = 0; x < 255 / k; x++) {
+                for (int c = 0; c < 24; c += 8) {
+                    int sum = 0;
+                    for (int j = 0; j < k; j++) {
+                        const uint32_t* row = &full.pixels[size_t(y * k + j) * 255 + x * k];
+                        for (int i = 0; i < k; i++) sum += (row[i] >> c) & 0xff;
+                    }
+                    int got = (small.pixels[size_t(y) * small.width + x] >> c) & 0xff;
+                    error += std::abs(double(sum) / (k * k) - got);
+                    samples++;
+                }
+            }
+        }
+        CHECK(error / samples < 2.5);
+    }
+    CHECK(jpeg_scale_for(6000, 4000, 1024, 683) == 2);
+    CHECK(jpeg_scale_for(6000, 4000, 6000, 4000) == 0);
+    CHECK(jpeg_scale_for(6000, 4000, 1, 1) == 3);
+}
+
+// Decoded at every scale, each either works or throws runtime_error. Counts which.
+struct Outcome {
+    int decoded = 0;
+    int refused = 0;
+    bool sizes_right = true;
+    bool only_runtime_errors = true;
+};
+
+void try_decode(const std::vector<uint8_t>& data, Outcome& outcome) {
+    for (int scale = 0; scale <= 3; scale++) {
+        try {
+            DecodedImage image = decode_jpeg(data, scale);
+            JpegInfo info = read_jpeg_info(data);
+            outcome.sizes_right &= image.width == jpeg_scaled_size(info.width, scale) &&
+                                   image.height == jpeg_scaled_size(info.height, scale) &&
+                                   image.pixels.size() == size_t(image.width) * image.height;
+            outcome.decoded++;
+        } catch (const std::runtime_error&) {
+            outcome.refused++;
+        } catch (...) {
+            outcome.only_runtime_errors = false;
+        }
+    }
+}
+
+void corpus() {
+    Outcome outcome;
+    int files = 0;
+    for (const auto& entry : fs::directory_iterator("jpeg_corpus")) {
+        try_decode(read_file(entry.path()), outcome);
+        files++;
+    }
+    CHECK(files >= 10);
+    CHECK(outcome.sizes_right);
+    CHECK(outcome.only_runtime_errors);
+    // Some are damaged past reading, some only in the scan, which still decodes.
+    CHECK(outcome.decoded > 0 && outcome.refused > 0);
+}
+
+// Where the segments before the scan are, to aim corruption at the parser rather than at the
+// entropy coded data, which decodes to something whatever it holds.
+size_t header_size(const std::vector<uint8_t>& data) {
+    size_t at = 2;
+    while (at + 4 <= data.size() && data[at] == 0xff && data[at + 1] != 0xda) {
+        at += 2 + (data[at + 2] << 8 | data[at + 3]);
+    }
+    return std::min(at + 14, data.size());
+}
+
+void random_damage() {
+    std::mt19937 rng(7);
+    const std::vector<uint8_t>& original = kitten();
+    const size_t header = header_size(original);
+    Outcome outcome;
+    for (int iter = 0; iter < 3000; iter++) {
+        std::vector<uint8_t> data = original;
+        switch (iter % 6) {
+        case 0:     // cut anywhere
+            data.resize(rng() % data.size());
+            break;
+        case 1:     // a few bytes anywhere
+            for (int i = 0; i < 8; i++) data[rng() % data.size()] = uint8_t(rng());
+            break;
+        case 2:     // a byte in the headers
+            data[2 + rng() % (header - 2)] = uint8_t(rng());
+            break;
+        case 3:     // a segment length or count, or a size, pushed to an extreme
+            data[2 + rng() % (header - 2)] = rng() % 2 ? 0xff : 0x00;
+            break;
+        case 4:     // a marker dropped into the scan
+            data[header + rng() % (data.size() - header - 1)] = 0xff;
+            data[header + rng() % (data.size() - header - 1)] = uint8_t(0xc0 + rng() % 64);
+            break;
+        case 5: {   // a run of the file repeated or dropped
+            size_t at = rng() % data.size(), length = rng() % 64;
+            if (rng() % 2) {
+                auto end = original.begin() + std::min(at + length, original.size());
+                data.insert(data.begin() + at, original.begin() + at, end);
+            } else {
+                data.erase(data.begin() + at, data.begin() + std::min(at + length, data.size()));
+            }
+            break;
+        }
+        }
+        try_decode(data, outcome);
+    }
+    CHECK(outcome.sizes_right);
+    CHECK(outcome.only_runtime_errors);
+    CHECK(outcome.decoded > 0 && outcome.refused > 0);
+}
+
+void not_jpegs() {
+    Outcome outcome;
+    try_decode({}, outcome);
+    try_decode({ 0xff, 0xd8 }, outcome);
+    try_decode({ 0xff, 0xd8, 0xff, 0xd9 }, outcome);
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0, 0, 0 };
+    try_decode(png, outcome);
+    CHECK(outcome.decoded == 0 && outcome.refused == 16 && outcome.only_runtime_errors);
+    CHECK_THROWS(read_jpeg_info(png), std::runtime_error);
+}
+
+int main() {
+    kitten_decodes();
+    corpus();
+    random_damage();
+    not_jpegs();
+    return check::result();
+}
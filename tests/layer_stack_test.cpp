@@ -0,0 +1,183 @@
+// LayerStack's incrementally updated composite against flattening every layer from scratch, through
+// random drawing and add/remove/move/opacity/mode/visibility changes, and that update() only redoes
+// the tiles a change can affect.
+
+#include "layer_stack.h"
+#include "check.h"
+
+#include <random>
+#include <vector>
+
+using namespace canvas;
+
+// Every pixel of every visible layer blended bottom to top, no tiles, no caching.
+std::vector<uint32_t> flatten(const LayerStack& stack) {
+    int w = stack.width(), h = stack.height();
+    std::vector<uint32_t> out(size_t(w) * h, 0), row(w);
+    for (size_t i = 0; i < stack.layer_count(); i++) {
+        const Layer& l = stack.layer(i);
+        if (!l.visible() || l.opacity() == 0) continue;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) row[x] = l.pixels.pixel(x, y);
+            pixel::blend_rgba8(l.mode(), out.data() + size_t(y) * w, row.data(), w, l.opacity(), simd::Level::scalar);
+        }
+    }
+    return out;
+}
+
+std::vector<uint32_t> composite_pixels(const LayerStack& stack) {
+    std::vector<uint32_t> out;
+    for (int y = 0; y < stack.height(); y++) {
+        for (int x = 0; x < stack.width(); x++) out.push_back(stack.composite().pixel(x, y));
+    }
+    return out;
+}
+
+uint32_t premultiplied(std::mt19937& rng) {
+    uint32_t a = rng() % 4 == 0 ? 255 : rng() & 0xff;
+    uint32_t r = rng() % (a + 1), g = rng() % (a + 1), b = rng() % (a + 1);
+    return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+void draw_something(Layer& l, std::mt19937& rng) {
+    int x = int(rng() % l.pixels.width()), y = int(rng() % l.pixels.height());
+    int w = 1 + int(rng() % 90), h = 1 + int(rng() % 90);
+    switch (rng() % 3) {
+    case 0:
+        l.pixels.fill_rect(x, y, x + w, y + h, premultiplied(rng));
+        break;
+    case 1:
+        l.pixels.set_pixel(x, y, premultiplied(rng));
+        break;
+    default:
+        // Drop a whole tile, like an undo back to before it was drawn on.
+        l.pixels.set_shared_tile(int(rng() % l.pixels.tile_count()), nullptr);
+        break;
+    }
+}
+
+void matches_full_recomposite() {
+    std::mt19937 rng(1);
+    const pixel::BlendMode modes[] = { pixel::BlendMode::source_over, pixel::BlendMode::multiply,
+                                       pixel::BlendMode::screen, pixel::BlendMode::add, pixel::BlendMode::erase };
+    LayerStack stack(300, 200);
+    stack.add_layer("base").pixels.fill_rect(0, 0, 300, 200, 0xff808080u);
+    for (int step = 0; step < 400; step++) {
+        size_t n = stack.layer_count();
+        size_t i = n ? rng() % n : 0;
+        switch (rng() % 9) {
+        case 0:
+            if (n < 6) draw_something(stack.add_layer("layer", rng() % (n + 1)), rng);
+            break;
+        case 1:
+            if (n > 1) stack.remove_layer(i);
+            break;
+        case 2:
+            if (n > 1) stack.move_layer(i, rng() % n);
+            break;
+        case 3:
+            if (n) stack.set_opacity(i, uint8_t(rng() % 3 == 0 ? 0 : rng()));
+            break;
+        case 4:
+            if (n) stack.set_mode(i, modes[rng() % 5]);
+            break;
+        case 5:
+            if (n) stack.set_visible(i, !stack.layer(i).visible());
+            break;
+        default:
+            if (n) draw_something(stack.layer(i), rng);
+            break;
+        }
+        // Sometimes several changes pile up between updates, and a layer may be edited and then
+        // removed before anything is recomposited.
+        if (rng() % 3 == 0) continue;
+        stack.update();
+        CHECK(composite_pixels(stack) == flatten(stack));
+    }
+}
+
+// The case remove_layer() used to get wrong: the layer's last edit drops a tile, then the layer
+// goes before the next update.
+void remove_after_unflushed_edit() {
+    LayerStack stack(128, 128);
+    stack.add_layer("paper").pixels.fill_rect(0, 0, 128, 128, 0xffffffffu);
+    Layer& ink = stack.add_layer("ink");
+    ink.pixels.fill_rect(0, 0, 64, 64, 0xff0000ffu);
+    stack.update();
+    CHECK(stack.composite().pixel(10, 10) == 0xff0000ffu);
+
+    ink.pixels.set_shared_tile(0, nullptr);
+    stack.remove_layer(1);
+    stack.update();
+    CHECK(stack.composite().pixel(10, 10) == 0xffffffffu);
+}
+
+void only_affected_tiles_are_redone() {
+    LayerStack stack(640, 640);   // 10x10 tiles
+    stack.add_layer("paper").pixels.fill_rect(0, 0, 640, 640, 0xffffffffu);
+    Layer& ink = stack.add_layer("ink");
+    CHECK(stack.update() == 100);
+    CHECK(stack.update() == 0);
+
+    ink.pixels.fill_rect(70, 70, 80, 80, 0xff000000u);        // one tile
+    CHECK(stack.update() == 1);
+    ink.pixels.fill_rect(60, 60, 70, 70, 0xff000000u);        // straddles four
+    CHECK(stack.update() == 4);
+
+    // Layer properties redo the tiles the layer has content in, and nothing else.
+    stack.set_opacity(1, 128);
+    CHECK(stack.update() == 4);
+    stack.set_visible(1, false);
+    CHECK(stack.update() == 4);
+    stack.set_visible(1, true);
+    stack.set_mode(1, pixel::BlendMode::multiply);
+    CHECK(stack.update() == 4);
+    stack.move_layer(1, 0);
+    CHECK(stack.update() == 4);
+    stack.set_opacity(0, 128);    // no change
+    CHECK(stack.update() == 0);
+    stack.remove_layer(0);
+    CHECK(stack.update() == 4);
+
+    // The composite's dirty list is what needs uploading.
+    CHECK(stack.composite().dirty_tiles().size() == 100);
+}
+
+// A lone opaque layer's tile is shared with the composite, not copied, and a later edit to the
+// layer doesn't leak into the composite before update().
+void lone_opaque_layer_is_shared() {
+    LayerStack stack(128, 128);
+    Layer& l = stack.add_layer("only");
+    l.pixels.fill_rect(0, 0, 64, 64, 0xff00ff00u);
+    stack.update();
+    CHECK(stack.composite().tile(0) == l.pixels.tile(0));
+    l.pixels.set_pixel(1, 1, 0xff0000ffu);
+    CHECK(stack.composite().pixel(1, 1) == 0xff00ff00u);
+    stack.update();
+    CHECK(stack.composite().pixel(1, 1) == 0xff0000ffu);
+}
+
+// What the app does when the GPU blur overwrites its copy: every tile goes back on the upload
+// list, without recompositing anything or looking like a stroke to the undo history.
+void mark_all_dirty_reuploads() {
+    LayerStack stack(200, 130);
+    stack.add_layer("only").pixels.fill_rect(0, 0, 10, 10, 0xff00ff00u);
+    stack.update();
+    TileCanvas& comp = stack.composite();
+    comp.clear_dirty();
+    comp.clear_touched();
+    comp.mark_all_dirty();
+    comp.mark_all_dirty();
+    CHECK(int(comp.dirty_tiles().size()) == comp.tile_count());
+    CHECK(comp.touched_tiles().empty());
+    CHECK(stack.update() == 0);
+}
+
+int main() {
+    matches_full_recomposite();
+    remove_after_unflushed_edit();
+    only_affected_tiles_are_redone();
+    lone_opaque_layer_is_shared();
+    mark_all_dirty_reuploads();
+    return check::result();
+}
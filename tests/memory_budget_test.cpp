@@ -0,0 +1,221 @@
+// MemoryBudget driven by made up allocation traces: per frame upload churn, textures streamed in
+// and evicted by an LRU cache, render targets recreated on resize. The budget's numbers are checked
+// against a shadow tally kept by the trace, and enforce() against what the evictors were asked for.
+
+#include "memory_budget.h"
+#include "check.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace gpu;
+
+constexpr uint64_t MB = 1024 * 1024;
+
+// What the budget should be reporting, kept independently.
+struct Shadow {
+    std::array<uint64_t, size_t(MemoryCategory::count)> current{}, peak{};
+    std::array<uint32_t, size_t(MemoryCategory::count)> count{};
+    uint64_t total = 0, total_peak = 0, frame_allocated = 0, frame_freed = 0;
+
+    void add(MemoryCategory c, uint64_t bytes) {
+        size_t i = size_t(c);
+        current[i] += bytes;
+        peak[i] = std::max(peak[i], current[i]);
+        count[i]++;
+        total += bytes;
+        total_peak = std::max(total_peak, total);
+        frame_allocated += bytes;
+    }
+
+    void remove(MemoryCategory c, uint64_t bytes) {
+        current[size_t(c)] -= bytes;
+        count[size_t(c)]--;
+        total -= bytes;
+        frame_freed += bytes;
+    }
+
+    bool matches(const MemoryStats& s) const {
+        bool ok = s.current == total && s.peak == total_peak;
+        for (size_t i = 0; i < current.size(); i++) {
+            ok &= s.categories[i].current == current[i] && s.categories[i].peak == peak[i] &&
+                  s.categories[i].count == count[i];
+        }
+        return ok;
+    }
+};
+
+struct Resource {
+    AllocationId id;
+    MemoryCategory category;
+    uint64_t bytes;
+};
+
+// The app's shape over a few thousand frames.
+void synthetic_trace() {
+    std::mt19937 rng(21);
+    MemoryBudget budget(512 * MB);
+    Shadow shadow;
+    auto track = [&](MemoryCategory c, uint64_t bytes, std::string name) {
+        shadow.add(c, bytes);
+        return Resource{ budget.track(c, bytes, std::move(name)), c, bytes };
+    };
+    auto untrack = [&](const Resource& r) {
+        shadow.remove(r.category, r.bytes);
+        budget.untrack(r.id);
+    };
+
+    // Streamed textures, least recently used at the front; the evictor drops from there.
+    std::deque<Resource> textures;
+    std::vector<uint64_t> asked;
+    budget.add_evictor("texture cache", 10, [&](uint64_t over) {
+        asked.push_back(over);
+        uint64_t freed = 0;
+        while (freed < over && !textures.empty()) {
+            freed += textures.front().bytes;
+            untrack(textures.front());
+            textures.pop_front();
+        }
+        return freed;
+    });
+
+    std::vector<Resource> render_targets;
+    auto make_render_targets = [&](uint64_t w, uint64_t h) {
+        for (auto& r : render_targets) untrack(r);
+        render_targets.clear();
+        render_targets.push_back(track(MemoryCategory::render_target, w * h * 4, "back buffer"));
+        render_targets.push_back(track(MemoryCategory::render_target, w * h * 8, "canvas 16f"));
+    };
+    make_render_targets(1920, 1080);
+    Resource mesh = track(MemoryCategory::geometry, 3 * MB, "quad");
+
+    bool consistent = true, churn_ok = true, fits_after_enforce = true, asked_right = true;
+    for (int frame = 0; frame < 3000; frame++) {
+        if (frame % 700 == 699) make_render_targets(1000 + rng() % 3000, 800 + rng() % 1500);
+
+        // A texture might be coming in: make room for it first, the way the streamer does.
+        if (rng() % 3 == 0) {
+            uint64_t bytes = (1 + rng() % 16) * MB;
+            uint64_t over_before = budget.stats().current + bytes > budget.budget()
+                                       ? budget.stats().current + bytes - budget.budget() : 0;
+            asked.clear();
+            bool fits = budget.enforce(bytes);
+            asked_right &= over_before == 0 ? asked.empty() : !asked.empty() && asked[0] == over_before;
+            fits_after_enforce &= fits == (budget.stats().current + bytes <= budget.budget());
+            textures.push_back(track(MemoryCategory::texture, bytes, "streamed"));
+        }
+        // Touching a texture moves it to the back.
+        if (!textures.empty() && rng() % 2 == 0) {
+            size_t i = rng() % textures.size();
+            Resource r = textures[i];
+            textures.erase(textures.begin() + i);
+            textures.push_back(r);
+        }
+
+        // Upload buffers only live for the frame; a readback now and then.
+        std::vector<Resource> uploads;
+        for (int n = rng() % 4; n > 0; n--) uploads.push_back(track(MemoryCategory::upload, (1 + rng() % 8) * MB, ""));
+        if (rng() % 50 == 0) uploads.push_back(track(MemoryCategory::readback, 8 * MB, "readback"));
+        for (auto& u : uploads) untrack(u);
+
+        budget.end_frame();
+        MemoryStats s = budget.stats();
+        churn_ok &= s.frame_allocated == shadow.frame_allocated && s.frame_freed == shadow.frame_freed;
+        shadow.frame_allocated = shadow.frame_freed = 0;
+        consistent &= shadow.matches(s);
+    }
+    CHECK(consistent);
+    CHECK(churn_ok);
+    CHECK(fits_after_enforce);
+    CHECK(asked_right);
+    MemoryStats s = budget.stats();
+    CHECK(s.frames == 3000);
+    CHECK(s.evictions > 0 && s.evicted > 0);
+    CHECK(s[MemoryCategory::geometry].current == 3 * MB);
+    CHECK(budget.dump(1000).find("quad") != std::string::npos);
+    untrack(mesh);
+}
+
+// Several evictors: asked in priority order (ties in the order added), only for what's still over,
+// and not at all once it fits. Evictors that can't help leave it counted as over budget.
+void evictor_order() {
+    MemoryBudget budget(100);
+    std::vector<AllocationId> cheap, dear;
+    for (int i = 0; i < 5; i++) cheap.push_back(budget.track(MemoryCategory::texture, 10));
+    for (int i = 0; i < 5; i++) dear.push_back(budget.track(MemoryCategory::render_target, 10));
+    std::vector<std::string> calls;
+    auto drop = [&](std::vector<AllocationId>& from, std::string name) {
+        return [&, name](uint64_t over) {
+            calls.push_back(name + " " + std::to_string(over));
+            uint64_t freed = 0;
+            while (freed < over && !from.empty()) {
+                budget.untrack(from.back());
+                from.pop_back();
+                freed += 10;
+            }
+            return freed;
+        };
+    };
+    budget.add_evictor("dear", 50, drop(dear, "dear"));
+    int nothing = budget.add_evictor("nothing", 0, [&](uint64_t over) {
+        calls.push_back("nothing " + std::to_string(over));
+        return uint64_t(0);
+    });
+    budget.add_evictor("cheap", 10, drop(cheap, "cheap"));
+    std::vector<AllocationId> never_used;
+    budget.add_evictor("cheap too", 10, drop(never_used, "cheap too"));
+
+    CHECK(budget.enforce());            // exactly at budget
+    CHECK(calls.empty());
+    CHECK(budget.enforce(25));          // 25 over: the cheap ones cover 30
+    CHECK((calls == std::vector<std::string>{ "nothing 25", "cheap 25" }));
+    CHECK(budget.stats().current == 70);
+
+    calls.clear();
+    budget.remove_evictor(nothing);
+    CHECK(budget.enforce(60));          // 30 over: the last 2 cheap ones give 20, dear gives 10
+    CHECK((calls == std::vector<std::string>{ "cheap 30", "cheap too 10", "dear 10" }));
+
+    calls.clear();
+    CHECK(!budget.enforce(1000));       // can't be done
+    MemoryStats s = budget.stats();
+    CHECK(s.current == 0 && s.over_budget == 1);
+    CHECK(s.evicted == 100 && s.evictions == 4);
+
+    budget.set_budget(10);
+    CHECK(budget.enforce(10));
+}
+
+// Startup tracks from several threads at once.
+void tracking_from_threads() {
+    MemoryBudget budget(1ull << 40);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            std::vector<AllocationId> mine;
+            for (int i = 0; i < 2000; i++) {
+                mine.push_back(budget.track(MemoryCategory(i % 5), 100 + t));
+                if (i % 3 == 0) {
+                    budget.untrack(mine.back());
+                    mine.pop_back();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    uint64_t expected = 0;
+    for (int t = 0; t < 4; t++) expected += uint64_t(2000 - 667) * (100 + t);
+    CHECK(budget.stats().current == expected);
+}
+
+int main() {
+    synthetic_trace();
+    evictor_order();
+    tracking_from_threads();
+    return check::result();
+}
@@ -0,0 +1,315 @@
+// The tessellator's triangles against the shapes they stand for: fills of rectangles, ellipses,
+// rounded rectangles and stars add up to their closed form areas under both fill rules, random
+// self intersecting polygons are covered exactly once inside and not at all outside, strokes
+// cover what's within half their width of the line (plus their caps and joins), the antialiasing
+// fringe fades to zero a pixel out, and tessellate() gives the same mesh on any thread count.
+
+#include "path_tessellator.h"
+#include "check.h"
+
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <vector>
+
+using namespace shapes;
+
+constexpr float pi = std::numbers::pi_v<float>;
+
+const TessellateOptions aliased = { 1, 0.25f, false };
+
+double triangle_area(const Mesh& mesh, size_t t) {
+    const ShapeVertex& a = mesh.vertices[mesh.indices[t]];
+    const ShapeVertex& b = mesh.vertices[mesh.indices[t + 1]];
+    const ShapeVertex& c = mesh.vertices[mesh.indices[t + 2]];
+    return std::abs((double(b.x) - a.x) * (double(c.y) - a.y) - (double(c.x) - a.x) * (double(b.y) - a.y)) / 2;
+}
+
+// Total area of the triangles whose corners all have alpha, ie. leaving out the fringe.
+double opaque_area(const Mesh& mesh) {
+    double area = 0;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        bool opaque = true;
+        for (size_t k = 0; k < 3; k++) opaque &= (mesh.vertices[mesh.indices[t + k]].color >> 24) != 0;
+        if (opaque) area += triangle_area(mesh, t);
+    }
+    return area;
+}
+
+// How many triangles have p strictly inside them.
+int cover_count(const Mesh& mesh, Vec2 p) {
+    int count = 0;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        const ShapeVertex& a = mesh.vertices[mesh.indices[t]];
+        const ShapeVertex& b = mesh.vertices[mesh.indices[t + 1]];
+        const ShapeVertex& c = mesh.vertices[mesh.indices[t + 2]];
+        double d0 = (double(b.x) - a.x) * (p.y - a.y) - (double(b.y) - a.y) * (p.x - a.x);
+        double d1 = (double(c.x) - b.x) * (p.y - b.y) - (double(c.y) - b.y) * (p.x - b.x);
+        double d2 = (double(a.x) - c.x) * (p.y - c.y) - (double(a.y) - c.y) * (p.x - c.x);
+        count += (d0 > 0 && d1 > 0 && d2 > 0) || (d0 < 0 && d1 < 0 && d2 < 0);
+    }
+    return count;
+}
+
+bool indices_valid(const Mesh& mesh) {
+    bool ok = mesh.indices.size() % 3 == 0;
+    for (uint32_t i : mesh.indices) ok &= i < mesh.vertices.size();
+    return ok;
+}
+
+float segment_distance(Vec2 p, Vec2 a, Vec2 b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float t = std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / (dx * dx + dy * dy), 0.0f, 1.0f);
+    return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+int winding_number(const std::vector<Vec2>& poly, Vec2 p) {
+    int winding = 0;
+    for (size_t i = 0; i < poly.size(); i++) {
+        Vec2 a = poly[i], b = poly[(i + 1) % poly.size()];
+        float cross = (b.x - a.x) * (p.y - a.y) - (p.x - a.x) * (b.y - a.y);
+        if (a.y <= p.y && b.y > p.y && cross > 0) winding++;
+        if (b.y <= p.y && a.y > p.y && cross < 0) winding--;
+    }
+    return winding;
+}
+
+Path polygon(const std::vector<Vec2>& points) {
+    Path path;
+    path.move_to(points[0].x, points[0].y);
+    for (size_t i = 1; i < points.size(); i++) path.line_to(points[i].x, points[i].y);
+    path.close();
+    return path;
+}
+
+double fill_area(const Path& path, FillRule rule = FillRule::nonzero, TessellateOptions options = aliased) {
+    Mesh mesh;
+    fill_path(path, 0xff0000ffu, rule, options, mesh);
+    return opaque_area(mesh);
+}
+
+bool near(double got, double expected, double tolerance) {
+    return std::abs(got - expected) <= tolerance;
+}
+
+void fill_areas() {
+    CHECK(near(fill_area(Path().rect(10, 20, 300, 150)), 45000, 0.05));
+    CHECK(near(fill_area(Path().rect(10, 20, -300, -150)), 45000, 0.05));
+
+    // Flattened curves are chords, inside the curve by up to the tolerance along its length; the
+    // cubic quarter circle is itself up to 0.03% out.
+    const float rx = 100, ry = 60, perimeter = 2 * pi * std::sqrt((rx * rx + ry * ry) / 2);
+    for (float tolerance : { 0.5f, 0.25f, 0.02f }) {
+        TessellateOptions options = { 1, tolerance, false };
+        double area = fill_area(Path().ellipse(0, 0, rx, ry), FillRule::nonzero, options);
+        double exact = pi * rx * ry;
+        CHECK(area < exact * 1.0006 && area > exact * 0.9994 - perimeter * tolerance);
+        double rounded = fill_area(Path().rounded_rect(0, 0, 200, 100, 30), FillRule::nonzero, options);
+        exact = 200 * 100 - (4 - pi) * 30 * 30;
+        CHECK(rounded < exact + 1 && rounded > exact - 4 * pi / 2 * 30 * tolerance - 1);
+    }
+    // A radius past half the side is clamped, making a stadium.
+    CHECK(near(fill_area(Path().rounded_rect(0, 0, 200, 100, 80), FillRule::nonzero, { 1, 0.02f, false }),
+               100 * 100 + pi * 50 * 50, 15));
+
+    // Two overlapping squares going the same way: union for nonzero, minus the overlap twice for even-odd.
+    Path pair = Path().rect(0, 0, 100, 100).rect(50, 50, 100, 100);
+    CHECK(near(fill_area(pair), 17500, 0.05));
+    CHECK(near(fill_area(pair, FillRule::even_odd), 15000, 0.05));
+    // A square inside going the other way is a hole either way.
+    Path holed = Path().rect(0, 0, 100, 100);
+    holed.move_to(20, 20).line_to(20, 60).line_to(60, 60).line_to(60, 20).close();
+    CHECK(near(fill_area(holed), 10000 - 1600, 0.05));
+    CHECK(near(fill_area(holed, FillRule::even_odd), 10000 - 1600, 0.05));
+
+    // A pentagram {5/2}: nonzero fills the middle pentagon, even-odd leaves it out. The outline is
+    // a ten sided star with inner radius R cos 72 / cos 36; the pentagon is 5/2 r^2 sin 72.
+    const float R = 100, r = R * std::cos(2 * pi / 5) / std::cos(pi / 5);
+    std::vector<Vec2> star;
+    for (int i = 0; i < 5; i++) {
+        float a = -pi / 2 + i * 4 * pi / 5;
+        star.push_back({ R * std::cos(a), R * std::sin(a) });
+    }
+    double outline = 5 * R * r * std::sin(pi / 5);        // ten triangles of sides R, r at 36 degrees
+    double pentagon = 2.5 * r * r * std::sin(2 * pi / 5);
+    CHECK(near(fill_area(polygon(star)), outline, 0.05));
+    CHECK(near(fill_area(polygon(star), FillRule::even_odd), outline - pentagon, 0.05));
+}
+
+// Random polygons, many self intersecting, sampled: each point inside by the rule is covered by
+// exactly one triangle, each outside by none. Points right on an edge are skipped.
+void fills_cover_once() {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> coord(0, 100);
+    bool once = true, valid = true;
+    for (int iter = 0; iter < 200; iter++) {
+        std::vector<Vec2> poly(3 + rng() % 10);
+        for (auto& p : poly) {
+            // Some on a grid, for shared ys and horizontal edges.
+            p = iter % 3 ? Vec2{ coord(rng), coord(rng) } : Vec2{ float(rng() % 6 * 20), float(rng() % 6 * 20) };
+        }
+        for (FillRule rule : { FillRule::nonzero, FillRule::even_odd }) {
+            Mesh mesh;
+            fill_path(polygon(poly), 0xffffffffu, rule, aliased, mesh);
+            valid &= indices_valid(mesh);
+            for (int s = 0; s < 200; s++) {
+                Vec2 p = { coord(rng), coord(rng) };
+                bool on_edge = false;
+                for (size_t i = 0; i < poly.size(); i++) {
+                    on_edge |= segment_distance(p, poly[i], poly[(i + 1) % poly.size()]) < 0.01f;
+                }
+                if (on_edge) continue;
+                int w = winding_number(poly, p);
+                bool in = rule == FillRule::nonzero ? w != 0 : (w & 1) != 0;
+                once &= cover_count(mesh, p) == (in ? 1 : 0);
+            }
+        }
+    }
+    CHECK(once);
+    CHECK(valid);
+}
+
+void stroke_areas() {
+    Path line = Path().move_to(0, 0).line_to(200, 0);
+    auto stroke_area = [&](LineCap cap) {
+        Mesh mesh;
+        stroke_path(line, 0xff000000u, { 10, LineJoin::miter, cap, 4 }, aliased, mesh);
+        return opaque_area(mesh);
+    };
+    CHECK(near(stroke_area(LineCap::butt), 200 * 10, 0.05));
+    CHECK(near(stroke_area(LineCap::square), 210 * 10, 0.05));
+    double round = stroke_area(LineCap::round);
+    CHECK(round <= 2000 + pi * 25 + 0.05 && round > 2000 + pi * 25 - 2 * pi * 5 * 0.25);
+
+    // A closed square with miter joins is a square ring.
+    Mesh ring;
+    stroke_path(Path().rect(0, 0, 100, 100), 0xff000000u, { 10, LineJoin::miter, LineCap::butt, 4 }, aliased, ring);
+    bool ring_ok = true;
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> coord(-10, 110);
+    for (int s = 0; s < 3000; s++) {
+        Vec2 p = { coord(rng), coord(rng) };
+        float outside = std::max({ -5 - p.x, p.x - 105, -5 - p.y, p.y - 105 });
+        float inside = std::min({ p.x - 5, 95 - p.x, p.y - 5, 95 - p.y });
+        if (std::abs(outside) < 0.01f || std::abs(inside) < 0.01f) continue;
+        ring_ok &= (cover_count(ring, p) > 0) == (outside < 0 && inside < 0);
+    }
+    CHECK(ring_ok);
+}
+
+// Round joins and caps: covered within half the width of the polyline, not past it.
+void round_strokes_cover() {
+    const std::vector<Vec2> pts = { { 0, 0 }, { 100, 0 }, { 100, 80 }, { 30, 120 }, { 60, 10 } };
+    Path path;
+    path.move_to(pts[0].x, pts[0].y);
+    for (size_t i = 1; i < pts.size(); i++) path.line_to(pts[i].x, pts[i].y);
+    Mesh mesh;
+    const float half = 6;
+    stroke_path(path, 0xff000000u, { 2 * half, LineJoin::round, LineCap::round, 4 }, aliased, mesh);
+    CHECK(indices_valid(mesh));
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> coord(-10, 130);
+    bool ok = true;
+    for (int s = 0; s < 4000; s++) {
+        Vec2 p = { coord(rng), coord(rng) };
+        float d = 1e9f;
+        for (size_t i = 0; i + 1 < pts.size(); i++) d = std::min(d, segment_distance(p, pts[i], pts[i + 1]));
+        // Round parts are flattened to within the tolerance.
+        if (d < half - 0.3f) ok &= cover_count(mesh, p) > 0;
+        if (d > half + 0.01f) ok &= cover_count(mesh, p) == 0;
+    }
+    CHECK(ok);
+}
+
+void antialiasing() {
+    // The fringe goes from the colour to nothing a pixel out, and leaves the inside alone.
+    const uint32_t color = 0xff2040c0u;
+    for (float pixel_size : { 1.0f, 2.0f }) {
+        TessellateOptions options = { pixel_size, 0.25f, true };
+        Mesh mesh;
+        fill_path(Path().rect(10, 10, 50, 30), color, FillRule::nonzero, options, mesh);
+        bool two_colours = true;
+        float x0 = 1e9f, y0 = 1e9f, x1 = -1e9f, y1 = -1e9f;
+        for (const auto& v : mesh.vertices) {
+            two_colours &= v.color == color || v.color == 0;
+            x0 = std::min(x0, v.x), y0 = std::min(y0, v.y), x1 = std::max(x1, v.x), y1 = std::max(y1, v.y);
+        }
+        CHECK(two_colours);
+        CHECK(x0 == 10 - pixel_size && y0 == 10 - pixel_size && x1 == 60 + pixel_size && y1 == 40 + pixel_size);
+        CHECK(near(opaque_area(mesh), 50 * 30, 0.05));
+    }
+    // The opaque core of an antialiased stroke is a pixel narrower; hairlines fade instead.
+    Mesh wide, thin;
+    Path line = Path().move_to(0, 0).line_to(100, 0);
+    stroke_path(line, color, { 6, LineJoin::miter, LineCap::butt, 4 }, { 1, 0.25f, true }, wide);
+    CHECK(near(opaque_area(wide), 100 * 5, 0.05));
+    stroke_path(line, 0xffffffffu, { 0.5f, LineJoin::miter, LineCap::butt, 4 }, { 1, 0.25f, true }, thin);
+    bool faded = true;
+    for (const auto& v : thin.vertices) faded &= (v.color >> 24) <= 0x80;
+    CHECK(faded && !thin.vertices.empty());
+}
+
+void degenerate() {
+    Mesh mesh;
+    fill_path(Path(), 0xff000000u, FillRule::nonzero, aliased, mesh);
+    fill_path(Path().move_to(5, 5), 0xff000000u, FillRule::nonzero, aliased, mesh);
+    fill_path(Path().rect(0, 0, 100, 0), 0xff000000u, FillRule::nonzero, aliased, mesh);
+    fill_path(Path().move_to(0, 0).line_to(10, 10).close(), 0xff000000u, FillRule::nonzero, aliased, mesh);
+    stroke_path(Path().move_to(5, 5), 0xff000000u, {}, aliased, mesh);
+    stroke_path(Path().rect(0, 0, 10, 10), 0xff000000u, { 0 }, aliased, mesh);
+    CHECK(opaque_area(mesh) == 0);
+    CHECK(indices_valid(mesh));
+}
+
+void threads_agree() {
+    std::mt19937 rng(4);
+    std::vector<Path> paths(300);
+    std::vector<ShapeDraw> draws(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        float x = float(rng() % 500), y = float(rng() % 500);
+        switch (i % 3) {
+        case 0: paths[i].ellipse(x, y, 5 + float(rng() % 40), 5 + float(rng() % 40)); break;
+        case 1: paths[i].rounded_rect(x, y, 60, 30, 8); break;
+        case 2:
+            paths[i].move_to(x, y).quad_to(x + 50, y - 40, x + 100, y).cubic_to(x, y + 10, x + 30, y + 80, x, y);
+            break;
+        }
+        draws[i] = { &paths[i], uint32_t(0xff000000u | rng()), i % 2 ? FillRule::even_odd : FillRule::nonzero,
+                     std::nullopt };
+        if (i % 4 == 0) draws[i].stroke = Stroke{ 3, LineJoin(i % 3), LineCap(i / 4 % 3), 4 };
+    }
+    std::vector<MeshRange> one_ranges, many_ranges;
+    Mesh one = tessellate(draws, {}, one_ranges, 1);
+    Mesh many = tessellate(draws, {}, many_ranges, 4);
+    bool same = one.indices == many.indices && one.vertices.size() == many.vertices.size();
+    for (size_t i = 0; same && i < one.vertices.size(); i++) {
+        same &= one.vertices[i].x == many.vertices[i].x && one.vertices[i].y == many.vertices[i].y &&
+                one.vertices[i].color == many.vertices[i].color;
+    }
+    CHECK(same);
+    CHECK(indices_valid(one));
+
+    // Each range is that draw's own mesh, in order and back to back.
+    bool ranges_ok = one_ranges.size() == draws.size();
+    uint32_t at = 0;
+    for (size_t i = 0; ranges_ok && i < draws.size(); i++) {
+        Mesh own;
+        if (draws[i].stroke) stroke_path(paths[i], draws[i].color, *draws[i].stroke, {}, own);
+        else fill_path(paths[i], draws[i].color, draws[i].fill_rule, {}, own);
+        ranges_ok &= one_ranges[i].start_index == at && one_ranges[i].index_count == own.indices.size();
+        at += one_ranges[i].index_count;
+        ranges_ok &= many_ranges[i].start_index == one_ranges[i].start_index;
+    }
+    CHECK(ranges_ok && at == one.indices.size());
+}
+
+int main() {
+    fill_areas();
+    fills_cover_once();
+    stroke_areas();
+    round_strokes_cover();
+    antialiasing();
+    degenerate();
+    threads_agree();
+    return check::result();
+}
@@ -0,0 +1,214 @@
+// Pixel format conversions: every path gives the scalar reference's bits, the scalar reference is
+// right for every input it can get (all 64K (channel, alpha) pairs, all 64K halves, all 256 sRGB
+// codes), and in-place, streaming and unaligned calls agree with the plain ones.
+
+#include "pixel_formats.h"
+#include "check.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace pixel;
+
+const simd::Level all_levels[] = { simd::Level::scalar, simd::Level::sse41, simd::Level::avx2 };
+const StoreMode store_modes[] = { StoreMode::cached, StoreMode::streaming };
+
+// Every (channel, alpha) pair, in all three colour channels.
+std::vector<uint32_t> all_channel_alpha_pairs() {
+    std::vector<uint32_t> pixels(65536);
+    for (uint32_t i = 0; i < 65536; i++) {
+        uint32_t c = i & 0xff, a = i >> 8;
+        pixels[i] = (a << 24) | (c << 16) | ((255 - c) << 8) | c;
+    }
+    return pixels;
+}
+
+void premultiply_exhaustive() {
+    auto src = all_channel_alpha_pairs();
+    for (simd::Level level : all_levels) {
+        std::vector<uint32_t> dst(src.size());
+        premultiply_rgba8(dst.data(), src.data(), src.size(), StoreMode::cached, level);
+        bool exact = true;
+        for (uint32_t i = 0; i < 65536; i++) {
+            uint32_t c = i & 0xff, a = i >> 8;
+            uint32_t pc = uint32_t(std::lround(c * a / 255.0)), pd = uint32_t(std::lround((255 - c) * a / 255.0));
+            exact &= dst[i] == ((a << 24) | (pc << 16) | (pd << 8) | pc);
+        }
+        CHECK(exact);
+    }
+}
+
+void unpremultiply_exhaustive() {
+    auto src = all_channel_alpha_pairs();
+    std::vector<uint32_t> expected(src.size());
+    unpremultiply_rgba8(expected.data(), src.data(), src.size(), StoreMode::cached, simd::Level::scalar);
+    bool exact = true;
+    for (uint32_t i = 0; i < 65536; i++) {
+        uint32_t c = i & 0xff, a = i >> 8;
+        uint32_t want = 0;
+        if (a) {
+            uint32_t uc = std::min<uint32_t>(uint32_t(std::nearbyint(c * 255.0 / a)), 255);
+            uint32_t ud = std::min<uint32_t>(uint32_t(std::nearbyint((255 - c) * 255.0 / a)), 255);
+            want = (a << 24) | (uc << 16) | (ud << 8) | uc;
+        }
+        exact &= expected[i] == want;
+    }
+    CHECK(exact);
+    for (simd::Level level : all_levels) {
+        std::vector<uint32_t> dst(src.size());
+        unpremultiply_rgba8(dst.data(), src.data(), src.size(), StoreMode::cached, level);
+        CHECK(dst == expected);
+    }
+
+    // Premultiplying what unpremultiply gives back lands on the same premultiplied pixel, for
+    // every valid premultiplied pixel.
+    std::vector<uint32_t> valid;
+    for (uint32_t a = 0; a < 256; a++) {
+        for (uint32_t c = 0; c <= a; c++) valid.push_back((a << 24) | (c << 16) | (c << 8) | c);
+    }
+    std::vector<uint32_t> straight(valid.size()), again(valid.size());
+    unpremultiply_rgba8(straight.data(), valid.data(), valid.size());
+    premultiply_rgba8(again.data(), straight.data(), straight.size());
+    CHECK(again == valid);
+}
+
+void half_packing_exhaustive() {
+    // All 256 UNORM values to half: c/255 correctly rounded, and back again unchanged.
+    std::vector<uint32_t> codes(256);
+    for (uint32_t c = 0; c < 256; c++) codes[c] = c * 0x01010101u;
+    for (simd::Level level : all_levels) {
+        std::vector<uint16_t> halves(4 * 256);
+        unorm8_to_half(halves.data(), codes.data(), 256, StoreMode::cached, level);
+        bool exact = true;
+        for (uint32_t c = 0; c < 256; c++) {
+            uint16_t want = float_to_half(float(c / 255.0));
+            for (int k = 0; k < 4; k++) exact &= halves[4 * c + k] == want;
+        }
+        CHECK(exact);
+        std::vector<uint32_t> back(256);
+        half_to_unorm8(back.data(), halves.data(), 256, StoreMode::cached, level);
+        CHECK(back == codes);
+    }
+
+    // All 64K halves to UNORM: clamped to [0,1] (NaN to 0), times 255, rounded to nearest even.
+    std::vector<uint16_t> halves(4 * 65536);
+    for (uint32_t h = 0; h < 65536; h++) {
+        for (int k = 0; k < 4; k++) halves[4 * h + k] = uint16_t(h);
+    }
+    for (simd::Level level : all_levels) {
+        std::vector<uint32_t> unorm(65536);
+        half_to_unorm8(unorm.data(), halves.data(), 65536, StoreMode::cached, level);
+        bool exact = true;
+        for (uint32_t h = 0; h < 65536; h++) {
+            float f = half_to_float(uint16_t(h));
+            f = std::isnan(f) ? 0.0f : std::clamp(f, 0.0f, 1.0f);
+            exact &= unorm[h] == uint32_t(std::nearbyint(f * 255.0f)) * 0x01010101u;
+        }
+        CHECK(exact);
+    }
+}
+
+double srgb_to_linear(double c) {
+    return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+void srgb_exhaustive() {
+    std::vector<uint32_t> codes(256);
+    for (uint32_t c = 0; c < 256; c++) codes[c] = (c << 24) | (c << 16) | (c << 8) | c;
+
+    // sRGB8 in: the correctly rounded linear value; alpha is just c/255.
+    std::vector<uint16_t> halves(4 * 256);
+    srgb8_to_linear_half(halves.data(), codes.data(), 256);
+    std::vector<float> floats(4 * 256);
+    srgb8_to_linear_float(floats.data(), codes.data(), 256);
+    bool exact = true;
+    for (uint32_t c = 0; c < 256; c++) {
+        double l = srgb_to_linear(c / 255.0);
+        exact &= halves[4 * c] == float_to_half(float(l)) && halves[4 * c + 3] == float_to_half(float(c / 255.0));
+        exact &= floats[4 * c] == float(l) && std::abs(floats[4 * c + 3] - c / 255.0f) < 1e-7f;
+    }
+    CHECK(exact);
+
+    // And back, unchanged, both ways.
+    std::vector<uint32_t> back(256);
+    linear_half_to_srgb8(back.data(), halves.data(), 256);
+    CHECK(back == codes);
+    linear_float_to_srgb8(back.data(), floats.data(), 256);
+    CHECK(back == codes);
+
+    // Linear in, every half: the sRGB code whose linear value is nearest in sRGB space, ie. no
+    // code is closer to the exact encoding than the one picked.
+    std::vector<uint16_t> all(4 * 65536);
+    for (uint32_t h = 0; h < 65536; h++) {
+        for (int k = 0; k < 3; k++) all[4 * h + k] = uint16_t(h);
+        all[4 * h + 3] = 0x3c00;
+    }
+    std::vector<uint32_t> srgb(65536);
+    linear_half_to_srgb8(srgb.data(), all.data(), 65536);
+    bool nearest = true;
+    for (uint32_t h = 0; h < 65536; h++) {
+        double f = half_to_float(uint16_t(h));
+        f = std::isnan(f) ? 0.0 : std::clamp(f, 0.0, 1.0);
+        double e = 255 * (f <= 0.0031308 ? f * 12.92 : 1.055 * std::pow(f, 1 / 2.4) - 0.055);
+        uint32_t code = srgb[h] & 0xff;
+        nearest &= std::abs(code - e) <= 0.5 + 1e-9 && (srgb[h] >> 24) == 255;
+        nearest &= ((srgb[h] >> 8) & 0xff) == code && ((srgb[h] >> 16) & 0xff) == code;
+    }
+    CHECK(nearest);
+}
+
+// Every SIMD kernel against scalar, at every count up to a few vectors and every dst/src alignment,
+// cached and streaming, out of place and in place.
+template <typename Dst, typename Src, typename Fn>
+void agrees_with_scalar(Fn fn, size_t dst_per_pixel, size_t src_per_pixel, bool in_place) {
+    std::mt19937 rng(4);
+    const size_t max_count = 70, pad = 8;
+    std::vector<Src> src(src_per_pixel * (max_count + pad));
+    for (auto& v : src) v = Src(rng());
+    bool same = true;
+    for (size_t count = 0; count <= max_count; count++) {
+        for (size_t offset = 0; offset < pad; offset++) {
+            const Src* s = src.data() + offset * src_per_pixel;
+            std::vector<Dst> expected(dst_per_pixel * (count + pad));
+            fn(expected.data() + offset * dst_per_pixel, s, count, StoreMode::cached, simd::Level::scalar);
+            for (simd::Level level : all_levels) {
+                for (StoreMode store : store_modes) {
+                    std::vector<Dst> got(expected.size());
+                    fn(got.data() + offset * dst_per_pixel, s, count, store, level);
+                    same &= got == expected;
+                    if (in_place) {
+                        std::vector<Src> buffer(src.begin(), src.begin() + expected.size());
+                        auto p = reinterpret_cast<Dst*>(buffer.data()) + offset * dst_per_pixel;
+                        fn(p, reinterpret_cast<const Src*>(p), count, store, level);
+                        size_t bytes = count * dst_per_pixel * sizeof(Dst);
+                        same &= std::memcmp(p, expected.data() + offset * dst_per_pixel, bytes) == 0;
+                    }
+                }
+            }
+        }
+    }
+    CHECK(same);
+}
+
+void every_path_agrees() {
+    agrees_with_scalar<uint32_t, uint32_t>(swizzle_rgba_bgra, 1, 1, true);
+    agrees_with_scalar<uint32_t, uint32_t>(premultiply_rgba8, 1, 1, true);
+    agrees_with_scalar<uint32_t, uint32_t>(unpremultiply_rgba8, 1, 1, true);
+    agrees_with_scalar<uint16_t, uint32_t>(unorm8_to_half, 4, 1, false);
+    agrees_with_scalar<uint32_t, uint16_t>(half_to_unorm8, 1, 4, false);
+
+    uint32_t p = 0x80402010u, q;
+    swizzle_rgba_bgra(&q, &p, 1);
+    CHECK(q == 0x80102040u);
+}
+
+int main() {
+    premultiply_exhaustive();
+    unpremultiply_exhaustive();
+    half_packing_exhaustive();
+    srgb_exhaustive();
+    every_path_agrees();
+    return check::result();
+}
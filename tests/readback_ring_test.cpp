@@ -0,0 +1,136 @@
+// ReadbackRing's slot bookkeeping: slots come back in fence order and only once the fence has
+// passed, a full ring or an oversized region is refused rather than waited on, and a random mix of
+// acquire/submit/cancel/collect against a simple model never hands out a slot that's still busy.
+
+#include "readback_ring.h"
+#include "check.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace gpu;
+
+struct Memory {
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<std::span<const uint8_t>> spans;
+
+    Memory(size_t count, size_t bytes) : buffers(count, std::vector<uint8_t>(bytes)) {
+        for (auto& b : buffers) spans.push_back(b);
+    }
+};
+
+void basics() {
+    Memory memory(3, 64 * 1024);
+    ReadbackRing ring(memory.spans);
+    CHECK(ring.slot_count() == 3);
+    CHECK(ring.slot_bytes(0) == 64 * 1024);
+
+    // 128 rows of 128 pixels fit at a 512 byte pitch (the last row needs no padding); 129 don't.
+    CHECK(ring.acquire(9, { 0, 0, 128, 129 }, 512) == -1);
+    int a = ring.acquire(1, { 0, 0, 128, 128 }, 512);
+    int b = ring.acquire(2, { 0, 0, 16, 16 }, 256);
+    int c = ring.acquire(3, { 0, 0, 16, 16 }, 256);
+    CHECK(a >= 0 && b >= 0 && c >= 0 && a != b && b != c && a != c);
+    CHECK(ring.acquire(4, { 0, 0, 1, 1 }, 4) == -1);    // full: refused, not waited on
+
+    ring.cancel(c);
+    ring.submit(a, 10);
+    ring.submit(b, 11);
+    CHECK(ring.in_flight() == 2);
+
+    std::vector<uint64_t> tags;
+    auto record = [&](const ReadbackView& v) { tags.push_back(v.tag); };
+    CHECK(ring.collect(9, record) == 0);
+    CHECK(ring.collect(10, record) == 1);
+    CHECK(tags == std::vector<uint64_t>{ 1 });
+    CHECK(ring.collect(100, record) == 1);
+    CHECK(tags == (std::vector<uint64_t>{ 1, 2 }));
+    CHECK(ring.in_flight() == 0);
+
+    // Everything is free again, and the view points at the slot's memory with what was asked for.
+    int d = ring.acquire(5, { 3, 4, 5, 6 }, 64);
+    ring.submit(d, 12);
+    ring.collect(12, [&](const ReadbackView& v) {
+        CHECK(v.data == memory.buffers[d].data());
+        CHECK(v.region.x == 3 && v.region.y == 4 && v.region.width == 5 && v.region.height == 6);
+        CHECK(v.row_pitch == 64);
+    });
+
+    // An empty region needs no bytes.
+    Memory none(1, 0);
+    ReadbackRing empty(none.spans);
+    CHECK(empty.acquire(1, { 0, 0, 0, 0 }, 0) == 0);
+}
+
+// Random operations against a model that tracks what each slot is doing.
+void random_against_model() {
+    std::mt19937 rng(7);
+    const size_t slots = 5;
+    Memory memory(slots, 4096);
+    ReadbackRing ring(memory.spans);
+
+    enum { free_, recording, in_flight };
+    std::vector<int> state(slots, free_);
+    std::map<int, uint64_t> fence_of;     // in flight slots
+    uint64_t fence = 0, completed = 0, tag = 0;
+    std::map<uint64_t, int> slot_of_tag;
+    uint64_t last_collected_fence = 0;
+    bool ok = true;
+
+    for (int step = 0; step < 20000; step++) {
+        switch (rng() % 4) {
+        case 0: {
+            uint32_t w = 1 + rng() % 40, h = 1 + rng() % 40;
+            int s = ring.acquire(++tag, { 0, 0, w, h }, 4 * w);
+            bool fits = size_t(w) * h * 4 <= 4096;
+            bool any_free = std::count(state.begin(), state.end(), free_) > 0;
+            if (s < 0) {
+                ok &= !fits || !any_free;
+            } else {
+                ok &= fits && state[s] == free_;
+                state[s] = recording;
+                slot_of_tag[tag] = s;
+            }
+            break;
+        }
+        case 1:
+        case 2:
+            for (size_t s = 0; s < slots; s++) {
+                if (state[s] != recording) continue;
+                if (rng() % 5 == 0) {
+                    ring.cancel(int(s));
+                    state[s] = free_;
+                } else {
+                    fence += rng() % 2;     // several copies can share a frame's fence
+                    ring.submit(int(s), fence);
+                    state[s] = in_flight;
+                    fence_of[int(s)] = fence;
+                }
+                break;
+            }
+            break;
+        default:
+            completed = std::min(fence, completed + rng() % 3);
+            ring.collect(completed, [&](const ReadbackView& v) {
+                int s = slot_of_tag[v.tag];
+                ok &= state[s] == in_flight && fence_of[s] <= completed && fence_of[s] >= last_collected_fence;
+                last_collected_fence = fence_of[s];
+                state[s] = free_;
+                fence_of.erase(s);
+            });
+            // Nothing whose fence has passed is left behind.
+            for (auto [s, f] : fence_of) ok &= f > completed;
+            break;
+        }
+        ok &= ring.in_flight() == fence_of.size();
+    }
+    CHECK(ok);
+}
+
+int main() {
+    basics();
+    random_against_model();
+    return check::result();
+}
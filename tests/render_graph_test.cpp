@@ -0,0 +1,341 @@
+// RenderGraph without a device: culling keeps exactly what an imported resource or a side effect
+// needs; transients that are alive at the same time never share memory, worked out here from the
+// passes rather than taken from the graph; the barriers bring every resource into the state each
+// pass asks for, and leave imports in their final state; and a blur chain's heap doesn't grow
+// with the number of passes.
+
+#include "render_graph.h"
+#include "check.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace gpu;
+
+constexpr uint64_t KB = 1024;
+
+// 4 bytes a texel, in 64 KB pages, like a placed D3D12 texture.
+Placement place(const TransientDesc& desc, uint32_t) {
+    uint64_t bytes = uint64_t(desc.width) * desc.height * 4;
+    return { (bytes + 64 * KB - 1) / (64 * KB) * (64 * KB), 64 * KB };
+}
+
+// Passes as the test sees them, so checks don't depend on what the graph kept.
+struct PassUses {
+    std::vector<std::pair<ResourceHandle, Access>> uses;
+};
+
+// Runs the graph, replaying its barriers on a state table and checking each pass finds its
+// resources in the states it declared. Transients start in none; aliasing barriers have to come
+// before an aliased transient's first use.
+struct Checker {
+    RenderGraph& graph;
+    const std::vector<PassUses>& passes;
+    std::vector<Access> state;
+    std::vector<bool> alias_seen;
+    std::vector<uint32_t> ran;
+    bool before_matches = true, states_match = true, aliasing_first = true;
+
+    Checker(RenderGraph& g, const std::vector<PassUses>& p) : graph(g), passes(p) {
+        state.resize(g.resource_count(), Access::none);
+        alias_seen.resize(g.resource_count(), false);
+    }
+
+    void barriers(std::span<const Barrier> batch) {
+        for (const Barrier& b : batch) {
+            uint32_t r = b.resource.index;
+            if (b.kind == Barrier::Kind::aliasing) {
+                alias_seen[r] = true;
+                continue;
+            }
+            before_matches &= b.before == state[r];
+            if (graph.transient(b.resource) && b.before == Access::none && graph.aliased(b.resource)) {
+                aliasing_first &= alias_seen[r];
+            }
+            state[r] = b.after;
+        }
+    }
+
+    void run(uint32_t pass) {
+        ran.push_back(pass);
+        for (auto [r, access] : passes[pass].uses) states_match &= state[r.index] == access;
+    }
+};
+
+// Live ranges from the passes that weren't culled, positions counted among those.
+std::vector<std::pair<int, int>> lifetimes(const RenderGraph& graph, const std::vector<PassUses>& passes) {
+    std::vector<std::pair<int, int>> range(graph.resource_count(), { -1, -1 });
+    int position = 0;
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        if (graph.culled(p)) continue;
+        for (auto [r, access] : passes[p].uses) {
+            if (range[r.index].first < 0) range[r.index].first = position;
+            range[r.index].second = position;
+        }
+        position++;
+    }
+    return range;
+}
+
+// Memory checks for a compiled graph.
+bool placement_is_sound(const RenderGraph& graph, const std::vector<PassUses>& passes) {
+    auto range = lifetimes(graph, passes);
+    bool ok = true;
+    uint64_t unaliased = 0;
+    for (uint32_t a = 0; a < graph.resource_count(); a++) {
+        ResourceHandle ha = { a };
+        if (!graph.transient(ha)) continue;
+        ok &= graph.used(ha) == (range[a].first >= 0);
+        if (!graph.used(ha)) continue;
+        unaliased += graph.size(ha);
+        ok &= graph.offset(ha) % place(graph.desc(ha), 0).alignment == 0;
+        ok &= graph.offset(ha) + graph.size(ha) <= graph.heap_size(graph.heap_class(ha));
+        bool shares = false;
+        for (uint32_t b = 0; b < graph.resource_count(); b++) {
+            ResourceHandle hb = { b };
+            if (a == b || !graph.transient(hb) || !graph.used(hb) || graph.heap_class(ha) != graph.heap_class(hb)) {
+                continue;
+            }
+            bool memory = graph.offset(ha) < graph.offset(hb) + graph.size(hb) &&
+                          graph.offset(hb) < graph.offset(ha) + graph.size(ha);
+            bool time = range[a].first <= range[b].second && range[b].first <= range[a].second;
+            ok &= !(memory && time);
+            shares |= memory;
+        }
+        ok &= graph.aliased(ha) == shares;
+    }
+    ok &= graph.stats().unaliased_bytes == unaliased;
+    ok &= graph.heap_size(HeapClass::targets) + graph.heap_size(HeapClass::textures) <= unaliased;
+    return ok;
+}
+
+void culling() {
+    RenderGraph graph;
+    std::vector<PassUses> passes;
+    int back_buffer_key = 0, readback_key = 0;
+    TransientDesc desc = { 256, 256, 28 };
+    auto back = graph.import_resource("back buffer", &back_buffer_key, Access::present, Access::present);
+    auto readback = graph.import_resource("readback", &readback_key, Access::copy_dst, Access::copy_dst);
+    auto scene = graph.create_texture("scene", desc);
+    auto bloom = graph.create_texture("bloom", desc);      // only read by a pass that's culled
+    auto bloom2 = graph.create_texture("bloom 2", desc);
+    auto debug = graph.create_texture("debug", desc);      // never read
+    auto unused = graph.create_texture("unused", desc);    // no pass at all
+
+    std::vector<uint32_t> ran;
+    auto add = [&](const char* name, std::vector<std::pair<ResourceHandle, Access>> uses, bool side_effect = false) {
+        uint32_t index = uint32_t(passes.size());
+        auto builder = graph.add_pass(name, [&ran, index] { ran.push_back(index); });
+        for (auto [r, a] : uses) {
+            if (is_write(a)) builder.write(r, a);
+            else builder.read(r, a);
+        }
+        if (side_effect) builder.side_effect();
+        passes.push_back({ uses });
+    };
+    add("scene", { { scene, Access::render_target } });                                            // 0 kept
+    add("bloom", { { scene, Access::shader_read }, { bloom, Access::render_target } });            // 1 culled
+    add("bloom 2", { { bloom, Access::shader_read }, { bloom2, Access::render_target } });         // 2 culled
+    add("debug", { { scene, Access::shader_read }, { debug, Access::unordered } });                // 3 culled
+    add("composite", { { scene, Access::shader_read }, { back, Access::render_target } });         // 4 kept
+    add("stats", { { scene, Access::compute_read } }, true);                                       // 5 kept
+    add("copy out", { { scene, Access::copy_src }, { readback, Access::copy_dst } });              // 6 kept
+    graph.compile(place);
+
+    CHECK(!graph.culled(0) && graph.culled(1) && graph.culled(2) && graph.culled(3));
+    CHECK(!graph.culled(4) && !graph.culled(5) && !graph.culled(6));
+    CHECK(graph.stats().culled == 3 && graph.stats().passes == 4);
+    CHECK(graph.used(scene) && !graph.used(bloom) && !graph.used(bloom2) && !graph.used(debug) && !graph.used(unused));
+    CHECK(graph.stats().transients == 1);
+    CHECK(graph.report().find("bloom (culled)") != std::string::npos);
+
+    Checker checker(graph, passes);
+    graph.execute([&](std::span<const Barrier> b) { checker.barriers(b); });
+    CHECK((ran == std::vector<uint32_t>{ 0, 4, 5, 6 }));
+    CHECK(graph.first_access(scene) == Access::render_target);
+    CHECK(graph.usage(scene) == (usage_bit(Access::render_target) | usage_bit(Access::shader_read) |
+                                 usage_bit(Access::compute_read) | usage_bit(Access::copy_src)));
+    CHECK(graph.heap_class(scene) == HeapClass::targets);
+}
+
+// Barriers and states on a hand built frame: every transition is from the state the resource is
+// really in, passes see what they declared, imports end where they asked to.
+void barriers() {
+    RenderGraph graph;
+    std::vector<PassUses> passes;
+    int key = 0;
+    auto back = graph.import_resource("back buffer", &key, Access::present, Access::present);
+    auto layers = graph.import_resource("layers", &key, Access::shader_read, Access::shader_read);
+    auto a = graph.create_texture("a", { 512, 512, 28 });
+    auto b = graph.create_texture("b", { 512, 512, 28 });
+    auto c = graph.create_texture("c", { 512, 512, 28 });
+    std::vector<std::pair<ResourceHandle, Access>> uses[] = {
+        { { layers, Access::compute_read }, { a, Access::unordered } },
+        { { a, Access::compute_read }, { b, Access::unordered } },
+        { { b, Access::copy_src }, { layers, Access::copy_dst } },
+        { { layers, Access::compute_read }, { c, Access::unordered } },
+        { { c, Access::shader_read }, { back, Access::render_target } },
+    };
+    Checker* checker = nullptr;
+    for (uint32_t p = 0; p < std::size(uses); p++) {
+        auto builder = graph.add_pass("pass " + std::to_string(p), [&checker, p] { checker->run(p); });
+        for (auto [r, access] : uses[p]) {
+            if (is_write(access)) builder.write(r, access);
+            else builder.read(r, access);
+        }
+        passes.push_back({ uses[p] });
+    }
+    graph.compile(place);
+    Checker check_states(graph, passes);
+    checker = &check_states;
+    check_states.state[back.index] = Access::present;
+    check_states.state[layers.index] = Access::shader_read;
+    std::vector<size_t> batch_sizes;
+    graph.execute([&](std::span<const Barrier> batch) {
+        batch_sizes.push_back(batch.size());
+        check_states.barriers(batch);
+    });
+    CHECK(check_states.before_matches);
+    CHECK(check_states.states_match);
+    CHECK(check_states.aliasing_first);
+    CHECK(check_states.ran.size() == 5);
+    CHECK(check_states.state[back.index] == Access::present);
+    CHECK(check_states.state[layers.index] == Access::shader_read);
+
+    // All three are compute textures. a dies before c is born, so c takes its memory; b overlaps both.
+    CHECK(graph.offset(c) == graph.offset(a) && graph.aliased(a) && graph.aliased(c) && !graph.aliased(b));
+    CHECK(graph.heap_size(HeapClass::textures) == 2 * graph.size(a));
+    CHECK(placement_is_sound(graph, passes));
+    size_t total = 0;
+    for (size_t n : batch_sizes) total += n;
+    CHECK(total == graph.stats().barriers);
+}
+
+// Rows then columns then rows..., each pass into a transient of its own: the heap holds two of
+// them however long the chain gets.
+uint64_t blur_chain(uint32_t length, uint64_t* unaliased) {
+    RenderGraph graph;
+    std::vector<PassUses> passes;
+    int key = 0;
+    auto layers = graph.import_resource("layers", &key, Access::shader_read, Access::shader_read);
+    TransientDesc desc = { 1024, 1024, 28 };
+    ResourceHandle source = layers;
+    for (uint32_t i = 0; i < length; i++) {
+        auto blurred = graph.create_texture("blur " + std::to_string(i), desc);
+        graph.add_pass("blur", [] {}).read(source, Access::compute_read).write(blurred, Access::unordered);
+        passes.push_back({ { { source, Access::compute_read }, { blurred, Access::unordered } } });
+        source = blurred;
+    }
+    graph.add_pass("copy back", [] {}).read(source, Access::copy_src).write(layers, Access::copy_dst);
+    passes.push_back({ { { source, Access::copy_src }, { layers, Access::copy_dst } } });
+    graph.compile(place);
+
+    Checker checker(graph, passes);
+    checker.state[layers.index] = Access::shader_read;
+    graph.execute([&](std::span<const Barrier> b) { checker.barriers(b); });
+    CHECK(checker.before_matches && checker.aliasing_first);
+    CHECK(checker.state[layers.index] == Access::shader_read);
+    CHECK(placement_is_sound(graph, passes));
+    CHECK(graph.stats().culled == 0 && graph.stats().transients == length);
+    *unaliased = graph.stats().unaliased_bytes;
+    return graph.heap_size(HeapClass::textures);
+}
+
+void blur_chains_dont_grow() {
+    uint64_t one = place({ 1024, 1024, 28 }, 0).size;
+    for (uint32_t length : { 2u, 8u, 32u }) {
+        uint64_t unaliased = 0;
+        CHECK(blur_chain(length, &unaliased) == 2 * one);
+        CHECK(unaliased == length * one);
+    }
+}
+
+// Random frames: random passes over random resources, some passes side effects, some transients
+// never touched. Everything the other tests check, on graphs nobody drew by hand.
+void random_graphs() {
+    std::mt19937 rng(17);
+    bool sound = true, before_matches = true, states_match = true, aliasing_first = true, culled_right = true;
+    for (int round = 0; round < 300; round++) {
+        RenderGraph graph;
+        std::vector<PassUses> passes;
+        int key = 0;
+        std::vector<ResourceHandle> resources;
+        std::vector<Access> initial;
+        uint32_t imports = 1 + rng() % 3, transients = 1 + rng() % 12;
+        for (uint32_t i = 0; i < imports; i++) {
+            Access a = rng() % 2 ? Access::shader_read : Access::present;
+            resources.push_back(graph.import_resource("import", &key, a, Access::shader_read));
+            initial.push_back(a);
+        }
+        for (uint32_t i = 0; i < transients; i++) {
+            TransientDesc desc = { 64u << (rng() % 4), 64u << (rng() % 4), 28 };
+            resources.push_back(graph.create_texture("t" + std::to_string(i), desc));
+            initial.push_back(Access::none);
+        }
+        const Access reads[] = { Access::shader_read, Access::compute_read, Access::copy_src, Access::depth_read };
+        const Access writes[] = { Access::render_target, Access::unordered, Access::copy_dst, Access::depth_write };
+        Checker* checker = nullptr;
+        uint32_t pass_count = 1 + rng() % 20;
+        std::vector<bool> side_effect(pass_count);
+        for (uint32_t p = 0; p < pass_count; p++) {
+            PassUses pass;
+            std::vector<bool> taken(resources.size(), false);
+            for (int n = 1 + rng() % 3; n > 0; n--) {
+                uint32_t r = rng() % resources.size();
+                if (taken[r]) continue;
+                taken[r] = true;
+                bool write = rng() % 2;
+                pass.uses.push_back({ resources[r], write ? writes[rng() % 4] : reads[rng() % 4] });
+            }
+            auto builder = graph.add_pass("p", [&checker, p] { checker->run(p); });
+            for (auto [r, access] : pass.uses) {
+                if (is_write(access)) builder.write(r, access);
+                else builder.read(r, access);
+            }
+            side_effect[p] = rng() % 10 == 0;
+            if (side_effect[p]) builder.side_effect();
+            passes.push_back(std::move(pass));
+        }
+        graph.compile(place);
+
+        // A pass is live iff it's a side effect, writes an import or writes something a live later
+        // pass reads. Checked from the last pass back, so the later passes' answers are known good.
+        for (uint32_t p = pass_count; p-- > 0;) {
+            bool needed = side_effect[p];
+            for (auto [r, access] : passes[p].uses) {
+                if (!is_write(access)) continue;
+                needed |= !graph.transient(r);
+                for (uint32_t q = p + 1; q < pass_count && !needed; q++) {
+                    if (graph.culled(q)) continue;
+                    for (auto [r2, a2] : passes[q].uses) needed |= r2.index == r.index && !is_write(a2);
+                }
+            }
+            culled_right &= graph.culled(p) == !needed;
+        }
+
+        Checker check(graph, passes);
+        checker = &check;
+        for (size_t i = 0; i < resources.size(); i++) check.state[i] = initial[i];
+        graph.execute([&](std::span<const Barrier> b) { check.barriers(b); });
+        before_matches &= check.before_matches;
+        states_match &= check.states_match;
+        aliasing_first &= check.aliasing_first;
+        for (uint32_t i = 0; i < imports; i++) states_match &= check.state[i] == Access::shader_read;
+        sound &= placement_is_sound(graph, passes);
+    }
+    CHECK(sound);
+    CHECK(before_matches);
+    CHECK(states_match);
+    CHECK(aliasing_first);
+    CHECK(culled_right);
+}
+
+int main() {
+    culling();
+    barriers();
+    blur_chains_dont_grow();
+    random_graphs();
+    return check::result();
+}
@@ -0,0 +1,196 @@
+// The resampler's weight tables and images. Every output's weights add up to 1 and stay within
+// the source, with padding taps at zero; a flat image stays exactly that colour at any size, with
+// any filter; at 1:1 box and Lanczos3 give back the image they were given. Filtering happens in
+// linear light: a black and white checkerboard shrinks to linear half grey, not sRGB 128. Every
+// SIMD level and thread count gives the same bits as the scalar code.
+
+#include "resample.h"
+#include "check.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace pixel;
+
+const ResampleFilter filters[] = { ResampleFilter::box, ResampleFilter::mitchell, ResampleFilter::lanczos3 };
+
+const int sizes[] = { 1, 2, 3, 5, 7, 16, 31, 64, 100, 257, 1000 };
+
+void weights_sum_to_one() {
+    bool sums = true, in_range = true, padding = true;
+    for (ResampleFilter filter : filters) {
+        for (int src : sizes) {
+            for (int dst : sizes) {
+                for (bool even : { false, true }) {
+                    ResampleWeights w = resample_weights(src, dst, filter, even);
+                    in_range &= int(w.first.size()) == dst && (!even || w.taps % 2 == 0);
+                    // Without padding all the taps are in the source; padding adds at most one more.
+                    int reach = even ? src + 1 : src;
+                    for (int i = 0; i < dst; i++) {
+                        in_range &= w.first[i] >= 0 && w.first[i] + w.taps <= reach;
+                        double total = 0;
+                        for (int t = 0; t < w.taps; t++) {
+                            float weight = w.weights[size_t(i) * w.taps + t];
+                            total += weight;
+                            if (w.first[i] + t >= src) padding &= weight == 0.0f;
+                        }
+                        sums &= std::abs(total - 1.0) < 1e-5;
+                    }
+                }
+            }
+        }
+    }
+    CHECK(sums);
+    CHECK(in_range);
+    CHECK(padding);
+    // The filters themselves: 1 at the centre, 0 past their radius, Lanczos 0 at whole pixels.
+    for (ResampleFilter filter : filters) {
+        CHECK(filter_weight(filter, filter_radius(filter) + 0.01) == 0.0);
+    }
+    CHECK(filter_weight(ResampleFilter::lanczos3, 0) == 1.0);
+    CHECK(std::abs(filter_weight(ResampleFilter::lanczos3, 1)) < 1e-12);
+    CHECK(std::abs(filter_weight(ResampleFilter::lanczos3, 2)) < 1e-12);
+    CHECK(filter_weight(ResampleFilter::box, 0.25) == 1.0);
+}
+
+std::vector<uint32_t> resample(const std::vector<uint32_t>& src, int src_width, int src_height, int width,
+                               int height, const ResampleOptions& options) {
+    std::vector<uint32_t> dst(size_t(width) * height, 0xdeadbeefu);
+    resample_rgba8(dst.data(), width, height, width, src.data(), src_width, src_height, src_width, options);
+    return dst;
+}
+
+void constant_images_stay_constant() {
+    const uint32_t colors[] = { 0xff000000u, 0xffffffffu, 0xff3080c0u, 0x80204060u, 0x00000000u, 0x7f7f7f7fu };
+    const int shapes[][2] = { { 1, 1 }, { 1, 40 }, { 37, 1 }, { 64, 48 }, { 300, 17 } };
+    bool flat = true;
+    for (ResampleFilter filter : filters) {
+        for (uint32_t color : colors) {
+            for (bool premultiplied : { false, true }) {
+                // Premultiplied input has colour no more than alpha.
+                if (premultiplied && color != 0x7f7f7f7fu && (color >> 24) != 0xff && color != 0) continue;
+                for (auto& from : shapes) {
+                    for (auto& to : shapes) {
+                        ResampleOptions options;
+                        options.filter = filter;
+                        options.premultiplied = premultiplied;
+                        std::vector<uint32_t> src(size_t(from[0]) * from[1], color);
+                        std::vector<uint32_t> dst = resample(src, from[0], from[1], to[0], to[1], options);
+                        // Fully transparent pixels have no colour to keep.
+                        for (uint32_t p : dst) flat &= color >> 24 ? p == color : p >> 24 == 0;
+                    }
+                }
+            }
+        }
+    }
+    CHECK(flat);
+}
+
+void identity_at_one_to_one() {
+    std::mt19937 rng(1);
+    const int width = 83, height = 61;
+    std::vector<uint32_t> opaque(size_t(width) * height), translucent(opaque.size());
+    for (auto& p : opaque) p = rng() | 0xff000000u;
+    for (auto& p : translucent) p = rng();
+    for (ResampleFilter filter : { ResampleFilter::box, ResampleFilter::lanczos3 }) {
+        for (bool srgb : { true, false }) {
+            ResampleOptions options;
+            options.filter = filter;
+            options.srgb = srgb;
+            CHECK(resample(opaque, width, height, width, height, options) == opaque);
+            // Through premultiplied alpha and back colour keeps at most 8 bits' worth of alpha's
+            // precision, so faint pixels can come back a little off. Alpha itself is exact.
+            std::vector<uint32_t> out = resample(translucent, width, height, width, height, options);
+            bool alpha = true, close = true;
+            for (size_t i = 0; i < out.size(); i++) {
+                uint32_t a = translucent[i] >> 24;
+                alpha &= out[i] >> 24 == a;
+                if (a < 16) continue;
+                for (int c = 0; c < 24; c += 8) {
+                    int d = std::abs(int((out[i] >> c) & 0xff) - int((translucent[i] >> c) & 0xff));
+                    close &= d <= (srgb ? 255 / int(a) + 2 : 255 / int(a) + 1);
+                }
+            }
+            CHECK(alpha);
+            CHECK(close);
+        }
+    }
+}
+
+// Whether every colour channel of an 8x8 image is within 1 of value, leaving out the outer ring:
+// there the clamped taps put extra weight on the edge pixel, black or white.
+bool all_near(const std::vector<uint32_t>& image, int value) {
+    bool near = true;
+    for (int y = 1; y < 7; y++) {
+        for (int x = 1; x < 7; x++) {
+            for (int c = 0; c < 24; c += 8) near &= std::abs(int((image[size_t(y) * 8 + x] >> c) & 0xff) - value) <= 1;
+        }
+    }
+    return near;
+}
+
+// A pixel checkerboard is half the light. Shrunk in linear light it's linear 0.5 (sRGB 188);
+// averaging the sRGB values would give 128, visibly darker.
+void linear_light() {
+    const int side = 64;
+    std::vector<uint32_t> board(size_t(side) * side);
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) board[size_t(y) * side + x] = (x + y) % 2 ? 0xffffffffu : 0xff000000u;
+    }
+    for (ResampleFilter filter : filters) {
+        ResampleOptions options;
+        options.filter = filter;
+        CHECK(all_near(resample(board, side, side, 8, 8, options), 188));
+        options.srgb = false;
+        CHECK(all_near(resample(board, side, side, 8, 8, options), 128));
+    }
+}
+
+void levels_and_threads_match() {
+    std::mt19937 rng(2);
+    const int shapes[][4] = { { 97, 53, 31, 17 }, { 40, 40, 97, 71 }, { 300, 200, 300, 200 }, { 1, 64, 5, 9 } };
+    bool same = true;
+    for (auto& s : shapes) {
+        std::vector<uint32_t> src(size_t(s[0]) * s[1]);
+        for (auto& p : src) p = rng();
+        for (ResampleFilter filter : filters) {
+            ResampleOptions options;
+            options.filter = filter;
+            options.level = simd::Level::scalar;
+            options.threads = 1;
+            std::vector<uint32_t> reference = resample(src, s[0], s[1], s[2], s[3], options);
+            for (simd::Level level : { simd::Level::scalar, simd::Level::sse41, simd::Level::avx2 }) {
+                for (unsigned threads : { 1u, 3u }) {
+                    options.level = level;
+                    options.threads = threads;
+                    same &= resample(src, s[0], s[1], s[2], s[3], options) == reference;
+                }
+            }
+        }
+    }
+    CHECK(same);
+}
+
+void fit() {
+    int w = 0, h = 0;
+    fit_within(6000, 4000, 1024, 1024, w, h);
+    CHECK(w == 1024 && h == 683);
+    fit_within(4000, 6000, 1024, 512, w, h);
+    CHECK(w == 341 && h == 512);
+    fit_within(300, 200, 1024, 1024, w, h);
+    CHECK(w == 300 && h == 200);
+    fit_within(10000, 1, 64, 64, w, h);
+    CHECK(w == 64 && h == 1);
+}
+
+int main() {
+    weights_sum_to_one();
+    constant_images_stay_constant();
+    identity_at_one_to_one();
+    linear_light();
+    levels_and_threads_match();
+    fit();
+    return check::result();
+}
@@ -0,0 +1,352 @@
+// The software device pixel for pixel: clears land in the readback with the target's channel order
+// and row pitch, triangles that share an edge or a corner cover each pixel centre on it exactly
+// once (the top-left rule), the depth test is strictly less and only writes when it's on, the
+// scissor and viewport both cut draws, and point and linear sampling give the exact texels and
+// 8 bit blend weights the rasterizer promises for clamp and wrap.
+
+#include "software_device.h"
+#include "check.h"
+
+#include <cstring>
+#include <optional>
+#include <vector>
+
+using namespace render;
+
+struct Draw {
+    std::vector<float> vertices;    // x, y, u, v per corner, x and y in target pixels
+    Texture texture;
+    PipelineDesc pipeline = { .cull = CullMode::none };
+    float z = 0.5f;
+    std::optional<Viewport> viewport = {};
+    std::optional<Rect> scissor = {};
+};
+
+// A color target and a depth buffer on a device with a few threads, so the row bands are shared
+// out the way they are in the app (targets taller than 16 rows get more than one band).
+struct Canvas {
+    SoftwareDevice device{ 3 };
+    uint32_t width, height;
+    Texture color, depth;
+
+    Canvas(uint32_t w, uint32_t h, Format format = Format::rgba8_unorm) : width(w), height(h) {
+        color = device.create_texture({ w, h, format });
+        depth = device.create_texture({ w, h, Format::d32_float });
+        clear();
+    }
+
+    Texture texture(uint32_t w, uint32_t h, const std::vector<uint32_t>& texels, Format format = Format::rgba8_unorm) {
+        Texture t = device.create_texture({ w, h, format });
+        device.write_texture(t, 0, 0, w, h, texels.data(), w * 4);
+        return t;
+    }
+
+    void clear() {
+        const float black[4] = { 0, 0, 0, 0 };
+        auto list = device.create_command_list();
+        list->clear(color, black);
+        list->clear_depth(depth, 1);
+        device.wait(device.submit(*list));
+    }
+
+    void draw(const Draw& d) {
+        std::vector<uint32_t> indices(d.vertices.size() / 4);
+        for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+        // Target pixels to clip space, stored transposed; z is the same for the whole draw.
+        float m[16] = { 2.0f / width, 0, 0, -1, 0, -2.0f / height, 0, 1, 0, 0, 0, d.z, 0, 0, 0, 1 };
+        Buffer vb = upload(d.vertices.data(), d.vertices.size() * 4);
+        Buffer ib = upload(indices.data(), indices.size() * 4);
+        Buffer cb = upload(m, sizeof(m));
+
+        auto list = device.create_command_list();
+        list->set_render_target(color, depth);
+        list->set_viewport(d.viewport.value_or(Viewport{ 0, 0, float(width), float(height), 0, 1 }));
+        list->set_scissor(d.scissor.value_or(Rect{ 0, 0, int32_t(width), int32_t(height) }));
+        list->set_pipeline(device.create_pipeline(d.pipeline));
+        list->set_vertex_buffer(vb, 16);
+        list->set_index_buffer(ib, Format::r32_uint);
+        list->set_constants(cb);
+        list->set_texture(d.texture);
+        list->draw_indexed(uint32_t(indices.size()));
+        device.wait(device.submit(*list));
+        for (Buffer b : { vb, ib, cb }) device.destroy(b);
+    }
+
+    Buffer upload(const void* data, size_t size) {
+        Buffer b = device.create_buffer(size);
+        device.write_buffer(b, 0, { static_cast<const uint8_t*>(data), size });
+        return b;
+    }
+
+    std::vector<uint32_t> pixels() {
+        std::vector<uint32_t> out(size_t(width) * height);
+        device.read_texture(color, out.data(), width * 4);
+        return out;
+    }
+
+    std::vector<float> depths() {
+        std::vector<float> out(size_t(width) * height);
+        device.read_texture(depth, out.data(), width * 4);
+        return out;
+    }
+
+    // The pixels a draw of a 1x1 white texture touches, cleared first.
+    std::vector<bool> coverage(std::vector<float> vertices) {
+        clear();
+        draw({ .vertices = std::move(vertices), .texture = texture(1, 1, { 0xffffffff }) });
+        std::vector<bool> covered;
+        for (uint32_t p : pixels()) covered.push_back(p != 0);
+        return covered;
+    }
+};
+
+std::vector<float> quad(float x0, float y0, float x1, float y1) {
+    return { x0, y0, 0, 0, x1, y0, 1, 0, x0, y1, 0, 1, x0, y1, 0, 1, x1, y0, 1, 0, x1, y1, 1, 1 };
+}
+
+// true when exactly the pixels [x0, x1) x [y0, y1) are set.
+bool exactly(const std::vector<bool>& covered, uint32_t width, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    for (uint32_t i = 0; i < covered.size(); i++) {
+        uint32_t x = i % width, y = i / width;
+        if (covered[i] != (x >= x0 && x < x1 && y >= y0 && y < y1)) return false;
+    }
+    return true;
+}
+
+void clear_and_readback() {
+    // 0.5 and 0.25 round to 128 and 64; bgra targets swap red and blue in the stored texel.
+    const float color[4] = { 1, 0.5f, 0, 0.25f };
+    for (Format format : { Format::rgba8_unorm, Format::bgra8_unorm }) {
+        Canvas canvas(5, 40, format);
+        auto list = canvas.device.create_command_list();
+        list->clear(canvas.color, color);
+        list->clear_depth(canvas.depth, 0.25f);
+        uint64_t fence = canvas.device.submit(*list);
+        CHECK(canvas.device.completed_fence() >= fence);
+
+        // A padded pitch: the gap after each row is left alone.
+        const uint32_t pitch = 7;
+        std::vector<uint32_t> out(pitch * 40, 0xdeadbeef);
+        canvas.device.read_texture(canvas.color, out.data(), pitch * 4);
+        uint32_t expected = format == Format::rgba8_unorm ? 0x400080ff : 0x40ff8000;
+        bool rows = true, gaps = true;
+        for (uint32_t y = 0; y < 40; y++) {
+            for (uint32_t x = 0; x < pitch; x++) {
+                if (x < 5) rows &= out[y * pitch + x] == expected;
+                else gaps &= out[y * pitch + x] == 0xdeadbeef;
+            }
+        }
+        CHECK(rows);
+        CHECK(gaps);
+        for (float d : canvas.depths()) CHECK(d == 0.25f);
+    }
+
+    // write_texture then read_texture of a sub-rectangle round trips.
+    Canvas canvas(4, 4);
+    std::vector<uint32_t> patch = { 1, 2, 3, 4, 5, 6 };
+    canvas.device.write_texture(canvas.color, 1, 2, 3, 2, patch.data(), 12);
+    auto px = canvas.pixels();
+    CHECK((px == std::vector<uint32_t>{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 0, 4, 5, 6 }));
+}
+
+void fill_rule() {
+    Canvas canvas(24, 24);
+    const size_t all = 24 * 24;
+
+    // A quad's edges on half pixels: the left and top edges run through pixel centres and keep
+    // them, the right and bottom ones give theirs to the neighbour.
+    CHECK(exactly(canvas.coverage(quad(0.5f, 0.5f, 4.5f, 4.5f)), 24, 0, 0, 4, 4));
+    CHECK(exactly(canvas.coverage(quad(4.5f, 0.5f, 8.5f, 4.5f)), 24, 4, 0, 8, 4));
+    CHECK(exactly(canvas.coverage(quad(0.5f, 4.5f, 4.5f, 8.5f)), 24, 0, 4, 4, 8));
+
+    // Two triangles splitting the target along its diagonal, which goes through 24 centres:
+    // between them every pixel is covered exactly once.
+    auto upper = canvas.coverage({ 0, 0, 0, 0, 24, 0, 0, 0, 24, 24, 0, 0 });
+    auto lower = canvas.coverage({ 0, 0, 0, 0, 24, 24, 0, 0, 0, 24, 0, 0 });
+    size_t total = 0, twice = 0;
+    for (size_t i = 0; i < all; i++) {
+        total += upper[i] + lower[i];
+        twice += upper[i] && lower[i];
+    }
+    CHECK(total == all);
+    CHECK(twice == 0);
+
+    // Four triangles fanned round a vertex sitting on a pixel centre, their edges on diagonals
+    // through more centres: the square is covered once and nothing outside it is touched.
+    const float c = 12.5f, lo = 4.5f, hi = 20.5f;
+    std::vector<std::vector<float>> fan = {
+        { c, c, 0, 0, lo, lo, 0, 0, hi, lo, 0, 0 },
+        { c, c, 0, 0, hi, lo, 0, 0, hi, hi, 0, 0 },
+        { c, c, 0, 0, hi, hi, 0, 0, lo, hi, 0, 0 },
+        { c, c, 0, 0, lo, hi, 0, 0, lo, lo, 0, 0 },
+    };
+    std::vector<int> hits(all);
+    for (const auto& tri : fan) {
+        auto covered = canvas.coverage(tri);
+        for (size_t i = 0; i < all; i++) hits[i] += covered[i];
+    }
+    bool once = true;
+    for (size_t i = 0; i < all; i++) {
+        size_t x = i % 24, y = i / 24;
+        once &= hits[i] == (x >= 4 && x < 20 && y >= 4 && y < 20 ? 1 : 0);
+    }
+    CHECK(once);
+
+    // The same fan in one draw, bands shared out across threads, gives the same pixels.
+    std::vector<float> all_four;
+    for (const auto& tri : fan) all_four.insert(all_four.end(), tri.begin(), tri.end());
+    CHECK(exactly(canvas.coverage(all_four), 24, 4, 4, 20, 20));
+}
+
+void depth() {
+    Canvas canvas(8, 8);
+    Texture red = canvas.texture(1, 1, { 0xff0000ff });
+    Texture green = canvas.texture(1, 1, { 0xff00ff00 });
+    Texture blue = canvas.texture(1, 1, { 0xffff0000 });
+    auto at = [&](uint32_t x, uint32_t y) { return canvas.pixels()[y * 8 + x]; };
+    auto depth_at = [&](uint32_t x, uint32_t y) { return canvas.depths()[y * 8 + x]; };
+
+    // Passes against the clear and writes its depth.
+    canvas.draw({ .vertices = quad(0, 0, 4, 8), .texture = red, .z = 0.5f });
+    CHECK(at(1, 1) == 0xff0000ff);
+    CHECK(depth_at(1, 1) == 0.5f);
+    CHECK(at(5, 1) == 0);
+    CHECK(depth_at(5, 1) == 1);
+
+    // Behind: fails where red is and passes beside it.
+    canvas.draw({ .vertices = quad(0, 0, 8, 4), .texture = green, .z = 0.75f });
+    CHECK(at(1, 1) == 0xff0000ff);
+    CHECK(depth_at(1, 1) == 0.5f);
+    CHECK(at(5, 1) == 0xff00ff00);
+    CHECK(depth_at(5, 1) == 0.75f);
+
+    // The test is strictly less, so equal depth doesn't draw.
+    canvas.draw({ .vertices = quad(0, 0, 8, 8), .texture = blue, .z = 0.5f });
+    CHECK(at(1, 1) == 0xff0000ff);
+    CHECK(at(5, 1) == 0xffff0000);
+    CHECK(depth_at(5, 1) == 0.5f);
+    CHECK(at(5, 5) == 0xffff0000);
+    CHECK(depth_at(5, 5) == 0.5f);
+
+    // In front of everything.
+    canvas.draw({ .vertices = quad(0, 0, 8, 8), .texture = green, .z = 0.25f });
+    for (uint32_t p : canvas.pixels()) CHECK(p == 0xff00ff00);
+    for (float d : canvas.depths()) CHECK(d == 0.25f);
+
+    // With the test off the draw lands behind everything and leaves depth as it was.
+    canvas.draw({ .vertices = quad(2, 2, 6, 6), .texture = red,
+                  .pipeline = { .cull = CullMode::none, .depth_test = false }, .z = 0.9f });
+    CHECK(at(3, 3) == 0xff0000ff);
+    CHECK(at(1, 1) == 0xff00ff00);
+    for (float d : canvas.depths()) CHECK(d == 0.25f);
+}
+
+void clipping() {
+    Canvas canvas(24, 24);
+    Texture white = canvas.texture(1, 1, { 0xffffffff });
+    auto covered = [&] {
+        std::vector<bool> out;
+        for (uint32_t p : canvas.pixels()) out.push_back(p != 0);
+        return out;
+    };
+
+    // Scissor: a quad over everything only reaches inside the rectangle.
+    canvas.draw({ .vertices = quad(0, 0, 24, 24), .texture = white, .scissor = Rect{ 3, 5, 17, 20 } });
+    CHECK(exactly(covered(), 24, 3, 5, 17, 20));
+
+    // A scissor hanging off the target or empty.
+    canvas.clear();
+    canvas.draw({ .vertices = quad(0, 0, 24, 24), .texture = white, .scissor = Rect{ -10, 20, 40, 99 } });
+    CHECK(exactly(covered(), 24, 0, 20, 24, 24));
+    canvas.clear();
+    canvas.draw({ .vertices = quad(0, 0, 24, 24), .texture = white, .scissor = Rect{ 8, 8, 8, 16 } });
+    CHECK(exactly(covered(), 24, 0, 0, 0, 0));
+
+    // Viewport: the target-sized quad is mapped onto it.
+    canvas.clear();
+    canvas.draw({ .vertices = quad(0, 0, 24, 24), .texture = white, .viewport = Viewport{ 4, 2, 8, 12, 0, 1 } });
+    CHECK(exactly(covered(), 24, 4, 2, 12, 14));
+
+    // A quad three times the clip volume is cut at the viewport's edges, not the target's.
+    canvas.clear();
+    canvas.draw({ .vertices = quad(-24, -24, 48, 48), .texture = white, .viewport = Viewport{ 6, 10, 6, 4, 0, 1 } });
+    CHECK(exactly(covered(), 24, 6, 10, 12, 14));
+
+    // Both at once: the overlap.
+    canvas.clear();
+    canvas.draw({ .vertices = quad(-24, -24, 48, 48), .texture = white,
+                  .viewport = Viewport{ 0, 0, 16, 16, 0, 1 }, .scissor = Rect{ 8, 4, 24, 12 } });
+    CHECK(exactly(covered(), 24, 8, 4, 16, 12));
+}
+
+void sampling() {
+    // Point: a 4x4 texture over an 8x8 target doubles every texel.
+    {
+        Canvas canvas(8, 8);
+        std::vector<uint32_t> texels(16);
+        for (uint32_t i = 0; i < 16; i++) texels[i] = 0xff000000 | i * 0x010203;
+        canvas.draw({ .vertices = quad(0, 0, 8, 8), .texture = canvas.texture(4, 4, texels) });
+        auto px = canvas.pixels();
+        bool doubled = true;
+        for (uint32_t y = 0; y < 8; y++) {
+            for (uint32_t x = 0; x < 8; x++) doubled &= px[y * 8 + x] == texels[y / 2 * 4 + x / 2];
+        }
+        CHECK(doubled);
+
+        // A bgra texture into an rgba target comes out with red and blue swapped.
+        Texture bgra = canvas.texture(1, 1, { 0xff112233 }, Format::bgra8_unorm);
+        canvas.draw({ .vertices = quad(0, 0, 8, 8), .texture = bgra, .z = 0.25f });
+        for (uint32_t p : canvas.pixels()) CHECK(p == 0xff332211);
+    }
+
+    // Point with uvs past 1: wrap repeats the texture, clamp smears the last texel.
+    {
+        Canvas canvas(8, 1);
+        std::vector<float> twice = { 0, 0, 0, 0, 8, 0, 2, 0, 0, 1, 0, 1, 0, 1, 0, 1, 8, 0, 2, 0, 8, 1, 2, 1 };
+        Texture t = canvas.texture(4, 1, { 10, 20, 30, 40 });
+        canvas.draw({ .vertices = twice, .texture = t,
+                      .pipeline = { .address = AddressMode::wrap, .cull = CullMode::none } });
+        CHECK((canvas.pixels() == std::vector<uint32_t>{ 10, 20, 30, 40, 10, 20, 30, 40 }));
+        canvas.clear();
+        canvas.draw({ .vertices = twice, .texture = t,
+                      .pipeline = { .address = AddressMode::clamp, .cull = CullMode::none } });
+        CHECK((canvas.pixels() == std::vector<uint32_t>{ 10, 20, 30, 40, 40, 40, 40, 40 }));
+    }
+
+    // Linear: black to white over 2 texels stretched across 8 pixels. Pixel x samples at
+    // (x + 0.5) / 4 - 0.5 texels, and the weight is that fraction in 256ths, rounded down.
+    {
+        Canvas canvas(8, 1);
+        Texture ramp = canvas.texture(2, 1, { 0xff000000, 0xffffffff });
+        auto channel = [&] {
+            std::vector<uint32_t> out;
+            for (uint32_t p : canvas.pixels()) out.push_back(p & 0xff);
+            return out;
+        };
+        auto opaque = [&] {
+            bool all = true;
+            for (uint32_t p : canvas.pixels()) all &= p >> 24 == 0xff;
+            return all;
+        };
+        PipelineDesc linear = { .filter = Filter::linear, .address = AddressMode::clamp, .cull = CullMode::none };
+        canvas.draw({ .vertices = quad(0, 0, 8, 1), .texture = ramp, .pipeline = linear });
+        CHECK((channel() == std::vector<uint32_t>{ 0, 0, 32, 96, 159, 223, 255, 255 }));
+        CHECK(opaque());
+
+        // Wrap blends the ends with each other.
+        canvas.clear();
+        linear.address = AddressMode::wrap;
+        canvas.draw({ .vertices = quad(0, 0, 8, 1), .texture = ramp, .pipeline = linear });
+        CHECK((channel() == std::vector<uint32_t>{ 96, 32, 32, 96, 159, 223, 223, 159 }));
+        CHECK(opaque());
+    }
+}
+
+int main() {
+    clear_and_readback();
+    fill_rule();
+    depth();
+    clipping();
+    sampling();
+    return check::result();
+}
@@ -0,0 +1,216 @@
+// SpatialIndex against a brute force scan of the same items: after random inserts, moves and
+// removes, with and without a margin, and again after rebuild(), every rectangle, point and
+// multi-view query finds exactly what scanning finds. Insertion order mustn't turn the tree into
+// a list.
+
+#include "spatial_index.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace spatial;
+
+struct Item {
+    ProxyId proxy = null_proxy;
+    Bounds bounds;
+    bool live = false;
+};
+
+// Everything the scan finds, sorted, to compare with a query's answer.
+std::vector<uint32_t> scan(const std::vector<Item>& items, const Bounds& area) {
+    std::vector<uint32_t> found;
+    for (uint32_t i = 0; i < items.size(); i++) {
+        if (items[i].live && items[i].bounds.overlaps(area)) found.push_back(i);
+    }
+    return found;
+}
+
+std::vector<uint32_t> sorted(std::vector<uint32_t> v) {
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+Bounds random_box(std::mt19937& rng, float world, float max_size) {
+    std::uniform_real_distribution<float> pos(-world, world), size(0.0f, max_size);
+    float x = pos(rng), y = pos(rng);
+    // Some zero sized: a dot, a horizontal or vertical line.
+    float w = rng() % 10 == 0 ? 0.0f : size(rng), h = rng() % 10 == 0 ? 0.0f : size(rng);
+    return { x, y, x + w, y + h };
+}
+
+// Height is about 1.44 log2(n) for an AVL balanced tree; leave room for the SAH's choices.
+bool height_is_logarithmic(const SpatialIndex& index) {
+    if (index.size() < 2) return true;
+    return index.height() <= int(2.0 * std::log2(double(index.size()))) + 2;
+}
+
+bool queries_match(const SpatialIndex& index, const std::vector<Item>& items, std::mt19937& rng) {
+    bool ok = true;
+    std::vector<uint32_t> found;
+    for (int q = 0; q < 50; q++) {
+        Bounds area = random_box(rng, 1100, rng() % 4 == 0 ? 800.0f : 60.0f);
+        found.clear();
+        index.query(area, found);
+        ok &= sorted(found) == scan(items, area);
+
+        // Points, including exactly on an item's corner.
+        float x = area.min_x, y = area.min_y;
+        if (q % 2 == 0) {
+            for (const Item& it : items) {
+                if (it.live) {
+                    x = it.bounds.max_x;
+                    y = it.bounds.min_y;
+                    if (rng() % 8 == 0) break;
+                }
+            }
+        }
+        found.clear();
+        index.query_point(x, y, found);
+        ok &= sorted(found) == scan(items, { x, y, x, y });
+    }
+
+    // Several views in one walk, up to the maximum.
+    for (size_t count : { size_t(1), size_t(3), max_views }) {
+        std::vector<Bounds> views(count);
+        for (auto& v : views) v = random_box(rng, 1000, 400);
+        std::vector<std::vector<uint32_t>> visible(count);
+        index.cull(views, visible);
+        for (size_t v = 0; v < count; v++) ok &= sorted(visible[v]) == scan(items, views[v]);
+    }
+    return ok;
+}
+
+void against_brute_force() {
+    for (float margin : { 0.0f, 5.0f }) {
+        std::mt19937 rng(margin == 0 ? 1 : 2);
+        SpatialIndex index(margin);
+        std::vector<Item> items;
+        bool match = true, users_right = true, balanced = true, moves_stay_put = true;
+        size_t live = 0;
+
+        for (int step = 0; step < 6000; step++) {
+            uint32_t r = rng() % 10;
+            if (r < 5 || live == 0) {
+                Item it;
+                it.bounds = random_box(rng, 1000, rng() % 20 == 0 ? 500.0f : 30.0f);
+                it.proxy = index.insert(it.bounds, uint32_t(items.size()));
+                it.live = true;
+                items.push_back(it);
+                live++;
+            } else {
+                uint32_t i = rng() % items.size();
+                if (!items[i].live) continue;
+                if (r < 8) {
+                    // Mostly small moves (strokes being dragged), sometimes a jump.
+                    Bounds b = items[i].bounds;
+                    float dx = rng() % 4 == 0 ? float(int(rng() % 1000)) - 500 : float(int(rng() % 5)) - 2;
+                    Bounds moved = { b.min_x + dx, b.min_y - dx / 2, b.max_x + dx, b.max_y - dx / 2 };
+                    index.update(items[i].proxy, moved);
+                    moves_stay_put &= !index.update(items[i].proxy, moved);   // fits the box it just got
+                    items[i].bounds = moved;
+                } else {
+                    index.remove(items[i].proxy);
+                    items[i].live = false;
+                    live--;
+                }
+            }
+            if (step % 500 == 499) {
+                match &= queries_match(index, items, rng);
+                balanced &= height_is_logarithmic(index);
+            }
+        }
+        CHECK(index.size() == live);
+        for (uint32_t i = 0; i < items.size(); i++) {
+            if (!items[i].live) continue;
+            users_right &= index.user(items[i].proxy) == i;
+            const Bounds& b = index.bounds(items[i].proxy);
+            users_right &= b.min_x == items[i].bounds.min_x && b.max_y == items[i].bounds.max_y;
+        }
+        CHECK(match);
+        CHECK(users_right);
+        CHECK(balanced);
+        CHECK(moves_stay_put);
+
+        float before = index.quality();
+        index.rebuild();
+        CHECK(queries_match(index, items, rng));
+        CHECK(height_is_logarithmic(index));
+        CHECK(index.quality() <= before * 1.5f);
+        // Still a working dynamic tree afterwards.
+        for (uint32_t i = 0; i < items.size(); i += 3) {
+            if (!items[i].live) continue;
+            index.remove(items[i].proxy);
+            items[i].live = false;
+        }
+        CHECK(queries_match(index, items, rng));
+    }
+}
+
+// Items arriving sorted, on a line and all on one spot.
+void insertion_order() {
+    for (int pattern = 0; pattern < 3; pattern++) {
+        SpatialIndex index;
+        std::vector<Item> items;
+        for (uint32_t i = 0; i < 4096; i++) {
+            float x = pattern == 2 ? 0.0f : float(i), y = pattern == 0 ? float(i) : 0.0f;
+            Item it;
+            it.bounds = { x, y, x + 1, y + 1 };
+            it.proxy = index.insert(it.bounds, i);
+            it.live = true;
+            items.push_back(it);
+        }
+        CHECK(height_is_logarithmic(index));
+        std::mt19937 rng(pattern);
+        CHECK(queries_match(index, items, rng));
+    }
+}
+
+void small_cases() {
+    SpatialIndex index;
+    std::vector<uint32_t> found;
+    index.query({ -1, -1, 1, 1 }, found);
+    std::vector<std::vector<uint32_t>> visible(1);
+    Bounds everything = { -1e30f, -1e30f, 1e30f, 1e30f };
+    index.cull(std::span<const Bounds>(&everything, 1), visible);
+    CHECK(found.empty() && visible[0].empty() && index.height() == 0);
+    index.rebuild();
+    CHECK(index.quality() == 0);
+
+    ProxyId a = index.insert({ 0, 0, 1, 1 }, 7);
+    index.query_point(1, 1, found);                 // edges count
+    CHECK((found == std::vector<uint32_t>{ 7 }));
+    found.clear();
+    index.query_point(1.0001f, 1, found);
+    CHECK(found.empty());
+    index.remove(a);
+    CHECK(index.size() == 0);
+    index.query(everything, found);
+    CHECK(found.empty());
+
+    // Moves inside the margin leave the tree alone.
+    SpatialIndex loose(5);
+    ProxyId b = loose.insert({ 0, 0, 1, 1 }, 1);
+    CHECK(!loose.update(b, { 3, -4, 4, -3 }));
+    CHECK(loose.update(b, { 10, 0, 11, 1 }));
+    loose.query_point(10.5f, 0.5f, found);
+    CHECK((found == std::vector<uint32_t>{ 1 }));
+    found.clear();
+    loose.query_point(0.5f, 0.5f, found);         // the grown box isn't what queries see
+    CHECK(found.empty());
+
+    // A visitor returning false stops the query.
+    for (uint32_t i = 0; i < 100; i++) index.insert({ 0, 0, 1, 1 }, i);
+    int visits = 0;
+    index.query(everything, [&](ProxyId) { return ++visits < 5; });
+    CHECK(visits == 5);
+}
+
+int main() {
+    against_brute_force();
+    insertion_order();
+    small_cases();
+    return check::result();
+}
@@ -0,0 +1,138 @@
+// TaskGraph: tasks never start before everything they depend on has finished, at any thread
+// count; a throwing task skips what depends on it (through every path), lets the rest run and
+// has its exception rethrown from run(); caller-affinity tasks stay on the thread that called
+// run(); and the critical path is the chain that really took the longest.
+
+#include "task_graph.h"
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tasks;
+
+// Random DAGs: each task records when it started and ended on one shared counter, so "started
+// after every dep ended" is checkable without trusting the graph's own timings.
+void dependencies_are_respected() {
+    std::mt19937 rng(5);
+    for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+        for (int round = 0; round < 20; round++) {
+            TaskGraph graph;
+            const size_t n = 60;
+            std::atomic<int> clock{ 0 };
+            std::vector<int> started(n, -1), ended(n, -1);
+            std::vector<std::vector<TaskId>> deps(n);
+            for (TaskId id = 0; id < n; id++) {
+                for (TaskId d = 0; d < id; d++) {
+                    if (rng() % 10 == 0) deps[id].push_back(d);
+                }
+                bool slow = rng() % 8 == 0;
+                graph.add("task " + std::to_string(id), [&, id, slow] {
+                    started[id] = clock++;
+                    if (slow) std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    ended[id] = clock++;
+                }, deps[id]);
+            }
+            graph.run(threads);
+            bool ordered = true, all_ran = true;
+            for (TaskId id = 0; id < n; id++) {
+                all_ran &= ended[id] >= 0 && graph.timings()[id].ran;
+                for (TaskId d : deps[id]) ordered &= started[id] > ended[d];
+            }
+            CHECK(all_ran);
+            CHECK(ordered);
+            CHECK(graph.timings()[0].thread < threads);
+        }
+    }
+}
+
+void exceptions_skip_dependents() {
+    for (unsigned threads : { 1u, 3u }) {
+        TaskGraph graph;
+        std::atomic<int> ran{ 0 };
+        auto count = [&] { ran++; };
+        TaskId a = graph.add("a", count);
+        TaskId bad = graph.add("bad", [] { throw std::runtime_error("bad task"); }, { a });
+        TaskId b = graph.add("b", count, { bad });
+        TaskId c = graph.add("c", count, { bad, a });
+        TaskId d = graph.add("d", count, { b, c });           // skipped through two paths
+        TaskId other = graph.add("other", count, { a });
+        TaskId later_bad = graph.add("later bad", [] { throw std::logic_error("second"); }, { other });
+
+        std::string what;
+        try {
+            graph.run(threads);
+        } catch (const std::runtime_error& e) {
+            what = e.what();
+        } catch (const std::logic_error& e) {
+            what = e.what();
+        }
+        // Both failures happen; with one thread the order is known and the first one wins.
+        CHECK(!what.empty());
+        if (threads == 1) CHECK(what == "bad task");
+        CHECK(ran == 2);   // a and other
+        const auto& t = graph.timings();
+        CHECK(t[a].ran && t[bad].ran && t[other].ran && t[later_bad].ran);
+        CHECK(!t[b].ran && !t[c].ran && !t[d].ran);
+        CHECK(graph.report().find("skipped") != std::string::npos);
+    }
+}
+
+void caller_affinity_stays_on_caller() {
+    TaskGraph graph;
+    const auto caller = std::this_thread::get_id();
+    std::atomic<int> wrong_thread{ 0 };
+    std::vector<TaskId> any;
+    for (int i = 0; i < 20; i++) {
+        any.push_back(graph.add("any", [] { std::this_thread::sleep_for(std::chrono::microseconds(100)); }));
+    }
+    for (int i = 0; i < 20; i++) {
+        graph.add("caller", [&] {
+            if (std::this_thread::get_id() != caller) wrong_thread++;
+        }, { any[i] }, Affinity::caller);
+    }
+    graph.run(4);
+    CHECK(wrong_thread == 0);
+    bool on_zero = true;
+    for (TaskId id = 20; id < 40; id++) on_zero &= graph.timings()[id].ran && graph.timings()[id].thread == 0;
+    CHECK(on_zero);
+
+    // A caller task at the end of a chain that only worker threads could start still runs.
+    TaskGraph chain;
+    bool done = false;
+    TaskId first = chain.add("first", [] {});
+    chain.add("last", [&] { done = std::this_thread::get_id() == caller; }, { first }, Affinity::caller);
+    chain.run(2);
+    CHECK(done);
+}
+
+void critical_path_is_the_slow_chain() {
+    TaskGraph graph;
+    auto sleep_ms = [](int ms) { return [ms] { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }; };
+    TaskId a = graph.add("a", sleep_ms(5));
+    TaskId b = graph.add("b", sleep_ms(1));
+    TaskId c = graph.add("c", sleep_ms(20), { a });
+    TaskId d = graph.add("d", sleep_ms(1), { b });
+    TaskId e = graph.add("e", sleep_ms(2), { c, d });
+    graph.run(2);
+    CHECK(graph.critical_path() == (std::vector<TaskId>{ a, c, e }));
+    CHECK(graph.wall_ms() >= 27);
+    CHECK(graph.report().find("critical path") != std::string::npos);
+
+    TaskGraph empty;
+    empty.run();
+    CHECK(empty.critical_path().empty());
+}
+
+int main() {
+    dependencies_are_respected();
+    exceptions_skip_dependents();
+    caller_affinity_stays_on_caller();
+    critical_path_is_the_slow_chain();
+    return check::result();
+}
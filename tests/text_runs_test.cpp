@@ -0,0 +1,629 @@
+// The text path on fonts built here byte by byte, so it doesn't depend on what's installed. The
+// TrueType reader maps characters through a format 4 cmap (delta and glyph array segments, and the
+// wrap of the delta), reads simple glyphs in long and short loca fonts, places composite components
+// with their offsets and scale, x/y scale and 2x2 transforms, nested, and rasterizes outlines to the
+// coverage their areas give. Truncated and damaged fonts throw runtime_error and never read past
+// the end. The glyph cache packs shelves, evicts the least recently used one and never one used this
+// frame, and warm() packs the same as get(); the run cache hits on the same text and style, and
+// misses on anything else or after an eviction.
+
+#include "truetype_font.h"
+#include "glyph_cache.h"
+#include "text_runs.h"
+#include "check.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace text;
+
+// Big endian writes, padded to a multiple of 2 or 4 where the format wants it.
+struct Bytes {
+    std::vector<uint8_t> data;
+
+    void u8(int v) { data.push_back(uint8_t(v)); }
+    void u16(int v) { u8(v >> 8); u8(v); }
+    void u32(uint32_t v) { u16(int(v >> 16)); u16(int(v & 0xffff)); }
+    void append(const Bytes& b) { data.insert(data.end(), b.data.begin(), b.data.end()); }
+    void pad(size_t to) { while (data.size() % to) u8(0); }
+};
+
+struct Pt {
+    int x, y;
+    bool on = true;
+};
+
+// A simple glyph, packed the way font tools do: short or repeated coordinates where they fit, and
+// runs of equal flags with the repeat flag, so every branch of the flag decoding gets used.
+Bytes simple_glyph(const std::vector<std::vector<Pt>>& contours) {
+    std::vector<Pt> points;
+    for (const auto& c : contours) points.insert(points.end(), c.begin(), c.end());
+    Bytes g;
+    g.u16(int(contours.size()));
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    for (const Pt& p : points) {
+        x0 = std::min(x0, p.x), y0 = std::min(y0, p.y), x1 = std::max(x1, p.x), y1 = std::max(y1, p.y);
+    }
+    for (int v : { x0, y0, x1, y1 }) g.u16(v);
+    int end = -1;
+    for (const auto& c : contours) g.u16(end += int(c.size()));
+    g.u16(0);   // no instructions
+    std::vector<uint8_t> flags;
+    std::vector<int> dxs, dys;
+    Pt previous = { 0, 0 };
+    for (const Pt& p : points) {
+        int dx = p.x - previous.x, dy = p.y - previous.y;
+        uint8_t f = p.on ? 1 : 0;
+        f |= dx == 0 ? 16 : std::abs(dx) < 256 ? (dx > 0 ? 2 | 16 : 2) : 0;
+        f |= dy == 0 ? 32 : std::abs(dy) < 256 ? (dy > 0 ? 4 | 32 : 4) : 0;
+        flags.push_back(f);
+        dxs.push_back(dx);
+        dys.push_back(dy);
+        previous = p;
+    }
+    for (size_t i = 0; i < flags.size();) {
+        size_t repeat = 0;
+        while (i + repeat + 1 < flags.size() && flags[i + repeat + 1] == flags[i] && repeat < 255) repeat++;
+        if (repeat) {
+            g.u8(flags[i] | 8);
+            g.u8(int(repeat));
+        } else {
+            g.u8(flags[i]);
+        }
+        i += repeat + 1;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        const std::vector<int>& ds = pass ? dys : dxs;
+        const int short_bit = pass ? 4 : 2, same_bit = pass ? 32 : 16;
+        for (size_t i = 0; i < flags.size(); i++) {
+            if (flags[i] & short_bit) g.u8(std::abs(ds[i]));
+            else if (!(flags[i] & same_bit)) g.u16(ds[i]);
+        }
+    }
+    g.pad(2);
+    return g;
+}
+
+// One part of a composite glyph: no transform, a scale, an x and y scale or a 2x2.
+struct Component {
+    uint16_t glyph;
+    int dx, dy;
+    std::vector<double> transform;
+};
+
+Bytes composite_glyph(const std::vector<Component>& components) {
+    Bytes g;
+    g.u16(0xffff);      // -1 contours
+    for (int i = 0; i < 4; i++) g.u16(0);
+    for (size_t i = 0; i < components.size(); i++) {
+        const Component& c = components[i];
+        bool words = c.dx < -128 || c.dx > 127 || c.dy < -128 || c.dy > 127;
+        int flags = 2 | (words ? 1 : 0) | (i + 1 < components.size() ? 0x20 : 0);
+        flags |= c.transform.size() == 1 ? 8 : c.transform.size() == 2 ? 0x40 : c.transform.size() == 4 ? 0x80 : 0;
+        g.u16(flags);
+        g.u16(c.glyph);
+        if (words) {
+            g.u16(c.dx);
+            g.u16(c.dy);
+        } else {
+            g.u8(c.dx);
+            g.u8(c.dy);
+        }
+        for (double t : c.transform) g.u16(int(std::lround(t * 16384)));
+    }
+    g.pad(2);
+    return g;
+}
+
+// cmap format 4: 'A' to 'C' are glyphs 1 to 3 by delta; 'a' to 'c' go through the glyph array,
+// [3, 0, 4] plus a delta of 1, so 'b' is missing; U+F000 is glyph 1 by a delta that wraps; and
+// the 0xffff segment that ends every table.
+Bytes cmap_table() {
+    struct Segment { int start, end, delta; std::vector<int> glyphs; };
+    const std::vector<Segment> segments = {
+        { 0x41, 0x43, 1 - 0x41, {} },
+        { 0x61, 0x63, 1, { 3, 0, 4 } },
+        { 0xf000, 0xf000, (1 - 0xf000) & 0xffff, {} },
+        { 0xffff, 0xffff, 1, {} },
+    };
+    const int n = int(segments.size());
+    Bytes sub;
+    sub.u16(4);
+    sub.u16(0);     // length, patched below
+    sub.u16(0);
+    sub.u16(2 * n);
+    sub.u16(8);     // searchRange and so on, which the reader doesn't use
+    sub.u16(2);
+    sub.u16(0);
+    for (const auto& s : segments) sub.u16(s.end);
+    sub.u16(0);
+    for (const auto& s : segments) sub.u16(s.start);
+    for (const auto& s : segments) sub.u16(s.delta);
+    int array_at = 0;
+    for (int i = 0; i < n; i++) {
+        // From this idRangeOffset entry to the segment's place in the glyph array after them.
+        sub.u16(segments[i].glyphs.empty() ? 0 : 2 * (n - i) + 2 * array_at);
+        array_at += int(segments[i].glyphs.size());
+    }
+    for (const auto& s : segments) {
+        for (int g : s.glyphs) sub.u16(g);
+    }
+    sub.data[2] = uint8_t(sub.data.size() >> 8);
+    sub.data[3] = uint8_t(sub.data.size());
+    Bytes cmap;
+    cmap.u16(0);
+    cmap.u16(1);
+    cmap.u16(3);
+    cmap.u16(1);
+    cmap.u32(12);
+    cmap.append(sub);
+    return cmap;
+}
+
+// 1000 units per em, ascent 800, descent 200, line gap 100. Advances 500, 700, then 900 for every
+// glyph from 2 on; kerning A B -40 and B C +25.
+std::vector<uint8_t> build_font(const std::vector<Bytes>& glyphs, bool long_loca = true) {
+    Bytes head;
+    head.u32(0x00010000);
+    for (int i = 0; i < 4; i++) head.u16(0);
+    head.u32(0x5f0f3cf5);
+    head.u16(0);
+    head.u16(1000);                                 // unitsPerEm, at 18
+    for (int i = 0; i < 15; i++) head.u16(0);
+    head.u16(long_loca ? 1 : 0);                    // indexToLocFormat, at 50
+    head.u16(0);
+
+    Bytes maxp;
+    maxp.u32(0x00005000);
+    maxp.u16(int(glyphs.size()));
+
+    Bytes hhea;
+    hhea.u32(0x00010000);
+    hhea.u16(800);
+    hhea.u16(-200);
+    hhea.u16(100);
+    for (int i = 0; i < 12; i++) hhea.u16(0);
+    hhea.u16(3);                                    // numberOfHMetrics, at 34
+
+    Bytes hmtx;
+    for (int advance : { 500, 700, 900 }) {
+        hmtx.u16(advance);
+        hmtx.u16(0);
+    }
+
+    Bytes kern;
+    kern.u16(0);
+    kern.u16(1);
+    kern.u16(0);
+    kern.u16(14 + 2 * 6);
+    kern.u16(1);        // horizontal, format 0
+    kern.u16(2);
+    for (int i = 0; i < 3; i++) kern.u16(0);
+    kern.u16(1), kern.u16(2), kern.u16(-40);
+    kern.u16(2), kern.u16(3), kern.u16(25);
+
+    Bytes glyf, loca;
+    for (const Bytes& g : glyphs) {
+        long_loca ? loca.u32(uint32_t(glyf.data.size())) : loca.u16(int(glyf.data.size() / 2));
+        glyf.append(g);
+    }
+    long_loca ? loca.u32(uint32_t(glyf.data.size())) : loca.u16(int(glyf.data.size() / 2));
+
+    const std::pair<const char*, const Bytes*> tables[] = {
+        { "head", &head }, { "hhea", &hhea }, { "maxp", &maxp }, { "cmap", nullptr },
+        { "hmtx", &hmtx }, { "kern", &kern }, { "loca", &loca }, { "glyf", &glyf },
+    };
+    const Bytes cmap = cmap_table();
+    const int count = int(std::size(tables));
+    Bytes font;
+    font.u32(0x00010000);
+    font.u16(count);
+    for (int i = 0; i < 3; i++) font.u16(0);
+    size_t offset = 12 + 16 * size_t(count);
+    for (const auto& [tag, table] : tables) {
+        const Bytes& t = table ? *table : cmap;
+        for (int i = 0; i < 4; i++) font.u8(tag[i]);
+        font.u32(0);
+        font.u32(uint32_t(offset));
+        font.u32(uint32_t(t.data.size()));
+        offset += (t.data.size() + 3) / 4 * 4;
+    }
+    for (const auto& [tag, table] : tables) {
+        font.append(table ? *table : cmap);
+        font.pad(4);
+    }
+    return font.data;
+}
+
+size_t table_offset(const std::vector<uint8_t>& font, const char* tag) {
+    for (size_t record = 12; record + 16 <= font.size(); record += 16) {
+        if (std::memcmp(&font[record], tag, 4) == 0) {
+            return size_t(font[record + 8]) << 24 | font[record + 9] << 16 | font[record + 10] << 8 | font[record + 11];
+        }
+    }
+    return 0;
+}
+
+void put_u32(std::vector<uint8_t>& font, size_t at, uint32_t v) {
+    for (int i = 0; i < 4; i++) font[at + i] = uint8_t(v >> (24 - 8 * i));
+}
+
+// 0 is empty; 1 a 500 unit square; 2 an 800 unit square with a 400 unit hole; 3 a square of four
+// off curve points, which is all implied on curve points; 4 an arch, on off on; 5 is 1 at half
+// size, moved by (50, 100); 6 is 1 with x and y swapped and moved by (300, -700), then 5 scaled
+// by 1.5 in x and moved by (10, 20).
+std::vector<Bytes> test_glyphs() {
+    const std::vector<Pt> square = { { 100, 0 }, { 100, 500 }, { 600, 500 }, { 600, 0 } };
+    return {
+        Bytes(),
+        simple_glyph({ square }),
+        simple_glyph({ { { 0, 0 }, { 0, 800 }, { 800, 800 }, { 800, 0 } },
+                       { { 200, 200 }, { 600, 200 }, { 600, 600 }, { 200, 600 } } }),
+        simple_glyph({ { { 0, 0, false }, { 0, 1000, false }, { 1000, 1000, false }, { 1000, 0, false } } }),
+        simple_glyph({ { { 0, 0 }, { 500, 1000, false }, { 1000, 0 } } }),
+        composite_glyph({ { 1, 50, 100, { 0.5 } } }),
+        composite_glyph({ { 1, 300, -700, { 0, 1, 1, 0 } }, { 5, 10, 20, { 1.5, 1 } } }),
+    };
+}
+
+bool near(double a, double b, double tolerance) {
+    return std::abs(a - b) <= tolerance;
+}
+
+bool same_point(const OutlinePoint& p, float x, float y) {
+    return near(p.x, x, 0.01) && near(p.y, y, 0.01) && p.on_curve;
+}
+
+double covered_pixels(const GlyphBitmap& b) {
+    double sum = 0;
+    for (uint8_t c : b.coverage) sum += c;
+    return sum / 255;
+}
+
+void cmap_format_4() {
+    TrueTypeFont font(build_font(test_glyphs()));
+    CHECK(font.glyph_count() == 7);
+    CHECK(font.glyph_index('A') == 1 && font.glyph_index('B') == 2 && font.glyph_index('C') == 3);
+    CHECK(font.glyph_index('@') == 0 && font.glyph_index('D') == 0);
+    CHECK(font.glyph_index('a') == 4 && font.glyph_index('b') == 0 && font.glyph_index('c') == 5);
+    CHECK(font.glyph_index('`') == 0 && font.glyph_index('d') == 0);
+    CHECK(font.glyph_index(0xf000) == 1 && font.glyph_index(0xefff) == 0 && font.glyph_index(0xf001) == 0);
+    CHECK(font.glyph_index(0xffff) == 0);
+    CHECK(font.glyph_index(0x1f600) == 0);      // past the BMP, which format 4 can't map
+
+    FontMetrics m = font.metrics(10);
+    CHECK(near(m.ascent, 8, 1e-4) && near(m.descent, 2, 1e-4) && near(m.line_gap, 1, 1e-4));
+    CHECK(font.advance_units(0) == 500 && font.advance_units(1) == 700 && font.advance_units(6) == 900);
+    CHECK(font.kerning_units(1, 2) == -40 && font.kerning_units(2, 3) == 25);
+    CHECK(font.kerning_units(2, 1) == 0 && font.kerning_units(1, 3) == 0);
+
+    TrueTypeRasterizer rasterizer;
+    FontId id = rasterizer.add_font(std::move(font));
+    ShapedRun run = shape(rasterizer, "ABC", { id, 10 });
+    CHECK(run.glyphs.size() == 3 && run.glyphs[0].glyph == 1 && run.glyphs[2].glyph == 3);
+    CHECK(near(run.glyphs[0].x, 0, 1e-4) && near(run.glyphs[1].x, 6.6, 1e-4) && near(run.glyphs[2].x, 15.85, 1e-4));
+    CHECK(near(run.width, 24.85, 1e-4));
+    CHECK(decode_utf8("a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80") == std::u32string({ 'a', 0xe9, 0x20ac, 0x1f600 }));
+    CHECK(decode_utf8("\xc3(\xff") == std::u32string({ 0xfffd, '(', 0xfffd }));
+}
+
+void simple_glyphs() {
+    for (bool long_loca : { true, false }) {
+        TrueTypeFont font(build_font(test_glyphs(), long_loca));
+        CHECK(font.outline(0).points.empty());
+        Outline square = font.outline(1);
+        CHECK(square.points.size() == 4 && square.contour_ends == std::vector<uint32_t>({ 4 }));
+        CHECK(same_point(square.points[0], 100, 0) && same_point(square.points[2], 600, 500));
+        CHECK(square.x_min == 100 && square.x_max == 600 && square.y_min == 0 && square.y_max == 500);
+        Outline ring = font.outline(2);
+        CHECK(ring.points.size() == 8 && ring.contour_ends == std::vector<uint32_t>({ 4, 8 }));
+        CHECK(same_point(ring.points[5], 600, 200));
+        Outline arch = font.outline(4);
+        CHECK(arch.points.size() == 3 && !arch.points[1].on_curve && arch.points[1].y == 1000);
+    }
+
+    // At 10 pixels, 100 units a pixel: the square is 5 pixels on a side, from x = 1, sitting on
+    // the baseline.
+    TrueTypeRasterizer rasterizer;
+    FontId id = rasterizer.add_font(TrueTypeFont(build_font(test_glyphs())));
+    GlyphBitmap b = rasterizer.rasterize(id, 10, 1, 0);
+    CHECK(b.left == 1 && b.top == -5 && b.width == 6 && b.height == 6);
+    bool exact = true;
+    for (int y = 0; y < b.height; y++) {
+        for (int x = 0; x < b.width; x++) exact &= b.coverage[size_t(y) * b.width + x] == (x < 5 && y < 5 ? 255 : 0);
+    }
+    CHECK(exact);
+    // Half a pixel along, the same area over one more column.
+    GlyphBitmap shifted = rasterizer.rasterize(id, 10, 1, 0.5f);
+    CHECK(shifted.left == 1 && shifted.width == 7);
+    CHECK(near(covered_pixels(shifted), 25, 0.05));
+    CHECK(std::abs(shifted.coverage[0] - 128) <= 1 && shifted.coverage[2] == 255);
+
+    CHECK(near(covered_pixels(rasterizer.rasterize(id, 10, 2, 0)), 64 - 16, 0.05));
+    // Curves are flattened into lines a little inside them, which loses up to a pixel each. Four
+    // implied on curve points at the middles of the sides: a diamond plus four parabolic segments
+    // of 2/3 the triangles they cut from the corners.
+    CHECK(near(covered_pixels(rasterizer.rasterize(id, 10, 3, 0)), 50 + 4 * 12.5 * 2 / 3, 4));
+    // Under a parabola, 2/3 of base times height, and the height is half the control point's.
+    CHECK(near(covered_pixels(rasterizer.rasterize(id, 10, 4, 0)), 2.0 / 3 * 10 * 5, 1));
+    CHECK(rasterizer.rasterize(id, 10, 0, 0).coverage.empty());
+    // Past the glyph count is the empty glyph too.
+    CHECK(rasterizer.rasterize(id, 10, 100, 0).coverage.empty());
+}
+
+void composite_glyphs() {
+    TrueTypeFont font(build_font(test_glyphs()));
+    Outline half = font.outline(5);
+    CHECK(half.points.size() == 4 && half.contour_ends == std::vector<uint32_t>({ 4 }));
+    CHECK(same_point(half.points[0], 100, 100) && same_point(half.points[2], 350, 350));
+
+    // The first component swaps x and y, the second scales the first composite's points again.
+    Outline nested = font.outline(6);
+    CHECK(nested.points.size() == 8 && nested.contour_ends == std::vector<uint32_t>({ 4, 8 }));
+    CHECK(same_point(nested.points[0], 0 + 300, 100 - 700));
+    CHECK(same_point(nested.points[1], 500 + 300, 100 - 700));
+    CHECK(same_point(nested.points[2], 500 + 300, 600 - 700));
+    // (x, y) in glyph 1 is (0.5x + 50, 0.5y + 100) in glyph 5, then (1.5 * that + 10, that + 20).
+    CHECK(same_point(nested.points[4], 0.75f * 100 + 85, 0.5f * 0 + 120));
+    CHECK(same_point(nested.points[6], 0.75f * 600 + 85, 0.5f * 500 + 120));
+    CHECK(nested.x_min == 160 && nested.x_max == 800 && nested.y_min == -600 && nested.y_max == 370);
+
+    TrueTypeRasterizer rasterizer;
+    FontId id = rasterizer.add_font(std::move(font));
+    CHECK(near(covered_pixels(rasterizer.rasterize(id, 10, 5, 0)), 2.5 * 2.5, 0.05));
+    CHECK(near(covered_pixels(rasterizer.rasterize(id, 10, 6, 0)), 25 + 3.75 * 2.5, 0.1));
+}
+
+// Constructing and then using the font either works or throws runtime_error, and counts which.
+struct Outcome {
+    int loaded = 0;
+    int refused = 0;
+    int threw_later = 0;
+    bool only_runtime_errors = true;
+};
+
+void try_font(std::vector<uint8_t> data, Outcome& outcome) {
+    try {
+        TrueTypeRasterizer rasterizer;
+        FontId id = rasterizer.add_font(TrueTypeFont(std::move(data)));
+        outcome.loaded++;
+        try {
+            for (char32_t c : { U'A', U'B', U'b', U'\xf000', U'\x1f600' }) rasterizer.glyph_index(id, c);
+            rasterizer.kerning(id, 10, 1, 2);
+            for (uint16_t g = 0; g < rasterizer.font(id).glyph_count(); g++) {
+                rasterizer.advance(id, 10, g);
+                rasterizer.rasterize(id, 10, g, 0.25f);
+            }
+        } catch (const std::runtime_error&) {
+            outcome.threw_later++;
+        }
+    } catch (const std::runtime_error&) {
+        outcome.refused++;
+    } catch (...) {
+        outcome.only_runtime_errors = false;
+    }
+}
+
+void malformed_fonts() {
+    const std::vector<uint8_t> good = build_font(test_glyphs());
+    CHECK_THROWS(TrueTypeFont(std::vector<uint8_t>()), std::runtime_error);
+    CHECK_THROWS(TrueTypeFont(std::vector<uint8_t>(good.begin(), good.begin() + 100)), std::runtime_error);
+
+    // Every table cut short, at every length.
+    Outcome truncated;
+    for (size_t size = 0; size < good.size(); size++) try_font({ good.begin(), good.begin() + size }, truncated);
+    CHECK(truncated.only_runtime_errors);
+    CHECK(truncated.refused > 0 && truncated.loaded > 0 && truncated.threw_later > 0);
+    Outcome whole;
+    try_font(good, whole);
+    CHECK(whole.loaded == 1 && whole.threw_later == 0);
+
+    // No glyf table, and no units per em.
+    std::vector<uint8_t> font = good;
+    for (size_t record = 12; record < 12 + 16 * 8; record += 16) {
+        if (std::memcmp(&font[record], "glyf", 4) == 0) font[record + 3] = 'x';
+    }
+    CHECK_THROWS(TrueTypeFont(font), std::runtime_error);
+    font = good;
+    font[table_offset(font, "head") + 18] = font[table_offset(font, "head") + 19] = 0;
+    CHECK_THROWS(TrueTypeFont(font), std::runtime_error);
+
+    // loca pointing glyph 1 past the end of the file, and glyph 2 backwards.
+    font = good;
+    size_t loca = table_offset(font, "loca");
+    put_u32(font, loca + 4, 0x00ffff00);
+    put_u32(font, loca + 8, 0x00ffff40);
+    TrueTypeFont bad_loca(font);
+    CHECK_THROWS(bad_loca.outline(1), std::runtime_error);
+    font = good;
+    put_u32(font, loca + 12, 0);
+    CHECK(TrueTypeFont(font).outline(2).points.empty());
+    Outcome damaged;
+    try_font(font, damaged);
+    CHECK(damaged.loaded == 1 && damaged.only_runtime_errors);
+
+    // Contour ends that go down, or repeat, would have the contours run past the points decoded
+    // for the last one.
+    for (std::vector<int> ends : { std::vector<int>{ 10, 3 }, std::vector<int>{ 3, 3 } }) {
+        Bytes glyph;
+        glyph.u16(2);
+        for (int i = 0; i < 4; i++) glyph.u16(0);
+        for (int end : ends) glyph.u16(end);
+        glyph.u16(0);
+        for (int i = 0; i < 4; i++) glyph.u8(1 | 16 | 32);
+        TrueTypeFont bad_ends(build_font({ Bytes(), glyph }));
+        CHECK_THROWS(bad_ends.outline(1), std::runtime_error);
+        TrueTypeRasterizer rasterizer;
+        FontId id = rasterizer.add_font(std::move(bad_ends));
+        CHECK_THROWS(rasterizer.rasterize(id, 10, 1, 0), std::runtime_error);
+    }
+    // A composite that uses itself stops at the nesting limit.
+    TrueTypeFont recursive(build_font({ Bytes(), composite_glyph({ { 1, 1, 1, {} } }) }));
+    CHECK(recursive.outline(1).points.empty());
+}
+
+// Glyph g at size s is a g x s box of coverage g, on the baseline. 'a' is glyph 1, 'b' 2 and so on.
+class BoxFont final : public GlyphRasterizer {
+public:
+    uint16_t glyph_index(FontId, char32_t c) const override { return uint16_t(c - 0x60); }
+    FontMetrics metrics(FontId, float size) const override { return { size, 0, 0 }; }
+    float advance(FontId, float size, uint16_t glyph) const override { return glyph + 0.25f; }
+    float kerning(FontId, float, uint16_t, uint16_t) const override { return 0; }
+
+    GlyphBitmap rasterize(FontId, float size, uint16_t glyph, float) const override {
+        GlyphBitmap b;
+        b.width = glyph;
+        b.height = int(size);
+        b.top = -b.height;
+        b.coverage.assign(size_t(b.width) * b.height, uint8_t(glyph));
+        return b;
+    }
+};
+
+GlyphKey box(uint16_t width, int height, uint8_t subpixel = 0) {
+    return { 0, width, uint32_t(height * 64), subpixel };
+}
+
+bool filled(const GlyphCache& cache, const AtlasRect& r, uint8_t value) {
+    bool ok = true;
+    for (int y = r.y; y < r.y + r.height; y++) {
+        const uint8_t* row = cache.atlas_pixels() + size_t(y) * cache.atlas_width();
+        for (int x = r.x; x < r.x + r.width; x++) ok &= row[x] == value;
+    }
+    return ok;
+}
+
+bool same_rect(const AtlasRect& a, const AtlasRect& b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+// Glyphs are 1 pixel apart and shelves 8 pixels apart in height.
+void glyph_shelves() {
+    BoxFont font;
+    GlyphCache cache(font, 64, 32);
+    cache.clear_dirty();
+    const CachedGlyph* a = cache.get(box(10, 7));
+    CHECK(a && same_rect(a->rect, { 0, 0, 10, 7 }) && a->top == -7);
+    CHECK(cache.dirty_top() == 0 && cache.dirty_bottom() == 7);
+    CHECK(same_rect(cache.get(box(20, 7))->rect, { 11, 0, 20, 7 }));
+    // Shorter, but close enough to share the shelf.
+    CHECK(same_rect(cache.get(box(12, 5))->rect, { 32, 0, 12, 5 }));
+    // Twice as tall gets a shelf of its own, and so does one that doesn't fit across the first.
+    CHECK(same_rect(cache.get(box(12, 15))->rect, { 0, 8, 12, 15 }));
+    CHECK(same_rect(cache.get(box(40, 7))->rect, { 0, 24, 40, 7 }));
+    CHECK(filled(cache, cache.get(box(20, 7))->rect, 20) && filled(cache, { 31, 0, 1, 8 }, 0));
+    CHECK(cache.size() == 5 && cache.stats().misses == 5 && cache.stats().hits == 1);
+
+    // The same glyph at another subpixel position is another entry.
+    CHECK(same_rect(cache.get(box(10, 7, 1))->rect, { 45, 0, 10, 7 }));
+    CHECK(cache.get(box(10, 7)) == a && cache.size() == 6);
+    // Blank glyphs take no room; too wide or too tall for the atlas isn't cached.
+    CHECK(cache.get(box(0, 7))->rect.width == 0);
+    CHECK(!cache.get(box(64, 7)) && !cache.get(box(5, 40)) && cache.stats().too_big == 2);
+}
+
+// Four shelves, each filled by one glyph, then more glyphs than fit.
+void glyph_eviction() {
+    BoxFont font;
+    GlyphCache cache(font, 64, 32);
+    for (uint16_t g = 60; g < 64; g++) {
+        cache.begin_frame();
+        CHECK(cache.get(box(g - 1, 7))->rect.y == (g - 60) * 8);
+    }
+    // The first shelf used again, so the second is the least recently used one.
+    cache.begin_frame();
+    cache.get(box(59, 7));
+    cache.begin_frame();
+    cache.clear_dirty();
+    const CachedGlyph* in_its_place = cache.get(box(30, 7));
+    CHECK(in_its_place && in_its_place->rect.y == 8);
+    CHECK(cache.stats().evicted_shelves == 1 && cache.stats().evicted_glyphs == 1);
+    CHECK(cache.dirty_top() == 8 && cache.dirty_bottom() == 16);
+    CHECK(filled(cache, { 30, 8, 34, 8 }, 0));
+    uint64_t misses = cache.stats().misses;
+    cache.get(box(59, 7));
+    cache.get(box(61, 7));
+    CHECK(cache.stats().misses == misses);
+    cache.get(box(60, 7));
+    CHECK(cache.stats().misses == misses + 1 && cache.stats().evicted_shelves == 2);
+
+    // Everything used this frame stays, even with no room for the next glyph.
+    cache.begin_frame();
+    for (uint16_t g : { 59, 30, 60, 61 }) cache.get(box(g, 7));
+    CHECK(!cache.get(box(50, 7)));
+    bool kept = true;
+    for (uint16_t g : { 59, 30, 60, 61 }) kept &= cache.get(box(g, 7)) != nullptr;
+    CHECK(kept);
+    // A taller glyph can't take a shorter shelf, used or not.
+    cache.begin_frame();
+    CHECK(!cache.get(box(10, 15)));
+}
+
+void warm_matches_get() {
+    BoxFont font;
+    std::vector<GlyphKey> keys;
+    for (uint16_t g = 1; g < 40; g++) keys.push_back(box(g, 6 + g % 12, uint8_t(g % subpixel_steps)));
+    keys.push_back(keys[3]);
+    GlyphCache one(font, 256, 256), warmed(font, 256, 256);
+    for (const auto& k : keys) one.get(k);
+    warmed.warm(keys, 3);
+    CHECK(warmed.size() == one.size() && warmed.stats().misses == one.stats().misses);
+    bool same = true;
+    for (const auto& k : keys) same &= same_rect(one.get(k)->rect, warmed.get(k)->rect);
+    CHECK(same);
+    CHECK(std::memcmp(one.atlas_pixels(), warmed.atlas_pixels(), 256 * 256) == 0);
+}
+
+void run_cache() {
+    BoxFont font;
+    RunCache runs(font, 2);
+    const TextStyle small = { 0, 12 }, big = { 0, 16 }, other_font = { 1, 16 };
+    const ShapedRun& ab = runs.get("ab", big);
+    CHECK(ab.glyphs.size() == 2 && ab.glyphs[1].glyph == 2 && near(ab.glyphs[1].x, 1.25, 1e-6));
+    CHECK(near(ab.width, 3.5, 1e-6));
+    runs.get("ab", big);
+    CHECK(runs.stats().hits == 1 && runs.stats().misses == 1);
+    // Another size, font or string is another run.
+    runs.get("ab", small);
+    runs.get("ab", big);
+    CHECK(runs.stats().hits == 2 && runs.stats().misses == 2 && runs.size() == 2);
+    // Full: the least recently used, "ab" small, goes.
+    runs.get("abc", big);
+    CHECK(runs.stats().evictions == 1 && runs.size() == 2);
+    runs.get("ab", big);
+    CHECK(runs.stats().hits == 3);
+    const ShapedRun& again = runs.get("ab", small);
+    CHECK(runs.stats().misses == 4 && runs.stats().evictions == 2);
+    CHECK(again.glyphs.size() == 2 && near(again.width, 3.5, 1e-6));
+    runs.get("ab", other_font);
+    runs.get("abc", big);
+    CHECK(runs.stats().misses == 6 && runs.stats().hits == 3);
+
+    // Quads at each glyph's subpixel position: pens at 10.5, 11.75 and 14, on a baseline at 20.
+    GlyphCache cache(font, 64, 64);
+    std::vector<GlyphQuad> quads;
+    CHECK(emit_quads(cache, runs.get("abc", big), big, 10.5f, 20, 0xffffffffu, quads) == 0);
+    CHECK(quads.size() == 3 && quads[0].x == 10 && quads[1].x == 11 && quads[2].x == 14 && quads[0].y == 4);
+    CHECK(cache.get(box(1, 16, 2)) && cache.get(box(2, 16, 3)) && cache.get(box(3, 16, 0)));
+    CHECK(cache.size() == 3 && cache.stats().hits == 3);
+    std::vector<TextVertex> vertices;
+    std::vector<uint32_t> indices;
+    quad_vertices(quads, 64, 64, vertices, indices);
+    CHECK(vertices.size() == 12 && indices.size() == 18 && indices[6] == 4);
+    CHECK(vertices[2].x == 11 && vertices[2].y == 20 && near(vertices[2].u, 1.0 / 64, 1e-6));
+}
+
+int main() {
+    cmap_format_4();
+    simple_glyphs();
+    composite_glyphs();
+    malformed_fonts();
+    glyph_shelves();
+    glyph_eviction();
+    warm_matches_get();
+    run_cache();
+    return check::result();
+}
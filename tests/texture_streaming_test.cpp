@@ -0,0 +1,511 @@
+// Mip files and the streamer that reads them. parse_mip_header() turns down every kind of bad header
+// it checks for, including offsets that would wrap past the end of a u64, and what build_mip_file()
+// writes parses back to every level, with the top one the image itself. TextureStreamer, over an
+// in-memory reader that logs its reads: headers first, biggest on screen first, then mips coarsest
+// first; over the budget it evicts what matters less than what it's reading and nothing that
+// matters as much; failed, short and damaged reads give up on the texture. And io_uring (where
+// there is one) reads the same bytes as blocking reads, ends of files included.
+
+#include "texture_streaming.h"
+#include "check.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace streaming;
+namespace fs = std::filesystem;
+
+std::vector<uint32_t> noise(int width, int height, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> pixels(size_t(width) * height);
+    for (auto& p : pixels) p = rng();
+    return pixels;
+}
+
+// Where level i's fields are in a mip file.
+size_t level_at(int i) {
+    return 20 + size_t(i) * 24;
+}
+
+template <class T>
+void put(std::vector<uint8_t>& file, size_t at, T v) {
+    std::memcpy(file.data() + at, &v, sizeof(v));
+}
+
+template <class T>
+T get(const std::vector<uint8_t>& file, size_t at) {
+    T v;
+    std::memcpy(&v, file.data() + at, sizeof(v));
+    return v;
+}
+
+// What parse_mip_header() says about it, or "" if it takes it.
+std::string rejection(const std::vector<uint8_t>& file) {
+    try {
+        parse_mip_header(file);
+        return "";
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+}
+
+bool rejected(const std::vector<uint8_t>& file, const char* why) {
+    return rejection(file).find(why) != std::string::npos;
+}
+
+void bad_headers() {
+    // 8x4, 4x2, 2x1, 1x1 and all stored as they are, since noise doesn't compress.
+    const std::vector<uint32_t> pixels = noise(8, 4, 1);
+    const std::vector<uint8_t> good = build_mip_file(pixels.data(), 8, 4, 8);
+    CHECK(rejection(good).empty());
+    CHECK(get<uint32_t>(good, level_at(3) + 20) == 0);
+
+    std::vector<uint8_t> f = good;
+    f[0] = 'X';
+    CHECK(rejected(f, "not a mip file"));
+    CHECK(rejected({ good.begin(), good.begin() + 19 }, "not a mip file"));
+    CHECK(rejected({}, "not a mip file"));
+
+    f = good;
+    put<uint32_t>(f, 16, 0);
+    CHECK(rejected(f, "bad mip count"));
+    put<uint32_t>(f, 16, 16);
+    CHECK(rejected(f, "bad mip count"));
+    put<uint32_t>(f, 16, 0xffffffffu);
+    CHECK(rejected(f, "bad mip count"));
+    // The table doesn't fit in what was read.
+    CHECK(rejected({ good.begin(), good.begin() + level_at(3) + 20 }, "bad mip count"));
+
+    // 4x2 made 4x3, with the stored size to match.
+    f = good;
+    put<uint32_t>(f, level_at(2) + 4, 3);
+    put<uint32_t>(f, level_at(2) + 16, 4 * 3 * 4);
+    CHECK(rejected(f, "don't halve"));
+    f = good;
+    put<uint32_t>(f, 8, 16);
+    CHECK(rejected(f, "don't halve"));
+    f = good;
+    put<uint32_t>(f, level_at(3), 0);
+    CHECK(rejected(f, "bad mip level"));
+
+    // Offsets in the table, and ones so big that the end of the level wraps around or is past any
+    // file there could be.
+    f = good;
+    put<uint64_t>(f, level_at(0) + 8, level_at(3) + 23);
+    CHECK(rejected(f, "bad mip level"));
+    for (uint64_t offset : { ~0ull - 2, ~0ull - 200, 1ull << 40, (1ull << 32) - 2 }) {
+        f = good;
+        put<uint64_t>(f, level_at(1) + 8, offset);
+        CHECK(rejected(f, "bad mip level"));
+    }
+
+    // Stored sizes: exactly the pixels when raw, no more than lz can make of them when packed.
+    f = good;
+    put<uint32_t>(f, level_at(2) + 16, 4 * 2 * 4 + 1);
+    CHECK(rejected(f, "bad mip level"));
+    put<uint32_t>(f, level_at(2) + 16, 4 * 2 * 4 - 1);
+    CHECK(rejected(f, "bad mip level"));
+    put<uint32_t>(f, level_at(2) + 20, 1);
+    CHECK(rejection(f).empty());
+    put<uint32_t>(f, level_at(2) + 16, 1000);
+    CHECK(rejected(f, "bad mip level"));
+}
+
+fs::path temp_dir() {
+    fs::path dir = fs::temp_directory_path() / "dot_texture_streaming_test";
+    fs::create_directories(dir);
+    return dir;
+}
+
+std::vector<uint8_t> read_file(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {});
+}
+
+std::vector<uint32_t> unpack(const std::vector<uint8_t>& file, const MipLevel& mip) {
+    std::vector<uint32_t> pixels(size_t(mip.width) * mip.height);
+    std::span<const uint8_t> stored(file.data() + mip.offset, mip.stored_size);
+    std::span<uint8_t> out(reinterpret_cast<uint8_t*>(pixels.data()), pixels.size() * 4);
+    if (mip.flags & 1) {
+        if (!lz::decompress(stored, out)) pixels.clear();
+    } else {
+        std::memcpy(out.data(), stored.data(), out.size());
+    }
+    return pixels;
+}
+
+void round_trip() {
+    // A 100x37 window of a wider image, half flat so some levels compress and half noise.
+    const int width = 100, height = 37, pitch = 130;
+    std::vector<uint32_t> pixels = noise(pitch, height, 2);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < 50; x++) pixels[size_t(y) * pitch + x] = 0xff336699u;
+    }
+    const fs::path path = temp_dir() / "round_trip.mips";
+    write_mip_file(path, pixels.data(), width, height, pitch);
+    const std::vector<uint8_t> file = read_file(path);
+    CHECK(file == build_mip_file(pixels.data(), width, height, pitch));
+
+    MipFileHeader header = parse_mip_header(file);
+    CHECK(header.width == 100 && header.height == 37 && header.mips.size() == 7);
+    uint32_t w = 100, h = 37;
+    uint64_t offset = 20 + 7 * 24;
+    bool sizes = true, packed = true, any_lz = false;
+    for (size_t i = header.mips.size(); i-- > 0;) {
+        const MipLevel& mip = header.mips[i];
+        sizes &= mip.width == w && mip.height == h;
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+        any_lz |= (mip.flags & 1) != 0;
+        packed &= unpack(file, mip).size() == size_t(mip.width) * mip.height;
+    }
+    for (const MipLevel& mip : header.mips) {
+        packed &= mip.offset == offset;
+        offset += mip.stored_size;
+    }
+    CHECK(sizes && packed && any_lz);
+    CHECK(offset == file.size());
+    std::vector<uint32_t> top = unpack(file, header.mips.back());
+    bool same = true;
+    for (int y = 0; y < height; y++) {
+        same &= std::memcmp(&top[size_t(y) * width], &pixels[size_t(y) * pitch], size_t(width) * 4) == 0;
+    }
+    CHECK(same);
+    // Box filtered: the flat half stays flat at 50x18.
+    std::vector<uint32_t> half = unpack(file, header.mips[5]);
+    CHECK(half[0] == 0xff336699u && half[size_t(17) * 50 + 24] == 0xff336699u);
+    CHECK(unpack(file, header.mips[0]).size() == 1);
+    fs::remove(path);
+}
+
+// Files held in memory and read in complete(), with a log of every request. Reads of a file in
+// broken fail.
+class MemoryReader final : public AsyncReader {
+public:
+    explicit MemoryReader(int depth) : m_depth(depth) {}
+
+    std::map<std::string, std::vector<uint8_t>> files;
+    std::set<std::string> broken;
+    std::vector<ReadRequest> log;
+    int open_files = 0;
+
+    const char* name() const override { return "memory"; }
+
+    int open(const fs::path& path) override {
+        if (!files.contains(path.string())) return -1;
+        m_names.push_back(path.string());
+        open_files++;
+        return int(m_names.size() - 1);
+    }
+
+    void close(int) override { open_files--; }
+
+    int depth() const override { return m_depth; }
+    int in_flight() const override { return int(m_queued.size()); }
+
+    bool submit(const ReadRequest& request) override {
+        if (in_flight() >= m_depth) return false;
+        m_queued.push_back(request);
+        log.push_back(request);
+        return true;
+    }
+
+    void complete(std::vector<ReadDone>& done, bool) override {
+        for (const ReadRequest& r : m_queued) {
+            const std::string& name = m_names[r.file];
+            const std::vector<uint8_t>& data = files[name];
+            if (broken.contains(name) || r.offset >= data.size()) {
+                done.push_back({ r.tag, -1 });
+                continue;
+            }
+            size_t n = std::min<size_t>(r.size, data.size() - r.offset);
+            std::memcpy(r.dest, data.data() + r.offset, n);
+            done.push_back({ r.tag, int64_t(n) });
+        }
+        m_queued.clear();
+    }
+
+private:
+    int m_depth;
+    std::vector<std::string> m_names;
+    std::vector<ReadRequest> m_queued;
+};
+
+// A streamer over a MemoryReader, keeping what it's been handed.
+struct Harness {
+    MemoryReader* reader;
+    TextureStreamer streamer;
+    std::vector<std::vector<int>> levels;                   // per texture, in the order they came
+    std::map<TextureId, std::vector<uint32_t>> full_size;   // level 0's pixels
+    std::vector<std::pair<TextureId, int>> evictions;
+
+    Harness(int depth, uint64_t budget)
+        : Harness(std::make_unique<MemoryReader>(depth), budget) {}
+
+    Harness(std::unique_ptr<MemoryReader> r, uint64_t budget)
+        : reader(r.get()),
+          streamer(std::move(r), { budget, 256 },
+              [this](TextureId id, const StreamedMip& mip) {
+                  levels.resize(std::max<size_t>(levels.size(), id + 1));
+                  levels[id].push_back(mip.level);
+                  if (mip.level == 0) full_size[id].assign(mip.pixels.begin(), mip.pixels.end());
+              },
+              [this](TextureId id, int level) { evictions.push_back({ id, level }); }) {}
+
+    size_t delivered(TextureId id) const { return id < levels.size() ? levels[id].size() : 0; }
+
+    TextureId add(const std::string& name, std::vector<uint8_t> file) {
+        reader->files[name] = std::move(file);
+        return streamer.add(name);
+    }
+
+    // Frames with these on screen, until nothing's being read.
+    void run(std::initializer_list<std::pair<TextureId, float>> visible, int frames = 20) {
+        for (int f = 0; f < frames; f++) {
+            for (auto [id, size] : visible) streamer.set_screen_size(id, size);
+            streamer.update();
+            if (streamer.stats().in_flight == 0 && f > 0) break;
+        }
+    }
+};
+
+// Raw 64x64 mips: 16384 bytes for level 0, 4096 for level 1 and 1364 for the other five, which all
+// come in with the header.
+constexpr uint64_t level_0 = 16384, level_1 = 4096, small_levels = 1364;
+constexpr uint64_t all_levels = level_0 + level_1 + small_levels;
+
+std::vector<uint8_t> noise_file(uint32_t seed, std::vector<uint32_t>* pixels = nullptr) {
+    std::vector<uint32_t> p = noise(64, 64, seed);
+    if (pixels) *pixels = p;
+    return build_mip_file(p.data(), 64, 64, 64);
+}
+
+bool coarsest_first(const std::vector<int>& levels) {
+    bool ok = !levels.empty() && levels[0] == 6;
+    for (size_t i = 1; i < levels.size(); i++) ok &= levels[i] == levels[i - 1] - 1;
+    return ok;
+}
+
+void priority_order() {
+    Harness h(1, 1 << 20);
+    std::vector<uint32_t> big_pixels;
+    TextureId small = h.add("small", noise_file(1));
+    TextureId medium = h.add("medium", noise_file(2));
+    TextureId big = h.add("big", noise_file(3, &big_pixels));
+    TextureId hidden = h.add("hidden", noise_file(4));
+    h.run({ { small, 10 }, { medium, 100 }, { big, 1000 } });
+
+    // One read at a time: every header before any mip, by size on screen, then the rest of the big
+    // one's mips before the medium one's. The small one has all it needs from the first read.
+    const auto& log = h.reader->log;
+    CHECK(log.size() == 5);
+    std::vector<uint64_t> order;
+    for (const auto& r : log) order.push_back(r.tag);
+    CHECK(order == std::vector<uint64_t>({ big, medium, small, big, medium }));
+    CHECK(log[0].offset == 0 && log[0].size == head_bytes);
+    // Levels 1 and 0 are next to each other in the file and small, so one read takes in both.
+    CHECK(log[3].size == level_0 + level_1 && log[3].offset == 20 + 7 * 24 + small_levels);
+
+    CHECK(coarsest_first(h.levels[big]) && h.delivered(big) == 7);
+    CHECK(coarsest_first(h.levels[small]) && h.delivered(small) == 5);
+    CHECK(h.streamer.resident_level(big) == 0 && h.streamer.resident_level(medium) == 0);
+    CHECK(h.streamer.resident_level(small) == 2 && h.streamer.mip_count(small) == 7);
+    CHECK(h.streamer.mip_count(hidden) == 0 && h.delivered(hidden) == 0);
+    CHECK(h.full_size[big] == big_pixels);
+    CHECK(h.streamer.stats().resident_bytes == 2 * all_levels + small_levels);
+    // Each file is closed once its texture has what it wants.
+    CHECK(h.reader->open_files == 0);
+    CHECK(h.streamer.stats().reads == 5 && h.streamer.stats().failed == 0);
+
+    // Bigger on screen wants finer mips.
+    h.run({ { small, 20 } });
+    CHECK(h.streamer.resident_level(small) == 1);
+}
+
+// Room for one texture's levels and a bit: a second one gets its finest level only by pushing out
+// something that matters less.
+void eviction() {
+    const uint64_t budget = all_levels + small_levels + level_1 + 1000;
+    {
+        Harness h(4, budget);
+        TextureId a = h.add("a", noise_file(1)), b = h.add("b", noise_file(2));
+        h.run({ { a, 64 } });
+        CHECK(h.streamer.resident_level(a) == 0);
+        // a is off screen, so it gives up its finest level to b.
+        h.run({ { b, 64 } });
+        CHECK(h.streamer.resident_level(b) == 0 && h.streamer.resident_level(a) == 1);
+        CHECK((h.evictions == std::vector<std::pair<TextureId, int>>({ { a, 1 } })));
+        CHECK(h.streamer.stats().mips_evicted == 1);
+        CHECK(h.streamer.stats().resident_bytes == 2 * all_levels - level_0);
+        CHECK(h.streamer.stats().resident_bytes <= budget);
+    }
+    {
+        Harness h(4, budget);
+        TextureId a = h.add("a", noise_file(1)), b = h.add("b", noise_file(2));
+        h.run({ { a, 64 } });
+        // Both on screen at the same size: b's finest level matters as much as a's, so a keeps its
+        // and b gets what fits without it.
+        h.run({ { a, 64 }, { b, 64 } });
+        CHECK(h.streamer.resident_level(a) == 0 && h.streamer.resident_level(b) == 1);
+        CHECK(h.evictions.empty());
+        uint64_t reads = h.streamer.stats().reads;
+        h.run({ { a, 64 }, { b, 64 } }, 5);
+        CHECK(h.streamer.stats().reads == reads && h.streamer.resident_level(b) == 1);
+        // Bigger on screen, b wins.
+        h.run({ { a, 64 }, { b, 200 } });
+        CHECK(h.streamer.resident_level(a) == 1 && h.streamer.resident_level(b) == 0);
+        CHECK((h.evictions == std::vector<std::pair<TextureId, int>>({ { a, 1 } })));
+        CHECK(h.streamer.stats().resident_bytes <= budget);
+    }
+    {
+        // A level bigger than the whole budget is never read.
+        Harness h(4, level_0 - 1);
+        TextureId a = h.add("a", noise_file(1));
+        h.run({ { a, 64 } });
+        CHECK(h.streamer.resident_level(a) == 1 && !h.streamer.failed(a));
+    }
+}
+
+void failures() {
+    Harness h(4, 1 << 20);
+    TextureId missing = h.streamer.add("missing");
+    TextureId broken = h.add("broken", noise_file(1));
+    h.reader->broken.insert("broken");
+    std::vector<uint8_t> cut = noise_file(2);
+    cut.resize(5000);
+    TextureId short_read = h.add("short", cut);
+    std::vector<uint8_t> garbage(4096, 0x5a);
+    TextureId not_mips = h.add("garbage", garbage);
+    // Flat, so the finest levels are lz packed; then the finest damaged.
+    std::vector<uint32_t> flat(64 * 64, 0xff808080u);
+    std::vector<uint8_t> damaged = build_mip_file(flat.data(), 64, 64, 64);
+    MipLevel finest = parse_mip_header(damaged).mips.back();
+    CHECK((finest.flags & 1) != 0);
+    std::fill(damaged.begin() + ptrdiff_t(finest.offset), damaged.end(), uint8_t(0xff));
+    TextureId bad_data = h.add("bad_data", damaged);
+    // Levels ending past the end of a u64; a header like this used to get through to the read.
+    std::vector<uint8_t> wraps = noise_file(3);
+    put<uint64_t>(wraps, level_at(5) + 8, ~0ull - 100);
+    TextureId wrapping = h.add("wrapping", wraps);
+    TextureId fine = h.add("fine", noise_file(4));
+
+    std::initializer_list<std::pair<TextureId, float>> all = { { missing, 64 }, { broken, 64 }, { short_read, 64 },
+        { not_mips, 64 }, { bad_data, 64 }, { wrapping, 64 }, { fine, 64 } };
+    h.run(all);
+    for (TextureId id : { missing, broken, short_read, not_mips, bad_data, wrapping }) CHECK(h.streamer.failed(id));
+    CHECK(!h.streamer.failed(fine) && h.streamer.resident_level(fine) == 0);
+    CHECK(h.streamer.stats().failed == 6);
+    // What came before the failure stays: the short file's header read had its five coarsest levels,
+    // the damaged one all but its finest.
+    CHECK(h.delivered(short_read) == 5 && h.delivered(bad_data) == 6);
+    CHECK(h.delivered(missing) == 0 && h.delivered(broken) == 0 && h.delivered(wrapping) == 0);
+    CHECK(h.reader->open_files == 0);
+
+    // Given up on for good: no more reads for them.
+    size_t reads = h.reader->log.size();
+    h.run(all, 5);
+    CHECK(h.reader->log.size() == reads);
+}
+
+// The same reads through each reader, several at a time, ending inside and past the file.
+struct Read {
+    uint64_t offset;
+    uint32_t size;
+};
+
+std::vector<std::pair<int64_t, std::vector<uint8_t>>> read_all(AsyncReader& reader, const std::vector<fs::path>& paths,
+                                                               const std::vector<Read>& reads) {
+    std::vector<int> files;
+    for (const auto& p : paths) files.push_back(reader.open(p));
+    std::vector<std::pair<int64_t, std::vector<uint8_t>>> results(reads.size());
+    std::vector<ReadDone> done;
+    size_t next = 0, finished = 0;
+    while (finished < reads.size()) {
+        while (next < reads.size()) {
+            auto& [bytes, data] = results[next];
+            data.assign(reads[next].size, 0);
+            ReadRequest r;
+            r.file = files[next % files.size()];
+            r.offset = reads[next].offset;
+            r.size = reads[next].size;
+            r.dest = data.data();
+            r.tag = next;
+            if (!reader.submit(r)) break;
+            next++;
+        }
+        done.clear();
+        reader.complete(done, true);
+        for (const ReadDone& d : done) {
+            results[d.tag].first = d.bytes;
+            finished++;
+        }
+    }
+    for (int f : files) reader.close(f);
+    return results;
+}
+
+void readers_agree() {
+    const fs::path dir = temp_dir();
+    std::vector<fs::path> paths = { dir / "a.bin", dir / "b.bin" };
+    std::vector<std::vector<uint8_t>> contents;
+    std::mt19937 rng(5);
+    for (size_t i = 0; i < paths.size(); i++) {
+        contents.emplace_back(200000 + i * 1000);
+        for (auto& b : contents.back()) b = uint8_t(rng());
+        std::ofstream(paths[i], std::ios::binary)
+            .write(reinterpret_cast<const char*>(contents.back().data()), std::streamsize(contents.back().size()));
+    }
+    std::vector<Read> reads = { { 0, 4096 }, { 0, 4096 }, { 1000, 50000 }, { 199000, 4096 }, { 199000, 4096 },
+                                { 250000, 16 }, { 0, 201000 }, { 123457, 1 }, { 200000, 8 }, { 201000, 8 } };
+    for (int i = 0; i < 40; i++) reads.push_back({ rng() % 200000, uint32_t(1 + rng() % 70000) });
+
+    auto async = make_reader(3), blocking = make_blocking_reader(3);
+    std::printf("reading through %s\n", async->name());
+    for (AsyncReader* reader : { async.get(), blocking.get() }) {
+        CHECK(reader->open(dir / "not there") == -1);
+        auto results = read_all(*reader, paths, reads);
+        bool right = true;
+        for (size_t i = 0; i < reads.size(); i++) {
+            const std::vector<uint8_t>& file = contents[i % paths.size()];
+            auto [bytes, data] = results[i];
+            if (reads[i].offset >= file.size()) {
+                right &= bytes == -1;
+                continue;
+            }
+            size_t expected = std::min<size_t>(reads[i].size, file.size() - reads[i].offset);
+            right &= bytes == int64_t(expected);
+            right &= std::memcmp(data.data(), file.data() + reads[i].offset, expected) == 0;
+        }
+        CHECK(right);
+        CHECK(reader->in_flight() == 0);
+    }
+
+    // No more than depth at a time.
+    int file = async->open(paths[0]);
+    std::vector<uint8_t> buffer(4 * 16);
+    int accepted = 0;
+    for (int i = 0; i < 4; i++) accepted += async->submit({ file, 0, 16, buffer.data() + 16 * i, uint64_t(i) });
+    CHECK(accepted == 3 && async->in_flight() == 3);
+    std::vector<ReadDone> done;
+    while (async->in_flight()) async->complete(done, true);
+    CHECK(done.size() == 3);
+    async->close(file);
+    fs::remove_all(dir);
+}
+
+int main() {
+    bad_headers();
+    round_trip();
+    priority_order();
+    eviction();
+    failures();
+    readers_agree();
+    return check::result();
+}
@@ -0,0 +1,178 @@
+// Undo/redo on a TileCanvas: every step restores exactly the pixels it should, history shares
+// tiles instead of copying them, and the memory cap is kept without the UI thread waiting.
+
+#include "tile_canvas.h"
+#include "undo_history.h"
+#include "check.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace canvas;
+
+std::vector<uint32_t> snapshot(const TileCanvas& c) {
+    std::vector<uint32_t> pixels;
+    pixels.reserve(size_t(c.width()) * c.height());
+    for (int y = 0; y < c.height(); y++) {
+        for (int x = 0; x < c.width(); x++) pixels.push_back(c.pixel(x, y));
+    }
+    return pixels;
+}
+
+// A random rectangle of noise-free color, like a stroke would leave; some are big, most small.
+void random_stroke(TileCanvas& c, std::mt19937& rng) {
+    int w = rng() % 8 == 0 ? 300 : 5 + rng() % 60;
+    int h = rng() % 8 == 0 ? 200 : 5 + rng() % 60;
+    int x = int(rng() % c.width()) - w / 2, y = int(rng() % c.height()) - h / 2;
+    c.fill_rect(x, y, x + w, y + h, rng() | 0xff000000u);
+    c.set_pixel(std::max(x, 0), std::max(y, 0), rng());
+}
+
+void undo_redo_restore_every_step() {
+    std::mt19937 rng(1);
+    TileCanvas c(700, 500);
+    c.fill_rect(0, 0, 100, 100, 0xff102030);
+    UndoHistory history(c);
+    std::vector<std::vector<uint32_t>> states{ snapshot(c) };
+    for (int i = 0; i < 40; i++) {
+        random_stroke(c, rng);
+        history.commit_stroke();
+        states.push_back(snapshot(c));
+        // Let the worker compress some of them, so undo sees both kinds of version.
+        if (i % 3 == 0) history.wait_idle();
+    }
+    CHECK(history.stats().undo_steps == 40);
+
+    for (int i = 40; i > 20; i--) {
+        CHECK(history.undo());
+        CHECK(snapshot(c) == states[i - 1]);
+    }
+    history.wait_idle();
+    for (int i = 20; i > 0; i--) {
+        CHECK(history.undo());
+        CHECK(snapshot(c) == states[i - 1]);
+    }
+    CHECK(!history.undo());
+    CHECK(!history.can_undo());
+    for (int i = 1; i <= 40; i++) {
+        CHECK(history.redo());
+        CHECK(snapshot(c) == states[i]);
+    }
+    CHECK(!history.redo());
+
+    // Undo what's left on the canvas, not the history.
+    for (int i = 0; i < 40; i++) CHECK(history.undo());
+    CHECK(snapshot(c) == states[0]);
+}
+
+void new_stroke_clears_redo() {
+    TileCanvas c(256, 256);
+    UndoHistory history(c);
+    c.fill_rect(0, 0, 10, 10, 0xff0000ffu);
+    history.commit_stroke();
+    history.undo();
+    CHECK(history.can_redo());
+    c.fill_rect(100, 100, 110, 110, 0xff00ff00u);
+    history.commit_stroke();
+    CHECK(!history.can_redo());
+    CHECK(c.pixel(5, 5) == 0);
+    CHECK(c.pixel(105, 105) == 0xff00ff00u);
+}
+
+void undo_discards_uncommitted_drawing() {
+    TileCanvas c(256, 256);
+    UndoHistory history(c);
+    c.fill_rect(0, 0, 10, 10, 0xff0000ffu);
+    history.commit_stroke();
+    c.fill_rect(0, 0, 200, 200, 0xffffffffu);
+    history.undo();
+    CHECK(c.pixel(5, 5) == 0);
+    CHECK(c.pixel(150, 150) == 0);
+    CHECK(history.redo());
+    CHECK(c.pixel(5, 5) == 0xff0000ffu);
+    CHECK(c.pixel(150, 150) == 0);
+}
+
+// A stroke over one tile of a big canvas costs the history one tile, not the canvas.
+void history_only_holds_touched_tiles() {
+    TileCanvas c(4096, 4096);
+    c.fill_rect(0, 0, 4096, 4096, 0xff808080u);
+    UndoHistory history(c);
+    const Tile* untouched = c.tile(c.tile_index(5, 5));
+    for (int i = 0; i < 10; i++) {
+        c.fill_rect(10 + i, 10, 20 + i, 20, 0xff000000u + i);
+        history.commit_stroke();
+    }
+    history.wait_idle();
+    UndoStats stats = history.stats();
+    // 10 old versions of one tile, compressed; the canvas is 4096 tiles of 16KB.
+    CHECK(stats.compressed_tiles == 10);
+    CHECK(stats.bytes < 10 * tile_bytes);
+    // Untouched tiles are the same objects as before any history.
+    CHECK(c.tile(c.tile_index(5, 5)) == untouched);
+}
+
+void cap_drops_oldest_steps() {
+    std::mt19937 rng(2);
+    TileCanvas c(1024, 1024);
+    const size_t cap = 256 * 1024;
+    UndoHistory history(c, cap);
+    std::vector<std::vector<uint32_t>> states{ snapshot(c) };
+    // Noise doesn't compress, so each step holds about what it touched.
+    for (int i = 0; i < 30; i++) {
+        int x = int(rng() % 900), y = int(rng() % 900);
+        for (int py = y; py < y + 100; py++) {
+            for (int px = x; px < x + 100; px++) c.set_pixel(px, py, rng());
+        }
+        history.commit_stroke();
+        states.push_back(snapshot(c));
+    }
+    history.wait_idle();
+    UndoStats stats = history.stats();
+    CHECK(stats.bytes <= cap);
+    CHECK(stats.undo_steps > 0 && stats.undo_steps < 30);
+
+    // What's left still undoes correctly, from the newest back.
+    size_t steps = stats.undo_steps;
+    for (size_t i = 0; i < steps; i++) {
+        CHECK(history.undo());
+        CHECK(snapshot(c) == states[30 - i - 1]);
+    }
+    CHECK(!history.undo());
+
+    // Lowering the cap trims too. Steps whose before tiles were empty cost nothing and may stay.
+    for (size_t i = 0; i < steps; i++) history.redo();
+    history.set_memory_cap(0);
+    history.wait_idle();
+    CHECK(history.stats().bytes == 0);
+    CHECK(history.stats().undo_steps < steps);
+}
+
+// Going over the cap must not make commit_stroke() wait for the compression worker.
+void commit_does_not_wait_for_worker() {
+    std::mt19937 rng(3);
+    TileCanvas c(4096, 4096);
+    UndoHistory history(c, 1);
+    double worst = 0;
+    for (int i = 0; i < 20; i++) {
+        c.fill_rect(0, 0, 4096, 4096, rng() | 0xff000000u);   // 4096 tiles to compress each time
+        auto start = std::chrono::steady_clock::now();
+        history.commit_stroke();
+        worst = std::max(worst, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    history.wait_idle();
+    // Compressing a whole step takes tens of ms; committing one is just bookkeeping.
+    std::printf("slowest commit over the cap: %.2f ms\n", worst * 1000);
+    CHECK(history.stats().undo_steps == 0);
+}
+
+int main() {
+    undo_redo_restore_every_step();
+    new_stroke_clears_redo();
+    undo_discards_uncommitted_drawing();
+    history_only_holds_touched_tiles();
+    cap_drops_oldest_steps();
+    commit_does_not_wait_for_worker();
+    return check::result();
+}
@@ -0,0 +1,105 @@
+// Replays a frame capture (the app writes frames_<n>.cap while capturing, C toggles it) and says
+// what each frame asked the GPU for. With --software it also draws the frames with the software
+// device and saves the last one, with a checkerboard where the textures were.
+//
+//   replay_capture frames_120.cap [--frames] [--software out.png] [--threads n]
+
+#include "frame_capture.h"
+#include "capture_replay.h"
+#include "software_device.h"
+#include "pixel_formats.h"
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, size_t(p * v.size()))];
+}
+
+void print_counts(const char* label, const capture::FrameCounts& c) {
+    std::printf("%-8s %6u draws %8llu triangles %5u barriers %3u clears %3u copies %4u uploads %9llu bytes "
+                "%5u state changes\n",
+                label, c.draws, (unsigned long long)c.triangles, c.barriers, c.clears, c.copies, c.uploads,
+                (unsigned long long)c.upload_bytes, c.state_changes);
+}
+
+int usage() {
+    std::fprintf(stderr, "usage: replay_capture <capture> [--frames] [--software out.png] [--threads n]\n");
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    const char* png = nullptr;
+    bool per_frame = false;
+    unsigned threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--frames") == 0) {
+            per_frame = true;
+        } else if (std::strcmp(argv[i], "--software") == 0 && i + 1 < argc) {
+            png = argv[++i];
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = unsigned(std::atoi(argv[++i]));
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            return usage();
+        }
+    }
+    if (!path) return usage();
+
+    try {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error(std::string("couldn't open ") + path);
+        capture::CountingBackend counter;
+        capture::ReplayStats stats = capture::replay(in, counter);
+        std::printf("%s: %llu frames, %llu commands (%llu unknown), %llu bytes\n", path,
+                    (unsigned long long)stats.frames, (unsigned long long)stats.commands,
+                    (unsigned long long)stats.skipped, (unsigned long long)stats.bytes);
+        if (per_frame) {
+            for (const auto& f : counter.frames()) print_counts(std::to_string(f.frame).c_str(), f);
+        }
+        print_counts("total", counter.totals());
+
+        if (png) {
+            render::Format format = render::Format::unknown;
+            std::vector<uint32_t> pixels;
+            uint32_t width = 0, height = 0;
+            auto keep_frame = [&](const uint32_t* texels, uint32_t w, uint32_t h, render::Format f) {
+                pixels.assign(texels, texels + size_t(w) * h);
+                width = w;
+                height = h;
+                format = f;
+            };
+            render::SoftwareDevice device(threads, keep_frame);
+            capture::DeviceBackend backend(device);
+            in.clear();
+            in.seekg(0);
+            capture::ReplayStats drawn = capture::replay(in, backend);
+            std::printf("software, %u threads: %llu draws, %llu commands skipped, frame p50 %.2f ms, p99 %.2f ms\n",
+                        device.threads(), (unsigned long long)backend.stats().draws,
+                        (unsigned long long)backend.stats().skipped, percentile(drawn.frame_ms, 0.5),
+                        percentile(drawn.frame_ms, 0.99));
+            if (pixels.empty()) throw std::runtime_error("no frame had a render target to save");
+            if (format == render::Format::bgra8_unorm) {
+                pixel::swizzle_rgba_bgra(pixels.data(), pixels.data(), pixels.size());
+            }
+            image::write_png(png, reinterpret_cast<const uint8_t*>(pixels.data()), int(width), int(height),
+                             size_t(width) * 4);
+            std::printf("last frame (%ux%u) saved to %s\n", width, height, png);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "replay_capture: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}